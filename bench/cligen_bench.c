@@ -0,0 +1,685 @@
+/*
+  CLIgen benchmarks with synthetic workloads
+
+  ***** BEGIN LICENSE BLOCK *****
+ 
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the 
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+
+  Each workload generates a spec of size n, loads it with cligen_parse_str, then
+  completes and evaluates generated command lines. Each workload runs in its own
+  process so that peak RSS is per workload. Results are written to stdout, one JSON
+  object per workload and line, see bench/README.md
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <malloc.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+
+#include <cligen/cligen.h>
+#include <cligen/cligen_match.h> /* match_complete, not installed */
+
+/* Default size of generated specs */
+#define BENCH_N     1000
+/* Default number of command lines to complete and evaluate */
+#define BENCH_LINES 10000
+/* Number of commands given by the expand callback */
+#define BENCH_EXPAND 16
+
+/* Callbacks called, to check that lines match */
+static uint64_t _evals = 0;
+
+/*! Command callback, only counts
+ */
+static int
+bench_cb(cligen_handle h,
+	 cvec         *cvv,
+	 cvec         *argv)
+{
+    _evals++;
+    return 0;
+}
+
+static cgv_fnstype_t *
+bench_str2fn(char  *name,
+	     void  *arg,
+	     char **error)
+{
+    return bench_cb;
+}
+
+/*! Expand callback giving BENCH_EXPAND commands ex0, ex1,...
+ */
+static int
+bench_expand_cb(cligen_handle h,
+		char         *fn_str,
+		cvec         *cvv,
+		cvec         *argv,
+		cvec         *commands,
+		cvec         *helptexts)
+{
+    char str[16];
+    int  i;
+
+    for (i=0; i<BENCH_EXPAND; i++){
+	snprintf(str, sizeof(str), "ex%d", i);
+	cvec_add_string(commands, NULL, str);
+	cvec_add_string(helptexts, NULL, "Expanded");
+    }
+    return 0;
+}
+
+static expandv_cb *
+bench_str2fn_exp(char  *name,
+		 void  *arg,
+		 char **error)
+{
+    return bench_expand_cb;
+}
+
+/*
+ * Workloads: a spec generator and generators of the i:th command line to evaluate
+ * and to complete. r is a random number.
+ */
+
+/* Wide level: n keywords with a variable */
+static int
+wide_spec(cbuf *cb,
+	  int   n)
+{
+    int i;
+
+    for (i=0; i<n; i++)
+	cprintf(cb, "k%d(\"Keyword %d\") <x:int32>(\"Value\"), cb();\n", i, i);
+    return 0;
+}
+
+static void
+wide_line(int n, int r, char *buf, size_t len)
+{
+    snprintf(buf, len, "k%d %d", r%n, r);
+}
+
+static void
+wide_prefix(int n, int r, char *buf, size_t len)
+{
+    snprintf(buf, len, "k%d", r%n);
+}
+
+/* Deep hierarchy: n/20 levels with three siblings each */
+static int
+deep_depth(int n)
+{
+    return n/20 < 2 ? 2 : n/20;
+}
+
+static int
+deep_spec(cbuf *cb,
+	  int   n)
+{
+    int d = deep_depth(n);
+    int i;
+    int j;
+
+    for (i=0; i<d; i++){
+	cprintf(cb, "n%d(\"Level %d\") {\n", i, i);
+	for (j=0; j<3; j++)
+	    cprintf(cb, "m%d_%d, cb();\n", i, j);
+    }
+    cprintf(cb, "end, cb();\n");
+    for (i=0; i<d; i++)
+	cprintf(cb, "}\n");
+    return 0;
+}
+
+static void
+deep_path(int k, char *buf, size_t len)
+{
+    size_t l = 0;
+    int    i;
+
+    buf[0] = '\0';
+    for (i=0; i<k && l<len; i++)
+	l += snprintf(buf+l, len-l, "n%d ", i);
+}
+
+static void
+deep_line(int n, int r, char *buf, size_t len)
+{
+    int    k = r%deep_depth(n);
+    size_t l;
+
+    deep_path(k+1, buf, len);
+    l = strlen(buf);
+    snprintf(buf+l, len-l, "m%d_%d", k, r%3);
+}
+
+static void
+deep_prefix(int n, int r, char *buf, size_t len)
+{
+    size_t l;
+
+    deep_path(r%deep_depth(n), buf, len);
+    l = strlen(buf);
+    snprintf(buf+l, len-l, "n");
+}
+
+/* Tree references with filters: n/10 trees of three commands, referenced as copies
+ * with a filter and shared */
+static int
+ref_spec(cbuf *cb,
+	 int   n)
+{
+    int t = n/10 < 1 ? 1 : n/10;
+    int i;
+
+    for (i=0; i<t; i++){
+	cprintf(cb, "r%d @t%d, @remove:local, cb();\n", i, i);
+	cprintf(cb, "s%d @t%d;\n", i, i);
+    }
+    for (i=0; i<t; i++){
+	cprintf(cb, "treename=\"t%d\";\n", i);
+	cprintf(cb, "a%d, cb();\n", i);
+	cprintf(cb, "b%d, local, cb();\n", i);
+	cprintf(cb, "c%d <x:int32>, cb();\n", i);
+    }
+    return 0;
+}
+
+static void
+ref_line(int n, int r, char *buf, size_t len)
+{
+    int t = n/10 < 1 ? 1 : n/10;
+
+    if (r%2)
+	snprintf(buf, len, "r%d a%d", r%t, r%t);
+    else
+	snprintf(buf, len, "s%d c%d %d", r%t, r%t, r);
+}
+
+static void
+ref_prefix(int n, int r, char *buf, size_t len)
+{
+    int t = n/10 < 1 ? 1 : n/10;
+
+    snprintf(buf, len, "%c%d ", r%2?'r':'s', r%t);
+}
+
+/* Sets: n/4 commands each followed by a set of four elements */
+static int
+sets_spec(cbuf *cb,
+	  int   n)
+{
+    int s = n/4 < 1 ? 1 : n/4;
+    int i;
+
+    for (i=0; i<s; i++)
+	cprintf(cb, "s%d @{\n a, cb();\n b <x:int32>, cb();\n c, cb();\n d, cb();\n}\n", i);
+    return 0;
+}
+
+static void
+sets_line(int n, int r, char *buf, size_t len)
+{
+    int s = n/4 < 1 ? 1 : n/4;
+
+    snprintf(buf, len, "s%d c a b %d d", r%s, r);
+}
+
+static void
+sets_prefix(int n, int r, char *buf, size_t len)
+{
+    int s = n/4 < 1 ? 1 : n/4;
+
+    snprintf(buf, len, "s%d c ", r%s);
+}
+
+/* Range and regexp variables */
+static int
+vars_spec(cbuf *cb,
+	  int   n)
+{
+    int i;
+
+    for (i=0; i<n; i++)
+	cprintf(cb, "v%d <x:int32 range[1:1000]> <y:string regexp:\"[a-z]+[0-9]*\">, cb();\n", i);
+    return 0;
+}
+
+static void
+vars_line(int n, int r, char *buf, size_t len)
+{
+    snprintf(buf, len, "v%d %d abc%d", r%n, 1+r%1000, r);
+}
+
+static void
+vars_prefix(int n, int r, char *buf, size_t len)
+{
+    snprintf(buf, len, "v%d %d a", r%n, 1+r%1000);
+}
+
+/* Expand callbacks */
+static int
+expand_spec(cbuf *cb,
+	    int   n)
+{
+    int i;
+
+    for (i=0; i<n; i++)
+	cprintf(cb, "e%d <x:string exp()>, cb();\n", i);
+    return 0;
+}
+
+static void
+expand_line(int n, int r, char *buf, size_t len)
+{
+    snprintf(buf, len, "e%d ex%d", r%n, r%BENCH_EXPAND);
+}
+
+static void
+expand_prefix(int n, int r, char *buf, size_t len)
+{
+    snprintf(buf, len, "e%d ex1", r%n);
+}
+
+struct bench_workload{
+    const char *bw_name;
+    int       (*bw_spec)(cbuf *cb, int n);
+    void      (*bw_line)(int n, int r, char *buf, size_t len);
+    void      (*bw_prefix)(int n, int r, char *buf, size_t len);
+};
+
+static struct bench_workload _workloads[] = {
+    {"wide",   wide_spec,   wide_line,   wide_prefix},
+    {"deep",   deep_spec,   deep_line,   deep_prefix},
+    {"ref",    ref_spec,    ref_line,    ref_prefix},
+    {"sets",   sets_spec,   sets_line,   sets_prefix},
+    {"vars",   vars_spec,   vars_line,   vars_prefix},
+    {"expand", expand_spec, expand_line, expand_prefix},
+    {NULL,     NULL,        NULL,        NULL}
+};
+
+/* Strings parsed by the cv_parse1 micro-benchmark, one valid and one invalid per type */
+struct bench_type{
+    enum cv_type bt_type;
+    char        *bt_valid;
+    char        *bt_invalid;
+};
+
+static struct bench_type _types[] = {
+    {CGV_INT8,     "-100",                                 "1000"},
+    {CGV_INT32,    "1234567",                              "12x"},
+    {CGV_INT64,    "-123456789012",                        "abc"},
+    {CGV_UINT32,   "4000000000",                           "-1"},
+    {CGV_UINT64,   "123456789012345",                      "0x"},
+    {CGV_DEC64,    "12345.67",                             "1.234"},
+    {CGV_BOOL,     "true",                                 "maybe"},
+    {CGV_STRING,   "interface-name",                       ""},
+    {CGV_IPV4ADDR, "192.168.100.200",                      "192.168.100.256"},
+    {CGV_IPV6ADDR, "2001:db8:85a3::8a2e:370:7334",         "eth0"},
+    {CGV_IPV4PFX,  "10.0.0.0/8",                           "10.0.0.0/40"},
+    {CGV_MACADDR,  "00:1b:21:3a:4f:5e",                    "00:1b:21:3a:4f"},
+    {CGV_UUID,     "f47ac10b-58cc-4372-a567-0e02b2c3d479", "f47ac10b"},
+    {CGV_TIME,     "2008-09-21T18:57:21.003456Z",          "2008-13-21"},
+    {CGV_ERR,      NULL,                                   NULL}
+};
+
+/*! Monotonic time in microseconds
+ */
+static double
+bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1e6 + ts.tv_nsec/1e3;
+}
+
+/*! Heap in use in kilobytes, or 0 if not known
+ */
+static uint64_t
+bench_heap(void)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 mi = mallinfo2();
+
+    return (mi.uordblks + mi.hblkhd)/1024;
+#else
+    return 0;
+#endif
+}
+
+/*! Complete a line as TAB does, see cli_tab_hook, without showing the alternatives
+ */
+static int
+bench_complete(cligen_handle h,
+	       parse_tree   *pt,
+	       char         *line)
+{
+    int         retval = -1;
+    parse_tree *ptn = NULL;
+    cvec       *cvv = NULL;
+    char       *s = NULL;
+    size_t      slen;
+    size_t      mark;
+
+    if (cligen_line_begin(h, &mark) < 0)
+	return -1;
+    if ((ptn = pt_new_arena(cligen_line_arena(h))) == NULL)
+	goto done;
+    if (pt_expand_treeref_flush(h) < 0)
+	goto done;
+    if (pt_expand_treeref(h, NULL, pt) < 0)
+	goto done;
+    if ((cvv = cvec_start(line)) == NULL)
+	goto done;
+    if (pt_expand(h, pt, cvv, 1, 0, ptn) < 0)
+	goto done;
+    slen = strlen(line) + 64;
+    if ((s = malloc(slen)) == NULL)
+	goto done;
+    strcpy(s, line);
+    if (match_complete(h, ptn, &s, &slen, cvv) < 0)
+	goto done;
+    retval = 0;
+ done:
+    if (s)
+	free(s);
+    if (cvv)
+	cvec_free(cvv);
+    if (ptn)
+	pt_free(ptn, 0);
+    pt_expand_cleanup(pt);
+    pt_expand_treeref_release(h, pt);
+    cligen_line_end(h, mark);
+    return retval;
+}
+
+/*! Parse and evaluate a line as cliread_eval does
+ * @retval  1  Match
+ * @retval  0  No match
+ * @retval -1  Error
+ */
+static int
+bench_eval(cligen_handle h,
+	   parse_tree   *pt,
+	   char         *line)
+{
+    int           retval = -1;
+    cvec         *cvv;
+    cg_obj       *co;
+    cligen_result result;
+    char         *reason = NULL;
+
+    if ((cvv = cvec_new(0)) == NULL)
+	return -1;
+    if (cliread_parse(h, line, pt, &co, cvv, &result, &reason) < 0)
+	goto done;
+    if (result == CG_MATCH){
+	cligen_eval(h, co, cvv);
+	retval = 1;
+    }
+    else
+	retval = 0;
+ done:
+    if (reason)
+	free(reason);
+    cvec_free(cvv);
+    pt_expand_treeref_release(h, pt);
+    return retval;
+}
+
+/*! Run one workload and print its result
+ */
+static int
+bench_run(struct bench_workload *bw,
+	  int                    n,
+	  int                    lines)
+{
+    int           retval = -1;
+    cligen_handle h = NULL;
+    cbuf         *cb = NULL;
+    pt_head      *ph;
+    parse_tree   *pt;
+    char          line[1024];
+    double        t0;
+    double        load;
+    double        complete;
+    double        eval;
+    uint64_t      co0;
+    uint64_t      coload;
+    uint64_t      coeval;
+    uint64_t      heap;
+    int           matched = 0;
+    int           i;
+    int           ret;
+    struct rusage ru;
+
+    if ((cb = cbuf_new()) == NULL)
+	goto done;
+    cprintf(cb, "treename=\"main\";\n");
+    if (bw->bw_spec(cb, n) < 0)
+	goto done;
+    if ((h = cligen_init()) == NULL)
+	goto done;
+    /* Load */
+    co0 = co_count_get();
+    t0 = bench_now();
+    if (cligen_parse_str(h, cbuf_get(cb), (char*)bw->bw_name, NULL, NULL) < 0)
+	goto done;
+    ph = NULL;
+    while ((ph = cligen_ph_each(h, ph)) != NULL){
+	if ((pt = cligen_ph_parsetree_get(ph)) == NULL)
+	    continue;
+	if (cligen_callbackv_str2fn(pt, bench_str2fn, NULL) < 0)
+	    goto done;
+	if (cligen_expandv_str2fn(pt, bench_str2fn_exp, NULL) < 0)
+	    goto done;
+    }
+    load = bench_now() - t0;
+    coload = co_count_get() - co0;
+    heap = bench_heap();
+    if (cligen_ph_active_set(h, "main") < 0)
+	goto done;
+    if ((pt = cligen_pt_active_get(h)) == NULL)
+	goto done;
+    /* Complete */
+    srandom(1);
+    t0 = bench_now();
+    for (i=0; i<lines; i++){
+	bw->bw_prefix(n, random(), line, sizeof(line));
+	if (bench_complete(h, pt, line) < 0)
+	    goto done;
+    }
+    complete = bench_now() - t0;
+    /* Parse and evaluate */
+    srandom(1);
+    co0 = co_count_get();
+    _evals = 0;
+    t0 = bench_now();
+    for (i=0; i<lines; i++){
+	bw->bw_line(n, random(), line, sizeof(line));
+	if ((ret = bench_eval(h, pt, line)) < 0)
+	    goto done;
+	matched += ret;
+    }
+    eval = bench_now() - t0;
+    coeval = co_count_get() - co0;
+    pt_expand_cleanup(pt);
+    getrusage(RUSAGE_SELF, &ru);
+    printf("{\"bench\":\"%s\",\"version\":\"%s\",\"n\":%d,\"lines\":%d,"
+	   "\"load_ms\":%.3f,\"load_objects\":%" PRIu64 ",\"heap_kb\":%" PRIu64 ","
+	   "\"complete_us\":%.3f,\"eval_us\":%.3f,\"eval_per_s\":%.0f,"
+	   "\"eval_objects\":%.2f,\"matched\":%d,\"evals\":%" PRIu64 ",\"maxrss_kb\":%ld}\n",
+	   bw->bw_name, CLIGEN_VERSION, n, lines,
+	   load/1000, coload, heap,
+	   lines?complete/lines:0, lines?eval/lines:0, eval>0?lines/(eval/1e6):0,
+	   lines?(double)coeval/lines:0, matched, _evals, ru.ru_maxrss);
+    fflush(stdout);
+    retval = 0;
+ done:
+    if (h)
+	cligen_exit(h);
+    if (cb)
+	cbuf_free(cb);
+    return retval;
+}
+
+/*! Micro-benchmark of cv_parse1 per type, of valid strings and of invalid strings
+ * with reason, as when alternative variables are tried on a token
+ */
+static int
+bench_types(int lines)
+{
+    struct bench_type *bt;
+    cg_var            *cv;
+    char              *reason;
+    double             t0;
+    double             valid;
+    double             invalid;
+    int                i;
+
+    for (bt = _types; bt->bt_type != CGV_ERR; bt++){
+	if ((cv = cv_new(bt->bt_type)) == NULL)
+	    return -1;
+	if (bt->bt_type == CGV_DEC64)
+	    cv_dec64_n_set(cv, 2);
+	t0 = bench_now();
+	for (i=0; i<lines; i++)
+	    if (cv_parse1(bt->bt_valid, cv, NULL) != 1){
+		fprintf(stderr, "%s: %s not valid\n", __FUNCTION__, bt->bt_valid);
+		cv_free(cv);
+		return -1;
+	    }
+	valid = bench_now() - t0;
+	t0 = bench_now();
+	for (i=0; i<lines; i++){
+	    reason = NULL;
+	    if (cv_parse1(bt->bt_invalid, cv, &reason) < 0){
+		cv_free(cv);
+		return -1;
+	    }
+	    if (reason)
+		free(reason);
+	}
+	invalid = bench_now() - t0;
+	cv_free(cv);
+	printf("{\"bench\":\"types\",\"version\":\"%s\",\"type\":\"%s\",\"lines\":%d,"
+	       "\"valid_ns\":%.1f,\"invalid_ns\":%.1f}\n",
+	       CLIGEN_VERSION, cv_type2str(bt->bt_type), lines,
+	       lines?valid*1000/lines:0, lines?invalid*1000/lines:0);
+    }
+    fflush(stdout);
+    return 0;
+}
+
+static void
+usage(char *argv0)
+{
+    fprintf(stderr, "Usage:%s [-h][-n <size>][-l <lines>][-w <workload>], where the options have the following meaning:\n"
+	    "\t-h \t\tHelp\n"
+	    "\t-n <size> \tSize of generated specs (default %d)\n"
+	    "\t-l <lines> \tNumber of lines to complete and evaluate (default %d)\n"
+	    "\t-w <name> \tOnly run workload: wide, deep, ref, sets, vars, expand or types\n",
+	    argv0, BENCH_N, BENCH_LINES);
+    exit(0);
+}
+
+int
+main(int   argc,
+     char *argv[])
+{
+    int                    c;
+    int                    n = BENCH_N;
+    int                    lines = BENCH_LINES;
+    char                  *name = NULL;
+    struct bench_workload *bw;
+    pid_t                  pid;
+    int                    status;
+    int                    failed = 0;
+
+    while ((c = getopt(argc, argv, "hn:l:w:")) != -1)
+	switch (c){
+	case 'n':
+	    n = atoi(optarg);
+	    break;
+	case 'l':
+	    lines = atoi(optarg);
+	    break;
+	case 'w':
+	    name = optarg;
+	    break;
+	default:
+	    usage(argv[0]);
+	    break;
+	}
+    if (n < 1 || lines < 0)
+	usage(argv[0]);
+    for (bw = _workloads; bw->bw_name; bw++){
+	if (name && strcmp(name, bw->bw_name) != 0)
+	    continue;
+	/* Own process for peak RSS of this workload only */
+	if ((pid = fork()) < 0){
+	    fprintf(stderr, "fork: %s\n", strerror(errno));
+	    return 1;
+	}
+	if (pid == 0)
+	    exit(bench_run(bw, n, lines) < 0 ? 1 : 0);
+	if (waitpid(pid, &status, 0) < 0 ||
+	    !WIFEXITED(status) || WEXITSTATUS(status) != 0){
+	    fprintf(stderr, "%s: workload %s failed\n", argv[0], bw->bw_name);
+	    failed++;
+	}
+    }
+    /* cv_parse1 per type, no spec */
+    if (name == NULL || strcmp(name, "types") == 0){
+	if ((pid = fork()) < 0){
+	    fprintf(stderr, "fork: %s\n", strerror(errno));
+	    return 1;
+	}
+	if (pid == 0)
+	    exit(bench_types(lines) < 0 ? 1 : 0);
+	if (waitpid(pid, &status, 0) < 0 ||
+	    !WIFEXITED(status) || WEXITSTATUS(status) != 0){
+	    fprintf(stderr, "%s: workload types failed\n", argv[0]);
+	    failed++;
+	}
+    }
+    return failed ? 1 : 0;
+}
@@ -70,6 +70,13 @@ extern "C" {
 #include <cligen/cligen_util.h>
 #include <cligen/cligen_regex.h>
 #include <cligen/cligen_history.h>
+#include <cligen/cligen_arena.h>
+#include <cligen/cligen_image.h>
+#include <cligen/cligen_intern.h>
+#include <cligen/cligen_stats.h>
+#include <cligen/cligen_registry.h>
+#include <cligen/cligen_compile.h>
+#include <cligen/cligen_server.h>
 
 #ifdef __cplusplus
 } /* extern "C" */
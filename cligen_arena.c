@@ -0,0 +1,288 @@
+/*
+  CLI generator memory arenas
+
+  ***** BEGIN LICENSE BLOCK *****
+ 
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the 
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+
+  This file includes a simple region (arena) allocator: memory is carved sequentially
+  from larger chunks and released all at once, or back to a mark.
+*/
+
+#include "cligen_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "cligen_arena.h"
+
+/* Alignment of allocations */
+#define ARENA_ALIGN (2*sizeof(void*))
+
+/* A chunk of memory in an arena. Data follows the header */
+struct arena_chunk{
+    struct arena_chunk *ac_next;  /* Next chunk, chunks after current are spare */
+    size_t              ac_off;   /* Offset of this chunk in arena, used by marks */
+    size_t              ac_size;  /* Size of data (excluding header) */
+    size_t              ac_used;  /* Used bytes of data */
+};
+
+/* Header size, rounded up to alignment */
+#define ARENA_HDR (((sizeof(struct arena_chunk)+ARENA_ALIGN-1)/ARENA_ALIGN)*ARENA_ALIGN)
+
+struct cligen_arena{
+    size_t              ca_chunksize; /* Default chunk data size */
+    struct arena_chunk *ca_first;     /* First chunk */
+    struct arena_chunk *ca_cur;       /* Current chunk, allocate from here */
+    size_t              ca_peak;      /* Highest position allocated to, see cligen_arena_peak */
+};
+
+/*! Create a new arena
+ * @param[in]  chunksize  Size of each chunk, 0 means CLIGEN_ARENA_CHUNK
+ * @retval     ca         Arena, free with cligen_arena_free
+ * @retval     NULL       Error
+ */
+cligen_arena *
+cligen_arena_new(size_t chunksize)
+{
+    cligen_arena *ca;
+
+    if ((ca = malloc(sizeof(*ca))) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	return NULL;
+    }
+    memset(ca, 0, sizeof(*ca));
+    ca->ca_chunksize = chunksize?chunksize:CLIGEN_ARENA_CHUNK;
+    return ca;
+}
+
+/*! Allocate a new chunk after the current chunk in an arena
+ * @param[in]  ca    Arena
+ * @param[in]  size  Minimal data size of chunk
+ */
+static struct arena_chunk *
+arena_chunk_new(cligen_arena *ca,
+		size_t        size)
+{
+    struct arena_chunk *ac;
+    
+    if (size < ca->ca_chunksize)
+	size = ca->ca_chunksize;
+    if ((ac = malloc(ARENA_HDR + size)) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	return NULL;
+    }
+    memset(ac, 0, sizeof(*ac));
+    ac->ac_size = size;
+    if (ca->ca_cur == NULL){
+	ac->ac_next = ca->ca_first;
+	ca->ca_first = ac;
+    }
+    else{
+	ac->ac_next = ca->ca_cur->ac_next;
+	ca->ca_cur->ac_next = ac;
+    }
+    return ac;
+}
+
+/*! Allocate memory from an arena
+ *
+ * The memory is aligned and not initialized. It cannot be freed individually, only by
+ * cligen_arena_release, cligen_arena_reset or cligen_arena_free.
+ * @param[in]  ca    Arena
+ * @param[in]  len   Number of bytes
+ * @retval     ptr   Allocated memory
+ * @retval     NULL  Error
+ */
+void *
+cligen_arena_alloc(cligen_arena *ca,
+		   size_t        len)
+{
+    struct arena_chunk *ac;
+    struct arena_chunk *next;
+    void               *ptr;
+
+    if (ca == NULL){
+	errno = EINVAL;
+	return NULL;
+    }
+    len = ((len+ARENA_ALIGN-1)/ARENA_ALIGN)*ARENA_ALIGN;
+    if ((ac = ca->ca_cur) == NULL || ac->ac_used + len > ac->ac_size){
+	/* Use next spare chunk if large enough, otherwise allocate a new */
+	next = ac?ac->ac_next:ca->ca_first;
+	if (next == NULL || next->ac_size < len){
+	    if ((next = arena_chunk_new(ca, len)) == NULL)
+		return NULL;
+	}
+	next->ac_off = ac?ac->ac_off + ac->ac_size:0;
+	next->ac_used = 0;
+	ca->ca_cur = ac = next;
+    }
+    ptr = (char*)ac + ARENA_HDR + ac->ac_used;
+    ac->ac_used += len;
+    if (ac->ac_off + ac->ac_used > ca->ca_peak)
+	ca->ca_peak = ac->ac_off + ac->ac_used;
+    return ptr;
+}
+
+/*! Allocate zeroed memory from an arena
+ * @param[in]  ca    Arena
+ * @param[in]  len   Number of bytes
+ * @see cligen_arena_alloc
+ */
+void *
+cligen_arena_calloc(cligen_arena *ca,
+		    size_t        len)
+{
+    void *ptr;
+
+    if ((ptr = cligen_arena_alloc(ca, len)) != NULL)
+	memset(ptr, 0, len);
+    return ptr;
+}
+
+/*! Get a mark of current position in arena, to release back to
+ * @param[in]  ca    Arena
+ * @retval     mark  Position
+ * @see cligen_arena_release
+ */
+size_t
+cligen_arena_mark(cligen_arena *ca)
+{
+    if (ca == NULL || ca->ca_cur == NULL)
+	return 0;
+    return ca->ca_cur->ac_off + ca->ca_cur->ac_used;
+}
+
+/*! Release all memory allocated after a mark. Chunks are kept for re-use
+ *
+ * Marks and releases must be nested, ie a release invalidates all later marks.
+ * @param[in]  ca    Arena
+ * @param[in]  mark  Position from cligen_arena_mark
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+int
+cligen_arena_release(cligen_arena *ca,
+		     size_t        mark)
+{
+    struct arena_chunk *ac;
+
+    if (ca == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    if (mark == 0){
+	ca->ca_cur = NULL;
+	return 0;
+    }
+    for (ac = ca->ca_first; ac != NULL; ac = ac->ac_next){
+	if (mark <= ac->ac_off + ac->ac_size){
+	    ac->ac_used = mark - ac->ac_off;
+	    ca->ca_cur = ac;
+	    return 0;
+	}
+	if (ac == ca->ca_cur)
+	    break;
+    }
+    errno = EINVAL;
+    return -1;
+}
+
+/*! Return highest position allocated to since creation or cligen_arena_peak_reset
+ *
+ * Compare with a mark to get the most memory used after the mark
+ * @param[in]  ca    Arena
+ * @see cligen_arena_mark
+ */
+size_t
+cligen_arena_peak(cligen_arena *ca)
+{
+    if (ca == NULL)
+	return 0;
+    return ca->ca_peak;
+}
+
+/*! Reset highest position allocated to, to current position
+ * @param[in]  ca    Arena
+ */
+int
+cligen_arena_peak_reset(cligen_arena *ca)
+{
+    if (ca != NULL)
+	ca->ca_peak = cligen_arena_mark(ca);
+    return 0;
+}
+
+/*! Release all memory of an arena. Chunks are kept for re-use
+ * @param[in]  ca    Arena
+ */
+int
+cligen_arena_reset(cligen_arena *ca)
+{
+    return cligen_arena_release(ca, 0);
+}
+
+/*! Return number of bytes allocated from the system by an arena (in chunks)
+ * @param[in]  ca    Arena
+ */
+size_t
+cligen_arena_size(cligen_arena *ca)
+{
+    struct arena_chunk *ac;
+    size_t              size = 0;
+
+    if (ca == NULL)
+	return 0;
+    for (ac = ca->ca_first; ac != NULL; ac = ac->ac_next)
+	size += ARENA_HDR + ac->ac_size;
+    return size;
+}
+
+/*! Free an arena and all its chunks
+ * @param[in]  ca    Arena
+ */
+int
+cligen_arena_free(cligen_arena *ca)
+{
+    struct arena_chunk *ac;
+
+    if (ca == NULL)
+	return 0;
+    while ((ac = ca->ca_first) != NULL){
+	ca->ca_first = ac->ac_next;
+	free(ac);
+    }
+    free(ca);
+    return 0;
+}
@@ -0,0 +1,66 @@
+/*
+  CLI generator memory arenas
+
+  ***** BEGIN LICENSE BLOCK *****
+ 
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the 
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+
+  This file includes a simple region (arena) allocator
+*/
+
+#ifndef _CLIGEN_ARENA_H_
+#define _CLIGEN_ARENA_H_
+
+/*
+ * Constants
+ */
+/* Default size of arena chunks */
+#define CLIGEN_ARENA_CHUNK 65536
+
+/*
+ * Types
+ */
+typedef struct cligen_arena cligen_arena; /* struct defined internally in cligen_arena.c */
+
+/*
+ * Prototypes
+ */
+cligen_arena *cligen_arena_new(size_t chunksize);
+void         *cligen_arena_alloc(cligen_arena *ca, size_t len);
+void         *cligen_arena_calloc(cligen_arena *ca, size_t len);
+size_t        cligen_arena_mark(cligen_arena *ca);
+int           cligen_arena_release(cligen_arena *ca, size_t mark);
+int           cligen_arena_reset(cligen_arena *ca);
+size_t        cligen_arena_peak(cligen_arena *ca);
+int           cligen_arena_peak_reset(cligen_arena *ca);
+size_t        cligen_arena_size(cligen_arena *ca);
+int           cligen_arena_free(cligen_arena *ca);
+
+#endif /* _CLIGEN_ARENA_H_ */
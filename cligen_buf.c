@@ -52,6 +52,12 @@
 #define CBUFLEN_START 1024
 #define CBUFLEN_THRESHOLD 65536
 
+/* Max buffer length of a cbuf kept by a pool, larger buffers are freed so that a pool
+ * does not hold the space of an unusually large output
+ * @see cbuf_pool_set
+ */
+#define CBUF_POOL_BUFLEN_MAX CBUFLEN_THRESHOLD
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -63,9 +69,10 @@
 
 /*
  * Variables
+ * These are defaults, copied to new pools, see cbuf_alloc_set
  */
-/* This is how large an initial cbuf is after calling cbuf_new. Note that the cbuf 
- * may grow after calls to cprintf or cbuf_alloc 
+/* This is how large an initial cbuf is after calling cbuf_new. Note that the cbuf
+ * may grow after calls to cprintf or cbuf_alloc
  */
 static size_t cbuflen_start     = CBUFLEN_START;
 
@@ -74,9 +81,15 @@ static size_t cbuflen_start     = CBUFLEN_START;
  */
 static size_t cbuflen_threshold = CBUFLEN_THRESHOLD;
 
-/*! Get global cbuf initial memory allocation size
- * This is how large a cbuf is after calling cbuf_new. Note that the cbuf 
+/* Pool of the calling thread, used by cbuf_new and cbuf_free if set
+ * @see cbuf_pool_set
+ */
+static __thread cbuf_pool *_cbuf_pool = NULL;
+
+/*! Get cbuf initial memory allocation size
+ * This is how large a cbuf is after calling cbuf_new. Note that the cbuf
  * may grow after calls to cprintf or cbuf_alloc
+ * The sizes are those of the pool bound to the calling thread, or the defaults if none.
  * @param[out]  default   Initial default cbuf size
  * @param[out]  threshold Threshold where cbuf grows linearly instead of exponentially
  */
@@ -84,22 +97,125 @@ int
 cbuf_alloc_get(size_t *start,
 	       size_t *threshold)
 {
-    *start = cbuflen_start;
-    *threshold = cbuflen_threshold;
+    cbuf_pool *cp;
+
+    if ((cp = _cbuf_pool) != NULL){
+	*start = cp->cp_start;
+	*threshold = cp->cp_threshold;
+    }
+    else {
+	*start = cbuflen_start;
+	*threshold = cbuflen_threshold;
+    }
     return 0;
 }
 
-/*! Set global cbuf initial memory allocation size
- * This is how large a cbuf is after calling cbuf_new. Note that the cbuf 
+/*! Set cbuf initial memory allocation size
+ * This is how large a cbuf is after calling cbuf_new. Note that the cbuf
  * may grow after calls to cprintf or cbuf_alloc
  * If 0 continue with exponential growth
+ * The sizes are set in the pool bound to the calling thread, eg by cligen_thread_set. If
+ * no pool is bound, the defaults are set, which are copied to pools created later.
+ * Set the defaults before threads are started.
  */
 int
 cbuf_alloc_set(size_t start,
 	       size_t threshold)
 {
-    cbuflen_start = start;
-    cbuflen_threshold = threshold;
+    cbuf_pool *cp;
+
+    if ((cp = _cbuf_pool) != NULL){
+	cp->cp_start = start;
+	cp->cp_threshold = threshold;
+    }
+    else {
+	cbuflen_start = start;
+	cbuflen_threshold = threshold;
+    }
+    return 0;
+}
+
+/*! Create a pool of free cbufs
+ * @retval  cp    Pool, free with cbuf_pool_free
+ * @retval  NULL  Error
+ * @see cbuf_pool_set
+ */
+cbuf_pool *
+cbuf_pool_new(void)
+{
+    cbuf_pool *cp;
+
+    if ((cp = malloc(sizeof(*cp))) == NULL)
+	return NULL;
+    memset(cp, 0, sizeof(*cp));
+    cp->cp_start = cbuflen_start;
+    cp->cp_threshold = cbuflen_threshold;
+    return cp;
+}
+
+/*! Free a pool and the cbufs it keeps
+ *
+ * The pool is unbound from the calling thread if bound to it.
+ * @param[in]  cp   Pool
+ * @retval     0    OK
+ */
+int
+cbuf_pool_free(cbuf_pool *cp)
+{
+    cbuf *cb;
+
+    if (cp == NULL)
+	return 0;
+    if (_cbuf_pool == cp)
+	_cbuf_pool = NULL;
+    while (cp->cp_len){
+	cb = cp->cp_free[--cp->cp_len];
+	free(cb->cb_buffer);
+	free(cb);
+    }
+    free(cp);
+    return 0;
+}
+
+/*! Bind a pool to the calling thread
+ *
+ * When a pool is bound, cbuf_free gives the cbuf back to the pool keeping its buffer,
+ * and cbuf_new takes it from there. A pool is used by one thread at a time.
+ * CLIgen binds the pool of a handle with cligen_thread_set.
+ * @param[in]  cp   Pool, or NULL to unbind, ie cbufs are always allocated and freed
+ * @retval     0    OK
+ */
+int
+cbuf_pool_set(cbuf_pool *cp)
+{
+    _cbuf_pool = cp;
+    return 0;
+}
+
+/*! Return pool bound to the calling thread, or NULL
+ * @see cbuf_pool_set
+ */
+cbuf_pool *
+cbuf_pool_get(void)
+{
+    return _cbuf_pool;
+}
+
+/*! Get number of cbufs taken from and allocated while a pool was bound
+ * @param[in]  cp         Pool
+ * @param[out] reused     Cbufs taken from the pool
+ * @param[out] allocated  Cbufs allocated since the pool had no large enough cbuf
+ * @retval     0          OK
+ */
+int
+cbuf_pool_stats(cbuf_pool *cp,
+		uint64_t  *reused,
+		uint64_t  *allocated)
+{
+    if (reused)
+	*reused = cp?cp->cp_reused:0;
+    if (allocated)
+	*allocated = cp?cp->cp_allocated:0;
     return 0;
 }
 
@@ -114,14 +230,32 @@ cbuf_alloc_set(size_t start,
 cbuf *
 cbuf_new_alloc(size_t sz)
 {
-    cbuf *cb;
-
+    cbuf      *cb;
+    cbuf_pool *cp;
+    int        i;
+
+    if ((cp = _cbuf_pool) != NULL){
+	/* Latest freed first, its buffer is most likely in cache */
+	for (i=cp->cp_len-1; i>=0; i--){
+	    cb = cp->cp_free[i];
+	    if (cb->cb_buflen < sz)
+		continue;
+	    cp->cp_free[i] = cp->cp_free[--cp->cp_len];
+	    cp->cp_reused++;
+	    cb->cb_strlen = 0;
+	    cb->cb_buffer[0] = '\0';
+	    return cb;
+	}
+	cp->cp_allocated++;
+    }
     if ((cb = (cbuf*)malloc(sizeof(*cb))) == NULL)
 	return NULL;
     memset(cb, 0, sizeof(*cb));
     cb->cb_buflen = sz;
-    if ((cb->cb_buffer = malloc(cb->cb_buflen)) == NULL)
+    if ((cb->cb_buffer = malloc(cb->cb_buflen)) == NULL){
+	free(cb);
 	return NULL;
+    }
     memset(cb->cb_buffer, 0, cb->cb_buflen);
     cb->cb_strlen = 0;
     return cb;
@@ -137,16 +271,31 @@ cbuf_new_alloc(size_t sz)
 cbuf *
 cbuf_new(void)
 {
-    return cbuf_new_alloc(cbuflen_start);
+    cbuf_pool *cp = _cbuf_pool;
+
+    return cbuf_new_alloc(cp ? cp->cp_start : cbuflen_start);
 }
 
 /*! Free cligen buffer previously allocated with cbuf_new
+ *
+ * If a pool is bound to the calling thread, the cbuf is kept by the pool with its
+ * buffer, unless the pool is full or the buffer is large.
  * @param[in]   cb  Cligen buffer
+ * @see cbuf_pool_set
  */
 void
 cbuf_free(cbuf *cb)
 {
+    cbuf_pool *cp;
+
     if (cb) {
+	if ((cp = _cbuf_pool) != NULL &&
+	    cp->cp_len < CBUF_POOL_MAX &&
+	    cb->cb_buffer &&
+	    cb->cb_buflen <= CBUF_POOL_BUFLEN_MAX){
+	    cp->cp_free[cp->cp_len++] = cb;
+	    return;
+	}
 	if (cb->cb_buffer)
 	    free(cb->cb_buffer);
 	free(cb);
@@ -201,16 +350,18 @@ static int
 cbuf_realloc(cbuf  *cb,
 	     size_t sz)
 {
-    int retval = -1;
-    int diff;
-    
+    int    retval = -1;
+    int    diff;
+    size_t threshold;
+
     diff = cb->cb_buflen - (cb->cb_strlen + sz + 1);
     if (diff <= 0){
+	threshold = _cbuf_pool ? _cbuf_pool->cp_threshold : cbuflen_threshold;
 	while (diff <= 0){
-	    if (cbuflen_threshold == 0 || cb->cb_buflen < cbuflen_threshold)
+	    if (threshold == 0 || cb->cb_buflen < threshold)
 		cb->cb_buflen *= 2; /* Double the space - exponential */
 	    else
-		cb->cb_buflen += cbuflen_threshold; /* Add - linear growth*/
+		cb->cb_buflen += threshold; /* Add - linear growth*/
 	    diff = cb->cb_buflen - (cb->cb_strlen + sz + 1);
 	}
 	if ((cb->cb_buffer = realloc(cb->cb_buffer, cb->cb_buflen)) == NULL)
@@ -221,8 +372,57 @@ cbuf_realloc(cbuf  *cb,
     return retval;
 }
 
+/*! Reserve space at the end of a cbuf to write into directly
+ *
+ * Use instead of formatting into a local buffer and appending it. Write at most n
+ * bytes at the returned pointer and then call cbuf_commit with the number of bytes
+ * written. The pointer is valid until the cbuf is changed.
+ * @code
+ *   if ((p = cbuf_reserve(cb, INET6_ADDRSTRLEN)) == NULL)
+ *      err();
+ *   inet_ntop(AF_INET6, &addr, p, INET6_ADDRSTRLEN);
+ *   cbuf_commit(cb, strlen(p));
+ * @endcode
+ * @param [in]  cb   cligen buffer allocated by cbuf_new(), may be reallocated.
+ * @param [in]  n    Number of bytes to reserve, a null byte is reserved in addition
+ * @retval      p    Pointer to end of string in cbuf
+ * @retval      NULL Error
+ * @see cbuf_commit
+ */
+char *
+cbuf_reserve(cbuf  *cb,
+	     size_t n)
+{
+    if (cbuf_realloc(cb, n) < 0)
+	return NULL;
+    return cb->cb_buffer + cb->cb_strlen;
+}
+
+/*! Add bytes written into space reserved by cbuf_reserve to the string of a cbuf
+ * @param [in]  cb   cligen buffer
+ * @param [in]  n    Number of bytes written, a null byte is added
+ * @retval      0    OK
+ * @retval      -1   Error, n is larger than the space of the cbuf
+ * @see cbuf_reserve
+ */
+int
+cbuf_commit(cbuf  *cb,
+	    size_t n)
+{
+    if (cb->cb_strlen + n >= cb->cb_buflen){
+	errno = EINVAL;
+	return -1;
+    }
+    cb->cb_strlen += n;
+    cb->cb_buffer[cb->cb_strlen] = '\0';
+    return 0;
+}
+
 /*! Append a cligen buf by printf like semantics
  * 
+ * The string is formatted directly into the free space of the cbuf. Only if it does
+ * not fit, the cbuf is grown and the string is formatted again. Since the cbuf grows
+ * exponentially, this is rare when a cbuf is reused.
  * @param [in]  cb      cligen buffer allocated by cbuf_new(), may be reallocated.
  * @param [in]  format  arguments uses printf syntax.
  * @retval      See printf
@@ -236,28 +436,36 @@ cprintf(cbuf       *cb,
     int     retval = -1;
     va_list ap;
     int     len;
-    int     ret;
+    size_t  avail;
 
     if (cb == NULL)
 	goto ok;
-    va_start(ap, format); /* dryrun */
-    if ((len = vsnprintf(NULL, 0, format, ap)) < 0) /* dryrun, just get len */
-	goto done;
-    va_end(ap);
-    /* Ensure buffer is large enough */
-    if (cbuf_realloc(cb, len) < 0)
-    	goto done;
-    va_start(ap, format); /* real */
-    if ((ret = vsnprintf(cb->cb_buffer+cb->cb_strlen, /* str */
-			 cb->cb_buflen-cb->cb_strlen, /* size */
-			 format, ap)) < 0)
-	goto done;
+    avail = cb->cb_buflen - cb->cb_strlen;
+    va_start(ap, format);
+    len = vsnprintf(cb->cb_buffer+cb->cb_strlen, avail, format, ap);
     va_end(ap);
-    cb->cb_strlen += ret;
+    if (len < 0)
+	goto fail;
+    if ((size_t)len >= avail){ /* Truncated, grow and format again */
+	if (cbuf_realloc(cb, len) < 0)
+	    goto fail;
+	va_start(ap, format);
+	len = vsnprintf(cb->cb_buffer+cb->cb_strlen, /* str */
+			cb->cb_buflen-cb->cb_strlen, /* size */
+			format, ap);
+	va_end(ap);
+	if (len < 0)
+	    goto fail;
+    }
+    cb->cb_strlen += len;
  ok:
     retval = 0;
  done:
     return retval;
+ fail:
+    if (cb->cb_buffer)
+	cb->cb_buffer[cb->cb_strlen] = '\0'; /* Remove truncated output */
+    goto done;
 }
 
 /*! Append a string to a cbuf
@@ -283,9 +491,9 @@ cbuf_append_str(cbuf       *cb,
     len0 = strlen(str);
     len = cb->cb_strlen + len0;
     /* Ensure buffer is large enough */
-    if (cbuf_realloc(cb, len) < 0)
+    if (cbuf_realloc(cb, len0) < 0)
 	return -1;
-    strncpy(cb->cb_buffer+cb->cb_strlen, str, len0+1);
+    memcpy(cb->cb_buffer+cb->cb_strlen, str, len0+1);
     cb->cb_strlen = len;
     return 0;
 }
@@ -333,7 +541,7 @@ cbuf_append_buf(cbuf  *cb,
     len0 = cb->cb_strlen;
     len = cb->cb_strlen + n;
     /* Ensure buffer is large enough */
-    if (cbuf_realloc(cb, len+1) < 0)
+    if (cbuf_realloc(cb, n) < 0)
 	return -1;
     memcpy(cb->cb_buffer+len0, src, n);
     cb->cb_buffer[len] = '\0'; /* Add a null byte */
@@ -48,17 +48,25 @@
 #define _CLIGEN_BUF_H
 
 #include <stdarg.h> 
+#include <stdint.h>
+#include <stdint.h>
 
 /*
  * Types
  */
 typedef struct cbuf cbuf; /* cligen buffer type is fully defined in c-file */
+typedef struct cbuf_pool cbuf_pool; /* Free cbufs, see cbuf_pool_set */
 
 /*
  * Prototypes
  */
 int      cbuf_alloc_get(size_t *start, size_t *threshold);
 int      cbuf_alloc_set(size_t start, size_t threshold);
+cbuf_pool *cbuf_pool_new(void);
+int      cbuf_pool_free(cbuf_pool *cp);
+int      cbuf_pool_set(cbuf_pool *cp);
+cbuf_pool *cbuf_pool_get(void);
+int      cbuf_pool_stats(cbuf_pool *cp, uint64_t *reused, uint64_t *allocated);
 cbuf    *cbuf_new(void);
 cbuf    *cbuf_new_alloc(size_t sz);
 
@@ -76,5 +84,7 @@ int      cbuf_append(cbuf *cb, int c);
 int      cbuf_append_str(cbuf *cb, char *str);
 int      cbuf_append_buf(cbuf *cb, void *src, size_t n);
 int      cbuf_trunc(cbuf *cb, size_t i);
+char    *cbuf_reserve(cbuf *cb, size_t n);
+int      cbuf_commit(cbuf *cb, size_t n);
 
 #endif /* _CLIGEN_BUF_H */
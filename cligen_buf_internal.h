@@ -38,6 +38,12 @@
 #ifndef _CLIGEN_BUF_INTERNAL_H
 #define _CLIGEN_BUF_INTERNAL_H
 
+/*
+ * Constants
+ */
+/* Max free cbufs kept by a pool, see cbuf_pool_set */
+#define CBUF_POOL_MAX 16
+
 /*
  * Types
  */
@@ -49,4 +55,15 @@ struct cbuf {
     size_t cb_strlen;   /* length of string in buffer (< buflen) */
 };
 
+/*! Pool of free cbufs keeping their buffers, see cbuf_pool_set
+ */
+struct cbuf_pool {
+    cbuf    *cp_free[CBUF_POOL_MAX]; /* Free cbufs */
+    int      cp_len;       /* Number of free cbufs */
+    uint64_t cp_reused;    /* Cbufs taken from pool */
+    uint64_t cp_allocated; /* Cbufs allocated while pool was bound */
+    size_t   cp_start;     /* Initial size of cbuf_new, see cbuf_alloc_set */
+    size_t   cp_threshold; /* Threshold of linear growth, see cbuf_alloc_set */
+};
+
 #endif /* _CLIGEN_BUF_INTERNAL_H */
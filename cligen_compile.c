@@ -0,0 +1,670 @@
+/*
+  CLI generator compiled matcher
+
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+
+  Compiled matcher of command lines, enabled with cligen_compile_set.
+  Each level of a parse-tree is compiled into a state with a table of keyword transitions,
+  sorted for binary search, and a table of variable transitions, sorted by preference.
+  Variable transitions are matched with cv_parse1/cv_validate as in match_pattern.
+  States are compiled on first use, so only the paths of lines actually parsed, including
+  their expanded tree references, are compiled.
+  The matcher only decides lines that match uniquely. Levels with sets, expand or choice
+  variables, rest variables or unexpanded tree references, and all lines that do not
+  match, are left to match_pattern_exact, which gives the same result and error reason.
+*/
+
+#include "cligen_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "cligen_buf.h"
+#include "cligen_cv.h"
+#include "cligen_cvec.h"
+#include "cligen_parsetree.h"
+#include "cligen_pt_head.h"
+#include "cligen_object.h"
+#include "cligen_handle.h"
+#include "cligen_expand.h"
+#include "cligen_match.h"
+#include "cligen_stats.h"
+#include "cligen_compile.h"
+
+/*
+ * Constants
+ */
+#define CSTATE_NONE     -1   /* Transition: child state not compiled yet */
+#define CSTATE_LEAF     -2   /* Transition: object has no children */
+
+#define CSTATE_TERMINAL 0x01 /* State: a line may end before it (empty child) */
+#define CSTATE_FALLBACK 0x02 /* State: not compiled, match with match_pattern_exact */
+
+#define CTRANS_COMPLETE 0x01 /* Transition: a line may end with its object */
+
+/*
+ * Types
+ */
+/* Transition of a state, a keyword or a variable of a parse-tree level */
+struct ctrans{
+    cg_obj     *ct_co;    /* Object in the (treeref-expanded) parse-tree */
+    char       *ct_key;   /* Keyword, or NULL for variables */
+    uint32_t    ct_len;   /* Length of keyword */
+    uint32_t    ct_uniq;  /* Shortest unique prefix of keyword, or 0 if not known */
+    int32_t     ct_pref;  /* Preference of variable, see co_pref */
+    int32_t     ct_next;  /* State of children, or CSTATE_NONE, CSTATE_LEAF */
+    uint32_t    ct_flags; /* CTRANS_COMPLETE */
+};
+
+/* State of a compiled level */
+struct cstate{
+    parse_tree *cs_pt;    /* Parse-tree level */
+    uint32_t    cs_trans; /* First transition in ct_trans */
+    uint32_t    cs_nkey;  /* Keywords, sorted by keyword */
+    uint32_t    cs_nvar;  /* Variables after keywords, by decreasing preference */
+    uint32_t    cs_flags; /* CSTATE_TERMINAL, CSTATE_FALLBACK */
+};
+
+struct cligen_ctab{
+    struct cstate *ct_states;   /* Compiled states */
+    size_t         ct_nstates;
+    size_t         ct_maxstates;
+    struct ctrans *ct_trans;    /* Transitions of all states */
+    size_t         ct_ntrans;
+    size_t         ct_maxtrans;
+    int32_t       *ct_index;    /* Hash index of states by parse-tree, -1 if empty slot */
+    size_t         ct_slots;    /* Slots of ct_index, power of two */
+    struct ctrans **ct_path;    /* Matched transition per token, reused between lines */
+    int            ct_pathlen;  /* Allocated length of ct_path */
+    uint64_t       ct_hits;     /* Lines decided by the compiled matcher */
+    uint64_t       ct_misses;   /* Lines left to match_pattern_exact */
+};
+
+/*! Create a compiled table
+ * @retval  ct    Compiled table, free with cligen_ctab_free
+ * @retval  NULL  Error
+ */
+cligen_ctab *
+cligen_ctab_new(void)
+{
+    cligen_ctab *ct;
+
+    if ((ct = malloc(sizeof(*ct))) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	return NULL;
+    }
+    memset(ct, 0, sizeof(*ct));
+    ct->ct_slots = CLIGEN_COMPILE_SLOTS;
+    if ((ct->ct_index = malloc(ct->ct_slots*sizeof(int32_t))) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	free(ct);
+	return NULL;
+    }
+    memset(ct->ct_index, 0xff, ct->ct_slots*sizeof(int32_t)); /* -1 */
+    return ct;
+}
+
+/*! Remove all states of a compiled table, keep counters and allocated space
+ */
+static void
+ctab_reset(cligen_ctab *ct)
+{
+    ct->ct_nstates = 0;
+    ct->ct_ntrans = 0;
+    memset(ct->ct_index, 0xff, ct->ct_slots*sizeof(int32_t));
+}
+
+/*! Free a compiled table
+ * @param[in]  ct   Compiled table
+ */
+int
+cligen_ctab_free(cligen_ctab *ct)
+{
+    if (ct == NULL)
+	return 0;
+    if (ct->ct_states)
+	free(ct->ct_states);
+    if (ct->ct_trans)
+	free(ct->ct_trans);
+    if (ct->ct_index)
+	free(ct->ct_index);
+    if (ct->ct_path)
+	free(ct->ct_path);
+    free(ct);
+    return 0;
+}
+
+/*! Hash of a parse-tree pointer
+ */
+static inline size_t
+ctab_hash(parse_tree *pt)
+{
+    uint64_t k = (uint64_t)(uintptr_t)pt;
+
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    return (size_t)k;
+}
+
+/*! Find slot of the state of a parse-tree level, or empty slot where it should be added
+ */
+static int32_t *
+ctab_slot(cligen_ctab *ct,
+	  parse_tree  *pt)
+{
+    size_t   j;
+    int32_t *slot;
+
+    j = ctab_hash(pt) & (ct->ct_slots-1);
+    while (*(slot = &ct->ct_index[j]) != -1){
+	if (ct->ct_states[*slot].cs_pt == pt)
+	    break;
+	j = (j+1) & (ct->ct_slots-1);
+    }
+    return slot;
+}
+
+/*! Double the state index and rehash
+ */
+static int
+ctab_grow(cligen_ctab *ct)
+{
+    size_t i;
+
+    if ((ct->ct_index = realloc(ct->ct_index, 2*ct->ct_slots*sizeof(int32_t))) == NULL){
+	fprintf(stderr, "%s: realloc: %s\n", __FUNCTION__, strerror(errno));
+	return -1;
+    }
+    ct->ct_slots *= 2;
+    memset(ct->ct_index, 0xff, ct->ct_slots*sizeof(int32_t));
+    for (i=0; i<ct->ct_nstates; i++)
+	*ctab_slot(ct, ct->ct_states[i].cs_pt) = i;
+    return 0;
+}
+
+/*! Reserve space for n more transitions
+ */
+static int
+ctab_trans_reserve(cligen_ctab *ct,
+		   size_t       n)
+{
+    size_t max;
+    
+    if (ct->ct_ntrans + n <= ct->ct_maxtrans)
+	return 0;
+    max = ct->ct_maxtrans ? ct->ct_maxtrans : 64;
+    while (max < ct->ct_ntrans + n)
+	max *= 2;
+    if ((ct->ct_trans = realloc(ct->ct_trans, max*sizeof(struct ctrans))) == NULL){
+	fprintf(stderr, "%s: realloc: %s\n", __FUNCTION__, strerror(errno));
+	return -1;
+    }
+    ct->ct_maxtrans = max;
+    return 0;
+}
+
+/*! Sort keywords by keyword */
+static int
+ctrans_key_cmp(const void *a,
+	       const void *b)
+{
+    return strcmp(((struct ctrans *)a)->ct_key, ((struct ctrans *)b)->ct_key);
+}
+
+/*! Sort variables by decreasing preference, then by position in the level */
+static int
+ctrans_pref_cmp(const void *a,
+		const void *b)
+{
+    const struct ctrans *ta = a;
+    const struct ctrans *tb = b;
+
+    if (ta->ct_pref != tb->ct_pref)
+	return tb->ct_pref - ta->ct_pref;
+    return ta->ct_next - tb->ct_next; /* position, before ct_next is set */
+}
+
+/*! Check if a line may end with an object, as in match_pattern_exact
+ * @retval  1  No children, or an empty child
+ * @retval  0  Incomplete command
+ */
+static int
+co_complete(cg_obj *co)
+{
+    parse_tree *ptc;
+    cg_obj     *co1;
+    int         i;
+
+    if ((ptc = co_pt_get(co)) == NULL || pt_len_get(ptc) == 0)
+	return 1;
+    for (i=0; i<pt_len_get(ptc); i++)
+	if ((co1 = pt_vec_i_get(ptc, i)) == NULL || co1->co_type == CO_EMPTY)
+	    return 1;
+    return 0;
+}
+
+/*! Check if a level can be compiled, and count its keywords and variables
+ * @retval  1  Level can be compiled
+ * @retval  0  Level is matched with match_pattern_exact
+ */
+static int
+ctab_compilable(parse_tree *pt,
+		int        *nkey,
+		int        *nvar,
+		int        *terminal)
+{
+    int     i;
+    cg_obj *co;
+
+    *nkey = *nvar = *terminal = 0;
+    if (pt_sets_get(pt))
+	return 0;
+    for (i=0; i<pt_len_get(pt); i++){
+	if ((co = pt_vec_i_get(pt, i)) == NULL){
+	    *terminal = 1;
+	    continue;
+	}
+	switch (co->co_type){
+	case CO_EMPTY:
+	    *terminal = 1;
+	    break;
+	case CO_REFERENCE: /* An expanded reference never matches */
+	    if (!co_flags_get(co, CO_FLAGS_REFDONE))
+		return 0;
+	    break;
+	case CO_COMMAND:
+	    if (co->co_command == NULL || *co->co_command == '\0' ||
+		*co->co_command == '\"') /* escaped */
+		return 0;
+	    (*nkey)++;
+	    break;
+	case CO_VARIABLE:
+	    if (co->co_choice != NULL ||
+		co->co_expand_fn_str != NULL || co->co_expandv_fn != NULL)
+		return 0;
+	    /* Prefix matches of keywords have preference 3, see co_pref */
+	    if (co_pref(co, 0) <= 3)
+		return 0;
+	    (*nvar)++;
+	    break;
+	}
+    }
+    return 1;
+}
+
+/*! Compile a parse-tree level into a state, or get the state if already compiled
+ *
+ * Tree references of the level are expanded in place first, as when matching.
+ * @param[in]  h     CLIgen handle
+ * @param[in]  ct    Compiled table
+ * @param[in]  co0   Parent of level, or NULL
+ * @param[in]  pt    Parse-tree level
+ * @retval     s     State index
+ * @retval    -1     Error
+ */
+static int32_t
+ctab_state(cligen_handle h,
+	   cligen_ctab  *ct,
+	   cg_obj       *co0,
+	   parse_tree   *pt)
+{
+    int32_t       *slot;
+    struct cstate *cs;
+    struct ctrans *t;
+    cg_obj        *co;
+    int            nkey;
+    int            nvar;
+    int            terminal;
+    int            i;
+    int            k;
+    int            v;
+    size_t         max;
+
+    slot = ctab_slot(ct, pt);
+    if (*slot != -1)
+	return *slot;
+    if (pt_expand_treeref(h, co0, pt) < 0)
+	return -1;
+    if (ct->ct_nstates == ct->ct_maxstates){
+	max = ct->ct_maxstates ? 2*ct->ct_maxstates : 64;
+	if ((ct->ct_states = realloc(ct->ct_states, max*sizeof(struct cstate))) == NULL){
+	    fprintf(stderr, "%s: realloc: %s\n", __FUNCTION__, strerror(errno));
+	    return -1;
+	}
+	ct->ct_maxstates = max;
+    }
+    cs = &ct->ct_states[ct->ct_nstates];
+    memset(cs, 0, sizeof(*cs));
+    cs->cs_pt = pt;
+    cs->cs_trans = ct->ct_ntrans;
+    if (ctab_compilable(pt, &nkey, &nvar, &terminal) == 0)
+	cs->cs_flags |= CSTATE_FALLBACK;
+    else {
+	if (terminal)
+	    cs->cs_flags |= CSTATE_TERMINAL;
+	if (ctab_trans_reserve(ct, nkey + nvar) < 0)
+	    return -1;
+	k = 0;
+	v = nkey;
+	for (i=0; i<pt_len_get(pt); i++){
+	    if ((co = pt_vec_i_get(pt, i)) == NULL)
+		continue;
+	    if (co->co_type == CO_COMMAND)
+		t = &ct->ct_trans[cs->cs_trans + k++];
+	    else if (co->co_type == CO_VARIABLE)
+		t = &ct->ct_trans[cs->cs_trans + v++];
+	    else
+		continue;
+	    memset(t, 0, sizeof(*t));
+	    t->ct_co = co;
+	    if (co->co_type == CO_COMMAND){
+		t->ct_key = co->co_command;
+		if (co_flags_get(co, CO_FLAGS_META)){
+		    t->ct_len = co->co_mlen;
+		    if (pt_uniq_get(pt))
+			t->ct_uniq = co->co_muniq;
+		}
+		else
+		    t->ct_len = strlen(co->co_command);
+	    }
+	    else{
+		t->ct_pref = co_pref(co, 0);
+		t->ct_next = i; /* position, for sorting */
+	    }
+	    if (co_complete(co))
+		t->ct_flags |= CTRANS_COMPLETE;
+	}
+	t = &ct->ct_trans[cs->cs_trans];
+	qsort(t, nkey, sizeof(*t), ctrans_key_cmp);
+	qsort(t + nkey, nvar, sizeof(*t), ctrans_pref_cmp);
+	/* Equal keywords match the same tokens */
+	for (k=1; k<nkey; k++)
+	    if (strcmp(t[k-1].ct_key, t[k].ct_key) == 0)
+		break;
+	if (k < nkey)
+	    cs->cs_flags |= CSTATE_FALLBACK;
+	else {
+	    for (k=0; k<nkey+nvar; k++)
+		t[k].ct_next = pt_len_get(co_pt_get(t[k].ct_co)) ? CSTATE_NONE : CSTATE_LEAF;
+	    cs->cs_nkey = nkey;
+	    cs->cs_nvar = nvar;
+	    ct->ct_ntrans += nkey + nvar;
+	}
+    }
+    *slot = ct->ct_nstates++;
+    /* Keep load factor below 1/2 */
+    if (ct->ct_nstates*2 > ct->ct_slots && ctab_grow(ct) < 0)
+	return -1;
+    return ct->ct_nstates - 1;
+}
+
+/*! Find the transition of a token in a state, as match_vec with best set
+ *
+ * An exact keyword is preferred to all variables, which are preferred to keywords that
+ * only have the token as prefix, see co_pref.
+ * @param[in]  h     CLIgen handle
+ * @param[in]  ct    Compiled table
+ * @param[in]  cs    State
+ * @param[in]  token Token
+ * @param[in]  len   Length of token
+ * @param[out] tp    Unique transition
+ * @retval     1     Unique match, see tp
+ * @retval     0     No match or several, left to match_pattern_exact
+ * @retval    -1     Error
+ */
+static int
+cstate_match(cligen_handle   h,
+	     cligen_ctab    *ct,
+	     struct cstate  *cs,
+	     char           *token,
+	     size_t          len,
+	     struct ctrans **tp)
+{
+    struct ctrans *t = &ct->ct_trans[cs->cs_trans];
+    struct ctrans *tv;
+    int            lo = 0;
+    int            hi = cs->cs_nkey;
+    int            mid;
+    int            i;
+    int            j;
+    int            ret;
+
+    /* Lower bound of token among keywords */
+    while (lo < hi){
+	mid = (lo + hi)/2;
+	if (strcmp(t[mid].ct_key, token) < 0)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    if (lo < cs->cs_nkey && t[lo].ct_len == len && memcmp(t[lo].ct_key, token, len) == 0){
+	*tp = &t[lo];
+	return 1;
+    }
+    /* Variables by decreasing preference, the first match is unique unless another
+     * variable of the same preference also matches */
+    tv = t + cs->cs_nkey;
+    for (i=0; i<cs->cs_nvar; i++){
+	if ((ret = match_variable(h, tv[i].ct_co, token, NULL)) < 0)
+	    return -1;
+	if (ret == 0)
+	    continue;
+	for (j=i+1; j<cs->cs_nvar && tv[j].ct_pref == tv[i].ct_pref; j++){
+	    if ((ret = match_variable(h, tv[j].ct_co, token, NULL)) < 0)
+		return -1;
+	    if (ret == 1)
+		return 0;
+	}
+	*tp = &tv[i];
+	return 1;
+    }
+    /* Unique keyword with token as prefix. Keywords before lo are less than token, so
+     * with metadata only the length of token is compared */
+    if (lo < cs->cs_nkey && strncmp(t[lo].ct_key, token, len) == 0 &&
+	(t[lo].ct_uniq ? len >= t[lo].ct_uniq :
+	 (lo+1 == cs->cs_nkey || strncmp(t[lo+1].ct_key, token, len) != 0))){
+	*tp = &t[lo];
+	return 1;
+    }
+    return 0;
+}
+
+/*! Bind variables and keywords of a matched line to a variable vector, as match_bindvars
+ */
+static int
+ctab_bind(cligen_handle        h,
+	  struct cligen_tokens *tk,
+	  struct ctrans       **path,
+	  int                   n,
+	  cvec                 *cvvall)
+{
+    int     i;
+    cg_obj *co;
+    cg_var *cv;
+
+    for (i=0; i<n; i++){
+	co = path[i]->ct_co;
+	if (co->co_type == CO_VARIABLE){
+	    if (add_cov_to_cvec(h, co, tk->tk_vec[i].ct_str, cvvall) == NULL)
+		return -1;
+	}
+	else if (!cv_exclude_keys_get()){
+	    if ((cv = cvec_add(cvvall, CGV_STRING)) == NULL)
+		return -1;
+	    cv_name_set(cv, co->co_command);
+	    cv_string_set(cv, co->co_command);
+	    cv_const_set(cv, 1);
+	}
+    }
+    return 0;
+}
+
+/*! Match a tokenized line with the compiled table of the handle
+ *
+ * Called by cliread_parse before match_pattern_exact, with tree references of pt
+ * expanded. If the line matches uniquely, variables and keywords are bound to cvvall and
+ * the matched object is returned, as by match_pattern_exact. Otherwise the line is left
+ * to match_pattern_exact, which decides it with the same result and error reason.
+ * @param[in]  h        CLIgen handle
+ * @param[in]  pt       Parse-tree
+ * @param[in]  tk       Tokenized line
+ * @param[out] cvvall   Variables and keywords of the line, if matched
+ * @param[out] co_orig  Matched object, if matched
+ * @param[out] result   CG_MATCH, if matched
+ * @retval     1        Matched
+ * @retval     0        Not decided, match with match_pattern_exact
+ * @retval    -1        Error
+ * @see cligen_compile_set
+ */
+int
+cligen_compile_match(cligen_handle         h,
+		     parse_tree           *pt,
+		     struct cligen_tokens *tk,
+		     cvec                 *cvvall,
+		     cg_obj              **co_orig,
+		     cligen_result        *result)
+{
+    int            retval = -1;
+    cligen_ctab   *ct;
+    struct cstate *cs;
+    struct ctrans *t = NULL;
+    int32_t        s;
+    int            levels;
+    int            i;
+    int            ret;
+    uint64_t       t0;
+
+    if ((ct = cligen_compile_table(h)) == NULL || !cligen_treeref_cache(h))
+	return 0;
+    t0 = cligen_stats_start(h);
+    if ((levels = cligen_tokens_levels(tk)) < 0)
+	goto miss;
+    if (tk->tk_len > ct->ct_pathlen){
+	if ((ct->ct_path = realloc(ct->ct_path, tk->tk_len*sizeof(struct ctrans *))) == NULL){
+	    fprintf(stderr, "%s: realloc: %s\n", __FUNCTION__, strerror(errno));
+	    goto done;
+	}
+	ct->ct_pathlen = tk->tk_len;
+    }
+    if ((s = ctab_state(h, ct, NULL, pt)) < 0)
+	goto done;
+    for (i=0; i<=levels; i++){
+	cs = &ct->ct_states[s];
+	if (cs->cs_flags & CSTATE_FALLBACK || tk->tk_vec[i].ct_len == 0)
+	    goto miss;
+	if ((ret = cstate_match(h, ct, cs, tk->tk_vec[i].ct_str, tk->tk_vec[i].ct_len, &t)) < 0)
+	    goto done;
+	if (ret == 0)
+	    goto miss;
+	ct->ct_path[i] = t;
+	if (i == levels)
+	    break;
+	if (t->ct_next == CSTATE_LEAF) /* More tokens than levels */
+	    goto miss;
+	if (t->ct_next == CSTATE_NONE){
+	    /* Compiling may move transitions */
+	    int j = t - ct->ct_trans;
+	    if ((s = ctab_state(h, ct, t->ct_co, co_pt_get(t->ct_co))) < 0)
+		goto done;
+	    t = &ct->ct_trans[j];
+	    t->ct_next = s;
+	    ct->ct_path[i] = t;
+	}
+	s = t->ct_next;
+    }
+    if ((t->ct_flags & CTRANS_COMPLETE) == 0) /* Incomplete command */
+	goto miss;
+    /* Paths are pointers into ct_trans, which is not moved after the walk */
+    if (ctab_bind(h, tk, ct->ct_path, levels+1, cvvall) < 0)
+	goto done;
+    *co_orig = t->ct_co;
+    *result = CG_MATCH;
+    ct->ct_hits++;
+    retval = 1;
+    goto done;
+ miss:
+    ct->ct_misses++;
+    retval = 0;
+ done:
+    cligen_stats_stop(h, CLIGEN_STAT_MATCH, t0);
+    return retval;
+}
+
+/*! Remove all compiled states of the handle, they are compiled again on next use
+ *
+ * Called when cached tree references are flushed. An application that modifies a
+ * parse-tree in place needs to call it, or cligen_treeref_cache_invalidate.
+ * @param[in] h      CLIgen handle
+ * @retval    0      OK
+ */
+int
+cligen_compile_invalidate(cligen_handle h)
+{
+    cligen_ctab *ct;
+
+    if ((ct = cligen_compile_table(h)) != NULL)
+	ctab_reset(ct);
+    return 0;
+}
+
+/*! Get counters of the compiled matcher of a handle
+ * @param[in]  h       CLIgen handle
+ * @param[out] states  Number of compiled states (levels)
+ * @param[out] hits    Lines matched by the compiled matcher
+ * @param[out] misses  Lines left to match_pattern_exact
+ * @retval     0       OK
+ * @retval    -1       Compiled matcher not enabled
+ */
+int
+cligen_compile_stats(cligen_handle h,
+		     uint64_t     *states,
+		     uint64_t     *hits,
+		     uint64_t     *misses)
+{
+    cligen_ctab *ct;
+
+    if ((ct = cligen_compile_table(h)) == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    if (states)
+	*states = ct->ct_nstates;
+    if (hits)
+	*hits = ct->ct_hits;
+    if (misses)
+	*misses = ct->ct_misses;
+    return 0;
+}
@@ -0,0 +1,65 @@
+/*
+  CLI generator compiled matcher
+
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+
+  This file includes a compiled matcher of command lines, a state machine of keyword
+  and variable transitions built from a parse-tree
+*/
+
+#ifndef _CLIGEN_COMPILE_H_
+#define _CLIGEN_COMPILE_H_
+
+/*
+ * Constants
+ */
+/* Initial number of slots in the state index of a compiled table, power of two */
+#define CLIGEN_COMPILE_SLOTS 64
+
+/*
+ * Types
+ */
+typedef struct cligen_ctab cligen_ctab; /* struct defined internally in cligen_compile.c */
+
+struct cligen_tokens; /* Tokenized command line, see cligen_str2tokens */
+
+/*
+ * Prototypes
+ */
+cligen_ctab *cligen_ctab_new(void);
+int          cligen_ctab_free(cligen_ctab *ct);
+int          cligen_compile_invalidate(cligen_handle h);
+int          cligen_compile_stats(cligen_handle h, uint64_t *states, uint64_t *hits, uint64_t *misses);
+int          cligen_compile_match(cligen_handle h, parse_tree *pt, struct cligen_tokens *tk,
+				  cvec *cvvall, cg_obj **co_orig, cligen_result *result);
+
+#endif /* _CLIGEN_COMPILE_H_ */
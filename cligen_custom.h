@@ -38,3 +38,9 @@ typedef struct {int a;} *cligen_handle;
 #else
 typedef void *cligen_handle; /* API */
 #endif
+
+/* Per-phase counters and timers, see cligen_stats_set. Build with -DCLIGEN_STATS=0 to
+ * compile out the instrumentation */
+#ifndef CLIGEN_STATS
+#define CLIGEN_STATS 1
+#endif
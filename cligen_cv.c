@@ -64,6 +64,7 @@
 #include "cligen_match.h"
 #include "cligen_regex.h"
 #include "cligen_getline.h"
+#include "cligen_stats.h"
 
 #include "cligen_cv_internal.h"
 /*
@@ -907,6 +908,48 @@ cv_urlpasswd_set(cg_var *cv,
     return s1; 
 }
 
+/*! Parse a plain decimal number in one pass, as strtoull would
+ *
+ * Common case of cv_parse1: no white space, plus sign, base prefix or octal leading
+ * zero, and few enough digits not to overflow. Other strings are left to strtoll or
+ * strtoull, except strings that cannot be numbers in any base.
+ * @param[in]  str   String after an optional minus sign
+ * @param[in]  base  Base as given to parse_int64_base, only 0 and 10 are handled
+ * @param[out] u     Value
+ * @retval     1     Decimal number, value in u
+ * @retval     0     Not handled, use strtoll or strtoull
+ * @retval    -1     Not a number
+ */
+static inline int
+parse_dec_fast(const char *str,
+	       int         base,
+	       uint64_t   *u)
+{
+    uint64_t v = 0;
+    int      n = 0;
+    
+    if (base != 0 && base != 10)
+	return 0;
+    if (str[0] == '0' && str[1] != '\0' && base == 0) /* octal or hex */
+	return 0;
+    while (str[n] >= '0' && str[n] <= '9'){
+	if (n == 18) /* 19 digits may overflow */
+	    return 0;
+	v = v*10 + (str[n] - '0');
+	n++;
+    }
+    if (str[n] != '\0'){
+	/* strtoll skips white space and a plus sign, and stops at other characters */
+	if (n == 0 && (str[0] == '+' || isspace((unsigned char)str[0])))
+	    return 0;
+	return -1;
+    }
+    if (n == 0) /* empty */
+	return -1;
+    *u = v;
+    return 1;
+}
+
 /*! Parse an int64 number with explicit base and check for errors
  * @param[in]  str     String containing number to parse
  * @parame[in] base    If base is 0 or 16, the string may include a "0x" prefix,
@@ -929,12 +972,26 @@ parse_int64_base(char    *str,
 		 int64_t *val,
 		 char   **reason)
 {
-    int64_t i;
+    int64_t  i = 0;
+    uint64_t u;
     char    *ep;
+    int      neg;
+    int      ret;
     int      retval = -1;
 
+    neg = (str[0] == '-');
+    if ((ret = parse_dec_fast(str + neg, base, &u)) == 1){
+	i = neg ? -(int64_t)u : (int64_t)u;
+	if (i < imin || i > imax)
+	    goto range;
+	*val = i;
+	return 1;
+    }
     errno = 0;
-    i = strtoll(str, &ep, base);
+    if (ret < 0)
+	ep = str; /* not a number */
+    else
+	i = strtoll(str, &ep, base);
     if (str[0] == '\0' || *ep != '\0'){
 	if (reason != NULL)
 	    if ((*reason = cligen_reason("'%s' is not a number", str)) == NULL){
@@ -956,15 +1013,17 @@ parse_int64_base(char    *str,
 	    goto done;
 	}
 	else{
-	    if ((*reason = cligen_reason("%s: %s", str, strerror(errno))) == NULL){
-		errno = 0;
-		retval = -1;
-		goto done;
-	    }
+	    if (reason != NULL)
+		if ((*reason = cligen_reason("%s: %s", str, strerror(errno))) == NULL){
+		    errno = 0;
+		    retval = -1;
+		    goto done;
+		}
 	}
 	errno = 0;
     } /* if errno */
     else if (i < imin || i > imax){
+    range:
 	if (reason != NULL)
 	    if ((*reason = cligen_reason("Number %s out of range: %" PRId64 " - %" PRId64, str, imin, imax)) == NULL){
 		retval = -1;
@@ -1087,12 +1146,23 @@ parse_uint64_base(char     *str,
 		  uint64_t *val, 
 		  char    **reason)
 {
-    uint64_t i;
+    uint64_t i = 0;
     char    *ep;
+    int      ret;
     int      retval = -1;
 
+    /* A minus sign is left to strtoull, see note */
+    if ((ret = parse_dec_fast(str, base, &i)) == 1){
+	if (i > umax)
+	    goto range;
+	*val = i;
+	return 1;
+    }
     errno = 0;
-    i = strtoull(str, &ep, base);
+    if (ret < 0 && str[0] != '-')
+	ep = str; /* not a number */
+    else
+	i = strtoull(str, &ep, base);
     if (str[0] == '\0' || *ep != '\0'){
 	if (reason != NULL)
 	    if ((*reason = cligen_reason("'%s' is not a number", str)) == NULL){
@@ -1113,15 +1183,17 @@ parse_uint64_base(char     *str,
 	    goto done;
 	}
 	else{
-	    if ((*reason = cligen_reason("%s: %s", str, strerror(errno))) == NULL){
-		retval = -1; /* malloc */
-		goto done;
-	    }
+	    if (reason != NULL)
+		if ((*reason = cligen_reason("%s: %s", str, strerror(errno))) == NULL){
+		    retval = -1; /* malloc */
+		    goto done;
+		}
 	    retval = 0;
 	    goto done;
 	}
     }
     else if (i > umax){
+    range:
 	if (reason != NULL)
 	    if ((*reason = cligen_reason("Number %s out of range: %" PRIu64 " - %" PRIu64, str, umin, umax)) == NULL){
 		retval = -1;
@@ -1248,10 +1320,10 @@ parse_dec64(char    *str,
 	    char   **reason)
 {
     int      retval = 1;
-    char    *s0 = NULL; /* the whole string, eg aaa.bbb*/
-    char    *s1;        /* the first part (eg aaa)  */
     char    *s2;        /* the second part (eg bbb)  */
     char    *ss = NULL; /* Help string */
+    char     buf[64];   /* Help string if short enough, no allocation */
+    size_t   len;
     int      len1;
     int      len2 = 0;
     int      i;
@@ -1273,18 +1345,18 @@ parse_dec64(char    *str,
 	retval = 0;
 	goto done;
     }
-    if ((s0 = strdup(str)) == NULL){
-	retval = -1; /* malloc */
-	goto done;
-    }
-    s2 = s0;
-    s1 = strsep(&s2, ".");
-    len1 = strlen(s1);
-    if ((ss = malloc(strlen(str)+n+2)) == NULL){
+    len = strlen(str);
+    if ((s2 = strchr(str, '.')) != NULL)
+	len1 = s2++ - str;
+    else
+	len1 = len;
+    if (len+n+2 <= sizeof(buf))
+	ss = buf;
+    else if ((ss = malloc(len+n+2)) == NULL){
 	retval = -1; /* malloc */
 	goto done;
     }
-    memcpy(ss, s1, len1);
+    memcpy(ss, str, len1);
 
     /*
      *     | s1 |.| s2 |
@@ -1314,9 +1386,7 @@ parse_dec64(char    *str,
     if ((retval = parse_int64_base(ss, 10, INT64_MIN, INT64_MAX, dec64_i, reason)) != 1)
 	goto done;
   done:
-    if (s0)
-	free(s0);
-    if (ss)
+    if (ss && ss != buf)
 	free(ss);
     return retval;
 }
@@ -1367,6 +1437,46 @@ parse_bool(char    *str,
     return retval;
 }
 
+/*! Convert a dotted-quad IPv4 address in one pass, accepts the same strings as inet_pton
+ *
+ * Four decimal octets of at most 255, without leading zeros
+ * @param[in]  str   String to parse
+ * @param[out] val   IPv4 binary address in network byte order
+ * @retval     1     OK
+ * @retval     0     Not an IPv4 address
+ */
+static int
+parse_ipv4_fast(const char     *str,
+		struct in_addr *val)
+{
+    uint8_t  a[4];
+    unsigned v;
+    int      octets = 0;
+    int      digits;
+
+    for (;;){
+	v = 0;
+	for (digits=0; str[digits] >= '0' && str[digits] <= '9'; digits++){
+	    if (digits && v == 0) /* leading zero */
+		return 0;
+	    if ((v = v*10 + (str[digits] - '0')) > 255)
+		return 0;
+	}
+	if (digits == 0)
+	    return 0;
+	a[octets++] = v;
+	str += digits;
+	if (octets == 4)
+	    break;
+	if (*str++ != '.')
+	    return 0;
+    }
+    if (*str != '\0')
+	return 0;
+    memcpy(val, a, sizeof(a));
+    return 1;
+}
+
 /*! Parse an IPv4 address struct
  * @param[in]  str        String to parse
  * @param[in]  val        IPv4 binary address
@@ -1382,7 +1492,7 @@ parse_ipv4addr(char           *str,
 {
     int retval = -1;
 
-    if ((retval = inet_pton(AF_INET, str, val)) < 0)
+    if ((retval = parse_ipv4_fast(str, val)) < 0)
 	goto done;
     if (retval == 0 && reason) 
 	if ((*reason = cligen_reason("Invalid IPv4 address")) == NULL)
@@ -1404,9 +1514,16 @@ parse_ipv6addr(char            *str,
 	       struct in6_addr *val, 
 	       char           **reason)
 {
-    int retval = -1;
+    int         retval = -1;
+    const char *s;
 
-    if ((retval = inet_pton(AF_INET6, str, val)) < 0)
+    /* Strings with other characters than hex digits, colons and dots (of an embedded
+     * IPv4 address) or without a colon are rejected by inet_pton, do not call it */
+    for (s=str; isxdigit((unsigned char)*s) || *s == ':' || *s == '.'; s++)
+	;
+    if (*s != '\0' || s - str > INET6_ADDRSTRLEN || strchr(str, ':') == NULL)
+	retval = 0;
+    else if ((retval = inet_pton(AF_INET6, str, val)) < 0)
 	goto done;
     if (retval == 0 && reason) 
 	if ((*reason = cligen_reason("Invalid IPv6 address")) == NULL)
@@ -1416,6 +1533,20 @@ parse_ipv6addr(char            *str,
 }
 
 
+/*! Given a single hex character, return its number as int
+ */
+static int 
+toint(char c)
+{
+  if (c >= '0' && c <= '9') 
+      return      c - '0';
+  if (c >= 'A' && c <= 'F') 
+      return 10 + c - 'A';
+  if (c >= 'a' && c <= 'f') 
+      return 10 + c - 'a';
+  return -1;
+}
+
 /*! Own version of ether_aton(): 
  * parse string in colon hex notation and return a vector of chars.
  * @param[out] reason     if given, malloced err string (retval=0), needs freeing
@@ -1431,7 +1562,6 @@ parse_macaddr(char  *str,
 {
     char *s1;
     int n_colons;
-    unsigned int octets[MACADDR_OCTETS];
     int i;
 
     /*
@@ -1493,13 +1623,9 @@ parse_macaddr(char  *str,
 	return 0;
     }
 
-    sscanf(str,
-	   "%x:%02x:%02x:%02x:%02x:%02x",
-	   octets + 0, octets + 1, octets + 2,
-	   octets + 3, octets + 4, octets + 5);
-
+    /* Characters are checked above, convert each octet directly */
     for (i = 0; i < MACADDR_OCTETS; ++i) {
-	addr[i] = octets[i];
+	addr[i] = (toint(str[3*i]) << 4) | toint(str[3*i+1]);
     }
 
     return 1;	/* OK */
@@ -1612,20 +1738,6 @@ uuid2str(uuid_t u,
     return 0;
 }
 
-/*! Given a single hex character, return its number as int
- */
-static int 
-toint(char c)
-{
-  if (c >= '0' && c <= '9') 
-      return      c - '0';
-  if (c >= 'A' && c <= 'F') 
-      return 10 + c - 'A';
-  if (c >= 'a' && c <= 'f') 
-      return 10 + c - 'a';
-  return -1;
-}
-
 /*! Translate uuid ascii string to uuid binary data structure.
  * uuid string on form f47ac10b-58cc-4372-a567-0e02b2c3d479 to uuid data structure.
  * @param[in]  in    in-string is 36 bytes + null termination (37 bytes in total).
@@ -1637,50 +1749,21 @@ int
 str2uuid(char  *in, 
 	 uuid_t u)
 {
-    int i = 0, j = 0, k;
+    int i = 0, j = 0;
     int a, b;
     int retval = -1;
 
-    if (strlen(in) != 36)
-	return -1;
-    for (k=0; k<4; k++){
-	a = toint(in[j++]);  
-	b = toint(in[j++]);
-	if (a < 0 || b < 0)
-	    goto done;
-	u[i++]    = (a << 4) | b; 
-    }
-    if (in[j++] != '-')
-	goto done;
-    for (k=0; k<2; k++){
-	a = toint(in[j++]);  b = toint(in[j++]);
-	if (a < 0 || b < 0)
-	    goto done;
-	u[i++]    = (a << 4) | b; 
-    }
-    if (in[j++] != '-')
-	goto done;
-    for (k=0; k<2; k++){
-	a = toint(in[j++]);  b = toint(in[j++]);
-	if (a < 0 || b < 0)
+    /* One pass, a NUL before position 36 fails as a hex digit or dash */
+    for (i=0; i<16; i++){
+	if ((i == 4 || i == 6 || i == 8 || i == 10) && in[j++] != '-')
 	    goto done;
-	u[i++]    = (a << 4) | b; 
-    }
-    if (in[j++] != '-')
-	goto done;
-    for (k=0; k<2; k++){
-	a = toint(in[j++]);  b = toint(in[j++]);
-	if (a < 0 || b < 0)
+	a = toint(in[j++]);
+	if (a < 0)
 	    goto done;
-	u[i++]    = (a << 4) | b; 
-    }
-    if (in[j++] != '-')
-	goto done;
-    for (k=0; k<6; k++){
-	a = toint(in[j++]);  b = toint(in[j++]);
-	if (a < 0 || b < 0)
+	b = toint(in[j++]);
+	if (b < 0)
 	    goto done;
-	u[i++]    = (a << 4) | b; 
+	u[i] = (a << 4) | b; 
     }
     if (in[j] != '\0')
 	goto done;
@@ -1763,7 +1846,7 @@ str2time(char           *in,
     int        min;
     int        sec;
     int        usec = 0;
-    struct tm *tm; 
+    struct tm  tm; 
     time_t     t;
     char       frac[7];
 
@@ -1853,17 +1936,14 @@ str2time(char           *in,
     if (in[i] != '\0')
 	goto done;
   mkdate:
-    if ((tm = calloc(1, sizeof(struct tm))) == NULL){
-	fprintf(stderr, "calloc: %s\n", strerror(errno));
-	goto done;
-    }
-    tm->tm_year = year - 1900;
-    tm->tm_mon = month - 1;
-    tm->tm_mday = day;
-    tm->tm_hour = hour;
-    tm->tm_min = min;
-    tm->tm_sec = sec;
-    if ((t = mktime(tm)) < 0) 
+    memset(&tm, 0, sizeof(tm));
+    tm.tm_year = year - 1900;
+    tm.tm_mon = month - 1;
+    tm.tm_mday = day;
+    tm.tm_hour = hour;
+    tm.tm_min = min;
+    tm.tm_sec = sec;
+    if ((t = mktime(&tm)) < 0) 
 	goto done;
 #if 0 /* If I enable this, I get 1h extra when loading from file in summer.
          When parsing a timestamp such as 2013-04-03T10:50:36 from file to cv
@@ -1871,7 +1951,7 @@ str2time(char           *in,
 	 I dont know why I enabled it in the first place. That is why I make this
 	 note.
       */
-    if (tm->tm_isdst) /* Daylight savings time */
+    if (tm.tm_isdst) /* Daylight savings time */
 	t += 3600; /* add hour */
 #endif
     /* Must adjust with timezone, since mktime() assumes tm i local but it is UTC! */
@@ -1885,7 +1965,6 @@ str2time(char           *in,
 	t = t - tz.tz_minuteswest*60; 
     }
 #endif
-    free(tm);
     tv->tv_sec = t; 
     tv->tv_usec = usec;
     retval = 0;
@@ -2218,11 +2297,8 @@ int
 cv2cbuf(cg_var *cv,
 	cbuf   *cb)
 {
-    char straddr[INET6_ADDRSTRLEN];
-    char ss[64];
-    int  sslen = sizeof(ss);
-    char uuidstr[37];
-    char timestr[28];
+    char *p;
+    int   sslen = 64;
 
     switch (cv->var_type){
     case CGV_INT8:
@@ -2249,15 +2325,14 @@ cv2cbuf(cg_var *cv,
     case CGV_UINT64:
 	cprintf(cb, "%" PRIu64, cv->var_uint64);
 	break;
-    case CGV_DEC64:
-	cv_dec64_print(cv, ss, &sslen);
-	cprintf(cb, "%s", ss);
+    case CGV_DEC64: /* Printed directly into cbuf, see cbuf_reserve */
+	if ((p = cbuf_reserve(cb, sslen)) == NULL)
+	    return -1;
+	cv_dec64_print(cv, p, &sslen);
+	cbuf_commit(cb, strlen(p));
 	break;
     case CGV_BOOL:
-	if (cv->var_bool)
-	    cprintf(cb, "true");
-	else
-	    cprintf(cb, "false");
+	cbuf_append_str(cb, cv->var_bool ? "true" : "false");
 	break;
     case CGV_REST:
 	cprintf(cb, "%s", cv->var_rest);
@@ -2269,7 +2344,7 @@ cv2cbuf(cg_var *cv,
 	cprintf(cb, "%s", cv->var_interface);
 	break;
     case CGV_IPV4ADDR:
-	cprintf(cb, "%s", inet_ntoa(cv->var_ipv4addr));
+	cbuf_append_str(cb, inet_ntoa(cv->var_ipv4addr));
 	break;
     case CGV_IPV4PFX:
 	cprintf(cb, "%s/%u", 
@@ -2277,18 +2352,16 @@ cv2cbuf(cg_var *cv,
 		cv->var_ipv4masklen);
 	break;
     case CGV_IPV6ADDR:
-	if (inet_ntop(AF_INET6, &cv->var_ipv6addr, straddr, sizeof(straddr)) < 0){
-	    fprintf(stderr, "inet_ntop: %s\n", strerror(errno));
-	    return -1;
-	}
-	cprintf(cb, "%s", straddr);
-	break;
     case CGV_IPV6PFX:
-	if (inet_ntop(AF_INET6, &cv->var_ipv6addr, straddr, sizeof(straddr)) < 0){
+	if ((p = cbuf_reserve(cb, INET6_ADDRSTRLEN)) == NULL)
+	    return -1;
+	if (inet_ntop(AF_INET6, &cv->var_ipv6addr, p, INET6_ADDRSTRLEN) == NULL){
 	    fprintf(stderr, "inet_ntop: %s\n", strerror(errno));
 	    return -1;
 	}
-	cprintf(cb, "%s/%u", straddr, cv->var_ipv6masklen);
+	cbuf_commit(cb, strlen(p));
+	if (cv->var_type == CGV_IPV6PFX)
+	    cprintf(cb, "/%u", cv->var_ipv6masklen);
 	break;
     case CGV_MACADDR:
 	cprintf(cb, "%02x:%02x:%02x:%02x:%02x:%02x", 
@@ -2311,12 +2384,16 @@ cv2cbuf(cg_var *cv,
 	    );
 	break;
     case CGV_UUID:
-	uuid2str(cv->var_uuid, uuidstr, sizeof(uuidstr));
-	cprintf(cb, "%s", uuidstr);
+	if ((p = cbuf_reserve(cb, 37)) == NULL) /* 36 chars and null */
+	    return -1;
+	uuid2str(cv->var_uuid, p, 37);
+	cbuf_commit(cb, strlen(p));
 	break;
     case CGV_TIME:
-	time2str(cv->var_time, timestr, sizeof(timestr));
-	cprintf(cb, "%s", timestr);
+	if ((p = cbuf_reserve(cb, 28)) == NULL) /* ISO 8601 with usecs and null */
+	    return -1;
+	time2str(cv->var_time, p, 28);
+	cbuf_commit(cb, strlen(p));
 	break;
     case CGV_VOID: /* N/A */
     case CGV_EMPTY: 
@@ -2793,6 +2870,7 @@ cv_min_set(cg_var *cv)
  *    cv_free(cv);
  *  free(reason);
  * @endcode
+ * @note Threads: only cv and reason are written, so this function is thread-safe
  */
 int
 cv_parse1(char   *str0,
@@ -2801,6 +2879,7 @@ cv_parse1(char   *str0,
 {
     int    retval = -1;
     char  *str;
+    char  *dup = NULL; /* Copy of str0, only for types that modify it */
     char  *mask;
     int    masklen = 0;
     int    i, j;
@@ -2809,13 +2888,12 @@ cv_parse1(char   *str0,
 	fprintf(stderr, "reason must be NULL on calling\n");
 	return -1;
     }
-    if (str0 == NULL){
-	if ((str = strdup("")) == NULL)
+    str = str0 ? str0 : "";
+    if (cv->var_type == CGV_IPV4PFX || cv->var_type == CGV_IPV6PFX){
+	if ((dup = strdup(str)) == NULL)
 	    goto done;
+	str = dup;
     }
-    else
-	if ((str = strdup(str0)) == NULL)
-	goto done;
     switch (cv->var_type) {
     case CGV_INT8:
 	retval = parse_int8(str, &cv->var_int8, reason);
@@ -2848,33 +2926,29 @@ cv_parse1(char   *str0,
 	retval = parse_bool(str, &cv->var_bool, reason);
 	break;
     case CGV_REST:
-	j = 0; /* decode string, remove \<delimiters */
-	/* XXX: unsure of the sanity of the use of strlen below, is it static or does the
-	 * length change due to the loop logic? */
-	for (i=0; i<strlen(str); i++)
-	    if (str[i] != '\\')
-		str[j++] = str[i];
-	for (;j<strlen(str);j++)
-	    str[j] = '\0';
 	if (cv->var_rest)
 	    free(cv->var_rest);
 	if ((cv->var_rest = strdup(str)) == NULL)
 	    goto done;
+	/* decode string in place, remove \<delimiters */
+	for (i=j=0; cv->var_rest[i]; i++)
+	    if (cv->var_rest[i] != '\\')
+		cv->var_rest[j++] = cv->var_rest[i];
+	cv->var_rest[j] = '\0';
 	retval = 1;
 	break;
     case CGV_STRING:
-	j = 0; /* decode string, remove \<delimiters */
-	for (i=0;i<strlen(str);i++)
-	    if (str[i] != '\\')
-		str[j++] = str[i];
-	for (;j<strlen(str);j++)
-	    str[j] = '\0';
 	if (cv->var_string){
 	    free(cv->var_string);
 	    cv->var_string = NULL;
 	}
 	if ((cv->var_string = strdup(str)) == NULL)
 	    goto done;
+	/* decode string in place, remove \<delimiters */
+	for (i=j=0; cv->var_string[i]; i++)
+	    if (cv->var_string[i] != '\\')
+		cv->var_string[j++] = cv->var_string[i];
+	cv->var_string[j] = '\0';
 	retval = 1;
 	break;
     case CGV_INTERFACE:
@@ -2969,8 +3043,8 @@ cv_parse1(char   *str0,
 	break;
     } /* switch */
   done:
-    if (str)
-	free (str);
+    if (dup)
+	free(dup);
     if (reason && *reason)
 	assert(retval == 0); /* validation error only on reason */
     return retval;
@@ -3017,18 +3091,191 @@ cv_parse(char   *str,
     return 0;
 }
 
-/*! Range interval check if a number is in an interval
- * @param[in] i      The number to check if it is in an interval
- * @param[in] cvlow  cv containing lower bound
- * @param[in] cvupp  cv containing upper bound
- * @param[in] type   Numeric type string, eg "int32"
- * @retval    0      i is outside [low,upper]
- * @retval    1      i is in [low,upper]
- * @note need to use macro trick ## to fix different types
-*/
-#define range_check(i, cvlow, cvupp, type)       \
-    (((i) >= cv_##type##_get(cvlow)) && \
-     ((i) <= cv_##type##_get(cvupp)))
+/* Signed values are compiled to unsigned keys with the same order */
+#define RANGE_SIGNED(i64) ((uint64_t)(int64_t)(i64) ^ ((uint64_t)1 << 63))
+
+/*! Compiled ranges of a variable specification, sorted disjoint intervals
+ * Bounds are keys, see range_key. Binary search finds the interval of a value.
+ */
+struct cligen_ranges{
+    int       cr_len;  /* Number of intervals */
+    uint64_t *cr_vec;  /* Lower bound of interval i at 2i, upper at 2i+1 */
+};
+
+/*! Get key of a numeric cv, ordered as the values of its type
+ * @param[in]  cv    CLIgen variable, int, uint or decimal64
+ * @param[in]  type  Type of cv
+ * @retval     key   Unsigned key, signed values are biased
+ */
+static uint64_t
+range_key(cg_var      *cv,
+	  enum cv_type type)
+{
+    switch (type){
+    case CGV_INT8:
+	return RANGE_SIGNED(cv_int8_get(cv));
+    case CGV_INT16:
+	return RANGE_SIGNED(cv_int16_get(cv));
+    case CGV_INT32:
+	return RANGE_SIGNED(cv_int32_get(cv));
+    case CGV_INT64:
+    case CGV_DEC64:
+	return RANGE_SIGNED(cv_int64_get(cv));
+    case CGV_UINT8:
+	return cv_uint8_get(cv);
+    case CGV_UINT16:
+	return cv_uint16_get(cv);
+    case CGV_UINT32:
+	return cv_uint32_get(cv);
+    default:
+	return cv_uint64_get(cv);
+    }
+}
+
+/*! Help function to qsort intervals on lower bound
+ */
+static int
+range_cmp(const void *arg1,
+	  const void *arg2)
+{
+    uint64_t u1 = *(uint64_t *)arg1;
+    uint64_t u2 = *(uint64_t *)arg2;
+
+    return u1 < u2 ? -1 : u1 > u2 ? 1 : 0;
+}
+
+/*! Compile ranges of a variable specification into sorted disjoint intervals
+ *
+ * The cgs_rangecvv_low/upp bounds are kept for printing and error messages. A lower 
+ * bound of type CGV_EMPTY is the min value of the type. Overlapping and adjacent 
+ * intervals are merged. Called when a range is parsed, and otherwise on first
+ * validation, see cv_validate. Call again if the range cvecs are changed.
+ * @param[in]  cs   Variable specification
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+int
+cv_range_compile(cg_varspec *cs)
+{
+    int                   retval = -1;
+    struct cligen_ranges *cr = NULL;
+    cg_var               *cv1;
+    cg_var               *cv2;
+    uint64_t              low;
+    uint64_t              upp;
+    int                   i;
+    int                   k;
+
+    if (cs == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    if ((cr = malloc(sizeof(*cr))) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	goto done;
+    }
+    memset(cr, 0, sizeof(*cr));
+    if (cs->cgs_rangelen &&
+	(cr->cr_vec = malloc(2*cs->cgs_rangelen*sizeof(uint64_t))) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	goto done;
+    }
+    k = 0;
+    for (i=0; i<cs->cgs_rangelen; i++){
+	if ((cv1 = cvec_i(cs->cgs_rangecvv_low, i)) == NULL ||
+	    (cv2 = cvec_i(cs->cgs_rangecvv_upp, i)) == NULL)
+	    continue;
+	/* Key 0 is the min value of both signed and unsigned types */
+	low = cv_type_get(cv1) == CGV_EMPTY ? 0 : range_key(cv1, cv_type_get(cv1));
+	upp = cv_type_get(cv2) == CGV_EMPTY ? UINT64_MAX : range_key(cv2, cv_type_get(cv2));
+	if (low > upp) /* Empty interval */
+	    continue;
+	cr->cr_vec[2*k] = low;
+	cr->cr_vec[2*k+1] = upp;
+	k++;
+    }
+    if (k > 1)
+	qsort(cr->cr_vec, k, 2*sizeof(uint64_t), range_cmp);
+    /* Merge overlapping and adjacent intervals */
+    cr->cr_len = 0;
+    for (i=0; i<k; i++){
+	low = cr->cr_vec[2*i];
+	upp = cr->cr_vec[2*i+1];
+	if (cr->cr_len &&
+	    (cr->cr_vec[2*cr->cr_len-1] == UINT64_MAX ||
+	     low <= cr->cr_vec[2*cr->cr_len-1] + 1)){
+	    if (upp > cr->cr_vec[2*cr->cr_len-1])
+		cr->cr_vec[2*cr->cr_len-1] = upp;
+	    continue;
+	}
+	cr->cr_vec[2*cr->cr_len] = low;
+	cr->cr_vec[2*cr->cr_len+1] = upp;
+	cr->cr_len++;
+    }
+    if (cs->cgs_ranges)
+	cv_range_free(cs->cgs_ranges);
+    cs->cgs_ranges = cr;
+    cr = NULL;
+    retval = 0;
+ done:
+    if (cr)
+	cv_range_free(cr);
+    return retval;
+}
+
+/*! Return the alloced memory of compiled ranges
+ * @param[in]  cr   Compiled ranges, see cv_range_compile
+ */
+size_t
+cv_range_size(struct cligen_ranges *cr)
+{
+    return sizeof(*cr) + 2*cr->cr_len*sizeof(uint64_t);
+}
+
+/*! Free compiled ranges
+ * @param[in]  cr   Compiled ranges
+ */
+int
+cv_range_free(struct cligen_ranges *cr)
+{
+    if (cr == NULL)
+	return 0;
+    if (cr->cr_vec)
+	free(cr->cr_vec);
+    free(cr);
+    return 0;
+}
+
+/*! Check if a key is in any range of a variable specification
+ * @param[in]  cs    Variable specification with ranges
+ * @param[in]  key   Key of value, see range_key
+ * @retval     1     In range
+ * @retval     0     Out of range
+ * @retval    -1     Error
+ */
+static int
+range_check(cg_varspec *cs,
+	    uint64_t    key)
+{
+    struct cligen_ranges *cr;
+    int                   low = 0;
+    int                   upp;
+    int                   mid;
+
+    if (cs->cgs_ranges == NULL && cv_range_compile(cs) < 0)
+	return -1;
+    cr = cs->cgs_ranges;
+    /* Find last interval whose lower bound is <= key */
+    upp = cr->cr_len;
+    while (low < upp){
+	mid = (low + upp) / 2;
+	if (cr->cr_vec[2*mid] <= key)
+	    low = mid + 1;
+	else
+	    upp = mid;
+    }
+    return low > 0 && key <= cr->cr_vec[2*(low-1)+1];
+}
 
 /*! Error messsage for int violating ranges */
 static int
@@ -3042,6 +3289,8 @@ outofrange(cg_var     *cv0,
     cg_var *cv2;
     int     i;
 
+    if (reason == NULL) /* Only format if asked for */
+	return 0;
     if ((cb = cbuf_new()) == NULL)
 	goto done;
     cprintf(cb, "Number ");
@@ -3077,6 +3326,8 @@ outoflength(uint64_t    u64,
     cg_var *cv2;
     int     i;
 
+    if (reason == NULL) /* Only format if asked for */
+	return 0;
     if ((cb = cbuf_new()) == NULL)
 	goto done;
     cprintf(cb, "String length %" PRIu64 " out of range: ", u64);
@@ -3109,6 +3360,9 @@ outoflength(uint64_t    u64,
  * @retval -1  Error (fatal), with errno set to indicate error
  * @retval 0   Validation not OK, malloced reason is returned. returned reason must be freed
  * @retval 1   Validation OK
+ * @note Threads: regexps of cs, and ranges not compiled when parsed, are compiled and
+ *       cached on first use, so cs must not be used by several threads concurrently, 
+ *       see match_pattern
  */
 int
 cv_validate(cligen_handle h,
@@ -3118,146 +3372,26 @@ cv_validate(cligen_handle h,
 	    char        **reason)
 {
     int      retval = 1; /* OK */
-    int32_t  i = 0;
-    uint32_t u = 0;
-    int64_t  i64;
     uint64_t u64;
     char    *str;
     int      ok;
     int      j;
-    cg_var  *cv1;
-    cg_var  *cv2;
+    uint64_t t0;
     
     switch (cs->cgs_vtype){
     case CGV_INT8:
-	if (!cs->cgs_rangelen)
-	    break;
-	i = cv_int8_get(cv);
-	ok = 0; 	/* At least one should pass */
-	for (j=0; j<cs->cgs_rangelen; j++){
-	    cv1 = cvec_i(cs->cgs_rangecvv_low, j);
-	    cv2 = cvec_i(cs->cgs_rangecvv_upp, j);
-	    if ((ok = range_check(i, cv1, cv2, int8)) != 0)
-		break;
-	}
-	if (!ok){
-	    if (outofrange(cv, cs, reason) < 0)
-		goto done;
-	    retval = 0; /* No match */
-	}
-	break;
     case CGV_INT16:
-	if (!cs->cgs_rangelen)
-	    break;
-	i = cv_int16_get(cv);
-	ok = 0; 	/* At least one should pass */
-	for (j=0; j<cs->cgs_rangelen; j++){
-	    cv1 = cvec_i(cs->cgs_rangecvv_low, j);
-	    cv2 = cvec_i(cs->cgs_rangecvv_upp, j);
-	    if ((ok = range_check(i, cv1, cv2, int16)) != 0)
-		break;
-	}
-	if (!ok){
-	    if (outofrange(cv, cs, reason) < 0)
-		goto done;
-	    retval = 0; /* No match */
-	}
-	break;
     case CGV_INT32:
-	if (!cs->cgs_rangelen)
-	    break;
-	i = cv_int32_get(cv);
-	ok = 0; 	/* At least one should pass */
-	for (j=0; j<cs->cgs_rangelen; j++){
-	    cv1 = cvec_i(cs->cgs_rangecvv_low, j);
-	    cv2 = cvec_i(cs->cgs_rangecvv_upp, j);
-	    if ((ok = range_check(i, cv1, cv2, int32)) != 0)
-		break;
-	}
-	if (!ok){
-	    if (outofrange(cv, cs, reason) < 0)
-		goto done;
-	    retval = 0; /* No match */
-	}
-	break;
     case CGV_INT64:
-	if (!cs->cgs_rangelen)
-	    break;
-	i64 = cv_int64_get(cv);
-	ok = 0; 	/* At least one should pass */
-	for (j=0; j<cs->cgs_rangelen; j++){
-	    cv1 = cvec_i(cs->cgs_rangecvv_low, j);
-	    cv2 = cvec_i(cs->cgs_rangecvv_upp, j);
-	    if ((ok = range_check(i64, cv1, cv2, int64)) != 0)
-		break;
-	}
-	if (!ok){
-	    if (outofrange(cv, cs, reason) < 0)
-		goto done;
-	    retval = 0; /* No match */
-	}
-	break;
     case CGV_UINT8:
-	if (!cs->cgs_rangelen)
-	    break;
-	u = cv_uint8_get(cv);
-	ok = 0; 	/* At least one should pass */
-	for (j=0; j<cs->cgs_rangelen; j++){
-	    cv1 = cvec_i(cs->cgs_rangecvv_low, j);
-	    cv2 = cvec_i(cs->cgs_rangecvv_upp, j);
-	    if ((ok = range_check(u, cv1, cv2, uint8)) != 0)
-		break;
-	}
-	if (!ok){
-	    if (outofrange(cv, cs, reason) < 0)
-		goto done;
-	    retval = 0; /* No match */
-	}
-	break;
     case CGV_UINT16:
-	if (!cs->cgs_rangelen)
-	    break;
-	u = cv_uint16_get(cv);
-	ok = 0; 	/* At least one should pass */
-	for (j=0; j<cs->cgs_rangelen; j++){
-	    cv1 = cvec_i(cs->cgs_rangecvv_low, j);
-	    cv2 = cvec_i(cs->cgs_rangecvv_upp, j);
-	    if ((ok = range_check(u, cv1, cv2, uint16)) != 0)
-		break;
-	}
-	if (!ok){
-	    if (outofrange(cv, cs, reason) < 0)
-		goto done;
-	    retval = 0; /* No match */
-	}
-	break;
     case CGV_UINT32:
-	if (!cs->cgs_rangelen)
-	    break;
-	u = cv_uint32_get(cv);
-	ok = 0; 	/* At least one should pass */
-	for (j=0; j<cs->cgs_rangelen; j++){
-	    cv1 = cvec_i(cs->cgs_rangecvv_low, j);
-	    cv2 = cvec_i(cs->cgs_rangecvv_upp, j);
-	    if ((ok = range_check(u, cv1, cv2, uint32)) != 0)
-		break;
-	}
-	if (!ok){
-	    if (outofrange(cv, cs, reason) < 0)
-		goto done;
-	    retval = 0; /* No match */
-	}
-	break;
     case CGV_UINT64:
 	if (!cs->cgs_rangelen)
 	    break;
-	u64 = cv_uint64_get(cv);
-	ok = 0; 	/* At least one should pass */
-	for (j=0; j<cs->cgs_rangelen; j++){
-	    cv1 = cvec_i(cs->cgs_rangecvv_low, j);
-	    cv2 = cvec_i(cs->cgs_rangecvv_upp, j);
-	    if ((ok = range_check(u64, cv1, cv2, uint64)) != 0)
-		break;
+	if ((ok = range_check(cs, range_key(cv, cs->cgs_vtype))) < 0){
+	    retval = -1;
+	    goto done;
 	}
 	if (!ok){
 	    if (outofrange(cv, cs, reason) < 0)
@@ -3274,13 +3408,9 @@ cv_validate(cligen_handle h,
 	}
 	if (!cs->cgs_rangelen)
 	    break;
-	i64 = cv_int64_get(cv);
-	ok = 0; 	/* At least one should pass */
-	for (j=0; j<cs->cgs_rangelen; j++){
-	    cv1 = cvec_i(cs->cgs_rangecvv_low, j);
-	    cv2 = cvec_i(cs->cgs_rangecvv_upp, j);
-	    if ((ok = range_check(i64, cv1, cv2, int64)) != 0)
-		break;
+	if ((ok = range_check(cs, range_key(cv, CGV_DEC64))) < 0){
+	    retval = -1;
+	    goto done;
 	}
 	if (!ok){
 	    if (reason){
@@ -3294,11 +3424,12 @@ cv_validate(cligen_handle h,
     case CGV_STRING:
 	str = cv_string_get(cv);
 	if (cs->cgs_regex != NULL){
-	    char *regexp;
-	    cv1 = NULL;
-	    while ((cv1 = cvec_each(cs->cgs_regex, cv1)) != NULL){
-		regexp = cv_string_get(cv1);
-		if ((retval = match_regexp(h, str, regexp, cv_flag(cv1, V_INVERT))) < 0)
+	    /* Patterns are compiled on first use and cached in cs */
+	    for (j=0; j<cvec_len(cs->cgs_regex); j++){
+		t0 = cligen_stats_start(h);
+		retval = match_regexp_cache(h, str, cs->cgs_regex, j, &cs->cgs_regex_cache);
+		cligen_stats_stop(h, CLIGEN_STAT_REGEX, t0);
+		if (retval < 0)
 		    break;
 		if (retval == 0){
 		    if (reason)
@@ -3315,12 +3446,9 @@ cv_validate(cligen_handle h,
 	if (!cs->cgs_rangelen)	/* Skip range check */
 	    break;
 	u64 = strlen(str); /* size_t */
-	ok = 0; 	/* At least one should pass */
-	for (j=0; j<cs->cgs_rangelen; j++){
-	    cv1 = cvec_i(cs->cgs_rangecvv_low, j);
-	    cv2 = cvec_i(cs->cgs_rangecvv_upp, j);
-	    if ((ok = range_check(u64, cv1, cv2, uint64)) != 0)
-		break;
+	if ((ok = range_check(cs, u64)) < 0){
+	    retval = -1;
+	    goto done;
 	}
 	if (!ok){
 	    if (outoflength(u64, cs, reason) < 0)
@@ -121,6 +121,8 @@ struct cg_obj;     /* forward declaration. Original in cligen_object.h */
 
 struct cg_varspec; /* forward declaration. Original in cligen_object.h */
 
+struct cligen_ranges; /* Compiled ranges of a varspec, defined internally in cligen_cv.c */
+
 /*
  * Prototypes
  */
@@ -228,6 +230,9 @@ int     cv_parse(char *str, cg_var *cgv);
 int     cv_parse1(char *str, cg_var *cgv, char **reason); /* better err-handling */
 
 int     cv_validate(cligen_handle h, cg_var *cv, struct cg_varspec *cs, char *cmd, char **reason);
+int     cv_range_compile(struct cg_varspec *cs);
+int     cv_range_free(struct cligen_ranges *cr);
+size_t  cv_range_size(struct cligen_ranges *cr);
 int     cv_reset(cg_var *cgv); /* not free cgv itself */ /* XXX: free_only */
 int     cv_free(cg_var *cv);   /* free cgv itself */
 cg_var *cv_new(enum cv_type type);
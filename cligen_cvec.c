@@ -77,6 +77,13 @@ static inline char * strdup4(char *str)
     return dup;
 }
 
+/*! Types of lookups by name, see cvec_find_type */
+enum cvec_find_type{
+    CVEC_FIND_ANY,     /* Any element */
+    CVEC_FIND_KEYWORD, /* Keyword elements (var_const set) */
+    CVEC_FIND_VAR,     /* Non-keyword elements */
+};
+
 /*
  * cv_exclude_keys
  * set if you want to backward compliant: dont include keys in cgv vec to callback
@@ -129,6 +136,195 @@ cvec_from_var(cg_var *cv)
     return newvec;
 }
 
+/*! FNV-1a hash of a name
+ */
+static inline uint32_t
+cvec_index_hash(const char *str)
+{
+    const unsigned char *s = (const unsigned char *)str;
+    uint32_t             h = 2166136261U;
+
+    while (*s){
+	h ^= *s++;
+	h *= 16777619U;
+    }
+    return h;
+}
+
+/*! Free name index of a cligen variable vector, it is rebuilt on demand
+ * @param[in]  cvv   Cligen variable vector
+ */
+static void
+cvec_index_free(cvec *cvv)
+{
+    if (cvv->vr_index)
+	free(cvv->vr_index);
+    if (cvv->vr_inext)
+	free(cvv->vr_inext);
+    cvv->vr_index = NULL;
+    cvv->vr_inext = NULL;
+    cvv->vr_islots = 0;
+    cvv->vr_isize = 0;
+    cvv->vr_indexed = 0;
+    cvv->vr_lookups = 0;
+}
+
+/*! Invalidate the name index of a cligen variable vector after renaming elements
+ *
+ * The index follows added and deleted elements, but not names changed in place, eg
+ * with cv_name_set on an element of the vector. It is rebuilt on demand.
+ * @param[in]  cvv   Cligen variable vector
+ * @retval     0     OK
+ * @see cvec_find
+ */
+int
+cvec_index_invalidate(cvec *cvv)
+{
+    if (cvv == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    cvec_index_free(cvv);
+    return 0;
+}
+
+/*! Add elements appended since last call to the name index
+ *
+ * Elements are added in order and stop at the first without a name, since a name is
+ * typically set after cvec_add. Elements not in the index are searched linearly.
+ * @param[in]  cvv   Cligen variable vector
+ * @retval     0     OK
+ * @retval    -1     Error, index is freed
+ */
+static int
+cvec_index_update(cvec *cvv)
+{
+    int     i;
+    int    *index;
+    int     slots;
+    size_t  j;
+    cg_var *cv;
+    cg_var *cv1;
+
+    if (cvv->vr_len > cvv->vr_isize){
+	if ((index = realloc(cvv->vr_inext, cvv->vr_size*sizeof(int))) == NULL)
+	    goto err;
+	cvv->vr_inext = index;
+	cvv->vr_isize = cvv->vr_size;
+    }
+    /* Keep load factor below 1/2 */
+    if (cvv->vr_len*2 > cvv->vr_islots){
+	slots = cvv->vr_islots?cvv->vr_islots:CVEC_INDEX_MIN*2;
+	while (cvv->vr_len*2 > slots)
+	    slots *= 2;
+	if ((index = calloc(slots, sizeof(int))) == NULL)
+	    goto err;
+	free(cvv->vr_index);
+	cvv->vr_index = index;
+	cvv->vr_islots = slots;
+	cvv->vr_indexed = 0; /* Rehash all */
+    }
+    for (i=cvv->vr_indexed; i<cvv->vr_len; i++){
+	cv = &cvv->vr_vec[i];
+	if (cv->var_name == NULL)
+	    break;
+	cvv->vr_inext[i] = 0;
+	j = cvec_index_hash(cv->var_name) & (cvv->vr_islots-1);
+	while (cvv->vr_index[j] != 0){
+	    cv1 = &cvv->vr_vec[cvv->vr_index[j]-1];
+	    if (cv1->var_name && strcmp(cv1->var_name, cv->var_name) == 0)
+		break;
+	    j = (j+1) & (cvv->vr_islots-1);
+	}
+	if (cvv->vr_index[j] == 0)
+	    cvv->vr_index[j] = i+1;
+	else{ /* Same name, append last in chain */
+	    index = &cvv->vr_index[j];
+	    while (*index != 0)
+		index = &cvv->vr_inext[*index-1];
+	    *index = i+1;
+	}
+    }
+    cvv->vr_indexed = i;
+    return 0;
+ err:
+    cvec_index_free(cvv);
+    return -1;
+}
+
+/*! Find first element with name among elements from index i0 up to i1, linearly
+ * @param[in]  cvv   Cligen variable vector
+ * @param[in]  i0    First element
+ * @param[in]  i1    Element after last
+ * @param[in]  name  Name to match, not NULL
+ * @param[in]  type  Any element, only keywords or only non-keywords
+ */
+static cg_var *
+cvec_find_linear(cvec                *cvv,
+		 int                  i0,
+		 int                  i1,
+		 char                *name,
+		 enum cvec_find_type  type)
+{
+    cg_var *cv;
+    int     i;
+
+    for (i=i0; i<i1; i++){
+	cv = &cvv->vr_vec[i];
+	if (cv->var_name == NULL || strcmp(cv->var_name, name) != 0)
+	    continue;
+	if (type == CVEC_FIND_ANY ||
+	    (type == CVEC_FIND_KEYWORD && cv->var_const) ||
+	    (type == CVEC_FIND_VAR && !cv->var_const))
+	    return cv;
+    }
+    return NULL;
+}
+
+/*! Find first element with name, using name index on large vectors
+ *
+ * The index is built lazily for vectors of at least CVEC_INDEX_MIN elements after
+ * CVEC_INDEX_LOOKUPS lookups, and is freed when elements are deleted.
+ * An element renamed after it was indexed is not found by its new name until the
+ * index is invalidated, see cvec_index_invalidate.
+ * @param[in]  cvv   Cligen variable vector
+ * @param[in]  name  Name to match, not NULL
+ * @param[in]  type  Any element, only keywords or only non-keywords
+ */
+static cg_var *
+cvec_find_type(cvec                *cvv,
+	       char                *name,
+	       enum cvec_find_type  type)
+{
+    cg_var *cv;
+    int     i = 0;
+    size_t  j;
+    int     k;
+
+    if (cvv == NULL)
+	return NULL;
+    if (cvv->vr_len >= CVEC_INDEX_MIN &&
+	(cvv->vr_index != NULL || ++cvv->vr_lookups >= CVEC_INDEX_LOOKUPS) &&
+	cvec_index_update(cvv) == 0){
+	j = cvec_index_hash(name) & (cvv->vr_islots-1);
+	while ((k = cvv->vr_index[j]) != 0){
+	    cv = &cvv->vr_vec[k-1];
+	    if (cv->var_name && strcmp(cv->var_name, name) == 0)
+		break;
+	    j = (j+1) & (cvv->vr_islots-1);
+	}
+	for (; k != 0; k = cvv->vr_inext[k-1]){
+	    cv = &cvv->vr_vec[k-1];
+	    if (type == CVEC_FIND_ANY ||
+		(type == CVEC_FIND_KEYWORD && cv->var_const) ||
+		(type == CVEC_FIND_VAR && !cv->var_const))
+		return cv;
+	}
+	i = cvv->vr_indexed; /* Search the rest linearly */
+    }
+    return cvec_find_linear(cvv, i, cvv->vr_len, name, type);
+}
+
 /*! Free a cligen  variable vector (cvec)
  *
  * Reset and free a cligen vector as previously created by cvec_new(). this includes
@@ -159,11 +355,41 @@ cvec_init(cvec *cvv,
 	  int   len)
 {
     cvv->vr_len = len;
+    cvv->vr_size = len;
     if (len && (cvv->vr_vec = calloc(cvv->vr_len, sizeof(cg_var))) == NULL)
 	return -1;
     return 0;
 }
 
+/*! Reserve space for at least len elements in a cligen variable vector
+ *
+ * Elements can then be added with cvec_add up to len without reallocation, and
+ * pointers to elements remain valid.
+ * The vector grows geometrically when needed, so this is an optimization only.
+ * @param[in] cvv  Cligen variable vector
+ * @param[in] len  Total number of elements (not additional)
+ * @retval    0    OK
+ * @retval   -1    Error
+ */
+int
+cvec_reserve(cvec *cvv,
+	     int   len)
+{
+    cg_var *vec;
+
+    if (cvv == NULL || len < 0){
+	errno = EINVAL;
+	return -1;
+    }
+    if (len <= cvv->vr_size)
+	return 0;
+    if ((vec = realloc(cvv->vr_vec, len*sizeof(cg_var))) == NULL)
+	return -1;
+    cvv->vr_vec = vec;
+    cvv->vr_size = len;
+    return 0;
+}
+
 /*! Reset cligen variable vector resetting it to an initial state as returned by cvec_new
  *
  * @param[in]  cvv   Cligen variable vector
@@ -178,6 +404,7 @@ cvec_reset(cvec *cvv)
 	return 0;
     while ((cv = cvec_each(cvv, cv)) != NULL)
 	cv_reset(cv);
+    cvec_index_free(cvv);
     if (cvv->vr_vec)
 	free(cvv->vr_vec);
     if (cvv->vr_name)
@@ -186,6 +413,31 @@ cvec_reset(cvec *cvv)
     return 0;
 }
 
+/*! Empty a cligen variable vector, keeping its allocated space
+ *
+ * The variables are reset and the vector can be filled again with cvec_add without
+ * reallocation, eg once per command line.
+ * @param[in]  cvv   Cligen variable vector
+ * @see cvec_reset  which also frees the allocated space
+ */
+int
+cvec_clear(cvec *cvv)
+{
+    cg_var *cv = NULL;
+
+    if (cvv == NULL)
+	return 0;
+    while ((cv = cvec_each(cvv, cv)) != NULL)
+	cv_reset(cv);
+    cvec_index_free(cvv);
+    if (cvv->vr_name){
+	free(cvv->vr_name);
+	cvv->vr_name = NULL;
+    }
+    cvv->vr_len = 0;
+    return 0;
+}
+
 /*! Given a cv in a cligen variable vector (cvec) return the next cv.
  *
  * @param[in]  cvv    The cligen variable vector
@@ -232,8 +484,9 @@ cvec_add(cvec        *cvv,
 	return NULL;
     }
     len = cvv->vr_len + 1;
-
-    if ((cvv->vr_vec = realloc(cvv->vr_vec, len*sizeof(cg_var))) == NULL)
+    /* Grow geometrically so that appending n elements is linear */
+    if (len > cvv->vr_size &&
+	cvec_reserve(cvv, cvv->vr_size?cvv->vr_size*2:CVEC_SIZE_MIN) < 0)
 	return NULL;
     cvv->vr_len = len;
     cv = cvec_i(cvv, len-1);
@@ -263,6 +516,33 @@ cvec_append_var(cvec   *cvv,
     return tail;
 }
 
+/*! Append clones of all variables in a vector to another vector
+ *
+ * Space is reserved once for all variables
+ * @param[in] cvv  Cligen variable vector
+ * @param[in] add  Append copies of all cligen variables of this vector, not modified
+ * @retval    0    OK
+ * @retval   -1    Error, cvv may have been partly appended
+ * @see cvec_append_var
+ */
+int
+cvec_append(cvec *cvv,
+	    cvec *add)
+{
+    cg_var *cv = NULL;
+
+    if (cvv == NULL || cvv == add){
+	errno = EINVAL;
+	return -1;
+    }
+    if (cvec_reserve(cvv, cvv->vr_len + cvec_len(add)) < 0)
+	return -1;
+    while ((cv = cvec_each(add, cv)) != NULL)
+	if (cvec_append_var(cvv, cv) == NULL)
+	    return -1;
+    return 0;
+}
+
 /*! Delete a cv variable from a cvec. Note: cv is not reset & cv may be stale!
  *
  * @param[in]  cvv   Cligen variable vector
@@ -297,8 +577,8 @@ cvec_del(cvec   *cvv,
 	memmove(&cvv->vr_vec[i], &cvv->vr_vec[i+1],
 		(cvv->vr_len-i-1) * sizeof(cvv->vr_vec[0]));
 
-    cvv->vr_len--;
-    cvv->vr_vec = realloc(cvv->vr_vec, cvv->vr_len*sizeof(cvv->vr_vec[0])); /* Shrink should not fail? */
+    cvv->vr_len--; /* Keep allocated space, see cvec_reserve */
+    cvec_index_free(cvv); /* Indexes have moved */
 
     return cvec_len(cvv);
 }
@@ -326,6 +606,7 @@ cvec_del_i(cvec *cvv,
 		(cvv->vr_len-i-1) * sizeof(cvv->vr_vec[0]));
 
     cvv->vr_len--;
+    cvec_index_free(cvv); /* Indexes have moved */
 
     return cvec_len(cvv);
 }
@@ -538,6 +819,10 @@ cvec2cbuf(cbuf *cb,
  * @retval     cv    Element matching name. NULL
  * @retval     NULL  Not found
  * @see cvec_find_keyword
+ * @note Large vectors get an index of names, which follows added and deleted elements.
+ *       A caller changing the name of an element in place, eg with cv_name_set, after
+ *       a lookup must call cvec_index_invalidate, otherwise the element may not be
+ *       found by its new name, or may be found by its old name.
  */
 cg_var *
 cvec_find(cvec *cvv,
@@ -545,6 +830,8 @@ cvec_find(cvec *cvv,
 {
     cg_var *cv = NULL;
 
+    if (name != NULL)
+	return cvec_find_type(cvv, name, CVEC_FIND_ANY);
     while ((cv = cvec_each(cvv, cv)) != NULL){
 	if (cv->var_name){
 	    if (name != NULL && strcmp(cv->var_name, name) == 0)
@@ -567,12 +854,7 @@ cg_var *
 cvec_find_keyword(cvec *cvv,
 		  char *name)
 {
-    cg_var *cv = NULL;
-
-    while ((cv = cvec_each(cvv, cv)) != NULL)
-	if (cv->var_name && strcmp(cv->var_name, name) == 0 && cv->var_const)
-	    return cv;
-    return NULL;
+    return cvec_find_type(cvv, name, CVEC_FIND_KEYWORD);
 }
 
 /*! Return first non-keyword cv in a cvec matching a name
@@ -586,12 +868,7 @@ cg_var *
 cvec_find_var(cvec *cvv,
 	      char *name)
 {
-    cg_var *cv = NULL;
-
-    while ((cv = cvec_each(cvv, cv)) != NULL)
-	if (cv->var_name && strcmp(cv->var_name, name) == 0 && !cv->var_const)
-	    return cv;
-    return NULL;
+    return cvec_find_type(cvv, name, CVEC_FIND_VAR);
 }
 
 /*! Typed version of cvec_find that returns the string value.
@@ -684,5 +961,7 @@ cvec_size(cvec *cvv)
     cv = NULL;
     while ((cv = cvec_each(cvv, cv)) != NULL)
 	sz += cv_size(cv);
+    sz += (cvv->vr_size - cvv->vr_len)*sizeof(cg_var); /* Reserved */
+    sz += (cvv->vr_islots + cvv->vr_isize)*sizeof(int); /* Name index */
     return sz;
 }
@@ -52,13 +52,16 @@ cvec   *cvec_new(int len);
 cvec   *cvec_from_var(cg_var *cv);
 int     cvec_free(cvec *vr);
 int     cvec_init(cvec *vr, int len);
+int     cvec_reserve(cvec *cvv, int len);
 int     cvec_reset(cvec *vr); 
+int     cvec_clear(cvec *cvv);
 int     cvec_len(cvec *vr);
 cg_var *cvec_i(cvec *vr, int i);
 char   *cvec_i_str(cvec *cvv, int i);
 cg_var *cvec_next(cvec *vr, cg_var *cv0);
 cg_var *cvec_add(cvec *vr, enum cv_type type);
 cg_var *cvec_append_var(cvec *cvv, cg_var *var);
+int     cvec_append(cvec *cvv, cvec *add);
 int     cvec_del(cvec *vr, cg_var *del);
 int     cvec_del_i(cvec *vr, int ix);
 cg_var *cvec_each(cvec *vr, cg_var *prev);
@@ -70,6 +73,7 @@ int     cvec2cbuf(cbuf *cb, cvec *cvv);
 cg_var *cvec_find(cvec *vr, char *name);
 cg_var *cvec_find_keyword(cvec *vr, char *name);
 cg_var *cvec_find_var(cvec *vr, char *name);
+int     cvec_index_invalidate(cvec *cvv);
 char   *cvec_find_str(cvec *vr, char *name);
 char   *cvec_name_get(cvec *vr);
 char   *cvec_name_set(cvec *vr, char *name);
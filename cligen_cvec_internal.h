@@ -38,13 +38,32 @@
 #ifndef _CLIGEN_CVEC_INTERNAL_H_
 #define _CLIGEN_CVEC_INTERNAL_H_
 
+/*
+ * Constants
+ */
+/* Initial allocated length of vector when elements are added, doubled when full */
+#define CVEC_SIZE_MIN 4
+
+/* Vectors with at least this many elements get a name index, see cvec_find */
+#define CVEC_INDEX_MIN 16
+
+/* Lookups by name before the index is built, so that vectors looked up once do not pay */
+#define CVEC_INDEX_LOOKUPS 4
+
 /*
  * Types
  */
 struct cvec{
     cg_var         *vr_vec;  /* vector of CLIgen variables */
     int             vr_len;  /* length of vector */
+    int             vr_size; /* allocated length of vr_vec, >= vr_len */
     char           *vr_name; /* name of cvec, can be NULL */
+    int            *vr_index;   /* Hash table of names: index+1 of first element, 0: empty */
+    int            *vr_inext;   /* Index+1 of next element with same name, 0: none */
+    int             vr_islots;  /* Number of slots of vr_index, power of two */
+    int             vr_isize;   /* Allocated length of vr_inext */
+    int             vr_indexed; /* Elements before this are in the index */
+    int             vr_lookups; /* Lookups by name since the index was freed */
 };
 
 #endif /* _CLIGEN_CVEC_INTERNAL_H_ */
@@ -40,6 +40,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/time.h>
 #include <netinet/in.h>
 
 #include "cligen_buf.h"
@@ -53,6 +54,12 @@
 #include "cligen_print.h"
 #include "cligen_expand.h"
 #include "cligen_syntax.h"
+#include "cligen_regex.h"
+#include "cligen_io.h"
+#include "cligen_getline.h"
+#include "cligen_stats.h"
+#include "cligen_registry.h"
+#include "cligen_compile.h"
 
 /* Callback function for expand variables */
 
@@ -72,6 +79,7 @@ co_expand_sub(cg_obj  *co,
 {
     cg_obj     *con = NULL;
     parse_tree *pt;
+    int         intern;
 
     if ((con = co_new_only()) == NULL)
 	return -1;
@@ -79,17 +87,21 @@ co_expand_sub(cg_obj  *co,
     /* Point to same underlying pt */
     con->co_ptvec = NULL;
     con->co_pt_len = 0;
+    if (co_varspec_new(con, co->co_var) < 0)
+	return -1;
     pt = co_pt_get(co);
     if (co_pt_set(con, pt) < 0)
 	return -1;
     /* Replace all pointers */
     co_up_set(con, co_parent);
-    if (co->co_command)
+    /* Interned strings are shared, see co_intern */
+    intern = co_flags_get(co, CO_FLAGS_INTERN);
+    if (co->co_command && !intern)
 	if ((con->co_command = strdup(co->co_command)) == NULL){
 	    fprintf(stderr, "%s: strdup: %s\n", __FUNCTION__, strerror(errno));
 	    return -1;
 	}
-    if (co->co_prefix)
+    if (co->co_prefix && !intern)
 	if ((con->co_prefix = strdup(co->co_prefix)) == NULL){
 	    fprintf(stderr, "%s: strdup: %s\n", __FUNCTION__, strerror(errno));
 	    return -1;
@@ -98,11 +110,11 @@ co_expand_sub(cg_obj  *co,
 	con->co_cvec = cvec_dup(co->co_cvec);
     if (co_callback_copy(co->co_callbacks, &con->co_callbacks) < 0)
 	return -1;
-    if (co->co_helpvec)
+    if (co->co_helpvec && !intern)
 	if ((con->co_helpvec = cvec_dup(co->co_helpvec)) == NULL)
 	    return -1;
     if (co->co_type == CO_VARIABLE){
-	if (co->co_expand_fn_str)
+	if (co->co_expand_fn_str && !intern)
 	    if ((con->co_expand_fn_str = strdup(co->co_expand_fn_str)) == NULL){
 		fprintf(stderr, "%s: strdup: %s\n", __FUNCTION__, strerror(errno));
 		return -1;
@@ -110,12 +122,12 @@ co_expand_sub(cg_obj  *co,
 	if (co->co_expand_fn_vec)
 	    if ((con->co_expand_fn_vec = cvec_dup(co->co_expand_fn_vec)) == NULL)
 		return -1;
-	if (co->co_translate_fn_str)
+	if (co->co_translate_fn_str && !intern)
 	    if ((con->co_translate_fn_str = strdup(co->co_translate_fn_str)) == NULL){
 		fprintf(stderr, "%s: strdup: %s\n", __FUNCTION__, strerror(errno));
 		return -1;
 	    }
-	if (co->co_show)
+	if (co->co_show && !intern)
 	    if ((con->co_show = strdup(co->co_show)) == NULL){
 		fprintf(stderr, "%s: strdup: %s\n", __FUNCTION__, strerror(errno));
 		return -1;
@@ -126,7 +138,7 @@ co_expand_sub(cg_obj  *co,
 	if (co->co_rangecvv_upp)
 	    if ((con->co_rangecvv_upp = cvec_dup(co->co_rangecvv_upp)) == NULL)
 		return -1;
-	if (co->co_choice)
+	if (co->co_choice && !intern)
 	    if ((con->co_choice = strdup(co->co_choice)) == NULL){
 		fprintf(stderr, "%s: strdup: %s\n", __FUNCTION__, strerror(errno));
 		return -1;
@@ -136,12 +148,34 @@ co_expand_sub(cg_obj  *co,
 		fprintf(stderr, "%s: cvec_dup: %s\n", __FUNCTION__, strerror(errno));
 		return -1;
 	    }
+	con->co_regex_cache = NULL; /* Compiled on first use */
+	con->co_ranges = NULL;
+	con->co_choicevec = NULL;
+	con->co_choicelen = 0;
     } /* CO_VARIABLE */
     con->co_ref = co;
     *conp = con;
     return 0;
 }
 
+/*! Make a shallow copy of a cligen object in an expanded parse-tree
+ * The copy shares all fields, including the sub-tree, with the original and is only
+ * valid as long as the original. Set co_ref to point back to the original.
+ * @param[in]  co     Original cg_obj
+ * @param[out] con    New, shadow object, allocated by caller with pt_block_new
+ * @see co_expand_sub  for a deep copy that may be transformed
+ */
+static void
+co_expand_shallow(cg_obj  *co, 
+		  cg_obj  *con)
+{
+    memcpy(con, co, sizeof(cg_obj));
+    con->co_prev = NULL;
+    con->co_value = NULL;
+    co_flags_set(con, CO_FLAGS_SHALLOW);
+    con->co_ref = co;
+}
+
 /*! Transform string variables to commands
  * Expansion of choice or expand takes a variable (<expand> <choice>)
  * and transform them to a set of commands: <string>...<string>
@@ -154,6 +188,8 @@ transform_var_to_cmd(cg_obj *co,
 		     char   *cmd, 
 		     char   *helptext)
 {
+    if (co_intern_detach(co) < 0)
+	return -1;
     if (co->co_command)
 	free(co->co_command);
     co->co_command = cmd; 
@@ -192,15 +228,29 @@ transform_var_to_cmd(cg_obj *co,
 	cvec_free(co->co_rangecvv_upp);
 	co->co_rangecvv_upp = NULL;
     }
+    if (co->co_ranges){
+	cv_range_free(co->co_ranges);
+	co->co_ranges = NULL;
+    }
     if (co->co_choice){
 	free(co->co_choice);
 	co->co_choice = NULL;
     }
+    if (co->co_choicevec){
+	free(co->co_choicevec);
+	co->co_choicevec = NULL;
+	co->co_choicelen = 0;
+    }
     if (co->co_regex){
 	cvec_free(co->co_regex);
 	co->co_regex = NULL;
     }
+    if (co->co_regex_cache){
+	cligen_regex_cache_free(co->co_regex_cache);
+	co->co_regex_cache = NULL;
+    }
     co->co_type = CO_COMMAND;
+    co_flags_reset(co, CO_FLAGS_META|CO_FLAGS_REST);
     return 0;
 }
 
@@ -244,6 +294,9 @@ pt_callback_reference(parse_tree         *pt,
 		    return -1;
 	    }
 	    else {
+		if (co_callbacks_unshare(&co->co_callbacks) < 0)
+		    return -1;
+		cc = co->co_callbacks;
 		cc->cc_fn_vec = cc0->cc_fn_vec; /*  */
 		if (cc0->cc_fn_str){
 		    if (cc->cc_fn_str)
@@ -328,6 +381,248 @@ pt_recurse_filter(parse_tree  *pt,
     return retval;
 }
 
+/*! Check if a referenced parse-tree can be shared read-only instead of copied
+ *
+ * A tree can not be shared if it contains tree references itself, since those would 
+ * be expanded in place in the shared tree, or if any of its objects are filtered.
+ * @param[in]  pt       Referenced parse-tree
+ * @param[in]  cvv      Filter labels as computed for the reference
+ * @retval     1        Tree may be shared
+ * @retval     0        Tree needs to be copied
+ */
+static int
+pt_reference_shareable(parse_tree *pt,
+		       cvec       *cvv)
+{
+    int     i;
+    cg_obj *co;
+    cg_var *cv;
+    cg_var *cvf;
+    char   *filter;
+    
+    for (i=0; i<pt_len_get(pt); i++){
+	if ((co = pt_vec_i_get(pt, i)) == NULL)
+	    continue;
+	if (co->co_type == CO_REFERENCE)
+	    return 0;
+	cv = NULL;
+	while ((cv = cvec_each(co->co_cvec, cv)) != NULL){
+	    cvf = NULL;
+	    while ((cvf = cvec_each(cvv, cvf)) != NULL)
+		if ((filter = cv_name_get(cvf)) != NULL &&
+		    strcmp(filter, cv_name_get(cv)) == 0)
+		    return 0;
+	}
+	if (pt_reference_shareable(co_pt_get(co), cvv) == 0)
+	    return 0;
+    }
+    return 1;
+}
+
+/*! Compute label mask of an object from its local variables
+ * @param[in]  h       CLIgen handle, owns label ids
+ * @param[in]  co      CLIgen object
+ * @param[out] labels  Label mask
+ * @retval     0       OK
+ * @retval    -1       Error
+ */
+static int
+co_labels_mask(cligen_handle h,
+	       cg_obj       *co,
+	       uint64_t     *labels)
+{
+    cg_var *cv = NULL;
+    char   *name;
+    int     id;
+
+    *labels = 0;
+    if (co->co_type == CO_REFERENCE)
+	*labels |= CO_LABELS_REFERENCE;
+    while ((cv = cvec_each(co->co_cvec, cv)) != NULL){
+	if ((name = cv_name_get(cv)) == NULL)
+	    continue;
+	if ((id = cligen_label_id(h, name)) < 0)
+	    return -1;
+	if (id < CLIGEN_LABELS_MAX)
+	    *labels |= (uint64_t)1 << id;
+    }
+    return 0;
+}
+
+/*! Compute label masks of objects of a parse-tree and return the union of them
+ *
+ * Objects with valid masks (CO_FLAGS_LABELS) are not descended since co_labels_below
+ * already covers their sub-trees.
+ * @param[in]  h       CLIgen handle, owns label ids
+ * @param[in]  pt      CLIgen parse-tree
+ * @param[out] labels  Union of label masks of all objects in pt and below
+ * @retval     0       OK
+ * @retval    -1       Error
+ */
+static int
+pt_labels_update(cligen_handle h,
+		 parse_tree   *pt,
+		 uint64_t     *labels)
+{
+    int      i;
+    cg_obj  *co;
+    uint64_t below;
+
+    *labels = 0;
+    for (i=0; i<pt_len_get(pt); i++){
+	if ((co = pt_vec_i_get(pt, i)) == NULL)
+	    continue;
+	if (!co_flags_get(co, CO_FLAGS_LABELS)){
+	    if (co_labels_mask(h, co, &co->co_labels) < 0)
+		return -1;
+	    below = 0;
+	    if (co_pt_get(co) != NULL &&
+		pt_labels_update(h, co_pt_get(co), &below) < 0)
+		return -1;
+	    co->co_labels_below = below;
+	    co_flags_set(co, CO_FLAGS_LABELS);
+	}
+	*labels |= co->co_labels | co->co_labels_below;
+    }
+    return 0;
+}
+
+/*! Get mask of filter labels
+ * @param[in]  h       CLIgen handle
+ * @param[in]  cvv     Filter labels as computed for a reference, removed labels are NULL
+ * @param[out] mask    Label mask
+ * @retval     1       OK
+ * @retval     0       A label has no id, filter by name
+ * @retval    -1       Error
+ */
+static int
+filter_labels_mask(cligen_handle h,
+		   cvec         *cvv,
+		   uint64_t     *mask)
+{
+    cg_var *cv = NULL;
+    char   *filter;
+    int     id;
+
+    *mask = 0;
+    while ((cv = cvec_each(cvv, cv)) != NULL){
+	if ((filter = cv_name_get(cv)) == NULL)
+	    continue;
+	if ((id = cligen_label_id(h, filter)) < 0)
+	    return -1;
+	if (id == CLIGEN_LABELS_MAX)
+	    return 0;
+	*mask |= (uint64_t)1 << id;
+    }
+    return 1;
+}
+
+/*! Remove parse-tree objects labelled by any label in mask, in one pass
+ *
+ * Sub-trees without any of the labels are not visited. Label masks of pt must be valid.
+ * @param[in]  pt       CLIgen parse-tree
+ * @param[in]  mask     Filter label mask
+ * @retval     0        OK
+ * @retval    -1        Error
+ * @see pt_recurse_filter  Filter by name
+ */
+static int
+pt_labels_filter(parse_tree *pt,
+		 uint64_t    mask)
+{
+    int         retval = -1;
+    parse_tree *ptc;
+    cg_obj     *co;
+    int         i;
+
+    for (i=0; i<pt_len_get(pt); i++){
+	if ((co = pt_vec_i_get(pt, i)) == NULL)
+	    continue;
+	if (co->co_labels & mask){
+	    if (pt_vec_i_delete(pt, i) < 0)
+		goto done;
+	    i--; /* co is removed, get next in place */
+	    continue;
+	}
+	if ((co->co_labels_below & mask) &&
+	    (ptc = co_pt_get(co)) != NULL &&
+	    pt_labels_filter(ptc, mask) < 0)
+	    goto done;
+    }
+    retval = 0;
+ done:
+    return retval;
+}
+
+/*! Compute label masks of all objects in a parse-tree
+ *
+ * Labels are given ids on the handle and each object gets a mask of its labels and of
+ * the labels of all objects below it. Tree references filter labels with one mask test
+ * per object and skip sub-trees without filtered labels.
+ * Called when a spec is parsed or loaded, and on referenced trees before filtering.
+ * Objects with valid masks are skipped.
+ * @param[in]  h     CLIgen handle
+ * @param[in]  pt    CLIgen parse-tree
+ * @retval     0     OK
+ * @retval    -1     Error
+ * @see co_labels_reset  Invalidate masks if the tree is changed
+ */
+int
+cligen_parsetree_labels(cligen_handle h,
+			parse_tree   *pt)
+{
+    uint64_t labels;
+
+    if (pt == NULL)
+	return 0;
+    return pt_labels_update(h, pt, &labels);
+}
+
+/*! Insert thin top-level objects of a referenced tree sharing their sub-trees
+ *
+ * Each top-level object of the referenced tree is shallow-copied into pt0 and marked
+ * as a tree reference, but the sub-tree below it is the one of the referenced tree.
+ * @param[in]  pt0      Parse-tree where the reference is expanded
+ * @param[in]  coref    Reference object
+ * @param[in]  coparent Parent of the reference object
+ * @param[in]  ptref    Referenced parse-tree
+ * @retval     0        OK
+ * @retval    -1        Error
+ * @see cligen_treeref_share_set
+ */
+static int
+pt_reference_share(parse_tree *pt0,
+		   cg_obj     *coref,
+		   cg_obj     *coparent,
+		   parse_tree *ptref)
+{
+    int     retval = -1;
+    int     j;
+    cg_obj *co;
+    cg_obj *con;
+
+    for (j=0; j<pt_len_get(ptref); j++){
+	if ((co = pt_vec_i_get(ptref, j)) == NULL)
+	    continue;
+	con = NULL;
+	if (co_expand_sub(co, coparent, &con) < 0)
+	    goto done;
+	con->co_value = NULL; /* Not copied by co_expand_sub */
+	co_flags_reset(con, CO_FLAGS_MARK|CO_FLAGS_REFDONE);
+	co_flags_set(con, CO_FLAGS_TREEREF|CO_FLAGS_REFSHARED);
+	con->co_ref = coref; /* Backpointer so we know where this treeref is from */
+	con->co_treeref_orig = co->co_treeref_orig ? co->co_treeref_orig : co;
+	if (pt_vec_append(pt0, con) < 0) 
+	    goto done;
+    }
+    /* Sort and merge once, as co_insert of each object */
+    if (cligen_parsetree_finalize(pt0, 0) < 0)
+	goto done;
+    retval = 0;
+ done:
+    return retval;
+}
+
 /*! Take a top-object parse-tree (pt0), and expand all tree references one level. 
  * 
  * One level only. Parse-tree is expanded itself (not copy).
@@ -362,7 +657,13 @@ pt_expand_treeref(cligen_handle h,
     cvec       *cvv0;
     cvec       *cvv = NULL;
     cg_var     *cv1;
+    uint64_t    labels;
+    uint64_t    mask;
+    int         masked;
+    int         shareable;
+    uint64_t    t0;
     
+    t0 = cligen_stats_start(h);
  again: /* XXX ugly goto , try to replace with a loop */
     for (i=0; i<pt_len_get(pt0); i++){ /*  */
 	if ((co = pt_vec_i_get(pt0, i)) == NULL)
@@ -382,19 +683,7 @@ pt_expand_treeref(cligen_handle h,
 	    else
 		ptref = cligen_ph_parsetree_get(ph);	    
 
-	    /* make a copy of ptref -> pt1ref */
 	    co02 = co_up(co);
-
-	    if ((pt1ref = pt_dup(ptref, co02)) == NULL) /* From ptref -> pt1ref */
-		goto done;
-	    /* Recursively add extra NULLs in non-terminals */
-	    if (co_flags_get(co, CO_FLAGS_HIDE) && /* XXX: hide to trunk? */
-		pt_reference_trunc(pt1ref) < 0)
-		goto done;
-	    /* Recursively install callback all through the referenced tree */
-	    if (co->co_callbacks && 
-		pt_callback_reference(pt1ref, co->co_callbacks) < 0)
-		goto done;
 	    /* Filter label code
 	     * 1. Prepare new cvv filter add/subtract to cvvfilter depending on co_cvec */
 	    if ((cvv0 = cligen_reftree_filter_get(h)) != NULL){
@@ -422,32 +711,77 @@ pt_expand_treeref(cligen_handle h,
 		    else if (strncmp(CLIGEN_REF_ADD, name, strlen(CLIGEN_REF_ADD)) == 0){
 			filter = name+strlen(CLIGEN_REF_ADD);
 			/* If filter in cvv, remove it (set to NULL) */
-			if ((cv1 = cvec_find(cvv, filter)) != NULL)
+			if ((cv1 = cvec_find(cvv, filter)) != NULL){
 			    cv_name_set(cv1, NULL);
+			    cvec_index_invalidate(cvv);
+			}
 		    }
 		}
 	    }
-	    /* 3. Now iterate over the names of cvv and filter out those on pt1ref 
-	     * Then traverse pt1ref and remove all objects labelled with "filter"
-	     */
-	    cv = NULL;
-	    while ((cv = cvec_each(cvv, cv)) != NULL){
-		if ((filter = cv_name_get(cv)) != NULL){
-		    if (pt_recurse_filter(pt1ref, filter) < 0)
-			goto done;
+	    /* 3. Label masks of the referenced tree and of the filter. If a filter label
+	     * has no id, filter by name */
+	    if (pt_labels_update(h, ptref, &labels) < 0)
+		goto done;
+	    if ((masked = filter_labels_mask(h, cvv, &mask)) < 0)
+		goto done;
+	    /* Share the referenced tree if nothing in it is specific to this reference */
+	    shareable = 0;
+	    if (cligen_treeref_share(h) &&
+		co->co_callbacks == NULL &&
+		!co_flags_get(co, CO_FLAGS_HIDE)){
+		if (masked)
+		    shareable = (labels & (mask|CO_LABELS_REFERENCE)) == 0;
+		else
+		    shareable = pt_reference_shareable(ptref, cvv);
+	    }
+	    if (shareable){
+		if (pt_reference_share(pt0, co, co02, ptref) < 0)
+		    goto done;
+		co_flags_set(co, CO_FLAGS_REFDONE);
+		cvec_free(cvv);
+		cvv = NULL;
+		goto again;
+	    }
+	    /* make a copy of ptref -> pt1ref */
+	    if ((pt1ref = pt_dup(ptref, co02)) == NULL) /* From ptref -> pt1ref */
+		goto done;
+	    /* Recursively add extra NULLs in non-terminals */
+	    if (co_flags_get(co, CO_FLAGS_HIDE) && /* XXX: hide to trunk? */
+		pt_reference_trunc(pt1ref) < 0)
+		goto done;
+	    /* Recursively install callback all through the referenced tree */
+	    if (co->co_callbacks && 
+		pt_callback_reference(pt1ref, co->co_callbacks) < 0)
+		goto done;
+	    /* 4. Remove all objects of pt1ref labelled with a filter of cvv. 
+	     * The copy has the label masks of ptref */
+	    if (masked){
+		if ((labels & mask) &&
+		    pt_labels_filter(pt1ref, mask) < 0)
+		    goto done;
+	    }
+	    else {
+		cv = NULL;
+		while ((cv = cvec_each(cvv, cv)) != NULL){
+		    if ((filter = cv_name_get(cv)) != NULL){
+			if (pt_recurse_filter(pt1ref, filter) < 0)
+			    goto done;
+		    }
 		}
-			
 	    }
 	    /* Copy top-levels into original parse-tree */
 	    for (j=0; j<pt_len_get(pt1ref); j++)
 		if ((cot = pt_vec_i_get(pt1ref, j)) != NULL){
 		    co_flags_set(cot, CO_FLAGS_TREEREF); /* Mark expanded refd tree */
 		    cot->co_ref = co; /* Backpointer so we know where this treeref is from */
-		    if (co_insert(pt0, cot) == NULL) 
+		    if (pt_vec_append(pt0, cot) < 0) 
 			goto done;
 		    if (pt_vec_i_clear(pt1ref, j) < 0)
 			goto done;
 		}
+	    /* Sort and merge once, as co_insert of each object */
+	    if (cligen_parsetree_finalize(pt0, 0) < 0)
+		goto done;
 	    /* Due to loop above, all co in vec should be moved, it should
 	       be safe to remove */
 	    co_flags_set(co, CO_FLAGS_REFDONE);
@@ -455,6 +789,8 @@ pt_expand_treeref(cligen_handle h,
 		pt_free(pt1ref, 1);
 		pt1ref = NULL;
 	    }
+	    cvec_free(cvv);
+	    cvv = NULL;
 	    goto again; 
 	}
     }
@@ -464,6 +800,7 @@ pt_expand_treeref(cligen_handle h,
 	cvec_free(cvv);
     if (pt1ref)
 	pt_free(pt1ref, 1);
+    cligen_stats_stop(h, CLIGEN_STAT_TREEREF, t0);
     return retval;
 }
 
@@ -521,6 +858,236 @@ cligen_escape(const char* s)
 	return copy;
 }
 
+/* A cached result of an expand callback, see pt_expand_fnv */
+struct expand_entry{
+    struct expand_entry *ee_next;
+    char                *ee_key;       /* Callback, arguments and variable values */
+    int                  ee_gen;       /* Generation, see cligen_expand_cache_gen */
+    struct timeval       ee_time;      /* When the callback was called */
+    cvec                *ee_commands;  /* Result of callback */
+    cvec                *ee_helptexts; /* Result of callback */
+};
+
+/* Cached expand results of a handle, most recently used first */
+struct expand_cache{
+    struct expand_entry *ec_list;
+    int                  ec_len;
+};
+
+/*! Free an expand cache entry
+ */
+static void
+expand_entry_free(struct expand_entry *ee)
+{
+    if (ee->ee_key)
+	free(ee->ee_key);
+    if (ee->ee_commands)
+	cvec_free(ee->ee_commands);
+    if (ee->ee_helptexts)
+	cvec_free(ee->ee_helptexts);
+    free(ee);
+}
+
+/*! Free expand cache of a handle
+ * @param[in]  ec   Expand cache, see cligen_expand_cache_get
+ */
+int
+pt_expand_cache_free(void *ec0)
+{
+    struct expand_cache *ec = (struct expand_cache *)ec0;
+    struct expand_entry *ee;
+
+    if (ec == NULL)
+	return 0;
+    while ((ee = ec->ec_list) != NULL){
+	ec->ec_list = ee->ee_next;
+	expand_entry_free(ee);
+    }
+    free(ec);
+    return 0;
+}
+
+/*! Create key of an expand callback invocation
+ * The key consists of the callback, its name and arguments, and the variables of the command
+ * except the first, which is the whole command line.
+ * @param[in]  co   Expand variable
+ * @param[in]  cvv  Variables of command
+ * @retval     key  Malloced string
+ * @retval     NULL Error
+ */
+static char *
+expand_cache_key(cg_obj *co,
+		 cvec   *cvv)
+{
+    cbuf   *cb;
+    cg_var *cv = NULL;
+    char   *key = NULL;
+    int     i;
+
+    if ((cb = cbuf_new()) == NULL){
+	fprintf(stderr, "%s: cbuf_new: %s\n", __FUNCTION__, strerror(errno));
+	return NULL;
+    }
+    cprintf(cb, "%p\x1f%s", co->co_expandv_fn, co->co_expand_fn_str);
+    while ((cv = cvec_each(co->co_expand_fn_vec, cv)) != NULL){
+	cprintf(cb, "\x1f");
+	if (cv2cbuf(cv, cb) < 0)
+	    goto done;
+    }
+    cprintf(cb, "\x1e");
+    for (i=1; i<cvec_len(cvv); i++){
+	cv = cvec_i(cvv, i);
+	cprintf(cb, "\x1f%s=", cv_name_get(cv)?cv_name_get(cv):"");
+	if (cv2cbuf(cv, cb) < 0)
+	    goto done;
+    }
+    if ((key = strdup(cbuf_get(cb))) == NULL)
+	fprintf(stderr, "%s: strdup: %s\n", __FUNCTION__, strerror(errno));
+ done:
+    cbuf_free(cb);
+    return key;
+}
+
+/*! Look up a fresh cached result of an expand callback
+ *
+ * Stale entries found on the way are dropped, a hit is moved first.
+ * @param[in]  h     CLIgen handle
+ * @param[in]  key   Key, see expand_cache_key
+ * @retval     ee    Cache entry, owned by cache
+ * @retval     NULL  No fresh entry
+ */
+static struct expand_entry *
+expand_cache_lookup(cligen_handle h,
+		    char         *key)
+{
+    struct expand_cache  *ec;
+    struct expand_entry **eep;
+    struct expand_entry  *ee;
+    struct timeval        now;
+    int                   ttl;
+    int                   gen;
+    long                  age;
+
+    if ((ec = cligen_expand_cache_get(h)) == NULL)
+	return NULL;
+    gettimeofday(&now, NULL);
+    ttl = cligen_expand_cache_ttl(h);
+    gen = cligen_expand_cache_gen(h);
+    eep = &ec->ec_list;
+    while ((ee = *eep) != NULL){
+	age = (now.tv_sec - ee->ee_time.tv_sec)*1000 + (now.tv_usec - ee->ee_time.tv_usec)/1000;
+	if (ee->ee_gen != gen || (ttl && age >= ttl)){
+	    *eep = ee->ee_next;
+	    ec->ec_len--;
+	    expand_entry_free(ee);
+	    continue;
+	}
+	if (strcmp(ee->ee_key, key) == 0){
+	    *eep = ee->ee_next;
+	    ee->ee_next = ec->ec_list;
+	    ec->ec_list = ee;
+	    return ee;
+	}
+	eep = &ee->ee_next;
+    }
+    return NULL;
+}
+
+/*! Add a result of an expand callback first in the cache, drop least recently used if full
+ * @param[in]  h          CLIgen handle
+ * @param[in]  key        Key, consumed
+ * @param[in]  commands   Commands, consumed
+ * @param[in]  helptexts  Helptexts, consumed
+ * @retval     0          OK
+ * @retval    -1          Error, nothing is consumed
+ */
+static int
+expand_cache_add(cligen_handle h,
+		 char         *key,
+		 cvec         *commands,
+		 cvec         *helptexts)
+{
+    struct expand_cache  *ec;
+    struct expand_entry **eep;
+    struct expand_entry  *ee;
+    int                   i;
+
+    if ((ec = cligen_expand_cache_get(h)) == NULL){
+	if ((ec = malloc(sizeof(*ec))) == NULL){
+	    fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	    return -1;
+	}
+	memset(ec, 0, sizeof(*ec));
+	cligen_expand_cache_put(h, ec);
+    }
+    if ((ee = malloc(sizeof(*ee))) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	return -1;
+    }
+    memset(ee, 0, sizeof(*ee));
+    ee->ee_key = key;
+    ee->ee_gen = cligen_expand_cache_gen(h);
+    gettimeofday(&ee->ee_time, NULL);
+    ee->ee_commands = commands;
+    ee->ee_helptexts = helptexts;
+    ee->ee_next = ec->ec_list;
+    ec->ec_list = ee;
+    if (++ec->ec_len > CLIGEN_EXPAND_CACHE_MAX){
+	eep = &ec->ec_list;
+	for (i=0; i<CLIGEN_EXPAND_CACHE_MAX; i++)
+	    eep = &(*eep)->ee_next;
+	ee = *eep;
+	*eep = NULL;
+	ec->ec_len--;
+	expand_entry_free(ee);
+    }
+    return 0;
+}
+
+/*! Wait for a pending expansion by serving registered file descriptors
+ *
+ * Returns when the application calls cligen_expand_done or the deadline passes.
+ * The deadline is counted from the start of the line or keystroke, see cligen_expand_left.
+ * @param[in]  h       CLIgen handle
+ * @retval     0       OK, check cligen_expand_pending for deadline
+ * @retval    -1       Error
+ * @see cligen_expand_deadline_set
+ */
+static int
+expand_wait(cligen_handle h)
+{
+#if CLIGEN_REGFD
+    struct timeval end;
+    struct timeval now;
+    struct timeval tv;
+    int            ms;
+    int            left;
+
+    gettimeofday(&end, NULL);
+    ms = cligen_expand_left(h);
+    /* A pre-expansion waits within its budget and until a key is typed */
+    if ((left = cligen_idle_left(h)) >= 0 && left < ms)
+	ms = left;
+    tv.tv_sec = ms/1000;
+    tv.tv_usec = (ms%1000)*1000;
+    timeradd(&end, &tv, &end);
+    while (cligen_expand_pending(h)){
+	gettimeofday(&now, NULL);
+	if (!timercmp(&now, &end, <))
+	    break;
+	if (left >= 0 && gl_input_pending())
+	    break;
+	timersub(&end, &now, &tv);
+	ms = tv.tv_sec*1000 + (tv.tv_usec+999)/1000;
+	if (left >= 0 && ms > CLIGEN_IDLE_SLICE)
+	    ms = CLIGEN_IDLE_SLICE;
+	if (gl_select_timeout(ms) < 0)
+	    return -1;
+    }
+#endif /* CLIGEN_REGFD */
+    return 0;
+}
+
 /*! Call expand callback and insert expanded commands in place of variable
  * variable argument callback variant
  * @param[in]  h       CLIgen handle
@@ -530,6 +1097,10 @@ cligen_escape(const char* s)
  * @param[in]  co      CLIgen object parent
  * @retval     0       OK
  * @retval    -1       Error
+ * If the callback returns CLIGEN_EXPAND_PENDING, wait for the rest of the result, see
+ * expand_wait. An incomplete result is not cached.
+ * In a pre-expansion the callback is not called when its budget is spent or a key is
+ * typed, see cligen_idle_budget_set.
  */
 static int
 pt_expand_fnv(cligen_handle h, 
@@ -539,30 +1110,78 @@ pt_expand_fnv(cligen_handle h,
 	      cg_obj       *co_parent)
 {
     int         retval = -1;
-    cvec       *commands;
-    cvec       *helptexts;
+    cvec       *commands = NULL;
+    cvec       *helptexts = NULL;
     cg_var     *cv = NULL;
     char       *helpstr;
     cg_obj     *con = NULL;
     int         i;
     const char *value;
     const char *escaped;
+    char       *key = NULL;
+    int         cached = 0; /* commands and helptexts are owned by cache */
+    int         ret;
+    int         left;
+    uint64_t    t0;
+    struct expand_entry *ee;
 
     if (cvv == NULL){
 	errno = EINVAL;
 	goto done;
     }
+    if (cligen_expand_cache(h)){
+	if ((key = expand_cache_key(co, cvv)) == NULL)
+	    goto done;
+	if ((ee = expand_cache_lookup(h, key)) != NULL){
+	    free(key);
+	    key = NULL;
+	    commands = ee->ee_commands;
+	    helptexts = ee->ee_helptexts;
+	    cached = 1;
+	    goto expand;
+	}
+    }
+    /* A pre-expansion calls callbacks within its budget and until a key is typed */
+    if ((left = cligen_idle_left(h)) >= 0 && (left == 0 || gl_input_pending())){
+	retval = 0;
+	goto done;
+    }
     if ((commands = cvec_new(0)) == NULL)
 	goto done;
     if ((helptexts = cvec_new(0)) == NULL)
 	goto done;
-    if ((*co->co_expandv_fn)(cligen_userhandle(h)?cligen_userhandle(h):h, 
-			     co->co_expand_fn_str, 
-			     cvv,
-			     co->co_expand_fn_vec,
-			     commands, 
-			     helptexts) < 0)
+    /* The callback may also deliver commands with cligen_expand_add, see cligen_expand_id */
+    cligen_expand_pending_set(h, commands, helptexts);
+    t0 = cligen_stats_start(h);
+    ret = (*co->co_expandv_fn)(cligen_userhandle(h)?cligen_userhandle(h):h, 
+			       co->co_expand_fn_str, 
+			       cvv,
+			       co->co_expand_fn_vec,
+			       commands, 
+			       helptexts);
+    if (ret == CLIGEN_EXPAND_PENDING && cligen_expand_pending(h)){
+	if (expand_wait(h) < 0)
+	    goto done;
+	if (cligen_expand_pending(h)){ /* Deadline passed, use partial result */
+	    cligen_expand_incomplete_set(h);
+	    if (key){ /* Do not cache */
+		free(key);
+		key = NULL;
+	    }
+	}
+    }
+    cligen_expand_pending_set(h, NULL, NULL);
+    cligen_stats_stop(h, CLIGEN_STAT_EXPAND_FN, t0);
+    if (ret < 0)
 	goto done;
+    /* Cache owns the result, it is not modified below */
+    if (key != NULL){
+	if (expand_cache_add(h, key, commands, helptexts) < 0)
+	    goto done;
+	key = NULL;
+	cached = 1;
+    }
+ expand:
     i = 0;
     while ((cv = cvec_each(commands, cv)) != NULL) {
 	if (i < cvec_len(helptexts))
@@ -589,49 +1208,149 @@ pt_expand_fnv(cligen_handle h,
 	    helpstr = NULL;
 	}
     }
-    if (commands)
-	cvec_free(commands);
-    if (helptexts)
-	cvec_free(helptexts);
     retval = 0;
  done:
+    cligen_expand_pending_set(h, NULL, NULL);
+    if (!cached){
+	if (commands)
+	    cvec_free(commands);
+	if (helptexts)
+	    cvec_free(helptexts);
+    }
+    if (key)
+	free(key);
     return retval;
 
 }
 
-/*! Expand a choice rule with actual commands
- * @param[in]  co        Original cligen object (to expand into ptn)
- * @param[out] ptn       New parse-tree initially an empty pointer, its value is returned.
- * @retval     0         OK
- * @retval    -1         Error
+/*! Make a command of one choice of a choice variable, as a shallow object
+ *
+ * The command shares all fields with the variable, except its name which is a string
+ * of the compiled choices of the variable, see co_choice_compile.
+ * @param[in]  co      Choice variable
+ * @param[in]  choice  Choice
+ * @param[out] con     New command object, allocated by caller with pt_block_new
+ */
+static void
+co_expand_choice(cg_obj *co,     
+		 char   *choice,
+		 cg_obj *con)
+{
+    co_expand_shallow(co, con);
+    con->co_type = CO_COMMAND;
+    con->co_command = choice;
+    co_flags_reset(con, CO_FLAGS_META|CO_FLAGS_REST);
+}
+
+/*! Merge a sorted run of keyword positions of ptn into a sorted index
+ * @param[in]     ptn    Expanded parse-tree
+ * @param[in,out] index  Sorted positions, len entries, with space for len+rlen
+ * @param[in]     len    Length of index
+ * @param[in]     run    Sorted positions
+ * @param[in]     rlen   Length of run
+ * @param[out]    tmp    Work space for len+rlen positions
+ * @retval        len    New length of index
+ */
+static int
+pt_expand_index_merge(parse_tree *ptn,
+		      int        *index,
+		      int         len,
+		      int        *run,
+		      int         rlen,
+		      int        *tmp)
+{
+    int i = 0;
+    int j = 0;
+    int k = 0;
+
+    while (i < len && j < rlen){
+	if (strcmp(pt_vec_i_get(ptn, index[i])->co_command,
+		   pt_vec_i_get(ptn, run[j])->co_command) <= 0)
+	    tmp[k++] = index[i++];
+	else
+	    tmp[k++] = run[j++];
+    }
+    while (i < len)
+	tmp[k++] = index[i++];
+    while (j < rlen)
+	tmp[k++] = run[j++];
+    memcpy(index, tmp, k*sizeof(int));
+    return k;
+}
+
+/*! Derive the keyword index of an expanded parse-tree from the index of the original
+ *
+ * Shallow objects in ptn keep the command names of the originals, so the sorted order
+ * of the original index is reused, only positions are translated. Commands of choice
+ * variables are sorted when compiled, each choice variable gives a sorted run that is
+ * merged into the index. This makes the cost linear instead of sorting ptn again.
+ * @param[in] pt     Original parse-tree
+ * @param[in] ptn    Expanded and sorted parse-tree
+ * @param[in] block  Block of shallow objects in ptn
+ * @param[in] nblock Number of objects in block
+ * @param[in] bi     Block slot of each child in pt, or -1 if not copied to block
+ * @param[in] runs   First block slot and number of choices of each choice variable
+ * @param[in] nruns  Number of choice variables
+ * @retval    0      OK
+ * @retval   -1      Error
+ * @see pt_index_lookup
  */
 static int
-pt_expand_choice(cg_obj       *co,     
-		 parse_tree   *ptn)
+pt_expand_index(parse_tree *pt,
+		parse_tree *ptn,
+		cg_obj     *block,
+		int         nblock,
+		int        *bi,
+		int        *runs,
+		int         nruns)
 {
     int     retval = -1;
-    char   *ccmd;
-    char   *cp = NULL;
-    char   *c;
-    cg_obj *con = NULL;
+    int    *pos = NULL;
+    int    *index = NULL;
+    int    *tmp = NULL;
+    int    *index0;
+    int     len0;
+    int     len = 0;
+    int     rlen;
+    int     k;
+    int     j;
+    int     r;
+    cg_obj *con;
 
-    /* parse co_command and get alternatives <alt:hej,hopp> */
-    if (co->co_choice){
-	cp = ccmd = strdup(co->co_choice);
-	while ((c = strsep(&ccmd, ",|")) != NULL){
-	    con = NULL;
-	    if (co_expand_sub(co, NULL, &con) < 0)
-		goto done;
-	    if (pt_vec_append(ptn, con) < 0)
-		goto done;
-	    if (transform_var_to_cmd(con, strdup(c), NULL) < 0) 
-		goto done;
+    if ((index0 = pt_index_get(pt, &len0)) == NULL && len0 < 0)
+	goto done;
+    if ((pos = malloc(nblock*sizeof(int))) == NULL ||
+	(index = malloc(nblock*sizeof(int))) == NULL ||
+	(nruns && (tmp = malloc(nblock*sizeof(int))) == NULL)){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	goto done;
+    }
+    for (k=0; k<pt_len_get(ptn); k++)
+	if ((con = pt_vec_i_get(ptn, k)) != NULL &&
+	    co_flags_get(con, CO_FLAGS_SHALLOW))
+	    pos[con - block] = k;
+    for (j=0; j<len0; j++)
+	if (bi[index0[j]] != -1)
+	    index[len++] = pos[bi[index0[j]]];
+    /* Choices are appended after the index, as the run to merge */
+    for (r=0; r<nruns; r++){
+	rlen = 0;
+	for (j=0; j<runs[2*r+1]; j++){
+	    con = &block[runs[2*r]+j];
+	    if (con->co_command[0] != '"') /* As pt_index_keyword */
+		index[len+rlen++] = pos[runs[2*r]+j];
 	}
+	len = pt_expand_index_merge(ptn, index, len, index+len, rlen, tmp);
     }
-    retval = 0;
+    retval = pt_index_set(ptn, index, len); /* index is consumed */
+    index = NULL;
  done:
-    if (cp)
-	free(cp);
+    if (pos)
+	free(pos);
+    if (index)
+	free(index);
+    if (tmp)
+	free(tmp);
     return retval;
 }
 
@@ -644,6 +1363,9 @@ pt_expand_choice(cg_obj       *co,
  * The structure of the new parsetree ptn is a little peculiar, it only creates a new top-level
  * with new, temporary expanded cg-objects, but they in turn point back to the original
  * parse-tree. Therefore this new parse-tree cannot be free:d recursively.
+ * Static objects are not copied: they are shallow objects in a block owned by ptn that
+ * share all fields with the original. Choices are also shallow objects, named by the
+ * compiled choices of the variable. Only expand objects are allocated.
  * @param[in]  h       Cligen handle
  * @param[in]  pt      Original parse-tree consisting of a vector of cligen objects
  * @param[out] cvv     Cligen variable vector containing vars/values pair for completion
@@ -652,6 +1374,8 @@ pt_expand_choice(cg_obj       *co,
  * @param[out] ptn     New parse-tree initially an empty pointer, its value is returned.
  * @retval     0       OK
  * @retval    -1       Error
+ * @note Threads: ptn is private to the caller, but the expanded values of pt are cleared,
+ *       so pt must belong to the calling thread, see match_pattern
  */
 int
 pt_expand(cligen_handle h, 
@@ -662,26 +1386,75 @@ pt_expand(cligen_handle h,
 	  parse_tree   *ptn)
 {
     int     i;
+    int     j;
     cg_obj *co;
     cg_obj *con = NULL;
+    cg_obj *block;
+    int     n = 0;
+    int     nblock = 0;
+    int     nruns = 0;
+    int    *bi = NULL;
+    int    *runs = NULL;
     int     retval = -1;
+    uint64_t t0;
 
+    t0 = cligen_stats_start(h);
     pt_sets_set(ptn, pt_sets_get(pt));
     if (pt_len_get(pt) == 0)
 	goto ok;
+    /* Block slots: one per child, and one per choice of choice variables */
+    for (i=0; i<pt_len_get(pt); i++){
+	if ((co = pt_vec_i_get(pt, i)) != NULL &&
+	    co->co_type == CO_VARIABLE && co->co_choice != NULL){
+	    if (co->co_choicevec == NULL && co_choice_compile(co) < 0)
+		goto done;
+	    nblock += co->co_choicelen;
+	    nruns++;
+	}
+	else
+	    nblock++;
+    }
+    if (nblock == 0)
+	nblock = 1;
+    /* Static objects are not copied, but referenced by shallow objects in one block */
+    if ((block = pt_block_new(ptn, nblock)) == NULL)
+	goto done;
+    /* Wide levels get a keyword index: record block slot of each original child */
+    if (nblock >= PT_INDEX_MIN){
+	if ((bi = malloc(pt_len_get(pt)*sizeof(int))) == NULL ||
+	    (nruns && (runs = malloc(2*nruns*sizeof(int))) == NULL)){
+	    fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	    goto done;
+	}
+	memset(bi, 0xff, pt_len_get(pt)*sizeof(int)); /* -1 */
+	nruns = 0;
+    }
     for (i=0; i<pt_len_get(pt); i++){ /* Build ptn (new) from pt (orig) */
 	if ((co = pt_vec_i_get(pt, i)) != NULL){
 	    if (co_value_set(co, NULL) < 0)
 		goto done;
 	    if (hide && co_flags_get(co, CO_FLAGS_HIDE))
 		continue;
+	    /* Resolve expand function on first use, see cligen_fn_register */
+	    if (co->co_type == CO_VARIABLE &&
+		co->co_expand_fn_str != NULL && co->co_expandv_fn == NULL)
+		co->co_expandv_fn = (expandv_cb*)cligen_fn_lookup(h, CLIGEN_FN_EXPAND, co->co_expand_fn_str);
 	    /*
 	     * Choice variable - Insert the static choices as commands in place
 	     * of the variable
 	     */
 	    if (co->co_type == CO_VARIABLE && co->co_choice != NULL){
-		if (pt_expand_choice(co, ptn) < 0)
-		    goto done;
+		if (runs){
+		    runs[2*nruns] = n;
+		    runs[2*nruns+1] = co->co_choicelen;
+		    nruns++;
+		}
+		for (j=0; j<co->co_choicelen; j++){
+		    con = &block[n++];
+		    co_expand_choice(co, co->co_choicevec[j], con);
+		    if (pt_vec_append(ptn, con) < 0)
+			goto done;
+		}
 	    }
 	    /* Expand variable - call expand callback and insert expanded
 	     * commands in place of the variable
@@ -701,10 +1474,11 @@ pt_expand(cligen_handle h,
 			goto done;
 	    }
 	    else{
-		/* Copy original cg_obj to shadow list*/
-		con = NULL;
-		if (co_expand_sub(co, NULL, &con) < 0)
-		    goto done;
+		/* Shallow copy of original cg_obj to shadow list*/
+		if (bi)
+		    bi[i] = n;
+		con = &block[n++];
+		co_expand_shallow(co, con);
 		if (pt_vec_append(ptn, con) < 0)
 		    goto done;
 	    }
@@ -713,7 +1487,10 @@ pt_expand(cligen_handle h,
 	    pt_realloc(ptn); /* empty child */
 	}
     } /* for */
-    cligen_parsetree_sort(ptn, 1);
+    /* Only new level needs sorting, sub-trees are the original ones */
+    cligen_parsetree_sort(ptn, 0);
+    if (bi && pt_expand_index(pt, ptn, block, nblock, bi, runs, nruns) < 0)
+	goto done;
     if (cligen_logsyntax(h) > 0){
 	fprintf(stderr, "%s:\n", __FUNCTION__);
 	pt_print(stderr, ptn, 0);
@@ -721,6 +1498,11 @@ pt_expand(cligen_handle h,
  ok:
     retval = 0;
  done:
+    if (bi)
+	free(bi);
+    if (runs)
+	free(runs);
+    cligen_stats_stop(h, CLIGEN_STAT_EXPAND, t0);
     return retval;
 }
 
@@ -761,6 +1543,56 @@ pt_expand_treeref_cleanup(parse_tree *pt)
     return retval;
 }
 
+/*! Flush cached tree references in all parse-trees if they have been invalidated
+ *
+ * Expanded tree references (@tree) are kept in place between commands if the treeref
+ * cache is enabled. The expansion depends on the referenced parse-trees, their working
+ * points and the reftree filter. When any of those change the cache is invalidated and
+ * the expansions are removed here, before they are next used.
+ * @param[in] h    CLIgen handle
+ * @retval    0    OK
+ * @retval   -1    Error
+ * @see cligen_treeref_cache_invalidate
+ */
+int
+pt_expand_treeref_flush(cligen_handle h)
+{
+    int         retval = -1;
+    pt_head    *ph = NULL;
+    parse_tree *pt;
+
+    if (!cligen_treeref_cache_dirty(h))
+	goto ok;
+    while ((ph = cligen_ph_each(h, ph)) != NULL)
+	if ((pt = cligen_ph_parsetree_get(ph)) != NULL &&
+	    pt_expand_treeref_cleanup(pt) < 0)
+	    goto done;
+    /* Compiled states point into the removed sub-trees */
+    if (cligen_compile_invalidate(h) < 0)
+	goto done;
+    cligen_treeref_cache_clean(h);
+ ok:
+    retval = 0;
+ done:
+    return retval;
+}
+
+/*! Release expanded tree references after use, unless they are cached
+ * @param[in] h    CLIgen handle
+ * @param[in] pt   Parsetree
+ * @retval    0    OK
+ * @retval   -1    Error
+ * @see pt_expand_treeref_flush
+ */
+int
+pt_expand_treeref_release(cligen_handle h,
+			  parse_tree   *pt)
+{
+    if (cligen_treeref_cache(h))
+	return 0;
+    return pt_expand_treeref_cleanup(pt);
+}
+
 /*! Go through tree and clean & delete all extra memory from pt_expand()
  * More specifically, delete all co_values and co_pt_exp.
  * @param[in] pt   Parsetree
@@ -52,6 +52,26 @@
 #define CLIGEN_REF_ADD "@add:"
 #define CLIGEN_REF_REMOVE "@remove:"
 
+/* Default lifetime in ms of cached expand callback results, see cligen_expand_cache_set */
+#define CLIGEN_EXPAND_CACHE_TTL 2000
+
+/* Max number of cached expand callback results, least recently used are dropped */
+#define CLIGEN_EXPAND_CACHE_MAX 64
+
+/* Return value of an expand callback (expandv_cb) whose commands are delivered later,
+ * see cligen_expand_add */
+#define CLIGEN_EXPAND_PENDING 2
+
+/* Default time in ms to wait for pending expand results, see cligen_expand_deadline_set */
+#define CLIGEN_EXPAND_DEADLINE 500
+
+/* Max time in ms between checks for typed keys while a pre-expansion waits for pending
+ * expand results, see cligen_idle_expand_set */
+#define CLIGEN_IDLE_SLICE 10
+
+/* Shown after the help of an expansion that did not complete before the deadline */
+#define CLIGEN_EXPAND_INCOMPLETE "(incomplete)"
+
 /*
  * Types
  */
@@ -61,11 +81,15 @@
  * Prototypes
  */
 int pt_expand_treeref(cligen_handle h, cg_obj *coprev, parse_tree *pt);
+int cligen_parsetree_labels(cligen_handle h, parse_tree *pt);
 int pt_expand(cligen_handle h, parse_tree *pt, cvec *cvec, int hide, int expandv, parse_tree *ptn);
 int pt_expand_treeref_cleanup(parse_tree *pt);
+int pt_expand_treeref_flush(cligen_handle h);
+int pt_expand_treeref_release(cligen_handle h, parse_tree *pt);
 int pt_expand_cleanup(parse_tree *pt);
 int reference_path_match(cg_obj *co1, parse_tree *pt0, cg_obj **co0p);
 int transform_var_to_cmd(cg_obj *co, char *cmd, char *comment);
+int pt_expand_cache_free(void *ec);
 
 #endif /* _CLIGEN_EXPAND_H_ */
 
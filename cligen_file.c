@@ -36,15 +36,29 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
 #include <netinet/in.h>
+#include <signal.h>
 
 #include <cligen/cligen.h>
 
+/* Number of commands of many() expand function */
+#define CLI_EXPAND_MANY 20000
+
+/* Server of -N, and the spec file and options used by reload() */
+static cligen_server *_server = NULL;
+static char          *_specfile = NULL;
+static char          *_specdir = NULL;
+static int            _set_expand = 0;
+
+static int reload(cligen_handle handle, cvec *cvv, cvec *argv);
+
 /*! General callback for executing shells. 
  * The argument is a command followed by arguments as defined in the input syntax.
  * Simple example:
@@ -121,6 +135,156 @@ callback(cligen_handle handle, cvec *cvv, cvec *argv)
     return 0;
 }
 
+/*! CLI callback printing numbered lines on stdout through output filters
+ *
+ * The first argument is the number of lines. Each keyword include, exclude or begin
+ * followed by a regexp variable, and count, attach an output filter.
+ * Every other line is output as a cbuf. With a second argument "stdio" every third line
+ * is printed with printf instead, and with "stderr" each line is also output to stderr.
+ * Syntax example: lines [include <re:string>] [count], lines("100");
+ */
+int
+lines(cligen_handle handle, cvec *cvv, cvec *argv)
+{
+    cg_var *cv = NULL;
+    cbuf   *cb;
+    char   *name;
+    char   *mode = "";
+    int     n = 10;
+    int     i;
+
+    if (argv && cvec_len(argv) > 0)
+	n = atoi(cv_string_get(cvec_i(argv, 0)));
+    if (argv && cvec_len(argv) > 1)
+	mode = cv_string_get(cvec_i(argv, 1));
+    while ((cv = cvec_each1(cvv, cv)) != NULL) {
+	name = cv_name_get(cv);
+	if (strcmp(name, "count") == 0)
+	    cligen_output_filter_add(handle, CLIGEN_FILTER_COUNT, NULL);
+	else if ((strcmp(name, "include") == 0 ||
+		  strcmp(name, "exclude") == 0 ||
+		  strcmp(name, "begin") == 0) &&
+		 cvec_next(cvv, cv) != NULL)
+	    cligen_output_filter_add(handle,
+				     name[0]=='i'?CLIGEN_FILTER_INCLUDE:
+				     name[0]=='e'?CLIGEN_FILTER_EXCLUDE:CLIGEN_FILTER_BEGIN,
+				     cv_string_get(cvec_next(cvv, cv)));
+    }
+    if ((cb = cbuf_new()) == NULL)
+	return -1;
+    for (i=0; i<n; i++){
+	if (strcmp(mode, "stderr") == 0 &&
+	    cligen_output(stderr, "err %d\n", i) < 0)
+	    break;
+	if (strcmp(mode, "stdio") == 0 && i%3 == 2)
+	    printf("line %d\n", i);
+	else if (i%2){
+	    cbuf_reset(cb);
+	    cprintf(cb, "line %d\n", i);
+	    if (cligen_output_cbuf(stdout, cb) < 0)
+		break;
+	}
+	else if (cligen_output(stdout, "line %d\n", i) < 0)
+	    break;
+    }
+    cbuf_free(cb);
+    return i<n ? -1 : 0;
+}
+
+/*! CLI callback renaming a variable of the command and looking it up by its new name
+ *
+ * The variable is first looked up by its old name a few times so that the name index
+ * of a large variable vector is built, which is invalidated after renaming, see cvec_find.
+ * Syntax example: r <a:int32> <b:int32>, rename("a", "x");
+ */
+int
+rename_cb(cligen_handle handle, cvec *cvv, cvec *argv)
+{
+    cg_var *cv = NULL;
+    char   *from;
+    char   *to;
+    char    buf[64];
+    int     i;
+
+    if (argv == NULL || cvec_len(argv) != 2){
+	fprintf(stderr, "%s: expected <from> <to>\n", __FUNCTION__);
+	return -1;
+    }
+    from = cv_string_get(cvec_i(argv, 0));
+    to = cv_string_get(cvec_i(argv, 1));
+    for (i=0; i<8; i++)
+	if ((cv = cvec_find(cvv, from)) == NULL)
+	    break;
+    if (cv == NULL || cv_name_set(cv, to) == NULL)
+	return -1;
+    /* Renamed in place, the index does not follow */
+    if (cvec_index_invalidate(cvv) < 0)
+	return -1;
+    if ((cv = cvec_find(cvv, to)) == NULL){
+	cligen_output(stdout, "%s: not found\n", to);
+	return 0;
+    }
+    cv2str(cv, buf, sizeof(buf)-1);
+    cligen_output(stdout, "%s: %s\n", to, buf);
+    if (cvec_find(cvv, from) != NULL)
+	cligen_output(stdout, "%s: still found\n", from);
+    return 0;
+}
+
+/*! CLI callback setting the reftree filter to the labels given as arguments
+ *
+ * Without arguments the filter is removed, see cligen_reftree_filter_set.
+ * Syntax example: filter, filter("local");
+ */
+int
+filter_cb(cligen_handle handle, cvec *cvv, cvec *argv)
+{
+    cvec   *filter = NULL;
+    cg_var *cv = NULL;
+    cg_var *cv1;
+
+    if (argv && cvec_len(argv) > 0){
+	if ((filter = cvec_new(0)) == NULL)
+	    return -1;
+	while ((cv = cvec_each(argv, cv)) != NULL){
+	    if ((cv1 = cvec_add(filter, CGV_STRING)) == NULL ||
+		cv_name_set(cv1, cv_string_get(cv)) == NULL){
+		cvec_free(filter);
+		return -1;
+	    }
+	}
+    }
+    return cligen_reftree_filter_set(handle, filter);
+}
+
+/*! CLI callback swapping the parse-trees of two trees, see cligen_ph_parsetree_set
+ *
+ * The command must not be in one of the trees.
+ * Syntax example: swap, treeswap("a", "b");
+ */
+int
+treeswap(cligen_handle handle, cvec *cvv, cvec *argv)
+{
+    pt_head    *ph0;
+    pt_head    *ph1;
+    parse_tree *pt0;
+
+    if (argv == NULL || cvec_len(argv) != 2){
+	fprintf(stderr, "%s: expected <tree> <tree>\n", __FUNCTION__);
+	return -1;
+    }
+    if ((ph0 = cligen_ph_find(handle, cv_string_get(cvec_i(argv, 0)))) == NULL ||
+	(ph1 = cligen_ph_find(handle, cv_string_get(cvec_i(argv, 1)))) == NULL){
+	fprintf(stderr, "%s: tree not found\n", __FUNCTION__);
+	return -1;
+    }
+    pt0 = cligen_ph_parsetree_get(ph0);
+    if (cligen_ph_parsetree_set(ph0, cligen_ph_parsetree_get(ph1)) < 0 ||
+	cligen_ph_parsetree_set(ph1, pt0) < 0)
+	return -1;
+    return 0;
+}
+
 /*! Example of static string to function mapper
  * Note, the syntax need to something like: "a{help}, callback(42)"
  */
@@ -132,9 +296,52 @@ str2fn(char *name, void *arg, char **error)
 	return callback;
     if (strcmp(name, "cligen_exec_cb") == 0)
 	return cligen_exec_cb;
+    if (strcmp(name, "lines") == 0)
+	return lines;
+    if (strcmp(name, "reload") == 0)
+	return reload;
+    if (strcmp(name, "filter") == 0)
+	return filter_cb;
+    if (strcmp(name, "treeswap") == 0)
+	return treeswap;
+    if (strcmp(name, "cligen_wp_set") == 0)
+	return cligen_wp_set;
+    if (strcmp(name, "cligen_wp_up") == 0)
+	return cligen_wp_up;
+    if (strcmp(name, "cligen_wp_top") == 0)
+	return cligen_wp_top;
     return callback; /* allow any function (for testing) */
 }
 
+/* Request of async(), the id identifies the expansion the result belongs to */
+struct cli_expand_req {
+    cligen_handle er_h;
+    int           er_id;
+};
+
+/*! Deliver result of async() when its pipe is readable, see cli_expand_cb
+ */
+static int
+cli_expand_async_cb(int   fd,
+		    void *arg)
+{
+    struct cli_expand_req *er = (struct cli_expand_req *)arg;
+    char                   c;
+    int                    retval = -1;
+
+    if (read(fd, &c, 1) < 0)
+	goto done;
+    cligen_expand_add(er->er_h, er->er_id, "async1", "Help async1");
+    cligen_expand_add(er->er_h, er->er_id, "async2", "Help async2");
+    cligen_expand_done(er->er_h, er->er_id);
+    retval = 0;
+ done:
+    cligen_unregfd(fd);
+    close(fd);
+    free(er);
+    return retval;
+}
+
 /*! Example of expansion(completion) function. 
  * It is called every time a variable of the form <expand> needs to be evaluated.
  * Note the mallocing of vectors which could probably be done in a
@@ -157,6 +364,59 @@ cli_expand_cb(cligen_handle h,
 	cvec_add_string(commands, NULL, "exp2"); cvec_add_string(helptexts, NULL, "Help exp2");
 	cvec_add_string(commands, NULL, "exp3"); cvec_add_string(helptexts, NULL, "Help exp3");
     }
+    else if (strcmp(fn_str,"count")==0){ /* New command on each call, to test -C */
+	static int count = 0;
+	char       str[16];
+
+	snprintf(str, sizeof(str), "cnt%d", count++);
+	cvec_add_string(commands, NULL, str); cvec_add_string(helptexts, NULL, "Help count");
+    }
+    else if (strcmp(fn_str,"many")==0){ /* Large expansion */
+	char str[16];
+	int  i;
+
+	if (cvec_reserve(commands, CLI_EXPAND_MANY) < 0 ||
+	    cvec_reserve(helptexts, CLI_EXPAND_MANY) < 0)
+	    return -1;
+	for (i=0; i<CLI_EXPAND_MANY; i++){
+	    snprintf(str, sizeof(str), "many%d", i);
+	    cvec_add_string(commands, NULL, str); cvec_add_string(helptexts, NULL, "Help many");
+	}
+    }
+    else if (strcmp(fn_str,"async")==0){ /* Result delivered via event loop */
+	struct cli_expand_req *er;
+	int                    fds[2];
+
+	if (pipe(fds) < 0)
+	    return -1;
+	if (write(fds[1], "x", 1) < 0)
+	    return -1;
+	close(fds[1]);
+	if ((er = malloc(sizeof(*er))) == NULL)
+	    return -1;
+	er->er_h = h;
+	er->er_id = cligen_expand_id(h);
+	if (cligen_regfd(fds[0], cli_expand_async_cb, er) < 0){
+	    free(er);
+	    return -1;
+	}
+	return CLIGEN_EXPAND_PENDING;
+    }
+    else if (strcmp(fn_str,"slow")==0){ /* Never done, partial result after deadline */
+	cligen_expand_add(h, cligen_expand_id(h), "slow1", "Help slow1");
+	return CLIGEN_EXPAND_PENDING;
+    }
+    else if (strcmp(fn_str,"late")==0){ /* Result of previous expansion arrives late */
+	static int id0 = 0;
+	int        id = cligen_expand_id(h);
+
+	if (id0 && cligen_expand_add(h, id0, "late0", "Help late0") == 0)
+	    return -1;
+	id0 = id;
+	cligen_expand_add(h, id, "late1", "Help late1");
+	cligen_expand_done(h, id);
+	return CLIGEN_EXPAND_PENDING;
+    }
     else{
 	cvec_add_string(commands, NULL, "exp2");  cvec_add_string(helptexts, NULL, "Help exp2");
     }
@@ -167,6 +427,23 @@ cli_expand_cb(cligen_handle h,
     return 0;
 }
 
+/*! Per-line trace hook of -T, see cligen_stats_fn_set
+ */
+static int
+cli_stats_line(cligen_handle h,
+	       char         *line,
+	       cligen_stats *cs,
+	       void         *arg)
+{
+    fprintf(stderr, "trace: \"%s\" match:%" PRIu64 " eval:%" PRIu64 " new:%" PRIu64 " freed:%" PRIu64 "\n",
+	    line,
+	    cs->cs_calls[CLIGEN_STAT_MATCH],
+	    cs->cs_calls[CLIGEN_STAT_EVAL],
+	    cs->cs_co_new,
+	    cs->cs_co_free);
+    return 0;
+}
+
 /*! Trivial function translator/mapping function that just assigns same callback
  */
 static expandv_cb *
@@ -175,21 +452,254 @@ str2fn_exp(char *name, void *arg, char **error)
     return cli_expand_cb;
 }
 
+/*! Parse changed files of the spec directory (-D) again, updating their trees in place
+ * @param[in] h   CLIgen handle
+ */
+static int
+reload_dir(cligen_handle h)
+{
+    pt_head    *ph = NULL;
+    parse_tree *pt;
+    int         n;
+
+    if ((n = cligen_parse_files_reload(h, _specdir, ".cli", NULL)) < 0)
+	return -1;
+    /* Only new objects are mapped */
+    while ((ph = cligen_ph_each(h, ph)) != NULL) {
+	if ((pt = cligen_ph_parsetree_get(ph)) == NULL)
+	    continue;
+	if (cligen_callbackv_str2fn(pt, str2fn, NULL) < 0)
+	    return -1;
+	if (_set_expand &&
+	    cligen_expandv_str2fn(pt, str2fn_exp, NULL) < 0)
+	    return -1;
+    }
+    cligen_output(stdout, "reload: files:%d\n", n);
+    return 0;
+}
+
+/*! CLI callback of server mode (-N) loading the spec file again as a new version
+ *
+ * Sessions move to the new version before their next command, this command is done
+ * with the old version.
+ * Without server mode, changed files of the spec directory (-D) are parsed again and
+ * their trees are updated in place. The command must not be in a changed file.
+ * Syntax example: reload, reload();
+ */
+static int
+reload(cligen_handle handle, cvec *cvv, cvec *argv)
+{
+    int           retval = -1;
+    cligen_handle h = NULL;
+    cligen_spec  *sp = NULL;
+    pt_head      *ph = NULL;
+    parse_tree   *pt;
+    cvec         *globals = NULL;
+    FILE         *f = NULL;
+    char         *str;
+
+    if (_server == NULL && _specdir != NULL)
+	return reload_dir(handle);
+    if (_server == NULL || _specfile == NULL){
+	cligen_output(stdout, "reload: requires -N and -f, or -D\n");
+	goto done;
+    }
+    h = cligen_init();
+    if (h == NULL)
+	goto done;
+    cligen_lexicalorder_set(h, 1);
+    cligen_ignorecase_set(h, 1);
+    if ((globals = cvec_new(0)) == NULL)
+	goto done;
+    if ((f = fopen(_specfile, "r")) == NULL){
+	cligen_output(stdout, "fopen(%s): %s\n", _specfile, strerror(errno));
+	goto done;
+    }
+    if (cligen_parse_file(h, f, _specfile, NULL, globals) < 0)
+	goto done;
+    while ((ph = cligen_ph_each(h, ph)) != NULL) {
+	if ((pt = cligen_ph_parsetree_get(ph)) == NULL)
+	    continue;
+	if (cligen_callbackv_str2fn(pt, str2fn, NULL) < 0)
+	    goto done;
+	if (_set_expand &&
+	    cligen_expandv_str2fn(pt, str2fn_exp, NULL) < 0)
+	    goto done;
+    }
+    if ((str = cvec_find_str(globals, "prompt")) != NULL)
+	cligen_prompt_set(h, str);
+    if ((sp = cligen_spec_new(h)) == NULL)
+	goto done;
+    h = NULL; /* owned by spec */
+    if (cligen_server_spec_set(_server, sp) < 0)
+	goto done;
+    cligen_output(stdout, "spec version %d\n", cligen_spec_version(sp));
+    retval = 0;
+ done:
+    if (sp)
+	cligen_spec_release(sp);
+    if (h)
+	cligen_exit(h);
+    if (globals)
+	cvec_free(globals);
+    if (f)
+	fclose(f);
+    return retval;
+}
+
+/*! Serve a session on stdin/stdout from a server sharing the parse-trees of h
+ * @param[in] h   CLIgen handle with parse-trees, owned by the server spec after the call
+ */
+static int
+server_run(cligen_handle h)
+{
+    int          retval = -1;
+    cligen_spec *sp;
+    int          fd;
+
+    if ((sp = cligen_spec_new(h)) == NULL){
+	cligen_exit(h);
+	goto done;
+    }
+    _server = cligen_server_new(sp);
+    cligen_spec_release(sp);
+    if (_server == NULL)
+	goto done;
+    signal(SIGPIPE, SIG_IGN);
+    if ((fd = dup(1)) < 0)
+	goto done;
+    if (cligen_session_new(_server, 0, fd) == NULL)
+	goto done;
+    if (cligen_server_loop(_server) < 0)
+	goto done;
+    retval = 0;
+ done:
+    if (_server){
+	cligen_server_free(_server);
+	_server = NULL;
+    }
+    return retval;
+}
+
+/*! Validate lines of stdin with nworkers threads without invoking callbacks
+ * @param[in] h         CLIgen handle
+ * @param[in] nworkers  Number of worker threads
+ */
+static int
+validate_run(cligen_handle h,
+	     int           nworkers)
+{
+    int                     retval = -1;
+    char                  **lines = NULL;
+    cligen_validate_result *vr = NULL;
+    int                     nlines = 0;
+    int                     maxlines = 0;
+    char                   *line = NULL;
+    size_t                  len = 0;
+    ssize_t                 n;
+    int                     failed;
+    int                     i;
+
+    while ((n = getline(&line, &len, stdin)) >= 0){
+	if (n > 0 && line[n-1] == '\n')
+	    line[n-1] = '\0';
+	if (nlines == maxlines){
+	    maxlines = maxlines ? 2*maxlines : 64;
+	    if ((lines = realloc(lines, maxlines*sizeof(char*))) == NULL)
+		goto done;
+	}
+	lines[nlines++] = line;
+	line = NULL;
+	len = 0;
+    }
+    if ((vr = calloc(nlines?nlines:1, sizeof(*vr))) == NULL)
+	goto done;
+    if ((failed = cligen_validate_lines(h, lines, nlines, nworkers, NULL, vr)) < 0)
+	goto done;
+    for (i=0; i<nlines; i++){
+	if (vr[i].vr_result == CG_MATCH)
+	    continue;
+	fprintf(stderr, "%d: CLI syntax error in: \"%s\": %s\n", i+1, lines[i],
+		vr[i].vr_result==CG_MULTIPLE?"Ambiguous command":
+		vr[i].vr_reason?vr[i].vr_reason:"Unknown command");
+    }
+    fprintf(stdout, "validate: lines:%d failed:%d\n", nlines, failed);
+    retval = 0;
+ done:
+    if (line)
+	free(line);
+    if (vr){
+	for (i=0; i<nlines; i++)
+	    if (vr[i].vr_reason)
+		free(vr[i].vr_reason);
+	free(vr);
+    }
+    if (lines){
+	for (i=0; i<nlines; i++)
+	    free(lines[i]);
+	free(lines);
+    }
+    return retval;
+}
+
+/* Functions registered with -R, resolved on first use instead of by str2fn */
+static cligen_fn_entry fn_callbacks[] = {
+    {"callback",       CLIGEN_FN_CALLBACK, (cligen_fn_t*)callback},
+    {"cligen_exec_cb", CLIGEN_FN_CALLBACK, (cligen_fn_t*)cligen_exec_cb},
+    {"lines",          CLIGEN_FN_CALLBACK, (cligen_fn_t*)lines},
+    {"rename",         CLIGEN_FN_CALLBACK, (cligen_fn_t*)rename_cb},
+    {"filter",         CLIGEN_FN_CALLBACK, (cligen_fn_t*)filter_cb},
+    {"treeswap",       CLIGEN_FN_CALLBACK, (cligen_fn_t*)treeswap},
+    {"cligen_wp_set",  CLIGEN_FN_CALLBACK, (cligen_fn_t*)cligen_wp_set},
+    {"cligen_wp_up",   CLIGEN_FN_CALLBACK, (cligen_fn_t*)cligen_wp_up},
+    {"cligen_wp_top",  CLIGEN_FN_CALLBACK, (cligen_fn_t*)cligen_wp_top},
+};
+
+static cligen_fn_entry fn_expands[] = {
+    {"exp",   CLIGEN_FN_EXPAND, (cligen_fn_t*)cli_expand_cb},
+    {"other", CLIGEN_FN_EXPAND, (cligen_fn_t*)cli_expand_cb},
+    {"count", CLIGEN_FN_EXPAND, (cligen_fn_t*)cli_expand_cb},
+    {"many",  CLIGEN_FN_EXPAND, (cligen_fn_t*)cli_expand_cb},
+    {"async", CLIGEN_FN_EXPAND, (cligen_fn_t*)cli_expand_cb},
+    {"slow",  CLIGEN_FN_EXPAND, (cligen_fn_t*)cli_expand_cb},
+    {"late",  CLIGEN_FN_EXPAND, (cligen_fn_t*)cli_expand_cb},
+};
+
 /*
  * Global variables.
  */
 static void 
 usage(char *argv)
 {
-    fprintf(stderr, "Usage:%s [-h][-f <filename>][-1][-p][-P], where the optoions have the following meaning:\n"
+    fprintf(stderr, "Usage:%s [-h][-f <filename>][-1][-b][-B][-p][-P][-S][-I][-r][-c][-K][-m][-C <ms>][-T][-R][-H <file>][-u][-M <nr>][-N], where the optoions have the following meaning:\n"
 	    "\t-h \t\tHelp\n"
 	    "\t-f <file> \tConfig-file (or stdin)\n"
+	    "\t-D <dir> \tLoad all *.cli files in dir, each in a tree named after the file\n"
 	    "\t-1 \t\tOnce only. Do not enter interactive mode\n"
+	    "\t-b \t\tBatch mode: evaluate commands from stdin without line editing\n"
+	    "\t-B \t\tBatch mode, stop at first failed command\n"
 	    "\t-p \t\tPrint syntax\n"
 	    "\t-e \t\tSet automatic expansion/completion for all expand() functions\n"
 	    "\t-P \t\tSet preference mode to 1, ie return first if several have same pref\n"
+	    "\t-S \t\tShare referenced trees (@tree) instead of copying them\n"
+	    "\t-I \t\tIntern strings of parse-tree objects\n"
+	    "\t-r \t\tCache expanded tree references (@tree) between commands\n"
+	    "\t-c \t\tMatch lines with compiled matcher first, implies -r\n"
+	    "\t-K \t\tResume TAB and ? from the match state of the previous keystroke, implies -r\n"
+	    "\t-m \t\tDo not memoize variable matches of a line\n"
+	    "\t-C <ms> \tCache results of expand functions for ms milliseconds, 0: no limit\n"
+	    "\t-A \t\tAllocate parse-tree objects from slab\n"
+	    "\t-T \t\tTrace counters of each line and print phase statistics and memory on exit\n"
+	    "\t-R \t\tRegister functions by name, resolved on first use, instead of mapping all trees\n"
+	    "\t-i <file> \tPrecompiled image of config-file, used if fresh, otherwise written\n"
 	    "\t-t <nr> \tSet tab mode: 1:columns, 2: same pref for vars, 4: all steps\n"
 	    "\t-s <nr> \tScrolling 0: disable line scrolling, 1: enable line scrolling (default 1)\n"
+	    "\t-H <file> \tHistory file, loaded at start and appended at exit\n"
+	    "\t-u \t\tRemove older duplicates from history\n"
+	    "\t-M <nr> \tShow at most nr commands on ? and TAB\n"
+	    "\t-N \t\tServer mode: stdin/stdout is a session sharing the parse-trees\n"
+	    "\t-V <nr> \tValidate lines of stdin with nr threads without invoking callbacks\n"
+	    "\t-W <ms> \tPre-expand the line when no key is typed for ms milliseconds, implies -K\n"
 	    ,
 	    argv);
     exit(0);
@@ -201,19 +711,40 @@ main(int argc, char *argv[])
 {
     int         retval = -1;
     parse_tree *pt = NULL;
+    parse_tree *ptph;
     pt_head    *ph;
     FILE       *f = stdin;
     char       *argv0 = argv[0];
     char       *filename=NULL;
-    cvec       *globals;   /* global variables from syntax */
-    cligen_handle  h;
+    char       *imagefile=NULL;
+    char       *specdir=NULL;
+    char       *histfile=NULL;
+    FILE       *fh;
+    cvec       *globals = NULL; /* global variables from syntax */
+    cligen_handle  h = NULL;
     char       *str;
     int         once = 0;
+    int         batch = 0;
     int         print_syntax = 0;
     int         set_expand = 0;
     int         set_preference = 0;
+    int         set_share = 0;
+    int         set_intern = 0;
+    int         set_treeref = 0;
+    int         set_compile = 0;
+    int         set_resume = 0;
+    int         no_memo = 0;
+    int         expand_ttl = -1;
+    int         set_slab = 0;
+    int         set_stats = 0;
+    int         set_registry = 0;
     int         tabmode = 0;
     int         scrollmode = 0;
+    int         set_dedup = 0;
+    int         help_max = 0;
+    int         server = 0;
+    int         validate = 0;
+    int         idle_ms = 0;
 
     argv++;argc--;
     for (;(argc>0)&& *argv; argc--, argv++){
@@ -229,6 +760,12 @@ main(int argc, char *argv[])
 	case '1': /* quit directly */
 	    once++;
 	    break;
+	case 'b': /* batch mode */
+	    batch = 1;
+	    break;
+	case 'B': /* batch mode, stop on error */
+	    batch = 2;
+	    break;
 	case 'p': /* print syntax */
 	    print_syntax++;
 	    break;
@@ -238,6 +775,38 @@ main(int argc, char *argv[])
 	case 'P': /* Return first if several have same preference */
 	    set_preference++;
 	    break;
+	case 'S': /* Share referenced trees */
+	    set_share++;
+	    break;
+	case 'I': /* Intern strings of parse-tree objects */
+	    set_intern++;
+	    break;
+	case 'r': /* Cache tree references */
+	    set_treeref++;
+	    break;
+	case 'c': /* Compiled matcher, uses cached tree references */
+	    set_compile++;
+	    set_treeref++;
+	    break;
+	case 'K': /* Completion state, uses cached tree references */
+	    set_resume++;
+	    break;
+	case 'm': /* No memo of variable matches */
+	    no_memo++;
+	    break;
+	case 'C': /* Cache expand results */
+	    argc--;argv++;
+	    expand_ttl = atoi(*argv);
+	    break;
+	case 'A': /* Allocate cligen objects from slab */
+	    set_slab++;
+	    break;
+	case 'T': /* Phase statistics */
+	    set_stats++;
+	    break;
+	case 'R': /* Function registry */
+	    set_registry++;
+	    break;
 	case 'f' : 
 	    argc--;argv++;
 	    filename = *argv;
@@ -246,6 +815,14 @@ main(int argc, char *argv[])
 		exit(1);
 	    }
 	    break;
+	case 'D': /* directory of config-files */
+	    argc--;argv++;
+	    specdir = *argv;
+	    break;
+	case 'i': /* precompiled image */
+	    argc--;argv++;
+	    imagefile = *argv;
+	    break;
 	case 's': /* line scrolling mode */
 	    argc--;argv++;
 	    scrollmode = atoi(*argv);
@@ -254,32 +831,104 @@ main(int argc, char *argv[])
 	    argc--;argv++;
 	    tabmode = atoi(*argv);
 	    break;
+	case 'H': /* history file */
+	    argc--;argv++;
+	    histfile = *argv;
+	    break;
+	case 'u': /* remove duplicates from history */
+	    set_dedup++;
+	    break;
+	case 'M': /* max commands shown by help */
+	    argc--;argv++;
+	    help_max = atoi(*argv);
+	    break;
+	case 'N': /* server mode */
+	    server++;
+	    break;
+	case 'V': /* parallel validation */
+	    argc--;argv++;
+	    validate = atoi(*argv);
+	    break;
+	case 'W': /* idle pre-expansion, resumed by next TAB or ? */
+	    argc--;argv++;
+	    idle_ms = atoi(*argv);
+	    set_resume++;
+	    break;
 	default:
 	    usage(argv0);
 	    break;
 	}
   }
+    if (set_slab && co_slab_set(1) < 0)
+	goto done;
     if ((h = cligen_init()) == NULL)
 	goto done;    
     cligen_lexicalorder_set(h, 1);
     cligen_ignorecase_set(h, 1);
     if (set_preference)
 	cligen_preference_mode_set(h, set_preference);
+    if (help_max && cligen_help_max_set(h, help_max) < 0)
+	goto done;
+    if (set_share)
+	cligen_treeref_share_set(h, set_share);
+    if (set_intern && cligen_intern_set(h, 1) < 0)
+	goto done;
+    if (set_treeref)
+	cligen_treeref_cache_set(h, 1);
+    if (set_resume && cligen_complete_state_set(h, 1) < 0)
+	goto done;
+    if (set_compile && cligen_compile_set(h, 1) < 0)
+	goto done;
+    if (no_memo)
+	cligen_match_memo_set(h, 0);
+    if (expand_ttl >= 0){
+	if (cligen_expand_cache_ttl_set(h, expand_ttl) < 0)
+	    goto done;
+	cligen_expand_cache_set(h, 1);
+    }
+    /* Expand functions may use the idle time as budget */
+    if (idle_ms &&
+	(cligen_idle_expand_set(h, idle_ms) < 0 ||
+	 cligen_idle_budget_set(h, idle_ms) < 0))
+	goto done;
+    if (set_stats){
+	if (cligen_stats_set(h, 1) < 0)
+	    goto done;
+	cligen_stats_fn_set(h, cli_stats_line, NULL);
+    }
 //    cligen_parse_debug(1);
     if ((globals = cvec_new(0)) == NULL)
 	goto done;
-    if (cligen_parse_file(h, f, filename?filename:"stdin", NULL, globals) < 0)
+    if (specdir){
+	if (cligen_parse_files(h, specdir, ".cli", globals) < 0)
+	    goto done;
+    }
+    else if (imagefile){
+	if (cligen_parse_file_image(h, f, filename?filename:"stdin", imagefile, globals) < 0)
+	    goto done;
+    }
+    else if (cligen_parse_file(h, f, filename?filename:"stdin", NULL, globals) < 0)
 	goto done;
 
     ph = cligen_ph_i(h, 0); 
     pt = cligen_ph_parsetree_get(ph);
     
-    /* map functions */
-    if (pt) {
-	if (cligen_callbackv_str2fn(pt, str2fn, NULL) < 0)   /* callback */
+    if (set_registry){
+	if (cligen_fn_register(h, fn_callbacks, sizeof(fn_callbacks)/sizeof(fn_callbacks[0])) < 0)
+	    goto done;
+	if (set_expand &&
+	    cligen_fn_register(h, fn_expands, sizeof(fn_expands)/sizeof(fn_expands[0])) < 0)
+	    goto done;
+    }
+    /* map functions in all trees, shared references use them directly */
+    ph = NULL;
+    while (!set_registry && (ph = cligen_ph_each(h, ph)) != NULL) {
+	if ((ptph = cligen_ph_parsetree_get(ph)) == NULL)
+	    continue;
+	if (cligen_callbackv_str2fn(ptph, str2fn, NULL) < 0)   /* callback */
 	    goto done;
 	if (set_expand &&
-	    cligen_expandv_str2fn(pt, str2fn_exp, NULL) < 0) /* expand */
+	    cligen_expandv_str2fn(ptph, str2fn_exp, NULL) < 0) /* expand */
 	    goto done;
     }
     if ((str = cvec_find_str(globals, "prompt")) != NULL)
@@ -295,6 +944,7 @@ main(int argc, char *argv[])
     if ((str = cvec_find_str(globals, "mode")) != NULL)
 	cligen_ph_active_set(h, str);
     cvec_free(globals);
+    globals = NULL;
 
     if (print_syntax){
 	pt_print(stdout, pt, 0);
@@ -302,12 +952,67 @@ main(int argc, char *argv[])
     }
     if (once)
 	goto done;
-    if (cligen_loop(h) < 0)
+    if (set_dedup)
+	cligen_hist_dedup_set(h, 1);
+    if (histfile && (fh = fopen(histfile, "r")) != NULL){
+	if (cligen_hist_file_load(h, fh) < 0){
+	    fclose(fh);
+	    goto done;
+	}
+	fclose(fh);
+    }
+    if (server){
+	_specfile = filename;
+	_set_expand = set_expand;
+	/* Handle is owned and freed by the spec of the server */
+	retval = server_run(h);
+	h = NULL;
+	goto done;
+    }
+    _specdir = specdir;
+    if (validate){
+	if (validate_run(h, validate) < 0)
+	    goto done;
+    }
+    else if (batch){
+	if (cligen_eval_stream(h, stdin, batch==2?CLIGEN_STREAM_STOP:0, NULL, NULL) < 0)
+	    goto done;
+    }
+    else if (cligen_loop(h) < 0)
+	goto done;
+    if (histfile && cligen_hist_file_sync(h, histfile) < 0)
 	goto done;
     retval = 0;
   done:
     fclose(f);
+    if (globals)
+	cvec_free(globals);
+    if (h && set_stats){
+	uint64_t     states, hits, misses;
+	uint64_t     reused, allocated;
+	cligen_msize ms = {0,};
+	pt_head     *ph = NULL;
+	size_t       last, max, size;
+
+	cligen_stats_dump(stderr, h);
+	if (set_compile && cligen_compile_stats(h, &states, &hits, &misses) == 0)
+	    fprintf(stderr, "compile: states:%" PRIu64 " hits:%" PRIu64 " misses:%" PRIu64 "\n",
+		    states, hits, misses);
+	while ((ph = cligen_ph_each(h, ph)) != NULL)
+	    cligen_ph_size(ph, &ms);
+	fprintf(stderr, "memory: objects:%" PRIu64 " nodes:%zu strings:%zu cvecs:%zu callbacks:%zu varspecs:%zu total:%zu\n",
+		ms.ms_objects, ms.ms_nodes, ms.ms_strings, ms.ms_cvecs, ms.ms_callbacks,
+		ms.ms_varspecs, cligen_msize_total(&ms));
+	cligen_line_scratch_get(h, &last, &max, &size);
+	fprintf(stderr, "scratch: last:%zu max:%zu arena:%zu\n", last, max, size);
+	cligen_parse_ctx_stats(cligen_parse_ctx_get(h), &reused, &allocated);
+	fprintf(stderr, "parse: reused:%" PRIu64 " allocated:%" PRIu64 "\n", reused, allocated);
+	cbuf_pool_stats(cligen_cbuf_pool(h), &reused, &allocated);
+	fprintf(stderr, "cbuf: reused:%" PRIu64 " allocated:%" PRIu64 "\n", reused, allocated);
+    }
     if (h)
 	cligen_exit(h);
+    if (set_slab)
+	co_slab_set(0); /* Release slab chunks, fails if objects remain */
     return retval;
 }
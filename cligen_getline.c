@@ -46,6 +46,7 @@ int (*gl_tab_hook)() = NULL;
 int (*gl_qmark_hook)() = NULL;
 int (*gl_susp_hook)() = NULL;
 int (*gl_interrupt_hook)() = NULL;
+int (*gl_idle_hook)() = NULL;
 
 /******************** internal interface *********************************/
 
@@ -66,6 +67,10 @@ static void     gl_kill_begin(cligen_handle h, int pos);	/* delete to BEGIN of l
 static int      gl_kill_word(cligen_handle h, int pos);	/* delete word */
 static void     gl_newline(cligen_handle);	/* handle \n or \r */
 static int      gl_puts(char *buf);	/* write a line to terminal */
+static int      gl_flush(void);		/* write buffered output to terminal */
+static int      gl_paste(cligen_handle h);	/* read bracketed paste */
+static void     gl_paste_done(void);		/* free pasted text if all read */
+static void     gl_paste_echo(cligen_handle h, char *s, size_t len);
 
 static void     gl_transpose(cligen_handle h);	/* transpose two chars */
 static int      gl_yank(cligen_handle h);		/* yank killed text */
@@ -77,37 +82,183 @@ static void     search_back(cligen_handle h, int new);	/* look back for current
 static void     search_forw(cligen_handle h, int new);	/* look forw for current string */
 /* end forward declared internal functions */
 
-/* begin global variables */
-static int      gl_init_done = -1;	/* terminal mode flag  */
-static int      gl_termw = 80;		/* actual terminal width */
-static int      gl_utf8 = 0;		/* UTF-8 experimental mode */
-static int      gl_scrolling_mode = 1;	/* Scrolling on / off */
-static int      gl_scrollw = 27;	/* width of EOL scrolling region */
-static int      gl_width = 0;		/* net size available for input */
-static int      gl_extent = 0;		/* how far to redraw, 0 means all */
-static int      gl_overwrite = 0;	/* overwrite mode */
-static int      gl_pos, gl_cnt = 0;     /* position and size of input */
-
+/* begin global variables
+ * Keyboard characters of the terminal on stdin, read by gl_char_init
+ */
 static char     gl_intrc = 0;		/* keyboard SIGINT char (^C) */
 static char     gl_quitc = 0;		/* keyboard SIGQUIT char (^]) */
 static char     gl_suspc = 0;		/* keyboard SIGTSTP char (^Z) */
 static char     gl_dsuspc = 0;		/* delayed SIGTSTP char */
-static int      gl_search_mode = 0;	/* search mode flag */
 
-static int exitchars[8] = {0,}; /* 8 different exit chars should be enough */
-static int gl_iseof = 0;
+/* Output to the terminal of one keystroke is written at once, see gl_flush */
+#define GL_OBUF_SIZE 4096
+#define SEARCH_LEN 100
+#define GL_EXITCHARS 8
 
-static int   fixup_gl_shift;	/* index of first on screen character */
-static int   fixup_off_right;	/* true if more text right of screen */
-static int   fixup_off_left;	/* true if more text left of screen */
-static char  fixup_last_prompt[80] = "";
+/*! Line editing state of a handle, see gl_state_set
+ *
+ * Each handle has its own state, so that handles in different threads do not share
+ * the line being edited, the screen line or pasted text. The state is selected by the
+ * handle bound to the thread, see cligen_thread_set, and gl_getline selects the state
+ * of its handle while it runs.
+ */
+struct gl_state {
+    int      gl_init_done;	/* terminal mode flag  */
+    int      gl_termw;		/* actual terminal width */
+    int      gl_utf8;		/* UTF-8 experimental mode */
+    int      gl_scrolling_mode;	/* Scrolling on / off */
+    int      gl_scrollw;	/* width of EOL scrolling region */
+    int      gl_width;		/* net size available for input */
+    int      gl_extent;		/* how far to redraw, 0 means all */
+    int      gl_overwrite;	/* overwrite mode */
+    int      gl_pos, gl_cnt;    /* position and size of input */
+    int      gl_search_mode;	/* search mode flag */
+    int      exitchars[GL_EXITCHARS]; /* 8 different exit chars should be enough */
+    int      gl_iseof;
+    int      gl_idle_off;	/* Pre-expansion failed, off for the rest of the line */
+
+    int      fixup_gl_shift;	/* index of first on screen character */
+    int      fixup_off_right;	/* true if more text right of screen */
+    int      fixup_off_left;	/* true if more text left of screen */
+    char     fixup_last_prompt[80];
+
+    char     gl_obuf[GL_OBUF_SIZE];
+    int      gl_olen;
+
+    /* Screen line after the prompt as drawn by gl_fixup_scroll, with trailing blanks
+     * stripped, and cursor position in it, see gl_fixup_diff */
+    char    *gl_shadow;
+    char    *gl_screen;		/* New screen line, swapped with gl_shadow */
+    int      gl_shadow_size;
+    int      gl_shadow_len;
+    int      gl_shadow_col;
+
+    /* Input read ahead of gl_getc, eg after a bracketed paste */
+    char     gl_ibuf[GL_OBUF_SIZE];
+    int      gl_ilen;
+    int      gl_ipos;
+
+    /* Pasted text not yet returned as lines, see gl_paste */
+    int      gl_bracketed;	/* Bracketed paste mode, -1: not set */
+    char    *gl_pasted;
+    size_t   gl_pasted_len;	/* Length of pasted text */
+    size_t   gl_pasted_pos;	/* Start of text not yet returned */
+    size_t   gl_pasted_size;	/* Allocated size */
+
+    char     search_prompt[SEARCH_LEN+2]; /* prompt includes search string */
+    char     search_string[SEARCH_LEN];
+    int      search_pos;	/* current location in search_string */
+    int      search_forw_flg;	/* search direction flag */
+    int      search_last;	/* last match found */
+};
 
-#define SEARCH_LEN 100
-static char  search_prompt[SEARCH_LEN+2];  /* prompt includes search string */
-static char  search_string[SEARCH_LEN];
-static int   search_pos = 0;      /* current location in search_string */
-static int   search_forw_flg = 0; /* search direction flag */
-static int   search_last = 0;	  /* last match found */
+/* Initial values of a line editing state */
+#define GL_STATE_INIT {			\
+	.gl_init_done = -1,		\
+	.gl_termw = 80,			\
+	.gl_scrolling_mode = 1,		\
+	.gl_scrollw = 27,		\
+	.gl_bracketed = -1		\
+    }
+
+/* State of threads without handle */
+static struct gl_state _gl_default = GL_STATE_INIT;
+
+/* State used by the calling thread, see gl_state_set */
+static __thread struct gl_state *_gl = &_gl_default;
+
+/*! Create a line editing state, see cligen_gl_state
+ * @retval  gs    Line editing state, free with gl_state_free
+ * @retval  NULL  Error
+ */
+struct gl_state *
+gl_state_new(void)
+{
+    struct gl_state  gs0 = GL_STATE_INIT;
+    struct gl_state *gs;
+
+    if ((gs = malloc(sizeof(*gs))) == NULL)
+	return NULL;
+    memcpy(gs, &gs0, sizeof(*gs));
+    return gs;
+}
+
+/*! Free a line editing state
+ *
+ * The state is unselected from the calling thread if selected.
+ * @param[in]  gs   Line editing state
+ */
+void
+gl_state_free(struct gl_state *gs)
+{
+    if (gs == NULL)
+	return;
+    if (_gl == gs)
+	_gl = &_gl_default;
+    if (gs->gl_shadow)
+	free(gs->gl_shadow);
+    if (gs->gl_screen)
+	free(gs->gl_screen);
+    if (gs->gl_pasted)
+	free(gs->gl_pasted);
+    free(gs);
+}
+
+/*! Select line editing state of the calling thread
+ *
+ * CLIgen selects the state of a handle with cligen_thread_set. Functions without handle
+ * argument, such as gl_putc and gl_setwidth, use the selected state.
+ * @param[in]  gs    Line editing state, or NULL for the state of threads without handle
+ * @retval     prev  Previously selected state, to restore with gl_state_set
+ */
+struct gl_state *
+gl_state_set(struct gl_state *gs)
+{
+    struct gl_state *prev = _gl;
+
+    _gl = gs ? gs : &_gl_default;
+    return prev;
+}
+
+/* The state variables below refer to the selected state */
+#define gl_init_done      (_gl->gl_init_done)
+#define gl_termw          (_gl->gl_termw)
+#define gl_utf8           (_gl->gl_utf8)
+#define gl_scrolling_mode (_gl->gl_scrolling_mode)
+#define gl_scrollw        (_gl->gl_scrollw)
+#define gl_width          (_gl->gl_width)
+#define gl_extent         (_gl->gl_extent)
+#define gl_overwrite      (_gl->gl_overwrite)
+#define gl_pos            (_gl->gl_pos)
+#define gl_cnt            (_gl->gl_cnt)
+#define gl_search_mode    (_gl->gl_search_mode)
+#define exitchars         (_gl->exitchars)
+#define gl_iseof          (_gl->gl_iseof)
+#define gl_idle_off       (_gl->gl_idle_off)
+#define fixup_gl_shift    (_gl->fixup_gl_shift)
+#define fixup_off_right   (_gl->fixup_off_right)
+#define fixup_off_left    (_gl->fixup_off_left)
+#define fixup_last_prompt (_gl->fixup_last_prompt)
+#define gl_obuf           (_gl->gl_obuf)
+#define gl_olen           (_gl->gl_olen)
+#define gl_shadow         (_gl->gl_shadow)
+#define gl_screen         (_gl->gl_screen)
+#define gl_shadow_size    (_gl->gl_shadow_size)
+#define gl_shadow_len     (_gl->gl_shadow_len)
+#define gl_shadow_col     (_gl->gl_shadow_col)
+#define gl_ibuf           (_gl->gl_ibuf)
+#define gl_ilen           (_gl->gl_ilen)
+#define gl_ipos           (_gl->gl_ipos)
+#define gl_bracketed      (_gl->gl_bracketed)
+#define gl_pasted         (_gl->gl_pasted)
+#define gl_pasted_len     (_gl->gl_pasted_len)
+#define gl_pasted_pos     (_gl->gl_pasted_pos)
+#define gl_pasted_size    (_gl->gl_pasted_size)
+#define search_prompt     (_gl->search_prompt)
+#define search_string     (_gl->search_string)
+#define search_pos        (_gl->search_pos)
+#define search_forw_flg   (_gl->search_forw_flg)
+#define search_last       (_gl->search_last)
 
 /* end global variables */
 
@@ -160,6 +311,8 @@ struct termio   new_termio, old_termio;
 #endif /* POSIX */
 #endif	/* __unix__ */
 
+static int gl_char_depth = 0;   /* Nesting of gl_char_init/gl_char_cleanup */
+
 #ifdef vms
 #include <descrip.h>
 #include <ttdef.h>
@@ -174,6 +327,8 @@ struct dsc$descriptor_s descrip;     /* VMS descriptor */
 void
 gl_char_init(void)			/* turn off input echo */
 {
+    if (gl_char_depth++ > 0) /* nested, eg --More-- of help output in a hook */
+	return;
 #ifdef __unix__
 #ifdef POSIX
     tcgetattr(0, &old_termios);
@@ -235,6 +390,8 @@ gl_char_init(void)			/* turn off input echo */
 void
 gl_char_cleanup(void)		/* undo effects of gl_char_init */
 {
+    if (gl_char_depth == 0 || --gl_char_depth > 0)
+	return;
 #ifdef __unix__
 #ifdef POSIX 
     tcsetattr(0, TCSADRAIN, &old_termios);
@@ -282,46 +439,58 @@ struct regfd {
 };
 static int nextfds = 0;
 static struct regfd *extfds = NULL;
+/* File descriptors waiting to be writable, see gl_regfd_write */
+static int nwfds = 0;
+static struct regfd *wfds = NULL;
 
-/* XXX: If arg is malloced, the treatment of arg creates leaks */
-int
-gl_regfd(int fd, 
-	 cligen_fd_cb_t *cb, 
-	 void *arg)
+/*! Add or update a file descriptor in a vector of registered file descriptors
+ */
+static int
+regfd_add(struct regfd  **vec,
+	  int            *len,
+	  int             fd,
+	  cligen_fd_cb_t *cb,
+	  void           *arg)
 {
     int i;
     struct regfd *tmp;
 
-    for (i = 0; i < nextfds; i++) {
-	if (extfds[i].fd == fd) { /* Already registered. Update arg and cb */
-	    extfds[i].cb = cb;
-	    extfds[i].arg = arg;
+    for (i = 0; i < *len; i++) {
+	if ((*vec)[i].fd == fd) { /* Already registered. Update arg and cb */
+	    (*vec)[i].cb = cb;
+	    (*vec)[i].arg = arg;
 	    return 0;
 	}
     }
 
-    if ((tmp = realloc(extfds, (nextfds+1) * sizeof(*extfds))) == NULL)
+    if ((tmp = realloc(*vec, (*len+1) * sizeof(**vec))) == NULL)
 	return -1;
-    tmp[nextfds].fd = fd;
-    tmp[nextfds].cb = cb;
-    tmp[nextfds].arg = arg;
-    extfds = tmp;
-    nextfds++;
+    tmp[*len].fd = fd;
+    tmp[*len].cb = cb;
+    tmp[*len].arg = arg;
+    *vec = tmp;
+    (*len)++;
 
     return 0;
 }
 
-int
-gl_unregfd(int fd)
+/*! Remove a file descriptor from a vector of registered file descriptors
+ */
+static int
+regfd_del(struct regfd **vec,
+	  int           *len,
+	  int            fd)
 {
     int i;
 
-    for (i = 0; i < nextfds; i++) {
-	if (extfds[i].fd == fd) {
-	    if (i+1 < nextfds)
-		memcpy(&extfds[i], &extfds[i+1], nextfds-i);
-	    extfds = realloc(extfds, (nextfds-1) * sizeof(*extfds));
-	    nextfds--;
+    for (i = 0; i < *len; i++) {
+	if ((*vec)[i].fd == fd) {
+	    if (i+1 < *len)
+		memmove(&(*vec)[i], &(*vec)[i+1], (*len-i-1)*sizeof(**vec));
+	    if (--(*len) == 0){
+		free(*vec);
+		*vec = NULL;
+	    }
 	    return 0;
 	}
     }
@@ -329,31 +498,190 @@ gl_unregfd(int fd)
     return -1;
 }
 
+/* XXX: If arg is malloced, the treatment of arg creates leaks */
 int
-gl_select()
+gl_regfd(int fd,
+	 cligen_fd_cb_t *cb,
+	 void *arg)
+{
+    return regfd_add(&extfds, &nextfds, fd, cb, arg);
+}
+
+int
+gl_unregfd(int fd)
+{
+    return regfd_del(&extfds, &nextfds, fd);
+}
+
+/*! Register a callback called when a file descriptor is writable
+ *
+ * Used for output to a non-blocking file descriptor that could not be written at once.
+ * Unregister when all output is written, or the callback is called in a loop.
+ * @param[in]  fd    File descriptor
+ * @param[in]  cb    Callback
+ * @param[in]  arg   Argument of callback
+ * @see gl_regfd  for input
+ */
+int
+gl_regfd_write(int             fd,
+	       cligen_fd_cb_t *cb,
+	       void           *arg)
+{
+    return regfd_add(&wfds, &nwfds, fd, cb, arg);
+}
+
+int
+gl_unregfd_write(int fd)
+{
+    return regfd_del(&wfds, &nwfds, fd);
+}
+
+/*! Add registered file descriptors to fd sets of select
+ */
+static void
+regfd_fdset(fd_set *rset,
+	    fd_set *wset)
 {
     int i;
-    fd_set fdset;
+
+    for(i = 0; i < nextfds; i++)
+	FD_SET(extfds[i].fd, rset);
+    for(i = 0; i < nwfds; i++)
+	FD_SET(wfds[i].fd, wset);
+}
+
+/*! Call the callbacks of ready registered file descriptors
+ *
+ * A callback may register and unregister file descriptors.
+ * @retval     0        OK
+ * @retval    -1        Error
+ */
+static int
+regfd_call(fd_set *rset,
+	   fd_set *wset)
+{
+    int i;
+
+    for(i = 0; i < nwfds; i++)
+	if (FD_ISSET(wfds[i].fd, wset)){
+	    FD_CLR(wfds[i].fd, wset);
+	    if (wfds[i].cb(wfds[i].fd, wfds[i].arg) < 0)
+		return -1;
+	    i = -1; /* restart, the vector may have changed */
+	}
+    for(i = 0; i < nextfds; i++)
+	if (FD_ISSET(extfds[i].fd, rset)){
+	    FD_CLR(extfds[i].fd, rset);
+	    if (extfds[i].cb(extfds[i].fd, extfds[i].arg) < 0)
+		return -1;
+	    i = -1;
+	}
+    return 0;
+}
+
+/*! Wait for input on stdin, serving registered file descriptors meanwhile
+ * @param[in]  ms       Max time without activity in milliseconds, or -1 to wait until input
+ * @retval     1        Input on stdin
+ * @retval     0        Timeout
+ * @retval    -1        Error
+ */
+static int
+gl_select_stdin(int ms)
+{
+    int            n;
+    int            in;
+    fd_set         rset;
+    fd_set         wset;
+    struct timeval tv;
 
     while (1){
-	FD_ZERO(&fdset);
-	FD_SET(0, &fdset);
-	for(i = 0; i < nextfds; i++)
-	    FD_SET(extfds[i].fd, &fdset);
-	if (select(FD_SETSIZE, &fdset, NULL, NULL, NULL) < 0)
+	FD_ZERO(&rset);
+	FD_ZERO(&wset);
+	FD_SET(0, &rset);
+	regfd_fdset(&rset, &wset);
+	tv.tv_sec = ms/1000;
+	tv.tv_usec = (ms%1000)*1000;
+	if ((n = select(FD_SETSIZE, &rset, &wset, NULL, ms < 0 ? NULL : &tv)) < 0)
 	    return -1;
-	for(i = 0; i < nextfds; i++)
-	    if (FD_ISSET(extfds[i].fd, &fdset))
-		if (extfds[i].cb(extfds[i].fd, extfds[i].arg) < 0)
-		    return -1;
-	if (FD_ISSET(0, &fdset))
+	if (n == 0)
+	    return 0;
+	in = FD_ISSET(0, &rset);
+	FD_CLR(0, &rset);
+	if (regfd_call(&rset, &wset) < 0)
+	    return -1;
+	if (in)
 	    break;
     }
-    return 0;
+    return 1;
+}
+
+int
+gl_select()
+{
+    return gl_select_stdin(-1) < 0 ? -1 : 0;
+}
+
+/*! Wait for registered file descriptors only and call their callbacks
+ *
+ * Input on stdin is left for gl_getline.
+ * @param[in]  ms       Max time to wait in milliseconds, or -1 to wait until input
+ * @retval     1        One or several callbacks were called
+ * @retval     0        Timeout or interrupted
+ * @retval    -1        Error
+ * @see gl_select
+ */
+int
+gl_select_timeout(int ms)
+{
+    int            n;
+    fd_set         rset;
+    fd_set         wset;
+    struct timeval tv;
+
+    FD_ZERO(&rset);
+    FD_ZERO(&wset);
+    regfd_fdset(&rset, &wset);
+    tv.tv_sec = ms/1000;
+    tv.tv_usec = (ms%1000)*1000;
+    if ((n = select(FD_SETSIZE, &rset, &wset, NULL, ms < 0 ? NULL : &tv)) < 0){
+	if (errno == EINTR)
+	    return 0;
+	return -1;
+    }
+    if (n == 0)
+	return 0;
+    if (regfd_call(&rset, &wset) < 0)
+	return -1;
+    return 1;
 }
 #endif
 
 
+/*! Check if a key is typed but not yet read
+ *
+ * Used by work done while waiting for input to stop early, see gl_idle_hook
+ * @retval     1        Input on stdin
+ * @retval     0        No input
+ */
+int
+gl_input_pending(void)
+{
+#ifdef __unix__
+    fd_set         fdset;
+    struct timeval tv = {0, 0};
+#endif
+
+    if (gl_ipos < gl_ilen)
+	return 1;
+#ifdef __unix__
+    FD_ZERO(&fdset);
+    FD_SET(0, &fdset);
+    if (select(1, &fdset, NULL, NULL, &tv) > 0)
+	return 1;
+#endif
+    return 0;
+}
+
 int
 gl_eof()
 {
@@ -365,7 +693,7 @@ gl_exitchar_add(char c)
 {
     int i;
 
-    for (i=0;sizeof(exitchars);i++)
+    for (i=0; i<GL_EXITCHARS; i++)
 	if (!exitchars[i]){
 	    exitchars[i] = c;
 	    break;
@@ -378,7 +706,7 @@ gl_exitchar(char c)
 {
     int i;
 
-    for (i=0;sizeof(exitchars);i++){
+    for (i=0; i<GL_EXITCHARS; i++){
 	if (!exitchars[i])
 	    break;
 	if (exitchars[i] == c)
@@ -413,7 +741,16 @@ gl_getc(cligen_handle h)
     unsigned char  ch;
 #endif
 
+    gl_flush(); /* redraw of previous key */
+    if (gl_ipos < gl_ilen)
+	return (unsigned char)gl_ibuf[gl_ipos++];
 #if CLIGEN_REGFD 
+    /* No key within idle time: pre-expand the line, once per key.
+     * It only prepares caches, if it fails it is off for the rest of the line */
+    if (gl_idle_hook && !gl_idle_off && cligen_idle_expand(h) > 0 &&
+	gl_select_stdin(cligen_idle_expand(h)) == 0 &&
+	gl_idle_hook(h, cligen_buf(h)) < 0)
+	gl_idle_off = 1;
     gl_select(); /* block until something arrives on stdin */
 #endif
 #ifdef __unix__
@@ -471,36 +808,310 @@ gl_getc(cligen_handle h)
     return c;
 }
 
+/*! Write buffered terminal output
+ *
+ * Called before reading a key and before hooks that may write to the terminal, so that
+ * the redraw of a keystroke is one write.
+ */
+static int
+gl_flush(void)
+{
+    int     i = 0;
+    ssize_t len;
+
+    fflush(stdout); /* Keep order with stdio output */
+    while (i < gl_olen){
+	if ((len = write(1, gl_obuf + i, gl_olen - i)) < 0){
+	    if (errno == EINTR)
+		continue;
+	    gl_olen = 0;
+	    return -1;
+	}
+	i += len;
+    }
+    gl_olen = 0;
+    return 0;
+}
+
+/*! Write one char to terminal, buffered while editing a line
+ * @param[in]  c   Character
+ */
 int
 gl_putc(int c)
 {
-    char   ch = c;
-
-    if (write(1, &ch, 1) < 0)
-      return -1;
-    if (ch == '\n') {
-	ch = '\r'; /* RAW mode needs '\r', does not hurt */
-        if (write(1, &ch, 1) < 0)
-	  return -1;
-    }
+    if (gl_olen + 2 > GL_OBUF_SIZE && gl_flush() < 0)
+	return -1;
+    gl_obuf[gl_olen++] = c;
+    if (c == '\n')
+	gl_obuf[gl_olen++] = '\r'; /* RAW mode needs '\r', does not hurt */
+    if (gl_init_done <= 0) /* Not editing */
+	return gl_flush();
     return 0;
 }
 
 /******************** fairly portable part *********************************/
 
+/*! Write string to terminal, buffered until gl_flush
+ * @param[in]  buf  String
+ * @param[in]  len  Length of buf
+ */
+static int
+gl_write(char *buf,
+	 int   len)
+{
+    if (gl_olen + len > GL_OBUF_SIZE && gl_flush() < 0)
+	return -1;
+    if (len > GL_OBUF_SIZE){
+	if (write(1, buf, len) < 0)
+	    return -1;
+    }
+    else {
+	memcpy(gl_obuf + gl_olen, buf, len);
+	gl_olen += len;
+    }
+    return 0;
+}
+
 static int
 gl_puts(char *buf)
 {
-    int len; 
-    
     if (buf) {
-        len = strlen(buf);
-        if (write(1, buf, len) < 0)
-	  return -1;
+	if (gl_write(buf, strlen(buf)) < 0)
+	    return -1;
+	if (gl_init_done <= 0) /* Not editing */
+	    return gl_flush();
+    }
+    return 0;
+}
+
+/*! Append text of a bracketed paste to the pasted text
+ * @param[in]  c   Character
+ * @retval     0   OK
+ * @retval    -1   Error
+ */
+static int
+gl_paste_add(int c)
+{
+    char *p;
+
+    if (gl_pasted_len + 2 > gl_pasted_size){
+	gl_pasted_size = gl_pasted_size ? gl_pasted_size * 2 : GL_OBUF_SIZE;
+	if ((p = realloc(gl_pasted, gl_pasted_size)) == NULL){
+	    fprintf(stderr, "%s: realloc: %s\n", __FUNCTION__, strerror(errno));
+	    return -1;
+	}
+	gl_pasted = p;
     }
+    gl_pasted[gl_pasted_len++] = c;
+    gl_pasted[gl_pasted_len] = '\0';
     return 0;
 }
 
+/*! Read a bracketed paste after ESC [200~ until ESC [201~
+ *
+ * Input is read in blocks, without redraw and without TAB and ? hooks. Lines are ended
+ * with \n, other control characters are removed. Input after the end of the paste is kept
+ * for gl_getc.
+ * @param[in]  h   CLIgen handle
+ * @retval     0   OK
+ * @retval    -1   Error or end of file
+ */
+static int
+gl_paste(cligen_handle h)
+{
+    char *end = "\033[201~";
+    int   k = 0;   /* Matched length of end */
+    int   cr = 0;  /* Previous was \r */
+    int   c;
+    int   i;
+    int   n;
+
+    while (end[k] != '\0'){
+	if (gl_ipos == gl_ilen){
+	    if ((n = read(0, gl_ibuf, sizeof(gl_ibuf))) < 0){
+		if (errno == EINTR)
+		    continue;
+		return -1;
+	    }
+	    if (n == 0) /* End of file in paste: keep what was pasted */
+		break;
+	    gl_ilen = n;
+	    gl_ipos = 0;
+	}
+	c = (unsigned char)gl_ibuf[gl_ipos++];
+	if (c == end[k]){
+	    k++;
+	    continue;
+	}
+	/* Not the end: the matched part is text, except ESC */
+	for (i = 1; i < k; i++)
+	    if (gl_paste_add(end[i]) < 0)
+		return -1;
+	k = (c == end[0]) ? 1 : 0;
+	if (k)
+	    continue;
+	if (c == '\r' || c == '\n'){
+	    if (!(c == '\n' && cr) && gl_paste_add('\n') < 0)
+		return -1;
+	}
+	else if (c == '\t'){
+	    if (gl_paste_add(' ') < 0)
+		return -1;
+	}
+	else if ((c >= ' ' && c < 0177) || (gl_utf8 && c >= 0200)){
+	    if (gl_paste_add(c) < 0)
+		return -1;
+	}
+	cr = (c == '\r');
+    }
+    return 0;
+}
+
+/*! Free pasted text when all lines are returned
+ */
+static void
+gl_paste_done(void)
+{
+    if (gl_pasted && gl_pasted_pos >= gl_pasted_len){
+	free(gl_pasted);
+	gl_pasted = NULL;
+	gl_pasted_len = gl_pasted_pos = gl_pasted_size = 0;
+    }
+}
+
+/*! Echo a pasted line after the prompt, in one write
+ * @param[in]  h     CLIgen handle
+ * @param[in]  s     Line
+ * @param[in]  len   Length of line
+ */
+static void
+gl_paste_echo(cligen_handle h,
+	      char         *s,
+	      size_t        len)
+{
+    char *prompt = cligen_prompt(h) ? cligen_prompt(h) : "";
+
+    gl_write("\r", 1);
+    gl_write(prompt, strlen(prompt));
+    gl_write(s, len);
+    gl_write("\n\r", 2);
+    gl_flush();
+}
+
+/*! Return next complete line of pasted text
+ *
+ * The line is echoed after the prompt, in one write.
+ * @param[in]  h     CLIgen handle
+ * @param[out] line  Line without newline, valid until next call, or NULL if none
+ * @retval     0     OK
+ * @retval    -1     Error
+ * @see cliread_paste_eval
+ */
+int
+gl_paste_line(cligen_handle h,
+	      char        **line)
+{
+    struct gl_state *prev;
+    char            *s;
+    char            *nl;
+
+    *line = NULL;
+    prev = gl_state_set(cligen_gl_state(h));
+    gl_paste_done();
+    if (gl_pasted == NULL)
+	goto done;
+    s = gl_pasted + gl_pasted_pos;
+    if ((nl = strchr(s, '\n')) == NULL)
+	goto done;
+    *nl = '\0';
+    gl_pasted_pos += nl - s + 1;
+    gl_paste_echo(h, s, nl - s);
+    *line = s;
+ done:
+    gl_state_set(prev);
+    return 0;
+}
+
+/*! Check if pasted text has a complete line not yet returned
+ * @retval  1  Yes, see gl_paste_line
+ * @retval  0  No
+ */
+int
+gl_paste_pending(void)
+{
+    return gl_pasted && strchr(gl_pasted + gl_pasted_pos, '\n') != NULL;
+}
+
+/*! Take pasted text up to and including the next newline, or all
+ * @param[out] text  Start of text
+ * @param[out] len   Length of text, without newline
+ * @retval     1     Text ends with newline
+ * @retval     0     Text is the rest of the paste
+ */
+static int
+gl_paste_take(char  **text,
+	      size_t *len)
+{
+    char *s = gl_pasted + gl_pasted_pos;
+    char *nl;
+
+    if ((nl = strchr(s, '\n')) != NULL){
+	*len = nl - s;
+	gl_pasted_pos += *len + 1;
+    }
+    else{
+	*len = strlen(s);
+	gl_pasted_pos += *len;
+    }
+    *text = s;
+    return nl != NULL;
+}
+
+/*! Insert pasted text up to the first newline at the cursor, with one redraw
+ * @param[in]  h   CLIgen handle
+ * @retval     1   The text ended with newline, the line is complete
+ * @retval     0   OK
+ * @retval    -1   Error
+ */
+static int
+gl_paste_insert(cligen_handle h)
+{
+    char  *text;
+    size_t len;
+    int    nl;
+
+    nl = gl_paste_take(&text, &len);
+    if (len){
+	if (cligen_buf_increase(h, gl_cnt + len + 1) < 0)
+	    return -1;
+	memmove(cligen_buf(h) + gl_pos + len, cligen_buf(h) + gl_pos, gl_cnt - gl_pos + 1);
+	memcpy(cligen_buf(h) + gl_pos, text, len);
+	gl_fixup(h, cligen_prompt(h), gl_pos, gl_pos + len);
+    }
+    return nl;
+}
+
+/*! Set bracketed paste mode of the terminal
+ * @param[in] mode   1: pasted text is read at once, see gl_paste, 0: as typed
+ * The default is on if stdin and stdout are terminals.
+ */
+int
+gl_bracketed_paste_set(int mode)
+{
+    gl_bracketed = mode;
+    return 0;
+}
+
+/*! Get bracketed paste mode
+ */
+int
+gl_bracketed_paste_get(void)
+{
+    if (gl_bracketed < 0)
+	gl_bracketed = isatty(0) && isatty(1);
+    return gl_bracketed;
+}
+
 /*! set up variables and terminal 
  * @see gl_init  cal this once first
  */
@@ -569,21 +1180,17 @@ gl_setwidth(int  w)
     return 0;
 }
 
-/*! Main getline function handling a command line
- *
- * @param[in]  h     CLIgen handle
- * @param[out] buf   Pointer to char* buffer containing CLIgen command
- * @retval     0     OK: string or EOF
- * @retval    -1     Error
- * Typically called by cliread.
+/*! Main getline function handling a command line, see gl_getline
  */
-int
-gl_getline(cligen_handle h,
-	   char        **buf)
+static int
+gl_getline1(cligen_handle h,
+	    char        **buf)
 {
     int             c, loc, tmp;
     char           *gl_prompt;
     int             escape = 0;
+    char           *text;
+    size_t          len;
 #ifdef __unix__
     int	            sig;
 #endif
@@ -591,6 +1198,24 @@ gl_getline(cligen_handle h,
     gl_init1();	
     gl_prompt = (cligen_prompt(h))? cligen_prompt(h) : "";
     cligen_buf(h)[0] = 0;
+    gl_idle_off = 0;
+    if (gl_bracketed_paste_get())
+	gl_write("\033[?2004h", 8);
+    /* Rest of a paste: a complete line is returned as is or the text is edited */
+    gl_paste_done();
+    if (gl_pasted){
+	c = gl_paste_take(&text, &len);
+	if (cligen_buf_increase(h, len + 2) < 0)
+	    goto err;
+	memcpy(cligen_buf(h), text, len);
+	cligen_buf(h)[len] = '\0';
+	if (c){
+	    gl_paste_echo(h, text, len);
+	    cligen_buf(h)[len] = '\n';
+	    cligen_buf(h)[len+1] = '\0';
+	    goto done;
+	}
+    }
     if (gl_in_hook)
 	gl_in_hook(h, cligen_buf(h));
     gl_fixup(h, gl_prompt, -2, cligen_buf_size(h));
@@ -602,6 +1227,7 @@ gl_getline(cligen_handle h,
             else{
 		if (escape ==0 && c == '?' && gl_qmark_hook) {
 		    escape = 0;
+		    gl_flush();
 		    if ((loc = gl_qmark_hook(h, cligen_buf(h))) < 0)
 			goto err;
 		    gl_fixup(h, gl_prompt, -2, gl_pos);
@@ -656,6 +1282,7 @@ gl_getline(cligen_handle h,
 	    case '\t':        				/* TAB */
                 if (gl_tab_hook) {
 		    tmp = gl_pos;
+		    gl_flush();
 	            if ((loc = gl_tab_hook(h, &tmp)) < 0)
 			goto err;
 		    gl_fixup(h, gl_prompt, -2, tmp);
@@ -699,6 +1326,7 @@ gl_getline(cligen_handle h,
 	    case '\032':                                      /* ^Z */
 		if(gl_susp_hook) {
 		    tmp = gl_pos;
+		    gl_flush();
 	            loc = gl_susp_hook(cligen_userhandle(h)?cligen_userhandle(h):h,
 				       cligen_buf(h), gl_strlen(gl_prompt), &tmp);
 	            if (loc != -1 || tmp != gl_pos)
@@ -733,6 +1361,18 @@ gl_getline(cligen_handle h,
 			    break;
 			gl_del(h, 0);
 			break;
+		    case '2': /* bracketed paste ESC [200~ */
+			if (gl_getc(h) != '0' || gl_getc(h) != '0' || gl_getc(h) != '~')
+			    break;
+			if (gl_paste(h) < 0)
+			    goto err;
+			if ((loc = gl_paste_insert(h)) < 0)
+			    goto err;
+			if (loc == 1){
+			    gl_newline(h);
+			    goto done;
+			}
+			break;
 		    default: gl_putc('\007');         /* who knows */
 		        break;
 		    }
@@ -799,6 +1439,7 @@ gl_getline(cligen_handle h,
 	                sig = SIGTSTP;
 #endif
                     if (sig != 0) {
+			gl_flush();
 	                gl_cleanup();
 	                kill(0, sig);
 	                gl_init1();
@@ -816,18 +1457,49 @@ gl_getline(cligen_handle h,
     } /* while */
     cligen_buf(h)[0] = 0;
  done:
+    if (gl_bracketed)
+	gl_write("\033[?2004l", 8);
+    gl_flush();
     gl_cleanup();
     *buf = cligen_buf(h);
     return 0;
  exit: /* ie exit from cli, not necessarily error */
+    if (gl_bracketed)
+	gl_write("\033[?2004l", 8);
+    gl_flush();
     gl_exit(h);
     *buf = cligen_buf(h);
     return 0;
  err: /* fatal error */
+    if (gl_bracketed)
+	gl_write("\033[?2004l", 8);
+    gl_flush();
     gl_cleanup();
     return -1;
 }
 
+/*! Main getline function handling a command line
+ *
+ * The line editing state of the handle is used, see cligen_gl_state.
+ * @param[in]  h     CLIgen handle
+ * @param[out] buf   Pointer to char* buffer containing CLIgen command
+ * @retval     0     OK: string or EOF
+ * @retval    -1     Error
+ * Typically called by cliread.
+ */
+int
+gl_getline(cligen_handle h,
+	   char        **buf)
+{
+    struct gl_state *prev;
+    int              retval;
+
+    prev = gl_state_set(cligen_gl_state(h));
+    retval = gl_getline1(h, buf);
+    gl_state_set(prev);
+    return retval;
+}
+
 /*! Add the character c to the input buffer at current location 
  * @param[in]  h     CLIgen handle
  * @param[in]  c     Character
@@ -1109,7 +1781,11 @@ wrap(int p,
 
 void gl_clear_screen(cligen_handle h)
 {
+    struct gl_state *prev;
+
+    prev = gl_state_set(cligen_gl_state(h));
     if (gl_init_done <= 0) {
+	gl_state_set(prev);
 	return;
     }
 
@@ -1123,6 +1799,8 @@ void gl_clear_screen(cligen_handle h)
     gl_putc('H');
 
     gl_fixup(h, cligen_prompt(h), -2, gl_pos);
+    gl_flush();
+    gl_state_set(prev);
 }
 
 /*! Emit a newline, reset and redraw prompt and current input line 
@@ -1131,10 +1809,15 @@ void gl_clear_screen(cligen_handle h)
 void
 gl_redraw(cligen_handle h)
 {
+    struct gl_state *prev;
+
+    prev = gl_state_set(cligen_gl_state(h));
     if (gl_init_done > 0) {
         gl_putc('\n');
         gl_fixup(h, cligen_prompt(h), -2, gl_pos);
+	gl_flush();
     }
+    gl_state_set(prev);
 }
 
 /*! Redrawing or moving within line
@@ -1254,6 +1937,96 @@ gl_fixup_noscroll(cligen_handle h,
 }
 
 
+/*! Byte i of a screen line, blank after its end */
+#define GL_CELL(s, len, i) ((i) < (len) ? (s)[i] : ' ')
+
+/*! Byte i of a screen line continues a UTF-8 character */
+#define GL_CONT(s, len, i) (gl_utf8 && (GL_CELL(s, len, i) & 0xc0) == 0x80)
+
+/*! Make room for screen lines of len bytes
+ * @param[in]  len  Length
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+static int
+gl_shadow_reserve(int len)
+{
+    char *s;
+
+    if (len + 1 <= gl_shadow_size)
+	return 0;
+    if ((s = realloc(gl_shadow, len + 1)) == NULL)
+	return -1;
+    gl_shadow = s;
+    if ((s = realloc(gl_screen, len + 1)) == NULL)
+	return -1;
+    gl_screen = s;
+    gl_shadow_size = len + 1;
+    return 0;
+}
+
+/*! Move cursor on the screen line as in gl_shadow
+ *
+ * Left with backspace, one per character, right by writing what is on the screen.
+ * @param[in]  col  New position, start of a character
+ */
+static void
+gl_shadow_move(int col)
+{
+    int i;
+
+    for (i = gl_shadow_col - 1; i >= col; i--)
+	if (!GL_CONT(gl_shadow, gl_shadow_len, i))
+	    gl_putc('\b');
+    for (i = gl_shadow_col; i < col; i++)
+	gl_putc(GL_CELL(gl_shadow, gl_shadow_len, i));
+    gl_shadow_col = col;
+}
+
+/*! Update the screen line from gl_shadow to gl_screen with minimal output
+ *
+ * Only the range from the first to the last changed byte is written, extended to whole
+ * UTF-8 characters, then the cursor is moved.
+ * @param[in]  len  Length of gl_screen
+ * @param[in]  col  Cursor position in gl_screen
+ */
+static void
+gl_fixup_diff(int len,
+	      int col)
+{
+    int   max;
+    int   d;
+    int   e;
+    int   i;
+    char *s;
+
+    while (len > 0 && gl_screen[len-1] == ' ')
+	len--;
+    max = (len > gl_shadow_len) ? len : gl_shadow_len;
+    for (d = 0; d < max; d++)
+	if (GL_CELL(gl_screen, len, d) != GL_CELL(gl_shadow, gl_shadow_len, d))
+	    break;
+    if (d < max){
+	for (e = max; e > d; e--)
+	    if (GL_CELL(gl_screen, len, e-1) != GL_CELL(gl_shadow, gl_shadow_len, e-1))
+		break;
+	while (d > 0 && (GL_CONT(gl_screen, len, d) || GL_CONT(gl_shadow, gl_shadow_len, d)))
+	    d--;
+	while (e < max && (GL_CONT(gl_screen, len, e) || GL_CONT(gl_shadow, gl_shadow_len, e)))
+	    e++;
+	gl_shadow_move(d);
+	for (i = d; i < e; i++)
+	    gl_putc(GL_CELL(gl_screen, len, i));
+	gl_shadow_col = e;
+    }
+    /* The screen now shows gl_screen */
+    s = gl_shadow;
+    gl_shadow = gl_screen;
+    gl_screen = s;
+    gl_shadow_len = len;
+    gl_shadow_move(col);
+}
+
 /*! Redrawing or moving within line
  *
  * This function is used both for redrawing when input changes or for
@@ -1265,6 +2038,8 @@ gl_fixup_noscroll(cligen_handle h,
  *   cursor : the desired location of the cursor after the call.
  *            A value of cligen_buf_size(h) can be used  to indicate the cursor should
  *            move just past the end of the input line.
+ * The new screen line is compared with what is on the screen (gl_shadow) and only the
+ * difference is written, see gl_fixup_diff.
  */
 static void
 gl_fixup_scroll(cligen_handle h, 
@@ -1272,13 +2047,11 @@ gl_fixup_scroll(cligen_handle h,
 		int           change, 
 		int           cursor)
 {
-    int          left = 0, right = -1;		/* bounds for redraw */
-    int          pad;		/* how much to erase at end of line */
-    int          backup;        /* how far to backup before fixing */
+    int          right;
     int          new_shift;     /* value of shift based on cursor */
     int          extra;         /* adjusts when shift (scroll) happens */
     int          i;
-    int          new_right = -1; /* alternate right bound, using gl_extent */
+    int          n;
     int          l1, l2;
 
     if (change == -2) {   /* reset */
@@ -1288,24 +2061,29 @@ gl_fixup_scroll(cligen_handle h,
 	strncpy(fixup_last_prompt, prompt, sizeof(fixup_last_prompt)-1);
 	change = 0;
         gl_width = gl_termw - gl_strlen(prompt);
+	gl_shadow_len = gl_shadow_col = 0;
     } else if (strcmp(prompt, fixup_last_prompt) != 0) {
-	l1 = gl_strlen(fixup_last_prompt);
-	l2 = gl_strlen(prompt);
-	gl_cnt = gl_cnt + l1 - l2;
+	l1 = strlen(fixup_last_prompt);
+	l2 = strlen(prompt);
+	/* The screen after the new prompt shows the rest of the old prompt and line */
+	if (gl_shadow_reserve(l1 + gl_shadow_len) < 0)
+	    return;
+	n = 0;
+	for (i = l2; i < l1; i++)
+	    gl_screen[n++] = fixup_last_prompt[i];
+	for (i = (l2 > l1) ? l2 - l1 : 0; i < gl_shadow_len; i++)
+	    gl_screen[n++] = gl_shadow[i];
+	memcpy(gl_shadow, gl_screen, n);
+	gl_shadow_len = n;
+	gl_shadow_col = 0;
 	strncpy(fixup_last_prompt, prompt, sizeof(fixup_last_prompt)-1);
 	gl_putc('\r');
 	gl_puts(prompt);
-	gl_pos = fixup_gl_shift;
-        gl_width = gl_termw - l2;
+        gl_width = gl_termw - gl_strlen(prompt);
 	change = 0;
     }
-    pad = (fixup_off_right)? gl_width - 1 : gl_cnt - fixup_gl_shift;   /* old length */
-    backup = gl_pos - fixup_gl_shift;
-    if (change >= 0) {
+    if (change >= 0)
         gl_cnt = strlen(cligen_buf(h));
-        if (change > gl_cnt)
-	    change = gl_cnt;
-    }
     if (cursor > gl_cnt) {
 	if (cursor != cligen_buf_size(h))		/* cligen_buf_size(h) means end of line */
 	    gl_putc('\007');
@@ -1327,53 +2105,26 @@ gl_fixup_scroll(cligen_handle h,
 	new_shift *= gl_scrollw;
     } else
 	new_shift = 0;
-    if (new_shift != fixup_gl_shift) {	/* scroll occurs */
+    if (new_shift != fixup_gl_shift || change >= 0) {	/* scroll or text changed */
 	fixup_gl_shift = new_shift;
 	fixup_off_left = (fixup_gl_shift)? 1 : 0;
 	fixup_off_right = (gl_cnt > fixup_gl_shift + gl_width - 1)? 1 : 0;
-	left = fixup_gl_shift;
-	new_right = right = (fixup_off_right)? fixup_gl_shift + gl_width - 2 : gl_cnt;
-    } else if (change >= 0) {		/* no scroll, but text changed */
-	if (change < fixup_gl_shift + fixup_off_left) {
-	    left = fixup_gl_shift;
-	} else {
-	    left = change;
-	    backup = gl_pos - change;
-	}
-	fixup_off_right = (gl_cnt > fixup_gl_shift + gl_width - 1)? 1 : 0;
-	right = (fixup_off_right)? fixup_gl_shift + gl_width - 2 : gl_cnt;
-	new_right = (gl_extent && (right > left + gl_extent))? 
-	    left + gl_extent : right;
     }
-    pad -= (fixup_off_right)? gl_width - 1 : gl_cnt - fixup_gl_shift;
-    pad = (pad < 0)? 0 : pad;
-    if (left <= right) {		/* clean up screen */
-	for (i=0; i < backup; i++)
-	    gl_putc('\b');
-	if (left == fixup_gl_shift && fixup_off_left) {
-	    gl_putc('$');
-	    left++;
-        }
-	for (i=left; i < new_right; i++)
-	    gl_putc(cligen_buf(h)[i]);
-	gl_pos = new_right;
-	if (fixup_off_right && new_right == right) {
-	    gl_putc('$');
-	    gl_pos++;
-	} else { 
-	    for (i=0; i < pad; i++)	/* erase remains of prev line */
-		gl_putc(' ');
-	    gl_pos += pad;
-	}
-    }
-    i = gl_pos - cursor;		/* move to final cursor location */
-    if (i > 0) {
-	while (i--)
-	    gl_putc('\b');
-    } else {
-	for (i=gl_pos; i < cursor; i++)
-	    gl_putc(cligen_buf(h)[i]);
+    /* New screen line, buffer position i is at fixup_gl_shift + i */
+    right = (fixup_off_right)? fixup_gl_shift + gl_width - 2 : gl_cnt;
+    if (gl_shadow_reserve(right - fixup_gl_shift + 1) < 0)
+	return;
+    n = 0;
+    i = fixup_gl_shift;
+    if (fixup_off_left) {
+	gl_screen[n++] = '$';
+	i++;
     }
+    for (; i < right; i++)
+	gl_screen[n++] = cligen_buf(h)[i];
+    if (fixup_off_right)
+	gl_screen[n++] = '$';
+    gl_fixup_diff(n, cursor - fixup_gl_shift);
     gl_pos = cursor;
 }
 
@@ -1490,7 +2241,6 @@ static void
 search_back(cligen_handle h, 
 	    int           new_search)
 {
-    int    found = 0;
     char  *p, *loc;
     int    last;
 
@@ -1504,19 +2254,16 @@ search_back(cligen_handle h,
         cligen_buf(h)[0] = 0;
 	gl_fixup(h, search_prompt, 0, 0);
     } else if (search_pos > 0) {
-	while (!found) {
-	    p = hist_prev(h);
-	    if (*p == 0) {		/* not found, done looking */
-	       cligen_buf(h)[0] = 0;
-	       gl_fixup(h, search_prompt, 0, 0);
-	       found = 1;
-	    } else if ((loc = strstr(p, search_string)) != 0) {
-		strncpy(cligen_buf(h), p, cligen_buf_size(h));
-		gl_fixup(h, search_prompt, 0, loc - p);
-	       if (new_search)
-		   search_last = hist_pos(h);
-	       found = 1;
-	    } 
+	p = hist_search(h, search_string, 0);
+	if (*p == 0) {		/* not found, done looking */
+	    cligen_buf(h)[0] = 0;
+	    gl_fixup(h, search_prompt, 0, 0);
+	} else {
+	    loc = strstr(p, search_string);
+	    strncpy(cligen_buf(h), p, cligen_buf_size(h));
+	    gl_fixup(h, search_prompt, 0, loc - p);
+	    if (new_search)
+		search_last = hist_pos(h);
 	}
     } else {
         gl_putc('\007');
@@ -1530,7 +2277,6 @@ static void
 search_forw(cligen_handle h, 
 	    int           new_search)
 {
-    int    found = 0;
     char  *p, *loc;
     int    last;
 
@@ -1545,19 +2291,16 @@ search_forw(cligen_handle h,
         cligen_buf(h)[0] = 0;
 	gl_fixup(h, search_prompt, 0, 0);
     } else if (search_pos > 0) {
-	while (!found) {
-	    p = hist_next(h);
-	    if (*p == 0) {		/* not found, done looking */
-	       cligen_buf(h)[0] = 0;
-	       gl_fixup(h, search_prompt, 0, 0);
-	       found = 1;
-	    } else if ((loc = strstr(p, search_string)) != 0) {
-		strncpy(cligen_buf(h), p, cligen_buf_size(h));
-		gl_fixup(h, search_prompt, 0, loc - p);
-	       if (new_search)
-		   search_last = hist_pos(h);
-	       found = 1;
-	    } 
+	p = hist_search(h, search_string, 1);
+	if (*p == 0) {		/* not found, done looking */
+	    cligen_buf(h)[0] = 0;
+	    gl_fixup(h, search_prompt, 0, 0);
+	} else {
+	    loc = strstr(p, search_string);
+	    strncpy(cligen_buf(h), p, cligen_buf_size(h));
+	    gl_fixup(h, search_prompt, 0, loc - p);
+	    if (new_search)
+		search_last = hist_pos(h);
 	}
     } else {
         gl_putc('\007');
@@ -42,11 +42,22 @@ int     gl_setwidth(int);		/* specify width of screen */
 int     gl_getwidth(void);		/* get width of screen */
 int     gl_utf8_set(int mode);          /* set UTF-8 experimental mode */
 int     gl_utf8_get(void);              /* get UTF-8 mode */
+int     gl_bracketed_paste_set(int mode); /* set bracketed paste mode */
+int     gl_bracketed_paste_get(void);   /* get bracketed paste mode */
+int     gl_paste_pending(void);         /* pasted line not yet read */
+int     gl_paste_line(cligen_handle h, char **line); /* next pasted line */
 void	gl_strwidth(gl_strwidth_proc);	/* to bind gl_strlen */
 void	gl_clear_screen(cligen_handle h); /* clear sceen and redraw */
 void	gl_redraw(cligen_handle h);	/* issue \n and redraw all */
 int     gl_regfd(int, cligen_fd_cb_t *, void *);
 int     gl_unregfd(int);
+int     gl_regfd_write(int, cligen_fd_cb_t *, void *);
+int     gl_unregfd_write(int);
+int     gl_select_timeout(int ms);
+int     gl_input_pending(void);
+struct gl_state *gl_state_new(void);
+void    gl_state_free(struct gl_state *gs);
+struct gl_state *gl_state_set(struct gl_state *gs); /* select state of thread */
 
 extern int 	(*gl_in_hook)(void *, char *);
 extern int 	(*gl_out_hook)(void*, char *);
@@ -54,5 +65,6 @@ extern int	(*gl_tab_hook)(cligen_handle, int *);
 extern cligen_susp_cb_t *gl_susp_hook;
 extern cligen_interrupt_cb_t *gl_interrupt_hook;
 extern int	(*gl_qmark_hook)(cligen_handle, char *);
+extern int	(*gl_idle_hook)(cligen_handle, char *);
 
 #endif /* CLIGEN_GETLINE_H */
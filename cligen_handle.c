@@ -50,6 +50,7 @@
 #include <termios.h>
 #include <signal.h>
 #include <sys/ioctl.h>
+#include <sys/time.h>
 
 #include "cligen_buf.h"
 #include "cligen_cv.h"
@@ -60,12 +61,20 @@
 #include "cligen_io.h"
 #include "cligen_handle.h"
 #include "cligen_read.h"
+#include "cligen_match.h"
+#include "cligen_expand.h"
 #include "cligen_parse.h"
 #include "cligen_history.h"
 #include "cligen_getline.h"
+#include "cligen_stats.h"
 #include "cligen_handle_internal.h"
 #include "cligen_history.h"
 #include "cligen_history_internal.h"
+#include "cligen_arena.h"
+#include "cligen_intern.h"
+#include "cligen_registry.h"
+#include "cligen_compile.h"
+#include "cligen_util.h"
 
 /*
  * Constants
@@ -73,11 +82,22 @@
 #define TREENAME_KEYWORD_DEFAULT "treename"
 
 /* forward */
-static int terminal_rows_set1(int rows);
+static int terminal_rows_set1(cligen_handle h, int rows);
+static uint64_t idle_now(void);
 
 /*
  * Variables
  */
+/* Handle bound to the calling thread, used by functions called without handle,
+ * eg cligen_output and sorting of parse-trees
+ * @see cligen_thread_set
+ */
+static __thread struct cligen_handle *_cligen_thread = NULL;
+
+/* The following are defaults of handle-scoped settings. They are used if a function
+ * is called with NULL handle and no handle is bound to the thread, and they are
+ * copied to new handles by cligen_init.
+ */
 /* Number of terminal rows as used by cligen_output pageing routine
  * @see cligen_output
  */
@@ -97,6 +117,23 @@ static int _helpstr_truncate = 0;
  */
 static int _helpstr_lines = 0;
 
+/* Lexical matching order: strcmp (0) or strverscmp (1) */
+static int _lexicalorder = 0;
+
+/* Ignore case (1) or not (0) */
+static int _ignorecase = 0;
+
+/*! Return handle, or the handle bound to the calling thread if NULL
+ * @param[in] h   CLIgen handle or NULL
+ * @retval    ch  Handle
+ * @retval    NULL  No handle given and none bound to thread, use defaults
+ */
+static struct cligen_handle *
+handle_thread(cligen_handle h)
+{
+    return h ? handle(h) : _cligen_thread;
+}
+
 /*! Get window size and set terminal row size
  * @param[in] h       CLIgen handle
  * The only real effect this has is to set the getline width parameter which effects scrolling
@@ -120,7 +157,7 @@ cligen_gwinsz(cligen_handle h)
 	perror("ioctl(STDIN_FILENO,TIOCGWINSZ)");
 	return -1;
     }
-    terminal_rows_set1(ws.ws_row); /* note special treatment of 0 in sub function */
+    terminal_rows_set1(h, ws.ws_row); /* note special treatment of 0 in sub function */
     cligen_terminal_width_set(h, ws.ws_col);
 
     return 0;
@@ -152,7 +189,29 @@ cligen_init(void)
     ch->ch_magic = CLIGEN_MAGIC;
     ch->ch_tabmode = 0x0; /* see CLIGEN_TABMODE_* */
     ch->ch_delimiter = ' ';
+    ch->ch_line_arena_enabled = 1;
+    ch->ch_match_memo_enabled = 1;
+    ch->ch_expand_cache_ttl = CLIGEN_EXPAND_CACHE_TTL;
+    ch->ch_expand_deadline = CLIGEN_EXPAND_DEADLINE;
+    ch->ch_terminalrows = _terminalrows;
+    ch->ch_helpstr_truncate = _helpstr_truncate;
+    ch->ch_helpstr_lines = _helpstr_lines;
+    ch->ch_lexicalorder = _lexicalorder;
+    ch->ch_ignorecase = _ignorecase;
+    if ((ch->ch_cbuf_pool = cbuf_pool_new()) == NULL){
+	fprintf(stderr, "%s: cbuf_pool_new: %s\n", __FUNCTION__, strerror(errno));
+	free(ch);
+	goto done;
+    }
+    if ((ch->ch_gl_state = gl_state_new()) == NULL){
+	fprintf(stderr, "%s: gl_state_new: %s\n", __FUNCTION__, strerror(errno));
+	cbuf_pool_free(ch->ch_cbuf_pool);
+	free(ch);
+	goto done;
+    }
     h = (cligen_handle)ch;
+    if (_cligen_thread == NULL)
+	cligen_thread_set(h);
     cligen_prompt_set(h, CLIGEN_PROMPT_DEFAULT);
     /* Only if stdin and stdout refers to a terminal make win size check */
     if (isatty(0) && isatty(1)){
@@ -167,7 +226,7 @@ cligen_init(void)
 	}
     }
     else
-	terminal_rows_set1(0); 
+	terminal_rows_set1(h, 0); 
     cliread_init(h);
     cligen_buf_init(h);
     /* getline cant function without some history */
@@ -176,6 +235,82 @@ cligen_init(void)
     return h;
 }
 
+/*! Create a session handle with the settings of another handle, sharing its parse-trees
+ *
+ * The new handle has its own prompt, history, getline buffers, workpoints and active
+ * parse-tree, but the parse-trees are those of h0, shared read-only, see cligen_share.
+ * Tree references are expanded for each command and not cached, since the expansion
+ * depends on the workpoints of the handle. The handle is not bound to the thread and
+ * does not use the terminal: output paging is off.
+ * @param[in] h0   Handle owning the parse-trees, eg loaded with cligen_parse_file
+ * @retval    h    New CLIgen handle, free with cligen_exit before h0
+ * @retval    NULL Error
+ * @see cligen_session_new  which creates a handle of a session in a server
+ */
+cligen_handle
+cligen_clone(cligen_handle h0)
+{
+    struct cligen_handle *ch0 = handle(h0);
+    struct cligen_handle *ch;
+    cligen_handle         h = NULL;
+
+    if ((ch = malloc(sizeof(*ch))) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	goto done;
+    }
+    memset(ch, 0, sizeof(*ch));
+    ch->ch_magic = CLIGEN_MAGIC;
+    ch->ch_comment = ch0->ch_comment;
+    ch->ch_tabmode = ch0->ch_tabmode;
+    ch->ch_lexicalorder = ch0->ch_lexicalorder;
+    ch->ch_ignorecase = ch0->ch_ignorecase;
+    ch->ch_helpstr_truncate = ch0->ch_helpstr_truncate;
+    ch->ch_helpstr_lines = ch0->ch_helpstr_lines;
+    ch->ch_help_max = ch0->ch_help_max;
+    ch->ch_logsyntax = ch0->ch_logsyntax;
+    ch->ch_hist_dedup = ch0->ch_hist_dedup;
+    ch->ch_userhandle = ch0->ch_userhandle;
+    ch->ch_userdata = ch0->ch_userdata;
+    ch->ch_regex_xsd = ch0->ch_regex_xsd;
+    ch->ch_delimiter = ch0->ch_delimiter;
+    ch->ch_preference_mode = ch0->ch_preference_mode;
+    ch->ch_treeref_share = ch0->ch_treeref_share;
+    ch->ch_line_arena_enabled = ch0->ch_line_arena_enabled;
+    ch->ch_match_memo_enabled = ch0->ch_match_memo_enabled;
+    ch->ch_complete_state = ch0->ch_complete_state;
+    ch->ch_expand_cache = ch0->ch_expand_cache;
+    ch->ch_expand_cache_ttl = ch0->ch_expand_cache_ttl;
+    ch->ch_expand_deadline = ch0->ch_expand_deadline;
+    ch->ch_idle_expand = ch0->ch_idle_expand;
+    ch->ch_idle_budget = ch0->ch_idle_budget;
+    ch->ch_stats_enabled = ch0->ch_stats_enabled;
+    ch->ch_eval_argv_copy = ch0->ch_eval_argv_copy;
+    h = (cligen_handle)ch;
+    if ((ch->ch_cbuf_pool = cbuf_pool_new()) == NULL)
+	goto err;
+    if ((ch->ch_gl_state = gl_state_new()) == NULL)
+	goto err;
+    if (cligen_prompt_set(h, ch0->ch_prompt ? ch0->ch_prompt : CLIGEN_PROMPT_DEFAULT) < 0)
+	goto err;
+    if (ch0->ch_reftree_filter &&
+	(ch->ch_reftree_filter = cvec_dup(ch0->ch_reftree_filter)) == NULL)
+	goto err;
+    if (cligen_compile_set(h, ch0->ch_compile_enabled) < 0)
+	goto err;
+    cliread_init(h);
+    if (cligen_buf_init(h) < 0)
+	goto err;
+    if (cligen_hist_init(h, ch0->ch_hist_size ? ch0->ch_hist_size : CLIGEN_HISTSIZE_DEFAULT) < 0)
+	goto err;
+    if (cligen_share(h, h0) < 0)
+	goto err;
+  done:
+    return h;
+  err:
+    cligen_exit(h);
+    return NULL;
+}
+
 /*! This is the last call to the CLIgen API an application should make
  * @param[in] h       CLIgen handle
  */
@@ -197,14 +332,366 @@ cligen_exit(cligen_handle h)
 	free(ch->ch_fn_str);
     if (ch->ch_reftree_filter)
 	cvec_free(ch->ch_reftree_filter);
+    if (ch->ch_scratch_cv)
+	cv_free(ch->ch_scratch_cv);
+    if (ch->ch_line_arena)
+	cligen_arena_free(ch->ch_line_arena);
+    if (ch->ch_complete_ms)
+	match_state_free(ch->ch_complete_ms);
+    if (ch->ch_match_memo)
+	match_memo_free(ch->ch_match_memo);
+    if (ch->ch_tokens)
+	cligen_tokens_free(ch->ch_tokens);
+    if (ch->ch_parse_ctx)
+	cligen_parse_ctx_free(ch->ch_parse_ctx);
+    if (ch->ch_expand_cache_tab)
+	pt_expand_cache_free(ch->ch_expand_cache_tab);
+    cligen_ph_index_free(h);
     while ((ph = ch->ch_pt_head) != NULL){
 	ch->ch_pt_head = ph->ph_next;
+	if (ch->ch_origin && !ch->ch_copy) /* Shared, owned by origin */
+	    ph->ph_parsetree = NULL;
 	cligen_ph_free(ph);
     }
+    /* After parse-trees, objects may point into it */
+    if (ch->ch_intern)
+	cligen_intern_free(ch->ch_intern);
+    if (ch->ch_ctab)
+	cligen_ctab_free(ch->ch_ctab);
+    if (ch->ch_fn_registry && ch->ch_origin == NULL)
+	cligen_registry_free(ch->ch_fn_registry);
+    if (ch->ch_labels)
+	cvec_free(ch->ch_labels);
+    if (ch->ch_ostream)
+	cligen_ostream_free(ch->ch_ostream);
+    if (_cligen_thread == ch)
+	cligen_thread_set(NULL);
+    if (ch->ch_gl_state)
+	gl_state_free(ch->ch_gl_state);
+    /* Last, cbufs above may have been given back to it */
+    if (ch->ch_cbuf_pool)
+	cbuf_pool_free(ch->ch_cbuf_pool);
     free(ch);
     return 0;
 }
 
+/*! Bind handle to the calling thread
+ *
+ * Some functions are called without handle, such as cligen_output and the comparison
+ * used when sorting parse-trees. They use the settings of the handle bound to the
+ * calling thread, and its cbuf pool and line editing state.
+ * cligen_init binds the new handle to the thread that creates it if the thread has no
+ * handle bound, and cligen_exit unbinds it. A thread that uses another handle, eg one
+ * session per thread, binds it before use.
+ * @param[in] h   CLIgen handle, or NULL to unbind
+ * @retval    0   OK
+ * @see cligen_thread
+ */
+int
+cligen_thread_set(cligen_handle h)
+{
+    _cligen_thread = handle(h);
+    cbuf_pool_set(_cligen_thread ? _cligen_thread->ch_cbuf_pool : NULL);
+    gl_state_set(_cligen_thread ? _cligen_thread->ch_gl_state : NULL);
+    return 0;
+}
+
+/*! Return handle bound to the calling thread, or NULL
+ * @see cligen_thread_set
+ */
+cligen_handle
+cligen_thread(void)
+{
+    return (cligen_handle)_cligen_thread;
+}
+
+/*! Share the parse-trees of another handle, replacing the parse-trees of the handle
+ *
+ * A parse-tree header is made in h for each parse-tree of h0, pointing to the same tree.
+ * Workpoints are those of h0. The active parse-tree is kept by name if h0 has it.
+ * Label ids and registered functions of h0 are used, since they are cached in the
+ * objects. The trees are owned by h0 and are not freed by cligen_exit of h.
+ * Parse-trees previously shared by h are released, h0 may be freed after this call if
+ * no other handle shares it.
+ * @param[in] h    CLIgen handle, eg made by cligen_clone
+ * @param[in] h0   Handle owning the parse-trees
+ * @retval    0    OK
+ * @retval   -1    Error
+ * @see cligen_spec_new
+ */
+int
+cligen_share(cligen_handle h,
+	     cligen_handle h0)
+{
+    struct cligen_handle *ch = handle(h);
+    struct cligen_handle *ch0 = handle(h0);
+    pt_head              *ph;
+    pt_head              *ph0;
+    char                 *active = NULL;
+    char                 *name;
+    int                   retval = -1;
+
+    if (h == h0 || ch->ch_copy || (ch->ch_origin == NULL && ch->ch_pt_head != NULL)){
+	errno = EINVAL;
+	goto done;
+    }
+    if ((ph = ch->ch_ph_active) != NULL && ph->ph_active &&
+	(active = strdup(ph->ph_name)) == NULL)
+	goto done;
+    cligen_ph_index_free(h);
+    while ((ph = ch->ch_pt_head) != NULL){
+	ch->ch_pt_head = ph->ph_next;
+	ph->ph_parsetree = NULL;
+	cligen_ph_free(ph);
+    }
+    ch->ch_ph_last = NULL;
+    ch->ch_ph_active = NULL;
+    /* Compiled states and saved match state point into the previous trees */
+    if (cligen_compile_invalidate(h) < 0)
+	goto done;
+    if (ch->ch_complete_ms){
+	match_state_free(ch->ch_complete_ms);
+	ch->ch_complete_ms = NULL;
+    }
+    if (ch->ch_labels){
+	cvec_free(ch->ch_labels);
+	ch->ch_labels = NULL;
+    }
+    if (ch0->ch_labels && (ch->ch_labels = cvec_dup(ch0->ch_labels)) == NULL)
+	goto done;
+    ch->ch_fn_registry = ch0->ch_fn_registry;
+    ch->ch_origin = h0;
+    for (ph0 = ch0->ch_pt_head; ph0; ph0 = ph0->ph_next){
+	if ((ph = cligen_ph_add(h, ph0->ph_name)) == NULL)
+	    goto done;
+	ph->ph_parsetree = ph0->ph_parsetree;
+	ph->ph_workpt = ph0->ph_workpt;
+    }
+    name = active;
+    if (name == NULL || cligen_ph_find(h, name) == NULL){
+	for (ph0 = ch0->ch_pt_head; ph0; ph0 = ph0->ph_next)
+	    if (ph0->ph_active)
+		break;
+	name = ph0 ? ph0->ph_name : NULL;
+    }
+    if (name)
+	cligen_ph_active_set(h, name);
+    cligen_treeref_cache_invalidate(h);
+    retval = 0;
+ done:
+    if (active)
+	free(active);
+    return retval;
+}
+
+/*! Return handle owning the parse-trees shared by the handle, or NULL
+ * @see cligen_share
+ */
+cligen_handle
+cligen_origin(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_origin;
+}
+
+/*! Position of an object in its parse-tree level, not counting expanded tree references
+ * @param[in]  pt   Parse-tree level
+ * @param[in]  co   Object
+ * @retval     pos  Position
+ * @retval    -1    Not found
+ */
+static int
+mode_pos(parse_tree *pt,
+	 cg_obj     *co)
+{
+    cg_obj *co1;
+    int     i;
+    int     pos = 0;
+
+    for (i=0; i<pt_len_get(pt); i++){
+	if ((co1 = pt_vec_i_get(pt, i)) == NULL ||
+	    co_flags_get(co1, CO_FLAGS_TREEREF))
+	    continue;
+	if (co1 == co)
+	    return pos;
+	pos++;
+    }
+    return -1;
+}
+
+/*! Find the object of a parse-tree at the same place as an object of another copy
+ *
+ * The place is the position at each level from the top, not counting expanded tree
+ * references, which may differ between the copies.
+ * @param[in]  pt0   Parse-tree of co0
+ * @param[in]  co0   Object in pt0
+ * @param[in]  pt    Copy of pt0
+ * @retval     co    Object in pt
+ * @retval     NULL  Not found
+ */
+static cg_obj *
+mode_find(parse_tree *pt0,
+	  cg_obj     *co0,
+	  parse_tree *pt)
+{
+    cg_obj *co;
+    cg_obj *co1 = NULL;
+    int    *path;
+    int     depth = 0;
+    int     i;
+    int     j;
+    int     pos;
+
+    for (co = co0; co; co = co_up(co))
+	depth++;
+    if ((path = malloc(depth*sizeof(*path))) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	return NULL;
+    }
+    i = depth;
+    for (co = co0; co; co = co_up(co))
+	if ((path[--i] = mode_pos(co_up(co) ? co_pt_get(co_up(co)) : pt0, co)) < 0)
+	    goto done;
+    for (i=0; i<depth && pt; i++){
+	co1 = NULL;
+	for (j=0, pos=0; j<pt_len_get(pt); j++){
+	    if ((co = pt_vec_i_get(pt, j)) == NULL ||
+		co_flags_get(co, CO_FLAGS_TREEREF))
+		continue;
+	    if (pos++ == path[i]){
+		co1 = co;
+		break;
+	    }
+	}
+	if (co1 == NULL)
+	    break;
+	pt = co_pt_get(co1);
+    }
+    if (i < depth)
+	co1 = NULL;
+ done:
+    free(path);
+    return co1;
+}
+
+/*! Set the mode of a handle to that of another handle with the same parse-trees
+ *
+ * The mode is the active parse-tree and the workpoints of the parse-trees. The trees of
+ * the handles may be copies of each other, workpoints are found by their place.
+ * @param[in] h    CLIgen handle, eg made by cligen_copy
+ * @param[in] h0   Handle with the mode to set
+ * @retval    0    OK
+ * @retval   -1    Error
+ * @see cligen_wp_set
+ */
+int
+cligen_mode_copy(cligen_handle h,
+		 cligen_handle h0)
+{
+    struct cligen_handle *ch0 = handle(h0);
+    pt_head              *ph0;
+    pt_head              *ph;
+    cg_obj               *co;
+
+    for (ph0 = ch0->ch_pt_head; ph0; ph0 = ph0->ph_next){
+	if ((ph = cligen_ph_find(h, ph0->ph_name)) == NULL)
+	    continue;
+	co = NULL;
+	if (ph0->ph_workpt != NULL){
+	    if (ph0->ph_parsetree == ph->ph_parsetree) /* Shared */
+		co = ph0->ph_workpt;
+	    else if ((co = mode_find(ph0->ph_parsetree, ph0->ph_workpt, ph->ph_parsetree)) == NULL){
+		errno = ENOENT;
+		return -1;
+	    }
+	}
+	if (ph->ph_workpt != co)
+	    cligen_ph_workpoint_set(ph, co);
+    }
+    for (ph0 = ch0->ch_pt_head; ph0; ph0 = ph0->ph_next)
+	if (ph0->ph_active)
+	    return cligen_ph_active_set(h, ph0->ph_name);
+    return 0;
+}
+
+/*! Make the objects of a copied parse-tree independent of the tree they were copied from
+ *
+ * Reset the original set by co_copy and make callback lists private, since the reference
+ * counts of shared lists are not safe to update from several threads.
+ * @param[in]  pt   Copied parse-tree, without expanded tree references
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+static int
+copy_private(parse_tree *pt)
+{
+    cg_obj *co;
+    int     i;
+
+    for (i=0; i<pt_len_get(pt); i++)
+	if ((co = pt_vec_i_get(pt, i)) != NULL){
+	    co->co_treeref_orig = NULL;
+	    if (co_callbacks_unshare(&co->co_callbacks) < 0)
+		return -1;
+	    if (co_pt_get(co) && copy_private(co_pt_get(co)) < 0)
+		return -1;
+	}
+    return 0;
+}
+
+/*! Create a handle with the settings of another handle and private copies of its trees
+ *
+ * As cligen_clone, but the parse-trees are copied and owned by the new handle, so that
+ * it can match lines in another thread than h0 and other copies. Expanded tree
+ * references of h0 are not copied. Registered functions and interned strings of h0 are
+ * shared read-only, h0 must not be changed or freed while the copy is in use.
+ * The mode of h0 is copied, see cligen_mode_copy.
+ * @param[in] h0   Handle owning the parse-trees
+ * @retval    h    New CLIgen handle, free with cligen_exit before h0
+ * @retval    NULL Error
+ * @see cligen_validate_lines
+ */
+cligen_handle
+cligen_copy(cligen_handle h0)
+{
+    struct cligen_handle *ch0 = handle(h0);
+    struct cligen_handle *ch;
+    cligen_handle         h;
+    pt_head              *ph;
+    pt_head              *ph0;
+    parse_tree           *pt;
+
+    if ((h = cligen_clone(h0)) == NULL)
+	return NULL;
+    ch = handle(h);
+    ch->ch_copy = 1;
+    for (ph = ch->ch_pt_head; ph; ph = ph->ph_next){
+	ph->ph_parsetree = NULL;
+	ph->ph_workpt = NULL;
+    }
+    for (ph0 = ch0->ch_pt_head; ph0; ph0 = ph0->ph_next){
+	if (ph0->ph_parsetree == NULL ||
+	    (ph = cligen_ph_find(h, ph0->ph_name)) == NULL)
+	    continue;
+	if ((pt = pt_dup(ph0->ph_parsetree, NULL)) == NULL)
+	    goto err;
+	ph->ph_parsetree = pt;
+	if (pt_expand_treeref_cleanup(pt) < 0)
+	    goto err;
+	if (copy_private(pt) < 0)
+	    goto err;
+    }
+    ch->ch_treeref_cache = ch0->ch_treeref_cache;
+    if (cligen_mode_copy(h, h0) < 0)
+	goto err;
+    cligen_treeref_cache_invalidate(h);
+    return h;
+ err:
+    cligen_exit(h);
+    return NULL;
+}
+
 /*! Check struct magic number for sanity checks
  * @param[in] h       CLIgen handle
  * return 0 if OK, -1 if fail.
@@ -319,6 +806,7 @@ cligen_pt_head_set(cligen_handle h,
     struct cligen_handle *ch = handle(h);
 
     ch->ch_pt_head = ph;
+    cligen_ph_index_free(h);
     return 0;
 }
 
@@ -430,19 +918,25 @@ cligen_fn_str_set(cligen_handle h,
 int 
 cligen_terminal_rows(cligen_handle h)
 {
-//    struct cligen_handle *ch = handle(h);
+    struct cligen_handle *ch = handle_thread(h);
 
-    return _terminalrows; /* ch->ch_terminalrows; */
+    return ch ? ch->ch_terminalrows : _terminalrows;
 }
 
 /*! Set number of displayed terminal rows, internal function
- * @param[in] h       CLIgen handle
+ * @param[in] h       CLIgen handle, or NULL for handle bound to thread
  * @param[in] rows    Number of lines in a terminal (y-direction)
  */
 static int 
-terminal_rows_set1(int rows)
+terminal_rows_set1(cligen_handle h,
+		   int           rows)
 {
-    _terminalrows = rows;
+    struct cligen_handle *ch = handle_thread(h);
+
+    if (ch)
+	ch->ch_terminalrows = rows;
+    else
+	_terminalrows = rows;
     return 0;
 }
 
@@ -469,7 +963,7 @@ cligen_terminal_rows_set(cligen_handle h,
     }
     if (ws.ws_row !=0 )
 	goto ok;
-    terminal_rows_set1(rows);
+    terminal_rows_set1(h, rows);
  ok:
     retval = 0;
  done:
@@ -480,12 +974,16 @@ cligen_terminal_rows_set(cligen_handle h,
  *
  * @param[in] h       CLIgen handle
  */
-int 
+int
 cligen_terminal_width(cligen_handle h)
 {
-//    struct cligen_handle *ch = handle(h);
+    struct gl_state *prev;
+    int              width;
 
-    return gl_getwidth()==0xffff?80:gl_getwidth();
+    prev = gl_state_set(cligen_gl_state(h));
+    width = gl_getwidth();
+    gl_state_set(prev);
+    return width==0xffff?80:width;
 }
 
 /*! Set width of a CLIgen line in characters, ie, the number of 'columns' in a line
@@ -499,8 +997,8 @@ int
 cligen_terminal_width_set(cligen_handle h, 
 			  int           width)
 {
-    //    struct cligen_handle *ch = handle(h);
-    int retval = -1;
+    int              retval = -1;
+    struct gl_state *prev;
 
     /* if width = 0, then set it to 65535 to effectively disable all scrolling mechanisms 
      * This is somewhat complex and there may be some missed cornercases:
@@ -512,10 +1010,12 @@ cligen_terminal_width_set(cligen_handle h,
     /* if width < 21 set it to 21, which is getline's limit. */
     else if (width < TERM_MIN_SCREEN_WIDTH)
 	width = TERM_MIN_SCREEN_WIDTH;
+    prev = gl_state_set(cligen_gl_state(h));
     if (gl_setwidth(width) < 0)
 	goto done; /* shouldnt happen */
     retval = 0;
  done:
+    gl_state_set(prev);
     return retval;
 }
 
@@ -525,10 +1025,16 @@ cligen_terminal_width_set(cligen_handle h,
  * @retval    0       UTF-8 mode disabled
  * @retval    1       UTF-8 mode enabled
  */
-int 
+int
 cligen_utf8_get(cligen_handle h)
 {
-    return gl_utf8_get();
+    struct gl_state *prev;
+    int              mode;
+
+    prev = gl_state_set(cligen_gl_state(h));
+    mode = gl_utf8_get();
+    gl_state_set(prev);
+    return mode;
 }
 
 /*! Set cligen/getline UTF-8 experimental mode
@@ -541,7 +1047,13 @@ int
 cligen_utf8_set(cligen_handle h,
 		int           mode)
 {
-    return gl_utf8_set(mode);
+    struct gl_state *prev;
+    int              retval;
+
+    prev = gl_state_set(cligen_gl_state(h));
+    retval = gl_utf8_set(mode);
+    gl_state_set(prev);
+    return retval;
 }
 
 /*! Get line scrolling mode
@@ -550,10 +1062,16 @@ cligen_utf8_set(cligen_handle h,
  * @retval    0       Line scrolling off
  * @retval    1       Line scrolling on
  */
-int 
+int
 cligen_line_scrolling(cligen_handle h)
 {
-    return gl_getscrolling();
+    struct gl_state *prev;
+    int              mode;
+
+    prev = gl_state_set(cligen_gl_state(h));
+    mode = gl_getscrolling();
+    gl_state_set(prev);
+    return mode;
 }
 
 /*! Set line scrolling mode
@@ -566,9 +1084,13 @@ int
 cligen_line_scrolling_set(cligen_handle h,
 			  int           mode)
 {
-    int prev = gl_getscrolling();
+    struct gl_state *prevgs;
+    int              prev;
 
+    prevgs = gl_state_set(cligen_gl_state(h));
+    prev = gl_getscrolling();
     gl_setscrolling(mode);
+    gl_state_set(prevgs);
     return prev;
 }
 
@@ -577,7 +1099,7 @@ cligen_line_scrolling_set(cligen_handle h,
  * Whether to truncate help string on right margin or wrap long help lines.
  * This only applies if you have really long help strings, such as when generating them from a
  * spec.
- * @param[in] h       CLIgen handle (dummy, need to be called where h is NULL)
+ * @param[in] h       CLIgen handle, or NULL for handle bound to thread
  * @retval    0       Do not truncate help string on right margin (wrap long help lines)
  * @retval    1       Truncate help string on right margin (do not wrap long help lines)
  * @see print_help_line
@@ -585,7 +1107,9 @@ cligen_line_scrolling_set(cligen_handle h,
 int 
 cligen_helpstring_truncate(cligen_handle h)
 {
-    return _helpstr_truncate;
+    struct cligen_handle *ch = handle_thread(h);
+
+    return ch ? ch->ch_helpstr_truncate : _helpstr_truncate;
 }
 
 /*! Set help string truncate mode (for ?)
@@ -593,7 +1117,7 @@ cligen_helpstring_truncate(cligen_handle h)
  * Whether to truncate help string on right margin or wrap long help lines.
  * This only applies if you have really long help strings, such as when generating them from a
  * spec.
- * @param[in]  h     CLIgen handle (dummy, need to be called where h is NULL)
+ * @param[in]  h     CLIgen handle, or NULL for handle bound to thread
  * @param[in]  mode  0: Wrap long help strings, 1: Truncate help string
  * @retval     0     OK
  * @see print_help_line
@@ -602,7 +1126,12 @@ int
 cligen_helpstring_truncate_set(cligen_handle h,
 			       int           mode)
 {
-    _helpstr_truncate = mode;
+    struct cligen_handle *ch = handle_thread(h);
+
+    if (ch)
+	ch->ch_helpstr_truncate = mode;
+    else
+	_helpstr_truncate = mode;
     return 0;
 }
 
@@ -610,21 +1139,23 @@ cligen_helpstring_truncate_set(cligen_handle h,
  *
  * This only applies if you have multi-line help strings, such as when generating them from a
  * spec.
- * @param[in] h       CLIgen handle (dummy, need to be called where h is NULL)
+ * @param[in] h       CLIgen handle, or NULL for handle bound to thread
  * @retval    n       Number of help string lines to display per command, 0 is unlimted
  * @see print_help_line
  */
 int 
 cligen_helpstring_lines(cligen_handle h)
 {
-    return _helpstr_lines;
+    struct cligen_handle *ch = handle_thread(h);
+
+    return ch ? ch->ch_helpstr_lines : _helpstr_lines;
 }
 
 /*! Set help string truncate mode (for ?)
  *
  * This only applies if you have multi-line help strings, such as when generating them from a
  * spec.
- * @param[in] h       CLIgen handle (dummy, need to be called where h is NULL)
+ * @param[in] h       CLIgen handle, or NULL for handle bound to thread
  * @retval    n       Number of help string lines to display per command, 0 means unlimited.
  * @see print_help_line
  */
@@ -632,7 +1163,50 @@ int
 cligen_helpstring_lines_set(cligen_handle h,
 			       int        lines)
 {
-    _helpstr_lines = lines;
+    struct cligen_handle *ch = handle_thread(h);
+
+    if (ch)
+	ch->ch_helpstr_lines = lines;
+    else
+	_helpstr_lines = lines;
+    return 0;
+}
+
+/*! Get max number of commands shown by help (? and TAB)
+ *
+ * @param[in] h       CLIgen handle
+ * @retval    n       Max number of commands, 0 is unlimited
+ * @see cligen_help_max_set
+ */
+int 
+cligen_help_max(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_help_max;
+}
+
+/*! Set max number of commands shown by help (? and TAB)
+ *
+ * Help of a level with more commands shows the first n, followed by a line with the
+ * number of the rest, so that help of huge expansions stays interactive.
+ * @param[in] h       CLIgen handle
+ * @param[in] n       Max number of commands, 0 means unlimited (default)
+ * @retval    0       OK
+ * @retval   -1       Error, negative n
+ * @see print_help_lines
+ */
+int 
+cligen_help_max_set(cligen_handle h,
+		    int           n)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (n < 0){
+	errno = EINVAL;
+	return -1;
+    }
+    ch->ch_help_max = n;
     return 0;
 }
 
@@ -701,64 +1275,62 @@ cligen_tabmode_set(cligen_handle h,
     return 0;
 }
 
-static int _lexicalorder = 0; /* XXX shouldnt be global */
-
 /*! Get lexical matching order
  * 
- * @param[in] h       CLIgen handle
+ * @param[in] h       CLIgen handle, or NULL for handle bound to thread
  * @retval 0  strcmp
  * @retval 1  strverscmp
  */
 int
 cligen_lexicalorder(cligen_handle h)
 {
-//    struct cligen_handle *ch = handle(h);
+    struct cligen_handle *ch = handle_thread(h);
 
-//    return ch->ch_lexicalorder;
-    return _lexicalorder;
+    return ch ? ch->ch_lexicalorder : _lexicalorder;
 }
 
 /*! Set lexical matching order.
  * 
- * @param[in] h  CLIgen handle
+ * @param[in] h  CLIgen handle, or NULL for handle bound to thread
  * @param[in] n  strcmp (0) or strverscmp (1).
  */
 int
 cligen_lexicalorder_set(cligen_handle h, 
 			int           n)
 {
-//    struct cligen_handle *ch = handle(h);
+    struct cligen_handle *ch = handle_thread(h);
 
-//    ch->ch_lexicalorder = n;
-    _lexicalorder = n;
+    if (ch)
+	ch->ch_lexicalorder = n;
+    else
+	_lexicalorder = n;
     return 0;
 }
 
-static int _ignorecase = 0; /* XXX shouldnt be global */
-
 /*! Ignore uppercase/lowercase or not
- * @param[in] h       CLIgen handle
+ * @param[in] h       CLIgen handle, or NULL for handle bound to thread
  */
 int
 cligen_ignorecase(cligen_handle h)
 {
-//    struct cligen_handle *ch = handle(h);
+    struct cligen_handle *ch = handle_thread(h);
 
-//    return ch->ch_ignorecase;
-    return _ignorecase;
+    return ch ? ch->ch_ignorecase : _ignorecase;
 }
 
 /*! Ignore uppercase/lowercase or not
- * @param[in] h       CLIgen handle
+ * @param[in] h       CLIgen handle, or NULL for handle bound to thread
  */
 int
 cligen_ignorecase_set(cligen_handle h, 
 		      int           n)
 {
-//    struct cligen_handle *ch = handle(h);
+    struct cligen_handle *ch = handle_thread(h);
 
-//    ch->ch_ignorecase = n;
-    _ignorecase = n;
+    if (ch)
+	ch->ch_ignorecase = n;
+    else
+	_ignorecase = n;
     return 0;
 }
 
@@ -840,9 +1412,6 @@ cligen_regex_xsd_set(cligen_handle h,
 }
 
 
-static int _getline_bufsize = GETLINE_BUFLEN_DEFAULT;
-static int _getline_killbufsize = GETLINE_BUFLEN_DEFAULT;
-
 /*!
  * @param[in] h       CLIgen handle
  */
@@ -872,7 +1441,9 @@ cligen_killbuf(cligen_handle h)
 int 
 cligen_buf_size(cligen_handle h)
 {
-    return _getline_bufsize;
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_buf_size;
 }
 
 /*! Return length cligen kill buffer
@@ -881,7 +1452,9 @@ cligen_buf_size(cligen_handle h)
 int 
 cligen_killbuf_size(cligen_handle h)
 {
-    return _getline_killbufsize;
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_killbuf_size;
 }
 
 /*!
@@ -892,16 +1465,18 @@ cligen_buf_init(cligen_handle h)
 {
     struct cligen_handle *ch = handle(h);
 
-    if ((ch->ch_buf = malloc(_getline_bufsize)) == NULL){
+    ch->ch_buf_size = GETLINE_BUFLEN_DEFAULT;
+    ch->ch_killbuf_size = GETLINE_BUFLEN_DEFAULT;
+    if ((ch->ch_buf = malloc(ch->ch_buf_size)) == NULL){
 	fprintf(stderr, "%s malloc: %s\n", __FUNCTION__, strerror(errno));
 	return -1;
     }
-    memset(ch->ch_buf, 0, _getline_bufsize);
-    if ((ch->ch_killbuf = malloc(_getline_killbufsize)) == NULL){
+    memset(ch->ch_buf, 0, ch->ch_buf_size);
+    if ((ch->ch_killbuf = malloc(ch->ch_killbuf_size)) == NULL){
 	fprintf(stderr, "%s malloc: %s\n", __FUNCTION__, strerror(errno));
 	return -1;
     }
-    memset(ch->ch_killbuf, 0, _getline_killbufsize);
+    memset(ch->ch_killbuf, 0, ch->ch_killbuf_size);
     return 0;
 }
 
@@ -918,17 +1493,17 @@ cligen_buf_increase(cligen_handle h,
 		    size_t        len1)
 {
     struct cligen_handle *ch = handle(h);
-    size_t                len0 = _getline_bufsize; /* orig length */
+    size_t                len0 = ch->ch_buf_size; /* orig length */
 
-    if (_getline_bufsize >= len1 + 1)
+    if (ch->ch_buf_size >= len1 + 1)
       return 0;
-    while (_getline_bufsize < len1 + 1)
-      _getline_bufsize *= 2;      
-    if ((ch->ch_buf = realloc(ch->ch_buf, _getline_bufsize)) == NULL){
+    while (ch->ch_buf_size < len1 + 1)
+      ch->ch_buf_size *= 2;      
+    if ((ch->ch_buf = realloc(ch->ch_buf, ch->ch_buf_size)) == NULL){
 	fprintf(stderr, "%s realloc: %s\n", __FUNCTION__, strerror(errno));
 	return -1;
     }
-    memset(ch->ch_buf+len0, 0, _getline_bufsize-len0);
+    memset(ch->ch_buf+len0, 0, ch->ch_buf_size-len0);
     return 0;
 }
 
@@ -941,17 +1516,17 @@ cligen_killbuf_increase(cligen_handle h,
 			size_t        len1)
 {
     struct cligen_handle *ch = handle(h);
-    int                   len0 = _getline_killbufsize;
+    int                   len0 = ch->ch_killbuf_size;
 
-    if (_getline_killbufsize >= len1 + 1)
+    if (ch->ch_killbuf_size >= len1 + 1)
       return 0;
-    while (_getline_killbufsize < len1 + 1)
-      _getline_killbufsize *= 2;      
-    if ((ch->ch_killbuf = realloc(ch->ch_killbuf, _getline_killbufsize)) == NULL){
+    while (ch->ch_killbuf_size < len1 + 1)
+      ch->ch_killbuf_size *= 2;      
+    if ((ch->ch_killbuf = realloc(ch->ch_killbuf, ch->ch_killbuf_size)) == NULL){
 	fprintf(stderr, "%s realloc: %s\n", __FUNCTION__, strerror(errno));
 	return -1;
     }
-    memset(ch->ch_killbuf+len0, 0, _getline_killbufsize-len0);
+    memset(ch->ch_killbuf+len0, 0, ch->ch_killbuf_size-len0);
     return 0;
 }
 
@@ -1052,5 +1627,1178 @@ cligen_reftree_filter_set(cligen_handle h,
     if (ch->ch_reftree_filter)
 	cvec_free(ch->ch_reftree_filter);
     ch->ch_reftree_filter = cvv;
+    cligen_treeref_cache_invalidate(h);
+    return 0;
+}
+
+/*! Get treeref cache mode: keep expanded tree references between commands
+ * @param[in] h      CLIgen handle
+ * @retval    1      Expanded tree references are kept until invalidated
+ * @retval    0      Expanded tree references are removed after each command
+ * @see cligen_treeref_cache_invalidate
+ */
+int 
+cligen_treeref_cache(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_treeref_cache;
+}
+
+/*! Set treeref cache mode: keep expanded tree references between commands
+ * If set, a tree reference (@tree) is expanded once and then reused by subsequent
+ * commands, completions and help until the expansion is invalidated.
+ * The expansions stay in the parse-trees between commands, so an application
+ * modifying or walking its parse-trees outside of cligen calls must call
+ * cligen_treeref_cache_invalidate first. Therefore it is off by default.
+ * The compiled matcher and completion state require it, see cligen_compile_set.
+ * @param[in] h      CLIgen handle
+ * @param[in] flag   Set to 1 to keep expansions, 0 to expand on every command (default)
+ * @retval    0      OK
+ */
+int 
+cligen_treeref_cache_set(cligen_handle h,
+			 int           flag)
+{
+    struct cligen_handle *ch = handle(h);
+
+    ch->ch_treeref_cache = flag;
+    ch->ch_treeref_dirty = 1;
+    ch->ch_complete_gen++;
+    return 0;
+}
+
+/*! Invalidate cached tree references. They are removed before next expansion
+ * The cache depends on the parse-trees, their working points and the reftree filter.
+ * This is called when any of those change, but an application that modifies a 
+ * parse-tree or the filter vector in place needs to call it explicitly.
+ * @param[in] h      CLIgen handle
+ * @retval    0      OK
+ * @see pt_expand_treeref_flush
+ */
+int
+cligen_treeref_cache_invalidate(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    ch->ch_treeref_dirty = 1;
+    ch->ch_complete_gen++;
+    return 0;
+}
+
+/*! Check if cached tree references are invalid and need to be flushed
+ * @param[in] h      CLIgen handle
+ * @retval    1      Cache is invalid
+ * @retval    0      Cache is valid (or empty)
+ */
+int
+cligen_treeref_cache_dirty(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_treeref_dirty;
+}
+
+/*! Mark cached tree references as valid after a flush
+ * @param[in] h      CLIgen handle
+ * @retval    0      OK
+ */
+int
+cligen_treeref_cache_clean(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    ch->ch_treeref_dirty = 0;
+    return 0;
+}
+
+/*! Get treeref share mode: share referenced trees instead of copying them
+ * @param[in] h      CLIgen handle
+ * @retval    1      Referenced trees are shared read-only when possible
+ * @retval    0      Referenced trees are always copied
+ */
+int 
+cligen_treeref_share(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_treeref_share;
+}
+
+/*! Set treeref share mode: share referenced trees instead of copying them
+ * If set, a tree reference (@tree) only creates a thin top-level node for each top
+ * object of the referenced tree, and shares the sub-trees below it read-only.
+ * A reference is still copied if it has callbacks, is hidden, if the referenced tree
+ * contains tree references itself, or if any of its objects are filtered.
+ * @param[in] h      CLIgen handle
+ * @param[in] flag   Set to 1 to share, 0 to copy (default)
+ * @retval    0      OK
+ */
+int 
+cligen_treeref_share_set(cligen_handle h,
+			 int           flag)
+{
+    struct cligen_handle *ch = handle(h);
+
+    ch->ch_treeref_share = flag;
+    ch->ch_treeref_dirty = 1;
+    ch->ch_complete_gen++;
+    return 0;
+}
+
+/*! Get scratch cv of a given type for temporary use
+ *
+ * Used for candidate variables in matching, to avoid allocating and freeing a cv
+ * for each candidate. The cv is owned by the handle and reset on each call, contents
+ * are only valid until next call. Do not free it.
+ * @param[in] h       CLIgen handle
+ * @param[in] type    Type of cv
+ * @retval    cv      Reset cv of type
+ * @retval    NULL    Error
+ */
+cg_var *
+cligen_scratch_cv(cligen_handle h,
+		  enum cv_type  type)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (ch->ch_scratch_cv == NULL){
+	if ((ch->ch_scratch_cv = cv_new(type)) == NULL){
+	    fprintf(stderr, "%s: cv_new: %s\n", __FUNCTION__, strerror(errno));
+	    return NULL;
+	}
+    }
+    else{
+	cv_reset(ch->ch_scratch_cv);
+	cv_type_set(ch->ch_scratch_cv, type);
+    }
+    return ch->ch_scratch_cv;
+}
+
+/*! Get line arena if enabled and a command line is being processed, else NULL
+ *
+ * Short-lived expanded parse-trees of one command line (eg ptn in the match functions)
+ * are allocated from this arena, which is released when the line is done.
+ * @param[in] h       CLIgen handle
+ * @retval    ca      Line arena
+ * @retval    NULL    No line in progress or line arena disabled
+ * @see cligen_line_begin
+ */
+struct cligen_arena *
+cligen_line_arena(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (ch->ch_line_depth == 0 || !ch->ch_line_arena_enabled)
+	return NULL;
+    return ch->ch_line_arena;
+}
+
+/*! Enable or disable line arena
+ * @param[in] h       CLIgen handle
+ * @param[in] flag    0: malloc each expanded parse-tree, 1: use line arena (default)
+ * @note Do not change while a line is in progress
+ */
+int
+cligen_line_arena_set(cligen_handle h,
+		      int           flag)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (ch->ch_line_depth != 0){
+	errno = EBUSY;
+	return -1;
+    }
+    ch->ch_line_arena_enabled = flag;
+    return 0;
+}
+
+/*! Get intern table of object strings if interning is enabled, else NULL
+ * @param[in] h       CLIgen handle
+ * @retval    ci      Intern table
+ * @retval    NULL    Interning not enabled
+ * @see cligen_intern_set
+ */
+struct cligen_intern *
+cligen_intern_table(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (!ch->ch_intern_enabled)
+	return NULL;
+    return ch->ch_intern;
+}
+
+/*! Enable or disable string interning of parsed specs
+ *
+ * If enabled, keywords, help texts and variable specs of objects parsed by
+ * cligen_parse_str or loaded from an image are shared in a per-handle intern table,
+ * and copies of the objects (eg expanded tree references) share them instead of
+ * duplicating them. Interned fields are read-only, see co_intern.
+ * The table is kept until cligen_exit also if interning is disabled later.
+ * @param[in] h       CLIgen handle
+ * @param[in] flag    0: each object owns its strings (default), 1: intern strings
+ * @retval    0       OK
+ * @retval   -1       Error
+ */
+int
+cligen_intern_set(cligen_handle h,
+		  int           flag)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (flag && ch->ch_intern == NULL &&
+	(ch->ch_intern = cligen_intern_new()) == NULL)
+	return -1;
+    ch->ch_intern_enabled = flag;
+    return 0;
+}
+
+/*! Get compiled matcher table if compiled matching is enabled, else NULL
+ * @param[in] h       CLIgen handle
+ * @retval    ct      Compiled table
+ * @retval    NULL    Compiled matching not enabled
+ * @see cligen_compile_set
+ */
+struct cligen_ctab *
+cligen_compile_table(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (!ch->ch_compile_enabled)
+	return NULL;
+    return ch->ch_ctab;
+}
+
+/*! Enable or disable the compiled matcher of command lines
+ *
+ * If enabled, cliread_parse first matches a line with per-level tables of keywords
+ * and variables, compiled on first use, and only walks the parse-tree with
+ * match_pattern_exact if the tables cannot decide the line.
+ * Requires cached tree references, see cligen_treeref_cache_set.
+ * Compiled tables are removed when cached tree references are flushed, see
+ * cligen_compile_invalidate.
+ * @param[in] h       CLIgen handle
+ * @param[in] flag    0: walk parse-tree (default), 1: compiled matcher first
+ * @retval    0       OK
+ * @retval   -1       Error
+ */
+int
+cligen_compile_set(cligen_handle h,
+		   int           flag)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (flag && ch->ch_ctab == NULL &&
+	(ch->ch_ctab = cligen_ctab_new()) == NULL)
+	return -1;
+    if (!flag && ch->ch_ctab)
+	cligen_compile_invalidate(h);
+    ch->ch_compile_enabled = flag;
+    return 0;
+}
+
+/*! Begin processing a command line: parse, completion or help
+ *
+ * Calls may be nested (eg an expand callback parsing another line) and must be paired
+ * with cligen_line_end using the returned mark.
+ * @param[in]  h       CLIgen handle
+ * @param[out] mark    Position in line arena to release to
+ * @retval     0       OK
+ * @retval    -1       Error
+ */
+int
+cligen_line_begin(cligen_handle h,
+		  size_t       *mark)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (ch->ch_line_arena_enabled && ch->ch_line_arena == NULL &&
+	(ch->ch_line_arena = cligen_arena_new(0)) == NULL)
+	return -1;
+    *mark = cligen_arena_mark(ch->ch_line_arena);
+    if (ch->ch_line_depth == 0){
+	ch->ch_line_mark = *mark;
+	cligen_arena_peak_reset(ch->ch_line_arena);
+	ch->ch_expand_incomplete = 0;
+	ch->ch_expand_begin = idle_now();
+	match_memo_reset(ch->ch_match_memo);
+    }
+    ch->ch_line_depth++;
+    return 0;
+}
+
+/*! End processing of a command line, release everything allocated in line arena after mark
+ *
+ * All parse-trees allocated from line arena after mark must have been freed (pt_free)
+ * @param[in]  h       CLIgen handle
+ * @param[in]  mark    Position from cligen_line_begin
+ * @retval     0       OK
+ * @retval    -1       Error
+ */
+int
+cligen_line_end(cligen_handle h,
+		size_t        mark)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (ch->ch_line_depth == 0){
+	errno = EINVAL;
+	return -1;
+    }
+    ch->ch_line_depth--;
+    if (ch->ch_line_depth == 0 && ch->ch_line_arena){
+	ch->ch_line_scratch_last = cligen_arena_peak(ch->ch_line_arena) - ch->ch_line_mark;
+	if (ch->ch_line_scratch_last > ch->ch_line_scratch_max)
+	    ch->ch_line_scratch_max = ch->ch_line_scratch_last;
+    }
+    if (ch->ch_line_arena)
+	return cligen_arena_release(ch->ch_line_arena, mark);
+    return 0;
+}
+
+/*! Get line arena memory used by command lines
+ *
+ * Only short-lived trees allocated from the line arena are counted, see
+ * cligen_line_arena. Objects copied with malloc (eg if the line arena is disabled) are
+ * counted by co_count_get instead.
+ * @param[in]  h     CLIgen handle
+ * @param[out] last  Bytes used by last line (or NULL)
+ * @param[out] max   Most bytes used by a line since start or cligen_line_scratch_reset (or NULL)
+ * @param[out] size  Bytes allocated from the system by line arena (or NULL)
+ */
+int
+cligen_line_scratch_get(cligen_handle h,
+			size_t       *last,
+			size_t       *max,
+			size_t       *size)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (last)
+	*last = ch->ch_line_scratch_last;
+    if (max)
+	*max = ch->ch_line_scratch_max;
+    if (size)
+	*size = cligen_arena_size(ch->ch_line_arena);
+    return 0;
+}
+
+/*! Reset high-water mark of line arena memory used by command lines
+ * @param[in]  h     CLIgen handle
+ * @see cligen_line_scratch_get
+ */
+int
+cligen_line_scratch_reset(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    ch->ch_line_scratch_last = 0;
+    ch->ch_line_scratch_max = 0;
+    return 0;
+}
+
+/*! Get if variable matches of a line are memoized
+ * @param[in] h       CLIgen handle
+ * @see cligen_match_memo_set
+ */
+int
+cligen_match_memo(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_match_memo_enabled;
+}
+
+/*! Memoize variable matches of a line
+ *
+ * If enabled (default), the parse and validation result of a token and a variable is
+ * kept from cligen_line_begin until the next line, and reused when the token is matched
+ * with the same variable again, eg for another alternative or when binding variables.
+ * @param[in] h       CLIgen handle
+ * @param[in] flag    0: parse a token each time, 1: memoize (default)
+ */
+int
+cligen_match_memo_set(cligen_handle h,
+		      int           flag)
+{
+    struct cligen_handle *ch = handle(h);
+
+    ch->ch_match_memo_enabled = flag;
+    return 0;
+}
+
+/*! Get memo of variable matches of the current line, created on first use
+ * @param[in] h       CLIgen handle
+ * @retval    mm      Memo, owned by handle, see match_memo_new
+ * @retval    NULL    Not enabled, not within cligen_line_begin/end, or error
+ */
+void *
+cligen_match_memo_get(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (!ch->ch_match_memo_enabled || ch->ch_line_depth == 0)
+	return NULL;
+    if (ch->ch_match_memo == NULL)
+	ch->ch_match_memo = match_memo_new();
+    return ch->ch_match_memo;
+}
+
+/*! Get reusable buffers of parsing lines of the handle, created on first use
+ *
+ * Match results and variable vectors of cliread_parse are taken from and given back to
+ * the context, keeping their allocated space between lines. Applications parsing lines
+ * in a loop get their variable vectors with cligen_parse_cvec_get.
+ * @param[in] h       CLIgen handle
+ * @retval    pc      Parse context, owned by handle
+ * @retval    NULL    Error
+ * @see cligen_parse_ctx_stats
+ */
+struct cligen_parse_ctx *
+cligen_parse_ctx_get(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (ch->ch_parse_ctx == NULL)
+	ch->ch_parse_ctx = cligen_parse_ctx_new();
+    return ch->ch_parse_ctx;
+}
+
+/*! Get pool of free cbufs of the handle
+ *
+ * The pool is bound to the calling thread with the handle, see cligen_thread_set, so
+ * that cbufs freed while the handle is bound keep their buffers for the next cbuf_new.
+ * @param[in] h       CLIgen handle
+ * @retval    cp      Pool, owned by handle
+ * @see cbuf_pool_stats
+ */
+struct cbuf_pool *
+cligen_cbuf_pool(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_cbuf_pool;
+}
+
+/*! Get line editing state of the handle
+ *
+ * The state holds the line being edited, the screen line, pasted text and the width,
+ * UTF-8 and scrolling settings of getline. It is selected by gl_getline of the handle
+ * and while the handle is bound to the calling thread, see cligen_thread_set.
+ * @param[in] h       CLIgen handle, or NULL for the handle bound to the thread
+ * @retval    gs      Line editing state, owned by handle
+ * @retval    NULL    No handle, getline uses the state of threads without handle
+ */
+struct gl_state *
+cligen_gl_state(cligen_handle h)
+{
+    struct cligen_handle *ch = handle_thread(h);
+
+    return ch ? ch->ch_gl_state : NULL;
+}
+
+/*! Get completion state mode: reuse match state of a line between keystrokes
+ * @param[in] h      CLIgen handle
+ * @retval    1      Match state of all but the last token is reused by completion and help
+ * @retval    0      Every completion and help matches the whole line
+ * @see match_state_resume
+ */
+int 
+cligen_complete_state(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_complete_state;
+}
+
+/*! Set completion state mode: reuse match state of a line between keystrokes
+ * If set, TAB and '?' save the matched path up to the last token of the line. The next
+ * TAB or '?' with the same preceding tokens only matches the last level.
+ * The saved path refers to expanded tree references, so setting it also enables the
+ * treeref cache, see cligen_treeref_cache_set. If the cache is disabled afterwards, the
+ * state is not used. Resumed matches are counted as phase resume, see cligen_stats_set.
+ * @param[in] h      CLIgen handle
+ * @param[in] flag   Set to 1 to reuse state, 0 to match whole line (default)
+ * @retval    0      OK
+ */
+int 
+cligen_complete_state_set(cligen_handle h,
+			  int           flag)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (flag && cligen_treeref_cache_set(h, 1) < 0)
+	return -1;
+    ch->ch_complete_state = flag;
+    ch->ch_complete_gen++;
+    return 0;
+}
+
+/*! Invalidate saved completion state
+ * The state refers to objects in the parse-trees and depends on expand callbacks. It is
+ * invalidated with the treeref cache and on each new line, but an application that 
+ * modifies a parse-tree in place or changes expand data in a line needs to call it.
+ * @param[in] h      CLIgen handle
+ * @retval    0      OK
+ * @see cligen_treeref_cache_invalidate
+ */
+int
+cligen_complete_state_invalidate(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    ch->ch_complete_gen++;
+    return 0;
+}
+
+/*! Get generation of completion state, saved state of other generations is stale
+ * @param[in] h      CLIgen handle
+ */
+int
+cligen_complete_state_gen(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_complete_gen;
+}
+
+/*! Get saved completion state
+ * @param[in] h      CLIgen handle
+ * @retval    ms     Match state, owned by handle (or NULL)
+ */
+void *
+cligen_complete_state_get(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_complete_ms;
+}
+
+/*! Save completion state, and free previous
+ * @param[in] h      CLIgen handle
+ * @param[in] ms     Match state, consumed (or NULL)
+ * @retval    0      OK
+ */
+int
+cligen_complete_state_put(cligen_handle h,
+			  void         *ms)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (ch->ch_complete_ms && ch->ch_complete_ms != ms)
+	match_state_free(ch->ch_complete_ms);
+    ch->ch_complete_ms = ms;
+    return 0;
+}
+
+/*! Take the reusable token vector from handle
+ * @param[in] h      CLIgen handle
+ * @retval    tk     Token vector, give back with cligen_tokens_cache_put
+ * @retval    NULL   None, eg in use by an outer line
+ * @see cligen_str2tokens
+ */
+void *
+cligen_tokens_cache_get(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+    cligen_tokens        *tk;
+
+    tk = ch->ch_tokens;
+    ch->ch_tokens = NULL;
+    return tk;
+}
+
+/*! Give back a token vector to handle to be reused, free it if there already is one
+ * @param[in] h      CLIgen handle
+ * @param[in] tk     Token vector, consumed
+ * @retval    0      OK
+ */
+int
+cligen_tokens_cache_put(cligen_handle h,
+			void         *tk)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (ch->ch_tokens == NULL)
+	ch->ch_tokens = tk;
+    else if (ch->ch_tokens != tk)
+	cligen_tokens_free(tk);
+    return 0;
+}
+
+/*! Get expand cache mode: reuse results of expand callbacks
+ * @param[in] h      CLIgen handle
+ * @retval    1      Results of expand callbacks are cached
+ * @retval    0      Expand callbacks are called on every expansion
+ */
+int
+cligen_expand_cache(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_expand_cache;
+}
+
+/*! Set expand cache mode: reuse results of expand callbacks
+ *
+ * If set, the commands and helptexts of an expand callback (expandv_cb) are kept and reused
+ * by later expansions with the same callback, arguments and variable values, eg on the
+ * next TAB, '?' or level. A result is reused until it is older than the TTL or the cache is
+ * invalidated. The whole command line (first element of cvv) is not part of the key.
+ * @param[in] h      CLIgen handle
+ * @param[in] flag   Set to 1 to cache, 0 to call the callbacks on every expansion (default)
+ * @retval    0      OK
+ * @see cligen_expand_cache_ttl_set
+ * @see cligen_expand_cache_invalidate
+ */
+int
+cligen_expand_cache_set(cligen_handle h,
+			int           flag)
+{
+    struct cligen_handle *ch = handle(h);
+
+    ch->ch_expand_cache = flag;
+    ch->ch_expand_cache_gen++;
+    return 0;
+}
+
+/*! Get lifetime of cached expand results in milliseconds, 0 means no limit
+ * @param[in] h      CLIgen handle
+ */
+int
+cligen_expand_cache_ttl(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_expand_cache_ttl;
+}
+
+/*! Set lifetime of cached expand results
+ * @param[in] h      CLIgen handle
+ * @param[in] ttl    Lifetime in milliseconds, 0 means until invalidated.
+ *                   Default CLIGEN_EXPAND_CACHE_TTL
+ * @retval    0      OK
+ * @retval   -1      Error, negative ttl
+ */
+int
+cligen_expand_cache_ttl_set(cligen_handle h,
+			    int           ttl)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (ttl < 0){
+	errno = EINVAL;
+	return -1;
+    }
+    ch->ch_expand_cache_ttl = ttl;
+    return 0;
+}
+
+/*! Invalidate cached expand results, eg when the data the callbacks read has changed
+ * @param[in] h      CLIgen handle
+ * @retval    0      OK
+ */
+int
+cligen_expand_cache_invalidate(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    ch->ch_expand_cache_gen++;
+    return 0;
+}
+
+/*! Get generation of expand cache, cached results of other generations are stale
+ * @param[in] h      CLIgen handle
+ */
+int
+cligen_expand_cache_gen(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_expand_cache_gen;
+}
+
+/*! Get cached expand results, see pt_expand_fnv
+ * @param[in] h      CLIgen handle
+ * @retval    ec     Expand cache, or NULL
+ */
+void *
+cligen_expand_cache_get(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_expand_cache_tab;
+}
+
+/*! Set cached expand results, the handle frees it in cligen_exit
+ * @param[in] h      CLIgen handle
+ * @param[in] ec     Expand cache, consumed
+ * @retval    0      OK
+ */
+int
+cligen_expand_cache_put(cligen_handle h,
+			void         *ec)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (ch->ch_expand_cache_tab && ch->ch_expand_cache_tab != ec)
+	pt_expand_cache_free(ch->ch_expand_cache_tab);
+    ch->ch_expand_cache_tab = ec;
+    return 0;
+}
+
+/*! Get max time to wait for pending expand results in milliseconds
+ * @param[in] h      CLIgen handle
+ */
+int
+cligen_expand_deadline(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_expand_deadline;
+}
+
+/*! Set max time to wait for pending expand results
+ *
+ * An expand callback returning CLIGEN_EXPAND_PENDING delivers its commands later with
+ * cligen_expand_add, typically from a callback registered with cligen_regfd. Registered
+ * file descriptors are served until cligen_expand_done is called or the deadline passes.
+ * After the deadline, the commands delivered so far are used and the expansion is
+ * marked incomplete.
+ * @param[in] h      CLIgen handle
+ * @param[in] ms     Max wait in milliseconds, 0: do not wait. Default CLIGEN_EXPAND_DEADLINE
+ * @retval    0      OK
+ * @retval   -1      Error, negative deadline
+ * @see cligen_expand_incomplete
+ */
+int
+cligen_expand_deadline_set(cligen_handle h,
+			   int           ms)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (ms < 0){
+	errno = EINVAL;
+	return -1;
+    }
+    ch->ch_expand_deadline = ms;
+    return 0;
+}
+
+/*! Get what is left of the expand deadline
+ *
+ * The deadline is counted from the start of the line or keystroke, see cligen_line_begin,
+ * so that all pending expansions of a line share it.
+ * @param[in] h      CLIgen handle
+ * @retval    ms     Milliseconds left, 0 if passed
+ * @see cligen_expand_deadline_set
+ */
+int
+cligen_expand_left(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+    uint64_t              end;
+    uint64_t              now;
+
+    if (ch->ch_line_depth == 0) /* Not in a line, full deadline */
+	return ch->ch_expand_deadline;
+    end = ch->ch_expand_begin + ch->ch_expand_deadline;
+    if ((now = idle_now()) >= end)
+	return 0;
+    return (int)(end - now);
+}
+
+/*! Set result vectors of the pending expansion, see pt_expand_fnv
+ * @param[in] h          CLIgen handle
+ * @param[in] commands   Commands of expansion, or NULL when expansion is over
+ * @param[in] helptexts  Helptexts of expansion
+ * @retval    id         Id of the new pending expansion, >0
+ * @retval    0          Expansion is over
+ * @see cligen_expand_id
+ */
+int
+cligen_expand_pending_set(cligen_handle h,
+			  cvec         *commands,
+			  cvec         *helptexts)
+{
+    struct cligen_handle *ch = handle(h);
+
+    ch->ch_expand_commands = commands;
+    ch->ch_expand_helptexts = helptexts;
+    if (commands == NULL)
+	ch->ch_expand_id = 0;
+    else{
+	if (++ch->ch_expand_gen <= 0) /* wrap */
+	    ch->ch_expand_gen = 1;
+	ch->ch_expand_id = ch->ch_expand_gen;
+    }
+    return ch->ch_expand_id;
+}
+
+/*! Get the id of the pending expansion
+ *
+ * An expand callback gets the id of its expansion and passes it to cligen_expand_add
+ * and cligen_expand_done, so that results of an earlier expansion arriving late are
+ * dropped.
+ * @param[in] h      CLIgen handle
+ * @retval    id     Id of pending expansion
+ * @retval    0      No pending expansion
+ */
+int
+cligen_expand_id(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_expand_id;
+}
+
+/*! Check if an expansion waits for results
+ * @param[in] h      CLIgen handle
+ * @retval    1      Pending, cligen_expand_done not yet called
+ * @retval    0      No pending expansion
+ */
+int
+cligen_expand_pending(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_expand_commands != NULL;
+}
+
+/*! Deliver a command of a pending expansion
+ *
+ * Called by the application after its expand callback returned CLIGEN_EXPAND_PENDING,
+ * or from the callback itself.
+ * @param[in] h      CLIgen handle
+ * @param[in] id     Id of expansion, see cligen_expand_id
+ * @param[in] cmd    Command
+ * @param[in] help   Helptext, or NULL
+ * @retval    0      OK, command added
+ * @retval    1      Not the pending expansion, eg the deadline passed, command is dropped
+ * @retval   -1      Error
+ * @see cligen_expand_done
+ */
+int
+cligen_expand_add(cligen_handle h,
+		  int           id,
+		  char         *cmd,
+		  char         *help)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (cmd == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    if (ch->ch_expand_commands == NULL || id != ch->ch_expand_id)
+	return 1;
+    if (cvec_add_string(ch->ch_expand_commands, NULL, cmd) < 0)
+	return -1;
+    if (cvec_add_string(ch->ch_expand_helptexts, NULL, help?help:"") < 0)
+	return -1;
+    return 0;
+}
+
+/*! All commands of a pending expansion are delivered
+ * @param[in] h      CLIgen handle
+ * @param[in] id     Id of expansion, see cligen_expand_id
+ * @retval    0      OK
+ * @retval    1      Not the pending expansion, ignored
+ * @see cligen_expand_add
+ */
+int
+cligen_expand_done(cligen_handle h,
+		   int           id)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (ch->ch_expand_commands == NULL || id != ch->ch_expand_id)
+	return 1;
+    return cligen_expand_pending_set(h, NULL, NULL);
+}
+
+/*! Check if an expansion of the current line passed the deadline with partial results
+ * @param[in] h      CLIgen handle
+ * @retval    1      Incomplete
+ * @retval    0      Complete
+ * @see cligen_expand_deadline_set
+ */
+int
+cligen_expand_incomplete(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_expand_incomplete;
+}
+
+/*! Mark an expansion of the current line as incomplete, reset by cligen_line_begin
+ * @param[in] h      CLIgen handle
+ * @retval    0      OK
+ */
+int
+cligen_expand_incomplete_set(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    ch->ch_expand_incomplete = 1;
+    return 0;
+}
+
+/*! Get idle time before pre-expansion of the line being typed
+ * @param[in] h      CLIgen handle
+ * @retval    ms     Idle time in milliseconds, 0: no pre-expansion
+ */
+int
+cligen_idle_expand(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_idle_expand;
+}
+
+/*! Pre-expand the line being typed when no key is typed within a time
+ *
+ * When the terminal is idle, the line is matched as for '?' without output. A following
+ * TAB or '?' resumes from the saved match state and finds expanded tree references
+ * and expand results cached, if enabled with cligen_complete_state_set and
+ * cligen_expand_cache_set. The pre-expansion stops at its next step when a key is
+ * typed.
+ * @param[in] h      CLIgen handle
+ * @param[in] ms     Idle time in milliseconds, 0: no pre-expansion (default)
+ * @retval    0      OK
+ * @retval   -1      Error, negative time
+ * @see cligen_idle_budget_set
+ */
+int
+cligen_idle_expand_set(cligen_handle h,
+		       int           ms)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (ms < 0){
+	errno = EINVAL;
+	return -1;
+    }
+    ch->ch_idle_expand = ms;
+    return 0;
+}
+
+/*! Get max time of expand callbacks in a pre-expansion
+ * @param[in] h      CLIgen handle
+ * @retval    ms     Budget in milliseconds
+ */
+int
+cligen_idle_budget(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_idle_budget;
+}
+
+/*! Set max time of expand callbacks in a pre-expansion
+ *
+ * Expand callbacks are called by a pre-expansion until the budget is spent, and pending
+ * results are waited for at most the rest of it. Results are cached if the expand cache
+ * is enabled.
+ * @param[in] h      CLIgen handle
+ * @param[in] ms     Budget in milliseconds, 0: expand callbacks are not called (default)
+ * @retval    0      OK
+ * @retval   -1      Error, negative budget
+ * @see cligen_idle_expand_set
+ */
+int
+cligen_idle_budget_set(cligen_handle h,
+		       int           ms)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (ms < 0){
+	errno = EINVAL;
+	return -1;
+    }
+    ch->ch_idle_budget = ms;
+    return 0;
+}
+
+/*! Current time in milliseconds
+ */
+static uint64_t
+idle_now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec*1000 + tv.tv_usec/1000;
+}
+
+/*! Begin a pre-expansion, its budget starts now
+ * @param[in] h      CLIgen handle
+ * @retval    0      OK
+ * @see cligen_idle_end
+ */
+int
+cligen_idle_begin(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    ch->ch_idle_end = idle_now() + ch->ch_idle_budget;
+    return 0;
+}
+
+/*! End a pre-expansion
+ * @param[in] h      CLIgen handle
+ * @retval    0      OK
+ */
+int
+cligen_idle_end(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    ch->ch_idle_end = 0;
+    return 0;
+}
+
+/*! Get what is left of the budget of a pre-expansion
+ * @param[in] h      CLIgen handle
+ * @retval    ms     Milliseconds left of budget, 0 if spent
+ * @retval   -1      No pre-expansion ongoing
+ */
+int
+cligen_idle_left(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+    uint64_t              now;
+
+    if (ch->ch_idle_end == 0)
+	return -1;
+    if ((now = idle_now()) >= ch->ch_idle_end)
+	return 0;
+    return (int)(ch->ch_idle_end - now);
+}
+
+/*! Get eval argv copy mode: callbacks get a copy of their argument vector
+ * @param[in] h      CLIgen handle
+ * @retval    1      Each callback gets a copy of its arguments that it may modify
+ * @retval    0      Callbacks get the arguments of the parse-tree read-only
+ */
+int
+cligen_eval_argv_copy(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_eval_argv_copy;
+}
+
+/*! Set eval argv copy mode: callbacks get a copy of their argument vector
+ *
+ * Callback argument vectors are shared by all copies of an object, see co_callback_copy. 
+ * By default cligen_eval passes the shared vector, which the callback must not modify.
+ * If set, the vector is copied before each callback and freed after it.
+ * @param[in] h      CLIgen handle
+ * @param[in] flag   Set to 1 to copy, 0 to pass the arguments read-only (default)
+ * @retval    0      OK
+ */
+int
+cligen_eval_argv_copy_set(cligen_handle h,
+			  int           flag)
+{
+    struct cligen_handle *ch = handle(h);
+
+    ch->ch_eval_argv_copy = flag;
+    return 0;
+}
+
+/*! Get function registry of handle
+ * @param[in] h      CLIgen handle, or NULL for the handle bound to the thread
+ * @retval    cr     Registry
+ * @retval    NULL   No functions registered
+ * @see cligen_fn_register
+ */
+struct cligen_registry *
+cligen_fn_registry(cligen_handle h)
+{
+    struct cligen_handle *ch = handle_thread(h);
+
+    return ch ? ch->ch_fn_registry : NULL;
+}
+
+/*! Set function registry of handle, any previous registry is freed
+ * @param[in] h      CLIgen handle
+ * @param[in] cr     Registry, freed by cligen_exit
+ * @retval    0      OK
+ */
+int
+cligen_fn_registry_set(cligen_handle           h,
+		       struct cligen_registry *cr)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (ch->ch_fn_registry && ch->ch_fn_registry != cr)
+	cligen_registry_free(ch->ch_fn_registry);
+    ch->ch_fn_registry = cr;
+    return 0;
+}
+
+/*! Get id of a label, a new label is given the next free id
+ *
+ * Labels are the local variables of objects (co_cvec), such as "hide" or labels filtered
+ * by tree references. The id is a bit position in the label masks of objects.
+ * @param[in] h     CLIgen handle
+ * @param[in] name  Label name
+ * @retval    id    Label id, 0..CLIGEN_LABELS_MAX-1
+ * @retval    CLIGEN_LABELS_MAX  All ids are taken, the label has no id
+ * @retval   -1     Error
+ * @see cligen_parsetree_labels
+ */
+int
+cligen_label_id(cligen_handle h,
+		char         *name)
+{
+    struct cligen_handle *ch = handle(h);
+    cg_var               *cv;
+    int                   id;
+
+    if (ch->ch_labels == NULL &&
+	(ch->ch_labels = cvec_new(0)) == NULL)
+	return -1;
+    if ((cv = cvec_find(ch->ch_labels, name)) != NULL)
+	return cv_int32_get(cv);
+    if ((id = cvec_len(ch->ch_labels)) >= CLIGEN_LABELS_MAX)
+	return CLIGEN_LABELS_MAX;
+    if ((cv = cvec_add(ch->ch_labels, CGV_INT32)) == NULL)
+	return -1;
+    if (cv_name_set(cv, name) == NULL)
+	return -1;
+    cv_int32_set(cv, id);
+    return id;
+}
+
+/*! Get file of output to stdout of the handle, or NULL for stdout
+ * @see cligen_output_file_set
+ */
+FILE *
+cligen_output_file(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_output_file;
+}
+
+/*! Redirect output to stdout of the handle, eg to the socket of a session
+ *
+ * Output made with cligen_output or cligen_output_cbuf to stdout while the handle is bound
+ * to the thread, see cligen_thread_set, is written to f instead. Output is not paged.
+ * @param[in] h   CLIgen handle
+ * @param[in] f   Open stdio FILE pointer, or NULL for stdout
+ * @retval    0   OK
+ */
+int
+cligen_output_file_set(cligen_handle h,
+		       FILE         *f)
+{
+    struct cligen_handle *ch = handle(h);
+
+    ch->ch_output_file = f;
     return 0;
 }
@@ -57,11 +57,21 @@
  */
 #define CLIGEN_TABMODE_STEPS    0x04
 
+/* Number of labels with an id, one bit each in object label masks, see cligen_label_id */
+#define CLIGEN_LABELS_MAX 63
+
 /*
  * Prototypes
  */
 cligen_handle cligen_init(void);
+cligen_handle cligen_clone(cligen_handle h0);
 int cligen_exit(cligen_handle);
+int cligen_share(cligen_handle h, cligen_handle h0);
+cligen_handle cligen_origin(cligen_handle h);
+cligen_handle cligen_copy(cligen_handle h0);
+int cligen_mode_copy(cligen_handle h, cligen_handle h0);
+int cligen_thread_set(cligen_handle h);
+cligen_handle cligen_thread(void);
 int cligen_check(cligen_handle h);
 
 int cligen_exiting(cligen_handle h);
@@ -104,6 +114,9 @@ int cligen_helpstring_truncate_set(cligen_handle h, int mode);
 int cligen_helpstring_lines(cligen_handle h);
 int cligen_helpstring_lines_set(cligen_handle h, int lines);
 
+int cligen_help_max(cligen_handle h);
+int cligen_help_max_set(cligen_handle h, int n);
+
 int cligen_tabmode(cligen_handle h);
 int cligen_tabmode_set(cligen_handle h, int mode);
 
@@ -143,4 +156,84 @@ int cligen_preference_mode_set(cligen_handle h, int flag);
 cvec *cligen_reftree_filter_get(cligen_handle h);
 int   cligen_reftree_filter_set(cligen_handle h, cvec *cvv);
 
+int cligen_treeref_cache(cligen_handle h);
+int cligen_treeref_cache_set(cligen_handle h, int flag);
+int cligen_treeref_cache_invalidate(cligen_handle h);
+int cligen_treeref_cache_dirty(cligen_handle h);
+int cligen_treeref_cache_clean(cligen_handle h);
+int cligen_treeref_share(cligen_handle h);
+int cligen_treeref_share_set(cligen_handle h, int flag);
+
+cg_var *cligen_scratch_cv(cligen_handle h, enum cv_type type);
+
+struct cligen_arena;  /* Forward declaration, see cligen_arena.h */
+struct cligen_arena *cligen_line_arena(cligen_handle h);
+int cligen_line_arena_set(cligen_handle h, int flag);
+int cligen_line_scratch_get(cligen_handle h, size_t *last, size_t *max, size_t *size);
+int cligen_line_scratch_reset(cligen_handle h);
+int cligen_line_begin(cligen_handle h, size_t *mark);
+int cligen_line_end(cligen_handle h, size_t mark);
+int cligen_match_memo(cligen_handle h);
+int cligen_match_memo_set(cligen_handle h, int flag);
+void *cligen_match_memo_get(cligen_handle h);
+
+struct cligen_intern;  /* Forward declaration, see cligen_intern.h */
+struct cligen_intern *cligen_intern_table(cligen_handle h);
+int cligen_intern_set(cligen_handle h, int flag);
+
+struct cligen_ctab;    /* Forward declaration, see cligen_compile.h */
+struct cligen_ctab *cligen_compile_table(cligen_handle h);
+int cligen_compile_set(cligen_handle h, int flag);
+
+int   cligen_complete_state(cligen_handle h);
+int   cligen_complete_state_set(cligen_handle h, int flag);
+int   cligen_complete_state_invalidate(cligen_handle h);
+int   cligen_complete_state_gen(cligen_handle h);
+void *cligen_complete_state_get(cligen_handle h);
+int   cligen_complete_state_put(cligen_handle h, void *ms);
+void *cligen_tokens_cache_get(cligen_handle h);
+int   cligen_tokens_cache_put(cligen_handle h, void *tk);
+
+int   cligen_expand_cache(cligen_handle h);
+int   cligen_expand_cache_set(cligen_handle h, int flag);
+int   cligen_expand_cache_ttl(cligen_handle h);
+int   cligen_expand_cache_ttl_set(cligen_handle h, int ttl);
+int   cligen_expand_cache_invalidate(cligen_handle h);
+int   cligen_expand_cache_gen(cligen_handle h);
+void *cligen_expand_cache_get(cligen_handle h);
+int   cligen_expand_cache_put(cligen_handle h, void *ec);
+int   cligen_expand_deadline(cligen_handle h);
+int   cligen_expand_deadline_set(cligen_handle h, int ms);
+int   cligen_expand_left(cligen_handle h);
+int   cligen_expand_pending_set(cligen_handle h, cvec *commands, cvec *helptexts);
+int   cligen_expand_id(cligen_handle h);
+int   cligen_expand_pending(cligen_handle h);
+int   cligen_expand_add(cligen_handle h, int id, char *cmd, char *help);
+int   cligen_expand_done(cligen_handle h, int id);
+int   cligen_expand_incomplete(cligen_handle h);
+int   cligen_expand_incomplete_set(cligen_handle h);
+int   cligen_idle_expand(cligen_handle h);
+int   cligen_idle_expand_set(cligen_handle h, int ms);
+int   cligen_idle_budget(cligen_handle h);
+int   cligen_idle_budget_set(cligen_handle h, int ms);
+int   cligen_idle_begin(cligen_handle h);
+int   cligen_idle_end(cligen_handle h);
+int   cligen_idle_left(cligen_handle h);
+
+int   cligen_eval_argv_copy(cligen_handle h);
+int   cligen_eval_argv_copy_set(cligen_handle h, int flag);
+
+struct cligen_parse_ctx; /* Forward declaration, see cligen_read.h */
+struct cligen_parse_ctx *cligen_parse_ctx_get(cligen_handle h);
+struct cbuf_pool *cligen_cbuf_pool(cligen_handle h);
+struct gl_state;         /* Forward declaration, see cligen_getline.c */
+struct gl_state *cligen_gl_state(cligen_handle h);
+struct cligen_registry;  /* Forward declaration, see cligen_registry.h */
+struct cligen_registry *cligen_fn_registry(cligen_handle h);
+int   cligen_fn_registry_set(cligen_handle h, struct cligen_registry *cr);
+int   cligen_label_id(cligen_handle h, char *name);
+
+FILE *cligen_output_file(cligen_handle h);
+int   cligen_output_file_set(cligen_handle h, FILE *f);
+
 #endif /* _CLIGEN_HANDLE_H_ */
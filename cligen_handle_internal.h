@@ -68,6 +68,10 @@ typedef struct pt_head  { /* Linked list of cligen parse-trees */
     int              ph_active;    /* First one is active */
     cg_obj          *ph_workpt;    /* Shortcut to "working point" cligen object, or more 
                                     * specifically its parse-tree sub vector. */
+    cligen_handle    ph_h;         /* Back-pointer to handle, for treeref cache invalidation */
+    struct pt_head  *ph_hnext;     /* Next in name index bucket of handle, see cligen_ph_find */
+    char            *ph_source;    /* Spec the tree was parsed from, see cligen_ph_reload */
+    uint64_t         ph_stamp;     /* Version of source, eg modification time */
 } pt_head;
 
 /* CLIgen handle. Its members should be hidden and only the typedef visible */
@@ -77,6 +81,11 @@ struct cligen_handle{
     char        ch_comment;      /* comment sign - everything behind it is ignored */
     char       *ch_prompt;       /* current prompt used */
     pt_head    *ch_pt_head;      /* Linked list of parsetrees */
+    pt_head   **ch_ph_index;     /* Hash index of parsetrees by name, built on demand */
+    int         ch_ph_slots;     /* Buckets of ch_ph_index, power of two */
+    int         ch_ph_len;       /* Parsetrees in ch_ph_index */
+    pt_head    *ch_ph_last;      /* Last parsetree in list, or NULL if not known */
+    pt_head    *ch_ph_active;    /* Active parsetree, or NULL if not known */
     char       *ch_treename_keyword; /* Name of treename parsing keyword */
     cg_obj     *ch_co_match;     /* Matching object in latest evaluation */
     char       *ch_fn_str;       /* Name of active callback function */
@@ -84,15 +93,18 @@ struct cligen_handle{
     char       *ch_nomatch;      /* Why did a string not match an evaluation? */
     int         ch_tabmode;      /* short or long output mode on TAB */
 
-    int         ch_lexicalorder; /* strcmp (0) or strverscmp (1) syntax order.
-                                    Also, this is global for now */
+    int         ch_lexicalorder; /* strcmp (0) or strverscmp (1) syntax order. */
     int         ch_ignorecase; /* dont care about aA (0), care about aA (1) 
-				     does not work if lexicalorder is set.
-				     Also this is global for now
-				  */
+				     does not work if lexicalorder is set. */
+    int         ch_terminalrows; /* Number of terminal rows used by cligen_output paging */
+    int         ch_helpstr_truncate; /* Truncate help string on right margin */
+    int         ch_helpstr_lines;  /* Max lines of help string to show, 0 means unlimited */
+    int         ch_help_max;     /* Max commands shown by ? and TAB, 0 means unlimited */
 
     char       *ch_buf;          /* getline input buffer */
+    int         ch_buf_size;     /* Length of ch_buf */
     char       *ch_killbuf;      /* getline killed text */
+    int         ch_killbuf_size; /* Length of ch_killbuf */
 
     int         ch_logsyntax;    /* Debug syntax by printing dynamically on stderr */
     int         ch_hist_size;    /* Number of history lines MUST be >0 */
@@ -100,6 +112,11 @@ struct cligen_handle{
     int         ch_hist_cur;     /* Current position (line) in history */
     int         ch_hist_last;    /* Last position in history */
     char       *ch_hist_pre;     /* Previous position in history */
+    uint64_t   *ch_hist_sig;     /* N-gram signature of each history line, see hist_search */
+    uint32_t   *ch_hist_hash;    /* Hash of each history line, for duplicates */
+    int         ch_hist_dedup;   /* Remove older duplicates when adding to history */
+    int         ch_hist_new;     /* Lines added since history file was loaded or saved */
+    int         ch_hist_flines;  /* Lines in history file, see cligen_hist_file_sync */
     
     void       *ch_userhandle;   /* Use this as app-specific callback handle */
     void       *ch_userdata;     /* application-specific data (any data) */
@@ -107,6 +124,55 @@ struct cligen_handle{
     char        ch_delimiter;    /* Delimiter between objects */
     int         ch_preference_mode;   /* Relaxed variable match preference handling */
     cvec       *ch_reftree_filter; /* Vector of reftree(@tree) labels that are disabled by default */
+    int         ch_treeref_cache;  /* Keep expanded tree references (@tree) between commands */
+    int         ch_treeref_dirty;  /* Cached tree references are stale, flush before next use */
+    int         ch_treeref_share;  /* Share referenced trees read-only instead of copying */
+    cg_var     *ch_scratch_cv;     /* Reusable cv for candidate variables, see cligen_scratch_cv */
+    struct cligen_arena *ch_line_arena; /* Arena for expanded trees of a line, see cligen_line_arena */
+    int         ch_line_arena_enabled; /* Use line arena (default) */
+    int         ch_line_depth;     /* Nesting of cligen_line_begin/end */
+    size_t      ch_line_mark;      /* Line arena position at outermost cligen_line_begin */
+    size_t      ch_line_scratch_last; /* Line arena used by last line, see cligen_line_scratch_get */
+    size_t      ch_line_scratch_max;  /* Most line arena used by a line */
+    void       *ch_match_memo;     /* Variable matches of the line, see match_variable */
+    int         ch_match_memo_enabled; /* Memoize variable matches of a line (default) */
+    int         ch_complete_state; /* Reuse match state of line between keystrokes */
+    int         ch_complete_gen;   /* Generation of parse-trees, bumped on invalidation */
+    void       *ch_complete_ms;    /* Saved match state, see match_state_resume */
+    struct cligen_tokens *ch_tokens; /* Reusable token vector, see cligen_str2tokens */
+    struct cligen_parse_ctx *ch_parse_ctx; /* Reusable buffers of parsing, see cligen_parse_ctx_get */
+    struct cbuf_pool *ch_cbuf_pool; /* Free cbufs, bound with the handle, see cbuf_pool_set */
+    struct gl_state  *ch_gl_state;  /* Line editing state, see cligen_gl_state */
+    struct cligen_intern *ch_intern; /* Intern table of object strings, see co_intern */
+    int         ch_intern_enabled; /* Intern strings of parsed specs */
+    struct cligen_ctab *ch_ctab;   /* Compiled matcher, see cligen_compile_match */
+    int         ch_compile_enabled; /* Match lines with compiled matcher first */
+    int         ch_expand_cache;   /* Cache results of expand callbacks */
+    int         ch_expand_cache_ttl; /* Lifetime of cached expand results in ms, 0: no limit */
+    int         ch_expand_cache_gen; /* Generation of expand results, bumped on invalidation */
+    void       *ch_expand_cache_tab; /* Cached expand results, see pt_expand_fnv */
+    int         ch_expand_deadline; /* Max wait in ms for pending expand results */
+    cvec       *ch_expand_commands; /* Commands of pending expansion, or NULL */
+    cvec       *ch_expand_helptexts; /* Helptexts of pending expansion */
+    int         ch_expand_id;      /* Id of pending expansion, 0: none */
+    int         ch_expand_gen;     /* Last id given to a pending expansion */
+    uint64_t    ch_expand_begin;   /* Start of line or keystroke in ms, deadline is counted from it */
+    int         ch_expand_incomplete; /* An expansion of this line passed the deadline */
+    int         ch_idle_expand;    /* Idle time in ms before pre-expansion of the line, 0: off */
+    int         ch_idle_budget;    /* Max time in ms of expand callbacks in a pre-expansion */
+    uint64_t    ch_idle_end;       /* End of budget of ongoing pre-expansion in ms, 0: none */
+    int         ch_stats_enabled;  /* Count and time phases, see cligen_stats_set */
+    cligen_stats ch_stats;         /* Counters since start or reset */
+    cligen_stats ch_stats_line;    /* Counters at start of line, then of the line */
+    cligen_stats_fn_t *ch_stats_fn; /* Per-line trace hook */
+    void       *ch_stats_arg;      /* Argument of trace hook */
+    int         ch_eval_argv_copy; /* Callbacks get a copy of their arguments */
+    struct cligen_registry *ch_fn_registry; /* Registered functions, see cligen_fn_register */
+    cvec       *ch_labels;         /* Label names, value is id, see cligen_label_id */
+    struct cligen_ostream *ch_ostream; /* Buffered output and filters, see cligen_output */
+    FILE       *ch_output_file;    /* Output to stdout goes here instead, see cligen_output_file_set */
+    cligen_handle ch_origin;       /* Handle owning shared parse-trees, see cligen_share */
+    int         ch_copy;           /* Parse-trees are private copies, see cligen_copy */
 };
 
 #endif /* _CLIGEN_HANDLE_INTERNAL_H_ */
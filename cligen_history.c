@@ -54,7 +54,13 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
 #include <sys/select.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/mman.h>
 #include <netinet/in.h>
 #include <string.h>
 #include <ctype.h>
@@ -70,35 +76,223 @@
 #include "cligen_io.h"
 #include "cligen_handle.h"
 #include "cligen_getline.h"
+#include "cligen_stats.h"
 #include "cligen_handle_internal.h"
 
 #include "cligen_history_internal.h" 
 #include "cligen_history.h"
 
-/*! Makes a copy of the string 
- * @param[in] p     String input
- * @retval    str   Malloced copied string output
- * @retval    NULL  Error
+/*
+ * Constants
  */
-static char *
-hist_save(char *p)
+#define HIST_SIG_UNIGRAMS 16 /* Signature bits of single characters, rest for bigrams */
+
+/*! Signature of uni- and bigrams of a string, one bit each
+ * A line can only contain a search string if all bits of the search string are
+ * set in the signature of the line, so most lines are skipped without strstr.
+ * @param[in] s     String
+ * @param[in] len   Length of string
+ * @retval    sig   Signature
+ */
+static uint64_t
+hist_sig(char  *s,
+	 size_t len)
 {
-    char *s = NULL;
-    int   len = strlen(p)+1;
-    char *nl = strchr(p, '\n'); /* newline */
+    unsigned char *u = (unsigned char *)s;
+    uint64_t       sig = 0;
+    size_t         i;
+
+    for (i=0; i<len; i++){
+	sig |= 1ULL << (u[i] % HIST_SIG_UNIGRAMS);
+	if (i > 0)
+	    sig |= 1ULL << (HIST_SIG_UNIGRAMS +
+			    (u[i-1]*31 + u[i]) % (64 - HIST_SIG_UNIGRAMS));
+    }
+    return sig;
+}
 
-    if (nl) {
-        if ((s = malloc(len)) == NULL)
-	    goto done;
-	strcpy(s, p);
-	s[len-1] = 0;
+/*! Hash of a history line (FNV-1a), used for finding duplicates
+ * @param[in] s     String
+ * @param[in] len   Length of string
+ */
+static uint32_t
+hist_hash(char  *s,
+	  size_t len)
+{
+    uint32_t hash = 2166136261U;
+    size_t   i;
+
+    for (i=0; i<len; i++)
+	hash = (hash ^ (unsigned char)s[i]) * 16777619U;
+    return hash;
+}
+
+/*! Find an entry equal to a line in the history
+ * @param[in] ch    CLIgen handle
+ * @param[in] s     Line
+ * @param[in] len   Length of line
+ * @param[in] hash  Hash of line
+ * @retval    i     Position of entry
+ * @retval   -1     Not found
+ */
+static int
+hist_find(struct cligen_handle *ch,
+	  char                 *s,
+	  size_t                len,
+	  uint32_t              hash)
+{
+    int   i;
+    char *p;
+
+    for (i=0; i < ch->ch_hist_size; i++)
+	if (ch->ch_hist_hash[i] == hash &&
+	    (p = ch->ch_hist_buf[i]) != NULL && *p &&
+	    strncmp(p, s, len) == 0 && p[len] == '\0')
+	    return i;
+    return -1;
+}
+
+/*! Remove an entry from the history by moving all later entries one step
+ * @param[in] ch    CLIgen handle
+ * @param[in] i     Position of entry, not last
+ */
+static void
+hist_remove(struct cligen_handle *ch,
+	    int                   i)
+{
+    int size = ch->ch_hist_size;
+    int last = ch->ch_hist_last;
+    int n;
+
+    if ((last - i + size) % size <= ch->ch_hist_new)
+	ch->ch_hist_new--;
+    free(ch->ch_hist_buf[i]);
+    for (; (n = (i + 1) % size) != last; i = n){
+	ch->ch_hist_buf[i] = ch->ch_hist_buf[n];
+	ch->ch_hist_sig[i] = ch->ch_hist_sig[n];
+	ch->ch_hist_hash[i] = ch->ch_hist_hash[n];
     }
-    else {
-	if ((s = strdup(p)) == NULL)
+    ch->ch_hist_buf[i] = ""; /* NB not-malloced, check in hist_free */
+    ch->ch_hist_buf[last] = NULL;
+    ch->ch_hist_last = i;
+}
+
+/*! Remove all older duplicates in the history in one pass
+ * The entries are traversed from the newest and moved towards it over removed
+ * entries. The kept entries are found in a temporary hash table.
+ * @param[in] ch    CLIgen handle
+ * @retval    0     OK
+ * @retval   -1     Error
+ */
+static int
+hist_dedup(struct cligen_handle *ch)
+{
+    int   retval = -1;
+    int   size = ch->ch_hist_size;
+    int   last = ch->ch_hist_last;
+    int  *tab = NULL;
+    int   tsize = 16;
+    int   kept = 0;
+    int   i;
+    int   j;
+    int   k;
+    int   dst;
+    char *s;
+
+    while (tsize < 2*size)
+	tsize <<= 1;
+    if ((tab = malloc(tsize*sizeof(int))) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	goto done;
+    }
+    memset(tab, 0xff, tsize*sizeof(int)); /* -1: empty */
+    dst = last;
+    for (i = (last - 1 + size) % size;
+	 i != last && (s = ch->ch_hist_buf[i]) != NULL;
+	 i = (i - 1 + size) % size){
+	k = ch->ch_hist_hash[i] & (tsize - 1);
+	while ((j = tab[k]) >= 0 &&
+	       (ch->ch_hist_hash[j] != ch->ch_hist_hash[i] ||
+		strcmp(ch->ch_hist_buf[j], s) != 0))
+	    k = (k + 1) & (tsize - 1);
+	if (j >= 0){ /* Newer duplicate kept */
+	    free(s);
+	    continue;
+	}
+	dst = (dst - 1 + size) % size;
+	ch->ch_hist_buf[dst] = s;
+	ch->ch_hist_sig[dst] = ch->ch_hist_sig[i];
+	ch->ch_hist_hash[dst] = ch->ch_hist_hash[i];
+	tab[k] = dst;
+	kept++;
+    }
+    for (i = (i + 1) % size; i != dst; i = (i + 1) % size)
+	ch->ch_hist_buf[i] = NULL;
+    if (ch->ch_hist_new > kept)
+	ch->ch_hist_new = kept;
+    retval = 0;
+ done:
+    if (tab)
+	free(tab);
+    return retval;
+}
+
+/*! Add a line of given length to the CLIgen history 
+ * @param[in] h   CLIgen handle
+ * @param[in] buf Line, not necessarily null-terminated
+ * @param[in] len Length of line
+ * @retval    0   OK
+ * @retval   -1   Error
+ */
+static int
+hist_add_len(cligen_handle h,
+	     char         *buf,
+	     size_t        len)
+{
+    struct cligen_handle *ch = handle(h);
+    int                   retval = -1;
+    size_t                i;
+    uint32_t              hash;
+    char                 *s;
+    int                   last;
+    int                   dup;
+
+    if (len >= cligen_buf_size(h))
+	if (cligen_buf_increase(h, len) < 0)
 	    goto done;
+    for (i=0; i<len; i++)
+	if (buf[i] != ' ' && buf[i] != '\t' && buf[i] != '\n')
+	    break;
+    if (i == len) /* empty */
+	goto ok;
+    if (ch->ch_hist_pre && strncmp(ch->ch_hist_pre, buf, len) == 0 &&
+	ch->ch_hist_pre[len] == '\0')
+	goto ok;
+    hash = hist_hash(buf, len);
+    if (ch->ch_hist_dedup && (dup = hist_find(ch, buf, len, hash)) != -1)
+	hist_remove(ch, dup);
+    if ((s = malloc(len+1)) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	goto done;
     }
+    memcpy(s, buf, len);
+    s[len] = '\0';
+    last = ch->ch_hist_last;
+    ch->ch_hist_buf[last] = s;
+    ch->ch_hist_sig[last] = hist_sig(s, len);
+    ch->ch_hist_hash[last] = hash;
+    ch->ch_hist_pre = s;
+    ch->ch_hist_last = last = (last + 1) % ch->ch_hist_size;
+    if (ch->ch_hist_buf[last] && *ch->ch_hist_buf[last])
+	free(ch->ch_hist_buf[last]);
+    ch->ch_hist_buf[last] = ""; /* NB not-malloced, check in hist_free */
+    if (ch->ch_hist_new < ch->ch_hist_size - 1)
+	ch->ch_hist_new++;
+ ok:
+    ch->ch_hist_cur = ch->ch_hist_last;
+    retval = 0;
  done:
-    return s;
+    return retval;
 }
 
 /*! Add a line to the CLIgen history 
@@ -110,37 +304,62 @@ hist_save(char *p)
 int
 hist_add(cligen_handle h,
 	 char         *buf)
+{
+    size_t len = strlen(buf);
+    char  *nl;
+
+    if ((nl = strchr(buf, '\n')) != NULL && nl[1] == '\0') /* strip newline */
+	len--;
+    return hist_add_len(h, buf, len);
+}
+
+/*! Search the history for a line containing a string, from current position
+ * Lines whose n-gram signature lacks bits of the string are skipped without
+ * comparing. Sets the current position to the matching line.
+ * @param[in] h       CLIgen handle
+ * @param[in] str     Search string
+ * @param[in] forward 0: search older lines, 1: search newer lines
+ * @retval    line    Matching history line
+ * @retval    ""      Not found, position as after hist_prev/hist_next
+ */
+char *
+hist_search(cligen_handle h,
+	    char         *str,
+	    int           forward)
 {
     struct cligen_handle *ch = handle(h);
-    int   retval = -1;
-    char *p = buf;
-    int   len;
+    int                   size = ch->ch_hist_size;
+    int                   cur = ch->ch_hist_cur;
+    uint64_t              sig = hist_sig(str, strlen(str));
+    int                   next;
+    char                 *p = NULL;
 
-    if (strlen(buf) >= cligen_buf_size(h))
-	if (cligen_buf_increase(h, strlen(buf)) < 0)
-	    goto done;
-    while (*p == ' ' || *p == '\t' || *p == '\n') 
-	p++;
-    if (*p) {
-	len = strlen(buf);
-	if (strchr(p, '\n')) 	/* previously line already has NL stripped */
-	    len--;
-	if (ch->ch_hist_pre == 0 || strlen(ch->ch_hist_pre) != len || 
-			    strncmp(ch->ch_hist_pre, buf, len) != 0) {
-            if ((ch->ch_hist_buf[ch->ch_hist_last] = hist_save(buf)) == NULL)
-		goto done;
-	    ch->ch_hist_pre = ch->ch_hist_buf[ch->ch_hist_last];
-            ch->ch_hist_last = (ch->ch_hist_last + 1) % ch->ch_hist_size;
-            if (ch->ch_hist_buf[ch->ch_hist_last] && *ch->ch_hist_buf[ch->ch_hist_last]) {
-	        free(ch->ch_hist_buf[ch->ch_hist_last]);
-            }
-	    ch->ch_hist_buf[ch->ch_hist_last] = ""; /* NB not-malloced, check in hist_free */
+    while (1){
+	if (forward){
+	    if (cur == ch->ch_hist_last)
+		break;
+	    cur = (cur + 1) % size;
+	    if (cur == ch->ch_hist_last)
+		goto notfound;
+	}
+	else {
+	    next = (cur - 1 + size) % size;
+	    if (ch->ch_hist_buf[cur] == NULL || next == ch->ch_hist_last)
+		break;
+	    cur = next;
+	    if (ch->ch_hist_buf[cur] == NULL)
+		break;
+	}
+	p = ch->ch_hist_buf[cur];
+	if ((ch->ch_hist_sig[cur] & sig) == sig && strstr(p, str) != NULL){
+	    ch->ch_hist_cur = cur;
+	    return p;
 	}
     }
-    ch->ch_hist_cur = ch->ch_hist_last;
-    retval = 0;
- done:
-    return retval;
+    gl_putc('\007');
+ notfound:
+    ch->ch_hist_cur = cur;
+    return "";
 }
 
 
@@ -160,6 +379,14 @@ hist_exit(cligen_handle h)
 	}
     free(ch->ch_hist_buf);
     ch->ch_hist_buf = NULL;
+    if (ch->ch_hist_sig){
+	free(ch->ch_hist_sig);
+	ch->ch_hist_sig = NULL;
+    }
+    if (ch->ch_hist_hash){
+	free(ch->ch_hist_hash);
+	ch->ch_hist_hash = NULL;
+    }
     // done:
     return 0;
 }
@@ -323,9 +550,18 @@ cligen_hist_init(cligen_handle h,
 	}
     if ((ch->ch_hist_buf = (char**)realloc(ch->ch_hist_buf, ch->ch_hist_size*sizeof(char*))) == NULL)
 	goto done;
+    if ((ch->ch_hist_sig = realloc(ch->ch_hist_sig, ch->ch_hist_size*sizeof(uint64_t))) == NULL ||
+	(ch->ch_hist_hash = realloc(ch->ch_hist_hash, ch->ch_hist_size*sizeof(uint32_t))) == NULL){
+	fprintf(stderr, "%s: realloc: %s\n", __FUNCTION__, strerror(errno));
+	goto done;
+    }
+    memset(ch->ch_hist_sig, 0, ch->ch_hist_size*sizeof(uint64_t));
+    memset(ch->ch_hist_hash, 0, ch->ch_hist_size*sizeof(uint32_t));
     ch->ch_hist_cur = 0;
     ch->ch_hist_last = 0;
     ch->ch_hist_pre = 0;
+    ch->ch_hist_new = 0;
+    ch->ch_hist_flines = 0;
     ch->ch_hist_buf[0] = ""; /* NB not-malloced, check in hist_free */
     for (i=1; i < ch->ch_hist_size; i++) /* reset all entries */
 	ch->ch_hist_buf[i] = (char *)0;
@@ -334,7 +570,67 @@ cligen_hist_init(cligen_handle h,
     return retval;
 }
 
+/*! Start of the last complete lines of a history file buffer
+ * @param[in]  s      Start of buffer
+ * @param[in]  end    End of buffer, after last newline
+ * @param[in]  n      Number of lines
+ * @param[out] total  Number of lines in buffer
+ * @retval     start  Start of the last n lines, or s if fewer
+ */
+static char *
+hist_file_tail(char  *s,
+	       char  *end,
+	       int    n,
+	       int   *total)
+{
+    char *p;
+    char *start = s;
+    int   i = 0;
+
+    for (p = end; p > s; p--)
+	if (p[-1] == '\n' && ++i == n+1 && start == s)
+	    start = p;
+    *total = i;
+    return start;
+}
+
+/*! Add lines of a history file buffer to history
+ * Only the last lines that fit in the history are added, an incomplete last
+ * line is ignored, it may be written by another session.
+ * @param[in] h     CLIgen handle
+ * @param[in] s     Start of buffer
+ * @param[in] len   Length of buffer
+ * @retval    0     OK
+ * @retval   -1     Error
+ */
+static int
+hist_load_buf(cligen_handle h,
+	      char         *s,
+	      size_t        len)
+{
+    struct cligen_handle *ch = handle(h);
+    int                   retval = -1;
+    char                 *end = s + len;
+    char                 *nl;
+    int                   total;
+
+    while (end > s && end[-1] != '\n')
+	end--;
+    s = hist_file_tail(s, end, ch->ch_hist_size-1, &total);
+    for (; s < end; s = nl + 1){
+	nl = memchr(s, '\n', end - s);
+	if (hist_add_len(h, s, nl - s) < 0)
+	    goto done;
+    }
+    ch->ch_hist_flines += total;
+    retval = 0;
+ done:
+    return retval;
+}
+
 /*! Read history entries from file
+ * A regular file is mapped in memory and only the lines that fit in the history
+ * are copied. Otherwise, eg a pipe, the file is read line by line.
  * @param[in] h  CLIgen handle
  * @param[in] f  Open file for read
  * @see cligen_hist_init must be called before
@@ -346,28 +642,46 @@ cligen_hist_file_load(cligen_handle h,
 		      FILE         *f)
 	    
 {
-    int           retval = -1;
-    int           ret;
-    unsigned char ch;
-    cbuf         *cb = NULL;
-
-    if ((cb = cbuf_new()) == NULL)
+    struct cligen_handle *ch = handle(h);
+    int                   retval = -1;
+    int                   ret;
+    int                   dedup;
+    cbuf                 *cb = NULL;
+    struct stat           st;
+    off_t                 off;
+    char                 *map = NULL;
+
+    if (f == NULL){
+	errno = EINVAL;
 	goto done;
-    while (1){
-	ret = fgetc(f);
-	if (ret == EOF)
-	    break; /* eof or error */
-	ch = (unsigned char)ret;
-	if (ch == '\n'){
-	    if (hist_add(h, cbuf_get(cb)) < 0)
-		goto done;
-	    cbuf_reset(cb);
+    }
+    /* Duplicates are removed in one pass afterwards */
+    dedup = ch->ch_hist_dedup;
+    ch->ch_hist_dedup = 0;
+    if (fstat(fileno(f), &st) == 0 && S_ISREG(st.st_mode) &&
+	(off = ftello(f)) >= 0 && st.st_size > off &&
+	(map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(f), 0)) != MAP_FAILED){
+	ret = hist_load_buf(h, map + off, st.st_size - off);
+	munmap(map, st.st_size);
+	if (ret < 0 || fseeko(f, 0, SEEK_END) < 0)
+	    goto restore;
+    }
+    else {
+	if ((cb = cbuf_new()) == NULL)
+	    goto restore;
+	while ((ret = fgetc(f)) != EOF){ /* eof or error */
+	    if (cbuf_append(cb, ret) < 0)
+		goto restore;
 	}
-	else
-	    if (cbuf_append(cb, ch) < 0)
-		goto done;
+	if (hist_load_buf(h, cbuf_get(cb), cbuf_len(cb)) < 0)
+	    goto restore;
     }
+    ch->ch_hist_new = 0;
+    if (dedup && hist_dedup(ch) < 0)
+	goto restore;
     retval = 0;
+ restore:
+    ch->ch_hist_dedup = dedup;
  done:
     if (cb)
 	cbuf_free(cb);
@@ -378,6 +692,7 @@ cligen_hist_file_load(cligen_handle h,
  * @param[in] h         CLIgen handle
  * @param[in] filename  Name of history file (or NULL if no history file)
  * @see cligen_exit  Call before this function before cligen_exit
+ * @see cligen_hist_file_sync to only append new entries
  */
 int
 cligen_hist_file_save(cligen_handle h,
@@ -388,6 +703,7 @@ cligen_hist_file_save(cligen_handle h,
     int                   i;
     char                 *line;
     int                   i1;
+    int                   n = 0;
 
     /* rewind to last */
     i = (ch->ch_hist_last+1)%ch->ch_hist_size;
@@ -398,9 +714,266 @@ cligen_hist_file_save(cligen_handle h,
 	if ((line = ch->ch_hist_buf[i]) == NULL) /* shouldnt happen */
 	    break;
 	fprintf(f, "%s\n", line);
+	n++;
 	i = (i+1)%ch->ch_hist_size;
     }
+    ch->ch_hist_new = 0;
+    ch->ch_hist_flines = n;
     retval = 0;
     return retval;
 }
 
+/*! Add history entries added since load or save to a buffer, one per line
+ * @param[in] ch  CLIgen handle
+ * @param[in] cb  Buffer
+ * @retval    0   OK
+ * @retval   -1   Error
+ */
+static int
+hist_new_cbuf(struct cligen_handle *ch,
+	      cbuf                 *cb)
+{
+    int i;
+
+    i = (ch->ch_hist_last - ch->ch_hist_new + ch->ch_hist_size) % ch->ch_hist_size;
+    for (; i != ch->ch_hist_last; i = (i+1) % ch->ch_hist_size)
+	if (cprintf(cb, "%s\n", ch->ch_hist_buf[i]) < 0)
+	    return -1;
+    return 0;
+}
+
+/*! Write a buffer to a file descriptor, also if written in parts
+ * @param[in] fd   File descriptor
+ * @param[in] buf  Buffer
+ * @param[in] len  Length of buffer
+ * @retval    0    OK
+ * @retval   -1    Error
+ */
+static int
+hist_write(int         fd,
+	   const char *buf,
+	   size_t      len)
+{
+    ssize_t n;
+
+    while (len > 0){
+	if ((n = write(fd, buf, len)) < 0){
+	    if (errno == EINTR)
+		continue;
+	    return -1;
+	}
+	buf += n;
+	len -= n;
+    }
+    return 0;
+}
+
+/*! Append history entries added since load or save to file
+ * Several sessions may append to the same file, each only writes its own lines.
+ * The lines are written with one call, use cligen_hist_file_sync for locking.
+ * @param[in] h   CLIgen handle
+ * @param[in] f   File open for append
+ * @retval    0   OK
+ * @retval   -1   Error
+ */
+int
+cligen_hist_file_append(cligen_handle h,
+			FILE         *f)
+{
+    struct cligen_handle *ch = handle(h);
+    int                   retval = -1;
+    cbuf                 *cb = NULL;
+
+    if (f == NULL){
+	errno = EINVAL;
+	goto done;
+    }
+    if ((cb = cbuf_new()) == NULL)
+	goto done;
+    if (hist_new_cbuf(ch, cb) < 0)
+	goto done;
+    if (fwrite(cbuf_get(cb), 1, cbuf_len(cb), f) != cbuf_len(cb))
+	goto done;
+    ch->ch_hist_flines += ch->ch_hist_new;
+    ch->ch_hist_new = 0;
+    retval = 0;
+ done:
+    if (cb)
+	cbuf_free(cb);
+    return retval;
+}
+
+/*! Open a history file for append and lock it for writing
+ * A session compacting the file replaces it while others may wait for the lock on
+ * the old file, so the lock is taken again if the file was replaced.
+ * @param[in] filename  Name of history file, created if it does not exist
+ * @retval    fd        Open and locked file descriptor, unlocked on close
+ * @retval   -1         Error
+ */
+static int
+hist_file_lock(char *filename)
+{
+    int         fd;
+    struct stat st;
+    struct stat st1;
+
+    while (1){
+	if ((fd = open(filename, O_RDWR|O_APPEND|O_CREAT, 0666)) < 0)
+	    return -1;
+	if (flock(fd, LOCK_EX) < 0 ||
+	    fstat(fd, &st) < 0)
+	    break;
+	if (stat(filename, &st1) == 0 &&
+	    st.st_dev == st1.st_dev && st.st_ino == st1.st_ino)
+	    return fd;
+	close(fd); /* Replaced, try again */
+    }
+    close(fd);
+    return -1;
+}
+
+/*! Rewrite a history file with only its last lines
+ * The lines are written to a temporary file which is renamed, so that the file
+ * is complete also if another session reads it at the same time.
+ * @param[in] h         CLIgen handle
+ * @param[in] fd        History file, open for read and locked, see hist_file_lock
+ * @param[in] filename  Name of history file
+ * @retval    0         OK
+ * @retval   -1         Error
+ */
+static int
+hist_file_compact(cligen_handle h,
+		  int           fd,
+		  char         *filename)
+{
+    struct cligen_handle *ch = handle(h);
+    int                   retval = -1;
+    int                   tfd = -1;
+    cbuf                 *cb = NULL;
+    struct stat           st;
+    char                 *map = MAP_FAILED;
+    char                 *end;
+    char                 *start;
+    int                   total;
+
+    if (fstat(fd, &st) < 0)
+	goto done;
+    if (st.st_size == 0)
+	goto ok;
+    if ((map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+	goto done;
+    end = map + st.st_size;
+    while (end > map && end[-1] != '\n')
+	end--;
+    start = hist_file_tail(map, end, ch->ch_hist_size-1, &total);
+    if ((cb = cbuf_new()) == NULL)
+	goto done;
+    cprintf(cb, "%s.XXXXXX", filename);
+    if ((tfd = mkstemp(cbuf_get(cb))) < 0){
+	fprintf(stderr, "%s: mkstemp(%s): %s\n", __FUNCTION__, cbuf_get(cb), strerror(errno));
+	goto done;
+    }
+    if (fchmod(tfd, st.st_mode & 0777) < 0 ||
+	hist_write(tfd, start, end - start) < 0 ||
+	rename(cbuf_get(cb), filename) < 0){
+	fprintf(stderr, "%s: %s: %s\n", __FUNCTION__, cbuf_get(cb), strerror(errno));
+	unlink(cbuf_get(cb));
+	goto done;
+    }
+    ch->ch_hist_flines = total < ch->ch_hist_size-1 ? total : ch->ch_hist_size-1;
+ ok:
+    retval = 0;
+ done:
+    if (tfd != -1)
+	close(tfd);
+    if (map != MAP_FAILED)
+	munmap(map, st.st_size);
+    if (cb)
+	cbuf_free(cb);
+    return retval;
+}
+
+/*! Append new history entries to a history file, and compact it if large
+ * Use this instead of cligen_hist_file_save at the end of a session so that the
+ * file is not rewritten each time and history of other sessions is kept. When
+ * the file has more than CLIGEN_HIST_COMPACT times the history size lines it is
+ * rewritten with its last lines.
+ * Sessions appending to and compacting the same file are serialized with flock(2),
+ * and the new lines are appended with one write.
+ * @param[in] h         CLIgen handle
+ * @param[in] filename  Name of history file, created if it does not exist
+ * @retval    0         OK
+ * @retval   -1         Error
+ * @see cligen_hist_file_load
+ */
+int
+cligen_hist_file_sync(cligen_handle h,
+		      char         *filename)
+{
+    struct cligen_handle *ch = handle(h);
+    int                   retval = -1;
+    int                   fd = -1;
+    cbuf                 *cb = NULL;
+    int                   compact;
+
+    if (filename == NULL){
+	errno = EINVAL;
+	goto done;
+    }
+    compact = ch->ch_hist_flines + ch->ch_hist_new > CLIGEN_HIST_COMPACT*(ch->ch_hist_size-1);
+    if (ch->ch_hist_new == 0 && !compact)
+	goto ok;
+    if ((fd = hist_file_lock(filename)) < 0)
+	goto done;
+    if (ch->ch_hist_new){
+	if ((cb = cbuf_new()) == NULL)
+	    goto done;
+	if (hist_new_cbuf(ch, cb) < 0)
+	    goto done;
+	if (hist_write(fd, cbuf_get(cb), cbuf_len(cb)) < 0)
+	    goto done;
+	ch->ch_hist_flines += ch->ch_hist_new;
+	ch->ch_hist_new = 0;
+    }
+    if (compact &&
+	hist_file_compact(h, fd, filename) < 0)
+	goto done;
+ ok:
+    retval = 0;
+ done:
+    if (fd != -1)
+	close(fd);
+    if (cb)
+	cbuf_free(cb);
+    return retval;
+}
+
+/*! Remove older duplicates when adding lines to history
+ * Setting it also removes duplicates already in history.
+ * @param[in] h      CLIgen handle
+ * @param[in] dedup  0: keep duplicates (default), 1: remove older duplicates
+ * @retval    0      OK
+ * @retval   -1      Error
+ */
+int
+cligen_hist_dedup_set(cligen_handle h,
+		      int           dedup)
+{
+    struct cligen_handle *ch = handle(h);
+
+    ch->ch_hist_dedup = dedup;
+    if (dedup && ch->ch_hist_buf && hist_dedup(ch) < 0)
+	return -1;
+    return 0;
+}
+
+/*! Get if older duplicates are removed when adding lines to history
+ * @param[in] h      CLIgen handle
+ */
+int
+cligen_hist_dedup_get(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_hist_dedup;
+}
@@ -52,11 +52,22 @@
 #ifndef CLIGEN_HISTORY_H
 #define CLIGEN_HISTORY_H
 
+/*
+ * Constants
+ */
+/* History file is compacted when it has this many times the history size lines,
+ * see cligen_hist_file_sync */
+#define CLIGEN_HIST_COMPACT 2
+
 /*
  * Prototypes
  */
 int cligen_hist_init(cligen_handle h, int lines);
 int cligen_hist_file_load(cligen_handle h, FILE *f);
 int cligen_hist_file_save(cligen_handle h, FILE *f);
+int cligen_hist_file_append(cligen_handle h, FILE *f);
+int cligen_hist_file_sync(cligen_handle h, char *filename);
+int cligen_hist_dedup_set(cligen_handle h, int dedup);
+int cligen_hist_dedup_get(cligen_handle h);
 
 #endif /* CLIGEN_HISTORY_H */
@@ -65,5 +65,6 @@ int   hist_last_get(cligen_handle h);
 int   hist_copy_pos(cligen_handle h);
 int   hist_copy_prev(cligen_handle h);
 int   hist_copy_next(cligen_handle h);
+char *hist_search(cligen_handle h, char *str, int forward);
 
 #endif /* CLIGEN_HISTORY_INTERNAL_H */
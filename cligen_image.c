@@ -0,0 +1,755 @@
+/*
+  CLI generator precompiled parse-tree images
+
+  ***** BEGIN LICENSE BLOCK *****
+ 
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the 
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+
+
+  This file includes a binary image format of parsed CLIgen specs.
+  An image is written after a spec has been parsed and is loaded instead of the
+  text spec on later startups, as long as the spec file is unchanged.
+  The image is position-independent: strings and vectors are stored inline and
+  length-prefixed, and all pointers are rebuilt when loading. Function pointers
+  are not stored, callbacks are stored by name and mapped with str2fn as usual.
+
+  Image layout (all integers in host byte order, see ih_endian):
+    header  struct image_header
+    heads   u32 nr, then per tree: str name, u8 active, tree
+    globals cvec
+  where
+    str     u32 len (0 is NULL, otherwise strlen+1) followed by len bytes incl NUL
+    cvec    u32 len (0 is NULL, otherwise cvec_len+1), str name, then len cv:s
+    cv      u32 type, str name, str show, u8 const, u8 flag, value
+    tree    u32 exists, if set: u8 set, str name, u32 len, then len (u32 exists, obj)
+    obj     fields, varspec if variable, then child tree
+*/
+
+#include "cligen_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <netinet/in.h>
+
+#include "cligen_buf.h"
+#include "cligen_cv.h"
+#include "cligen_cv_internal.h"
+#include "cligen_cvec.h"
+#include "cligen_parsetree.h"
+#include "cligen_pt_head.h"
+#include "cligen_object.h"
+#include "cligen_handle.h"
+#include "cligen_syntax.h"
+#include "cligen_image.h"
+#include "cligen_intern.h"
+#include "cligen_expand.h"
+
+/* Written in ih_endian, used to detect images from other architectures */
+#define IMAGE_ENDIAN 0x01020304
+
+/* Fixed image header */
+struct image_header{
+    char     ih_magic[4];   /* CLIGEN_IMAGE_MAGIC */
+    uint32_t ih_version;    /* CLIGEN_IMAGE_VERSION */
+    uint32_t ih_endian;     /* IMAGE_ENDIAN */
+    uint32_t ih_cvsize;     /* Size of cv value union, types are serialized raw */
+    uint64_t ih_srcsize;    /* Size of spec file the image was made from */
+    int64_t  ih_srcmtime;   /* Modification time of spec file, seconds */
+    int64_t  ih_srcmtime_ns;/* Modification time of spec file, nanoseconds */
+    uint64_t ih_len;        /* Total length of image including header */
+};
+
+/* Read cursor over a mapped image */
+struct image_cursor{
+    char   *ic_buf;
+    size_t  ic_len;
+    size_t  ic_off;
+};
+
+/*
+ * Writing
+ */
+static int
+image_put_u32(cbuf    *cb,
+	      uint32_t u)
+{
+    return cbuf_append_buf(cb, &u, sizeof(u));
+}
+
+static int
+image_put_u8(cbuf   *cb,
+	     uint8_t u)
+{
+    return cbuf_append_buf(cb, &u, sizeof(u));
+}
+
+static int
+image_put_str(cbuf *cb,
+	      char *str)
+{
+    uint32_t len;
+
+    len = str ? strlen(str)+1 : 0;
+    if (image_put_u32(cb, len) < 0)
+	return -1;
+    if (len && cbuf_append_buf(cb, str, len) < 0)
+	return -1;
+    return 0;
+}
+
+static int
+image_put_cv(cbuf   *cb,
+	     cg_var *cv)
+{
+    enum cv_type type = cv->var_type;
+
+    if (image_put_u32(cb, type) < 0 ||
+	image_put_str(cb, cv->var_name) < 0 ||
+	image_put_str(cb, cv->var_show) < 0 ||
+	image_put_u8(cb, cv->var_const) < 0 ||
+	image_put_u8(cb, cv->var_flag) < 0)
+	return -1;
+    if (cv_inline(type))
+	return cbuf_append_buf(cb, &cv->u, sizeof(cv->u));
+    if (cv_isstring(type))
+	return image_put_str(cb, cv->var_string);
+    if (type == CGV_URL)
+	return (image_put_str(cb, cv->var_urlproto) < 0 ||
+		image_put_str(cb, cv->var_urladdr) < 0 ||
+		image_put_str(cb, cv->var_urlpath) < 0 ||
+		image_put_str(cb, cv->var_urluser) < 0 ||
+		image_put_str(cb, cv->var_urlpasswd) < 0) ? -1 : 0;
+    return 0; /* CGV_VOID: external pointer is not stored */
+}
+
+static int
+image_put_cvec(cbuf *cb,
+	       cvec *cvv)
+{
+    cg_var *cv = NULL;
+
+    if (cvv == NULL)
+	return image_put_u32(cb, 0);
+    if (image_put_u32(cb, cvec_len(cvv)+1) < 0 ||
+	image_put_str(cb, cvec_name_get(cvv)) < 0)
+	return -1;
+    while ((cv = cvec_each(cvv, cv)) != NULL)
+	if (image_put_cv(cb, cv) < 0)
+	    return -1;
+    return 0;
+}
+
+static int image_put_pt(cbuf *cb, parse_tree *pt);
+
+static int
+image_put_co(cbuf   *cb,
+	     cg_obj *co)
+{
+    struct cg_callback *cc;
+    uint32_t            n = 0;
+
+    if (image_put_u32(cb, co->co_type) < 0 ||
+	image_put_u32(cb, co->co_flags & ~(CO_FLAGS_INTERN|CO_FLAGS_LABELS|CO_FLAGS_META|CO_FLAGS_REST)) < 0 ||
+	image_put_str(cb, co->co_command) < 0 ||
+	image_put_str(cb, co->co_prefix) < 0 ||
+	image_put_str(cb, co->co_value) < 0)
+	return -1;
+    for (cc = co->co_callbacks; cc; cc = cc->cc_next)
+	n++;
+    if (image_put_u32(cb, n) < 0)
+	return -1;
+    for (cc = co->co_callbacks; cc; cc = cc->cc_next)
+	if (image_put_str(cb, cc->cc_fn_str) < 0 ||
+	    image_put_cvec(cb, cc->cc_cvec) < 0)
+	    return -1;
+    if (image_put_cvec(cb, co->co_cvec) < 0 ||
+	image_put_cvec(cb, co->co_helpvec) < 0)
+	return -1;
+    if (co->co_type == CO_VARIABLE)
+	if (image_put_u32(cb, co->co_vtype) < 0 ||
+	    image_put_str(cb, co->co_show) < 0 ||
+	    image_put_str(cb, co->co_expand_fn_str) < 0 ||
+	    image_put_cvec(cb, co->co_expand_fn_vec) < 0 ||
+	    image_put_str(cb, co->co_translate_fn_str) < 0 ||
+	    image_put_str(cb, co->co_choice) < 0 ||
+	    image_put_u32(cb, co->co_rangelen) < 0 ||
+	    image_put_cvec(cb, co->co_rangecvv_low) < 0 ||
+	    image_put_cvec(cb, co->co_rangecvv_upp) < 0 ||
+	    image_put_cvec(cb, co->co_regex) < 0 ||
+	    image_put_u8(cb, co->co_dec64_n) < 0)
+	    return -1;
+    return image_put_pt(cb, co_pt_get(co));
+}
+
+static int
+image_put_pt(cbuf       *cb,
+	     parse_tree *pt)
+{
+    cg_obj *co;
+    int     i;
+
+    if (pt == NULL)
+	return image_put_u32(cb, 0);
+    if (image_put_u32(cb, 1) < 0 ||
+	image_put_u8(cb, pt_sets_get(pt)) < 0 ||
+	image_put_str(cb, pt_name_get(pt)) < 0 ||
+	image_put_u32(cb, pt_len_get(pt)) < 0)
+	return -1;
+    for (i=0; i<pt_len_get(pt); i++){
+	co = pt_vec_i_get(pt, i);
+	if (image_put_u32(cb, co != NULL) < 0)
+	    return -1;
+	if (co && image_put_co(cb, co) < 0)
+	    return -1;
+    }
+    return 0;
+}
+
+/*! Write all parse-trees of a handle and global variables to a binary image file
+ *
+ * The image can later be loaded with cligen_image_read instead of parsing the spec.
+ * @param[in]  h        CLIgen handle
+ * @param[in]  filename Image file. Written to a temporary file and renamed
+ * @param[in]  st       Status of the spec file the trees were parsed from, or NULL
+ * @param[in]  cvv      Global variables, or NULL
+ * @retval     0        OK
+ * @retval    -1        Error
+ * @see cligen_image_read
+ */
+int
+cligen_image_write(cligen_handle h,
+		   char         *filename,
+		   struct stat  *st,
+		   cvec         *cvv)
+{
+    int                 retval = -1;
+    cbuf               *cb = NULL;
+    cbuf               *tmp = NULL;
+    struct image_header ih = {{0,},};
+    pt_head            *ph;
+    uint32_t            n = 0;
+    FILE               *f = NULL;
+
+    if (filename == NULL){
+	errno = EINVAL;
+	goto done;
+    }
+    if ((cb = cbuf_new()) == NULL || (tmp = cbuf_new()) == NULL){
+	fprintf(stderr, "%s: cbuf_new: %s\n", __FUNCTION__, strerror(errno));
+	goto done;
+    }
+    memcpy(ih.ih_magic, CLIGEN_IMAGE_MAGIC, sizeof(ih.ih_magic));
+    ih.ih_version = CLIGEN_IMAGE_VERSION;
+    ih.ih_endian  = IMAGE_ENDIAN;
+    ih.ih_cvsize  = sizeof(((cg_var *)NULL)->u);
+    if (st){
+	ih.ih_srcsize  = st->st_size;
+	ih.ih_srcmtime = st->st_mtim.tv_sec;
+	ih.ih_srcmtime_ns = st->st_mtim.tv_nsec;
+    }
+    if (cbuf_append_buf(cb, &ih, sizeof(ih)) < 0)
+	goto done;
+    ph = NULL;
+    while ((ph = cligen_ph_each(h, ph)) != NULL)
+	n++;
+    if (image_put_u32(cb, n) < 0)
+	goto done;
+    ph = NULL;
+    while ((ph = cligen_ph_each(h, ph)) != NULL){
+	if (image_put_str(cb, cligen_ph_name_get(ph)) < 0 ||
+	    image_put_u8(cb, cligen_pt_active_get(h) == cligen_ph_parsetree_get(ph)) < 0 ||
+	    image_put_pt(cb, cligen_ph_parsetree_get(ph)) < 0)
+	    goto done;
+    }
+    if (image_put_cvec(cb, cvv) < 0)
+	goto done;
+    ((struct image_header *)cbuf_get(cb))->ih_len = cbuf_len(cb);
+    cprintf(tmp, "%s.tmp%d", filename, (int)getpid());
+    if ((f = fopen(cbuf_get(tmp), "w")) == NULL){
+	fprintf(stderr, "%s: fopen(%s): %s\n", __FUNCTION__, cbuf_get(tmp), strerror(errno));
+	goto done;
+    }
+    if (fwrite(cbuf_get(cb), 1, cbuf_len(cb), f) != cbuf_len(cb) ||
+	fclose(f) != 0){
+	f = NULL;
+	fprintf(stderr, "%s: fwrite(%s): %s\n", __FUNCTION__, cbuf_get(tmp), strerror(errno));
+	unlink(cbuf_get(tmp));
+	goto done;
+    }
+    f = NULL;
+    if (rename(cbuf_get(tmp), filename) < 0){
+	fprintf(stderr, "%s: rename(%s): %s\n", __FUNCTION__, filename, strerror(errno));
+	unlink(cbuf_get(tmp));
+	goto done;
+    }
+    retval = 0;
+ done:
+    if (f)
+	fclose(f);
+    if (cb)
+	cbuf_free(cb);
+    if (tmp)
+	cbuf_free(tmp);
+    return retval;
+}
+
+/*
+ * Reading. All get functions return 0 on success and -1 if the image is truncated,
+ * malformed or allocation fails. Either way the image is not used.
+ */
+static int
+image_get(struct image_cursor *ic,
+	  void                *dst,
+	  size_t               len)
+{
+    if (ic->ic_len - ic->ic_off < len)
+	return -1;
+    memcpy(dst, ic->ic_buf + ic->ic_off, len);
+    ic->ic_off += len;
+    return 0;
+}
+
+static int
+image_get_u32(struct image_cursor *ic,
+	      uint32_t            *u)
+{
+    return image_get(ic, u, sizeof(*u));
+}
+
+static int
+image_get_u8(struct image_cursor *ic,
+	     uint8_t             *u)
+{
+    return image_get(ic, u, sizeof(*u));
+}
+
+/*! Get string from image, returned string is malloced (or NULL) */
+static int
+image_get_str(struct image_cursor *ic,
+	      char               **strp)
+{
+    uint32_t len;
+    char    *s;
+
+    *strp = NULL;
+    if (image_get_u32(ic, &len) < 0)
+	return -1;
+    if (len == 0)
+	return 0;
+    if (ic->ic_len - ic->ic_off < len)
+	return -1;
+    s = ic->ic_buf + ic->ic_off;
+    if (s[len-1] != '\0')
+	return -1;
+    if ((*strp = strdup(s)) == NULL)
+	return -1;
+    ic->ic_off += len;
+    return 0;
+}
+
+static int
+image_get_cv(struct image_cursor *ic,
+	     cg_var              *cv)
+{
+    uint32_t type;
+    uint8_t  u8;
+
+    if (image_get_u32(ic, &type) < 0 || type > CGV_EMPTY)
+	return -1;
+    cv->var_type = type;
+    if (image_get_str(ic, &cv->var_name) < 0 ||
+	image_get_str(ic, &cv->var_show) < 0)
+	return -1;
+    if (image_get_u8(ic, &u8) < 0)
+	return -1;
+    cv->var_const = u8;
+    if (image_get_u8(ic, &u8) < 0)
+	return -1;
+    cv->var_flag = u8;
+    if (cv_inline(type))
+	return image_get(ic, &cv->u, sizeof(cv->u));
+    if (cv_isstring(type))
+	return image_get_str(ic, &cv->var_string);
+    if (type == CGV_URL)
+	return (image_get_str(ic, &cv->var_urlproto) < 0 ||
+		image_get_str(ic, &cv->var_urladdr) < 0 ||
+		image_get_str(ic, &cv->var_urlpath) < 0 ||
+		image_get_str(ic, &cv->var_urluser) < 0 ||
+		image_get_str(ic, &cv->var_urlpasswd) < 0) ? -1 : 0;
+    return 0;
+}
+
+/*! Get cligen vector from image, vector is returned even on error, free with cvec_free */
+static int
+image_get_cvec(struct image_cursor *ic,
+	       cvec               **cvvp)
+{
+    uint32_t len;
+    uint32_t i;
+    cvec    *cvv;
+    char    *name = NULL;
+    cg_var  *cv;
+
+    *cvvp = NULL;
+    if (image_get_u32(ic, &len) < 0)
+	return -1;
+    if (len-- == 0)
+	return 0;
+    if (image_get_str(ic, &name) < 0)
+	return -1;
+    if ((cvv = cvec_new(0)) == NULL){
+	if (name)
+	    free(name);
+	return -1;
+    }
+    *cvvp = cvv;
+    if (name){
+	cvec_name_set(cvv, name);
+	free(name);
+    }
+    for (i=0; i<len; i++){
+	/* Type is set by image_get_cv, cvec_add gives a zeroed cv */
+	if ((cv = cvec_add(cvv, CGV_EMPTY)) == NULL)
+	    return -1;
+	if (image_get_cv(ic, cv) < 0)
+	    return -1;
+    }
+    return 0;
+}
+
+static int image_get_pt(struct image_cursor *ic, cg_obj *parent, parse_tree **ptp);
+
+/*! Get cligen object from image, object is returned even on error, free with co_free */
+static int
+image_get_co(struct image_cursor *ic,
+	     cg_obj              *parent,
+	     cg_obj             **cop)
+{
+    cg_obj              *co;
+    struct cg_callback **ccp;
+    struct cg_callback  *cc;
+    parse_tree          *pt;
+    uint32_t             u32;
+    uint32_t             n;
+    uint8_t              u8;
+
+    if ((co = co_new_only()) == NULL)
+	return -1;
+    *cop = co;
+    co_up_set(co, parent);
+    if (image_get_u32(ic, &u32) < 0 || u32 > CO_EMPTY)
+	return -1;
+    co->co_type = u32;
+    if (co->co_type == CO_VARIABLE && co_varspec_new(co, NULL) < 0)
+	return -1;
+    if (image_get_u32(ic, &co->co_flags) < 0)
+	return -1;
+    /* Decoded strings are owned by the object, label ids are per handle */
+    co_flags_reset(co, CO_FLAGS_INTERN|CO_FLAGS_LABELS|CO_FLAGS_META|CO_FLAGS_REST);
+    if (image_get_str(ic, &co->co_command) < 0 ||
+	image_get_str(ic, &co->co_prefix) < 0 ||
+	image_get_str(ic, &co->co_value) < 0 ||
+	image_get_u32(ic, &n) < 0)
+	return -1;
+    ccp = &co->co_callbacks;
+    while (n--){
+	if ((cc = malloc(sizeof(*cc))) == NULL)
+	    return -1;
+	memset(cc, 0, sizeof(*cc));
+	*ccp = cc;
+	ccp = &cc->cc_next;
+	if (image_get_str(ic, &cc->cc_fn_str) < 0 ||
+	    image_get_cvec(ic, &cc->cc_cvec) < 0)
+	    return -1;
+    }
+    if (image_get_cvec(ic, &co->co_cvec) < 0 ||
+	image_get_cvec(ic, &co->co_helpvec) < 0)
+	return -1;
+    if (co->co_type == CO_VARIABLE){
+	if (image_get_u32(ic, &u32) < 0 || u32 > CGV_EMPTY)
+	    return -1;
+	co->co_vtype = u32;
+	if (image_get_str(ic, &co->co_show) < 0 ||
+	    image_get_str(ic, &co->co_expand_fn_str) < 0 ||
+	    image_get_cvec(ic, &co->co_expand_fn_vec) < 0 ||
+	    image_get_str(ic, &co->co_translate_fn_str) < 0 ||
+	    image_get_str(ic, &co->co_choice) < 0 ||
+	    image_get_u32(ic, &u32) < 0)
+	    return -1;
+	co->co_rangelen = u32;
+	if (image_get_cvec(ic, &co->co_rangecvv_low) < 0 ||
+	    image_get_cvec(ic, &co->co_rangecvv_upp) < 0 ||
+	    image_get_cvec(ic, &co->co_regex) < 0 ||
+	    image_get_u8(ic, &u8) < 0)
+	    return -1;
+	co->co_dec64_n = u8;
+    }
+    if (image_get_pt(ic, co, &pt) < 0){
+	if (pt)
+	    co_pt_set(co, pt);
+	return -1;
+    }
+    if (pt && co_pt_set(co, pt) < 0){
+	pt_free(pt, 1);
+	return -1;
+    }
+    return 0;
+}
+
+/*! Get parse-tree from image, tree is returned even on error, free with pt_free */
+static int
+image_get_pt(struct image_cursor *ic,
+	     cg_obj              *parent,
+	     parse_tree         **ptp)
+{
+    parse_tree *pt;
+    uint32_t    u32;
+    uint32_t    len;
+    uint8_t     u8;
+    char       *name = NULL;
+    cg_obj     *co;
+    int         ret;
+
+    *ptp = NULL;
+    if (image_get_u32(ic, &u32) < 0)
+	return -1;
+    if (u32 == 0)
+	return 0;
+    if ((pt = pt_new()) == NULL)
+	return -1;
+    *ptp = pt;
+    if (image_get_u8(ic, &u8) < 0)
+	return -1;
+    pt_sets_set(pt, u8);
+    if (image_get_str(ic, &name) < 0)
+	return -1;
+    if (name){
+	ret = pt_name_set(pt, name);
+	free(name);
+	if (ret < 0)
+	    return -1;
+    }
+    if (image_get_u32(ic, &len) < 0)
+	return -1;
+    while (len--){
+	if (image_get_u32(ic, &u32) < 0)
+	    return -1;
+	co = NULL;
+	ret = u32 ? image_get_co(ic, parent, &co) : 0;
+	if (pt_vec_append(pt, co) < 0){
+	    if (co)
+		co_free(co, 1);
+	    return -1;
+	}
+	if (ret < 0)
+	    return -1;
+    }
+    return 0;
+}
+
+/*! Read a binary parse-tree image and add its parse-trees to a handle
+ *
+ * The image is only used if it was written by the same image format version on 
+ * the same architecture, and (if st is given) from a spec file with the same size
+ * and modification time. Otherwise the image is considered stale and nothing is
+ * added, so that the caller can fall back to parsing the spec.
+ * @param[in]     h        CLIgen handle
+ * @param[in]     filename Image file
+ * @param[in]     st       Status of spec file to check freshness against, or NULL
+ * @param[in,out] cvv      Global variables are added to this vector (if given)
+ * @retval        1        OK, parse-trees added
+ * @retval        0        No image, or image is stale or malformed
+ * @retval       -1        Error
+ * @see cligen_image_write
+ */
+int
+cligen_image_read(cligen_handle h,
+		  char         *filename,
+		  struct stat  *st,
+		  cvec         *cvv)
+{
+    int                  retval = -1;
+    int                  fd = -1;
+    struct stat          ist;
+    struct image_header  ih;
+    struct image_cursor  ic = {NULL, 0, 0};
+    uint32_t             n;
+    uint32_t             i;
+    uint8_t              active;
+    char               **names = NULL;
+    parse_tree         **pts = NULL;
+    char                *actname = NULL;
+    cvec                *globals = NULL;
+    cg_var              *cv;
+    pt_head             *ph;
+
+    if (filename == NULL){
+	errno = EINVAL;
+	goto done;
+    }
+    if ((fd = open(filename, O_RDONLY)) < 0 ||
+	fstat(fd, &ist) < 0 ||
+	ist.st_size < (off_t)sizeof(ih))
+	goto stale;
+    ic.ic_len = ist.st_size;
+    if ((ic.ic_buf = mmap(NULL, ic.ic_len, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED){
+	ic.ic_buf = NULL;
+	goto stale;
+    }
+    if (image_get(&ic, &ih, sizeof(ih)) < 0)
+	goto stale;
+    if (memcmp(ih.ih_magic, CLIGEN_IMAGE_MAGIC, sizeof(ih.ih_magic)) != 0 ||
+	ih.ih_version != CLIGEN_IMAGE_VERSION ||
+	ih.ih_endian != IMAGE_ENDIAN ||
+	ih.ih_cvsize != sizeof(((cg_var *)NULL)->u) ||
+	ih.ih_len != ic.ic_len)
+	goto stale;
+    if (st && (ih.ih_srcsize != (uint64_t)st->st_size ||
+	       ih.ih_srcmtime != (int64_t)st->st_mtim.tv_sec ||
+	       ih.ih_srcmtime_ns != (int64_t)st->st_mtim.tv_nsec))
+	goto stale;
+    if (image_get_u32(&ic, &n) < 0 || n > ic.ic_len)
+	goto stale;
+    if ((names = calloc(n+1, sizeof(char *))) == NULL ||
+	(pts = calloc(n+1, sizeof(parse_tree *))) == NULL){
+	fprintf(stderr, "%s: calloc: %s\n", __FUNCTION__, strerror(errno));
+	goto done;
+    }
+    /* Decode everything before adding to handle, so a malformed image adds nothing */
+    for (i=0; i<n; i++){
+	if (image_get_str(&ic, &names[i]) < 0 ||
+	    image_get_u8(&ic, &active) < 0)
+	    goto stale;
+	if (active)
+	    actname = names[i];
+	if (image_get_pt(&ic, NULL, &pts[i]) < 0)
+	    goto stale;
+    }
+    if (image_get_cvec(&ic, &globals) < 0 || ic.ic_off != ic.ic_len)
+	goto stale;
+    cv = NULL;
+    while (cvv && globals && (cv = cvec_each(globals, cv)) != NULL)
+	if (cvec_append_var(cvv, cv) == NULL)
+	    goto done;
+    for (i=0; i<n; i++){
+	if (cligen_parsetree_intern(h, pts[i]) < 0)
+	    goto done;
+	if (cligen_parsetree_labels(h, pts[i]) < 0)
+	    goto done;
+	if (cligen_parsetree_meta(pts[i]) < 0)
+	    goto done;
+	if ((ph = cligen_ph_add(h, names[i])) == NULL)
+	    goto done;
+	if (cligen_ph_parsetree_set(ph, pts[i]) < 0)
+	    goto done;
+	pts[i] = NULL;
+    }
+    if (actname)
+	cligen_ph_active_set(h, actname);
+    retval = 1;
+    goto done;
+ stale:
+    retval = 0;
+ done:
+    if (names){
+	for (i=0; i<n; i++)
+	    if (names[i])
+		free(names[i]);
+	free(names);
+    }
+    if (pts){
+	for (i=0; i<n; i++)
+	    if (pts[i])
+		pt_free(pts[i], 1);
+	free(pts);
+    }
+    if (globals)
+	cvec_free(globals);
+    if (ic.ic_buf)
+	munmap(ic.ic_buf, ic.ic_len);
+    if (fd != -1)
+	close(fd);
+    return retval;
+}
+
+/*! Parse a file containing a CLIgen spec using a precompiled image if possible
+ *
+ * If the image exists and was made from the current version of the spec file, the
+ * parse-trees are loaded from the image. Otherwise the spec is parsed as with
+ * cligen_parse_file, and the image is (re)written for the next time. The image is
+ * a cache: failing to write it is not an error.
+ * @param[in]     h         CLIgen handle
+ * @param[in]     f         Open stdio file handle of the spec
+ * @param[in]     name      Debug string identifying the spec, typically a filename
+ * @param[in]     imagefile Image file
+ * @param[out]    cvv       Global variables
+ * @retval        0         OK
+ * @retval       -1         Error
+ * @see cligen_parse_file
+ * @note Loading the image adds the trees of the image, which is all trees of the 
+ *       handle at the time it was written. Use on a handle without other trees.
+ */
+int
+cligen_parse_file_image(cligen_handle h,
+			FILE         *f,
+			char         *name,
+			char         *imagefile,
+			cvec         *cvv)
+{
+    int         retval = -1;
+    struct stat st;
+    int         ret;
+
+    if (fstat(fileno(f), &st) < 0 || !S_ISREG(st.st_mode)){
+	/* Not a regular file (eg stdin): nothing to check freshness against */
+	if (cligen_parse_file(h, f, name, NULL, cvv) < 0)
+	    goto done;
+	retval = 0;
+	goto done;
+    }
+    if ((ret = cligen_image_read(h, imagefile, &st, cvv)) < 0)
+	goto done;
+    if (ret == 0){
+	if (cligen_parse_file(h, f, name, NULL, cvv) < 0)
+	    goto done;
+	(void)cligen_image_write(h, imagefile, &st, cvv);
+    }
+    retval = 0;
+ done:
+    return retval;
+}
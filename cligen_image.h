@@ -0,0 +1,60 @@
+/*
+  CLI generator precompiled parse-tree images
+
+  ***** BEGIN LICENSE BLOCK *****
+ 
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the 
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+
+  This file includes a binary image format of parsed CLIgen specs
+*/
+
+#ifndef _CLIGEN_IMAGE_H_
+#define _CLIGEN_IMAGE_H_
+
+/*
+ * Constants
+ */
+/* Magic and format version of parse-tree images, bump version on any format change */
+#define CLIGEN_IMAGE_MAGIC   "CLGI"
+#define CLIGEN_IMAGE_VERSION 1
+
+/*
+ * Types
+ */
+struct stat; /* forward declaration. Original in sys/stat.h */
+
+/*
+ * Prototypes
+ */
+int cligen_image_write(cligen_handle h, char *filename, struct stat *st, cvec *cvv);
+int cligen_image_read(cligen_handle h, char *filename, struct stat *st, cvec *cvv);
+int cligen_parse_file_image(cligen_handle h, FILE *f, char *name, char *imagefile, cvec *cvv);
+
+#endif /* _CLIGEN_IMAGE_H_ */
@@ -0,0 +1,385 @@
+/*
+  CLI generator string interning
+
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+
+  This file includes an intern table of immutable strings shared by parse-tree objects.
+  Generated specs repeat the same keywords, help texts and variable specs many times.
+  Each distinct string is stored once, in an arena, and objects point to the shared copy.
+  Help vectors (co_helpvec) are interned as whole vectors.
+  An interned object is marked with CO_FLAGS_INTERN, see co_intern.
+*/
+
+#include "cligen_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "cligen_buf.h"
+#include "cligen_cv.h"
+#include "cligen_cvec.h"
+#include "cligen_parsetree.h"
+#include "cligen_pt_head.h"
+#include "cligen_object.h"
+#include "cligen_handle.h"
+#include "cligen_arena.h"
+#include "cligen_intern.h"
+
+struct cligen_intern{
+    cligen_arena *ci_arena;    /* String data */
+    char        **ci_strs;     /* Open addressing hash table of strings */
+    size_t        ci_slots;    /* Number of slots in ci_strs, power of two */
+    size_t        ci_len;      /* Number of strings */
+    cvec        **ci_cvecs;    /* Open addressing hash table of help vectors */
+    size_t        ci_cvslots;  /* Number of slots in ci_cvecs, power of two */
+    size_t        ci_cvlen;    /* Number of help vectors */
+};
+
+/*! FNV-1a hash of a string, continuing from h
+ */
+static inline uint32_t
+intern_hash(uint32_t    h,
+	    const char *str)
+{
+    const unsigned char *s = (const unsigned char *)str;
+
+    while (*s){
+	h ^= *s++;
+	h *= 16777619U;
+    }
+    return h;
+}
+
+#define INTERN_HASH0 2166136261U
+
+/*! Hash of all strings of a help vector
+ */
+static uint32_t
+intern_cvec_hash(cvec *cvv)
+{
+    cg_var  *cv = NULL;
+    char    *str;
+    uint32_t h = INTERN_HASH0;
+
+    while ((cv = cvec_each(cvv, cv)) != NULL){
+	if ((str = cv_string_get(cv)) != NULL)
+	    h = intern_hash(h, str);
+	h = (h ^ '\n') * 16777619U; /* separator */
+    }
+    return h;
+}
+
+/*! Help vectors are equal if they have the same strings
+ */
+static int
+intern_cvec_eq(cvec *cvv1,
+	       cvec *cvv2)
+{
+    int   i;
+    char *s1;
+    char *s2;
+
+    if (cvec_len(cvv1) != cvec_len(cvv2))
+	return 0;
+    for (i=0; i<cvec_len(cvv1); i++){
+	s1 = cv_string_get(cvec_i(cvv1, i));
+	s2 = cv_string_get(cvec_i(cvv2, i));
+	if (s1 == NULL || s2 == NULL){
+	    if (s1 != s2)
+		return 0;
+	}
+	else if (strcmp(s1, s2) != 0)
+	    return 0;
+    }
+    return 1;
+}
+
+/*! Create a new intern table
+ * @retval  ci    Intern table, free with cligen_intern_free
+ * @retval  NULL  Error
+ */
+cligen_intern *
+cligen_intern_new(void)
+{
+    cligen_intern *ci;
+
+    if ((ci = malloc(sizeof(*ci))) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	return NULL;
+    }
+    memset(ci, 0, sizeof(*ci));
+    if ((ci->ci_arena = cligen_arena_new(0)) == NULL)
+	goto err;
+    ci->ci_slots = CLIGEN_INTERN_SLOTS;
+    if ((ci->ci_strs = calloc(ci->ci_slots, sizeof(char*))) == NULL){
+	fprintf(stderr, "%s: calloc: %s\n", __FUNCTION__, strerror(errno));
+	goto err;
+    }
+    ci->ci_cvslots = CLIGEN_INTERN_SLOTS;
+    if ((ci->ci_cvecs = calloc(ci->ci_cvslots, sizeof(cvec*))) == NULL){
+	fprintf(stderr, "%s: calloc: %s\n", __FUNCTION__, strerror(errno));
+	goto err;
+    }
+    return ci;
+ err:
+    cligen_intern_free(ci);
+    return NULL;
+}
+
+/*! Double the string hash table and rehash
+ */
+static int
+intern_grow(cligen_intern *ci)
+{
+    char  **strs;
+    size_t  slots = ci->ci_slots*2;
+    size_t  i;
+    size_t  j;
+
+    if ((strs = calloc(slots, sizeof(char*))) == NULL){
+	fprintf(stderr, "%s: calloc: %s\n", __FUNCTION__, strerror(errno));
+	return -1;
+    }
+    for (i=0; i<ci->ci_slots; i++){
+	if (ci->ci_strs[i] == NULL)
+	    continue;
+	j = intern_hash(INTERN_HASH0, ci->ci_strs[i]) & (slots-1);
+	while (strs[j] != NULL)
+	    j = (j+1) & (slots-1);
+	strs[j] = ci->ci_strs[i];
+    }
+    free(ci->ci_strs);
+    ci->ci_strs = strs;
+    ci->ci_slots = slots;
+    return 0;
+}
+
+/*! Double the help vector hash table and rehash
+ */
+static int
+intern_cvec_grow(cligen_intern *ci)
+{
+    cvec  **cvecs;
+    size_t  slots = ci->ci_cvslots*2;
+    size_t  i;
+    size_t  j;
+
+    if ((cvecs = calloc(slots, sizeof(cvec*))) == NULL){
+	fprintf(stderr, "%s: calloc: %s\n", __FUNCTION__, strerror(errno));
+	return -1;
+    }
+    for (i=0; i<ci->ci_cvslots; i++){
+	if (ci->ci_cvecs[i] == NULL)
+	    continue;
+	j = intern_cvec_hash(ci->ci_cvecs[i]) & (slots-1);
+	while (cvecs[j] != NULL)
+	    j = (j+1) & (slots-1);
+	cvecs[j] = ci->ci_cvecs[i];
+    }
+    free(ci->ci_cvecs);
+    ci->ci_cvecs = cvecs;
+    ci->ci_cvslots = slots;
+    return 0;
+}
+
+/*! Get the interned copy of a string, add it if not present
+ *
+ * The returned string is owned by the table and must not be modified or freed.
+ * Equal strings return the same pointer.
+ * @param[in]  ci    Intern table
+ * @param[in]  str   String
+ * @retval     istr  Interned string
+ * @retval     NULL  Error
+ */
+char *
+cligen_intern_str(cligen_intern *ci,
+		  char          *str)
+{
+    size_t j;
+    size_t len;
+    char  *istr;
+
+    if (ci == NULL || str == NULL){
+	errno = EINVAL;
+	return NULL;
+    }
+    j = intern_hash(INTERN_HASH0, str) & (ci->ci_slots-1);
+    while ((istr = ci->ci_strs[j]) != NULL){
+	if (strcmp(istr, str) == 0)
+	    return istr;
+	j = (j+1) & (ci->ci_slots-1);
+    }
+    len = strlen(str) + 1;
+    if ((istr = cligen_arena_alloc(ci->ci_arena, len)) == NULL)
+	return NULL;
+    memcpy(istr, str, len);
+    ci->ci_strs[j] = istr;
+    ci->ci_len++;
+    /* Keep load factor below 1/2 */
+    if (ci->ci_len*2 > ci->ci_slots && intern_grow(ci) < 0)
+	return NULL;
+    return istr;
+}
+
+/*! Get the interned copy of a help vector, add a copy of it if not present
+ *
+ * The returned vector is owned by the table and must not be modified or freed.
+ * @param[in]  ci    Intern table
+ * @param[in]  cvv   Help vector, not modified
+ * @retval     icvv  Interned help vector
+ * @retval     NULL  Error
+ */
+cvec *
+cligen_intern_cvec(cligen_intern *ci,
+		   cvec          *cvv)
+{
+    size_t j;
+    cvec  *icvv;
+
+    if (ci == NULL || cvv == NULL){
+	errno = EINVAL;
+	return NULL;
+    }
+    j = intern_cvec_hash(cvv) & (ci->ci_cvslots-1);
+    while ((icvv = ci->ci_cvecs[j]) != NULL){
+	if (intern_cvec_eq(icvv, cvv))
+	    return icvv;
+	j = (j+1) & (ci->ci_cvslots-1);
+    }
+    if ((icvv = cvec_dup(cvv)) == NULL)
+	return NULL;
+    ci->ci_cvecs[j] = icvv;
+    ci->ci_cvlen++;
+    if (ci->ci_cvlen*2 > ci->ci_cvslots && intern_cvec_grow(ci) < 0)
+	return NULL;
+    return icvv;
+}
+
+/*! Number of interned strings and help vectors
+ * @param[in]  ci    Intern table
+ */
+size_t
+cligen_intern_len(cligen_intern *ci)
+{
+    if (ci == NULL)
+	return 0;
+    return ci->ci_len + ci->ci_cvlen;
+}
+
+/*! Approximate memory used by intern table in bytes, not including help vectors
+ * @param[in]  ci    Intern table
+ */
+size_t
+cligen_intern_size(cligen_intern *ci)
+{
+    if (ci == NULL)
+	return 0;
+    return sizeof(*ci) + cligen_arena_size(ci->ci_arena) +
+	ci->ci_slots*sizeof(char*) + ci->ci_cvslots*sizeof(cvec*);
+}
+
+/*! Free intern table including all interned strings and help vectors
+ *
+ * All objects pointing to the table must be freed before, see cligen_exit
+ * @param[in]  ci    Intern table
+ */
+int
+cligen_intern_free(cligen_intern *ci)
+{
+    size_t i;
+
+    if (ci == NULL)
+	return 0;
+    if (ci->ci_cvecs){
+	for (i=0; i<ci->ci_cvslots; i++)
+	    if (ci->ci_cvecs[i])
+		cvec_free(ci->ci_cvecs[i]);
+	free(ci->ci_cvecs);
+    }
+    if (ci->ci_strs)
+	free(ci->ci_strs);
+    if (ci->ci_arena)
+	cligen_arena_free(ci->ci_arena);
+    free(ci);
+    return 0;
+}
+
+/*! Intern all objects of a parse-tree recursively
+ */
+static int
+pt_intern(cligen_intern *ci,
+	  parse_tree    *pt)
+{
+    int     i;
+    cg_obj *co;
+
+    for (i=0; i<pt_len_get(pt); i++){
+	if ((co = pt_vec_i_get(pt, i)) == NULL ||
+	    co_flags_get(co, CO_FLAGS_SHALLOW))
+	    continue;
+	if (!co_flags_get(co, CO_FLAGS_INTERN) &&
+	    co_intern(ci, co) < 0)
+	    return -1;
+	/* Children may have been added after an earlier pass */
+	if (!co_flags_get(co, CO_FLAGS_REFSHARED) &&
+	    co_pt_get(co) != NULL &&
+	    pt_intern(ci, co_pt_get(co)) < 0)
+	    return -1;
+    }
+    return 0;
+}
+
+/*! Intern strings of all objects in a parse-tree, if interning is enabled
+ *
+ * Called after a spec is parsed or loaded from an image. Objects already interned are
+ * skipped, but their children are visited.
+ * @param[in]  h     CLIgen handle
+ * @param[in]  pt    Parse-tree
+ * @retval     0     OK, or interning not enabled
+ * @retval    -1     Error
+ * @see cligen_intern_set
+ */
+int
+cligen_parsetree_intern(cligen_handle h,
+			parse_tree   *pt)
+{
+    cligen_intern *ci;
+
+    if (pt == NULL)
+	return 0;
+    if ((ci = cligen_intern_table(h)) == NULL)
+	return 0;
+    return pt_intern(ci, pt);
+}
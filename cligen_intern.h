@@ -0,0 +1,63 @@
+/*
+  CLI generator string interning
+
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+
+  This file includes an intern table of immutable strings shared by parse-tree objects
+*/
+
+#ifndef _CLIGEN_INTERN_H_
+#define _CLIGEN_INTERN_H_
+
+/*
+ * Constants
+ */
+/* Initial number of slots in intern hash tables, power of two */
+#define CLIGEN_INTERN_SLOTS 1024
+
+/*
+ * Types
+ */
+typedef struct cligen_intern cligen_intern; /* struct defined internally in cligen_intern.c */
+
+/*
+ * Prototypes
+ */
+cligen_intern *cligen_intern_new(void);
+char         *cligen_intern_str(cligen_intern *ci, char *str);
+cvec         *cligen_intern_cvec(cligen_intern *ci, cvec *cvv);
+size_t        cligen_intern_len(cligen_intern *ci);
+size_t        cligen_intern_size(cligen_intern *ci);
+int           cligen_intern_free(cligen_intern *ci);
+int           cligen_parsetree_intern(cligen_handle h, parse_tree *pt);
+
+#endif /* _CLIGEN_INTERN_H_ */
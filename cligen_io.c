@@ -46,6 +46,7 @@
 #include <errno.h>
 #include <signal.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <net/if.h>
@@ -61,6 +62,9 @@
 #include "cligen_print.h"
 #include "cligen_io.h"
 #include "cligen_getline.h"
+#include "cligen_regex.h"
+#include "cligen_stats.h"
+#include "cligen_handle_internal.h"
 
 /*
  * Constants
@@ -75,10 +79,442 @@
  */
 #define CLIGEN_HELP_LEFT_MARGIN 3
 
+/*
+ * Types
+ */
+/*! Output filter, see cligen_output_filter_add */
+struct cligen_ofilter{
+    struct cligen_ofilter *of_next;
+    enum cligen_filter     of_type;
+    void                  *of_re;    /* Compiled regexp, or NULL */
+    int                    of_count; /* Number of lines (count) or if matched (begin) */
+};
+
+/*! Output stream of a handle, see cligen_output
+ *
+ * The buffer has pending data ready to write: [0, os_len), followed by data that is
+ * not yet filtered: the last incomplete line [os_len, os_len+os_part).
+ * Pending data is written to the stdio buffer of os_f at the end of each call, so that
+ * it is in call order with other stdio output to the same file.
+ */
+struct cligen_ostream{
+    FILE                  *os_f;      /* Pending data is written to this file */
+    int                    os_stdout; /* Output to stdout, maybe redirected: filtered */
+    char                  *os_buf;    /* Write buffer */
+    size_t                 os_buflen; /* Allocated size of os_buf */
+    size_t                 os_len;    /* Pending data ready to write */
+    size_t                 os_part;   /* Incomplete line not yet filtered */
+    int                    os_lines;  /* Lines output since reset for paging, -1: quit */
+    int                    os_depth;  /* Nesting of cligen_output_begin/end */
+    struct cligen_ofilter *os_filters; /* Filter chain on stdout, applied in order */
+    cligen_handle          os_h;      /* Handle of filter regexps, or NULL */
+};
+
 /*
  * Local variables
  */
-static int D_LINES=0; /* XXX: global */
+/* Stream of threads without handle, not buffered between calls */
+static __thread struct cligen_ostream _ostream = {0,};
+
+/*! Get output stream of handle, or of the thread if there is no handle
+ * @param[in]  h   CLIgen handle, or NULL for handle bound to thread
+ * @retval     os  Output stream
+ * @retval     NULL Error
+ */
+static struct cligen_ostream *
+ostream_get(cligen_handle h)
+{
+    struct cligen_handle  *ch;
+    struct cligen_ostream *os;
+
+    if (h == NULL && (h = cligen_thread()) == NULL)
+	return &_ostream;
+    ch = handle(h);
+    if ((os = ch->ch_ostream) == NULL){
+	if ((os = malloc(sizeof(*os))) == NULL){
+	    fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	    return NULL;
+	}
+	memset(os, 0, sizeof(*os));
+	os->os_h = (cligen_handle)ch;
+	ch->ch_ostream = os;
+    }
+    return os;
+}
+
+/*! Make room for len more bytes (and a NUL) in the write buffer
+ * @param[in]  os   Output stream
+ * @param[in]  len  Number of bytes after pending and unfiltered data
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+static int
+ostream_reserve(struct cligen_ostream *os,
+		size_t                 len)
+{
+    size_t need;
+    size_t buflen;
+    char  *buf;
+
+    need = os->os_len + os->os_part + len + 1;
+    if (need <= os->os_buflen)
+	return 0;
+    buflen = os->os_buflen ? os->os_buflen : CLIGEN_OUTPUT_BUFMIN;
+    while (buflen < need)
+	buflen *= 2;
+    if ((buf = realloc(os->os_buf, buflen)) == NULL){
+	fprintf(stderr, "%s: realloc: %s\n", __FUNCTION__, strerror(errno));
+	return -1;
+    }
+    os->os_buf = buf;
+    os->os_buflen = buflen;
+    return 0;
+}
+
+/*! Write vector of buffers to file
+ *
+ * The data is written with stdio after earlier stdio output to f, eg with printf, to
+ * keep the order of output. Stdio writes it when its buffer is full, when f is flushed,
+ * and before getline reads the terminal, see gl_flush. Large buffers are written by
+ * stdio without copying.
+ * @param[in]  f     Open file
+ * @param[in]  iov   Vector of buffers
+ * @param[in]  n     Length of iov
+ * @retval     0     OK
+ * @retval    -1    Error
+ */
+static int
+ostream_writev(FILE         *f,
+	       struct iovec *iov,
+	       int           n)
+{
+    int i;
+
+    for (i=0; i<n; i++)
+	if (iov[i].iov_len && fwrite(iov[i].iov_base, 1, iov[i].iov_len, f) != iov[i].iov_len)
+	    return -1;
+    return 0;
+}
+
+/*! Write pending data of the stream, not unfiltered data
+ * @param[in]  os   Output stream
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+static int
+ostream_write(struct cligen_ostream *os)
+{
+    struct iovec iov[1];
+
+    if (os->os_len == 0)
+	return 0;
+    iov[0].iov_base = os->os_buf;
+    iov[0].iov_len = os->os_len;
+    if (ostream_writev(os->os_f, iov, 1) < 0)
+	return -1;
+    if (os->os_part)
+	memmove(os->os_buf, os->os_buf + os->os_len, os->os_part);
+    os->os_len = 0;
+    return 0;
+}
+
+/*! Show --More-- at a page boundary and read the answer of the user
+ *
+ * The page is flushed with --More-- before stdin is read.
+ * @param[in]  os   Output stream, with pending data written
+ */
+static void
+ostream_more(struct cligen_ostream *os)
+{
+    FILE *f = os->os_f;
+    char  c;
+
+    gl_char_init();
+    fprintf(f, "--More--");
+    fflush(f);
+    c = fgetc(stdin);
+    if (c == '\n')
+	os->os_lines--;
+    else if (c == ' ')
+	os->os_lines = 0;
+    else if (c == 'q' || c == 3) /* ^c */
+	os->os_lines = -1;
+    else if (c == '?')
+	fprintf(f, "Press CR for one more line, SPACE for next page, q to quit\n");
+    else 
+	os->os_lines = 0;  
+    fprintf(f, "        ");
+    fflush(f);
+    gl_char_cleanup();
+}
+
+/*! Run a line through the filter chain
+ * @param[in]  os    Output stream
+ * @param[in]  line  Line without newline, NUL-terminated
+ * @retval     1     Line passes all filters
+ * @retval     0     Line is filtered out
+ * @retval    -1     Error
+ */
+static int
+ostream_filter(struct cligen_ostream *os,
+	       char                  *line)
+{
+    struct cligen_ofilter *of;
+    int                    ret;
+
+    for (of = os->os_filters; of; of = of->of_next){
+	if (of->of_type == CLIGEN_FILTER_COUNT){
+	    of->of_count++;
+	    return 0;
+	}
+	if (of->of_type == CLIGEN_FILTER_BEGIN && of->of_count)
+	    continue;
+	if ((ret = cligen_regex_exec(os->os_h, of->of_re, line)) < 0)
+	    return -1;
+	switch (of->of_type){
+	case CLIGEN_FILTER_INCLUDE:
+	    if (ret == 0)
+		return 0;
+	    break;
+	case CLIGEN_FILTER_EXCLUDE:
+	    if (ret == 1)
+		return 0;
+	    break;
+	case CLIGEN_FILTER_BEGIN:
+	    if (ret == 0)
+		return 0;
+	    of->of_count = 1;
+	    break;
+	default:
+	    break;
+	}
+    }
+    return 1;
+}
+
+/*! Filter and page new data of the stream
+ *
+ * New data of len bytes is in the buffer after pending and unfiltered data. Complete
+ * lines through the filters become pending data, as does the rest if not filtering.
+ * On a page boundary, the pending data is written and --More-- is shown.
+ * @param[in]  os     Output stream
+ * @param[in]  len    Length of new data
+ * @param[in]  rows   Terminal rows for paging, or 0
+ * @param[in]  final  Also filter the last incomplete line
+ * @retval     0      OK
+ * @retval    -1      Error
+ */
+static int
+ostream_process(struct cligen_ostream *os,
+		size_t                 len,
+		int                    rows,
+		int                    final)
+{
+    struct cligen_ofilter *filters;
+    char                  *buf;
+    char                  *nl;
+    size_t                 rd;   /* Read position of unfiltered data */
+    size_t                 end;
+    size_t                 ll;
+    int                    ret;
+
+    rd = os->os_len;
+    end = os->os_len + os->os_part + len;
+    /* Filters apply to stdout only, not eg to stderr */
+    filters = os->os_stdout ? os->os_filters : NULL;
+    if (filters == NULL && rows == 0){
+	os->os_len = end;
+	os->os_part = 0;
+	return 0;
+    }
+    buf = os->os_buf;
+    while (rd < end){
+	if ((nl = memchr(buf + rd, '\n', end - rd)) != NULL)
+	    ll = nl - (buf + rd) + 1;
+	else if (final || filters == NULL)
+	    ll = end - rd;
+	else
+	    break;
+	ret = 1;
+	if (filters){
+	    buf[rd + ll - (nl?1:0)] = '\0';
+	    ret = ostream_filter(os, buf + rd);
+	    if (nl)
+		*nl = '\n';
+	    if (ret < 0)
+		return -1;
+	}
+	if (ret == 1){
+	    if (rd != os->os_len)
+		memmove(buf + os->os_len, buf + rd, ll);
+	    os->os_len += ll;
+	}
+	rd += ll;
+	if (ret == 1 && nl && rows){
+	    os->os_lines++;
+	    if (os->os_lines >= rows - 1){
+		/* Page boundary: write it and move unfiltered data to the front */
+		os->os_part = end - rd;
+		if (rd != os->os_len)
+		    memmove(buf + os->os_len, buf + rd, os->os_part);
+		if (ostream_write(os) < 0)
+		    return -1;
+		rd = 0;
+		end = os->os_part;
+		ostream_more(os);
+		if (os->os_lines < 0){ /* quit: drop the rest */
+		    end = 0;
+		    break;
+		}
+	    }
+	}
+    }
+    os->os_part = end - rd;
+    if (os->os_part && rd != os->os_len)
+	memmove(buf + os->os_len, buf + rd, os->os_part);
+    return 0;
+}
+
+/*! Write all data of the stream, including the incomplete line
+ * @param[in]  os   Output stream
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+static int
+ostream_flush(struct cligen_ostream *os)
+{
+    if (os->os_f == NULL)
+	return 0;
+    if (os->os_part && ostream_process(os, 0, 0, 1) < 0)
+	return -1;
+    return ostream_write(os);
+}
+
+/*! Prepare stream for new data to file f and get the paging rows
+ * @param[in]  os   Output stream
+ * @param[in]  f    Open stdio FILE pointer
+ * @param[out] rows Terminal rows for paging, or 0
+ * @retval     1    OK
+ * @retval     0    Quit by user in paging, discard data
+ * @retval    -1    Error
+ */
+static int
+ostream_use(struct cligen_ostream *os,
+	    FILE                  *f,
+	    int                   *rows)
+{
+    FILE *fo;
+    int   out = (f == stdout);
+
+    *rows = 0;
+    if (out){
+	*rows = cligen_terminal_rows(os->os_h);
+	if (*rows && os->os_lines < 0)
+	    return 0;
+	/* Redirected, eg to a session, see cligen_output_file_set */
+	if (os->os_h && (fo = cligen_output_file(os->os_h)) != NULL){
+	    *rows = 0;
+	    f = fo;
+	}
+    }
+    if (os->os_f != f || os->os_stdout != out){
+	if (ostream_flush(os) < 0)
+	    return -1;
+	os->os_f = f;
+	os->os_stdout = out;
+    }
+    return 1;
+}
+
+/*! Write pending data to stdio at the end of a call, see ostream_writev
+ * @param[in]  os   Output stream
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+static int
+ostream_done(struct cligen_ostream *os)
+{
+    if (ostream_write(os) < 0)
+	return -1;
+    /* Streams without handle are not buffered between calls */
+    if (os == &_ostream && os->os_depth == 0 && os->os_buf){
+	free(os->os_buf);
+	os->os_buf = NULL;
+	os->os_buflen = 0;
+    }
+    return 0;
+}
+
+/*! Format output to file f in the stream, see cligen_output
+ * @param[in]  os        Output stream
+ * @param[in]  f         Open stdio FILE pointer
+ * @param[in]  template  See man printf(3)
+ * @param[in]  ap        Arguments of template
+ * @retval     0         OK
+ * @retval    -1         Error
+ */
+static int
+ostream_vprintf(struct cligen_ostream *os,
+		FILE                  *f,
+		const char            *template,
+		va_list                ap)
+{
+    int     retval = -1;
+    va_list args;
+    size_t  avail;
+    char   *p;
+    int     rows;
+    int     len;
+    int     ret;
+
+    if ((ret = ostream_use(os, f, &rows)) < 0)
+	goto done;
+    if (ret == 0)
+	goto ok;
+    if (ostream_reserve(os, CLIGEN_OUTPUT_BUFMIN/2) < 0)
+	goto done;
+    /* Format directly after pending and unfiltered data, once if it fits */
+    p = os->os_buf + os->os_len + os->os_part;
+    avail = os->os_buflen - (p - os->os_buf);
+    va_copy(args, ap);
+    len = vsnprintf(p, avail, template, args);
+    va_end(args);
+    if (len < 0)
+	goto done;
+    if ((size_t)len >= avail){
+	if (ostream_reserve(os, len) < 0)
+	    goto done;
+	p = os->os_buf + os->os_len + os->os_part;
+	va_copy(args, ap);
+	vsnprintf(p, len+1, template, args);
+	va_end(args);
+    }
+    if (ostream_process(os, len, rows, 0) < 0)
+	goto done;
+    if (ostream_done(os) < 0)
+	goto done;
+ ok:
+    retval = 0;
+ done:
+    return retval;
+}
+
+/*! Format output to file f in the stream, see cligen_output
+ */
+static int
+ostream_printf(struct cligen_ostream *os,
+	       FILE                  *f,
+	       const char            *template,
+	       ...)
+{
+    int     retval;
+    va_list args;
+
+    va_start(args, template);
+    retval = ostream_vprintf(os, f, template, args);
+    va_end(args);
+    return retval;
+}
 
 /*! Reset cligen_output to initial state
  * For new output or when 'q' is pressed that sets d_line to -1
@@ -86,32 +522,46 @@ static int D_LINES=0; /* XXX: global */
 int
 cli_output_reset(void)
 {
-    D_LINES = 0;
+    struct cligen_ostream *os;
+
+    if ((os = ostream_get(NULL)) != NULL)
+	os->os_lines = 0;
     return 0;
 }
 
 int
 cli_output_status(void)
 {
-    return D_LINES;
+    struct cligen_ostream *os;
+
+    if ((os = ostream_get(NULL)) == NULL)
+	return 0;
+    return os->os_lines;
 }
 
 /*! CLIgen output function. All printf-style output should be made via this function.
  * 
- * It deals with formatting, page breaks, etc. 
+ * It deals with formatting, page breaks, filters, etc. 
+ * Output is formatted directly into the write buffer of the output stream of the handle
+ * bound to the thread, filtered and paged, and written to the stdio buffer of f. Output
+ * is thereby in call order with other stdio output, eg printf, to the same file.
+ * Output filters apply to stdout, see cligen_output_filter_add.
  * @param[in] f           Open stdio FILE pointer
  * @param[in] template... See man printf(3)
  *
- * @note: There has also been a discussion on the use of handles in this code (it relies on a
- * global variable _terminalrows and D_LINES). However, the signature needs to be the same as
- * fprintf in order to make compatible printing code.
+ * @note: There has also been a discussion on the use of handles in this code. The signature
+ * needs to be the same as fprintf in order to make compatible printing code, therefore the
+ * terminal rows of the handle bound to the thread are used, see cligen_thread_set.
  *
- * @note Related to the handle question is the use of the global variable D_LINES in order to
- * handle multiple calls (such as in a loop) to cligen_output. However, this assumes D_LINES
- * is reset before a new usage to D_LINES using the function cli_output_reset(). This therefore
+ * @note Related to the handle question is the use of the line count of the output stream in
+ * order to handle multiple calls (such as in a loop) to cligen_output. However, this assumes
+ * the count is reset before a new usage using the function cli_output_reset(). This therefore
  * be done between invocations. Especially this applies to 'q'. Further, to react to quit, you need
  * to poll cli_output_status() < 0.
  *
+ * @note When output is filtered, the last incomplete line is kept until it is complete
+ * or the command ends, call cligen_output_flush before direct stdio output of a line.
+ *
  * @note: There has been a debate whether this function is the right solution to the
  * pageing problem of CLIgen or not. 
  * (1) On the one hand, a less/more like sub-process could be forked and stdout piped to this
@@ -127,87 +577,251 @@ cligen_output(FILE       *f,
 	      const char *template,
 	      ... )
 {
-    int     retval = -1;
-    va_list args;
-    char   *buf = NULL;
-    char   *start;
-    char   *end;
-    char   *bufend;
-    char    c;
-    int     term_rows;
-    int     len;
-
-    term_rows = cligen_terminal_rows(NULL);
-    /* form a string in buf from all args */
+    int                    retval = -1;
+    va_list                args;
+    struct cligen_ostream *os;
 
+    if ((os = ostream_get(NULL)) == NULL)
+	goto done;
     va_start(args, template);
-    len = vsnprintf(NULL, 0, template, args);
+    retval = ostream_vprintf(os, f, template, args);
     va_end(args);
-    len++;
-    if ((buf = malloc(len)) == NULL){
-	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+ done:
+    return retval;
+}
+
+/*! CLIgen output of a cbuf, as cligen_output but without formatting
+ *
+ * If the data is not filtered or paged and is large, it is written to f without
+ * copying it to the buffer of the stream.
+ * @param[in] f   Open stdio FILE pointer
+ * @param[in] cb  CLIgen buffer
+ * @retval    0   OK
+ * @retval   -1   Error
+ * @see cligen_output
+ */
+int
+cligen_output_cbuf(FILE *f,
+		   cbuf *cb)
+{
+    int                    retval = -1;
+    struct cligen_ostream *os;
+    struct iovec           iov[2];
+    size_t                 len;
+    int                    rows;
+    int                    ret;
+
+    if (f == NULL || cb == NULL){
+	errno = EINVAL;
 	goto done;
     }
-    va_start(args, template);
-    vsnprintf(buf, len, template, args);
-    va_end(args);
+    if ((os = ostream_get(NULL)) == NULL)
+	goto done;
+    if ((ret = ostream_use(os, f, &rows)) < 0)
+	goto done;
+    if (ret == 0 || (len = cbuf_len(cb)) == 0)
+	goto ok;
+    if (rows == 0 && (!os->os_stdout || os->os_filters == NULL) &&
+	os->os_len + len >= CLIGEN_OUTPUT_BUFSIZE){
+	iov[0].iov_base = os->os_buf;
+	iov[0].iov_len = os->os_len;
+	iov[1].iov_base = cbuf_get(cb);
+	iov[1].iov_len = len;
+	if (ostream_writev(os->os_f, iov, 2) < 0)
+	    goto done;
+	os->os_len = 0;
+	goto ok;
+    }
+    if (ostream_reserve(os, len) < 0)
+	goto done;
+    memcpy(os->os_buf + os->os_len + os->os_part, cbuf_get(cb), len);
+    if (ostream_process(os, len, rows, 0) < 0)
+	goto done;
+    if (ostream_done(os) < 0)
+	goto done;
+ ok:
+    retval = 0;
+ done:
+    return retval;
+}
 
-    /* if writing to stdout, format output
-     */
-    if ((term_rows) && (f == stdout)){
-	start = end = buf;
-	bufend = buf + strlen(buf);
-	while (end < bufend){
-	    end = strstr(start, "\n");
-	    if (end) /* got a NL */{
-		if (D_LINES >= 0)
-		    D_LINES++;
-		*end = '\0';
-		if (D_LINES > -1)
-		    fprintf(f, "%s\n", start);
-	      
-		if (end < bufend)
-		    start = end+1;
-	      
-		if (D_LINES >= (term_rows -1)){		    
-		    gl_char_init();
-
-		    fprintf(f, "--More--");
-		    c = fgetc(stdin);
-		    if (c == '\n')
-			D_LINES--;
-		    else if (c == ' ')
-			    D_LINES = 0;
-		    else if (c == 'q' || c == 3) /* ^c */
-			D_LINES = -1;
-		    else if (c == '?')
-			fprintf(f, "Press CR for one more line, SPACE for next page, q to quit\n");
-		    else 
-			D_LINES = 0;  
-		    fprintf(f, "        ");
-		    gl_char_cleanup();
-		}
-	    } /* NL */
-	    else{
-		/* do only print if we have data */
-		if (D_LINES >=0 && *start != '\0')
-		    fprintf(f, "%s", start);
-		end = start + strlen(start);
-		start = end;
-	    }
+/*! Write all buffered output of the handle
+ * @param[in] h   CLIgen handle, or NULL for handle bound to thread
+ * @retval    0   OK
+ * @retval   -1   Error
+ */
+int
+cligen_output_flush(cligen_handle h)
+{
+    struct cligen_ostream *os;
+
+    if ((os = ostream_get(h)) == NULL)
+	return -1;
+    return ostream_flush(os);
+}
+
+/*! Start output of a command, filters are kept until cligen_output_end
+ * @param[in] h   CLIgen handle
+ * @retval    0   OK
+ * @retval   -1   Error
+ * @see cligen_eval  which calls this around callbacks
+ */
+int
+cligen_output_begin(cligen_handle h)
+{
+    struct cligen_ostream *os;
+
+    if ((os = ostream_get(h)) == NULL)
+	return -1;
+    os->os_depth++;
+    return 0;
+}
+
+/*! End output of a command: remove filters and write the last incomplete line
+ * @param[in] h   CLIgen handle
+ * @retval    0   OK
+ * @retval   -1   Error
+ * @see cligen_output_begin
+ */
+int
+cligen_output_end(cligen_handle h)
+{
+    struct cligen_ostream *os;
+
+    if ((os = ostream_get(h)) == NULL)
+	return -1;
+    if (os->os_depth > 0 && --os->os_depth > 0)
+	return 0;
+    if (os->os_filters && cligen_output_filter_reset(h) < 0)
+	return -1;
+    return ostream_flush(os);
+}
+
+/*! Attach a filter to the output on stdout of a handle, as a pipe of the command
+ *
+ * Filters are applied in the order added to each line of output, until the end of the
+ * command (see cligen_output_end) or cligen_output_filter_reset.
+ * @param[in] h       CLIgen handle, or NULL for handle bound to thread
+ * @param[in] type    Filter type
+ * @param[in] regexp  Regular expression, matches anywhere in a line. Not for count.
+ * @retval    1       OK
+ * @retval    0       Invalid regular expression
+ * @retval   -1       Error
+ * @code
+ *   cligen_output_filter_add(h, CLIGEN_FILTER_INCLUDE, "interface");
+ *   cligen_output_filter_add(h, CLIGEN_FILTER_COUNT, NULL);
+ * @endcode
+ */
+int
+cligen_output_filter_add(cligen_handle      h,
+			 enum cligen_filter type,
+			 char              *regexp)
+{
+    int                     retval = -1;
+    struct cligen_ostream  *os;
+    struct cligen_ofilter  *of = NULL;
+    struct cligen_ofilter **ofp;
+    cbuf                   *cb = NULL;
+    int                     ret;
+
+    if ((h == NULL && cligen_thread() == NULL) ||
+	(type != CLIGEN_FILTER_COUNT && regexp == NULL)){
+	errno = EINVAL;
+	goto done;
+    }
+    if ((os = ostream_get(h)) == NULL)
+	goto done;
+    /* Filter data with the new chain, not earlier data */
+    if (os->os_stdout && ostream_flush(os) < 0)
+	goto done;
+    if ((of = malloc(sizeof(*of))) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	goto done;
+    }
+    memset(of, 0, sizeof(*of));
+    of->of_type = type;
+    if (type != CLIGEN_FILTER_COUNT){
+	if ((cb = cbuf_new()) == NULL)
+	    goto done;
+	cprintf(cb, ".*(%s).*", regexp);
+	if ((ret = cligen_regex_compile(os->os_h, cbuf_get(cb), &of->of_re)) < 0)
+	    goto done;
+	if (ret == 0){
+	    retval = 0;
+	    goto done;
 	}
     }
-    else{
-	fprintf(f, "%s", buf);
-    }  
-    fflush(f);
+    for (ofp = &os->os_filters; *ofp; ofp = &(*ofp)->of_next);
+    *ofp = of;
+    of = NULL;
+    retval = 1;
+ done:
+    if (cb)
+	cbuf_free(cb);
+    if (of){
+	if (of->of_re)
+	    cligen_regex_free(os->os_h, of->of_re);
+	free(of);
+    }
+    return retval;
+}
+
+/*! Remove all output filters of a handle
+ *
+ * Filtered output is written, with the number of lines of a count filter.
+ * @param[in] h   CLIgen handle, or NULL for handle bound to thread
+ * @retval    0   OK
+ * @retval   -1   Error
+ */
+int
+cligen_output_filter_reset(cligen_handle h)
+{
+    int                    retval = -1;
+    struct cligen_ostream *os;
+    struct cligen_ofilter *of;
+    int                    count = -1;
+
+    if ((os = ostream_get(h)) == NULL)
+	goto done;
+    if (os->os_f == stdout && ostream_flush(os) < 0)
+	goto done;
+    while ((of = os->os_filters) != NULL){
+	os->os_filters = of->of_next;
+	if (of->of_type == CLIGEN_FILTER_COUNT && count < 0)
+	    count = of->of_count;
+	if (of->of_re)
+	    cligen_regex_free(os->os_h, of->of_re);
+	free(of);
+    }
+    if (count >= 0 &&
+	ostream_printf(os, stdout, "Count: %d lines\n", count) < 0)
+	goto done;
     retval = 0;
  done:
-    if (buf)
-	free(buf);
     return retval;
 }
 
+/*! Free output stream of a handle
+ * @param[in] os  Output stream
+ * @see cligen_exit
+ */
+int
+cligen_ostream_free(struct cligen_ostream *os)
+{
+    struct cligen_ofilter *of;
+
+    while ((of = os->os_filters) != NULL){
+	os->os_filters = of->of_next;
+	if (of->of_re)
+	    cligen_regex_free(os->os_h, of->of_re);
+	free(of);
+    }
+    if (os->os_buf)
+	free(os->os_buf);
+    free(os);
+    return 0;
+}
+
 #ifdef notyet
 /*
  * Yes/No question. Returns 1 for yes and 0 for no.
@@ -243,6 +857,21 @@ cligen_unregfd(int fd)
 {
     return gl_unregfd(fd);
 }
+
+/*! Register a callback called when fd is writable, eg for non-blocking output
+ * @see gl_regfd_write
+ */
+int
+cligen_regfd_write(int fd, cligen_fd_cb_t *cb, void *arg)
+{
+    return gl_regfd_write(fd, cb, arg);
+}
+
+int
+cligen_unregfd_write(int fd)
+{
+    return gl_unregfd_write(fd);
+}
 #endif /* CLIGEN_REGFD */
 
 void 
@@ -273,11 +902,15 @@ cligen_interrupt_hook(cligen_handle          h,
 
 /*! Register extra exit characters (in addition to ctrl-c)
  */
-void 
-cligen_exitchar_add(cligen_handle h, 
+void
+cligen_exitchar_add(cligen_handle h,
 		    char          c)
 {
-    gl_exitchar_add(c); /* XXX global */
+    struct gl_state *prev;
+
+    prev = gl_state_set(cligen_gl_state(h));
+    gl_exitchar_add(c);
+    gl_state_set(prev);
 }
 
 /*! Display multi help lines on query (?)
@@ -298,14 +931,14 @@ print_help_line(cligen_handle    h,
     cg_var *cv = NULL;
     int     w;
     char   *str;
-    char   *str2;
     int     j;
     int     linesmax;
     int     termwidth;
     int     truncate;
 	    
     /* First print command */
-    fprintf(fout, "  %*s", -column_width, ch->ch_cmd);
+    if (cligen_output(fout, "  %*s", -column_width, ch->ch_cmd) < 0)
+	goto done;
     /* Then print help */
     if (ch->ch_helpvec && cvec_len(ch->ch_helpvec)){
 	linesmax = cligen_helpstring_lines(h);
@@ -317,35 +950,124 @@ print_help_line(cligen_handle    h,
 	    w = termwidth - column_width - CLIGEN_HELP_LEFT_MARGIN;
 	    str = cv_string_get(cv);
 	    if (j > 0) /* skip first line */
-		fprintf(fout, "  %*s", -column_width, "");
+		cligen_output(fout, "  %*s", -column_width, "");
 	    if (truncate == 0 ||
-		strlen(str) < w){
-		fprintf(fout, " %*s", -w, str);
-	    }
-	    else {
-		if ((str2 = strdup(str)) == NULL)
-		    goto done;
-		str2[w] = '\0';
-		fprintf(fout, " %*s", -w, str2);
-		free(str2);
-		str2 = NULL;
-	    }
-	    fprintf(fout, "\n");
+		strlen(str) < w)
+		cligen_output(fout, " %*s\n", -w, str);
+	    else /* precision cuts the string without a copy */
+		cligen_output(fout, " %-*.*s\n", w, w, str);
 	    j++;
 	}
     }
     else
-	fprintf(fout, "\n");
+	cligen_output(fout, "\n");
     retval = 0;
  done:
     return retval;
 }
 
+/*! Get the command shown by help for a parse-tree object
+ * @param[in]  co   Cligen object
+ * @param[in]  cb   Buffer for variables, reset and overwritten
+ * @retval     cmd  Command or variable as "<name>", not to be freed
+ * @retval     NULL Not shown (no command, or a reference)
+ */
+static char *
+help_cmd(cg_obj *co,
+	 cbuf   *cb)
+{
+    char *cmd = NULL;
+
+    if (co == NULL || co->co_command == NULL)
+	return NULL;
+    switch (co->co_type){
+    case CO_VARIABLE:
+	cbuf_reset(cb);
+	cov2cbuf(cb, co, 1);
+	cmd = cbuf_get(cb);
+	break;
+    case CO_COMMAND:
+	cmd = co->co_command;
+	break;
+    default:
+	break;
+    }
+    if (cmd == NULL || *cmd == '\0')
+	return NULL;
+    return cmd;
+}
+
+/*! Get width of commands shown by help, computed from a bounded sample
+ *
+ * Only the first CLIGEN_HELP_SAMPLE (or at most max) candidates are measured, so that a
+ * huge candidate list does not need to be formatted before the first line is shown. Longer
+ * commands later in the list overflow their column.
+ * @param[in] ptmatch  Cligen parse-node vector
+ * @param[in] matchvec Array of indexes into ptmatch
+ * @param[in] matchlen Length of matchvec
+ * @param[in] max      Max number of commands shown, 0: unlimited
+ * @param[in] cb       Scratch buffer
+ * @retval    width    Column width, at least COLUMN_MIN_WIDTH
+ */
+static int
+help_width(parse_tree *ptmatch,
+	   int        *matchvec,
+	   size_t      matchlen,
+	   int         max,
+	   cbuf       *cb)
+{
+    size_t  i;
+    int     n = 0;
+    int     maxlen = 0;
+    int     len;
+    char   *cmd;
+
+    if (max == 0 || max > CLIGEN_HELP_SAMPLE)
+	max = CLIGEN_HELP_SAMPLE;
+    for (i=0; i<matchlen && n<max; i++){
+	if ((cmd = help_cmd(pt_vec_i_get(ptmatch, matchvec[i]), cb)) == NULL)
+	    continue;
+	n++;
+	if ((len = strlen(cmd)) > maxlen)
+	    maxlen = len;
+    }
+    maxlen++;
+    return maxlen<COLUMN_MIN_WIDTH?COLUMN_MIN_WIDTH:maxlen;
+}
+
+/*! Count help commands not shown after the cap of cligen_help_max was reached
+ * Adjacent duplicates are not detected, the count is an upper bound
+ */
+static int
+help_rest(parse_tree *ptmatch,
+	  int        *matchvec,
+	  size_t      matchlen,
+	  size_t      i0)
+{
+    size_t  i;
+    int     n = 0;
+    cg_obj *co;
+
+    for (i=i0; i<matchlen; i++){
+	co = pt_vec_i_get(ptmatch, matchvec[i]);
+	if (co && co->co_command &&
+	    (co->co_type == CO_COMMAND || co->co_type == CO_VARIABLE))
+	    n++;
+    }
+    return n;
+}
+
 /*! Print help lines for subset of a parsetree vector
+ *
+ * Lines are printed via cligen_output as they are produced, in the order of matchvec,
+ * and stop when the pager is quit. At most cligen_help_max commands are shown, followed
+ * by a line with the number of remaining commands.
+ * @param[in] h        Cligen handle
  * @param[in] fout     File to print to, eg stdout
- * @param[in] ptvec    Cligen parse-node vector
- * @param[in] matchvec Array of indexes into ptvec to match (the subset)
+ * @param[in] ptmatch  Cligen parse-node vector
+ * @param[in] matchvec Array of indexes into ptmatch to match (the subset)
  * @param[in] matchlen Length of matchvec
+ * @see print_help_columns
  */
 int
 print_help_lines(cligen_handle h,
@@ -357,79 +1079,124 @@ print_help_lines(cligen_handle h,
     int              retval = -1;
     cg_obj          *co;
     char            *cmd;
-    int              i;
+    size_t           i;
     cbuf            *cb = NULL;
-    struct cmd_help *chvec = NULL;
-    struct cmd_help *ch;
-    int              maxlen = 0;
-    char            *prev = NULL;
+    cbuf            *prev = NULL;
+    struct cmd_help  ch;
     int              nrcmd = 0;
     int              column_width;
-    int              vi;
+    int              max;
 
-    if ((cb = cbuf_new()) == NULL){
+    if ((cb = cbuf_new()) == NULL || (prev = cbuf_new()) == NULL){
 	fprintf(stderr, "cbuf_new: %s\n", strerror(errno));
-	return -1;
-    }
-    /* Go through match vector and collect commands and helps */
-    if ((chvec = calloc(matchlen, sizeof(struct cmd_help))) ==NULL){
-	perror("calloc");
 	goto done;
     }
+    max = cligen_help_max(h);
+    column_width = help_width(ptmatch, matchvec, matchlen, max, cb);
+    cli_output_reset();
     for (i=0; i<matchlen; i++){
-	vi = matchvec[i]; /* index into array, extra indirection */
-	co = pt_vec_i_get(ptmatch, vi);
-	if (co->co_command == NULL)
+	co = pt_vec_i_get(ptmatch, matchvec[i]);
+	if ((cmd = help_cmd(co, cb)) == NULL)
 	    continue;
-	cmd = NULL;
-	switch(co->co_type){
-	case CO_VARIABLE:
-	    cbuf_reset(cb);
-	    cov2cbuf(cb, co, 1);
-	    if ((cmd = strdup(cbuf_get(cb))) == NULL){
-		perror("strdup");
-		goto done;
-	    }
-	    break;
-	case CO_COMMAND:
-	    if ((cmd = strdup(co->co_command)) == NULL){
-		perror("strdup");
-		goto done;
-	    }
-	    break;
-	default:
+	if (nrcmd && strcmp(cmd, cbuf_get(prev))==0)
 	    continue;
+	if (max && nrcmd == max){
+	    cligen_output(fout, "  ... and %d more\n", help_rest(ptmatch, matchvec, matchlen, i));
 	    break;
 	}
-	if (prev && strcmp(cmd, prev)==0)
-	    continue;
-	ch = &chvec[nrcmd++];
-	ch->ch_cmd = cmd;
-	ch->ch_helpvec = co->co_helpvec;
-	prev = cmd;
-	/* Compute longest command */
-	maxlen = strlen(cmd)>maxlen?strlen(cmd):maxlen;
-    }
-    maxlen++;
-    column_width = maxlen<COLUMN_MIN_WIDTH?COLUMN_MIN_WIDTH:maxlen;
-    /* Actually print */
-    for (i = 0; i<nrcmd; i++){
-	ch = &chvec[i];
-	if (print_help_line(h, fout, column_width, ch) < 0)
+	ch.ch_cmd = cmd;
+	ch.ch_helpvec = co->co_helpvec;
+	if (print_help_line(h, fout, column_width, &ch) < 0)
 	    goto done;
+	if (cli_output_status() < 0) /* quit */
+	    break;
+	cbuf_reset(prev);
+	cbuf_append_str(prev, cmd);
+	nrcmd++;
     }
     fflush(fout);
     retval = 0;
  done:
-    if (chvec){
-	for (i=0; i<nrcmd; i++){
-	    if (chvec[i].ch_cmd)
-		free(chvec[i].ch_cmd);
+    if (cb)
+	cbuf_free(cb);
+    if (prev)
+	cbuf_free(prev);
+    return retval;
+}
+
+/*! Print commands of a subset of a parsetree vector in columns, without help texts
+ *
+ * Commands are printed row by row via cligen_output as they are produced, with the same
+ * sampled width and cap as print_help_lines.
+ * @param[in] h        Cligen handle
+ * @param[in] fout     File to print to, eg stdout
+ * @param[in] ptmatch  Cligen parse-node vector
+ * @param[in] matchvec Array of indexes into ptmatch to match (the subset)
+ * @param[in] matchlen Length of matchvec
+ * @see print_help_lines
+ */
+int
+print_help_columns(cligen_handle h,
+		   FILE         *fout, 
+		   parse_tree   *ptmatch, 
+		   int          *matchvec,
+		   size_t        matchlen)
+{
+    int              retval = -1;
+    char            *cmd;
+    size_t           i;
+    cbuf            *cb = NULL;
+    cbuf            *prev = NULL;
+    int              nrcmd = 0;
+    int              column_width;
+    int              column_nr;
+    int              ci = 0;  /* column number */
+    int              termwidth;
+    int              max;
+
+    if ((cb = cbuf_new()) == NULL || (prev = cbuf_new()) == NULL){
+	fprintf(stderr, "cbuf_new: %s\n", strerror(errno));
+	goto done;
+    }
+    max = cligen_help_max(h);
+    column_width = help_width(ptmatch, matchvec, matchlen, max, cb);
+    termwidth = cligen_terminal_width(h);
+    if ((column_nr = termwidth/column_width) < 1)
+	column_nr = 1;
+    column_width += (termwidth%column_width)/column_nr;
+    cli_output_reset();
+    for (i=0; i<matchlen; i++){
+	if ((cmd = help_cmd(pt_vec_i_get(ptmatch, matchvec[i]), cb)) == NULL)
+	    continue;
+	if (nrcmd && strcmp(cmd, cbuf_get(prev))==0)
+	    continue;
+	if (max && nrcmd == max){
+	    if (ci)
+		cligen_output(fout, "\n");
+	    cligen_output(fout, " ... and %d more\n", help_rest(ptmatch, matchvec, matchlen, i));
+	    ci = 0;
+	    break;
 	}
-	free(chvec);
+	cligen_output(fout, " %*s", -(column_width-1), cmd);
+	nrcmd++;
+	if (++ci == column_nr){
+	    cligen_output(fout, "\n");
+	    ci = 0;
+	    if (cli_output_status() < 0) /* quit */
+		break;
+	}
+	cbuf_reset(prev);
+	cbuf_append_str(prev, cmd);
     }
+    if (ci)
+	cligen_output(fout, "\n");
+    fflush(fout);
+    retval = 0;
+ done:
     if (cb)
 	cbuf_free(cb);
+    if (prev)
+	cbuf_free(prev);
     return retval;
 }
 
@@ -43,6 +43,15 @@
 #define COLUMN_MIN_WIDTH  21 /* For column formatting how many chars minimum 
 				for command/var */
 
+/* Help (? and TAB) computes the column width from at most this many commands */
+#define CLIGEN_HELP_SAMPLE 256
+
+/* Initial size of the write buffer of cligen_output */
+#define CLIGEN_OUTPUT_BUFMIN  4096
+
+/* Output of cligen_output_cbuf of this size is written without copying */
+#define CLIGEN_OUTPUT_BUFSIZE 65536
+
 /*
  * Types
  */
@@ -55,6 +64,16 @@ struct cmd_help{
 /* CLIgen event register callback type */
 typedef int (cligen_fd_cb_t)(int, void*);
 
+/* Output filters of stdout, see cligen_output_filter_add */
+enum cligen_filter{
+    CLIGEN_FILTER_INCLUDE, /* Lines matching regexp */
+    CLIGEN_FILTER_EXCLUDE, /* Lines not matching regexp */
+    CLIGEN_FILTER_BEGIN,   /* Lines from first line matching regexp */
+    CLIGEN_FILTER_COUNT,   /* Number of lines instead of lines */
+};
+
+struct cligen_ostream; /* Output stream of a handle, see cligen_output */
+
 /*
  * Prototypes
  */
@@ -65,13 +84,23 @@ int  cligen_output(FILE *f, const char *templ, ... ) __attribute__ ((format (pri
 #else
 int  cligen_output(FILE *f, const char *templ, ... );
 #endif
+int  cligen_output_cbuf(FILE *f, cbuf *cb);
+int  cligen_output_flush(cligen_handle h);
+int  cligen_output_begin(cligen_handle h);
+int  cligen_output_end(cligen_handle h);
+int  cligen_output_filter_add(cligen_handle h, enum cligen_filter type, char *regexp);
+int  cligen_output_filter_reset(cligen_handle h);
+int  cligen_ostream_free(struct cligen_ostream *os);
 int  cligen_regfd(int fd, cligen_fd_cb_t *cb, void *arg);
 int  cligen_unregfd(int fd);
+int  cligen_regfd_write(int fd, cligen_fd_cb_t *cb, void *arg);
+int  cligen_unregfd_write(int fd);
 void cligen_redraw(cligen_handle h);
 int  cligen_susp_hook(cligen_handle h, cligen_susp_cb_t *fn);
 int  cligen_interrupt_hook(cligen_handle h, cligen_interrupt_cb_t *fn);
 void cligen_exitchar_add(cligen_handle h, char c);
 int  print_help_lines(cligen_handle h, FILE *fout, parse_tree *ptmatch, int *matchvec, size_t matchlen);
+int  print_help_columns(cligen_handle h, FILE *fout, parse_tree *ptmatch, int *matchvec, size_t matchlen);
 int  cligen_help(cligen_handle h, FILE *f, parse_tree *pt);
 
 #endif /* _CLIGEN_IO_H_ */
@@ -64,12 +64,29 @@
 #include "cligen_expand.h"
 #include "cligen_read.h"
 #include "cligen_match.h"
+#include "cligen_stats.h"
+#include "cligen_registry.h"
 
 #ifndef MIN
 #define MIN(x,y) ((x)<(y)?(x):(y))
 #endif
 
-#define ISREST(co) ((co)->co_type == CO_VARIABLE && (co)->co_vtype == CGV_REST)
+/* Match metadata is used if valid, see co_meta_set */
+#define ISREST(co) (((co)->co_flags & CO_FLAGS_META) ?			\
+		    ((co)->co_flags & CO_FLAGS_REST) != 0 :		\
+		    ((co)->co_type == CO_VARIABLE && (co)->co_vtype == CGV_REST))
+
+/* Length of command of an object, including escape '"' */
+#define CO_CMDLEN(co) (((co)->co_flags & CO_FLAGS_META) ?		\
+		       (co)->co_mlen + (*(co)->co_command == '\"') :	\
+		       strlen((co)->co_command))
+
+/* Already matched objects of a set, a bitset indexed by position in the parse-tree
+ * owned by the caller iterating over the set, see match_pattern_sets. 
+ * Sets with up to MATCH_SET_WORDS*64 objects use a bitset on the stack */
+#define MATCH_SET_WORDS 4
+#define match_set_get(ms, i) ((ms) != NULL && ((ms)[(i)/64] & ((uint64_t)1 << ((i)%64))))
+#define match_set_add(ms, i) do {if (ms) (ms)[(i)/64] |= (uint64_t)1 << ((i)%64);} while (0)
 
 /*! Result vector from match_pattern_* family of functions
  */
@@ -82,9 +99,381 @@ struct match_result{
     int          mr_last;
     char        *mr_reason; /* Error reason if mr_len=0. Can also be carried by a mr_len!=0 
 			     * to store first error in case it is needed in a later error */
+    cg_obj      *mr_reason_co;    /* Deferred reason: variable that did not match token, */
+    char        *mr_reason_token; /* formatted only if needed, see mr_reason_get */
 };
 typedef struct match_result match_result;
 
+/*! Saved match state of a line, the path up to the last token, see match_state_resume
+ */
+struct match_state{
+    int          ms_gen;    /* Generation of handle when saved */
+    cg_obj      *ms_top;    /* Original of first object of top-level tree */
+    int          ms_toplen; /* Length of top-level tree */
+    int          ms_level;  /* Last level, ie number of preceding tokens */
+    char       **ms_tokens; /* Preceding tokens */
+    cg_obj      *ms_anchor; /* Original object matched before last level */
+    parse_tree  *ms_ptc;    /* Its (original) children, expanded to match last level */
+    cvec        *ms_cvv;    /* Variables bound before last level */
+    int          ms_vlen;   /* Number of original objects with values set before last level */
+    cg_obj     **ms_vobj;   /* Original objects with values */
+    char       **ms_vstr;   /* Values of ms_vobj */
+};
+typedef struct match_state match_state;
+
+/*! Memoized match of a token with a variable, see match_memo_find
+ */
+struct match_memo_entry{
+    cg_varspec  *me_cs;     /* Variable spec, identity */
+    char        *me_name;   /* Variable name, part of reason */
+    char        *me_str;    /* Token, copied */
+    uint32_t     me_hash;   /* Hash of spec and token */
+    int          me_match;  /* 0: not match, 1: match */
+    char        *me_reason; /* Reason if not match, or NULL if not asked for */
+    cg_var      *me_cv;     /* Parsed and validated value if match */
+};
+typedef struct match_memo_entry match_memo_entry;
+
+/*! Memo of variable matches of a line, reset on each new line, see cligen_line_begin
+ *
+ * A token is matched with the same variable several times in a line: once per
+ * alternative level tried, again when binding it, and for each preceding token
+ * when completing. Parse and validation results are kept here for the line.
+ */
+struct match_memo{
+    match_memo_entry *mm_vec;   /* Entries */
+    int               mm_len;
+    int               mm_max;
+    int32_t          *mm_index; /* Open addressing index of mm_vec, -1 if empty slot */
+    int               mm_slots; /* Power of two, at least twice mm_max */
+};
+typedef struct match_memo match_memo;
+
+/*! Capture of match state during a match of the whole line
+ */
+struct match_capture{
+    int          mc_bad;    /* Path cannot be resumed: sets or optional continuation */
+    int          mc_cvvlen; /* Length of cvv on entry */
+    int          mc_vlen;   /* Original objects with values so far */
+    cg_obj     **mc_vobj;
+    match_state *mc_state;  /* Captured state when last level is reached */
+};
+typedef struct match_capture match_capture;
+
+/*! Reusable buffers of parsing lines, kept between lines, see cligen_parse_ctx_get
+ *
+ * Match results and variable vectors are taken from here and given back after use,
+ * keeping their allocated space, so that parsing a stream of lines reaches a steady
+ * state without allocating them.
+ */
+struct cligen_parse_ctx{
+    match_result *pc_mr[CLIGEN_PARSE_CTX_MAX];  /* Free match results, with mr_vec */
+    int           pc_mrlen;
+    cvec         *pc_cvv[CLIGEN_PARSE_CTX_MAX]; /* Free variable vectors, empty */
+    int           pc_cvvlen;
+    uint64_t      pc_reused;    /* Buffers taken from context */
+    uint64_t      pc_allocated; /* Buffers allocated since context was empty */
+};
+
+/*! Create a memo of variable matches
+ * @retval  mm    Memo, free with match_memo_free
+ * @retval  NULL  Error
+ */
+void *
+match_memo_new(void)
+{
+    match_memo *mm;
+
+    if ((mm = malloc(sizeof(*mm))) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	return NULL;
+    }
+    memset(mm, 0, sizeof(*mm));
+    return mm;
+}
+
+/*! Remove all entries of a memo of variable matches, keep allocated space
+ * @param[in]  arg   Memo
+ */
+int
+match_memo_reset(void *arg)
+{
+    match_memo       *mm = (match_memo *)arg;
+    match_memo_entry *me;
+    int               i;
+
+    if (mm == NULL || mm->mm_len == 0)
+	return 0;
+    for (i=0; i<mm->mm_len; i++){
+	me = &mm->mm_vec[i];
+	free(me->me_str);
+	if (me->me_reason)
+	    free(me->me_reason);
+	if (me->me_cv)
+	    cv_free(me->me_cv);
+    }
+    mm->mm_len = 0;
+    memset(mm->mm_index, 0xff, mm->mm_slots*sizeof(int32_t));
+    return 0;
+}
+
+/*! Free a memo of variable matches
+ * @param[in]  arg   Memo
+ */
+int
+match_memo_free(void *arg)
+{
+    match_memo *mm = (match_memo *)arg;
+
+    if (mm == NULL)
+	return 0;
+    match_memo_reset(mm);
+    if (mm->mm_vec)
+	free(mm->mm_vec);
+    if (mm->mm_index)
+	free(mm->mm_index);
+    free(mm);
+    return 0;
+}
+
+/*! Create a parse context, see cligen_parse_ctx_get for the context of a handle
+ * @retval  pc    Parse context, free with cligen_parse_ctx_free
+ * @retval  NULL  Error
+ */
+cligen_parse_ctx *
+cligen_parse_ctx_new(void)
+{
+    cligen_parse_ctx *pc;
+
+    if ((pc = malloc(sizeof(*pc))) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	return NULL;
+    }
+    memset(pc, 0, sizeof(*pc));
+    return pc;
+}
+
+/*! Free the buffers kept by a parse context, eg after parsing an unusually long line
+ * @param[in]  pc   Parse context
+ * @retval     0    OK
+ */
+int
+cligen_parse_ctx_trim(cligen_parse_ctx *pc)
+{
+    match_result *mr;
+
+    if (pc == NULL)
+	return 0;
+    while (pc->pc_mrlen){
+	mr = pc->pc_mr[--pc->pc_mrlen];
+	if (mr->mr_vec)
+	    free(mr->mr_vec);
+	free(mr);
+    }
+    while (pc->pc_cvvlen)
+	cvec_free(pc->pc_cvv[--pc->pc_cvvlen]);
+    return 0;
+}
+
+/*! Free a parse context and its buffers
+ * @param[in]  pc   Parse context
+ * @retval     0    OK
+ */
+int
+cligen_parse_ctx_free(cligen_parse_ctx *pc)
+{
+    if (pc == NULL)
+	return 0;
+    cligen_parse_ctx_trim(pc);
+    free(pc);
+    return 0;
+}
+
+/*! Get number of buffers reused from and allocated by a parse context
+ *
+ * In steady state, eg parsing a stream of similar lines, only reused grows.
+ * @param[in]  pc         Parse context
+ * @param[out] reused     Buffers taken from context
+ * @param[out] allocated  Buffers allocated since context was empty
+ * @retval     0          OK
+ */
+int
+cligen_parse_ctx_stats(cligen_parse_ctx *pc,
+		       uint64_t         *reused,
+		       uint64_t         *allocated)
+{
+    if (reused)
+	*reused = pc?pc->pc_reused:0;
+    if (allocated)
+	*allocated = pc?pc->pc_allocated:0;
+    return 0;
+}
+
+/*! Get an empty variable vector, reused from the parse context of the handle
+ *
+ * Use instead of cvec_new(0) for the variable vector of cliread_parse in a loop.
+ * @param[in]  h     CLIgen handle
+ * @retval     cvv   Empty variable vector, give back with cligen_parse_cvec_put
+ * @retval     NULL  Error
+ */
+cvec *
+cligen_parse_cvec_get(cligen_handle h)
+{
+    cligen_parse_ctx *pc;
+
+    if ((pc = cligen_parse_ctx_get(h)) != NULL && pc->pc_cvvlen){
+	pc->pc_reused++;
+	return pc->pc_cvv[--pc->pc_cvvlen];
+    }
+    if (pc)
+	pc->pc_allocated++;
+    return cvec_new(0);
+}
+
+/*! Give back a variable vector to the parse context of the handle
+ *
+ * The variables are reset and the allocated space is kept for the next line. A vector
+ * is freed if the context is full.
+ * @param[in]  h     CLIgen handle
+ * @param[in]  cvv   Variable vector, eg from cligen_parse_cvec_get
+ * @retval     0     OK
+ */
+int
+cligen_parse_cvec_put(cligen_handle h,
+		      cvec         *cvv)
+{
+    cligen_parse_ctx *pc;
+
+    if (cvv == NULL)
+	return 0;
+    if ((pc = cligen_parse_ctx_get(h)) != NULL && pc->pc_cvvlen < CLIGEN_PARSE_CTX_MAX){
+	cvec_clear(cvv);
+	pc->pc_cvv[pc->pc_cvvlen++] = cvv;
+	return 0;
+    }
+    return cvec_free(cvv);
+}
+
+/*! Variable spec of a variable, shallow objects share the spec of the original
+ */
+static cg_varspec *
+match_varspec(cg_obj *co)
+{
+    if (co_flags_get(co, CO_FLAGS_SHALLOW) && co->co_ref)
+	return co2varspec(co->co_ref);
+    return co2varspec(co);
+}
+
+/*! Hash of a variable spec and a token, FNV-1a
+ */
+static uint32_t
+match_memo_hash(cg_varspec *cs,
+		char       *str)
+{
+    uint32_t  h = 2166136261u;
+    uintptr_t p = (uintptr_t)cs;
+
+    for (; *str; str++)
+	h = (h ^ (uint8_t)*str) * 16777619u;
+    return h ^ (uint32_t)(p >> 4) ^ (uint32_t)((uint64_t)p >> 32);
+}
+
+/*! Find memoized match of a token with a variable in a line
+ * @param[in]  mm    Memo
+ * @param[in]  cs    Variable spec
+ * @param[in]  name  Variable name
+ * @param[in]  str   Token
+ * @param[in]  hash  Hash of cs and str, see match_memo_hash
+ * @retval     me    Entry
+ * @retval     NULL  Not found
+ */
+static match_memo_entry *
+match_memo_find(match_memo *mm,
+		cg_varspec *cs,
+		char       *name,
+		char       *str,
+		uint32_t    hash)
+{
+    match_memo_entry *me;
+    int32_t           j;
+
+    if (mm->mm_len == 0)
+	return NULL;
+    for (j = hash & (mm->mm_slots-1); mm->mm_index[j] != -1; j = (j+1) & (mm->mm_slots-1)){
+	me = &mm->mm_vec[mm->mm_index[j]];
+	if (me->me_hash == hash && me->me_cs == cs && strcmp(me->me_str, str) == 0 &&
+	    (me->me_name == name ||
+	     (me->me_name && name && strcmp(me->me_name, name) == 0)))
+	    return me;
+    }
+    return NULL;
+}
+
+/*! Add a match of a token with a variable to the memo of a line
+ * @param[in]  mm     Memo
+ * @param[in]  cs     Variable spec
+ * @param[in]  name   Variable name
+ * @param[in]  str    Token, copied
+ * @param[in]  hash   Hash of cs and str, see match_memo_hash
+ * @param[in]  match  0: not match, 1: match
+ * @param[in]  reason Reason if not match, copied, or NULL
+ * @param[in]  cv     Parsed value if match, copied
+ * @retval     0      OK
+ * @retval    -1      Error
+ */
+static int
+match_memo_add(match_memo *mm,
+	       cg_varspec *cs,
+	       char       *name,
+	       char       *str,
+	       uint32_t    hash,
+	       int         match,
+	       char       *reason,
+	       cg_var     *cv)
+{
+    match_memo_entry *me;
+    int32_t           j;
+    int               i;
+    int               max;
+
+    if (mm->mm_len == mm->mm_max){
+	max = mm->mm_max ? 2*mm->mm_max : 16;
+	if ((mm->mm_vec = realloc(mm->mm_vec, max*sizeof(*me))) == NULL ||
+	    (mm->mm_index = realloc(mm->mm_index, 2*max*sizeof(int32_t))) == NULL){
+	    fprintf(stderr, "%s: realloc: %s\n", __FUNCTION__, strerror(errno));
+	    return -1;
+	}
+	mm->mm_max = max;
+	mm->mm_slots = 2*max;
+	memset(mm->mm_index, 0xff, mm->mm_slots*sizeof(int32_t));
+	for (i=0; i<mm->mm_len; i++){
+	    for (j = mm->mm_vec[i].me_hash & (mm->mm_slots-1); mm->mm_index[j] != -1;
+		 j = (j+1) & (mm->mm_slots-1))
+		;
+	    mm->mm_index[j] = i;
+	}
+    }
+    me = &mm->mm_vec[mm->mm_len];
+    memset(me, 0, sizeof(*me));
+    me->me_cs = cs;
+    me->me_name = name;
+    me->me_hash = hash;
+    me->me_match = match;
+    if ((me->me_str = strdup(str)) == NULL ||
+	(reason && (me->me_reason = strdup(reason)) == NULL) ||
+	(cv && (me->me_cv = cv_dup(cv)) == NULL)){
+	if (me->me_str)
+	    free(me->me_str);
+	if (me->me_reason)
+	    free(me->me_reason);
+	return -1;
+    }
+    for (j = hash & (mm->mm_slots-1); mm->mm_index[j] != -1; j = (j+1) & (mm->mm_slots-1))
+	;
+    mm->mm_index[j] = mm->mm_len++;
+    return 0;
+}
+
 /*! Match variable against input string
  * 
  * @param[in]  string  Input string to match
@@ -97,31 +486,68 @@ typedef struct match_result match_result;
  * Who prints errors?
  * @see cvec_match where actual allocation of variables is made not only sanity
  */
-static int
+int
 match_variable(cligen_handle h,
 	       cg_obj       *co, 
 	       char         *str, 
 	       char        **reason)
 {
-    int         retval = -1;
-    cg_var     *cv; /* Just a temporary cv for validation */
-    cg_varspec *cs;
+    int               retval = -1;
+    cg_var           *cv; /* Just a temporary cv for validation, owned by handle */
+    cg_varspec       *cs;
+    uint64_t          t0;
+    match_memo       *mm;
+    match_memo_entry *me = NULL;
+    uint32_t          hash = 0;
 
-    cs = &co->u.cou_var;
-    if ((cv = cv_new(co->co_vtype)) == NULL)
+    /* Shallow objects share the variable spec (and its regexp cache) with the original */
+    cs = match_varspec(co);
+    /* Same token and variable earlier in this line */
+    if (str && (mm = cligen_match_memo_get(h)) != NULL){
+	hash = match_memo_hash(cs, str);
+	if ((me = match_memo_find(mm, cs, co->co_command, str, hash)) != NULL){
+	    if (me->me_match == 1)
+		return 1;
+	    if (reason == NULL)
+		return 0;
+	    if (me->me_reason){
+		if ((*reason = strdup(me->me_reason)) == NULL)
+		    return -1;
+		return 0;
+	    }
+	    /* Reason not formatted before, match again */
+	}
+    }
+    else
+	mm = NULL;
+    if ((cv = cligen_scratch_cv(h, co->co_vtype)) == NULL)
 	goto done;
     if (co->co_vtype == CGV_DEC64) /* XXX: Seems misplaced? / too specific */
 	cv_dec64_n_set(cv, cs->cgs_dec64_n);
-    if ((retval = cv_parse1(str, cv, reason)) <= 0) 
+    t0 = cligen_stats_start(h);
+    retval = cv_parse1(str, cv, reason);
+    cligen_stats_stop(h, CLIGEN_STAT_PARSE, t0);
+    if (retval <= 0) 
 	goto done;
     /* here retval should be 1 */
     /* Validate value */
-    if ((retval = cv_validate(h, cv, cs, co->co_command, reason)) <= 0)
+    t0 = cligen_stats_start(h);
+    retval = cv_validate(h, cv, cs, co->co_command, reason);
+    cligen_stats_stop(h, CLIGEN_STAT_VALIDATE, t0);
+    if (retval <= 0)
 	goto done;
     /* here retval should be 1 */
   done:
-    if (cv)
-	cv_free(cv);
+    if (mm && retval >= 0){
+	if (me != NULL){ /* Add reason to entry */
+	    if (reason && *reason && (me->me_reason = strdup(*reason)) == NULL)
+		return -1;
+	}
+	else if (match_memo_add(mm, cs, co->co_command, str, hash, retval,
+				(retval == 0 && reason) ? *reason : NULL,
+				retval == 1 ? cv : NULL) < 0)
+	    return -1;
+    }
     return retval; 
 }
 
@@ -163,12 +589,12 @@ match_object(cligen_handle h,
 	  if (best && *co->co_command == '\"'){ /* escaped */
 	      match = (strncmp(co->co_command+1, str, len) == 0);
 	      if (exact)
-		  *exact = strlen(co->co_command+1) == len;
+		  *exact = CO_CMDLEN(co) - 1 == len;
 	  }
 	  else{
 	      match = (strncmp(co->co_command, str, len) == 0);
 	      if (exact)
-		  *exact = strlen(co->co_command) == len;
+		  *exact = CO_CMDLEN(co) == len;
 	  }
 	  if (match == 0 && reason){
 	      if ((*reason = strdup("Unknown command")) == NULL)
@@ -205,103 +631,222 @@ match_object(cligen_handle h,
       return 1;
 }
 
-/*! Given a string (s0), return the next token. 
- * The string is modified to return
- * the remainder of the string after the identified token.
+/*! Free a token vector
+ * @param[in]  tk   Token vector, see cligen_str2tokens
+ * @see cligen_tokens_release  Return it to the handle for reuse instead
+ */
+int
+cligen_tokens_free(cligen_tokens *tk)
+{
+    if (tk == NULL)
+	return 0;
+    if (tk->tk_vec)
+	free(tk->tk_vec);
+    if (tk->tk_buf)
+	free(tk->tk_buf);
+    free(tk);
+    return 0;
+}
+
+/*! Add a token span to a token vector
+ */
+static int
+tokens_add(cligen_tokens *tk,
+	   char          *st,
+	   size_t         len,
+	   char          *rest,
+	   int            quoted,
+	   char         **bufp)
+{
+    cligen_token *ct;
+    size_t        max;
+
+    if (tk->tk_len == tk->tk_max){
+	max = tk->tk_max?tk->tk_max*2:CLIGEN_TOKENS_MIN;
+	if ((ct = realloc(tk->tk_vec, max*sizeof(*ct))) == NULL){
+	    fprintf(stderr, "%s: realloc: %s\n", __FUNCTION__, strerror(errno));
+	    return -1;
+	}
+	tk->tk_vec = ct;
+	tk->tk_max = max;
+    }
+    ct = &tk->tk_vec[tk->tk_len++];
+    ct->ct_off = st - tk->tk_string;
+    ct->ct_len = len;
+    ct->ct_quoted = quoted;
+    ct->ct_rest = rest;
+    /* Tokens are copied after each other in one buffer */
+    ct->ct_str = *bufp;
+    memcpy(*bufp, st, len);
+    (*bufp)[len] = '\0';
+    *bufp += len + 1;
+    return 0;
+}
+
+/*! Split a string into token spans, the token vector is reused
+ *
  * A token is found either as characters delimited by one or many delimiters.
  * Or as a pair of double-quotes(") with any characters in between.
- * if there are trailing spaces after the token, trail is set to one.
- * If string is NULL or "", NULL is returned.
- * If empty token found, s0 is NULL
- * @param[in]  s0       String, the string is modified like strtok
- * @param[out] token0   A malloced token.  NOTE: token must be freed after use.
- * @param[out] rest0    A remaining (rest) string.  NOTE: NOT malloced.
- * @param[out] leading0 If leading delimiters eg " thisisatoken"
- * Example:
- *   s0 = "  foo bar"
- * results in token="foo", leading=1
+ * If the string is empty or ends with delimiters, an empty "" token is added last.
+ * @param[in]  tk      Token vector, previous tokens are replaced
+ * @param[in]  string  String to split, not modified or copied
  */
 static int
-next_token(char **s0, 
-	   char **token0,
-	   char **rest0, 
-	   int   *leading0)
+tokens_split(cligen_tokens *tk,
+	     char          *string)
 {
+    size_t len;
     char  *s;
     char  *st;
-    char  *token = NULL;
-    size_t len;
-    int    quote=0;
-    int    leading=0;
-    int    escape = 0;
+    char  *rest;
+    char  *buf;
+    int    quote;
+    int    leading;
+    int    escape;
 
-    s = *s0;
-    if (s==NULL){
-	fprintf(stderr, "%s: null string\n", __FUNCTION__);
-	return -1;
-    }
-    for (s=*s0; *s; s++){ /* First iterate through delimiters */
-	if (index(CLIGEN_DELIMITERS, *s) == NULL)
-	    break;
-	leading++;
-    }
-    if (rest0)
-	*rest0 = s;
-    if (*s && index(CLIGEN_QUOTES, *s) != NULL){
-	quote++;
-	s++;
+    tk->tk_string = string;
+    tk->tk_len = 0;
+    /* All tokens and their NULs fit in twice the string */
+    len = 2*strlen(string) + 2;
+    if (tk->tk_buflen < len){
+	if ((buf = realloc(tk->tk_buf, len)) == NULL){
+	    fprintf(stderr, "%s: realloc: %s\n", __FUNCTION__, strerror(errno));
+	    return -1;
+	}
+	tk->tk_buf = buf;
+	tk->tk_buflen = len;
     }
-    st=s; /* token starts */
-    escape = 0;
-    for (; *s; s++){ /* Then find token */
-	if (quote){
-	    if (index(CLIGEN_QUOTES, *s) != NULL)
+    buf = tk->tk_buf;
+    s = string;
+    while (1){
+	leading = 0;
+	for (; *s; s++){ /* First iterate through delimiters */
+	    if (index(CLIGEN_DELIMITERS, *s) == NULL)
 		break;
+	    leading++;
 	}
-	else{ /* backspace tokens for escaping delimiters */
-	    if (escape)
-		escape = 0;
-	    else{
-		if (*s == '\\')
-		    escape++;
-		else
-		    if (index(CLIGEN_DELIMITERS, *s) != NULL)
-			break;
+	rest = s;
+	quote = 0;
+	if (*s && index(CLIGEN_QUOTES, *s) != NULL){
+	    quote++;
+	    s++;
+	}
+	st = s; /* token starts */
+	escape = 0;
+	for (; *s; s++){ /* Then find token */
+	    if (quote){
+		if (index(CLIGEN_QUOTES, *s) != NULL)
+		    break;
+	    }
+	    else{ /* backspace tokens for escaping delimiters */
+		if (escape)
+		    escape = 0;
+		else{
+		    if (*s == '\\')
+			escape++;
+		    else
+			if (index(CLIGEN_DELIMITERS, *s) != NULL)
+			    break;
+		}
 	    }
 	}
-    }
-    if (quote && *s){
-	s++;
-	// fprintf(stderr, "s=\"%s\" %d %s\n", s, *s, index(CLIGEN_DELIMITERS, *s));
-	if (*s && index(CLIGEN_DELIMITERS, *s) == NULL){
-	    ;//	cligen_reason("Quote token error");
+	if (quote && *s){ /* Closing quote */
+	    s++;
+	    len = (s-st)-1;
 	}
-	len = (s-st)-1;
-    }
-    else{
-	if (quote){ /* Here we signalled error before but it is removed */
-	    st--;
+	else{
+	    if (quote) /* No closing quote: the quote is part of the token */
+		st--;
+	    quote = 0;
+	    len = (s-st);
 	}
-	len = (s-st);
-	if (!len){
-	    token = NULL;
-	    *s0 = NULL;
-	    goto done;
+	if (len == 0 && !quote){ /* No token */
+	    /* Stop, unless it is the initial token (empty string) OR there are trailing
+	     * delimiters. In these cases insert an empty "" token. */
+	    if (leading || tk->tk_len == 0)
+		if (tokens_add(tk, st, 0, rest, 0, &buf) < 0)
+		    return -1;
+	    break;
 	}
+	if (tokens_add(tk, st, len, rest, quote, &buf) < 0)
+	    return -1;
     }
-    if ((token=malloc(len+1)) == NULL){
-	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+    return 0;
+}
+
+/*! Split a CLIgen command string into token spans
+ *
+ * The token vector is taken from the handle if available, and should be given back with
+ * cligen_tokens_release. It refers to string but does not copy it, so string may not be
+ * changed or freed while the tokens are used.
+ * @param[in]  h       CLIgen handle
+ * @param[in]  string  String to split
+ * @param[out] tkp     Token vector
+ * @retval     0       OK
+ * @retval    -1       Error
+ * @code
+ *   cligen_tokens *tk = NULL;
+ *   if (cligen_str2tokens(h, "aa bb cc", &tk) < 0)
+ *     err;
+ *   ...
+ *   cligen_tokens_release(h, tk);
+ * @endcode
+ * Example, input string "aa  \"b b\" cc"
+ *   ct_str  : ["aa", "b b", "cc"]
+ *   ct_rest : ["aa  \"b b\" cc", "\"b b\" cc", "cc"]
+ *   ct_off  : [0, 5, 10]
+ *   ct_len  : [2, 3, 2]
+ * @see cligen_str2cvv  With a copy of all tokens and rests in cligen variable vectors
+ */
+int
+cligen_str2tokens(cligen_handle   h,
+		  char           *string,
+		  cligen_tokens **tkp)
+{
+    cligen_tokens *tk;
+
+    if (string == NULL || tkp == NULL){
+	errno = EINVAL;
 	return -1;
     }
-    memcpy(token, st, len);
-    token[len] = '\0';
-    *s0 = s;
- done:
-    *leading0 = leading;
-    *token0 = token;
+    if ((tk = cligen_tokens_cache_get(h)) == NULL){
+	if ((tk = malloc(sizeof(*tk))) == NULL){
+	    fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	    return -1;
+	}
+	memset(tk, 0, sizeof(*tk));
+    }
+    if (tokens_split(tk, string) < 0){
+	cligen_tokens_free(tk);
+	return -1;
+    }
+    *tkp = tk;
     return 0;
 }
 
+/*! Give back a token vector to the handle to be reused by the next line
+ * @param[in]  h     CLIgen handle
+ * @param[in]  tk    Token vector, see cligen_str2tokens
+ */
+int
+cligen_tokens_release(cligen_handle  h,
+		      cligen_tokens *tk)
+{
+    if (tk == NULL)
+	return 0;
+    return cligen_tokens_cache_put(h, tk);
+}
+
+/*! Number of levels of a token vector, ie number of tokens - 1
+ * @param[in]  tk    Token vector
+ * @see cligen_cvv_levels
+ */
+int
+cligen_tokens_levels(cligen_tokens *tk)
+{
+    return tk->tk_len - 1;
+}
+
 /*! Split a CLIgen command string into a cligen variable vector using delimeters and escape quotes
  *
  * @param[in]  string String to split
@@ -322,55 +867,48 @@ next_token(char **s0,
  *   cvp : ["aa bb cc", "aa", "bb", "cc"]
  *   cvr : ["aa bb cc", "aa bb cc", "bb cc", "cc"]
  * @note both out cvv:s should be freed with cvec_free()
+ * @note The rest vector has a copy of the string at every position, see cligen_str2tokens
+ *       for spans that refer to the original string
  */
 int
 cligen_str2cvv(char  *string, 
 	       cvec **cvtp,
     	       cvec **cvrp)
 {
-    int     retval = -1;
-    char   *s;
-    char   *sr;
-    char   *s0 = NULL;;
-    cvec   *cvt = NULL; /* token vector */
-    cvec   *cvr = NULL; /* rest vector */
-    cg_var *cv;
-    char   *t;
-    int     trail;
-    int     i;
+    int            retval = -1;
+    cligen_tokens  tk = {0,};
+    cvec          *cvt = NULL; /* token vector */
+    cvec          *cvr = NULL; /* rest vector */
+    cg_var        *cv;
+    int            i;
 
-    if ((s0 = strdup(string)) == NULL)
+    if (tokens_split(&tk, string) < 0)
 	goto done;
-    s = s0;
-    if ((cvt = cvec_start(string)) ==NULL)
+    if ((cvt = cvec_new(tk.tk_len+1)) == NULL ||
+	(cvr = cvec_new(tk.tk_len+1)) == NULL)
 	goto done;
-    if ((cvr = cvec_start(string)) ==NULL)
-	goto done;
-    i = 0;
-    while (s != NULL) {
-	if (next_token(&s, &t, &sr, &trail) < 0)
-	    goto done;
-	/* If there is no token, stop, 
-	 * unless it is the intial token (empty string) OR there are trailing whitespace
-	 * In these cases insert an empty "" token.
-	 */
-	if (t == NULL && !trail && i > 0)
-	    break;
-	if ((cv = cvec_add(cvr, CGV_STRING)) == NULL)
-	    goto done;
-	if (cv_string_set(cv, sr?sr:"") == NULL) /* XXX memleak */
-	    goto done;
-	if ((cv = cvec_add(cvt, CGV_STRING)) == NULL)
+    for (i=0; i<=tk.tk_len; i++){
+	cv = cvec_i(cvt, i);
+	if (i == 0){ /* Whole string, see cvec_start */
+	    cv_type_set(cv, CGV_REST);
+	    if (cv_name_set(cv, "cmd") == NULL ||
+		cv_string_set(cv, string) == NULL)
+		goto done;
+	    cv = cvec_i(cvr, i);
+	    cv_type_set(cv, CGV_REST);
+	    if (cv_name_set(cv, "cmd") == NULL ||
+		cv_string_set(cv, string) == NULL)
+		goto done;
+	    continue;
+	}
+	cv_type_set(cv, CGV_STRING);
+	if (cv_string_set(cv, tk.tk_vec[i-1].ct_str) == NULL)
 	    goto done;
-	if (cv_string_set(cv, t?t:"") == NULL) /* XXX memleak */
+	cv = cvec_i(cvr, i);
+	cv_type_set(cv, CGV_STRING);
+	if (cv_string_set(cv, tk.tk_vec[i-1].ct_rest) == NULL)
 	    goto done;
-	if (t)
-	    free(t);
-	i++;
     }
-    retval = 0;
-    assert(cvec_len(cvt)>1); /* XXX */
-    assert(cvec_len(cvr)>1); /* XXX */
     if (cvtp){
 	*cvtp = cvt;
 	cvt = NULL;
@@ -379,9 +917,12 @@ cligen_str2cvv(char  *string,
 	*cvrp = cvr;
 	cvr = NULL;
     }
+    retval = 0;
  done:
-    if (s0)
-	free(s0);
+    if (tk.tk_vec)
+	free(tk.tk_vec);
+    if (tk.tk_buf)
+	free(tk.tk_buf);
     if (cvt)
 	cvec_free(cvt);
     if (cvr)
@@ -486,13 +1027,10 @@ cligen_cvv_levels(cvec *cvv)
 /*! Termination criterium foir command string
  */
 static int
-last_level(cvec *cvt,
-	   int   level)
+last_level(cligen_tokens *tk,
+	   int            level)
 {
-    int levels;
-    
-    assert((levels = cligen_cvv_levels(cvt)) >= 0);
-    if (level >= levels)
+    if (level >= cligen_tokens_levels(tk))
 	return 1;
     return 0;
 }
@@ -559,27 +1097,44 @@ pt_onlyvars(parse_tree *pt)
  * @retval     NULL   Error
  * XXX see cvec_match
  */
-static cg_var *
+cg_var *
 add_cov_to_cvec(cligen_handle h,
 		cg_obj       *co, 
 		char         *cmd, 
 		cvec         *cvv)
 {
-    cg_var *cv = NULL;
+    cg_var           *cv = NULL;
+    match_memo       *mm;
+    match_memo_entry *me = NULL;
+    cg_varspec       *cs;
 
-    if ((cv = cvec_add(cvv, co->co_vtype)) == NULL)
-	return NULL;
-    cv_name_set(cv, co->co_command);
-    if (co->co_vtype == CGV_DEC64) /* XXX: Seems misplaced? / too specific */
-	cv_dec64_n_set(cv, co->co_dec64_n);
-    if (cv_parse(cmd, cv) < 0) {
-	cv_reset(cv);
-	cvec_del(cvv, cv);
-	return NULL;
+    /* Value parsed when the token was matched with the variable */
+    if (cmd && (mm = cligen_match_memo_get(h)) != NULL){
+	cs = match_varspec(co);
+	me = match_memo_find(mm, cs, co->co_command, cmd, match_memo_hash(cs, cmd));
+    }
+    if (me && me->me_cv){
+	if ((cv = cvec_append_var(cvv, me->me_cv)) == NULL)
+	    return NULL;
+	cv_name_set(cv, co->co_command);
+    }
+    else {
+	if ((cv = cvec_add(cvv, co->co_vtype)) == NULL)
+	    return NULL;
+	cv_name_set(cv, co->co_command);
+	if (co->co_vtype == CGV_DEC64) /* XXX: Seems misplaced? / too specific */
+	    cv_dec64_n_set(cv, co->co_dec64_n);
+	if (cv_parse(cmd, cv) < 0) {
+	    cv_reset(cv);
+	    cvec_del(cvv, cv);
+	    return NULL;
+	}
     }
     //    if (co->co_show)
     //	cv->var_show = strdup4(co->co_show);
     /* If translator function defined, here translate value */
+    if (co->co_translate_fn == NULL && co->co_translate_fn_str != NULL)
+	co->co_translate_fn = (translate_cb_t*)cligen_fn_lookup(h, CLIGEN_FN_TRANSLATE, co->co_translate_fn_str);
     if (co->co_translate_fn != NULL &&
 	co->co_translate_fn(h, cv) < 0)
 	return NULL;
@@ -592,14 +1147,16 @@ static int
 mr_vec_append(match_result *mr,
 	      int           index)
 {
-    int retval = -1;
+    int      retval = -1;
+    uint32_t size;
 
     if (mr->mr_size <= mr->mr_len){ /* need increased size */
-	if ((mr->mr_vec = realloc(mr->mr_vec, (mr->mr_len+1)*sizeof(int))) == NULL)
+	size = mr->mr_size?2*mr->mr_size:CLIGEN_MATCH_VEC_MIN;
+	if ((mr->mr_vec = realloc(mr->mr_vec, size*sizeof(int))) == NULL)
 	    goto done;
+	mr->mr_size = size;
     }
     mr->mr_vec[mr->mr_len++] = index;
-    mr->mr_size = mr->mr_len;
     retval = 0;
  done:
     return retval;
@@ -627,6 +1184,59 @@ mr_reason_set(match_result *mr,
     if (mr->mr_reason)
 	free(mr->mr_reason);
     mr->mr_reason = reason;
+    mr->mr_reason_co = NULL;
+    mr->mr_reason_token = NULL;
+    return 0;
+}
+
+/*! Set a deferred error reason: variable co did not match token
+ *
+ * The reason string is not formatted here, since almost all candidate reasons are
+ * discarded. It is formatted by mr_reason_get by matching again, if needed.
+ * @param[in,out]  mr      Match result struct
+ * @param[in]      co      Variable object, must be valid until mr_reason_get
+ * @param[in]      token   Token, must be valid until mr_reason_get
+ */
+static int
+mr_reason_defer(match_result *mr,
+		cg_obj       *co,
+		char         *token)
+{
+    mr_reason_set(mr, NULL);
+    mr->mr_reason_co = co;
+    mr->mr_reason_token = token;
+    return 0;
+}
+
+/*! Return 1 if match result has an error reason, formatted or deferred */
+static int
+mr_reason_exists(match_result *mr)
+{
+    return mr->mr_reason != NULL || mr->mr_reason_co != NULL;
+}
+
+/*! Get error reason of match result, format deferred reason if necessary
+ * @param[in]  h       CLIgen handle
+ * @param[in]  mr      Match result struct
+ * @param[out] reasonp Malloced reason string (or NULL), consumed from mr
+ * @retval     0       OK
+ * @retval    -1       Error
+ */
+static int
+mr_reason_get(cligen_handle h,
+	      match_result *mr,
+	      char        **reasonp)
+{
+    char *reason = NULL;
+    
+    if (mr->mr_reason == NULL && mr->mr_reason_co != NULL){
+	if (match_variable(h, mr->mr_reason_co, mr->mr_reason_token, &reason) < 0)
+	    return -1;
+	mr_reason_set(mr, reason);
+    }
+    *reasonp = mr->mr_reason;
+    mr->mr_reason = NULL;
+    mr_reason_set(mr, NULL);
     return 0;
 }
 
@@ -645,48 +1255,77 @@ static int
 mr_mv_reason(match_result *from,
 	     match_result *to)
 {
-    char *reason;
-
-    if ((reason = from->mr_reason) != NULL &&
-	to->mr_reason == NULL){
-	to->mr_reason = reason;
+    if (mr_reason_exists(from) && !mr_reason_exists(to)){
+	to->mr_reason = from->mr_reason;
+	to->mr_reason_co = from->mr_reason_co;
+	to->mr_reason_token = from->mr_reason_token;
 	from->mr_reason = NULL;
+	mr_reason_set(from, NULL);
     }
     return 0;
 }
 
+/*! Get an empty match result, reused from the parse context of the handle
+ * @param[in]  h     CLIgen handle
+ * @retval     mr    Match result, free with mr_free
+ * @retval     NULL  Error
+ */
 static match_result *
-mr_new(void)
+mr_new(cligen_handle h)
 {
-    match_result *mr;
-    
+    cligen_parse_ctx *pc;
+    match_result     *mr;
+
+    if ((pc = cligen_parse_ctx_get(h)) != NULL && pc->pc_mrlen){
+	pc->pc_reused++;
+	return pc->pc_mr[--pc->pc_mrlen];
+    }
+    if (pc)
+	pc->pc_allocated++;
     if ((mr = malloc(sizeof(*mr))) == NULL)
 	return NULL;
     memset(mr, 0, sizeof(*mr));
     return mr;
 }
 
-/*! Free a return structure
+/*! Free a return structure, or give it back to the parse context keeping mr_vec
  * Dont free the parse tree mr_parsetree
+ * @param[in]  h     CLIgen handle
+ * @param[in]  mr    Match result
  */
 static int
-mr_free(match_result *mr)
+mr_free(cligen_handle h,
+	match_result *mr)
 {
-    if (mr->mr_vec)
-	free(mr->mr_vec);
+    cligen_parse_ctx *pc;
+    int              *vec;
+    uint32_t          size;
+
     if (mr->mr_reason)
 	free(mr->mr_reason);
+    if ((pc = cligen_parse_ctx_get(h)) != NULL && pc->pc_mrlen < CLIGEN_PARSE_CTX_MAX){
+	vec = mr->mr_vec;
+	size = mr->mr_size;
+	memset(mr, 0, sizeof(*mr));
+	mr->mr_vec = vec;
+	mr->mr_size = size;
+	pc->pc_mr[pc->pc_mrlen++] = mr;
+	return 0;
+    }
+    if (mr->mr_vec)
+	free(mr->mr_vec);
     free(mr);
     return 0;
 }
 
-/*! Match a parse-tree (pt) with a command vector (cvt/cvr)
+/*! Match a parse-tree (pt) with a command vector (tokens)
  * @param[in]  h        CLIgen handle
  * @param[in]  token    Token to match at this level
  * @param[in]  resttokens Rest of tokens at this level (special case if type is REST)
  * @param[in]  pt       Vector of commands (array of cligen object pointers (cg_obj)
  * @param[in]  best     Only return best match (for command evaluation) instead of 
  *                      all possible options
+ * @param[in]  matched  Already matched positions of pt if set, or NULL
  * @param[out] mr       Match result, when retval = 0
  * @retval     0        OK. result in mr parameter
  * @retval    -1        Error
@@ -697,6 +1336,7 @@ match_vec(cligen_handle h,
 	  char         *token,
 	  char         *resttokens,
 	  int           best,
+	  uint64_t     *matched,
 	  match_result *mr)
 {
     int     retval = -1;
@@ -704,42 +1344,49 @@ match_vec(cligen_handle h,
     int32_t pref_upper = 0;         /* Preference upper bound */
     int     p;             /* If all fails, save lowest(widest) preference error message */
     int     exact;
-    char   *tmpreason = NULL;
     int     i;
+    int     j;
+    int    *vec = NULL; /* Candidate positions from keyword index */
+    int     len;
     cg_obj *co;
     int     match;
 
+    /* Keywords not having token as prefix cannot match and leave no reason: 
+     * use keyword index if present to skip them, otherwise try all */
+    if (token && *token != '\0' &&
+	pt_index_lookup(pt, token, &vec, &len) < 0)
+	goto done;
+    if (vec == NULL)
+	len = pt_len_get(pt);
     /* Loop through parse-tree at this level to find matches */
-    for (i=0; i<pt_len_get(pt); i++){
+    for (j=0; j<len; j++){
+	i = vec?vec[j]:j;
 	if ((co = pt_vec_i_get(pt, i)) == NULL)
 	    continue;
-	/* Return -1: error, 0: nomatch, 1: match */
-	tmpreason = NULL;
+	/* Return -1: error, 0: nomatch, 1: match 
+	 * No reason is formatted here, see mr_reason_defer */
 	if ((match = match_object(h,
 				  ISREST(co)?resttokens:token,
 				  co, best, &exact,
-				  &tmpreason      /* if match == 0 */
+				  NULL
 				  )) < 0)
 	    goto done;
 	p = co_pref(co, exact); /* get match preferences (higher is better match) */
 	if (match == 0){ /* No match */
-	    assert(tmpreason != NULL);
 	    /* If all fails, save lowest(widest) preference error message,
-	     * for variables only
+	     * for variables only. Shallow objects are only valid during this match, 
+	     * use original.
 	     */
 	    if (p < pref_lower && co->co_type == CO_VARIABLE){
 		pref_lower = p;
-		mr_reason_set(mr, tmpreason);
-		tmpreason = NULL;
-	    }
-	    if (tmpreason){
-		free(tmpreason);
-		tmpreason = NULL;
+		mr_reason_defer(mr,
+				(co_flags_get(co, CO_FLAGS_SHALLOW) && co->co_ref)?co->co_ref:co,
+				ISREST(co)?resttokens:token);
 	    }
 	}
 #if 1
 	/* An alternative is to sort away these after the call in match_pattern_sets_local */
-	else if (co_flags_get(co, CO_FLAGS_MATCH)){
+	else if (match_set_get(matched, i)){
 	    p = 1; /* XXX lower than any variables*/
 	    if (p < pref_lower){
 		char *r;
@@ -751,7 +1398,6 @@ match_vec(cligen_handle h,
 	}
 #endif
 	else { /* Match: if best compare and save highest preference */
-	    assert(tmpreason == NULL);
 	    if (best){ /* only save best match */
 		if (p == pref_upper){
 		    if (mr_vec_append(mr, i) < 0)
@@ -772,13 +1418,14 @@ match_vec(cligen_handle h,
 		    goto done;
 	    }
 	} /* switch match */
-	assert(tmpreason == NULL);
     } /* for pt_len_get(pt) */
     /* Only return reason if matches == 0 */
     if (mr->mr_len != 0)
 	mr_reason_set(mr, NULL);
     retval = 0;
  done:
+    if (vec)
+	free(vec);
     return retval;
 }
 
@@ -829,19 +1476,133 @@ match_bindvars(cligen_handle h,
     return retval;
 }
 
+/*! Return original of first object in a parse-tree, identifies the tree in match state
+ */
+static cg_obj *
+match_state_top(parse_tree *pt)
+{
+    int     i;
+    cg_obj *co;
+
+    for (i=0; i<pt_len_get(pt); i++)
+	if ((co = pt_vec_i_get(pt, i)) != NULL)
+	    return co->co_ref?co->co_ref:co;
+    return NULL;
+}
+
+/*! Free a saved match state
+ * @param[in]  arg   Match state
+ */
+int
+match_state_free(void *arg)
+{
+    match_state *ms = (match_state *)arg;
+    int          i;
+
+    if (ms == NULL)
+	return 0;
+    if (ms->ms_tokens){
+	for (i=0; i<ms->ms_level; i++)
+	    if (ms->ms_tokens[i])
+		free(ms->ms_tokens[i]);
+	free(ms->ms_tokens);
+    }
+    if (ms->ms_cvv)
+	cvec_free(ms->ms_cvv);
+    if (ms->ms_vobj)
+	free(ms->ms_vobj);
+    if (ms->ms_vstr){
+	for (i=0; i<ms->ms_vlen; i++)
+	    if (ms->ms_vstr[i])
+		free(ms->ms_vstr[i]);
+	free(ms->ms_vstr);
+    }
+    free(ms);
+    return 0;
+}
+
+/*! Record an original object whose value is set by a match, replayed when resuming
+ */
 static int
-co_clearflag(cg_obj *co,
-	     void   *arg)
+match_capture_value(match_capture *mc,
+		    cg_obj        *co_orig)
 {
-    co_flags_reset(co, (intptr_t)arg);
+    if ((mc->mc_vobj = realloc(mc->mc_vobj, (mc->mc_vlen+1)*sizeof(cg_obj *))) == NULL){
+	fprintf(stderr, "%s: realloc: %s\n", __FUNCTION__, strerror(errno));
+	return -1;
+    }
+    mc->mc_vobj[mc->mc_vlen++] = co_orig;
     return 0;
 }
 
+/*! Capture match state when the last level is reached
+ * @param[in]  mc       Match capture
+ * @param[in]  tk       Tokenized string: vector of tokens
+ * @param[in]  co_match Object matched before last level
+ * @param[in]  level    Last level
+ * @param[in]  cvv      Variables bound so far
+ */
+static int
+match_capture_state(match_capture *mc,
+		    cligen_tokens *tk,
+		    cg_obj        *co_match,
+		    int            level,
+		    cvec          *cvv)
+{
+    int          retval = -1;
+    match_state *ms = NULL;
+    int          i;
+    cg_obj      *co;
+
+    if ((ms = malloc(sizeof(*ms))) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	goto done;
+    }
+    memset(ms, 0, sizeof(*ms));
+    ms->ms_level = level;
+    ms->ms_anchor = co_match->co_ref?co_match->co_ref:co_match;
+    ms->ms_ptc = co_pt_get(co_match);
+    if ((ms->ms_tokens = calloc(level, sizeof(char *))) == NULL ||
+	(ms->ms_cvv = cvec_new(0)) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	goto done;
+    }
+    for (i=0; i<level; i++)
+	if ((ms->ms_tokens[i] = strdup(tk->tk_vec[i].ct_str)) == NULL)
+	    goto done;
+    for (i=mc->mc_cvvlen; i<cvec_len(cvv); i++)
+	if (cvec_append_var(ms->ms_cvv, cvec_i(cvv, i)) == NULL)
+	    goto done;
+    if (mc->mc_vlen){
+	if ((ms->ms_vobj = calloc(mc->mc_vlen, sizeof(cg_obj *))) == NULL ||
+	    (ms->ms_vstr = calloc(mc->mc_vlen, sizeof(char *))) == NULL){
+	    fprintf(stderr, "%s: calloc: %s\n", __FUNCTION__, strerror(errno));
+	    goto done;
+	}
+	for (i=0; i<mc->mc_vlen; i++){
+	    co = mc->mc_vobj[i];
+	    if (co->co_value == NULL)
+		continue;
+	    if ((ms->ms_vstr[ms->ms_vlen] = strdup(co->co_value)) == NULL)
+		goto done;
+	    ms->ms_vobj[ms->ms_vlen++] = co;
+	}
+    }
+    if (mc->mc_state)
+	match_state_free(mc->mc_state);
+    mc->mc_state = ms;
+    ms = NULL;
+    retval = 0;
+ done:
+    if (ms)
+	match_state_free(ms);
+    return retval;
+}
+
 /*! Matchpattern sets local
  *
  * @param[in]     h         CLIgen handle
- * @param[in]     cvt       Tokenized string: vector of tokens
- * @param[in]     cvr       Rest variant,  eg remaining string in each step
+ * @param[in]     tk        Tokenized string: vector of tokens and remaining strings
  * @param[in]     pt        Vector of commands. Array of cligen object pointers
  * @param[in]     pt_max    Length of the pt array
  * @param[in]     level     Current command level
@@ -850,18 +1611,21 @@ co_clearflag(cg_obj *co,
  * @param[out]    mrp       Match result including how many matches, level, reason for nomatc, etc
  * @param[in,out] cvv       cligen variable vector containing vars/values pair for completion
  * @param[in,out] cvvall    cligen variable vector containing vars/values + keywords for callbacks
+ * @param[in,out] mc        Capture of match state, or NULL
+ * @param[in]     matched   Already matched positions of pt if set, or NULL
  * @retval        0         OK. result returned in mrp
  * @retval        -1        Error
  */
 static int 
 match_pattern_sets_local(cligen_handle h, 
-			 cvec         *cvt,
-			 cvec         *cvr,
+			 cligen_tokens *tk,
 			 parse_tree   *pt,
 			 int           level,
 			 int           best,
 			 cvec         *cvv,
 			 cvec         *cvvall,
+			 match_capture *mc,
+			 uint64_t      *matched,
 			 match_result **mrp)
 {
     int         retval = -1;
@@ -872,22 +1636,23 @@ match_pattern_sets_local(cligen_handle h,
     char       *resttokens;
     match_result *mr0 = NULL;
 
-    if ((mr0 = mr_new()) == NULL)
+    if ((mr0 = mr_new(h)) == NULL)
 	goto done;
     /* Tokens of this level */
-    token = cvec_i_str(cvt, level+1);
+    token = tk->tk_vec[level].ct_str;
     /* Is this last token? */
-    lasttoken = last_level(cvt, level); 
-    resttokens  = cvec_i_str(cvr, level+1);
+    lasttoken = last_level(tk, level); 
+    resttokens  = tk->tk_vec[level].ct_rest;
     
     /* Return level at this point, can be overriden by recursive call */
     mr0->mr_level = level;
 
-    /* How many matches of cvt[level+1] in pt */
+    /* How many matches of token in pt */
     if (match_vec(h,
 		  pt, token, resttokens,
 		  lasttoken?best:1, /* use best preference match in non-terminal matching*/
-		   mr0) < 0)
+		  matched,
+		  mr0) < 0)
 	goto done;
     /* Number of matches is 0 (no match), 1 (exact) or many */
     switch (mr0->mr_len){
@@ -925,7 +1690,7 @@ match_pattern_sets_local(cligen_handle h,
     co_orig = co_match->co_ref?co_match->co_ref: co_match;
 
     /* Already matched (sets functionality) */
-    if (co_flags_get(co_match, CO_FLAGS_MATCH)){ /* XXX: orig?? */
+    if (match_set_get(matched, mr0->mr_vec[0])){
 	char *r;
 	if ((r = strdup("Already matched")) == NULL)
 	    goto done;
@@ -963,7 +1728,8 @@ match_pattern_sets_local(cligen_handle h,
 	assert(co_match);
 	if (co_match->co_type == CO_COMMAND &&
 	    co_orig && co_orig->co_type == CO_VARIABLE)
-	    if (co_value_set(co_orig, co_match->co_command) < 0)
+	    if (co_value_set(co_orig, co_match->co_command) < 0 ||
+		(mc && match_capture_value(mc, co_orig) < 0))
 		goto done;
 	break;
     default:
@@ -981,7 +1747,7 @@ match_pattern_sets_local(cligen_handle h,
     }
 #endif
     if (mr0)
-	mr_free(mr0);
+	mr_free(h, mr0);
     /* Only the last level may have multiple matches */
     return retval;
 } /* match_pattern_sets_local */
@@ -989,8 +1755,7 @@ match_pattern_sets_local(cligen_handle h,
 /*! Matchpattern sets
  *
  * @param[in]     h         CLIgen handle
- * @param[in]     cvt       Tokenized string: vector of tokens
- * @param[in]     cvr       Rest variant,  eg remaining string in each step
+ * @param[in]     tk        Tokenized string: vector of tokens and remaining strings
  * @param[in]     pt        Vector of commands. Array of cligen object pointers
  * @param[in]     pt_max    Length of the pt array
  * @param[in]     level     Current command level
@@ -999,20 +1764,26 @@ match_pattern_sets_local(cligen_handle h,
  *                          If not set, return all possible matches, do not return hidden options 
  * @param[in,out] cvv       cligen variable vector containing vars/values pair for completion
  * @param[in,out] cvvall    cligen variable vector containing vars/values + keywords for callbacks
+ * @param[in,out] mc        Capture of match state, or NULL
+ * @param[in,out] matched   Matched positions of pt if pt is a set iterated by the caller,
+ *                          the match of this call is added. Or NULL
  * @param[out]    mrp       Match result including how many matches, level, reason for nomatc, etc
  * @retval        0         OK. result returned in mrp
  * @retval        -1        Error
  * Note: parameter "best" is only set in call from match_pattern_exact().
+ * @note The parse-tree is not modified, matched set objects are recorded in bitsets
+ *       local to each iteration over a set.
  */
 static int 
 match_pattern_sets(cligen_handle h, 
-		   cvec         *cvt,
-		   cvec         *cvr,
+		   cligen_tokens *tk,
 		   parse_tree   *pt,
 		   int           level,
 		   int           best,
 		   cvec         *cvv,
 		   cvec         *cvvall,
+		   match_capture *mc,
+		   uint64_t      *matched,
 		   match_result **mrp)
 {
     int           retval = -1;
@@ -1023,13 +1794,17 @@ match_pattern_sets(cligen_handle h,
     match_result *mrc = NULL; /* child result */
     match_result *mrcprev = NULL; /* previous succesful result */
     char         *token;
+    int           i;              /* Position of unique match in pt */
+    uint64_t      setbuf[MATCH_SET_WORDS];
+    uint64_t     *setvec = NULL;  /* Matched positions of ptn if it is a set */
+    size_t        setlen;
 
-    token = cvec_i_str(cvt, level+1); /* for debugging */
+    token = tk->tk_vec[level].ct_str; /* for debugging */
     if (0)
 	fprintf(stderr, "%s %s\n", __FUNCTION__, token);
     /* Match the current token */
-    if (match_pattern_sets_local(h, cvt, cvr, pt, level, best, 
-				 cvv, cvvall, &mr0) < 0)
+    if (match_pattern_sets_local(h, tk, pt, level, best, 
+				 cvv, cvvall, mc, matched, &mr0) < 0)
 	goto done;
     if (mr0->mr_len != 1){ /* If not unique match exit here */
 	*mrp = mr0;
@@ -1037,16 +1812,17 @@ match_pattern_sets(cligen_handle h,
 	goto ok;
     }
     /* Unique match */
-    co_match = pt_vec_i_get(pt, mr0->mr_vec[0]);
+    i = mr0->mr_vec[0];
+    co_match = pt_vec_i_get(pt, i);
     if (mr0->mr_last && (strcmp(token,"") != 0)){
-	co_flags_set(co_match, CO_FLAGS_MATCH);
+	match_set_add(matched, i);
 	*mrp = mr0;
 	mr0 = NULL;
 	goto ok;
     }
     if (pt_expand_treeref(h, co_match, co_pt_get(co_match)) < 0) /* sub-tree expansion */
 	goto done;
-    if ((ptn = pt_new()) == NULL)
+    if ((ptn = pt_new_arena(cligen_line_arena(h))) == NULL)
 	goto done;
     if (pt_expand(h, co_pt_get(co_match), cvv,
 		  !best,  /* If best is set, include hidden commands, otherwise do not */
@@ -1060,7 +1836,7 @@ match_pattern_sets(cligen_handle h,
 	break;
     case 1: /* Last in syntax tree (not token) */
 	mr_parsetree_set(mr0, pt);
-	co_flags_set(co_match, CO_FLAGS_MATCH);
+	match_set_add(matched, i);
 	*mrp = mr0;
 	mr0 = NULL;
 	goto ok;
@@ -1068,15 +1844,28 @@ match_pattern_sets(cligen_handle h,
     case 2: /* Last in syntax tree but can continue,... */
 	break;
     }
+    /* Only a plain path can be resumed from saved state */
+    if (mc && (lastsyntax != 0 || pt_sets_get(pt) || pt_sets_get(ptn)))
+	mc->mc_bad = 1;
     if (pt_sets_get(ptn)){ /* For sets, iterate */
-	while (!last_level(cvt, level)){
+	setlen = (pt_len_get(ptn)+63)/64;
+	if (setlen <= MATCH_SET_WORDS)
+	    setvec = setbuf;
+	else if ((setvec = malloc(setlen*sizeof(uint64_t))) == NULL){
+	    fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	    goto done;
+	}
+	memset(setvec, 0, setlen*sizeof(uint64_t));
+	while (!last_level(tk, level)){
 	    if (mrc != NULL)
 		mrc = NULL;
-	    if (match_pattern_sets(h, cvt, cvr, ptn,
+	    if (match_pattern_sets(h, tk, ptn,
 				   level+1,
 				   best, 
 				   cvv,
 				   cvvall,
+				   mc,
+				   setvec,
 				   &mrc) < 0)
 		goto done;		
 	    if (mrc->mr_len != 1)
@@ -1085,7 +1874,7 @@ match_pattern_sets(cligen_handle h,
 		if (mrcprev->mr_parsetree != ptn &&
 		    mrcprev->mr_parsetree != mrc->mr_parsetree)
 		    pt_free(mrcprev->mr_parsetree, 0);
-		mr_free(mrcprev);
+		mr_free(h, mrcprev);
 		mrcprev = NULL;
 	    }
 	    mrcprev = mrc;
@@ -1098,41 +1887,45 @@ match_pattern_sets(cligen_handle h,
 	}
     }
     else{
-	if (last_level(cvt, level)){
+	if (last_level(tk, level)){
 	    *mrp = mr0;
 	    mr0 = NULL;
 	    goto ok;    
 	}
-	else if (match_pattern_sets(h, cvt, cvr, ptn,
-				    level+1, 
-				    best, 
-				    cvv,
-				    cvvall,
-				    &mrc) < 0)
-	    goto done;
+	else {
+	    if (mc && !mc->mc_bad && last_level(tk, level+1) &&
+		match_capture_state(mc, tk, co_match, level+1, cvv) < 0)
+		goto done;
+	    if (match_pattern_sets(h, tk, ptn,
+				   level+1, 
+				   best, 
+				   cvv,
+				   cvvall,
+				   mc,
+				   NULL,
+				   &mrc) < 0)
+		goto done;
+	}
     }
     assert(mrc != NULL);
-    /* Clear all CO_FLAGS_MATCH recursively */
-    pt_apply(ptn, co_clearflag, (void*)CO_FLAGS_MATCH);
     /* If child match fails, use previous */
     if (mrc->mr_len == 0 && mrcprev){
-	/* Transfer match flags from ptn to pt if this tree has no more matches */
-	if (mrc->mr_len == 0)
-	    co_flags_set(co_match, CO_FLAGS_MATCH);	    
+	/* Mark as matched in pt if this tree has no more matches */
+	match_set_add(matched, i);
 	mr_mv_reason(mrc, mrcprev); 	/* transfer error reason if any from child */
 	*mrp = mrcprev;
 	mrcprev = NULL;
     }
     else if (mrc->mr_len == 0 && lastsyntax == 2){ /* If no child match, then use local */
 	mr_parsetree_set(mr0, pt);
-	co_flags_set(co_match, CO_FLAGS_MATCH);
+	match_set_add(matched, i);
 	mr_mv_reason(mrc, mr0); 	/* transfer error reason if any from child */
 	*mrp = mr0;
 	mr0 = NULL;
     }
     else{ /* child match,  use that */
 	if (mrc->mr_len == 1)
-	    co_flags_set(co_match, CO_FLAGS_MATCH);
+	    match_set_add(matched, i);
 	*mrp = mrc;
 	if (mrcprev == mrc)
 	    mrcprev = NULL;
@@ -1151,73 +1944,178 @@ match_pattern_sets(cligen_handle h,
 	    *mrp &&
 	    mrcprev->mr_parsetree != (*mrp)->mr_parsetree)
 	    pt_free(mrcprev->mr_parsetree, 0);
-	mr_free(mrcprev);
+	mr_free(h, mrcprev);
     }
     if (ptn)
 	pt_free(ptn, 0);
     if (mrc)
-	mr_free(mrc);
+	mr_free(h, mrc);
     if (mr0)
-	mr_free(mr0);
+	mr_free(h, mr0);
+    if (setvec && setvec != setbuf)
+	free(setvec);
     return retval;   
 } /* match_pattern_sets */
 
-/*! CLIgen object matching function
+/*! Resume matching of a line from saved match state, only matching the last level
+ *
+ * A TAB or '?' saves the matched path of all tokens except the last. If the next 
+ * completion or help has the same preceding tokens (eg the user edits the last token) 
+ * only the last level is expanded and matched, instead of the whole line.
  * @param[in]  h         CLIgen handle
- * @param[in]  string    Input string to match
- * @param[in]  cvt       Tokenized string: vector of tokens
- * @param[in]  cvr       Rest variant,  eg remaining string in each step
+ * @param[in]  tk        Tokenized string: vector of tokens and remaining strings
+ * @param[in]  pt        Top-level parse-tree
+ * @param[in]  best      Best flag (is 0, see match_pattern)
+ * @param[in,out] cvv    Variables, those bound by preceding tokens are added
+ * @param[out] mrp       Match result
+ * @retval     1         Resumed, result in mrp
+ * @retval     0         No matching state, match whole line
+ * @retval    -1         Error
+ */
+static int
+match_state_resume(cligen_handle h,
+		   cligen_tokens *tk,
+		   parse_tree   *pt,
+		   int           best,
+		   cvec         *cvv,
+		   match_result **mrp)
+{
+    int           retval = -1;
+    match_state  *ms;
+    parse_tree   *ptc;
+    parse_tree   *ptn = NULL;
+    match_result *mr = NULL;
+    int           cvvlen;
+    int           i;
+    cg_var       *cv;
+
+    if ((ms = cligen_complete_state_get(h)) == NULL ||
+	ms->ms_gen != cligen_complete_state_gen(h) ||
+	ms->ms_level != cligen_tokens_levels(tk) ||
+	ms->ms_toplen != pt_len_get(pt) ||
+	ms->ms_top != match_state_top(pt))
+	goto nomatch;
+    for (i=0; i<ms->ms_level; i++)
+	if (strcmp(ms->ms_tokens[i], tk->tk_vec[i].ct_str) != 0)
+	    goto nomatch;
+    cvvlen = cvec_len(cvv);
+    for (i=0; i<ms->ms_vlen; i++)
+	if (co_value_set(ms->ms_vobj[i], ms->ms_vstr[i]) < 0)
+	    goto done;
+    cv = NULL;
+    while ((cv = cvec_each(ms->ms_cvv, cv)) != NULL)
+	if (cvec_append_var(cvv, cv) == NULL)
+	    goto done;
+    ptc = ms->ms_ptc;
+    if (pt_expand_treeref(h, ms->ms_anchor, ptc) < 0) /* sub-tree expansion */
+	goto done;
+    if ((ptn = pt_new_arena(cligen_line_arena(h))) == NULL)
+	goto done;
+    if (pt_expand(h, ptc, cvv, !best, 1, ptn) < 0)
+	goto done;
+    /* Expand callbacks may give another tree than when saved */
+    if (last_pt(ptn) != 0 || pt_sets_get(ptn)){
+	while (cvec_len(cvv) > cvvlen){
+	    cv = cvec_i(cvv, cvec_len(cvv)-1);
+	    cv_reset(cv);
+	    cvec_del(cvv, cv);
+	}
+	goto nomatch;
+    }
+    if (match_pattern_sets(h, tk, ptn, ms->ms_level, best, cvv, NULL, NULL, NULL, &mr) < 0)
+	goto done;
+    if (mr->mr_parsetree == ptn)
+	ptn = NULL; /* passed to caller */
+    *mrp = mr;
+    retval = 1;
+    goto done;
+ nomatch:
+    retval = 0;
+ done:
+    if (ptn)
+	pt_free(ptn, 0);
+    return retval;
+}
+
+/*! CLIgen object matching function returning the match result, see match_pattern_tokens
+ * @param[in]  h         CLIgen handle
+ * @param[in]  tk        Tokenized string, see cligen_str2tokens
  * @param[in]  pt        Vector of commands (array of cligen object pointers (cg_obj)
  * @param[in]  best      If set, only return best match (for command evaluation) instead of 
  *                       all possible options. Match also hidden options.
  *                       If not set, return all possible matches, do not return hidden options 
- * @param[out] ptmatch   Returns the parsetree at the place of matching
- * @param[out] matchvec  A vector of integers containing indexes in covec which match
- * @param[out] matchlen  Number of matches in matchvec, (if retval is 0)
  * @param[out] cvv       cligen variable vector containing vars/values pair for completion
  * @param[out] cvvall    cligen variable vector containing vars/values + keywords for callbacks
  * @param[out] reasonp   If retval = 0, this may be malloced to indicate reason for 
  *                       not matching variables, if given. Neeed to be free:d
+ * @param[out] mrp       Match result, free with mr_free, or NULL
  * @retval -1   error.
  * @retval  0   OK
  *
  * All options are ordered by PREFERENCE, where 
  *       command > ipv4,mac > string > rest
+ * @note Threads: all state of a match is in h and its line arena, so different handles
+ *       with different parse-trees can match concurrently. Matching writes expanded
+ *       values (co_value), tree references (@tree) and regexp caches into the parse-tree,
+ *       so handles sharing it run in one thread, see cligen_copy for other threads.
  */
-int 
-match_pattern(cligen_handle h,
-	      cvec         *cvt,
-	      cvec         *cvr,
-	      parse_tree   *pt, 
-	      int           best,
-	      parse_tree  **ptmatch, 
-	      int          *matchvec[],
-	      int          *matchlen, 
-	      cvec         *cvv,
-	      cvec         *cvvall,
-	      char        **reasonp)
+static int 
+match_pattern_mr(cligen_handle  h,
+		 cligen_tokens *tk,
+		 parse_tree    *pt, 
+		 int            best,
+		 cvec          *cvv,
+		 cvec          *cvvall,
+		 char         **reasonp,
+		 match_result **mrp)
 {
     int           retval = -1;
     match_result *mr = NULL;
+    match_capture mc = {0,};
+    int           resume;
+    int           ret;
+    uint64_t      t0;
+    uint64_t      t1;
     
-    if (ptmatch == NULL || cvt == NULL || cvr == NULL || matchvec == NULL || matchlen == NULL){
+    t0 = cligen_stats_start(h);
+    if (tk == NULL || tk->tk_len < 1){
 	errno = EINVAL;
 	goto done;
     }
-    *matchlen = 0;
-
-    if (match_pattern_sets(h, cvt, cvr,
-			   pt,
-			   0,
-			   best, 
-			   cvv, cvvall,
-			   &mr) < 0)
-	goto done;
-    /* Clear all CO_FLAGS_MATCH recursively */
-    pt_apply(pt, co_clearflag, (void*)CO_FLAGS_MATCH);
+    *mrp = NULL;
+    /* Completion and help may resume from the state of the previous keystroke */
+    resume = !best && cvv != NULL && cvvall == NULL &&
+	cligen_complete_state(h) && cligen_treeref_cache(h);
+    ret = 0;
+    if (resume){
+	t1 = cligen_stats_start(h);
+	if ((ret = match_state_resume(h, tk, pt, best, cvv, &mr)) < 0)
+	    goto done;
+	if (ret == 1) /* Only count resumed matches */
+	    cligen_stats_stop(h, CLIGEN_STAT_RESUME, t1);
+    }
+    if (ret == 0){
+	mc.mc_cvvlen = cvv?cvec_len(cvv):0;
+	if (match_pattern_sets(h, tk,
+			       pt,
+			       0,
+			       best, 
+			       cvv, cvvall,
+			       resume?&mc:NULL,
+			       NULL,
+			       &mr) < 0)
+	    goto done;
+	if (mc.mc_state){
+	    mc.mc_state->ms_gen = cligen_complete_state_gen(h);
+	    mc.mc_state->ms_top = match_state_top(pt);
+	    mc.mc_state->ms_toplen = pt_len_get(pt);
+	    cligen_complete_state_put(h, mc.mc_state);
+	    mc.mc_state = NULL;
+	}
+    }
 #if 1 /* XXX: should move up to callers? */
     if (mr){
-	if (!last_level(cvt, mr->mr_level)){
+	if (!last_level(tk, mr->mr_level)){
 	    cg_obj *co_match;
 	    char *r;
 	    if (mr->mr_len == 1){
@@ -1225,7 +2123,7 @@ match_pattern(cligen_handle h,
 		if (co_match->co_type == CO_VARIABLE && ISREST(co_match))
 		    ;
 		else{
-		    if (mr->mr_reason == NULL){ /* If pre-existing error reason use that */
+		    if (!mr_reason_exists(mr)){ /* If pre-existing error reason use that */
 			if ((r = strdup("Unknown command")) == NULL) /* else create unknown error */
 			    goto done;
 			mr_reason_set(mr, r);
@@ -1240,27 +2138,146 @@ match_pattern(cligen_handle h,
 		mr_vec_reset(mr);
 	    }
 	}
-	*ptmatch = mr->mr_parsetree;
-	*matchvec = mr->mr_vec;
-	*matchlen = mr->mr_len;
+	/* Only format a deferred reason if asked for */
 	if (reasonp){
-	    *reasonp = mr->mr_reason;
+	    if (mr_reason_get(h, mr, reasonp) < 0){
+		mr_free(h, mr);
+		goto done;
+	    }
 	}
-	else if (mr->mr_reason)
-	    free(mr->mr_reason);
-	free(mr);
+	else
+	    mr_reason_set(mr, NULL);
+	*mrp = mr;
     }
 #endif
     retval = 0;
  done:
+    if (mc.mc_vobj)
+	free(mc.mc_vobj);
+    if (mc.mc_state)
+	match_state_free(mc.mc_state);
+    cligen_stats_stop(h, CLIGEN_STAT_MATCH, t0);
     return retval;
-} /* match_pattern */
+} /* match_pattern_mr */
 
-/*! CLIgen object matching function for exact match
+/*! CLIgen object matching function
  * @param[in]  h         CLIgen handle
- * @param[in]  string    Input string to match
+ * @param[in]  tk        Tokenized string, see cligen_str2tokens
+ * @param[in]  pt        Vector of commands (array of cligen object pointers (cg_obj)
+ * @param[in]  best      If set, only return best match (for command evaluation) instead of 
+ *                       all possible options. Match also hidden options.
+ *                       If not set, return all possible matches, do not return hidden options 
+ * @param[out] ptmatch   Returns the parsetree at the place of matching
+ * @param[out] matchvec  A vector of integers containing indexes in covec which match,
+ *                       free after use
+ * @param[out] matchlen  Number of matches in matchvec, (if retval is 0)
+ * @param[out] cvv       cligen variable vector containing vars/values pair for completion
+ * @param[out] cvvall    cligen variable vector containing vars/values + keywords for callbacks
+ * @param[out] reasonp   If retval = 0, this may be malloced to indicate reason for 
+ *                       not matching variables, if given. Neeed to be free:d
+ * @retval -1   error.
+ * @retval  0   OK
+ * @see match_pattern_mr
+ */
+int 
+match_pattern_tokens(cligen_handle  h,
+		     cligen_tokens *tk,
+		     parse_tree    *pt, 
+		     int            best,
+		     parse_tree   **ptmatch, 
+		     int           *matchvec[],
+		     int           *matchlen, 
+		     cvec          *cvv,
+		     cvec          *cvvall,
+		     char         **reasonp)
+{
+    match_result *mr = NULL;
+
+    if (ptmatch == NULL || matchvec == NULL || matchlen == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    *matchlen = 0;
+    if (match_pattern_mr(h, tk, pt, best, cvv, cvvall, reasonp, &mr) < 0)
+	return -1;
+    if (mr){
+	*ptmatch = mr->mr_parsetree;
+	*matchvec = mr->mr_vec; /* Given to caller */
+	*matchlen = mr->mr_len;
+	mr->mr_vec = NULL;
+	mr->mr_size = 0;
+	mr_free(h, mr);
+    }
+    return 0;
+} /* match_pattern_tokens */
+
+/*! Token vector referring to tokens and rests in cligen variable vectors, see cligen_str2cvv
+ * @param[out] tk    Token vector, free tk_vec after use
+ * @param[in]  cvt   Tokenized string: vector of tokens
+ * @param[in]  cvr   Rest variant,  eg remaining string in each step
+ */
+static int
+tokens_cvec(cligen_tokens *tk,
+	    cvec          *cvt,
+	    cvec          *cvr)
+{
+    int           i;
+    cligen_token *ct;
+
+    memset(tk, 0, sizeof(*tk));
+    if (cvt == NULL || cvr == NULL ||
+	cvec_len(cvt) < 2 || cvec_len(cvr) < cvec_len(cvt)){
+	errno = EINVAL;
+	return -1;
+    }
+    tk->tk_string = cvec_i_str(cvt, 0);
+    tk->tk_len = tk->tk_max = cvec_len(cvt) - 1;
+    if ((tk->tk_vec = calloc(tk->tk_len, sizeof(*ct))) == NULL){
+	fprintf(stderr, "%s: calloc: %s\n", __FUNCTION__, strerror(errno));
+	return -1;
+    }
+    for (i=0; i<tk->tk_len; i++){
+	ct = &tk->tk_vec[i];
+	ct->ct_str = cvec_i_str(cvt, i+1);
+	ct->ct_rest = cvec_i_str(cvr, i+1);
+	ct->ct_len = ct->ct_str?strlen(ct->ct_str):0;
+    }
+    return 0;
+}
+
+/*! CLIgen object matching function with tokens in cligen variable vectors
  * @param[in]  cvt       Tokenized string: vector of tokens
  * @param[in]  cvr       Rest variant,  eg remaining string in each step
+ * @see match_pattern_tokens for the other parameters
+ * @see cligen_str2cvv
+ */
+int 
+match_pattern(cligen_handle h,
+	      cvec         *cvt,
+	      cvec         *cvr,
+	      parse_tree   *pt, 
+	      int           best,
+	      parse_tree  **ptmatch, 
+	      int          *matchvec[],
+	      int          *matchlen, 
+	      cvec         *cvv,
+	      cvec         *cvvall,
+	      char        **reasonp)
+{
+    int           retval = -1;
+    cligen_tokens tk;
+
+    if (tokens_cvec(&tk, cvt, cvr) < 0)
+	return -1;
+    retval = match_pattern_tokens(h, &tk, pt, best, ptmatch, matchvec, matchlen,
+				  cvv, cvvall, reasonp);
+    free(tk.tk_vec);
+    return retval;
+} /* match_pattern */
+
+/*! CLIgen object matching function for exact match
+ * @param[in]  h         CLIgen handle
+ * @param[in]  tk        Tokenized string, see cligen_str2tokens
  * @param[in]  pt        CLIgen parse tree, vector of cligen objects.
  * @param[out] cvv       CLIgen variable vector containing vars for matching path
  * @param[out] cvvall    CLIgen variable vector containing vars and constants for matching vars
@@ -1273,37 +2290,38 @@ match_pattern(cligen_handle h,
  * @retval   0           OK, resultp contains more info.
  */
 int 
-match_pattern_exact(cligen_handle  h, 
-		    cvec          *cvt,
-		    cvec          *cvr,
-		    parse_tree    *pt, 
-		    cvec          *cvv,
-		    cvec          *cvvall,
-		    cg_obj       **match_obj,
-		    parse_tree   **ptmatchp,
-		    cligen_result *resultp,
-		    char         **reason)
+match_pattern_exact_tokens(cligen_handle  h, 
+			   cligen_tokens *tk,
+			   parse_tree    *pt, 
+			   cvec          *cvv,
+			   cvec          *cvvall,
+			   cg_obj       **match_obj,
+			   parse_tree   **ptmatchp,
+			   cligen_result *resultp,
+			   char         **reason)
 {
     int           retval = -1;
+    match_result *mr = NULL;
     parse_tree   *ptmatch = NULL;
     cg_obj       *co = NULL;
     int          *matchvec = NULL;
-    int           matchlen = -1; /* length of matchvec */
+    int           matchlen = 0; /* length of matchvec */
     int           i;
     parse_tree   *ptc;
 
-    if ((match_pattern(h,
-		       cvt, cvr, /* token string */
-		       pt,       /* command vector */
-		       1,        /* best: Return only best option including hidden options */
-		       &ptmatch, 
-		       &matchvec,
-		       &matchlen, 
-		       cvv, cvvall,
-		       reason)) < 0){
+    if (match_pattern_mr(h,
+			 tk,       /* token string */
+			 pt,       /* command vector */
+			 1,        /* best: Return only best option including hidden options */
+			 cvv, cvvall,
+			 reason,
+			 &mr) < 0)
 	goto done;
+    if (mr){ /* Match vector is kept by mr */
+	ptmatch = mr->mr_parsetree;
+	matchvec = mr->mr_vec;
+	matchlen = mr->mr_len;
     }
-    assert(matchlen != -1);
     /* If no match fix an error message */
     if (matchlen == 0){
 	if (reason && *reason == NULL){
@@ -1317,7 +2335,7 @@ match_pattern_exact(cligen_handle  h,
 	    int j;
 	    int allvars = 1;
 	    char *string1;
-	    string1 = cvec_i_str(cvt, cligen_cvv_levels(cvt)+1);
+	    string1 = tk->tk_vec[cligen_tokens_levels(tk)].ct_str;
 	    for (j=0; j<matchlen; j++){
 		co = pt_vec_i_get(ptmatch,matchvec[j]);
 		/* XXX If variable dont compare co_command */
@@ -1387,8 +2405,37 @@ match_pattern_exact(cligen_handle  h,
  done:
     if (ptmatch && pt != ptmatch)
 	pt_free(ptmatch, 0);
-    if (matchvec)
-	free(matchvec);
+    if (mr)
+	mr_free(h, mr);
+    return retval;
+} /* match_pattern_exact_tokens */
+
+/*! CLIgen object matching function for exact match with tokens in cligen variable vectors
+ * @param[in]  cvt       Tokenized string: vector of tokens
+ * @param[in]  cvr       Rest variant,  eg remaining string in each step
+ * @see match_pattern_exact_tokens for the other parameters
+ * @see cligen_str2cvv
+ */
+int 
+match_pattern_exact(cligen_handle  h, 
+		    cvec          *cvt,
+		    cvec          *cvr,
+		    parse_tree    *pt, 
+		    cvec          *cvv,
+		    cvec          *cvvall,
+		    cg_obj       **match_obj,
+		    parse_tree   **ptmatchp,
+		    cligen_result *resultp,
+		    char         **reason)
+{
+    int           retval = -1;
+    cligen_tokens tk;
+
+    if (tokens_cvec(&tk, cvt, cvr) < 0)
+	return -1;
+    retval = match_pattern_exact_tokens(h, &tk, pt, cvv, cvvall, match_obj, ptmatchp,
+					resultp, reason);
+    free(tk.tk_vec);
     return retval;
 } /* match_pattern_exact */
 
@@ -1418,8 +2465,7 @@ match_complete(cligen_handle h,
     int      minmatch;
     cg_obj  *co;
     cg_obj  *co1 = NULL;
-    cvec    *cvt = NULL;      /* Tokenized string: vector of tokens */
-    cvec    *cvr = NULL;      /* Rest variant,  eg remaining string in each step */
+    cligen_tokens *tk = NULL; /* Tokenized string */
     char    *string;
     char    *s;
     char    *ss;
@@ -1430,31 +2476,34 @@ match_complete(cligen_handle h,
     int      append = 0; /* Has appended characters */
     int      retval = -1;
     size_t   len;
+    uint64_t t0;
 
     /* ignore any leading whitespace */
     string = *stringp;
-    /* Tokenize the string and transform it into two CLIgen vectors: tokens and rests */
-    if (cligen_str2cvv(string, &cvt, &cvr) < 0)
+    /* Tokenize the string into token spans */
+    t0 = cligen_stats_start(h);
+    if (cligen_str2tokens(h, string, &tk) < 0)
 	goto done;
+    cligen_stats_stop(h, CLIGEN_STAT_TOKENIZE, t0);
     s = string;
     while ((strlen(s) > 0) && isblank(*s))
 	s++;
     matchlen = 0;
-    if (match_pattern(h, cvt, cvr,
-		      pt,
-		      0, /* best: Return all options, not only best, exclude hidden options */
-		      &ptmatch, 
-		      &matchvec, &matchlen,
-		      cvv, NULL,
-		      NULL) < 0)
+    if (match_pattern_tokens(h, tk,
+			     pt,
+			     0, /* best: Return all options, not only best, exclude hidden options */
+			     &ptmatch, 
+			     &matchvec, &matchlen,
+			     cvv, NULL,
+			     NULL) < 0)
 	goto done;
     if (matchlen == 0){
 	retval = 0;
 	goto done; /*  No matches */
     }
-    if ((level = cligen_cvv_levels(cvt)) < 0)
+    if ((level = cligen_tokens_levels(tk)) < 0)
 	goto done;
-    ss = cvec_i_str(cvt, level+1);
+    ss = tk->tk_vec[level].ct_str;
     slen = ss?strlen(ss):0;
 
     minmatch = slen;
@@ -1472,19 +2521,21 @@ match_complete(cligen_handle h,
 		continue;
 	}
 	if (co1 == NULL){
-	    minmatch = strlen(co->co_command);
+	    minmatch = CO_CMDLEN(co);
 	    co1 = co;
 	}
 	else{
-	    if (strcmp(co1->co_command, co->co_command)==0)
+	    len = CO_CMDLEN(co);
+	    if (len == CO_CMDLEN(co1) && strcmp(co1->co_command, co->co_command)==0)
 		; /* equal */
 	    else{
 		equal = 0;
-		len = MIN(strlen(co1->co_command), strlen(co->co_command));
+		/* Common prefix with co1 beyond minmatch does not matter */
+		len = MIN(len, minmatch);
 		for (j=0; j<len; j++)
 		    if (co1->co_command[j] != co->co_command[j])
 			break;
-		minmatch = MIN(minmatch, j);
+		minmatch = j;
 	    }
 	}
     }
@@ -1511,10 +2562,8 @@ match_complete(cligen_handle h,
   done:
     if (ptmatch && pt != ptmatch)
 	pt_free(ptmatch, 0);
-    if (cvt)
-	cvec_free(cvt);
-    if (cvr)
-	cvec_free(cvr);
+    if (tk)
+	cligen_tokens_release(h, tk);
     if (matchvec)
 	free(matchvec);
     return retval;
@@ -44,9 +44,44 @@
 /* Just show a single help string */
 #undef CLIGEN_SINGLE_HELPSTRING
 
+/* Initial length of token vector, doubled when needed */
+#define CLIGEN_TOKENS_MIN 16
+
+/* Initial length of vector of matches of a match result, doubled when needed */
+#define CLIGEN_MATCH_VEC_MIN 4
+
+/*
+ * Types
+ */
+/*! Span of one token in a command string, see cligen_str2tokens */
+typedef struct cligen_token {
+    char   *ct_str;    /* Token as string, in the token buffer */
+    char   *ct_rest;   /* Remaining string from this token, in the command string */
+    size_t  ct_off;    /* Offset of token in command string, after an opening quote */
+    size_t  ct_len;    /* Length of token */
+    int     ct_quoted; /* Token is enclosed in quotes */
+} cligen_token;
+
+/*! Tokenized command string, see cligen_str2tokens */
+typedef struct cligen_tokens {
+    char         *tk_string; /* Command string, not copied */
+    cligen_token *tk_vec;    /* Tokens, at least one, empty "" if none or trailing delimiters */
+    int           tk_len;    /* Number of tokens */
+    int           tk_max;    /* Allocated length of tk_vec */
+    char         *tk_buf;    /* Token strings, each NUL-terminated */
+    size_t        tk_buflen; /* Allocated size of tk_buf */
+} cligen_tokens;
+
 /*
  * Function Prototypes
  */
+int match_pattern_tokens(cligen_handle h, cligen_tokens *tk,
+			 parse_tree *pt,
+			 int best, 
+			 parse_tree  **ptmatch, 
+			 int *matchvec[], int *matchlen,
+			 cvec *cvv, cvec *cvvall,
+			 char **reasonp);
 int match_pattern(cligen_handle h, cvec *cvt, cvec *cvr, 
 		  parse_tree *pt,
 		  int best, 
@@ -54,6 +89,14 @@ int match_pattern(cligen_handle h, cvec *cvt, cvec *cvr,
 		  int *matchvec[], int *matchlen,
 		  cvec *cvv, cvec *cvvall,
 		  char **reasonp);
+int match_pattern_exact_tokens(cligen_handle h, cligen_tokens *tk,
+			       parse_tree    *pt,
+			       cvec          *cvv,
+			       cvec          *cvvall,
+			       cg_obj       **match_obj,
+			       parse_tree   **ptmatch,
+			       cligen_result *result,
+			       char         **reasonp);
 int match_pattern_exact(cligen_handle h, cvec *cvt, cvec *cvr, 
 			parse_tree    *pt,
 			cvec          *cvv,
@@ -62,11 +105,21 @@ int match_pattern_exact(cligen_handle h, cvec *cvt, cvec *cvr,
 			parse_tree   **ptmatch,
 			cligen_result *result,
 			char         **reasonp);
+int cligen_str2tokens(cligen_handle h, char *string, cligen_tokens **tkp);
+int cligen_tokens_release(cligen_handle h, cligen_tokens *tk);
+int cligen_tokens_free(cligen_tokens *tk);
+int cligen_tokens_levels(cligen_tokens *tk);
 int cligen_str2cvv(char *string, cvec **cvp, cvec **cvr);
 int cligen_txt2cvv(char *str, cvec **cvp);
 int cligen_cvv_levels(cvec *cvv);
 int match_complete(cligen_handle h, parse_tree *pt,
 		   char **stringp, size_t *slen, cvec *cvec);
+int match_state_free(void *ms);
+void *match_memo_new(void);
+int match_memo_reset(void *mm);
+int match_memo_free(void *mm);
+int match_variable(cligen_handle h, cg_obj *co, char *str, char **reason);
+cg_var *add_cov_to_cvec(cligen_handle h, cg_obj *co, char *cmd, cvec *cvv);
 
 #endif /* _CLIGEN_MATCH_H */
 
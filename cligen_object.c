@@ -66,16 +66,99 @@
 #include "cligen_parse.h"
 #include "cligen_handle.h"
 #include "cligen_getline.h"
+#include "cligen_regex.h"
+#include "cligen_arena.h"
+#include "cligen_intern.h"
 
-/* Stats: nr of created cligen objects */
+/* Stats: nr of created cligen objects, counters are atomic since objects may be
+ * created by several threads */
 uint64_t _co_count = 0;
 
+/* Typed slab allocation of cligen objects, see co_slab_set
+ * The slab is process-wide and not thread-safe, only use it in single-threaded programs */
+static int           _co_slab = 0;          /* Allocate cligen objects from slab */
+static cligen_arena *_co_slab_arena = NULL; /* Chunks of cligen objects */
+static cg_obj       *_co_slab_free = NULL;  /* Free-list, linked via first word of object */
+static uint64_t      _co_live = 0;          /* Allocated and not freed cligen objects */
+static uint64_t      _co_var_live = 0;      /* Allocated and not freed variable specs */
+
+/* Variable spec of all objects that are not variables. Read-only: assigning a variable
+ * field of a command is an error and faults */
+static const cg_varspec _co_varspec_none = {0,};
+#define CO_VARSPEC_NONE ((cg_varspec *)&_co_varspec_none)
+
 /*! Return number of created cligen objects
  */
 uint64_t
 co_count_get(void) 
 {
-    return _co_count;
+    return __atomic_load_n(&_co_count, __ATOMIC_RELAXED);
+}
+
+/*! Return statistics of live cligen objects
+ *
+ * Only variables allocate a variable spec. Compared to embedding the spec in every
+ * object, each object without one saves the size of the spec less the pointer to it.
+ * Shallow objects of expanded parse-trees are not included.
+ * @param[out] nr     Number of live objects, or NULL
+ * @param[out] nvar   Number of live variable specs, or NULL
+ * @param[out] saved  Bytes saved by not embedding the variable spec, or NULL
+ * @retval     0      OK
+ * @see co_count_get
+ */
+int
+co_stats_get(uint64_t *nr,
+	     uint64_t *nvar,
+	     uint64_t *saved)
+{
+    uint64_t live = __atomic_load_n(&_co_live, __ATOMIC_RELAXED);
+    uint64_t vars = __atomic_load_n(&_co_var_live, __ATOMIC_RELAXED);
+
+    if (nr)
+	*nr = live;
+    if (nvar)
+	*nvar = vars;
+    if (saved)
+	*saved = live*(sizeof(cg_varspec) - sizeof(cg_varspec *)) - vars*sizeof(cg_varspec);
+    return 0;
+}
+
+/*! Return 1 if cligen objects are allocated from typed slab
+ */
+int
+co_slab_get(void) 
+{
+    return _co_slab;
+}
+
+/*! Allocate cligen objects from a typed slab instead of individual malloc
+ *
+ * Objects are carved from large chunks and freed objects are kept on a free-list for
+ * re-use, the chunks are released when the slab is disabled.
+ * Can only be changed when no cligen objects exist, ie before any parsing or after all
+ * parse-trees have been freed.
+ * @param[in] enable  0: malloc/free each object (default), 1: use slab
+ * @retval    0       OK
+ * @retval   -1       Error, eg live objects exist (errno EBUSY)
+ * @note The slab is process-wide, not per handle: it holds the objects of all handles
+ *       and is not locked. Only enable it in programs that create and free cligen
+ *       objects from one thread. Objects are freed without a handle, eg by co_free,
+ *       so they can not be returned to a slab of their handle.
+ */
+int
+co_slab_set(int enable) 
+{
+    if (__atomic_load_n(&_co_live, __ATOMIC_RELAXED) != 0){
+	errno = EBUSY;
+	return -1;
+    }
+    if (!enable && _co_slab_arena){
+	cligen_arena_free(_co_slab_arena);
+	_co_slab_arena = NULL;
+	_co_slab_free = NULL;
+    }
+    _co_slab = enable;
+    return 0;
 }
 
 /* Access macro */
@@ -203,6 +286,25 @@ co_flags_get(cg_obj  *co,
     return (co->co_flags & flag) ? 1 : 0;
 }
 
+/*! Invalidate label masks of an object and of its ancestors
+ *
+ * Call when objects are added below co, or when labels (co_cvec) of co are changed.
+ * If an object has valid masks, so have all objects below it, therefore the walk
+ * stops at the first ancestor without valid masks. Removing objects leaves the masks 
+ * of ancestors a superset, which is safe.
+ * @param[in]  co   CLIgen object, or NULL
+ * @see cligen_parsetree_labels
+ */
+void
+co_labels_reset(cg_obj *co)
+{
+    if (co == NULL)
+	return;
+    co_flags_reset(co, CO_FLAGS_LABELS);
+    for (co = co_up(co); co && co_flags_get(co, CO_FLAGS_LABELS); co = co_up(co))
+	co_flags_reset(co, CO_FLAGS_LABELS);
+}
+
 int
 co_sets_get(cg_obj *co)
 {
@@ -234,6 +336,8 @@ int
 co_prefix_set(cg_obj *co,
 	      char   *prefix)
 {
+    if (co_intern_detach(co) < 0)
+	return -1;
     if (co->co_prefix != NULL){
 	free(co->co_prefix);
 	co->co_prefix = NULL;
@@ -243,6 +347,152 @@ co_prefix_set(cg_obj *co,
 	return -1;
     return 0;
 }
+
+/*! Replace strings and help vector of an object with shared copies in an intern table
+ *
+ * Affects co_command, co_prefix, co_helpvec and the variable strings co_show,
+ * co_expand_fn_str, co_translate_fn_str and co_choice. The object is marked with
+ * CO_FLAGS_INTERN: the fields are then read-only, copies share them and they are not freed
+ * by co_free. Use co_intern_detach before modifying any of them.
+ * On error, the object is unchanged.
+ * @param[in]  ci    Intern table
+ * @param[in]  co    CLIgen object
+ * @retval     0     OK
+ * @retval    -1     Error
+ * @see cligen_parsetree_intern
+ */
+int
+co_intern(struct cligen_intern *ci,
+	  cg_obj               *co)
+{
+    char *cmd = NULL;
+    char *prefix = NULL;
+    cvec *helpvec = NULL;
+    char *show = NULL;
+    char *expand = NULL;
+    char *translate = NULL;
+    char *choice = NULL;
+
+    if (co_flags_get(co, CO_FLAGS_INTERN|CO_FLAGS_SHALLOW))
+	return 0;
+    if ((co->co_command && (cmd = cligen_intern_str(ci, co->co_command)) == NULL) ||
+	(co->co_prefix && (prefix = cligen_intern_str(ci, co->co_prefix)) == NULL) ||
+	(co->co_helpvec && (helpvec = cligen_intern_cvec(ci, co->co_helpvec)) == NULL))
+	return -1;
+    if (co->co_type == CO_VARIABLE){
+	if ((co->co_show && (show = cligen_intern_str(ci, co->co_show)) == NULL) ||
+	    (co->co_expand_fn_str &&
+	     (expand = cligen_intern_str(ci, co->co_expand_fn_str)) == NULL) ||
+	    (co->co_translate_fn_str &&
+	     (translate = cligen_intern_str(ci, co->co_translate_fn_str)) == NULL) ||
+	    (co->co_choice && (choice = cligen_intern_str(ci, co->co_choice)) == NULL))
+	    return -1;
+    }
+    if (co->co_command)
+	free(co->co_command);
+    co->co_command = cmd;
+    if (co->co_prefix)
+	free(co->co_prefix);
+    co->co_prefix = prefix;
+    if (co->co_helpvec)
+	cvec_free(co->co_helpvec);
+    co->co_helpvec = helpvec;
+    if (co->co_type == CO_VARIABLE){
+	if (co->co_show)
+	    free(co->co_show);
+	co->co_show = show;
+	if (co->co_expand_fn_str)
+	    free(co->co_expand_fn_str);
+	co->co_expand_fn_str = expand;
+	if (co->co_translate_fn_str)
+	    free(co->co_translate_fn_str);
+	co->co_translate_fn_str = translate;
+	if (co->co_choice)
+	    free(co->co_choice);
+	co->co_choice = choice;
+    }
+    co_flags_set(co, CO_FLAGS_INTERN);
+    return 0;
+}
+
+/*! strdup that accepts NULL, for co_intern_detach
+ * @retval 0   OK, *dst is a copy of src or NULL
+ * @retval -1  Error
+ */
+static int
+intern_strdup(char  *src,
+	      char **dst)
+{
+    *dst = NULL;
+    if (src && (*dst = strdup(src)) == NULL){
+	fprintf(stderr, "%s: strdup: %s\n", __FUNCTION__, strerror(errno));
+	return -1;
+    }
+    return 0;
+}
+
+/*! Give an interned object private copies of its strings, so that they can be modified
+ *
+ * No-op if the object is not interned. On error, the object is unchanged.
+ * @param[in]  co    CLIgen object
+ * @retval     0     OK
+ * @retval    -1     Error
+ * @see co_intern
+ */
+int
+co_intern_detach(cg_obj *co)
+{
+    int   retval = -1;
+    char *cmd = NULL;
+    char *prefix = NULL;
+    cvec *helpvec = NULL;
+    char *show = NULL;
+    char *expand = NULL;
+    char *translate = NULL;
+    char *choice = NULL;
+
+    if (!co_flags_get(co, CO_FLAGS_INTERN))
+	return 0;
+    if (intern_strdup(co->co_command, &cmd) < 0 ||
+	intern_strdup(co->co_prefix, &prefix) < 0)
+	goto done;
+    if (co->co_helpvec && (helpvec = cvec_dup(co->co_helpvec)) == NULL)
+	goto done;
+    if (co->co_type == CO_VARIABLE){
+	if (intern_strdup(co->co_show, &show) < 0 ||
+	    intern_strdup(co->co_expand_fn_str, &expand) < 0 ||
+	    intern_strdup(co->co_translate_fn_str, &translate) < 0 ||
+	    intern_strdup(co->co_choice, &choice) < 0)
+	    goto done;
+	co->co_show = show;
+	co->co_expand_fn_str = expand;
+	co->co_translate_fn_str = translate;
+	co->co_choice = choice;
+    }
+    co->co_command = cmd;
+    co->co_prefix = prefix;
+    co->co_helpvec = helpvec;
+    co_flags_reset(co, CO_FLAGS_INTERN);
+    retval = 0;
+ done:
+    if (retval < 0){
+	if (cmd)
+	    free(cmd);
+	if (prefix)
+	    free(prefix);
+	if (helpvec)
+	    cvec_free(helpvec);
+	if (show)
+	    free(show);
+	if (expand)
+	    free(expand);
+	if (translate)
+	    free(translate);
+	if (choice)
+	    free(choice);
+    }
+    return retval;
+}
     
 /*! Assign a preference to a cligen variable object
  * Prefer more specific commands/variables  if you have to choose from several. 
@@ -387,6 +637,11 @@ co_pref(cg_obj *co,
 {
     int pref = 0;;
 
+    if (co_flags_get(co, CO_FLAGS_META)){
+	if (co->co_type == CO_COMMAND && co->co_ref && !exact)
+	    return 3;
+	return co->co_mpref;
+    }
     switch (co->co_type){
     case CO_COMMAND:
 	if (co->co_ref && !exact)
@@ -404,19 +659,99 @@ co_pref(cg_obj *co,
     return pref;
 }
 
-/*! Just malloc a CLIgen object. No other allocations allowed */
+/*! Compute match metadata of an object: command length, preference and rest flag
+ *
+ * Matching then compares integers instead of computing them for each token.
+ * The shortest unique prefix is set to the command length, cligen_parsetree_meta sets it
+ * from the siblings. Copies of the object keep the metadata. Reset CO_FLAGS_META if
+ * the command or type of the object is changed.
+ * @param[in]  co   CLIgen object
+ * @see cligen_parsetree_meta
+ */
+void
+co_meta_set(cg_obj *co)
+{
+    char  *cmd = co->co_command;
+    size_t len = 0;
+
+    co_flags_reset(co, CO_FLAGS_META|CO_FLAGS_REST);
+    if (cmd){
+	if (*cmd == '\"') /* escaped */
+	    cmd++;
+	len = strlen(cmd);
+    }
+    if (len > UINT32_MAX)
+	return;
+    co->co_mlen = len;
+    co->co_muniq = len > UINT16_MAX ? UINT16_MAX : len;
+    co->co_mpref = (co->co_type == CO_VARIABLE) ? cov_pref(co) : co_pref(co, 1);
+    if (co->co_type == CO_VARIABLE && co->co_vtype == CGV_REST)
+	co_flags_set(co, CO_FLAGS_REST);
+    co_flags_set(co, CO_FLAGS_META);
+}
+
+/*! Just malloc a CLIgen object. No other allocations allowed 
+ * @see co_slab_set
+ */
 cg_obj *
 co_new_only()
 {
     cg_obj *co;
 
-    if ((co = malloc(sizeof(cg_obj))) == NULL)
+    if (_co_slab){
+	if ((co = _co_slab_free) != NULL)
+	    _co_slab_free = *(cg_obj **)co;
+	else{
+	    if (_co_slab_arena == NULL &&
+		(_co_slab_arena = cligen_arena_new(CO_SLAB_CHUNK*sizeof(cg_obj))) == NULL)
+		return NULL;
+	    if ((co = cligen_arena_alloc(_co_slab_arena, sizeof(cg_obj))) == NULL)
+		return NULL;
+	}
+    }
+    else if ((co = malloc(sizeof(cg_obj))) == NULL)
 	return NULL;
     memset(co, 0, sizeof(cg_obj));
-    _co_count++;
+    co->co_var = CO_VARSPEC_NONE;
+    __atomic_add_fetch(&_co_count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&_co_live, 1, __ATOMIC_RELAXED);
     return co;
 }
 
+/*! Allocate a variable spec of an object, as a copy of an existing spec or empty
+ *
+ * The fields of a copied spec are assigned as is, the caller duplicates pointers it needs 
+ * to own (as in co_copy). If cs is the spec of an object that is not a variable, co 
+ * shares it.
+ * @param[in]  co    CLIgen object, its previous spec is not freed
+ * @param[in]  cs    Spec to copy, or NULL for an empty spec
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+int
+co_varspec_new(cg_obj     *co,
+	       cg_varspec *cs)
+{
+    cg_varspec *csn;
+
+    if (cs == CO_VARSPEC_NONE){
+	co->co_var = CO_VARSPEC_NONE;
+	return 0;
+    }
+    if ((csn = malloc(sizeof(*csn))) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	co->co_var = CO_VARSPEC_NONE;
+	return -1;
+    }
+    if (cs)
+	memcpy(csn, cs, sizeof(*csn));
+    else
+	memset(csn, 0, sizeof(*csn));
+    co->co_var = csn;
+    __atomic_add_fetch(&_co_var_live, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
 /*! Create new cligen parse-tree command object
  *
  * That is, a cligen parse-tree object with type == CO_COMMAND (not variable)
@@ -467,6 +802,10 @@ cov_new(enum cv_type cvtype,
 
     if ((co = co_new_only()) == NULL)
 	return NULL;
+    if (co_varspec_new(co, NULL) < 0){
+	co_free(co, 0);
+	return NULL;
+    }
     co->co_type    = CO_VARIABLE;
     co->co_vtype   = cvtype;
     if (parent)
@@ -482,30 +821,51 @@ cov_new(enum cv_type cvtype,
 
 /*! Copy a linked list of cg_obj callback objects
  *
- * Copy a linked list of cg_obj callback objects, including function pointer, 
- * function name,
+ * The list is not copied but shared: its first element gets one more reference.
+ * Elements, function names and argument vectors of a shared list are read-only.
+ * Release the copy with co_callbacks_free, and use co_callbacks_unshare before modifying it.
  *
  * @param[in]  cc0  The object to copy from
- * @param[out] ccn  Pointer to the object to copy to (is allocated)
- * @param[in]  cgv  if given, is a string that overrides the arg in cc.
+ * @param[out] ccn  Pointer to the object to copy to
  * @retval     0      OK
  * @retval     -1     Error
  */
 int
 co_callback_copy(struct cg_callback  *cc0, 
 		 struct cg_callback **ccn)
+{
+    if (cc0)
+	cc0->cc_shared++;
+    *ccn = cc0;
+    return 0;
+}
+
+/*! Deep copy a linked list of cg_obj callback objects
+ *
+ * Copy including function pointer, function name and arguments
+ * @param[in]  cc0  The object to copy from
+ * @param[out] ccn  Pointer to the object to copy to (is allocated)
+ * @retval     0      OK
+ * @retval     -1     Error
+ */
+static int
+co_callback_dup(struct cg_callback  *cc0, 
+		struct cg_callback **ccn)
 {
     struct cg_callback  *cc;
     struct cg_callback  *cc1;
     struct cg_callback **ccp;
 
     ccp = ccn;
+    *ccp = NULL;
     for (cc = cc0; cc; cc=cc->cc_next){
 	if ((cc1 = malloc(sizeof(*cc1))) == NULL){
 	    fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
 	    return -1;
 	}
 	memset(cc1, 0, sizeof(*cc1));
+	*ccp = cc1;
+	ccp = &cc1->cc_next;
 	cc1->cc_fn_vec = cc->cc_fn_vec;
 	if (cc->cc_fn_str)
 	    if ((cc1->cc_fn_str = strdup(cc->cc_fn_str)) == NULL){
@@ -514,12 +874,64 @@ co_callback_copy(struct cg_callback  *cc0,
 	    }
 	if (cc->cc_cvec && ((cc1->cc_cvec = cvec_dup(cc->cc_cvec)) == NULL))
 	    return -1;
-	*ccp = cc1;
-	ccp = &cc1->cc_next;
     }
     return 0;
 }
 
+/*! Make a linked list of callbacks private so that it can be modified
+ *
+ * The list is copied from the first element that is shared, since all elements after it
+ * are reachable from other lists as well.
+ * @param[in,out] ccn  Pointer to first element of list
+ * @retval        0    OK
+ * @retval       -1    Error
+ * @see co_callback_copy
+ */
+int
+co_callbacks_unshare(struct cg_callback **ccn)
+{
+    struct cg_callback  *cc;
+    struct cg_callback **ccp;
+
+    for (ccp = ccn; (cc = *ccp) != NULL; ccp = &cc->cc_next)
+	if (cc->cc_shared){
+	    if (co_callback_dup(cc, ccp) < 0){
+		co_callbacks_free(ccp);
+		*ccp = cc;
+		return -1;
+	    }
+	    cc->cc_shared--;
+	    break;
+	}
+    return 0;
+}
+
+/*! Release a linked list of callbacks, elements are freed when not shared by other lists
+ * @param[in,out] ccn  Pointer to first element of list, set to NULL
+ * @retval        0    OK
+ */
+int
+co_callbacks_free(struct cg_callback **ccn)
+{
+    struct cg_callback *cc;
+    struct cg_callback *ccnext;
+
+    for (cc = *ccn; cc; cc = ccnext){
+	if (cc->cc_shared){
+	    cc->cc_shared--;
+	    break;
+	}
+	ccnext = cc->cc_next;
+	if (cc->cc_cvec)	
+	    cvec_free(cc->cc_cvec);
+	if (cc->cc_fn_str)     
+	    free(cc->cc_fn_str);
+	free(cc);
+    }
+    *ccn = NULL;
+    return 0;
+}
+
 /*! Recursively copy a cligen object.
  *
  * @param[in]  co     The object to copy from
@@ -538,6 +950,7 @@ co_copy(cg_obj  *co,
     cg_obj     *con = NULL;
     parse_tree *pt;
     parse_tree *ptn;
+    int         intern;
 
     if ((con = co_new_only()) == NULL)
 	goto done;
@@ -545,18 +958,24 @@ co_copy(cg_obj  *co,
     con->co_ptvec = NULL;
     con->co_pt_len = 0;
     con->co_ref = NULL;
+    if (co_varspec_new(con, co->co_var) < 0)
+	goto done;
     if (co->co_treeref_orig)
 	con->co_treeref_orig = co->co_treeref_orig;
     else
 	con->co_treeref_orig = co;
     co_flags_reset(con, CO_FLAGS_MARK);
     co_flags_reset(con, CO_FLAGS_REFDONE);
+    co_flags_reset(con, CO_FLAGS_REFSHARED); /* The copy owns its sub-tree */
+    co_flags_reset(con, CO_FLAGS_SHALLOW);
     /* Replace all pointers */
     co_up_set(con, parent);
-    if (co->co_command)
+    /* Interned strings are shared, see co_intern */
+    intern = co_flags_get(co, CO_FLAGS_INTERN);
+    if (co->co_command && !intern)
 	if ((con->co_command = strdup(co->co_command)) == NULL)
 	    goto done;
-    if (co->co_prefix)
+    if (co->co_prefix && !intern)
 	if ((con->co_prefix = strdup(co->co_prefix)) == NULL)
 	    goto done;
     if (co_callback_copy(co->co_callbacks, &con->co_callbacks) < 0)
@@ -569,19 +988,19 @@ co_copy(cg_obj  *co,
 	if (co_pt_set(con, ptn) < 0)
 	    goto done;
     }
-    if (co->co_helpvec)
+    if (co->co_helpvec && !intern)
 	if ((con->co_helpvec = cvec_dup(co->co_helpvec)) == NULL)
 	    goto done;
     if (co_value_set(con, co->co_value) < 0) /* XXX: free p co->co_value? */
 	goto done;
     if (co->co_type == CO_VARIABLE){
-	if (co->co_expand_fn_str)
+	if (co->co_expand_fn_str && !intern)
 	    if ((con->co_expand_fn_str = strdup(co->co_expand_fn_str)) == NULL)
 		goto done;
-	if (co->co_translate_fn_str)
+	if (co->co_translate_fn_str && !intern)
 	    if ((con->co_translate_fn_str = strdup(co->co_translate_fn_str)) == NULL)
 		goto done;
-	if (co->co_show)
+	if (co->co_show && !intern)
 	    if ((con->co_show = strdup(co->co_show)) == NULL)
 		goto done;
 	if (co->co_rangecvv_low)
@@ -593,7 +1012,7 @@ co_copy(cg_obj  *co,
 	if (co->co_expand_fn_vec)
 	    if ((con->co_expand_fn_vec = cvec_dup(co->co_expand_fn_vec)) == NULL)
 		goto done;
-	if (co->co_choice){
+	if (co->co_choice && !intern){
 	    if ((con->co_choice = strdup(co->co_choice)) == NULL)
 		goto done;
 	}
@@ -601,6 +1020,10 @@ co_copy(cg_obj  *co,
 	    if ((con->co_regex = cvec_dup(co->co_regex)) == NULL)
 		goto done;
 	}
+	con->co_regex_cache = NULL; /* Compiled on first use */
+	con->co_ranges = NULL;
+	con->co_choicevec = NULL;
+	con->co_choicelen = 0;
     } /* VARIABLE */
     *conp = con;
     retval = 0;
@@ -628,15 +1051,14 @@ static inline int
 str_cmp(char *s1, 
 	char *s2)
 {
-    if (s1 == NULL && s2 == NULL) 
+    if (s1 == s2) /* Also interned strings, see co_intern */
 	return 0;
     if (s1 == NULL) /* empty string first */
 	return -1;
     if (s2 == NULL)
 	return 1;
-    /*
-     * XXX: the cligen handler code uses NULL here which is wrong, but those
-     * options are for now global settings.
+    /* No handle here: the settings of the handle bound to the thread are used,
+     * see cligen_thread_set
      */
 #ifdef  HAVE_STRVERSCMP
     if (cligen_lexicalorder(NULL))
@@ -694,7 +1116,7 @@ co_eq(cg_obj *co1,
 	    goto done;
 	}   
 	/* Here one is command and one is variable */
-	eq = strcmp(co1->co_command, co2->co_command);
+	eq = co1->co_command == co2->co_command ? 0 : strcmp(co1->co_command, co2->co_command);
 	goto done;
     }
     switch (co1->co_type){
@@ -771,6 +1193,96 @@ co_eq(cg_obj *co1,
     return eq;
 }
 
+/*! Check if two strings are equal, both can be NULL
+ */
+static int
+str_same(char *s1,
+	 char *s2)
+{
+    if (s1 == s2)
+	return 1;
+    if (s1 == NULL || s2 == NULL)
+	return 0;
+    return strcmp(s1, s2) == 0;
+}
+
+/*! Check if two variable vectors have the same names and values, both can be NULL
+ */
+static int
+cvec_same(cvec *cvv1,
+	  cvec *cvv2)
+{
+    cg_var *cv1;
+    cg_var *cv2;
+    int     i;
+
+    if (cvv1 == cvv2)
+	return 1;
+    if (cvv1 == NULL || cvv2 == NULL || cvec_len(cvv1) != cvec_len(cvv2))
+	return 0;
+    for (i=0; i<cvec_len(cvv1); i++){
+	cv1 = cvec_i(cvv1, i);
+	cv2 = cvec_i(cvv2, i);
+	if (!str_same(cv_name_get(cv1), cv_name_get(cv2)) || cv_cmp(cv1, cv2) != 0)
+	    return 0;
+    }
+    return 1;
+}
+
+/*! Check if two cligen objects have the same attributes
+ *
+ * Stricter than co_eq: also names of variables, prefix, help texts, callbacks, local
+ * variables and all variable options are compared. Sub-trees are not compared.
+ * Resolved function pointers are only compared if there is no function name.
+ * @param[in]  co1
+ * @param[in]  co2
+ * @retval     1   Same
+ * @retval     0   Not same
+ * @see co_eq
+ * @see cligen_parsetree_update
+ */
+int
+co_same(cg_obj *co1,
+	cg_obj *co2)
+{
+    struct cg_callback *cc1;
+    struct cg_callback *cc2;
+    uint32_t            mask = CO_FLAGS_HIDE|CO_FLAGS_HIDE_DATABASE|CO_FLAGS_OPTION;
+
+    if (co1->co_type != co2->co_type ||
+	(co1->co_flags & mask) != (co2->co_flags & mask) ||
+	!str_same(co1->co_command, co2->co_command) ||
+	!str_same(co1->co_prefix, co2->co_prefix) ||
+	!cvec_same(co1->co_helpvec, co2->co_helpvec) ||
+	!cvec_same(co1->co_cvec, co2->co_cvec))
+	return 0;
+    for (cc1 = co1->co_callbacks, cc2 = co2->co_callbacks;
+	 cc1 && cc2;
+	 cc1 = cc1->cc_next, cc2 = cc2->cc_next){
+	if (!str_same(cc1->cc_fn_str, cc2->cc_fn_str) ||
+	    (cc1->cc_fn_str == NULL && cc1->cc_fn_vec != cc2->cc_fn_vec) ||
+	    !cvec_same(cc1->cc_cvec, cc2->cc_cvec))
+	    return 0;
+    }
+    if (cc1 || cc2)
+	return 0;
+    if (co1->co_type != CO_VARIABLE)
+	return 1;
+    if (co1->co_vtype != co2->co_vtype ||
+	co1->co_dec64_n != co2->co_dec64_n ||
+	co1->co_rangelen != co2->co_rangelen ||
+	!str_same(co1->co_show, co2->co_show) ||
+	!str_same(co1->co_expand_fn_str, co2->co_expand_fn_str) ||
+	!cvec_same(co1->co_expand_fn_vec, co2->co_expand_fn_vec) ||
+	!str_same(co1->co_translate_fn_str, co2->co_translate_fn_str) ||
+	!str_same(co1->co_choice, co2->co_choice) ||
+	!cvec_same(co1->co_rangecvv_low, co2->co_rangecvv_low) ||
+	!cvec_same(co1->co_rangecvv_upp, co2->co_rangecvv_upp) ||
+	!cvec_same(co1->co_regex, co2->co_regex))
+	return 0;
+    return 1;
+}
+
 /*! Free an individual syntax node (cg_obj).
  * @param[in]  co         CLIgen object
  * @param[in]  recursive  If set free recursive, if 0 free only cligen object, and parsetree
@@ -785,9 +1297,23 @@ int
 co_free(cg_obj *co, 
 	int     recursive)
 {
-    struct cg_callback *cc;
     parse_tree         *pt;
 
+    /* Shares all fields with original, and is freed with its parse-tree block */
+    if (co_flags_get(co, CO_FLAGS_SHALLOW))
+	return 0;
+    /* Owned by intern table, see co_intern */
+    if (co_flags_get(co, CO_FLAGS_INTERN)){
+	co->co_helpvec = NULL;
+	co->co_command = NULL;
+	co->co_prefix = NULL;
+	if (co->co_type == CO_VARIABLE){
+	    co->co_expand_fn_str = NULL;
+	    co->co_translate_fn_str = NULL;
+	    co->co_show = NULL;
+	    co->co_choice = NULL;
+	}
+    }
     if (co->co_helpvec) 
 	cvec_free(co->co_helpvec);
     if (co->co_command)
@@ -798,14 +1324,7 @@ co_free(cg_obj *co,
 	free(co->co_value);
     if (co->co_cvec)
 	cvec_free(co->co_cvec);
-    while ((cc = co->co_callbacks) != NULL){
-	if (cc->cc_cvec)	
-	    cvec_free(cc->cc_cvec);
-	if (cc->cc_fn_str)     
-	    free(cc->cc_fn_str);
-	co->co_callbacks = cc->cc_next;
-	free(cc);
-    }
+    co_callbacks_free(&co->co_callbacks);
     if (co->co_type == CO_VARIABLE){
 	if (co->co_expand_fn_str)
 	    free(co->co_expand_fn_str);
@@ -819,17 +1338,35 @@ co_free(cg_obj *co,
 	    free(co->co_choice);
 	if (co->co_regex)
 	    cvec_free(co->co_regex);
+	if (co->co_regex_cache)
+	    cligen_regex_cache_free(co->co_regex_cache);
 	if (co->co_rangecvv_low)
 	    cvec_free(co->co_rangecvv_low);
 	if (co->co_rangecvv_upp)
 	    cvec_free(co->co_rangecvv_upp);
+	if (co->co_ranges)
+	    cv_range_free(co->co_ranges);
+	if (co->co_choicevec)
+	    free(co->co_choicevec);
     }
-    if (recursive && (pt = co_pt_get(co)) != NULL){ 
+    /* A shared treeref sub-tree is owned by the referenced tree */
+    if (recursive && !co_flags_get(co, CO_FLAGS_REFSHARED) &&
+	(pt = co_pt_get(co)) != NULL){ 
 	pt_free(pt, 1); /* recursive */ 
     }
     if (co->co_ptvec != NULL)
 	free(co->co_ptvec);
-    free(co);
+    if (co->co_var != CO_VARSPEC_NONE){
+	free(co->co_var);
+	__atomic_sub_fetch(&_co_var_live, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_sub_fetch(&_co_live, 1, __ATOMIC_RELAXED);
+    if (_co_slab){ /* Put on free-list */
+	*(cg_obj **)co = _co_slab_free;
+	_co_slab_free = co;
+    }
+    else
+	free(co);
     return 0;
 }
 
@@ -936,11 +1473,13 @@ co_insert(parse_tree *pt,
 	if (co1 && co2 && co_eq(co1, co2)==0){
 	    cligen_parsetree_merge(co_pt_get(co2), co2, co_pt_get(co1));
 	    co_free(co1, 1);
+	    co_labels_reset(co2); /* Caller may also add labels to co2 */
 	    return co2;
 	}
     }
     if (pt_vec_i_insert(pt, pos, co1) < 0)
 	return NULL;
+    co_labels_reset(co1);
     return co1;
 }
 
@@ -984,6 +1523,69 @@ co_value_set(cg_obj *co,
     return 0;
 }
 
+/*! Help function to qsort choices as keywords of an index (strcmp)
+ */
+static int
+choice_cmp(const void *arg1,
+	   const void *arg2)
+{
+    return strcmp(*(char **)arg1, *(char **)arg2);
+}
+
+/*! Compile the choices of a choice variable into a sorted vector
+ *
+ * The choice string "a|b|c" (or "a,b,c") is split once instead of on every expansion,
+ * pt_expand inserts the choices as commands referencing the strings of the vector.
+ * The choices are sorted as keywords of an index. Vector and strings are allocated
+ * in one block, which is freed with the variable.
+ * Called when a choice is parsed, otherwise on first expansion.
+ * @param[in]  co   Choice variable
+ * @retval     0    OK
+ * @retval    -1    Error
+ * @see pt_expand
+ */
+int
+co_choice_compile(cg_obj *co)
+{
+    char  **vec;
+    char   *s;
+    char   *c;
+    size_t  len;
+    int     n;
+    int     i;
+
+    if (co == NULL || co->co_type != CO_VARIABLE){
+	errno = EINVAL;
+	return -1;
+    }
+    if (co->co_choicevec){
+	free(co->co_choicevec);
+	co->co_choicevec = NULL;
+	co->co_choicelen = 0;
+    }
+    if (co->co_choice == NULL)
+	return 0;
+    /* One more choice than delimiters */
+    n = 1;
+    for (c = co->co_choice; *c != '\0'; c++)
+	if (*c == ',' || *c == '|')
+	    n++;
+    len = strlen(co->co_choice) + 1;
+    if ((vec = malloc(n*sizeof(char *) + len)) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	return -1;
+    }
+    s = (char *)(vec + n);
+    memcpy(s, co->co_choice, len);
+    i = 0;
+    while ((c = strsep(&s, ",|")) != NULL)
+	vec[i++] = c;
+    qsort(vec, n, sizeof(char *), choice_cmp);
+    co->co_choicevec = vec;
+    co->co_choicelen = n;
+    return 0;
+}
+
 /*! co is a terminal command, and therefore should be printed with a ';' 
  * 
  * It contains a child that is of type "EMPTY".
@@ -1006,6 +1608,113 @@ co_terminal(cg_obj *co)
     return 0;
 }
 
+/*! Return sum of all categories of memory sizes
+ * @param[in]  ms   Sizes by category
+ */
+size_t
+cligen_msize_total(cligen_msize *ms)
+{
+    return ms->ms_nodes + ms->ms_strings + ms->ms_cvecs + ms->ms_callbacks + ms->ms_varspecs;
+}
+
+/*! Return the alloced memory of a variable spec
+ * @param[in]  co   CLIgen variable object
+ * @param[in]  own  Strings are not owned by intern table
+ */
+static size_t
+co_varspec_size(cg_obj *co,
+		int     own)
+{
+    size_t sz = sizeof(cg_varspec);
+
+    if (own){
+	if (co->co_show)
+	    sz += strlen(co->co_show)+1;
+	if (co->co_expand_fn_str)
+	    sz += strlen(co->co_expand_fn_str)+1;
+	if (co->co_translate_fn_str)
+	    sz += strlen(co->co_translate_fn_str)+1;
+	if (co->co_choice)
+	    sz += strlen(co->co_choice)+1;
+    }
+    if (co->co_expand_fn_vec)
+	sz += cvec_size(co->co_expand_fn_vec);
+    if (co->co_choicevec)
+	sz += co->co_choicelen*sizeof(char *) + (co->co_choice ? strlen(co->co_choice)+1 : 0);
+    if (co->co_rangecvv_low)
+	sz += cvec_size(co->co_rangecvv_low);
+    if (co->co_rangecvv_upp)
+	sz += cvec_size(co->co_rangecvv_upp);
+    if (co->co_ranges)
+	sz += cv_range_size(co->co_ranges);
+    if (co->co_regex)
+	sz += cvec_size(co->co_regex);
+    return sz;
+}
+
+/*! Return the alloced memory of a CLIgen object and its sub-tree, by category
+ *
+ * Memory shared with other objects is counted once: shallow copies in expanded trees
+ * count only their struct, shared sub-trees of tree references and strings owned by the
+ * intern table (see cligen_intern_size) are not counted, and a callback list shared by
+ * n objects counts 1/n in each. Compiled regular expressions are not counted.
+ * @param[in]     co   CLIgen object
+ * @param[in,out] ms   Sizes by category are added to this, or NULL
+ * @retval        sz   Size of object and sub-tree in bytes
+ * @see pt_size
+ */
+size_t
+co_size(cg_obj       *co,
+	cligen_msize *ms)
+{
+    cligen_msize        ms0 = {0,};
+    struct cg_callback *cc;
+    parse_tree         *pt;
+    size_t              sz0;
+    size_t              sz;
+    int                 own;
+
+    if (ms == NULL)
+	ms = &ms0;
+    sz0 = cligen_msize_total(ms);
+    ms->ms_objects++;
+    ms->ms_nodes += sizeof(cg_obj);
+    if (co_flags_get(co, CO_FLAGS_SHALLOW))
+	goto done;
+    own = !co_flags_get(co, CO_FLAGS_INTERN);
+    ms->ms_nodes += co->co_pt_len*sizeof(parse_tree *);
+    if (own){
+	if (co->co_command)
+	    ms->ms_strings += strlen(co->co_command)+1;
+	if (co->co_prefix)
+	    ms->ms_strings += strlen(co->co_prefix)+1;
+	if (co->co_helpvec)
+	    ms->ms_cvecs += cvec_size(co->co_helpvec);
+    }
+    if (co->co_value)
+	ms->ms_strings += strlen(co->co_value)+1;
+    if (co->co_cvec)
+	ms->ms_cvecs += cvec_size(co->co_cvec);
+    if ((cc = co->co_callbacks) != NULL){
+	sz = 0;
+	for (; cc; cc = cc->cc_next){
+	    sz += sizeof(*cc);
+	    if (cc->cc_fn_str)
+		sz += strlen(cc->cc_fn_str)+1;
+	    if (cc->cc_cvec)
+		sz += cvec_size(cc->cc_cvec);
+	}
+	ms->ms_callbacks += sz/(co->co_callbacks->cc_shared+1);
+    }
+    if (co->co_var != CO_VARSPEC_NONE)
+	ms->ms_varspecs += co_varspec_size(co, own);
+    if (!co_flags_get(co, CO_FLAGS_REFSHARED) &&
+	(pt = co_pt_get(co)) != NULL)
+	pt_size(pt, ms);
+ done:
+    return cligen_msize_total(ms) - sz0;
+}
+
 /*! Create (malloc) a reason string using var-list args
  * General purpose routine but used for error handling.
  * @param[in]  fmt     Format string followed by a variable list (as in  printf) 
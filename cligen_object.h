@@ -74,6 +74,7 @@ typedef int (cgv_fnstype_t)(cligen_handle h, cvec *vars, cvec *argv);
 /* Expand callback function for vector arguments (should be in cligen_expand.h) 
    Returns 0 if handled expand, that is, it returned commands for 'name'
            1 if did not handle expand 
+           CLIGEN_EXPAND_PENDING if commands are delivered later with cligen_expand_add
           -1 on error.
 */
 typedef int (expandv_cb)(cligen_handle h,       /* handler: cligen or userhandle */
@@ -103,12 +104,16 @@ typedef int (cligen_interrupt_cb_t)(cligen_handle h);
 typedef struct parse_tree parse_tree;
 
 /*! A CLIgen object may have one or several callbacks. This type defines one callback
+ *
+ * Lists of callbacks are shared by copies of an object and should be treated as
+ * read-only, use co_callbacks_unshare before modifying a list.
  */
 struct cg_callback  { /* Linked list of command callbacks */
     struct  cg_callback *cc_next;    /**< Next callback in list.  */
     cgv_fnstype_t       *cc_fn_vec;  /**< callback/function pointer using cvec.  */
     char                *cc_fn_str;  /**< callback/function name. malloced */
     cvec                *cc_cvec;    /**< callback/function arguments */
+    int                  cc_shared;  /**< References in addition to the first */
 };
 
 /*
@@ -125,6 +130,8 @@ struct cg_varspec{
     char           *cgs_translate_fn_str; /* translate function string */
     translate_cb_t *cgs_translate_fn;  /* variable translate function */
     char           *cgs_choice;        /* list of choices */
+    char          **cgs_choicevec;     /* Sorted choices, see co_choice_compile */
+    int             cgs_choicelen;     /* Length of cgs_choicevec */
     /* int range / str length of cvv_low/upper bound intervals. Note, the two 
      * range-cvvs must have the same length. */
     int             cgs_rangelen;      
@@ -132,7 +139,9 @@ struct cg_varspec{
      * it means the min value of the type (eg <a:int32 range[40]> */
     cvec           *cgs_rangecvv_low;  
     cvec           *cgs_rangecvv_upp;  /* array of upper bound of intervals */
+    struct cligen_ranges *cgs_ranges;  /* Compiled intervals, see cv_range_compile */
     cvec           *cgs_regex;         /* List of regular expressions */
+    void           *cgs_regex_cache;   /* Compiled cgs_regex, see match_regexp_cache */
     uint8_t         cgs_dec64_n;       /* negative decimal exponential 1..18 */
 };
 typedef struct cg_varspec cg_varspec;
@@ -140,6 +149,9 @@ typedef struct cg_varspec cg_varspec;
 /* Default number of fraction digits if type is DEC64 */
 #define CGV_DEC64_N_DEFAULT 2
 
+/* Number of cligen objects per slab chunk, see co_slab_set */
+#define CO_SLAB_CHUNK 1024
+
 /* General purpose flags for cg_obj co_flags type 
  */
 #define CO_FLAGS_HIDE      0x01  /* Don't show in help/completion */
@@ -148,10 +160,21 @@ typedef struct cg_varspec cg_varspec;
 #define CO_FLAGS_TREEREF   0x04  /* This node is top of expanded sub-tree */
 #define CO_FLAGS_REFDONE   0x08  /* This reference has already been expanded */
 #define CO_FLAGS_OPTION    0x10  /* Generated from optional [] */
-#define CO_FLAGS_MATCH     0x20  /* For sets: avoid selecting same more than once */
+#define CO_FLAGS_MATCH     0x20  /* Not used, matched set objects are kept in match state */
+#define CO_FLAGS_REFSHARED 0x80  /* Treeref top node sharing sub-tree with referenced tree */
+#define CO_FLAGS_SHALLOW   0x100 /* Shallow copy in expanded tree, shares all fields */
+#define CO_FLAGS_INTERN    0x200 /* Strings and helpvec are owned by intern table, see co_intern */
+#define CO_FLAGS_LABELS    0x400 /* co_labels and co_labels_below are valid, see co_labels_reset */
+#define CO_FLAGS_META      0x800 /* co_mlen, co_mpref and co_muniq are valid, see co_meta_set */
+#define CO_FLAGS_REST      0x1000 /* Variable of type rest, if CO_FLAGS_META */
+
+/* Bit of co_labels set in tree references, other bits are label ids, see cligen_label_id */
+#define CO_LABELS_REFERENCE ((uint64_t)1 << 63)
 
 /*! cligen gen object is a parse-tree node. A cg_obj is either a command or a variable
- * A cg_obj 
+ * Fields used when matching come first, so that traversing a parse-tree vector touches one
+ * cache line per child. The variable specification is allocated out of line, only for
+ * variables: all other objects share a read-only empty spec, see co_stats_get.
  * @code
  *      o <--- cg_obj
  *      ^
@@ -164,57 +187,77 @@ typedef struct cg_varspec cg_varspec;
  * @endcode
  */
 struct cg_obj{
-    parse_tree        **co_ptvec;     /* Child parse-tree (see co_next macro below) */
-    int                 co_pt_len;    /* Length of parse-tree vector */
-    struct cg_obj      *co_prev;      /* Parent */
     enum cg_objtype     co_type;      /* Type of object: command, variable or tree
 					 reference */
+    uint32_t            co_flags;     /* General purpose flags, see CO_FLAGS_HIDE and others above */
+    uint32_t            co_mlen;      /* Length of command without escape, if CO_FLAGS_META */
+    int16_t             co_mpref;     /* Preference, see co_pref, if CO_FLAGS_META */
+    uint16_t            co_muniq;     /* Shortest unique prefix among keyword siblings */
     char               *co_command;   /* malloc:ed matching string / name or type */
-    char               *co_prefix;    /* Prefix. Can be used in cases where co_command is not unique */
+    parse_tree        **co_ptvec;     /* Child parse-tree (see co_next macro below) */
+    int                 co_pt_len;    /* Length of parse-tree vector */
+    struct cg_obj      *co_prev;      /* Parent */
+    struct cg_obj      *co_ref;       /* Ref to original (if this is expanded) */
+    struct cg_varspec  *co_var;       /* Variable spec if CO_VARIABLE, else shared empty spec */
+    /* Fields below are not used in matching of commands */
+    cvec               *co_helpvec;   /* Vector of CLIgen helptexts */
     struct cg_callback *co_callbacks; /* linked list of callbacks and arguments */
     cvec               *co_cvec;      /* List of cligen local variables, such as "hide" 
                                        * Special labels on @treerefs are: 
                                        *     @add:<label> and @remove:<label>
 				       * which control tree ref macro expansion
 				       */
-    cvec               *co_helpvec;   /* Vector of CLIgen helptexts */
-    uint32_t            co_flags;     /* General purpose flags, see CO_FLAGS_HIDE and others above */
-    struct cg_obj      *co_ref;       /* Ref to original (if this is expanded) */
+    uint64_t            co_labels;    /* Mask of label ids of co_cvec, if CO_FLAGS_LABELS */
+    uint64_t            co_labels_below; /* Union of co_labels of all objects below */
+    char               *co_prefix;    /* Prefix. Can be used in cases where co_command is not unique */
     struct cg_obj      *co_treeref_orig; /* Ref to original (if this is a tree reference) */
     char               *co_value;     /* Expanded value can be a string with a constant. 
 					 Store the constant in the original variable. */
-    union {                           /* depends on co_type: */
-	struct {        } cou_cmd;    /* CO_COMMAND */
-	struct cg_varspec cou_var;    /* CO_VARIABLE */
-	//	struct cg_varspec cou_tree;   /* CO_REFERENCE */
-    } u;
 };
 
 typedef struct cg_obj cg_obj; 
 
+/*! Memory of parse-trees and objects by category in bytes, see co_size and pt_size */
+typedef struct cligen_msize{
+    size_t   ms_nodes;     /* Objects, parse-tree structs, child vectors and keyword indexes */
+    size_t   ms_strings;   /* Command, prefix, expanded value and tree name strings */
+    size_t   ms_cvecs;     /* Help vectors and local variables (co_cvec) */
+    size_t   ms_callbacks; /* Callbacks with function names and arguments */
+    size_t   ms_varspecs;  /* Variable specs with their strings, ranges, regexps and choices */
+    uint64_t ms_objects;   /* Number of objects */
+} cligen_msize;
+
 /* Access macro to cligen object variable specification */
-#define co2varspec(co)  &(co)->u.cou_var
-
-/* Access fields for code traversing parse tree */
-#define co_vtype         u.cou_var.cgs_vtype
-#define co_show          u.cou_var.cgs_show
-#define co_expand_fn_str u.cou_var.cgs_expand_fn_str
-#define co_expandv_fn  	 u.cou_var.cgs_expandv_fn
-#define co_expand_fn_vec u.cou_var.cgs_expand_fn_vec
-#define co_translate_fn_str u.cou_var.cgs_translate_fn_str
-#define co_translate_fn  u.cou_var.cgs_translate_fn
-#define co_choice	 u.cou_var.cgs_choice
-#define co_keyword	 u.cou_var.cgs_choice
-#define co_rangelen	 u.cou_var.cgs_rangelen 
-#define co_rangecvv_low	 u.cou_var.cgs_rangecvv_low
-#define co_rangecvv_upp  u.cou_var.cgs_rangecvv_upp
-#define co_regex         u.cou_var.cgs_regex
-#define co_dec64_n       u.cou_var.cgs_dec64_n
+#define co2varspec(co)  ((co)->co_var)
+
+/* Access fields for code traversing parse tree. 
+ * Only assign to them in variables (CO_VARIABLE), the spec of other objects is read-only */
+#define co_vtype         co_var->cgs_vtype
+#define co_show          co_var->cgs_show
+#define co_expand_fn_str co_var->cgs_expand_fn_str
+#define co_expandv_fn  	 co_var->cgs_expandv_fn
+#define co_expand_fn_vec co_var->cgs_expand_fn_vec
+#define co_translate_fn_str co_var->cgs_translate_fn_str
+#define co_translate_fn  co_var->cgs_translate_fn
+#define co_choice	 co_var->cgs_choice
+#define co_keyword	 co_var->cgs_choice
+#define co_choicevec	 co_var->cgs_choicevec
+#define co_choicelen	 co_var->cgs_choicelen
+#define co_rangelen	 co_var->cgs_rangelen 
+#define co_rangecvv_low	 co_var->cgs_rangecvv_low
+#define co_rangecvv_upp  co_var->cgs_rangecvv_upp
+#define co_ranges        co_var->cgs_ranges
+#define co_regex         co_var->cgs_regex
+#define co_regex_cache   co_var->cgs_regex_cache
+#define co_dec64_n       co_var->cgs_dec64_n
 
 /*
  * Prototypes
  */
 uint64_t    co_count_get(void);
+int         co_stats_get(uint64_t *nr, uint64_t *nvar, uint64_t *saved);
+int         co_slab_get(void);
+int         co_slab_set(int enable);
 cg_obj*     co_up(cg_obj *co);
 int         co_up_set(cg_obj *co, cg_obj *cop);
 cg_obj*     co_top(cg_obj *co0);
@@ -222,24 +265,36 @@ parse_tree *co_pt_get(cg_obj *co);
 int         co_pt_set(cg_obj *co, parse_tree *pt);
 int         co_pt_clear(cg_obj *co);
 void        co_flags_set(cg_obj *co, uint32_t flag);
+void        co_labels_reset(cg_obj *co);
+void        co_meta_set(cg_obj *co);
 void        co_flags_reset(cg_obj *co, uint32_t flag);
 int         co_flags_get(cg_obj *co, uint32_t flag);
 int         co_sets_get(cg_obj *co);
 void        co_sets_set(cg_obj *co, int sets);
 char       *co_prefix_get(cg_obj *co);
 int         co_prefix_set(cg_obj *co, char *prefix);
+struct cligen_intern;  /* Forward declaration, see cligen_intern.h */
+int         co_intern(struct cligen_intern *ci, cg_obj *co);
+int         co_intern_detach(cg_obj *co);
 cg_obj     *co_new_only(void);
+int         co_varspec_new(cg_obj *co, cg_varspec *cs);
 cg_obj     *co_new(char *cmd, cg_obj *prev);
 cg_obj     *cov_new(enum cv_type cvtype, cg_obj *prev);
 int         co_pref(cg_obj *co, int exact);
 int         co_callback_copy(struct cg_callback *cc0, struct cg_callback **ccn);
+int         co_callbacks_unshare(struct cg_callback **ccn);
+int         co_callbacks_free(struct cg_callback **ccn);
 int         co_copy(cg_obj *co, cg_obj *parent, cg_obj **conp);
 int         co_eq(cg_obj *co1, cg_obj *co2);
+int         co_same(cg_obj *co1, cg_obj *co2);
 int         co_free(cg_obj *co, int recursive);
 cg_obj     *co_insert(parse_tree *pt, cg_obj *co);
 cg_obj     *co_find_one(parse_tree *pt, char *name);
 int         co_value_set(cg_obj *co, char *str);
+int         co_choice_compile(cg_obj *co);
 int         co_terminal(cg_obj *co);
+size_t      co_size(cg_obj *co, cligen_msize *ms);
+size_t      cligen_msize_total(cligen_msize *ms);
 #if defined(__GNUC__) && __GNUC__ >= 3
 char       *cligen_reason(const char *fmt, ...) __attribute__ ((format (printf, 1, 2)));
 #else
@@ -68,6 +68,8 @@ struct cligen_parse_yacc{
     char                 *cy_treename;     /* Name of syntax (for error string) */
     int                   cy_linenum;      /* Number of \n in parsed buffer */
     char                 *cy_parse_string; /* original (copy of) parse string */
+    size_t                cy_parse_len;    /* If set, length of cy_parse_string which ends
+					      with two NULs and is scanned in place */
     void                 *cy_lexbuf;       /* internal parse buffer from lex */
     cvec                 *cy_globals;      /* global variables after parsing */
     cvec                 *cy_cvec;         /* local variables (per-command) */
@@ -628,7 +628,8 @@ cgy_comment(cligen_yacc *cy,
     for (cl = cy->cy_list; cl; cl = cl->cl_next){
 	co = cl->cl_obj;
 	if (co->co_helpvec == NULL && /* Why would it already have a comment? */
-	    cligen_txt2cvv(comment, &co->co_helpvec) < 0){ /* Or just append to existing? */
+	    (co_intern_detach(co) < 0 ||
+	     cligen_txt2cvv(comment, &co->co_helpvec) < 0)){ /* Or just append to existing? */
 	    cligen_parseerror1(cy, "Allocating comment");
 	    return -1;
 	}
@@ -675,7 +676,6 @@ cgy_terminal(cligen_yacc *cy)
     struct cgy_list    *cl; 
     cg_obj             *co; 
     int                 i;
-    struct cg_callback *cc;
     struct cg_callback **ccp;
     int                 retval = -1;
     parse_tree         *ptc;
@@ -683,15 +683,12 @@ cgy_terminal(cligen_yacc *cy)
     
     for (cl = cy->cy_list; cl; cl = cl->cl_next){
 	co  = cl->cl_obj;
-	if (cy->cy_callbacks){ /* callbacks */
+	if (cy->cy_callbacks){ /* callbacks, shared by all objects */
+	    if (co_callbacks_unshare(&co->co_callbacks) < 0)
+		goto done;
 	    ccp = &co->co_callbacks;
 	    while (*ccp != NULL)
 		ccp = &((*ccp)->cc_next);
-#if 1 /* Optimization: dont copy the last element */
-	    if (cl->cl_next == NULL)
-		*ccp = cy->cy_callbacks;		
-	    else
-#endif
 	    if (co_callback_copy(cy->cy_callbacks, ccp) < 0)
 		goto done;
 	}
@@ -732,19 +729,7 @@ cgy_terminal(cligen_yacc *cy)
 	}
     }
     /* cleanup */
-#if 1 /* Optimization: dont copy first */
-    if ((cl = cy->cy_list) != NULL)
-	cy->cy_callbacks = NULL;
-    else
-#endif
-    while ((cc = cy->cy_callbacks) != NULL){
-	if (cc->cc_cvec)	
-	    cvec_free(cc->cc_cvec);
-	if (cc->cc_fn_str)	
-	    free(cc->cc_fn_str);
-	cy->cy_callbacks = cc->cc_next;
-	free(cc);
-    }
+    co_callbacks_free(&cy->cy_callbacks);
     if (cy->cy_cvec){
 	cvec_free(cy->cy_cvec);
 	cy->cy_cvec = NULL;
@@ -1062,6 +1047,8 @@ cg_range_create(cligen_yacc *cy,
     
     /* Then increment range vector length */
     yv->co_rangelen++;
+    if (cv_range_compile(yv->co_var) < 0)
+	goto done;
     retval = 0;
   done:
     if (cv1)
@@ -1350,10 +1337,14 @@ keypair     : NAME '(' ')' { expand_fn(_cy, $1); }
             | V_FRACTION_DIGITS ':' NUMBER { 
 		if (cg_dec64_n(_cy, $3) < 0) YYERROR; free($3); 
 	      }
-            | V_CHOICE choices { _CY->cy_var->co_choice = $2; }
+            | V_CHOICE choices { 
+		_CY->cy_var->co_choice = $2; 
+		if (co_choice_compile(_CY->cy_var) < 0) YYERROR;
+	      }
             | V_KEYWORD ':' NAME { 
 		_CY->cy_var->co_keyword = $3;  
 		_CY->cy_var->co_vtype=CGV_STRING; 
+		if (co_choice_compile(_CY->cy_var) < 0) YYERROR;
 	      }
             | V_REGEXP  ':' DQ charseq DQ { if (cg_regexp(_cy, $4, 0) < 0) YYERROR; free($4); }
             | V_REGEXP  ':' '!'  DQ charseq DQ { if (cg_regexp(_cy, $5, 1) < 0) YYERROR; free($5);}
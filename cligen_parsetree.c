@@ -66,6 +66,7 @@
 #include "cligen_parse.h"
 #include "cligen_handle.h"
 #include "cligen_getline.h"
+#include "cligen_arena.h"
 
 /* Private definition of parsetree. Public is defined in cligen_parsetree.h 
  * @see parse_tree_list which is the upper level of a parse-tree
@@ -77,8 +78,27 @@ struct parse_tree{
     char               *pt_name;   /* Cache of ph_name */
 #endif
     char                pt_set;    /* Parse-tree is a SET */ 
+    struct cg_obj      *pt_block;  /* Block of shallow objects owned by tree, see pt_block_new */
+    char                pt_indexed;/* Keyword index below is valid, see pt_index_get */
+    int                *pt_index;  /* Positions of keyword children sorted by command name */
+    int                 pt_ilen;   /* Length of pt_index */
+    int                *pt_other;  /* Positions of non-keyword children in order */
+    int                 pt_olen;   /* Length of pt_other */
+    struct cligen_arena *pt_arena; /* Struct, vector and block allocated from arena, see pt_new_arena */
+    int                 pt_size;   /* Allocated length of vector */
+    char                pt_uniq;   /* co_muniq of keywords is valid, see pt_meta_level */
 };
 
+/* Element of cligen_parsetree_finalize sort, appended order keeps sort stable */
+struct pt_seq{
+    cg_obj *ps_co;
+    int     ps_seq;
+};
+
+static int pt_index_reset(parse_tree *pt);
+static int co_cmp(const void* arg1, const void* arg2);
+static int pt_meta_level(parse_tree *pt);
+
 /*! Access function to get the i:th CLIgen object child of a parse-tree
  * @param[in]  pt  Parse tree
  * @param[in]  i   Which object to return
@@ -115,6 +135,7 @@ pt_vec_i_clear(parse_tree *pt,
 	return -1;
     }
     pt->pt_vec[i] = NULL;
+    pt_index_reset(pt);
     return 0;
 }
 
@@ -142,6 +163,7 @@ pt_vec_i_insert(parse_tree *pt,
 		&pt->pt_vec[i], 
 		size);
     pt->pt_vec[i] = co;
+    pt->pt_uniq = 0; /* New sibling */
     retval = 0;
  done:
     return retval;
@@ -182,6 +204,7 @@ pt_vec_i_delete(parse_tree *pt,
 		&pt->pt_vec[i+1], 
 		size);
     pt->pt_len--;
+    pt_index_reset(pt);
     retval = 0;
  done:
     return retval;
@@ -267,6 +290,287 @@ pt_new(void)
     return pt;
 }
 
+/*! Allocate a new parsetree from an arena
+ *
+ * The tree struct, its child vector and object block are allocated from the arena
+ * and released with it. Child objects are still freed by pt_free.
+ * Used for short-lived expanded trees (in one command line).
+ * @param[in] ca  Arena, if NULL same as pt_new
+ * @see pt_free
+ */
+parse_tree *
+pt_new_arena(struct cligen_arena *ca)
+{
+    parse_tree *pt = NULL;
+
+    if (ca == NULL)
+	return pt_new();
+    if ((pt = cligen_arena_calloc(ca, sizeof(parse_tree))) == NULL)
+	return NULL;
+    pt->pt_arena = ca;
+    return pt;
+}
+
+/*! Allocate a block of CLIgen objects owned by the parse-tree
+ *
+ * The objects are freed together with the parse-tree by pt_free, not individually.
+ * Used for shallow copies in expanded parse-trees, which share all fields with the 
+ * original and should be flagged with CO_FLAGS_SHALLOW.
+ * @param[in] pt  Parse-tree, can only have one block
+ * @param[in] n   Number of objects in block
+ * @retval    vec Vector of n zeroed objects
+ * @retval    NULL Error
+ * @see pt_expand
+ */
+cg_obj *
+pt_block_new(parse_tree *pt,
+	     int         n)
+{
+    if (pt == NULL || pt->pt_block != NULL || n <= 0){
+	errno = EINVAL;
+	return NULL;
+    }
+    if (pt->pt_arena){
+	pt->pt_block = cligen_arena_calloc(pt->pt_arena, n*sizeof(cg_obj));
+	return pt->pt_block;
+    }
+    if ((pt->pt_block = calloc(n, sizeof(cg_obj))) == NULL){
+	fprintf(stderr, "%s: calloc: %s\n", __FUNCTION__, strerror(errno));
+	return NULL;
+    }
+    return pt->pt_block;
+}
+
+/*! Free the keyword index of a parse-tree, called whenever the child vector changes
+ * @param[in] pt  Parse-tree
+ * @see pt_index_get
+ */
+static int
+pt_index_reset(parse_tree *pt)
+{
+    if (pt->pt_index){
+	free(pt->pt_index);
+	pt->pt_index = NULL;
+    }
+    if (pt->pt_other){
+	free(pt->pt_other);
+	pt->pt_other = NULL;
+    }
+    pt->pt_ilen = 0;
+    pt->pt_olen = 0;
+    pt->pt_indexed = 0;
+    return 0;
+}
+
+/*! Return 1 if the CLIgen object is a keyword that can be looked up by prefix in the index
+ *
+ * Escaped commands ("cmd") are matched differently depending on preference mode and are
+ * treated as others, as are all variables, references and empty objects.
+ */
+static int
+pt_index_keyword(cg_obj *co)
+{
+    return co != NULL &&
+	co->co_type == CO_COMMAND &&
+	co->co_command != NULL &&
+	co->co_command[0] != '"';
+}
+
+/*! Help struct and function to qsort keyword positions by command name */
+struct pt_index_entry {
+    cg_obj *pe_co;
+    int     pe_i;
+};
+
+static int
+pt_index_cmp(const void *arg1,
+	     const void *arg2)
+{
+    const struct pt_index_entry *pe1 = arg1;
+    const struct pt_index_entry *pe2 = arg2;
+
+    return strcmp(pe1->pe_co->co_command, pe2->pe_co->co_command);
+}
+
+static int
+pt_int_cmp(const void *arg1,
+	   const void *arg2)
+{
+    return *(const int*)arg1 - *(const int*)arg2;
+}
+
+/*! Install a keyword index on a parse-tree, and compute the other (non-keyword) positions
+ *
+ * @param[in] pt     Parse-tree
+ * @param[in] index  Positions of all keyword children sorted by command name (strcmp).
+ *                   Consumed by this function (freed by pt_free or on change)
+ * @param[in] len    Length of index vector
+ * @retval    0      OK
+ * @retval   -1      Error
+ * @see pt_expand    which derives the index of an expanded tree from the original
+ */
+int
+pt_index_set(parse_tree *pt,
+	     int        *index,
+	     int         len)
+{
+    int   retval = -1;
+    char *mark = NULL;
+    int   i;
+    
+    if (pt == NULL){
+	errno = EINVAL;
+	goto done;
+    }
+    pt_index_reset(pt);
+    pt->pt_index = index;
+    pt->pt_ilen = len;
+    if (pt->pt_len){
+	if ((mark = calloc(pt->pt_len, sizeof(char))) == NULL ||
+	    (pt->pt_other = malloc(pt->pt_len * sizeof(int))) == NULL){
+	    fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	    goto done;
+	}
+	for (i=0; i<len; i++)
+	    mark[index[i]] = 1;
+	for (i=0; i<pt->pt_len; i++)
+	    if (pt->pt_vec[i] != NULL && mark[i] == 0)
+		pt->pt_other[pt->pt_olen++] = i;
+    }
+    pt->pt_indexed = 1;
+    retval = 0;
+ done:
+    if (mark)
+	free(mark);
+    if (retval < 0)
+	pt_index_reset(pt);
+    return retval;
+}
+
+/*! Get the keyword index of a parse-tree, build it if needed
+ *
+ * The index contains the positions of all keyword (command) children sorted by command
+ * name, so that keywords with a given prefix occupy a contiguous range.
+ * The index is invalidated when the child vector changes.
+ * @param[in]  pt     Parse-tree
+ * @param[out] len    Number of keywords in the index
+ * @retval     index  Vector of positions, owned by pt (may be NULL if len is 0)
+ * @retval     NULL   Error (if len is -1)
+ */
+int *
+pt_index_get(parse_tree *pt,
+	     int        *len)
+{
+    struct pt_index_entry *pe = NULL;
+    int                   *index = NULL;
+    int                    n = 0;
+    int                    i;
+    
+    *len = -1;
+    if (pt == NULL){
+	errno = EINVAL;
+	return NULL;
+    }
+    if (pt->pt_indexed == 0){
+	if (pt->pt_len &&
+	    ((pe = malloc(pt->pt_len * sizeof(*pe))) == NULL ||
+	     (index = malloc(pt->pt_len * sizeof(int))) == NULL)){
+	    fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	    if (pe)
+		free(pe);
+	    return NULL;
+	}
+	for (i=0; i<pt->pt_len; i++)
+	    if (pt_index_keyword(pt->pt_vec[i])){
+		pe[n].pe_co = pt->pt_vec[i];
+		pe[n++].pe_i = i;
+	    }
+	qsort(pe, n, sizeof(*pe), pt_index_cmp);
+	for (i=0; i<n; i++)
+	    index[i] = pe[i].pe_i;
+	if (pe)
+	    free(pe);
+	if (pt_index_set(pt, index, n) < 0)
+	    return NULL;
+    }
+    *len = pt->pt_ilen;
+    return pt->pt_index;
+}
+
+/*! Look up keywords with a given prefix using the keyword index of a parse-tree
+ *
+ * Candidates are all keywords starting with prefix (strncmp) and all other children, 
+ * such as variables, in ascending position order. That is, the children that a linear scan
+ * calling match_object could match, skipping keywords that cannot.
+ * The index is not built by this function, it is only used if already present.
+ * @param[in]  pt      Parse-tree
+ * @param[in]  prefix  Token, prefix of keyword
+ * @param[out] vecp    Vector of candidate positions, free with free()
+ * @param[out] lenp    Length of vector
+ * @retval     1       OK, candidates in vecp
+ * @retval     0       No index, caller should make a linear scan
+ * @retval    -1       Error
+ * @see pt_index_get
+ */
+int
+pt_index_lookup(parse_tree *pt,
+		char       *prefix,
+		int       **vecp,
+		int        *lenp)
+{
+    int    *vec;
+    int     lo;
+    int     hi;
+    int     mid;
+    int     n;
+    int     i;
+    int     j;
+    int     k;
+    size_t  len;
+
+    if (pt == NULL || prefix == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    if (pt->pt_indexed == 0)
+	return 0;
+    /* Lower bound: first keyword not less than prefix */
+    lo = 0;
+    hi = pt->pt_ilen;
+    while (lo < hi){
+	mid = (lo + hi)/2;
+	if (strcmp(pt->pt_vec[pt->pt_index[mid]]->co_command, prefix) < 0)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    len = strlen(prefix);
+    for (hi = lo; hi < pt->pt_ilen; hi++)
+	if (strncmp(pt->pt_vec[pt->pt_index[hi]]->co_command, prefix, len) != 0)
+	    break;
+    n = hi - lo;
+    if ((vec = malloc((n + pt->pt_olen + 1) * sizeof(int))) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	return -1;
+    }
+    /* Keyword range sorted by position last in vec, then merge with others */
+    memcpy(&vec[pt->pt_olen], &pt->pt_index[lo], n * sizeof(int));
+    qsort(&vec[pt->pt_olen], n, sizeof(int), pt_int_cmp);
+    i = pt->pt_olen; /* keywords */
+    j = 0;           /* others */
+    k = 0;
+    while (j < pt->pt_olen){
+	if (i < pt->pt_olen + n && vec[i] < pt->pt_other[j])
+	    vec[k++] = vec[i++];
+	else
+	    vec[k++] = pt->pt_other[j++];
+    }
+    /* Remaining keywords are already in place */
+    *vecp = vec;
+    *lenp = n + pt->pt_olen;
+    return 1;
+}
+
 /*! Enlarge the child-vector (pattern) of a parse-tree
  *
  * @param[in] pt  Cligen object vector
@@ -287,14 +591,50 @@ pt_new(void)
 int 
 pt_realloc(parse_tree *pt)
 {
-    pt->pt_len++;
-    /* Allocate larger cg_obj vector */
-    if ((pt->pt_vec = realloc(pt->pt_vec, (pt->pt_len)*sizeof(cg_obj *))) == 0)
+    pt_index_reset(pt);
+    if (pt_vec_reserve(pt, pt->pt_len + 1) < 0)
 	return -1;
+    pt->pt_len++;
     pt->pt_vec[pt->pt_len - 1] = NULL; /* init field */
     return 0;
 }
 
+/*! Ensure the child-vector of a parse-tree has room for len children
+ *
+ * The vector grows by doubling so that appending n children is linear. The length of
+ * the parse-tree is not changed.
+ * @param[in] pt   Parse-tree
+ * @param[in] len  Number of children
+ * @retval    0    OK
+ * @retval   -1    Error
+ */
+int
+pt_vec_reserve(parse_tree *pt,
+	       int         len)
+{
+    cg_obj **vec;
+    int      size;
+
+    if (len <= pt->pt_size)
+	return 0;
+    size = pt->pt_size?2*pt->pt_size:8;
+    if (size < len)
+	size = len;
+    if (pt->pt_arena){ /* Old vector is released with arena */
+	if ((vec = cligen_arena_alloc(pt->pt_arena, size*sizeof(cg_obj *))) == NULL)
+	    return -1;
+	if (pt->pt_vec)
+	    memcpy(vec, pt->pt_vec, pt->pt_len*sizeof(cg_obj *));
+    }
+    else if ((vec = realloc(pt->pt_vec, size*sizeof(cg_obj *))) == NULL){
+	fprintf(stderr, "%s: realloc: %s\n", __FUNCTION__, strerror(errno));
+	return -1;
+    }
+    pt->pt_vec = vec;
+    pt->pt_size = size;
+    return 0;
+}
+
 /*! Recursively copy a parse-tree.
  *
  * No common pointers between the two structures
@@ -333,6 +673,7 @@ pt_copy(parse_tree *pt,
 	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
 	goto done;
     }
+    ptn->pt_size = pt_len_get(ptn);
     j=0;
     for (i=0; i<pt_len_get(pt); i++){
 	if ((co = pt_vec_i_get(pt, i)) != NULL){
@@ -375,7 +716,81 @@ pt_dup(parse_tree *pt,
     return ptn;
 }
 
+/*! Check if one level of a parse-tree is sorted
+ * @param[in]  vec   Vector of cligen objects
+ * @param[in]  len   Length of vec
+ * @retval     1     Sorted
+ * @retval     0     Not sorted
+ */
+static int
+pt_vec_sorted(cg_obj **vec,
+	      int      len)
+{
+    int i;
+
+    for (i=1; i<len; i++)
+	if (co_cmp(&vec[i-1], &vec[i]) > 0)
+	    return 0;
+    return 1;
+}
+
+/*! Make a shared tree reference object own its sub-tree before it is modified
+ *
+ * The sub-tree of a shared treeref object, see pt_reference_share, is the one of the
+ * referenced tree. Merging into it would change the referenced tree for all its users,
+ * so the sub-tree is copied first.
+ * @param[in]  co    Object, unchanged if not shared
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+static int
+co_unshare(cg_obj *co)
+{
+    parse_tree *pt;
+    parse_tree *ptn;
+
+    if (co == NULL || !co_flags_get(co, CO_FLAGS_REFSHARED))
+	return 0;
+    if ((pt = co_pt_get(co)) != NULL){
+	if ((ptn = pt_dup(pt, co)) == NULL)
+	    return -1;
+	co_pt_clear(co); /* Owned by the referenced tree */
+	if (co_pt_set(co, ptn) < 0)
+	    return -1;
+    }
+    co_flags_reset(co, CO_FLAGS_REFSHARED);
+    return 0;
+}
+
+/*! Merge object co1 into an equal object co0
+ * @param[in]  co0   Object in merged tree
+ * @param[in]  co1   Equal object, its children are copied into co0
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+static int
+co_merge(cg_obj *co0,
+	 cg_obj *co1)
+{
+    if (co_unshare(co0) < 0)
+	return -1;
+    if (co0->co_callbacks == NULL && co1->co_callbacks != NULL){
+	/* Cornercase: co0 callback is NULL and co1 callback is not 
+	 * Copy from co1 to co0
+	 */
+	if (co_callback_copy(co1->co_callbacks, &co0->co_callbacks) < 0)
+	    return -1;
+    }
+    return cligen_parsetree_merge(co_pt_get(co0), co0, co_pt_get(co1));
+}
+
 /*! Recursively merge two parse-trees: pt1 into pt0
+ *
+ * Both levels are walked once in sorted order, objects in pt1 that are not in pt0 are
+ * copied and equal objects are merged recursively, so merging a level is linear.
+ * A level that is not sorted is sorted first, pt1 is not modified.
+ * If the parent shares the sub-tree of a referenced tree, it is unshared first and its
+ * own copy is merged into, see co_unshare.
  * @param[in,out] pt0     parse-tree 0. On exit contains pt1 too
  * @param[in]     parent  Parent of pt0
  * @param[in]     pt1     parse-tree 1. Merge this into pt0
@@ -387,58 +802,561 @@ cligen_parsetree_merge(parse_tree *pt0,
 		       cg_obj     *parent, 
 		       parse_tree *pt1)
 {
-    cg_obj *co0=NULL;
-    cg_obj *co1;
-    cg_obj *co1c;
+    int      retval = -1;
+    cg_obj **vec1 = NULL;
+    cg_obj **vec = NULL;
+    cg_obj  *co0;
+    cg_obj  *co1;
+    cg_obj  *co1c;
+    int      len0;
+    int      len1;
+    int      i = 0;
+    int      j = 0;
+    int      k = 0;
+    int      cmp;
+
+    if (pt1 == NULL || (len1 = pt_len_get(pt1)) == 0)
+	return 0;
+    if (pt0 == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    if (parent && co_flags_get(parent, CO_FLAGS_REFSHARED) && co_pt_get(parent) == pt0){
+	if (co_unshare(parent) < 0)
+	    return -1;
+	pt0 = co_pt_get(parent);
+    }
+    if (!pt_vec_sorted(pt0->pt_vec, pt_len_get(pt0)))
+	cligen_parsetree_sort(pt0, 0);
+    len0 = pt_len_get(pt0);
+    if (pt_vec_sorted(pt1->pt_vec, len1))
+	vec1 = pt1->pt_vec;
+    else {
+	if ((vec1 = malloc(len1*sizeof(cg_obj *))) == NULL){
+	    fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	    goto done;
+	}
+	memcpy(vec1, pt1->pt_vec, len1*sizeof(cg_obj *));
+	qsort(vec1, len1, sizeof(cg_obj*), co_cmp);
+    }
+    if ((vec = malloc((len0+len1)*sizeof(cg_obj *))) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	goto done;
+    }
+    while (i < len0 || j < len1){
+	if (j >= len1){
+	    vec[k++] = pt0->pt_vec[i++];
+	    continue;
+	}
+	co1 = vec1[j];
+	cmp = i < len0 ? co_cmp(&pt0->pt_vec[i], &co1) : 1;
+	if (cmp < 0){
+	    vec[k++] = pt0->pt_vec[i++];
+	    continue;
+	}
+	j++;
+	/* Equal object in pt0, or a copied object if pt1 has duplicates */
+	if (cmp == 0)
+	    co0 = pt0->pt_vec[i];
+	else if (k > 0 && co_cmp(&vec[k-1], &co1) == 0)
+	    co0 = vec[k-1];
+	else {
+	    co1c = NULL;
+	    if (co1 && co_copy(co1, parent, &co1c) < 0)
+		goto done;
+	    vec[k++] = co1c;
+	    continue;
+	}
+	if (co0 && co1 && co_merge(co0, co1) < 0)
+	    goto done;
+    }
+    /* pt0 is only grown, all its objects are in vec */
+    if (pt_vec_reserve(pt0, k) < 0)
+	goto done;
+    memcpy(pt0->pt_vec, vec, k*sizeof(cg_obj *));
+    pt0->pt_len = k;
+    pt_index_reset(pt0);
+    co_labels_reset(parent);
+    retval = 0;
+  done:
+    if (vec1 && vec1 != pt1->pt_vec)
+	free(vec1);
+    if (vec)
+	free(vec);
+    return retval;
+}
+
+/*! Set parent of all objects of a parse-tree level
+ * @param[in]  pt      Parse-tree level
+ * @param[in]  parent  New parent
+ */
+static void
+pt_up_set(parse_tree *pt,
+	  cg_obj     *parent)
+{
+    cg_obj *co;
     int     i;
-    int     j;
-    int     retval = -1;
-    int     exist;
-
-    for (j=0; j<pt_len_get(pt1); j++){ 
-	co1 = pt_vec_i_get(pt1, j);
-	exist = 0;
-	for (i=0; i<pt_len_get(pt0); i++){
-	    co0 = pt_vec_i_get(pt0, i);
-	    if (co0 == NULL && co1 == NULL){
-		exist = 1;
-		break;
-	    }
-	    if (co0 && co1 && co_eq(co0, co1)==0){
-		if (co0->co_callbacks == NULL && co1->co_callbacks != NULL){
-		    /* Cornercase: co0 callback is NULL and co1 callback is not 
-		     * Copy from co1 to co0
-		     */
-		    if (co_callback_copy(co1->co_callbacks, &co0->co_callbacks) < 0)
-			goto done;
-		}
-		exist = 1;
-		break;
+
+    for (i=0; i<pt_len_get(pt); i++)
+	if ((co = pt_vec_i_get(pt, i)) != NULL)
+	    co_up_set(co, parent);
+}
+
+/*! Move a working point out of an object that is removed, to the parent of the object
+ * @param[in]     co   Removed object
+ * @param[in,out] wp   Working point, or NULL
+ */
+static void
+pt_update_wp(cg_obj  *co,
+	     cg_obj **wp)
+{
+    cg_obj *cw;
+
+    if (wp == NULL)
+	return;
+    for (cw = *wp; cw; cw = co_up(cw))
+	if (cw == co){
+	    *wp = co_up(co);
+	    break;
+	}
+}
+
+static int pt_update(parse_tree *pt0, cg_obj *parent, parse_tree *pt1, cg_obj **wp, int *changes);
+
+/*! Update the children of an object to the children of an equal object
+ * @param[in]     co0      Object in updated tree
+ * @param[in]     co1      Equal object in new tree, its children may be moved to co0
+ * @param[in,out] wp       Working point, or NULL
+ * @param[in,out] changes  Number of changed objects
+ * @retval        0        OK
+ * @retval       -1        Error
+ */
+static int
+co_update(cg_obj  *co0,
+	  cg_obj  *co1,
+	  cg_obj **wp,
+	  int     *changes)
+{
+    int         retval = -1;
+    parse_tree *pt0 = co_pt_get(co0);
+    parse_tree *pt1 = co_pt_get(co1);
+    parse_tree *ptempty = NULL;
+
+    if (pt0 == NULL){
+	if (pt1 == NULL || pt_len_get(pt1) == 0)
+	    goto ok;
+	co_pt_clear(co1);
+	if (co_pt_set(co0, pt1) < 0)
+	    goto done;
+	pt_up_set(pt1, co0);
+	co_labels_reset(co0);
+	(*changes) += pt_len_get(pt1);
+	goto ok;
+    }
+    if (pt1 == NULL){
+	if ((ptempty = pt_new()) == NULL)
+	    goto done;
+	pt1 = ptempty;
+    }
+    if (pt_update(pt0, co0, pt1, wp, changes) < 0)
+	goto done;
+ ok:
+    retval = 0;
+ done:
+    if (ptempty)
+	pt_free(ptempty, 1);
+    return retval;
+}
+
+/*! Update one level of a parse-tree to an equal level of a new tree, see cligen_parsetree_update
+ */
+static int
+pt_update(parse_tree *pt0,
+	  cg_obj     *parent,
+	  parse_tree *pt1,
+	  cg_obj    **wp,
+	  int        *changes)
+{
+    int      retval = -1;
+    cg_obj **vec = NULL;
+    cg_obj  *co0;
+    cg_obj  *co1;
+    int      len0;
+    int      len1;
+    int      i = 0;
+    int      j = 0;
+    int      k = 0;
+    int      n = 0;
+    int      cmp;
+
+    if (!pt_vec_sorted(pt0->pt_vec, pt_len_get(pt0)))
+	cligen_parsetree_sort(pt0, 0);
+    if (!pt_vec_sorted(pt1->pt_vec, pt_len_get(pt1)))
+	cligen_parsetree_sort(pt1, 0);
+    len0 = pt_len_get(pt0);
+    len1 = pt_len_get(pt1);
+    if (len0 + len1 && (vec = malloc((len0+len1)*sizeof(cg_obj *))) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	goto done;
+    }
+    while (i < len0 || j < len1){
+	cmp = i >= len0 ? 1 : j >= len1 ? -1 : co_cmp(&pt0->pt_vec[i], &pt1->pt_vec[j]);
+	if (cmp < 0){ /* Not in new tree: delete */
+	    if ((co0 = pt0->pt_vec[i]) != NULL){
+		pt_update_wp(co0, wp);
+		co_free(co0, 1);
 	    }
-	} 
-	if (co1==NULL){ /* empty */
-	    if (exist)
-		continue;
-	    if (pt_realloc(pt0) < 0)
-		goto done;
-	    pt0->pt_vec[pt_len_get(pt0)-1] = NULL;
+	    pt0->pt_vec[i++] = NULL;
+	    n++;
 	    continue;
 	}
-	if (exist){
-	    if (cligen_parsetree_merge(co_pt_get(co0), co0, co_pt_get(co1)) < 0)
-		goto done;
+	co1 = pt1->pt_vec[j];
+	if (cmp > 0){ /* Not in updated tree: move from new tree */
+	    if (co1)
+		co_up_set(co1, parent);
+	    pt1->pt_vec[j++] = NULL;
+	    vec[k++] = co1;
+	    n++;
+	    continue;
 	}
-	else{
-	    if (pt_realloc(pt0) < 0)
-		goto done;
-	    if (co_copy(co1, parent, &co1c) < 0)
+	co0 = pt0->pt_vec[i];
+	pt0->pt_vec[i++] = NULL;
+	j++;
+	if (co0 == NULL){
+	    vec[k++] = NULL;
+	    continue;
+	}
+	if (co_update(co0, co1, wp, changes) < 0){
+	    vec[k++] = co0;
+	    goto done;
+	}
+	if (co_same(co0, co1)){ /* Keep */
+	    vec[k++] = co0;
+	    continue;
+	}
+	/* Replace: the new object takes over the updated children of the old */
+	pt1->pt_vec[j-1] = NULL;
+	if (co_pt_get(co0) != NULL){
+	    if (co_pt_set(co1, co_pt_get(co0)) < 0){
+		vec[k++] = co0;
 		goto done;
-	    pt0->pt_vec[pt_len_get(pt0)-1] = co1c;
+	    }
+	    co_pt_clear(co0);
+	    pt_up_set(co_pt_get(co1), co1);
 	}
+	if (wp && *wp == co0)
+	    *wp = co1;
+	co_up_set(co1, parent);
+	co_free(co0, 1);
+	vec[k++] = co1;
+	n++;
     }
-    cligen_parsetree_sort(pt0, 0);
+    pt_sets_set(pt0, pt_sets_get(pt1));
     retval = 0;
-  done:
+ done:
+    /* On error, objects not yet walked are kept after the walked ones */
+    while (i < len0)
+	vec[k++] = pt0->pt_vec[i++];
+    if (k > 0 && pt_vec_reserve(pt0, k) < 0)
+	retval = -1;
+    else {
+	if (k > 0)
+	    memcpy(pt0->pt_vec, vec, k*sizeof(cg_obj *));
+	pt0->pt_len = k;
+    }
+    if (n){
+	pt_index_reset(pt0);
+	pt0->pt_uniq = 0;
+	if (pt_meta_level(pt0) < 0)
+	    retval = -1;
+	co_labels_reset(parent);
+	(*changes) += n;
+    }
+    if (vec)
+	free(vec);
+    return retval;
+}
+
+/*! Update a parse-tree in place to be equal to a new parse-tree, keeping unchanged objects
+ *
+ * Levels of the two trees are walked in sorted order (co_eq), and the minimal changes
+ * are made in pt0: objects not in pt1 are deleted, objects not in pt0 are moved from pt1,
+ * and objects equal by co_eq but with other attributes (see co_same) are replaced by the
+ * object in pt1, which takes over the updated children of the replaced object.
+ * Unchanged objects are kept with their resolved functions, compiled ranges, regexps
+ * and choices, labels and match metadata, so pointers to them remain valid.
+ * A working point in a deleted or replaced sub-tree is moved to its closest kept
+ * ancestor, or to the replacing object.
+ * Moved objects have unresolved function names, use eg cligen_callbackv_str2fn.
+ * Expanded tree references must be removed from pt0 before, see pt_expand_treeref_cleanup.
+ * @param[in,out] pt0     Parse-tree, updated
+ * @param[in]     parent  Parent of pt0, or NULL for a top-level tree
+ * @param[in]     pt1     New parse-tree. Objects are moved from it, free it with pt_free
+ * @param[in,out] wp      Working point in pt0, or NULL
+ * @retval        n       Number of deleted, inserted and replaced objects, 0: no change
+ * @retval       -1       Error
+ * @see cligen_parsetree_merge  Add a tree without deleting
+ * @see cligen_ph_reload
+ */
+int
+cligen_parsetree_update(parse_tree *pt0,
+			cg_obj     *parent,
+			parse_tree *pt1,
+			cg_obj    **wp)
+{
+    int changes = 0;
+
+    if (pt0 == NULL || pt1 == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    if (pt_update(pt0, parent, pt1, wp, &changes) < 0)
+	return -1;
+    return changes;
+}
+
+/*! Help function to qsort for finalizing: order of co_cmp, then appended order
+ */
+static int
+pt_seq_cmp(const void* arg1, 
+	   const void* arg2)
+{
+    struct pt_seq *ps1 = (struct pt_seq *)arg1;
+    struct pt_seq *ps2 = (struct pt_seq *)arg2;
+    int            cmp;
+
+    if ((cmp = co_cmp(&ps1->ps_co, &ps2->ps_co)) != 0)
+	return cmp;
+    return ps1->ps_seq - ps2->ps_seq;
+}
+
+/*! Finalize a parse-tree built by appending children unsorted
+ *
+ * Bulk construction: add children with pt_vec_append in any order, then call this
+ * function once instead of co_insert for each child, which shifts the vector on every
+ * insert. Each level is sorted with co_cmp and duplicates per co_eq are merged as in
+ * co_insert: the first appended object is kept and later equal objects are merged
+ * into it and freed. A kept object sharing the sub-tree of a referenced tree, eg
+ * appended by pt_reference_share, is unshared before it is merged into.
+ * Match metadata of the finalized levels is also computed, see cligen_parsetree_meta.
+ * @param[in]  pt         Parse-tree
+ * @param[in]  recursive  If set, finalize all levels, else only the top level
+ * @retval     0          OK
+ * @retval    -1          Error
+ * @code
+ *   for (i=0; i<n; i++)
+ *      if (pt_vec_append(pt, co_new(names[i], NULL)) < 0)
+ *         err;
+ *   if (cligen_parsetree_finalize(pt, 1) < 0)
+ *      err;
+ * @endcode
+ * @see co_insert
+ */
+int
+cligen_parsetree_finalize(parse_tree *pt,
+			  int         recursive)
+{
+    int            retval = -1;
+    struct pt_seq *ps = NULL;
+    cg_obj        *co;
+    cg_obj        *co0;
+    int            len;
+    int            i;
+    int            k;
+
+    if (pt == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    len = pt_len_get(pt);
+    /* Children first, so that merges below see sorted levels */
+    for (i=0; recursive && i<len; i++){
+	if ((co = pt_vec_i_get(pt, i)) == NULL ||
+	    co_flags_get(co, CO_FLAGS_REFSHARED|CO_FLAGS_MARK))
+	    continue;
+	co_flags_set(co, CO_FLAGS_MARK);
+	if (co_pt_get(co) &&
+	    cligen_parsetree_finalize(co_pt_get(co), 1) < 0){
+	    co_flags_reset(co, CO_FLAGS_MARK);
+	    goto done;
+	}
+	co_flags_reset(co, CO_FLAGS_MARK);
+    }
+    if (len < 2)
+	goto ok;
+    if ((ps = malloc(len*sizeof(*ps))) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	goto done;
+    }
+    for (i=0; i<len; i++){
+	ps[i].ps_co = pt->pt_vec[i];
+	ps[i].ps_seq = i;
+    }
+    qsort(ps, len, sizeof(*ps), pt_seq_cmp);
+    k = 0;
+    for (i=0; i<len; i++){
+	co = ps[i].ps_co;
+	if (k > 0 && co_cmp(&pt->pt_vec[k-1], &co) == 0){
+	    if ((co0 = pt->pt_vec[k-1]) != NULL){
+		/* Dont merge into the tree referenced by a shared object */
+		if (co_unshare(co0) < 0)
+		    goto done;
+		if (cligen_parsetree_merge(co_pt_get(co0), co0, co_pt_get(co)) < 0)
+		    goto done;
+		co_free(co, 1);
+	    }
+	    continue;
+	}
+	pt->pt_vec[k++] = co;
+    }
+    pt->pt_len = k;
+    pt_index_reset(pt);
+ ok:
+    /* Children are done above */
+    if (pt_meta_level(pt) < 0)
+	goto done;
+    /* Label masks of the parent do not cover the appended children */
+    for (i=0; i<pt_len_get(pt); i++)
+	if ((co = pt_vec_i_get(pt, i)) != NULL){
+	    co_labels_reset(co_up(co));
+	    break;
+	}
+    retval = 0;
+ done:
+    if (ps)
+	free(ps);
+    return retval;
+}
+
+/*! Help function to qsort keywords by command without escape, see pt_meta_level
+ */
+static int
+co_meta_cmp(const void* arg1, 
+	    const void* arg2)
+{
+    cg_obj *co1 = *(cg_obj**)arg1;
+    cg_obj *co2 = *(cg_obj**)arg2;
+    char   *c1 = co1->co_command;
+    char   *c2 = co2->co_command;
+
+    if (*c1 == '\"')
+	c1++;
+    if (*c2 == '\"')
+	c2++;
+    return strcmp(c1, c2);
+}
+
+/*! Compute match metadata of the objects of one parse-tree level
+ *
+ * The shortest unique prefix of a keyword is one more than its longest common prefix
+ * with its neighbours in sorted order, but at most its length.
+ * @param[in]  pt   Parse-tree level
+ * @retval     0    OK
+ * @retval    -1    Error
+ */
+static int
+pt_meta_level(parse_tree *pt)
+{
+    cg_obj **kv;
+    cg_obj  *co;
+    char    *c1;
+    char    *c2;
+    size_t   prev = 0;
+    size_t   next;
+    size_t   uniq;
+    int      nkey = 0;
+    int      i;
+
+    for (i=0; i<pt_len_get(pt); i++)
+	if ((co = pt_vec_i_get(pt, i)) != NULL){
+	    co_meta_set(co);
+	    if (co->co_type == CO_COMMAND && co->co_command &&
+		co_flags_get(co, CO_FLAGS_META))
+		nkey++;
+	}
+    if (nkey == 0)
+	goto ok;
+    if ((kv = malloc(nkey*sizeof(*kv))) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	return -1;
+    }
+    nkey = 0;
+    for (i=0; i<pt_len_get(pt); i++)
+	if ((co = pt_vec_i_get(pt, i)) != NULL &&
+	    co->co_type == CO_COMMAND && co->co_command &&
+	    co_flags_get(co, CO_FLAGS_META))
+	    kv[nkey++] = co;
+    qsort(kv, nkey, sizeof(*kv), co_meta_cmp);
+    for (i=0; i<nkey; i++){
+	next = 0;
+	if (i < nkey-1){
+	    c1 = kv[i]->co_command + (*kv[i]->co_command == '\"');
+	    c2 = kv[i+1]->co_command + (*kv[i+1]->co_command == '\"');
+	    while (c1[next] && c1[next] == c2[next])
+		next++;
+	}
+	uniq = (prev > next ? prev : next) + 1;
+	if (uniq > kv[i]->co_mlen)
+	    uniq = kv[i]->co_mlen;
+	kv[i]->co_muniq = uniq > UINT16_MAX ? UINT16_MAX : uniq;
+	prev = next;
+    }
+    free(kv);
+ ok:
+    pt->pt_uniq = 1;
+    return 0;
+}
+
+/*! Get if unique prefixes of the keywords of a level are valid
+ *
+ * Set when metadata of the level is computed, reset when an object is inserted.
+ * @param[in]  pt   Parse-tree level
+ * @retval     1    co_muniq of all keywords of the level is valid
+ * @retval     0    Not computed or stale
+ * @see cligen_parsetree_meta
+ */
+int
+pt_uniq_get(parse_tree *pt)
+{
+    return pt->pt_uniq;
+}
+
+/*! Compute match metadata of all objects in a parse-tree
+ *
+ * Each object gets its command length, preference and rest flag, and keywords get
+ * their shortest unique prefix among the siblings of their level, see co_meta_set.
+ * Called when a spec is parsed or loaded and when a tree is finalized. Copies made
+ * when expanding a tree keep the metadata of the original, also the unique prefix.
+ * Objects without metadata (eg built with co_insert) are matched as before.
+ * @param[in]  pt    CLIgen parse-tree
+ * @retval     0     OK
+ * @retval    -1     Error
+ * @see co_meta_set
+ */
+int
+cligen_parsetree_meta(parse_tree *pt)
+{
+    int     retval = -1;
+    cg_obj *co;
+    int     i;
+
+    if (pt == NULL)
+	return 0;
+    if (pt_meta_level(pt) < 0)
+	goto done;
+    for (i=0; i<pt_len_get(pt); i++){
+	if ((co = pt_vec_i_get(pt, i)) == NULL ||
+	    co_flags_get(co, CO_FLAGS_REFSHARED|CO_FLAGS_MARK))
+	    continue;
+	co_flags_set(co, CO_FLAGS_MARK);
+	if (cligen_parsetree_meta(co_pt_get(co)) < 0){
+	    co_flags_reset(co, CO_FLAGS_MARK);
+	    goto done;
+	}
+	co_flags_reset(co, CO_FLAGS_MARK);
+    }
+    retval = 0;
+ done:
     return retval;
 }
 
@@ -482,6 +1400,7 @@ cligen_parsetree_sort(parse_tree *pt,
     parse_tree *pt1;
     
     qsort(pt->pt_vec, pt_len_get(pt), sizeof(cg_obj*), co_cmp);
+    pt_index_reset(pt);
     for (i=0; i<pt_len_get(pt); i++){
 	if ((co = pt_vec_i_get(pt, i)) == NULL)
 	    continue;
@@ -496,6 +1415,34 @@ cligen_parsetree_sort(parse_tree *pt,
     }
 }
 
+/*! Return the alloced memory of a parse-tree and its objects, by category
+ * @param[in]     pt   CLIgen parse-tree
+ * @param[in,out] ms   Sizes by category are added to this, or NULL
+ * @retval        sz   Size of parse-tree in bytes
+ * @see co_size
+ */
+size_t
+pt_size(parse_tree          *pt,
+	struct cligen_msize *ms)
+{
+    cligen_msize ms0 = {0,};
+    cg_obj      *co;
+    size_t       sz0;
+    int          i;
+
+    if (ms == NULL)
+	ms = &ms0;
+    sz0 = cligen_msize_total(ms);
+    ms->ms_nodes += sizeof(*pt) + pt->pt_size*sizeof(cg_obj *);
+    ms->ms_nodes += (pt->pt_ilen + pt->pt_olen)*sizeof(int);
+    if (pt->pt_name)
+	ms->ms_strings += strlen(pt->pt_name)+1;
+    for (i=0; i<pt_len_get(pt); i++)
+	if ((co = pt_vec_i_get(pt, i)) != NULL)
+	    co_size(co, ms);
+    return cligen_msize_total(ms) - sz0;
+}
+
 /*! Free all parse-tree nodes of the parse-tree, 
  * @param[in]  pt         CLIgen parse-tree
  * @param[in]  recursive  If set free recursive
@@ -517,14 +1464,19 @@ pt_free(parse_tree *pt,
 	for (i=0; i<pt_len_get(pt); i++)
 	    if ((co = pt_vec_i_get(pt, i)) != NULL)
 		co_free(co, recursive);
-	free(pt->pt_vec);
+	if (pt->pt_arena == NULL)
+	    free(pt->pt_vec);
     }
+    if (pt->pt_block && pt->pt_arena == NULL)
+	free(pt->pt_block);
+    pt_index_reset(pt);
     pt->pt_len = 0;
     if (pt->pt_name){
 	free(pt->pt_name);
 	pt->pt_name = NULL;
     }
-    free(pt);
+    if (pt->pt_arena == NULL) /* Else released with arena */
+	free(pt);
     return 0;
 }
 
@@ -35,6 +35,15 @@
 #ifndef _CLIGEN_PARSETREE_H_
 #define _CLIGEN_PARSETREE_H_
 
+/*
+ * Constants
+ */
+/* Expanded parse-tree levels with at least this many children get a keyword index,
+ * so that keyword matching visits only the keywords with the token as prefix.
+ * @see pt_index_lookup
+ */
+#define PT_INDEX_MIN 16
+
 /*
  * Types
  */
@@ -52,6 +61,9 @@ typedef struct cg_obj cg_obj;
 
 typedef struct parse_tree parse_tree; /* struct defined internally in cligen_parsetree.c */
 
+struct cligen_arena;  /* Forward declaration, see cligen_arena.h */
+struct cligen_msize;  /* Forward declaration, see cligen_object.h */
+
 /* Callback for pt_apply() 
  * @param[in]  co   CLIgen parse-tree object
  * @param[in]  arg  Argument, cast to application-specific info
@@ -77,12 +89,23 @@ int         pt_sets_get(parse_tree *pt);
 int         pt_sets_set(parse_tree *pt, int sets);
 void        cligen_parsetree_sort(parse_tree *pt, int recursive);
 int         pt_realloc(parse_tree *pt);
+int         pt_vec_reserve(parse_tree *pt, int len);
+cg_obj     *pt_block_new(parse_tree *pt, int n);
+int         pt_index_set(parse_tree *pt, int *index, int len);
+int        *pt_index_get(parse_tree *pt, int *len);
+int         pt_index_lookup(parse_tree *pt, char *prefix, int **vecp, int *lenp);
 int         pt_copy(parse_tree *pt, cg_obj *parent, parse_tree *ptn);
 parse_tree *pt_dup(parse_tree *pt, cg_obj *cop);
 int         cligen_parsetree_merge(parse_tree *pt0, cg_obj *parent0, parse_tree *pt1);
+int         cligen_parsetree_update(parse_tree *pt0, cg_obj *parent, parse_tree *pt1, cg_obj **wp);
+int         cligen_parsetree_finalize(parse_tree *pt, int recursive);
+int         cligen_parsetree_meta(parse_tree *pt);
+int         pt_uniq_get(parse_tree *pt);
+size_t      pt_size(parse_tree *pt, struct cligen_msize *ms);
 int         pt_free(parse_tree *pt, int recurse);
 int         cligen_parsetree_free(parse_tree *pt, int recurse);
 parse_tree *pt_new(void);
+parse_tree *pt_new_arena(struct cligen_arena *ca);
 int         pt_apply(parse_tree *pt, cg_applyfn_t fn, void *arg);
 
 #endif /* _CLIGEN_PARSETREE_H_ */
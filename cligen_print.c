@@ -139,6 +139,22 @@ cov2cbuf(cbuf   *cb,
     return retval;
 }
 
+/*! Print a marginal of spaces directly into a CLIgen buffer, see cbuf_reserve
+ */
+static int
+margin2cbuf(cbuf *cb,
+	    int   marginal)
+{
+    char *p;
+
+    if (marginal <= 0)
+	return 0;
+    if ((p = cbuf_reserve(cb, marginal)) == NULL)
+	return -1;
+    memset(p, ' ', marginal);
+    return cbuf_commit(cb, marginal);
+}
+
 /*! Print a CLIgen object (cg object / co) to a CLIgen buffer
  */
 static int 
@@ -157,7 +173,7 @@ co2cbuf(cbuf   *cb,
     switch (co->co_type){
     case CO_COMMAND:
 	if (co->co_command)
-	    cprintf(cb, "%s", co->co_command);
+	    cbuf_append_str(cb, co->co_command);
 	break;
     case CO_REFERENCE:
 	if (co->co_command)
@@ -220,8 +236,9 @@ co2cbuf(cbuf   *cb,
     if (pt2cbuf(cb, pt, marginal+3, brief) < 0)
 	goto done;
     if (pt_len_get(pt)>1){
-	cprintf(cb, "%*s", marginal, ""); 
-	cprintf(cb, "}\n");
+	if (margin2cbuf(cb, marginal) < 0)
+	    goto done;
+	cbuf_append_str(cb, "}\n");
     }
     retval = 0;
   done:
@@ -248,8 +265,9 @@ pt2cbuf(cbuf       *cb,
 	if ((co = pt_vec_i_get(pt, i)) == NULL ||
 	    co->co_type == CO_EMPTY)
 	    continue;
-	if (pt_len_get(pt) > 1)
-	    cprintf(cb, "%*s", marginal, "");
+	if (pt_len_get(pt) > 1 &&
+	    margin2cbuf(cb, marginal) < 0)
+	    goto done;
 	if (co2cbuf(cb, co, marginal, brief) < 0)
 	    goto done;
     }
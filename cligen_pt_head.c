@@ -69,8 +69,114 @@
 #include "cligen_history.h"
 #include "cligen_getline.h"
 #include "cligen_print.h"
+#include "cligen_stats.h"
+#include "cligen_expand.h"
 #include "cligen_handle_internal.h"
 
+/*! FNV-1a hash of a tree name
+ */
+static inline uint32_t
+ph_hash(const char *str)
+{
+    const unsigned char *s = (const unsigned char *)str;
+    uint32_t             h = 2166136261U;
+
+    while (*s){
+	h ^= *s++;
+	h *= 16777619U;
+    }
+    return h;
+}
+
+/*! Free name index, it is rebuilt on next lookup
+ * @param[in]  ch    CLIgen handle
+ */
+static void
+ph_index_drop(struct cligen_handle *ch)
+{
+    if (ch->ch_ph_index)
+	free(ch->ch_ph_index);
+    ch->ch_ph_index = NULL;
+    ch->ch_ph_slots = 0;
+    ch->ch_ph_len = 0;
+}
+
+/*! Add parse-tree header last in its bucket of the name index, if there is an index
+ * @param[in]  ch    CLIgen handle
+ * @param[in]  ph    Parse-tree header
+ */
+static void
+ph_index_add(struct cligen_handle *ch,
+	     pt_head              *ph)
+{
+    pt_head **php;
+
+    if (ch->ch_ph_index == NULL || ph->ph_name == NULL)
+	return;
+    if (ch->ch_ph_len >= ch->ch_ph_slots){ /* Rebuilt larger on next lookup */
+	ph_index_drop(ch);
+	return;
+    }
+    php = &ch->ch_ph_index[ph_hash(ph->ph_name) & (ch->ch_ph_slots-1)];
+    while (*php)
+	php = &(*php)->ph_hnext;
+    ph->ph_hnext = NULL;
+    *php = ph;
+    ch->ch_ph_len++;
+}
+
+/*! Remove parse-tree header from the name index
+ * @param[in]  ch    CLIgen handle
+ * @param[in]  ph    Parse-tree header
+ * @retval     1     Removed
+ * @retval     0     Not in index
+ */
+static int
+ph_index_del(struct cligen_handle *ch,
+	     pt_head              *ph)
+{
+    pt_head **php;
+
+    if (ch->ch_ph_index == NULL || ph->ph_name == NULL)
+	return 0;
+    php = &ch->ch_ph_index[ph_hash(ph->ph_name) & (ch->ch_ph_slots-1)];
+    for (; *php; php = &(*php)->ph_hnext)
+	if (*php == ph){
+	    *php = ph->ph_hnext;
+	    ph->ph_hnext = NULL;
+	    ch->ch_ph_len--;
+	    return 1;
+	}
+    return 0;
+}
+
+/*! Build name index of all parse-tree headers of handle
+ * @param[in]  ch    CLIgen handle
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+static int
+ph_index_build(struct cligen_handle *ch)
+{
+    pt_head *ph;
+    int      n = 0;
+    int      slots = PT_HEAD_INDEX_MIN;
+
+    for (ph = ch->ch_pt_head; ph; ph = ph->ph_next)
+	n++;
+    while (slots < n*2)
+	slots *= 2;
+    if ((ch->ch_ph_index = calloc(slots, sizeof(pt_head*))) == NULL){
+	fprintf(stderr, "%s: calloc: %s\n", __FUNCTION__, strerror(errno));
+	return -1;
+    }
+    ch->ch_ph_slots = slots;
+    ch->ch_ph_len = 0;
+    for (ph = ch->ch_pt_head; ph; ph = ph->ph_next)
+	ph_index_add(ch, ph);
+    return 0;
+}
+
 /*
  * Access functions 
  */
@@ -99,10 +205,18 @@ int
 cligen_ph_name_set(pt_head *ph,
 		   char    *name)
 {
+    int indexed = 0;
+
     if (ph == NULL){
        errno = EINVAL;
        return -1;
     }
+    if (ph->ph_h){
+	if (ph->ph_name == NULL) /* Not in index */
+	    ph_index_drop(handle(ph->ph_h));
+	else
+	    indexed = ph_index_del(handle(ph->ph_h), ph);
+    }
     if (ph->ph_name)
 	free(ph->ph_name);
     if (name){
@@ -111,6 +225,11 @@ cligen_ph_name_set(pt_head *ph,
     }
     else
 	ph->ph_name = NULL;
+    if (ph->ph_h){
+	if (indexed)
+	    ph_index_add(handle(ph->ph_h), ph);
+	cligen_treeref_cache_invalidate(ph->ph_h);
+    }
     return 0;
 }
 
@@ -146,6 +265,8 @@ cligen_ph_parsetree_set(pt_head    *ph,
        goto done;
     }
     ph->ph_parsetree = pt; /* XXX not free if exists? */
+    if (ph->ph_h)
+	cligen_treeref_cache_invalidate(ph->ph_h);
 #if 1 /* This is still used in clixon */
     if (pt_name_set(pt, cligen_ph_name_get(ph)) < 0) /* XXX Is this even necessary ? */
 	goto done;
@@ -171,16 +292,24 @@ cligen_ph_workpoint_get(pt_head *ph)
 /*! Access function to the working point in a tree, shortcut to implement edit modes.
  * @param[in]  pt   Parse tree
  * @param[in]  wp   Working point identified by a cligen object(actually its parse-tree sub vector)
+ * @note Invalidates cached tree references, but they are flushed first on next expansion
+ *       since this may be called from a callback while expanded objects are in use.
  */
 int
 cligen_ph_workpoint_set(pt_head *ph,
 			cg_obj  *wp)
 {
     ph->ph_workpt = wp;
+    if (ph->ph_h)
+	cligen_treeref_cache_invalidate(ph->ph_h);
     return 0;
 }
 
 /*! Find a parsetree head by its name,
+ *
+ * Uses a hash index of names, built on first lookup and kept in sync by cligen_ph_add,
+ * cligen_ph_name_set and cligen_ph_free. If several trees have the same name, the first
+ * added is found.
  * @param[in] h       CLIgen handle
  * @param[in] name    Name of tree
  * @retval    ph      Parse-tree header
@@ -190,9 +319,18 @@ pt_head *
 cligen_ph_find(cligen_handle h,
 	       char         *name)
 {
-    pt_head *ph = NULL;
-    char    *phname;
+    struct cligen_handle *ch = handle(h);
+    pt_head              *ph = NULL;
+    char                 *phname;
     
+    if (name == NULL)
+	return NULL;
+    if (ch->ch_ph_index != NULL || ph_index_build(ch) == 0){
+	for (ph = ch->ch_ph_index[ph_hash(name) & (ch->ch_ph_slots-1)]; ph; ph = ph->ph_hnext)
+	    if (strcmp(ph->ph_name, name) == 0)
+		break;
+	return ph;
+    }
     for (ph = cligen_pt_head_get(h); ph; ph = ph->ph_next){
 	if ((phname = cligen_ph_name_get(ph)) == NULL)
 	    continue;
@@ -202,18 +340,240 @@ cligen_ph_find(cligen_handle h,
     return ph;
 }
 
+/*! Free name index and cached pointers of parse-tree headers, rebuilt on demand
+ *
+ * Call this if the list of parse-tree headers is changed other than by cligen_ph_add
+ * @param[in] h       CLIgen handle
+ */
+int
+cligen_ph_index_free(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    ph_index_drop(ch);
+    ch->ch_ph_last = NULL;
+    ch->ch_ph_active = NULL;
+    return 0;
+}
+
+/*! Return the alloced memory of a parsetree header and its parse-tree, by category
+ * @param[in]     ph   Parse tree header
+ * @param[in,out] ms   Sizes by category are added to this, or NULL
+ * @retval        sz   Size in bytes
+ * @see pt_size
+ */
+size_t
+cligen_ph_size(pt_head             *ph,
+	       struct cligen_msize *ms)
+{
+    cligen_msize ms0 = {0,};
+    size_t       sz0;
+
+    if (ms == NULL)
+	ms = &ms0;
+    sz0 = cligen_msize_total(ms);
+    ms->ms_nodes += sizeof(*ph);
+    if (ph->ph_name)
+	ms->ms_strings += strlen(ph->ph_name)+1;
+    if (ph->ph_parsetree)
+	pt_size(ph->ph_parsetree, ms);
+    return cligen_msize_total(ms) - sz0;
+}
+
+/*! Get spec a parse-tree was parsed from
+ * @param[in]  ph      Parse-tree header
+ * @retval     source  Name of spec, typically a file name
+ * @retval     NULL    Not parsed from a spec, or error
+ * @see cligen_ph_reload
+ */
+char *
+cligen_ph_source_get(pt_head *ph)
+{
+    if (ph == NULL){
+       errno = EINVAL;
+       return NULL;
+    }
+    return ph->ph_source;
+}
+
+/*! Set spec a parse-tree was parsed from, and its version
+ * @param[in]  ph      Parse-tree header
+ * @param[in]  source  Name of spec, or NULL
+ * @param[in]  stamp   Version of spec, eg modification time
+ * @retval     0       OK
+ * @retval    -1       Error
+ */
+int
+cligen_ph_source_set(pt_head *ph,
+		     char    *source,
+		     uint64_t stamp)
+{
+    char *s = NULL;
+
+    if (ph == NULL){
+       errno = EINVAL;
+       return -1;
+    }
+    if (source && (s = strdup(source)) == NULL)
+	return -1;
+    if (ph->ph_source)
+	free(ph->ph_source);
+    ph->ph_source = s;
+    ph->ph_stamp = stamp;
+    return 0;
+}
+
+/*! Get version of the spec a parse-tree was parsed from
+ * @param[in]  ph      Parse-tree header
+ * @retval     stamp   Version set by cligen_ph_source_set, 0 if not set
+ */
+uint64_t
+cligen_ph_stamp_get(pt_head *ph)
+{
+    return ph ? ph->ph_stamp : 0;
+}
+
+/*! Remove a parse-tree header from the list of the handle, without freeing it
+ * @param[in]  ch    CLIgen handle
+ * @param[in]  ph    Parse-tree header
+ */
+static void
+ph_unlink(struct cligen_handle *ch,
+	  pt_head              *ph)
+{
+    pt_head **php;
+
+    for (php = &ch->ch_pt_head; *php; php = &(*php)->ph_next)
+	if (*php == ph){
+	    *php = ph->ph_next;
+	    ph->ph_next = NULL;
+	    break;
+	}
+    if (ch->ch_ph_last == ph)
+	ch->ch_ph_last = NULL;
+}
+
+/*! Remove and free all parse-tree headers after mark, eg added by a failed parse
+ * @param[in]  h     CLIgen handle
+ * @param[in]  mark  Last parse-tree header to keep, or NULL to remove all
+ * @retval     0     OK
+ */
+int
+cligen_ph_trim(cligen_handle h,
+	       pt_head      *mark)
+{
+    struct cligen_handle *ch = handle(h);
+    pt_head              *ph;
+
+    while ((ph = mark ? mark->ph_next : ch->ch_pt_head) != NULL){
+	ph_unlink(ch, ph);
+	cligen_ph_free(ph);
+    }
+    cligen_treeref_cache_invalidate(h);
+    return 0;
+}
+
+/*! Update the parse-trees of a spec with trees of the same spec parsed again
+ *
+ * Trees added after mark are a new parse of spec source. Each earlier tree of the
+ * same source and name is updated in place to the new tree, see cligen_parsetree_update,
+ * and the new tree is removed. Unchanged objects and working points in them are kept,
+ * the working point of a tree is moved out of removed objects. Earlier trees of the
+ * source without a new tree are removed. Other new trees are kept.
+ * Expanded tree references are removed from updated trees, and flushed from other trees
+ * before next use, see pt_expand_treeref_flush.
+ * Must not be called from a callback of a command in a tree of source.
+ * @param[in]  h       CLIgen handle
+ * @param[in]  mark    Last parse-tree header before the new parse, or NULL if none
+ * @param[in]  source  Name of spec, see cligen_ph_source_get
+ * @retval     n       Number of changed objects and trees, 0: no change
+ * @retval    -1       Error
+ * @see cligen_parse_file_reload
+ */
+int
+cligen_ph_reload(cligen_handle h,
+		 pt_head      *mark,
+		 char         *source)
+{
+    struct cligen_handle *ch = handle(h);
+    pt_head              *first;
+    pt_head              *ph0;
+    pt_head              *ph1;
+    pt_head              *next;
+    int                   changes = 0;
+    int                   n;
+
+    if (source == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    first = mark ? mark->ph_next : ch->ch_pt_head;
+    for (ph0 = ch->ch_pt_head; ph0 && ph0 != first; ph0 = next){
+	next = ph0->ph_next;
+	if (ph0->ph_source == NULL || strcmp(ph0->ph_source, source) != 0)
+	    continue;
+	for (ph1 = first; ph1; ph1 = ph1->ph_next)
+	    if (ph1->ph_name && ph0->ph_name && strcmp(ph1->ph_name, ph0->ph_name) == 0)
+		break;
+	if (ph1 == NULL){ /* Not in new parse */
+	    ph_unlink(ch, ph0);
+	    cligen_ph_free(ph0);
+	    changes++;
+	    continue;
+	}
+	if (ph1 == first)
+	    first = ph1->ph_next;
+	ph_unlink(ch, ph1);
+	if (ph0->ph_parsetree == NULL){
+	    ph0->ph_parsetree = ph1->ph_parsetree;
+	    ph1->ph_parsetree = NULL;
+	    changes++;
+	}
+	else if (ph1->ph_parsetree){
+	    if (pt_expand_treeref_cleanup(ph0->ph_parsetree) < 0 ||
+		(n = cligen_parsetree_update(ph0->ph_parsetree, NULL, ph1->ph_parsetree,
+					     &ph0->ph_workpt)) < 0){
+		cligen_ph_free(ph1);
+		return -1;
+	    }
+	    changes += n;
+	}
+	if (ph1->ph_stamp)
+	    ph0->ph_stamp = ph1->ph_stamp;
+	cligen_ph_free(ph1);
+	next = ph0->ph_next; /* ph1 may have been next */
+    }
+    for (ph1 = first; ph1; ph1 = ph1->ph_next)
+	changes++;
+    cligen_treeref_cache_invalidate(h);
+    return changes;
+}
+
 /*! Free a  parsetree header
  * @param[in]   ph    Parse-tree header
+ * @note The header must be removed from the list of the handle by the caller
  */
 int
 cligen_ph_free(pt_head *ph)
 {
+    struct cligen_handle *ch;
+
     if (ph == NULL){
        errno = EINVAL;
        return -1;
     }
+    if (ph->ph_h){
+	ch = handle(ph->ph_h);
+	ph_index_del(ch, ph);
+	if (ch->ch_ph_last == ph)
+	    ch->ch_ph_last = NULL;
+	if (ch->ch_ph_active == ph)
+	    ch->ch_ph_active = NULL;
+    }
     if (ph->ph_name)
 	free(ph->ph_name);
+    if (ph->ph_source)
+	free(ph->ph_source);
     if (ph->ph_parsetree)
 	pt_free(ph->ph_parsetree, 1);
     free(ph);
@@ -231,8 +591,9 @@ pt_head *
 cligen_ph_add(cligen_handle h, 
 	      char         *name)
 {
-    pt_head *ph;
-    pt_head *phlast;
+    struct cligen_handle *ch = handle(h);
+    pt_head              *ph;
+    pt_head              *phlast;
     
     if ((ph = (pt_head *)malloc(sizeof(*ph))) == NULL)
 	goto done;
@@ -242,15 +603,22 @@ cligen_ph_add(cligen_handle h,
 	ph = NULL;
 	goto done;
     }
+    ph->ph_h = h;
+    cligen_treeref_cache_invalidate(h);
     if ((phlast = cligen_pt_head_get(h)) == NULL){
 	ph->ph_active++;
 	cligen_pt_head_set(h, ph);
+	ch->ch_ph_active = ph;
     }
     else {
+	if (ch->ch_ph_last != NULL && ch->ch_ph_last->ph_next == NULL)
+	    phlast = ch->ch_ph_last;
 	while (phlast->ph_next)
 	    phlast = phlast->ph_next;
 	phlast->ph_next = ph;
     }
+    ch->ch_ph_last = ph;
+    ph_index_add(ch, ph);
  done:
     return ph;
 }
@@ -305,11 +673,16 @@ cligen_ph_i(cligen_handle h,
 parse_tree *
 cligen_pt_active_get(cligen_handle h)
 {
-    pt_head *ph;
+    struct cligen_handle *ch = handle(h);
+    pt_head              *ph;
 
+    if ((ph = ch->ch_ph_active) != NULL && ph->ph_active)
+	return ph->ph_parsetree;
     for (ph = cligen_pt_head_get(h); ph; ph = ph->ph_next)
-	if (ph->ph_active)
+	if (ph->ph_active){
+	    ch->ch_ph_active = ph;
 	    return ph->ph_parsetree;
+	}
     return NULL;
 }
 
@@ -335,15 +708,18 @@ int
 cligen_ph_active_set(cligen_handle h, 
 		     char         *name)
 {
-    pt_head *ph;
+    struct cligen_handle *ch = handle(h);
+    pt_head              *ph;
 
-    for (ph = cligen_pt_head_get(h); ph; ph = ph->ph_next)
-	if (ph->ph_active)
-	    break;
+    if ((ph = ch->ch_ph_active) == NULL || !ph->ph_active)
+	for (ph = cligen_pt_head_get(h); ph; ph = ph->ph_next)
+	    if (ph->ph_active)
+		break;
     if (ph != NULL)
 	ph->ph_active = 0;
     if ((ph = cligen_ph_find(h, name)) != NULL)
 	ph->ph_active = 1;
+    ch->ch_ph_active = ph;
     return 0;
 }
 
@@ -364,25 +740,35 @@ cligen_ph_active_set(cligen_handle h,
 /*! Callback: Working point tree set
  * Format of argv:
  *   <treename>
+ * The matched object is either a copy of an object in the tree, or, if the tree 
+ * reference is shared, the object in the tree itself.
  */
 int
 cligen_wp_set(cligen_handle h,
 	      cvec         *cvv,
 	      cvec         *argv)
 {
-    cg_var   *cv;
-    char     *treename;
-    pt_head  *ph;  
-    cg_obj   *co;
-    cg_obj   *coorig;
+    cg_var     *cv;
+    char       *treename;
+    pt_head    *ph;  
+    cg_obj     *co;
+    cg_obj     *coorig;
+    cg_obj     *cotop;
+    parse_tree *pt;
 
     cv = cvec_i(argv, 0);
     treename = cv_string_get(cv);
-    if ((ph = cligen_ph_find(h, treename)) != NULL &&
-	(co = cligen_co_match(h)) != NULL &&
-	(coorig = co->co_treeref_orig) != NULL){
-	cligen_ph_workpoint_set(ph, coorig);
+    if ((ph = cligen_ph_find(h, treename)) == NULL ||
+	(co = cligen_co_match(h)) == NULL)
+	return 0;
+    if ((coorig = co->co_treeref_orig) == NULL &&
+	(pt = cligen_ph_parsetree_get(ph)) != NULL){
+	cotop = co_top(co);
+	if (cotop->co_command && co_find_one(pt, cotop->co_command) == cotop)
+	    coorig = co;
     }
+    if (coorig != NULL)
+	cligen_ph_workpoint_set(ph, coorig);
     return 0;
 }
 
@@ -36,6 +36,12 @@
 #ifndef _CLIGEN_PT_HEAD_H_
 #define _CLIGEN_PT_HEAD_H_
 
+/*
+ * Constants
+ */
+/* Initial number of buckets of the name index of parse-tree headers, power of two */
+#define PT_HEAD_INDEX_MIN 64
+
 /*
  * Types
  */
@@ -54,6 +60,12 @@ cg_obj     *cligen_ph_workpoint_get(pt_head *ph);
 int         cligen_ph_workpoint_set(pt_head *ph, cg_obj *cow);
 
 pt_head    *cligen_ph_find(cligen_handle h, char *name);
+size_t      cligen_ph_size(pt_head *ph, struct cligen_msize *ms);
+char       *cligen_ph_source_get(pt_head *ph);
+int         cligen_ph_source_set(pt_head *ph, char *source, uint64_t stamp);
+uint64_t    cligen_ph_stamp_get(pt_head *ph);
+int         cligen_ph_trim(cligen_handle h, pt_head *mark);
+int         cligen_ph_reload(cligen_handle h, pt_head *mark, char *source);
 int         cligen_ph_free(pt_head *ph);
 #ifdef NOTUSED
 int         cligen_ph_del(cligen_handle h, char *name);
@@ -61,6 +73,7 @@ int         cligen_ph_del(cligen_handle h, char *name);
 pt_head    *cligen_ph_add(cligen_handle h, char *name);
 pt_head    *cligen_ph_each(cligen_handle h, pt_head *ph);
 pt_head    *cligen_ph_i(cligen_handle h, int i);
+int         cligen_ph_index_free(cligen_handle h);
 
 parse_tree *cligen_pt_active_get(cligen_handle h);
 #if 0 /* XXX Add after 5.3 */
@@ -56,6 +56,7 @@
 #define __USE_GNU /* isblank() */
 #include <ctype.h>
 #include <assert.h>
+#include <pthread.h>
 
 #ifndef isblank
 #define isblank(c) (c==' ')
@@ -75,6 +76,19 @@
 #include "cligen_expand.h"
 #include "cligen_history_internal.h"
 #include "cligen_getline.h"
+#include "cligen_stats.h"
+#include "cligen_registry.h"
+#include "cligen_compile.h"
+
+/*
+ * Types
+ */
+/* File read by cligen_eval_stream, the getline buffer is reused between lines */
+struct cligen_stream{
+    FILE   *cs_f;
+    char   *cs_buf;
+    size_t  cs_buflen;
+};
 
 /*
  * Local prototypes
@@ -100,12 +114,17 @@ cli_show_help_commands(cligen_handle h,
     parse_tree   *pt=NULL;     /* Orig parse-tree */
     parse_tree   *ptn = NULL;    /* Expanded */
     cvec         *cvv = NULL;
+    size_t        mark;
 
     fputs("\n", stdout);
-    if ((ptn = pt_new()) == NULL)
+    if (cligen_line_begin(h, &mark) < 0)
+	return -1;
+    if ((ptn = pt_new_arena(cligen_line_arena(h))) == NULL)
 	goto done;
     if ((pt = cligen_pt_active_get(h)) == NULL)
 	goto ok;
+    if (pt_expand_treeref_flush(h) < 0) /* remove stale cached sub-trees */
+	goto done;
     if (pt_expand_treeref(h, NULL, pt) < 0) /* sub-tree expansion */
 	goto done; 
     if ((cvv = cvec_start(string)) == NULL)
@@ -121,17 +140,22 @@ cli_show_help_commands(cligen_handle h,
     }
     else if (show_help_columns(h, stdout, cligen_buf(h), ptn, cvv) < 0)
 	    goto done;
+    if (cligen_expand_incomplete(h))
+	cligen_output(stdout, "  %s\n", CLIGEN_EXPAND_INCOMPLETE);
  ok:
     retval = 0;
   done:
     if (cvv)
 	cvec_free(cvv);
+    /* Errors of cleanup fail the call, the line is still ended */
     if (ptn && pt_free(ptn, 0) < 0)
-	return -1;
-    if (pt && pt_expand_cleanup(pt) < 0) 
-	return -1;
-    if (pt && pt_expand_treeref_cleanup(pt) < 0) 
-	return -1;
+	retval = -1;
+    if (pt && pt_expand_cleanup(pt) < 0)
+	retval = -1;
+    if (pt && pt_expand_treeref_release(h, pt) < 0)
+	retval = -1;
+    if (cligen_line_end(h, mark) < 0)
+	retval = -1;
     return retval;
 }
 
@@ -171,11 +195,16 @@ cli_tab_hook(cligen_handle h,
     parse_tree   *pt = NULL;     /* Orig */
     parse_tree   *ptn = NULL;    /* Expanded */
     cvec         *cvv = NULL;
+    size_t        mark;
 
-    if ((ptn = pt_new()) == NULL)
+    if (cligen_line_begin(h, &mark) < 0)
+	return -1;
+    if ((ptn = pt_new_arena(cligen_line_arena(h))) == NULL)
 	goto done;
     if ((pt = cligen_pt_active_get(h)) == NULL)
 	goto ok;
+    if (pt_expand_treeref_flush(h) < 0) /* remove stale cached sub-trees */
+	goto done;
     if (pt_expand_treeref(h, NULL, pt) < 0) /* sub-tree expansion */
 	goto done;
     if ((cvv = cvec_start(cligen_buf(h))) == NULL)
@@ -198,22 +227,111 @@ cli_tab_hook(cligen_handle h,
     }
     else if (show_help_columns(h, stdout, cligen_buf(h), ptn, cvv) < 0)
 	    goto done;
+    if (cligen_expand_incomplete(h))
+	cligen_output(stdout, "  %s\n", CLIGEN_EXPAND_INCOMPLETE);
  ok:
     retval = 0; 
  done:
     if (cvv)
 	cvec_free(cvv);
+    /* Errors of cleanup fail the call, the line is still ended */
     if (ptn && pt_free(ptn, 0) < 0)
-	return -1;
+	retval = -1;
     if (pt != NULL) {
 	if (pt_expand_cleanup(pt) < 0)
-	    return -1;
-	if (pt_expand_treeref_cleanup(pt) < 0)
-	    return -1;
+	    retval = -1;
+	if (pt_expand_treeref_release(h, pt) < 0)
+	    retval = -1;
     }
+    if (cligen_line_end(h, mark) < 0)
+	retval = -1;
     return retval;	
 }
 
+/*! Callback from getline: no key typed within idle time, see cligen_idle_expand_set
+ *
+ * Match the line as for '?' without output, saving its match state, expanding tree
+ * references and calling expand callbacks within the budget. If one object matches, the
+ * tree references of its children are also expanded. With the caches enabled, the next
+ * TAB or '?' resumes from there. Stops at the next step when a key is typed.
+ * @param[in]  h       CLIgen handle
+ * @param[in]  string  Input string
+ * @retval     0       OK
+ * @retval    -1       Error
+ */
+static int
+cli_idle_hook(cligen_handle h,
+	      char         *string)
+{
+    int            retval = -1;
+    parse_tree    *pt = NULL;     /* Orig */
+    parse_tree    *ptn = NULL;    /* Expanded */
+    parse_tree    *ptmatch = NULL;
+    int           *matchvec = NULL;
+    int            matchlen = 0;
+    cligen_tokens *tk = NULL;
+    cvec          *cvv = NULL;
+    cg_obj        *co;
+    size_t         mark;
+
+    if (cligen_line_begin(h, &mark) < 0)
+	return -1;
+    cligen_idle_begin(h);
+    if ((ptn = pt_new_arena(cligen_line_arena(h))) == NULL)
+	goto done;
+    if ((pt = cligen_pt_active_get(h)) == NULL || gl_input_pending())
+	goto ok;
+    if (pt_expand_treeref_flush(h) < 0) /* remove stale cached sub-trees */
+	goto done;
+    if (pt_expand_treeref(h, NULL, pt) < 0) /* sub-tree expansion */
+	goto done;
+    if ((cvv = cvec_start(string)) == NULL)
+	goto done;
+    if (pt_expand(h, pt, cvv, 1, 0, ptn) < 0)
+	goto done;
+    if (gl_input_pending())
+	goto ok;
+    if (cligen_str2tokens(h, string, &tk) < 0)
+	goto done;
+    if (match_pattern_tokens(h, tk, ptn, 0,
+			     &ptmatch,
+			     &matchvec, &matchlen,
+			     cvv, NULL,
+			     NULL) < 0)
+	goto done;
+    /* Next level: cached tree references of the children of a single match */
+    if (matchlen == 1 && cligen_treeref_cache(h) && !gl_input_pending()){
+	co = pt_vec_i_get(ptmatch, matchvec[0]);
+	if (co && co_pt_get(co) &&
+	    pt_expand_treeref(h, co->co_ref?co->co_ref:co, co_pt_get(co)) < 0)
+	    goto done;
+    }
+ ok:
+    retval = 0;
+ done:
+    cligen_idle_end(h);
+    if (ptmatch && ptmatch != ptn)
+	pt_free(ptmatch, 0);
+    if (matchvec)
+	free(matchvec);
+    if (tk)
+	cligen_tokens_release(h, tk);
+    if (cvv)
+	cvec_free(cvv);
+    /* Errors of cleanup fail the call, the line is still ended */
+    if (ptn && pt_free(ptn, 0) < 0)
+	retval = -1;
+    if (pt != NULL) {
+	if (pt_expand_cleanup(pt) < 0)
+	    retval = -1;
+	if (pt_expand_treeref_release(h, pt) < 0)
+	    retval = -1;
+    }
+    if (cligen_line_end(h, mark) < 0)
+	retval = -1;
+    return retval;
+}
+
 /*! Initialize this module
  */
 void
@@ -221,42 +339,7 @@ cliread_init(cligen_handle h)
 {
     gl_qmark_hook = cli_qmark_hook;
     gl_tab_hook = cli_tab_hook; /* XXX globals */
-}
-
-/*! Print columns
- * @param[in]  cnr  Number of columns.
- * @param[in]  cw   Width of column
- */
-static int
-column_print(FILE            *fout, 
-	     int              cnr, 
-	     int              cw,
-	     struct cmd_help *chvec,
-	     int              len,
-	     int              level)
-{ 
-    int              retval = -1;
-    int              li; /* line number */
-    int              ci; /* column number */
-    int              linenr;
-    struct cmd_help *ch;
-
-    linenr = (len-1)/cnr + 1;
-    for (ci=0, li = 0; li < linenr; li++) {
-	while ((ci < cnr) && (li*cnr+ci < len)) {
-	    ch = &chvec[li*cnr+ci];
-	    fprintf(fout, " %*s", 
-		     -(cw-1), 
-		     ch->ch_cmd);
-	    ci++;
-	}
-	ci = 0;
-	fprintf(fout, "\n");  
-    }  
-    fflush(fout);
-    retval = 0;
-    // done:
-    return retval;
+    gl_idle_hook = cli_idle_hook;
 }
 
 /*! Show briefly the commands available (show no help)
@@ -276,119 +359,35 @@ show_help_columns(cligen_handle h,
 		  cvec         *cvv)
 {
     int              retval = -1;
-    int              level;
     int              matchlen = 0;
     int             *matchvec = NULL;
-    int              vi;
-    int              i;
-    int              nrcmd = 0;
-    struct cmd_help *chvec = NULL;
-    struct cmd_help *ch;
-    cg_obj          *co;
-    cbuf            *cb = NULL;
-    char            *cmd;
-    char            *prev = NULL;
-    int              maxlen = 0;
-    int              column_width;
-    int              column_nr;
-    int              rest;
-    cvec            *cvt = NULL;      /* Tokenized string: vector of tokens */
-    cvec            *cvr = NULL;      /* Rest variant,  eg remaining string in each step */
+    cligen_tokens   *tk = NULL;       /* Tokenized string */
     parse_tree      *ptmatch = NULL;
 
     if (string == NULL){
 	errno = EINVAL;
 	goto done;
     }
-    if ((cb = cbuf_new()) == NULL){
-	fprintf(stderr, "cbuf_new: %s\n", strerror(errno));
-	return -1;
-    }
-    /* Tokenize the string and transform it into two CLIgen vectors: tokens and rests */
-    if (cligen_str2cvv(string, &cvt, &cvr) < 0)
+    /* Tokenize the string into token spans */
+    if (cligen_str2tokens(h, string, &tk) < 0)
 	goto done;
-    if (match_pattern(h, cvt, cvr,
-		      pt,
-		      0, /* best: Return all options, not only best, exclude hidden */
-		      &ptmatch, 
-		      &matchvec, &matchlen,
-		      cvv, NULL,
-		      NULL) < 0)
+    if (match_pattern_tokens(h, tk,
+			     pt,
+			     0, /* best: Return all options, not only best, exclude hidden */
+			     &ptmatch, 
+			     &matchvec, &matchlen,
+			     cvv, NULL,
+			     NULL) < 0)
 	goto done;
-    if ((level = cligen_cvv_levels(cvt)) < 0)
+    if (matchlen > 0 &&
+	print_help_columns(h, fout, ptmatch, matchvec, matchlen) < 0)
 	goto done;
-    if (matchlen > 0){ /* min, max only defined if matchlen > 0 */
-	/* Go through match vector and collect commands and helps */
-	if ((chvec = calloc(matchlen, sizeof(struct cmd_help))) ==NULL){
-	    fprintf(stderr, "%s calloc: %s\n", __FUNCTION__, strerror(errno));
-	    goto done;
-	}
-	nrcmd = 0;
-	for (i = 0; i<matchlen; i++){ // nr-1?
-	    vi=matchvec[i];
-	    if ((co = pt_vec_i_get(ptmatch, vi)) == NULL)
-		continue;
-	    if (co->co_command == NULL)
-		continue;		
-	    cmd = NULL;
-	    switch (co->co_type){
-	    case CO_VARIABLE:
-		cbuf_reset(cb);
-		cov2cbuf(cb, co, 1);
-		cmd = cbuf_get(cb);
-		break;
-	    case CO_COMMAND:
-		cmd = co->co_command;
-		break;
-	    case CO_REFERENCE:
-	    default:
-		continue;
-	    }
-	    if (cmd == NULL || strlen(cmd)==0)
-		continue;
-	    if (prev && strcmp(cmd, prev)==0)
-		continue;
-	    ch = &chvec[nrcmd++];
-	    if ((ch->ch_cmd = strdup(cmd)) == NULL){
-		fprintf(stderr, "%s strdup: %s\n", __FUNCTION__, strerror(errno));
-		goto done;
-	    }
-	    prev = ch->ch_cmd;
-	    maxlen = strlen(cmd)>maxlen?strlen(cmd):maxlen;
-	}
-	maxlen++;
-	column_width = maxlen<COLUMN_MIN_WIDTH?COLUMN_MIN_WIDTH:maxlen;
-	column_nr = cligen_terminal_width(h)/column_width;
-	if (column_nr < 1)
-	    column_nr = 1;
-	rest = cligen_terminal_width(h)%column_width;
-	column_width += rest/column_nr;
-	if (column_print(fout, 
-			 column_nr,
-			 column_width,
-			 chvec, 
-			 nrcmd,
-			 level) < 0)
-	    goto done;
-    } /* nr>0 */
-
     retval = 0;
   done:
-    if (chvec){
-	for (i=0; i<nrcmd; i++){
-	    if (chvec[i].ch_cmd)
-		free(chvec[i].ch_cmd);
-	}
-	free(chvec);
-    }
     if (ptmatch && ptmatch != pt)
 	pt_free(ptmatch, 0);
-    if (cvt)
-	cvec_free(cvt);
-    if (cvr)
-	cvec_free(cvr);
-    if (cb)
-	cbuf_free(cb);
+    if (tk)
+	cligen_tokens_release(h, tk);
     if (matchvec)
 	free(matchvec);
     return retval;
@@ -426,10 +425,7 @@ show_help_line(cligen_handle h,
     int           level;
     int           matchlen = 0;
     int          *matchvec = NULL;
-    cvec         *cvt = NULL;      /* Tokenized string: vector of tokens */
-    cvec         *cvr = NULL;      /* Rest variant,  eg remaining string in each step */
-    cg_var       *cvlastt;         /* Last element in cvt */
-    cg_var       *cvlastr;         /* Last element in cvr */
+    cligen_tokens *tk = NULL;      /* Tokenized string */
     cligen_result result;
     parse_tree   *ptmatch = NULL; 
 
@@ -437,21 +433,21 @@ show_help_line(cligen_handle h,
 	errno = EINVAL;
 	goto done;
     }
-    /* Tokenize the string and transform it into two CLIgen vectors: tokens and rests */
-    if (cligen_str2cvv(string, &cvt, &cvr) < 0) /* XXX cvr leaks memory */
+    /* Tokenize the string into token spans */
+    if (cligen_str2tokens(h, string, &tk) < 0)
 	goto done;
-    if (match_pattern(h,
-		      cvt, cvr, /* token string */
-		      pt,       /* command vector */
-		      0,        /* best: Return all options, not only best, exclude hidden */
-		      &ptmatch,
-		      &matchvec, &matchlen,
-		      cvv, NULL,
-		      NULL) < 0)
+    if (match_pattern_tokens(h,
+			     tk,       /* token string */
+			     pt,       /* command vector */
+			     0,        /* best: Return all options, not only best, exclude hidden */
+			     &ptmatch,
+			     &matchvec, &matchlen,
+			     cvv, NULL,
+			     NULL) < 0)
 	goto done;
     if (matchlen) /* sanity */
 	assert(matchvec!= NULL && ptmatch != NULL);
-    if ((level =  cligen_cvv_levels(cvt)) < 0)
+    if ((level =  cligen_tokens_levels(tk)) < 0)
 	goto done;
 
     /* If last char is blank, look for next level in parse-tree 
@@ -462,26 +458,18 @@ show_help_line(cligen_handle h,
      * This means we need to peek in next level and if that provides a unique solution,
      * then add a <cr>
      */
-    cvlastt = cvec_i(cvt, cvec_len(cvt)-1);
-    if (cvec_len(cvt) > 2 && strcmp(cv_string_get(cvlastt), "")==0){
+    if (tk->tk_len > 1 && tk->tk_vec[tk->tk_len-1].ct_len == 0){
 	/* if it is ok to <cr> here (at end of one mode) 
 	   Example: x [y|z] and we have typed 'x ', then show
 	   help for y and z and a 'cr' for 'x'.
 	*/
 
-	/* Remove the last elements. Awkward: first free the cv then truncate the cvec */
-	if (cvlastt)
-	    cv_reset(cvlastt);
-	cvec_del_i(cvt, cvec_len(cvt)-1); /* We really just want to truncate len-1 */
-
-	if ((cvlastr = cvec_i(cvr, cvec_len(cvr)-1)) != NULL)
-	    cv_reset(cvlastr);
-	cvec_del_i(cvr, cvec_len(cvr)-1);
-
-	if (match_pattern_exact(h, cvt, cvr, pt,
-				cvv, NULL,
-				NULL, NULL,
-				&result, NULL) < 0)
+	/* Remove the last empty token */
+	tk->tk_len--;
+	if (match_pattern_exact_tokens(h, tk, pt,
+				       cvv, NULL,
+				       NULL, NULL,
+				       &result, NULL) < 0)
 	    goto done;
 	if (result == CG_MATCH || result == CG_MULTIPLE){
 	    fprintf(fout, "  <cr>\n");
@@ -500,10 +488,8 @@ show_help_line(cligen_handle h,
   done:
     if (ptmatch && pt != ptmatch)
 	pt_free(ptmatch, 0);
-    if (cvt)
-	cvec_free(cvt);
-    if (cvr)
-	cvec_free(cvr);
+    if (tk)
+	cligen_tokens_release(h, tk);
     if (matchvec)
 	free(matchvec);
     return retval;
@@ -618,65 +604,54 @@ cli_trim(char **line,
     *line = s;    
 }
 
-/*! Given an input string, return a parse-tree.
- *
- * Given an input string and a parse-tree, return a matching parse-tree node, a
- * CLIgen keyword and CLIgen variable record vector. 
- * Some complexity in this function is due to variable expansion: if there
- * are <expand:> variables, the parse-tree needs to be expanded with current
- * values by calling user-supplied callbacks and building a 'shadow' parse-tree
- * which is purged after use. 
- * Use this function if you already have a string but you want it syntax-checked 
- * and parsed.
- *
- * @param[in]  h         Cligen handle
- * @param[in]  string    Input string to match
- * @param[in]  pt        Parse-tree
- * @param[out] co_orig   Object that matches (if retval == 1).
- * @param[out] cvvall    Variable vector (if retval == 1).
- * @param[out] result    Result, < 0: errors, >=0 number of matches
- * @param[out] reason    Error reason if result is nomatch. Need to be free:d 
- * @retval     0         OK
- * @retval    -1         Error
+/*! Parse a string against a parse-tree, see cliread_parse
  *
- * cvv should be created but empty on entry
- * On exit it contains the command string as 0th element, and one entry per element
- * Example: "aa <bb:str>" and inut string "aa 22" gives:
- *   0 : "aa 22"     # initial command has no "name"
- *   1 : aa = "aa"   # string has keyword itself as value
- *   2 : bb = 22     # variable
+ * @param[in]  cleanup   If set, clear expanded values in pt after matching. If not set,
+ *                       the caller calls pt_expand_cleanup(pt) itself, eg once after a
+ *                       stream of lines instead of walking the whole tree each line.
+ * @see cliread_parse    for the other parameters
  */
-int 
-cliread_parse(cligen_handle  h, 
-	      char          *string,
-	      parse_tree    *pt,     /* Orig */
-	      cg_obj       **co_orig,
-	      cvec          *cvvall,
-	      cligen_result *result,
-	      char         **reason)
+static int 
+cliread_parse1(cligen_handle  h, 
+	       char          *string,
+	       parse_tree    *pt,
+	       cg_obj       **co_orig,
+	       cvec          *cvvall,
+	       cligen_result *result,
+	       char         **reason,
+	       int            cleanup)
 {
     int         retval = -1;
     cg_obj     *match_obj;
     parse_tree *ptn = NULL;      /* Expanded */
     parse_tree *ptmatch = NULL;
-    cvec       *cvt = NULL;      /* Tokenized string: vector of tokens */
-    cvec       *cvr = NULL;      /* Rest variant,  eg remaining string in each step */
+    cligen_tokens *tk = NULL;    /* Tokenized string */
     cg_var     *cv;
     cvec       *cvv = NULL;     /* Top-level vars/val vector with just command as 0th element */
+    size_t      mark;
+    int         ret;
+    uint64_t    t0;
 
     if (cvvall == NULL || cvec_len(cvvall) != 0){
 	errno = EINVAL;
-	goto done;
+	return -1;
     }
-    if ((ptn = pt_new()) == NULL)
+    if (cligen_line_begin(h, &mark) < 0)
+	return -1;
+    if ((ptn = pt_new_arena(cligen_line_arena(h))) == NULL)
 	goto done;
     if (cligen_logsyntax(h) > 0){
 	fprintf(stderr, "%s:\n", __FUNCTION__);
 	pt_print(stderr, pt, 0);
     }
     cli_trim(&string, cligen_comment(h));
-    /* Tokenize the string and transform it into two CLIgen vectors: tokens and rests */
-    if (cligen_str2cvv(string, &cvt, &cvr) < 0)
+    /* Tokenize the string into token spans */
+    t0 = cligen_stats_start(h);
+    ret = cligen_str2tokens(h, string, &tk);
+    cligen_stats_stop(h, CLIGEN_STAT_TOKENIZE, t0);
+    if (ret < 0)
+	goto done;
+    if (pt_expand_treeref_flush(h) < 0) /* remove stale cached sub-trees */
 	goto done;
     if (pt_expand_treeref(h, NULL, pt) < 0) /* sub-tree expansion, ie @ */
 	goto done; 
@@ -684,41 +659,144 @@ cliread_parse(cligen_handle  h,
 	goto done;
     cv_name_set(cv, "cmd"); /* the whole command string */
     cv_string_set(cv, string); /* the whole command string */
+    /* Compiled matcher decides unique matches without expanding the parse-tree */
+    if ((ret = cligen_compile_match(h, pt, tk, cvvall, co_orig, result)) < 0)
+	goto done;
+    if (ret == 1)
+	goto ok;
     /* Why is this created separately from cvvall? */
-    if ((cvv = cvec_start(string)) == NULL)
+    if ((cvv = cligen_parse_cvec_get(h)) == NULL ||
+	(cv = cvec_add(cvv, CGV_REST)) == NULL)
 	goto done;
+    cv_name_set(cv, "cmd"); /* the whole command string, see cvec_start */
+    cv_string_set(cv, string);
     if (pt_expand(h, pt, cvv,
 		  0,  /* Do not include hidden commands */
 		  0,  /* VARS are not expanded, eg ? <tab> */
 		  ptn) < 0) /* sub-tree expansion, ie choice, expand function */
 	goto done;
-    if (match_pattern_exact(h, cvt, cvr,
-			    ptn, cvv, cvvall,
-			    &match_obj, &ptmatch, 
-			    result, reason) < 0)
+    if (match_pattern_exact_tokens(h, tk,
+				   ptn, cvv, cvvall,
+				   &match_obj, &ptmatch, 
+				   result, reason) < 0)
 	goto done;
     /* Map from ghost object match_obj to real object */
     if (match_obj && match_obj->co_ref)
 	*co_orig = match_obj->co_ref;
     else
 	*co_orig = match_obj;
+ ok:
     retval = 0;
   done:
     if (cvv)
-	cvec_free(cvv);
-    if (cvt)
-	cvec_free(cvt);
-    if (cvr)
-	cvec_free(cvr);
-    if (ptmatch && ptmatch != ptn)
-	if (pt_free(ptmatch, 0) < 0)
-	    return -1;
-    if (ptn)
-	if (pt_free(ptn, 0) < 0)
-	    return -1;
+	cligen_parse_cvec_put(h, cvv);
+    if (tk)
+	cligen_tokens_release(h, tk);
+    /* Errors of cleanup fail the call, the line is still ended */
+    if (ptmatch && ptmatch != ptn &&
+	pt_free(ptmatch, 0) < 0)
+	retval = -1;
+    if (ptn && pt_free(ptn, 0) < 0)
+	retval = -1;
+    if (cligen_line_end(h, mark) < 0)
+	retval = -1;
+    if (cleanup && pt_expand_cleanup(pt) < 0)
+	retval = -1;
+    return retval;
+}
 
-    if (pt_expand_cleanup(pt) < 0)
-	return -1;
+/*! Given an input string, return a parse-tree.
+ *
+ * Given an input string and a parse-tree, return a matching parse-tree node, a
+ * CLIgen keyword and CLIgen variable record vector. 
+ * Some complexity in this function is due to variable expansion: if there
+ * are <expand:> variables, the parse-tree needs to be expanded with current
+ * values by calling user-supplied callbacks and building a 'shadow' parse-tree
+ * which is purged after use. 
+ * Use this function if you already have a string but you want it syntax-checked 
+ * and parsed.
+ *
+ * @param[in]  h         Cligen handle
+ * @param[in]  string    Input string to match
+ * @param[in]  pt        Parse-tree
+ * @param[out] co_orig   Object that matches (if retval == 1).
+ * @param[out] cvvall    Variable vector (if retval == 1).
+ * @param[out] result    Result, < 0: errors, >=0 number of matches
+ * @param[out] reason    Error reason if result is nomatch. Need to be free:d 
+ * @retval     0         OK
+ * @retval    -1         Error
+ *
+ * cvv should be created but empty on entry
+ * On exit it contains the command string as 0th element, and one entry per element
+ * Example: "aa <bb:str>" and inut string "aa 22" gives:
+ *   0 : "aa 22"     # initial command has no "name"
+ *   1 : aa = "aa"   # string has keyword itself as value
+ *   2 : bb = 22     # variable
+ */
+int 
+cliread_parse(cligen_handle  h, 
+	      char          *string,
+	      parse_tree    *pt,     /* Orig */
+	      cg_obj       **co_orig,
+	      cvec          *cvvall,
+	      cligen_result *result,
+	      char         **reason)
+{
+    return cliread_parse1(h, string, pt, co_orig, cvvall, result, reason, 1);
+}
+
+/*! Evaluate a matched object, see cligen_eval
+ *
+ * @param[in]  copy  If set, each callback gets a copy of its argument vector which it
+ *                   may modify. If not set, it gets the vector of the parse-tree.
+ * @see cligen_eval  for the other parameters
+ */
+static int
+cligen_eval1(cligen_handle h, 
+	     cg_obj       *co, 
+	     cvec         *cvv,
+	     int           copy)
+{
+    struct cg_callback *cc;
+    int                 retval = 0;
+    cvec               *argv;
+    uint64_t            t0;
+
+    if (h){
+	cligen_co_match_set(h, co);
+	if (cligen_output_begin(h) < 0)
+	    return -1;
+    }
+    t0 = cligen_stats_start(h);
+    for (cc = co->co_callbacks; cc; cc=cc->cc_next){
+	/* Resolve name on first use, see cligen_fn_register */
+	if (cc->cc_fn_vec == NULL && cc->cc_fn_str != NULL)
+	    cc->cc_fn_vec = (cgv_fnstype_t*)cligen_fn_lookup(h, CLIGEN_FN_CALLBACK, cc->cc_fn_str);
+	/* Vector cvec argument to callback */
+    	if (cc->cc_fn_vec){
+	    if (copy)
+		argv = cc->cc_cvec ? cvec_dup(cc->cc_cvec) : NULL;
+	    else
+		argv = cc->cc_cvec;
+	    cligen_fn_str_set(h, cc->cc_fn_str);
+	    if ((retval = (*cc->cc_fn_vec)(
+					cligen_userhandle(h)?cligen_userhandle(h):h, 
+					cvv, 
+					argv)) < 0){
+		if (copy && argv != NULL)
+		    cvec_free(argv);
+		cligen_fn_str_set(h, NULL);
+		break;
+	    }
+	    if (copy && argv != NULL)
+		cvec_free(argv);
+	    cligen_fn_str_set(h, NULL);
+	}
+    }
+    cligen_stats_stop(h, CLIGEN_STAT_EVAL, t0);
+    /* Output of the command is written at its end */
+    if (h && cligen_output_end(h) < 0)
+	retval = -1;
     return retval;
 }
 
@@ -741,6 +819,8 @@ cliread(cligen_handle h,
 	goto done;
     }
     *stringp = NULL;
+    /* Saved completion state is only valid within one line */
+    cligen_complete_state_invalidate(h);
     do {
 	buf = NULL;
 	if (gl_getline(h, &buf) < 0)
@@ -833,20 +913,23 @@ cliread_eval(cligen_handle  h,
 	fprintf(stderr, "No active parse-tree found\n");
 	goto done;;
     }
-    if ((cvv = cvec_new(0)) == NULL){
+    if ((cvv = cligen_parse_cvec_get(h)) == NULL){
 	fprintf(stderr, "%s: cvec_new: %s\n", __FUNCTION__, strerror(errno));
 	goto done;;
     }
+    cligen_stats_line_begin(h);
     if (cliread_parse(h, *line, pt, &matchobj, cvv, result, reason) < 0)
 	goto done;
     if (*result == CG_MATCH)
 	*cb_retval = cligen_eval(h, matchobj, cvv);
-    cvec_free(cvv);	
+    cligen_parse_cvec_put(h, cvv);
+    if (cligen_stats_line_end(h, *line) < 0)
+	goto done;
  ok:
     retval = 0;
  done:
     /* XXX: Get parse-tree */
-    if (pt && pt_expand_treeref_cleanup(pt) < 0) 
+    if (pt && pt_expand_treeref_release(h, pt) < 0) 
 	retval = -1;
     return retval;
 }
@@ -863,37 +946,578 @@ cliread_eval(cligen_handle  h,
  * @retval   0   otherwise
  *
  * This is the only place where cligen callbacks are invoked
+ * The argument vector of a callback is shared by the parse-tree and must not be modified
+ * by the callback, unless copying is enabled with cligen_eval_argv_copy_set.
  */
 int
 cligen_eval(cligen_handle h, 
 	    cg_obj       *co, 
 	    cvec         *cvv)
+{
+    return cligen_eval1(h, co, cvv, h ? cligen_eval_argv_copy(h) : 0);
+}
+
+/*! Read next line of a stream with getline, see cligen_line_fn_t
+ */
+static int
+cligen_stream_line(void  *arg,
+		   char **line)
+{
+    struct cligen_stream *cs = (struct cligen_stream *)arg;
+    ssize_t               len;
+
+    *line = NULL;
+    if ((len = getline(&cs->cs_buf, &cs->cs_buflen, cs->cs_f)) < 0){
+	if (ferror(cs->cs_f)){
+	    fprintf(stderr, "%s: getline: %s\n", __FUNCTION__, strerror(errno));
+	    return -1;
+	}
+	return 0; /* EOF */
+    }
+    *line = cs->cs_buf;
+    return 0;
+}
+
+/*! Default result function of cligen_eval_lines, same messages as cligen_loop
+ */
+static int
+cligen_stream_print(cligen_handle h,
+		    int           lineno,
+		    char         *line,
+		    cligen_result result,
+		    int           cb_retval,
+		    char         *reason,
+		    void         *arg)
+{
+    switch (result){
+    case CG_NOMATCH:
+	printf("CLI syntax error in: \"%s\": %s\n", line, reason);
+	break;
+    case CG_MATCH:
+	if (cb_retval < 0)
+	    printf("CLI callback error\n");
+	break;
+    default: /* multiple matches */
+	printf("Ambiguous command\n");
+	break;
+    }
+    return 0;
+}
+
+/*! Parse and evaluate a stream of command lines without interactive line editing
+ *
+ * Each line is matched against the active parse-tree and the callbacks of the matching
+ * command are invoked, as in cligen_loop, but lines are not read with gl_getline and
+ * not added to history. Scratch state is reused between lines: the variable vector, the
+ * per-line arena (see cligen_line_begin) and cached tree references. Expanded values
+ * in the parse-tree are cleared once at the end of the stream (or when the active
+ * tree changes) instead of after each line.
+ * Empty lines and comments are skipped. The stream also ends when a callback sets
+ * cligen_exiting.
+ * @param[in]  h      CLIgen handle
+ * @param[in]  next   Line iterator, sets line to NULL on end of stream
+ * @param[in]  narg   Argument given to next
+ * @param[in]  flags  CLIGEN_STREAM_STOP and/or CLIGEN_STREAM_NOCOPY
+ * @param[in]  fn     Result function called for each line, or NULL to print errors
+ *                    as cligen_loop. If it returns < 0, the stream is aborted with error.
+ * @param[in]  arg    Argument given to fn
+ * @retval    >=0     Number of failed lines: no match, ambiguous or callback error
+ * @retval    -1      Error
+ * @see cligen_eval_stream  for a FILE
+ */
+int
+cligen_eval_lines(cligen_handle       h,
+		  cligen_line_fn_t   *next,
+		  void               *narg,
+		  int                 flags,
+		  cligen_stream_fn_t *fn,
+		  void               *arg)
+{
+    int           retval = -1;
+    parse_tree   *pt;
+    parse_tree   *pt0 = NULL; /* Tree with values to clean */
+    cvec         *cvv = NULL;
+    cg_obj       *matchobj;
+    char         *line;
+    char         *reason = NULL;
+    cligen_result result;
+    int           cb_retval;
+    int           lineno = 0;
+    int           failed = 0;
+
+    if (h == NULL || next == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    if (fn == NULL)
+	fn = cligen_stream_print;
+    if ((cvv = cvec_new(0)) == NULL){
+	fprintf(stderr, "%s: cvec_new: %s\n", __FUNCTION__, strerror(errno));
+	goto done;
+    }
+    while (!cligen_exiting(h)){
+	if ((*next)(narg, &line) < 0)
+	    goto done;
+	if (line == NULL) /* EOF */
+	    break;
+	lineno++;
+	cli_trim(&line, cligen_comment(h));
+	if (strlen(line) == 0)
+	    continue;
+	if ((pt = cligen_pt_active_get(h)) == NULL){
+	    fprintf(stderr, "No active parse-tree found\n");
+	    goto done;
+	}
+	if (pt0 != pt){ /* Mode change, clean previous tree */
+	    if (pt0 && pt_expand_cleanup(pt0) < 0)
+		goto done;
+	    pt0 = pt;
+	}
+	cvec_clear(cvv);
+	cb_retval = 0;
+	cligen_stats_line_begin(h);
+	if (cliread_parse1(h, line, pt, &matchobj, cvv, &result, &reason, 0) < 0)
+	    goto done;
+	if (result == CG_ERROR){
+	    fprintf(stderr, "CLI read error\n");
+	    goto done;
+	}
+	if (result == CG_MATCH)
+	    cb_retval = cligen_eval1(h, matchobj, cvv,
+				     cligen_eval_argv_copy(h) && (flags & CLIGEN_STREAM_NOCOPY) == 0);
+	if (pt_expand_treeref_release(h, pt) < 0)
+	    goto done;
+	if (cligen_stats_line_end(h, line) < 0)
+	    goto done;
+	if ((*fn)(h, lineno, line, result, cb_retval, reason, arg) < 0)
+	    goto done;
+	if (reason){
+	    free(reason);
+	    reason = NULL;
+	}
+	if (result != CG_MATCH || cb_retval < 0){
+	    failed++;
+	    if (flags & CLIGEN_STREAM_STOP)
+		break;
+	}
+    }
+    retval = failed;
+ done:
+    if (pt0 && pt_expand_cleanup(pt0) < 0)
+	retval = -1;
+    if (reason)
+	free(reason);
+    if (cvv)
+	cvec_free(cvv);
+    return retval;
+}
+
+/* Callbacks changing mode by default, see cligen_validate_lines */
+static cgv_fnstype_t *validate_modefns[] = {cligen_wp_set, cligen_wp_up, cligen_wp_top, NULL};
+
+/* A chunk of lines of cligen_validate_lines matched by one worker */
+struct validate_worker{
+    cligen_handle           vw_h;       /* Private copy of handle, see cligen_copy */
+    pthread_t               vw_thread;
+    char                  **vw_lines;   /* All lines */
+    cligen_validate_result *vw_vr;      /* Results of all lines */
+    cgv_fnstype_t         **vw_modefns; /* Callbacks changing mode */
+    int                     vw_first;   /* First line of chunk */
+    int                     vw_last;    /* Line after chunk */
+    int                     vw_mode;    /* A line of the chunk changed mode */
+    int                     vw_ret;     /* 0: OK, -1: error */
+};
+
+/*! Invoke the callbacks of a matched object that change mode
+ * @param[in]  h       CLIgen handle
+ * @param[in]  co      Matched object
+ * @param[in]  cvv     Variables of the line
+ * @param[in]  modefns Callbacks changing mode, NULL terminated
+ * @retval     1       Mode changed
+ * @retval     0       No callback changes mode
+ * @retval    -1       A callback failed
+ */
+static int
+validate_mode(cligen_handle   h,
+	      cg_obj         *co,
+	      cvec           *cvv,
+	      cgv_fnstype_t **modefns)
 {
     struct cg_callback *cc;
     int                 retval = 0;
-    cvec               *argv;
+    int                 i;
 
-    if (h)
-	cligen_co_match_set(h, co);
     for (cc = co->co_callbacks; cc; cc=cc->cc_next){
-	/* Vector cvec argument to callback */
-    	if (cc->cc_fn_vec){
-	    argv = cc->cc_cvec ? cvec_dup(cc->cc_cvec) : NULL;
-	    cligen_fn_str_set(h, cc->cc_fn_str);
-	    if ((retval = (*cc->cc_fn_vec)(
-					cligen_userhandle(h)?cligen_userhandle(h):h, 
-					cvv, 
-					argv)) < 0){
-		if (argv != NULL)
-		    cvec_free(argv);
-		cligen_fn_str_set(h, NULL);
+	if (cc->cc_fn_vec == NULL && cc->cc_fn_str != NULL)
+	    cc->cc_fn_vec = (cgv_fnstype_t*)cligen_fn_lookup(h, CLIGEN_FN_CALLBACK, cc->cc_fn_str);
+	if (cc->cc_fn_vec == NULL)
+	    continue;
+	for (i=0; modefns[i]; i++)
+	    if (modefns[i] == cc->cc_fn_vec)
 		break;
+	if (modefns[i] == NULL)
+	    continue;
+	cligen_co_match_set(h, co);
+	if ((*cc->cc_fn_vec)(cligen_userhandle(h)?cligen_userhandle(h):h, cvv, cc->cc_cvec) < 0)
+	    return -1;
+	retval = 1;
+    }
+    return retval;
+}
+
+/*! Match the lines of a chunk with the private handle of a worker
+ *
+ * Lines are copied before they are trimmed. A line that changes mode is matched and its
+ * mode callbacks are invoked, the following lines are matched in the new mode.
+ * @param[in]  vw   Worker
+ * @retval     0    OK, results are set
+ * @retval    -1    Error
+ */
+static int
+validate_chunk(struct validate_worker *vw)
+{
+    int                     retval = -1;
+    cligen_handle           h = vw->vw_h;
+    cligen_validate_result *vr;
+    parse_tree             *pt;
+    parse_tree             *pt0 = NULL; /* Tree with values to clean */
+    cvec                   *cvv = NULL;
+    cg_obj                 *matchobj;
+    cligen_result           result;
+    char                   *reason = NULL;
+    char                   *buf = NULL;
+    size_t                  buflen = 0;
+    size_t                  len;
+    char                   *line;
+    int                     ret;
+    int                     i;
+
+    if ((cvv = cvec_new(0)) == NULL){
+	fprintf(stderr, "%s: cvec_new: %s\n", __FUNCTION__, strerror(errno));
+	goto done;
+    }
+    for (i=vw->vw_first; i<vw->vw_last; i++){
+	vr = &vw->vw_vr[i];
+	vr->vr_result = CG_MATCH; /* Empty lines and comments */
+	vr->vr_reason = NULL;
+	len = strlen(vw->vw_lines[i]);
+	if (len + 1 > buflen){
+	    buflen = 2*(len + 1);
+	    if ((buf = realloc(buf, buflen)) == NULL){
+		fprintf(stderr, "%s: realloc: %s\n", __FUNCTION__, strerror(errno));
+		goto done;
 	    }
-	    if (argv != NULL)
-		cvec_free(argv);
-	    cligen_fn_str_set(h, NULL);
 	}
+	memcpy(buf, vw->vw_lines[i], len + 1);
+	line = buf;
+	cli_trim(&line, cligen_comment(h));
+	if (strlen(line) == 0)
+	    continue;
+	if ((pt = cligen_pt_active_get(h)) == NULL){
+	    fprintf(stderr, "No active parse-tree found\n");
+	    goto done;
+	}
+	if (pt0 != pt){ /* Mode change, clean previous tree */
+	    if (pt0 && pt_expand_cleanup(pt0) < 0)
+		goto done;
+	    pt0 = pt;
+	}
+	cvec_clear(cvv);
+	if (cliread_parse1(h, line, pt, &matchobj, cvv, &result, &reason, 0) < 0)
+	    goto done;
+	if (result == CG_ERROR){
+	    fprintf(stderr, "CLI read error\n");
+	    goto done;
+	}
+	if (result == CG_MATCH &&
+	    (ret = validate_mode(h, matchobj, cvv, vw->vw_modefns)) != 0){
+	    vw->vw_mode = 1;
+	    if (ret < 0){
+		result = CG_NOMATCH;
+		if ((reason = strdup("Mode change failed")) == NULL)
+		    goto done;
+	    }
+	}
+	if (pt_expand_treeref_release(h, pt) < 0)
+	    goto done;
+	vr->vr_result = result;
+	vr->vr_reason = reason;
+	reason = NULL;
+    }
+    retval = 0;
+ done:
+    if (pt0 && pt_expand_cleanup(pt0) < 0)
+	retval = -1;
+    if (reason)
+	free(reason);
+    if (buf)
+	free(buf);
+    if (cvv)
+	cvec_free(cvv);
+    return retval;
+}
+
+/*! Thread of a worker of cligen_validate_lines
+ */
+static void *
+validate_thread(void *arg)
+{
+    struct validate_worker *vw = (struct validate_worker *)arg;
+
+    cligen_thread_set(vw->vw_h);
+    vw->vw_ret = validate_chunk(vw);
+    cligen_thread_set(NULL);
+    return NULL;
+}
+
+/*! Validate command lines without invoking callbacks, matching chunks of lines in parallel
+ *
+ * Each line is matched as by cligen_eval_lines, but only callbacks changing mode are
+ * invoked, eg cligen_wp_set. Lines are split in chunks of CLIGEN_VALIDATE_CHUNK lines,
+ * matched by a pool of worker threads. Each worker has a private copy of h, see
+ * cligen_copy, with its own parse-trees, line arena and mode, so matching in a worker
+ * does not touch h or other workers. Expand callbacks are called by the workers and must
+ * be thread-safe.
+ * A line that changes mode is a barrier: chunks after it in the same round were matched
+ * in the old mode and are matched again, starting in the mode of the worker that
+ * matched the line. The mode of h is not changed.
+ * If objects are allocated from the slab (see co_slab_set), lines are matched by one
+ * worker in the calling thread.
+ * @param[in]  h        CLIgen handle
+ * @param[in]  lines    Lines to validate, not modified
+ * @param[in]  nlines   Number of lines
+ * @param[in]  nworkers Number of worker threads
+ * @param[in]  modefns  Callbacks changing mode, NULL terminated, or NULL for the
+ *                      workpoint callbacks cligen_wp_set, cligen_wp_up and cligen_wp_top
+ * @param[out] vr       Result of each line in input order, nlines entries. Empty lines
+ *                      and comments are CG_MATCH. Free vr_reason of each entry.
+ * @retval    >=0       Number of failed lines: no match or ambiguous
+ * @retval    -1        Error
+ * @code
+ *   cligen_validate_result *vr = calloc(n, sizeof(*vr));
+ *   if ((failed = cligen_validate_lines(h, lines, n, 8, NULL, vr)) < 0)
+ *      err;
+ * @endcode
+ */
+int
+cligen_validate_lines(cligen_handle           h,
+		      char                  **lines,
+		      int                     nlines,
+		      int                     nworkers,
+		      cgv_fnstype_t         **modefns,
+		      cligen_validate_result *vr)
+{
+    int                     retval = -1;
+    struct validate_worker *vw = NULL;
+    cligen_handle           h0;
+    int                     chunk;
+    int                     n;
+    int                     i;
+    int                     j;
+    int                     k;
+    int                     mode;
+    int                     first;
+    int                     failed = 0;
+
+    if (h == NULL || nlines < 0 || (nlines && (lines == NULL || vr == NULL))){
+	errno = EINVAL;
+	return -1;
+    }
+    if (nlines == 0)
+	return 0;
+    memset(vr, 0, nlines*sizeof(*vr));
+    if (modefns == NULL)
+	modefns = validate_modefns;
+    if (nworkers < 1 || co_slab_get()) /* The slab is not thread-safe */
+	nworkers = 1;
+    chunk = CLIGEN_VALIDATE_CHUNK;
+    if (nlines < nworkers*chunk)
+	chunk = (nlines + nworkers - 1)/nworkers;
+    if (nworkers > (nlines + chunk - 1)/chunk)
+	nworkers = (nlines + chunk - 1)/chunk;
+    if ((vw = calloc(nworkers, sizeof(*vw))) == NULL){
+	fprintf(stderr, "%s: calloc: %s\n", __FUNCTION__, strerror(errno));
+	goto done;
+    }
+    for (i=0; i<nworkers; i++){
+	if ((vw[i].vw_h = cligen_copy(h)) == NULL)
+	    goto done;
+	vw[i].vw_lines = lines;
+	vw[i].vw_vr = vr;
+	vw[i].vw_modefns = modefns;
+    }
+    first = 0;
+    while (first < nlines){
+	for (n=0; n<nworkers && first + n*chunk < nlines; n++){
+	    vw[n].vw_first = first + n*chunk;
+	    vw[n].vw_last = vw[n].vw_first + chunk < nlines ? vw[n].vw_first + chunk : nlines;
+	    vw[n].vw_mode = 0;
+	    vw[n].vw_ret = 0;
+	}
+	if (n == 1){
+	    h0 = cligen_thread();
+	    cligen_thread_set(vw[0].vw_h);
+	    vw[0].vw_ret = validate_chunk(&vw[0]);
+	    cligen_thread_set(h0);
+	}
+	else {
+	    for (i=0; i<n; i++)
+		if ((errno = pthread_create(&vw[i].vw_thread, NULL, validate_thread, &vw[i])) != 0){
+		    fprintf(stderr, "%s: pthread_create: %s\n", __FUNCTION__, strerror(errno));
+		    for (j=0; j<i; j++)
+			pthread_join(vw[j].vw_thread, NULL);
+		    goto done;
+		}
+	    for (i=0; i<n; i++)
+		pthread_join(vw[i].vw_thread, NULL);
+	}
+	for (i=0; i<n; i++)
+	    if (vw[i].vw_ret < 0)
+		goto done;
+	/* Chunks after the first that changed mode are matched again in the new mode */
+	mode = 0;
+	for (k=0; k<n-1; k++)
+	    if (vw[k].vw_mode)
+		break;
+	for (i=0; i<n; i++)
+	    mode |= vw[i].vw_mode;
+	for (i=k+1; i<n; i++)
+	    for (j=vw[i].vw_first; j<vw[i].vw_last; j++)
+		if (vr[j].vr_reason){
+		    free(vr[j].vr_reason);
+		    vr[j].vr_reason = NULL;
+		}
+	if (mode)
+	    for (i=0; i<nworkers; i++)
+		if (i != k && cligen_mode_copy(vw[i].vw_h, vw[k].vw_h) < 0)
+		    goto done;
+	first = vw[k].vw_last;
+    }
+    for (i=0; i<nlines; i++)
+	if (vr[i].vr_result != CG_MATCH)
+	    failed++;
+    retval = failed;
+ done:
+    if (vw){
+	for (i=0; i<nworkers; i++)
+	    if (vw[i].vw_h)
+		cligen_exit(vw[i].vw_h);
+	free(vw);
+    }
+    if (retval < 0)
+	for (i=0; i<nlines; i++)
+	    if (vr[i].vr_reason){
+		free(vr[i].vr_reason);
+		vr[i].vr_reason = NULL;
+	    }
+    return retval;
+}
+
+/*! Next line of a paste, echoed and added to history, see cligen_line_fn_t
+ */
+static int
+cligen_paste_next(void  *arg,
+		  char **line)
+{
+    cligen_handle h = (cligen_handle)arg;
+
+    if (gl_paste_line(h, line) < 0)
+	return -1;
+    if (*line && hist_add(h, *line) < 0)
+	return -1;
+    return 0;
+}
+
+/*! Evaluate complete lines of a paste into the terminal that are not yet read
+ *
+ * A bracketed paste of several lines is read at once by gl_getline, which returns the
+ * first line. Call this after evaluating it to evaluate the other lines as a batch, see
+ * cligen_eval_lines. Each line is echoed after the prompt and added to history.
+ * An incomplete last line is left for the next gl_getline to edit.
+ * @param[in]  h      CLIgen handle
+ * @retval    >=0     Number of failed lines
+ * @retval    -1      Error
+ * @see cligen_loop
+ */
+int
+cliread_paste_eval(cligen_handle h)
+{
+    struct gl_state *prev;
+    int              pending;
+
+    prev = gl_state_set(cligen_gl_state(h));
+    pending = gl_paste_pending();
+    gl_state_set(prev);
+    if (!pending)
+	return 0;
+    return cligen_eval_lines(h, cligen_paste_next, h, 0, NULL, NULL);
+}
+
+/*! Parse and evaluate all command lines of a file, see cligen_eval_lines
+ *
+ * @param[in]  h      CLIgen handle
+ * @param[in]  f      Open file, eg stdin
+ * @param[in]  flags  CLIGEN_STREAM_STOP and/or CLIGEN_STREAM_NOCOPY
+ * @param[in]  fn     Result function called for each line, or NULL
+ * @param[in]  arg    Argument given to fn
+ * @retval    >=0     Number of failed lines
+ * @retval    -1      Error
+ */
+int
+cligen_eval_stream(cligen_handle       h,
+		   FILE               *f,
+		   int                 flags,
+		   cligen_stream_fn_t *fn,
+		   void               *arg)
+{
+    int                  retval;
+    struct cligen_stream cs = {0,};
+
+    if (f == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    cs.cs_f = f;
+    retval = cligen_eval_lines(h, cligen_stream_line, &cs, flags, fn, arg);
+    if (cs.cs_buf)
+	free(cs.cs_buf);
+    return retval;
+}
+
+/*! Parse and evaluate all command lines read from a file descriptor, see cligen_eval_lines
+ *
+ * The descriptor is read until end of file but is not closed.
+ * @param[in]  h      CLIgen handle
+ * @param[in]  fd     Open file descriptor, eg a pipe or socket
+ * @param[in]  flags  CLIGEN_STREAM_STOP and/or CLIGEN_STREAM_NOCOPY
+ * @param[in]  fn     Result function called for each line, or NULL
+ * @param[in]  arg    Argument given to fn
+ * @retval    >=0     Number of failed lines
+ * @retval    -1      Error
+ */
+int
+cligen_eval_fd(cligen_handle       h,
+	       int                 fd,
+	       int                 flags,
+	       cligen_stream_fn_t *fn,
+	       void               *arg)
+{
+    int   retval = -1;
+    int   fd1;
+    FILE *f;
+
+    if ((fd1 = dup(fd)) < 0){
+	fprintf(stderr, "%s: dup: %s\n", __FUNCTION__, strerror(errno));
+	goto done;
     }
+    if ((f = fdopen(fd1, "r")) == NULL){
+	fprintf(stderr, "%s: fdopen: %s\n", __FUNCTION__, strerror(errno));
+	close(fd1);
+	goto done;
+    }
+    retval = cligen_eval_stream(h, f, flags, fn, arg);
+    fclose(f);
+ done:
     return retval;
 }
 
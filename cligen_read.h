@@ -41,6 +41,49 @@
 /*
  * Constants
  */
+/* Flags of cligen_eval_stream */
+#define CLIGEN_STREAM_STOP   0x01 /* Stop at first failed line */
+#define CLIGEN_STREAM_NOCOPY 0x02 /* Callbacks get argv of parse-tree even if cligen_eval_argv_copy is set */
+
+/* Lines of a chunk matched by one worker of cligen_validate_lines */
+#define CLIGEN_VALIDATE_CHUNK 1024
+
+/* Max free buffers of each kind kept by a parse context, see cligen_parse_ctx_get */
+#define CLIGEN_PARSE_CTX_MAX 32
+
+/*
+ * Types
+ */
+/*! Line iterator of cligen_eval_lines
+ * @param[in]  arg   Argument given to cligen_eval_lines
+ * @param[out] line  Next line, valid until next call, or NULL on end of stream
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+typedef int (cligen_line_fn_t)(void *arg, char **line);
+
+/*! Result function of cligen_eval_lines, called once for each non-empty line
+ * @param[in]  h          CLIgen handle
+ * @param[in]  lineno     Line number in stream, first line is 1
+ * @param[in]  line       Trimmed line
+ * @param[in]  result     Match result, see cligen_result
+ * @param[in]  cb_retval  Return value of callback if result is CG_MATCH
+ * @param[in]  reason     Error reason if result is CG_NOMATCH, or NULL
+ * @param[in]  arg        Argument given to cligen_eval_lines
+ * @retval     0          OK, continue
+ * @retval    -1          Error, abort stream
+ */
+typedef int (cligen_stream_fn_t)(cligen_handle h, int lineno, char *line, cligen_result result,
+				 int cb_retval, char *reason, void *arg);
+
+/*! Reusable buffers of parsing lines, see cligen_parse_ctx_get */
+typedef struct cligen_parse_ctx cligen_parse_ctx;
+
+/*! Result of a line, see cligen_validate_lines */
+typedef struct cligen_validate_result{
+    cligen_result vr_result;  /* Match result, see cligen_result */
+    char         *vr_reason;  /* Error reason if result is CG_NOMATCH (malloced), or NULL */
+} cligen_validate_result;
 
 /*
  * Function Prototypes
@@ -51,6 +94,19 @@ void cli_trim (char **line, char comment);
 int cliread_parse(cligen_handle h, char *, parse_tree *pt, cg_obj **, cvec *cvv, cligen_result *result, char **reason);
 int cliread_eval(cligen_handle h, char **line, int *cb_ret, cligen_result *result, char **reason);
 int cligen_eval(cligen_handle h, cg_obj *co_match, cvec *vr);
+int cligen_eval_lines(cligen_handle h, cligen_line_fn_t *next, void *narg, int flags,
+		      cligen_stream_fn_t *fn, void *arg);
+int cligen_eval_stream(cligen_handle h, FILE *f, int flags, cligen_stream_fn_t *fn, void *arg);
+int cligen_eval_fd(cligen_handle h, int fd, int flags, cligen_stream_fn_t *fn, void *arg);
+int cligen_validate_lines(cligen_handle h, char **lines, int nlines, int nworkers,
+			  cgv_fnstype_t **modefns, cligen_validate_result *vr);
+int cliread_paste_eval(cligen_handle h);
+cligen_parse_ctx *cligen_parse_ctx_new(void);
+int cligen_parse_ctx_trim(cligen_parse_ctx *pc);
+int cligen_parse_ctx_free(cligen_parse_ctx *pc);
+int cligen_parse_ctx_stats(cligen_parse_ctx *pc, uint64_t *reused, uint64_t *allocated);
+cvec *cligen_parse_cvec_get(cligen_handle h);
+int cligen_parse_cvec_put(cligen_handle h, cvec *cvv);
 void cligen_echo_on(void);
 void cligen_echo_off(void);
 
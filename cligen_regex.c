@@ -334,3 +334,144 @@ match_regexp(cligen_handle h,
     retval = 0;
     goto done;
 }
+
+/*-------------------------- Cache -----------------------------------*/
+/* Compiled regular expressions of a list of patterns, eg cgs_regex of a variable
+ * The engine is recorded so that a change of cligen_regex_xsd() recompiles. 
+ */
+struct cligen_regex_cache{
+    int    rc_xsd;  /* Engine used at compile: 0: posix, 1: libxml2 */
+    int    rc_len;  /* Length of rc_vec, same as pattern vector */
+    void **rc_vec;  /* Compiled regexps, NULL if invalid */
+};
+
+/*! Free a regexp cache 
+ * Does not need a handle since the engine is stored in the cache
+ * @param[in]  cache  Regexp cache, created by match_regexp_cache
+ */
+int
+cligen_regex_cache_free(void *cache)
+{
+    struct cligen_regex_cache *rc = cache;
+    int                        i;
+
+    if (rc == NULL)
+	return 0;
+    for (i=0; i<rc->rc_len; i++){
+	if (rc->rc_vec[i] == NULL)
+	    continue;
+	if (rc->rc_xsd == 0){
+	    cligen_regex_posix_free(rc->rc_vec[i]);
+	    free(rc->rc_vec[i]);
+	}
+	else
+	    cligen_regex_libxml2_free(rc->rc_vec[i]);
+    }
+    if (rc->rc_vec)
+	free(rc->rc_vec);
+    free(rc);
+    return 0;
+}
+
+/*! Compile all patterns of a pattern vector into a new regexp cache
+ * @param[in]  h        Clicon handle
+ * @param[in]  regexv   Vector of patterns as string cvs
+ * @param[out] cachep   Regexp cache, free with cligen_regex_cache_free
+ * @retval     0        OK, invalid patterns are NULL in cache
+ * @retval    -1        Error
+ */
+static int
+cligen_regex_cache_new(cligen_handle               h,
+		       cvec                       *regexv,
+		       struct cligen_regex_cache **cachep)
+{
+    int                        retval = -1;
+    struct cligen_regex_cache *rc = NULL;
+    int                        i;
+    void                      *re;
+    
+    if ((rc = malloc(sizeof(*rc))) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	goto done;
+    }
+    memset(rc, 0, sizeof(*rc));
+    rc->rc_xsd = cligen_regex_xsd(h);
+    if (cvec_len(regexv) &&
+	(rc->rc_vec = calloc(cvec_len(regexv), sizeof(void*))) == NULL){
+	fprintf(stderr, "%s: calloc: %s\n", __FUNCTION__, strerror(errno));
+	goto done;
+    }
+    rc->rc_len = cvec_len(regexv);
+    for (i=0; i<rc->rc_len; i++){
+	re = NULL;
+	if (cligen_regex_compile(h, cv_string_get(cvec_i(regexv, i)), &re) < 0){
+	    if (re)
+		cligen_regex_free(h, re);
+	    goto done;
+	}
+	rc->rc_vec[i] = re;
+    }
+    *cachep = rc;
+    rc = NULL;
+    retval = 0;
+ done:
+    if (rc)
+	cligen_regex_cache_free(rc);
+    return retval;
+}
+
+/*! Makes a regexp check of <string> with the i:th pattern of a pattern vector, using cache
+ *
+ * Same as match_regexp but the patterns are compiled once, on first use, and stored in
+ * cache. The cache is recompiled if the regex engine or the number of patterns changes.
+ * @param[in]     h       Clicon handle
+ * @param[in]     string  Content string to match
+ * @param[in]     regexv  Vector of patterns as string cvs, V_INVERT flag means invert match
+ * @param[in]     i       Which pattern in regexv to match
+ * @param[in,out] cache   Regexp cache, NULL on first call. Free with cligen_regex_cache_free
+ * @retval       -1       Error, 
+ * @retval        0       No match
+ * @retval        1       Match
+ * @see match_regexp  for single patterns without cache
+ */
+int 
+match_regexp_cache(cligen_handle h,
+		   char         *string, 
+		   cvec         *regexv,
+		   int           i,
+		   void        **cache)
+{
+    int                        retval = -1;
+    struct cligen_regex_cache *rc;
+    int                        ret;
+
+    if (string == NULL || regexv == NULL || cache == NULL ||
+	i < 0 || i >= cvec_len(regexv)){
+	errno = EINVAL;
+	goto done;
+    }
+    rc = *cache;
+    if (rc && (rc->rc_xsd != cligen_regex_xsd(h) || rc->rc_len != cvec_len(regexv))){
+	cligen_regex_cache_free(rc);
+	*cache = rc = NULL;
+    }
+    if (rc == NULL){
+	if (cligen_regex_cache_new(h, regexv, &rc) < 0)
+	    goto done;
+	*cache = rc;
+    }
+    if (rc->rc_vec[i] == NULL) /* Invalid regular expression */
+	goto fail;
+    if ((ret = cligen_regex_exec(h, rc->rc_vec[i], string)) < 0)
+	goto done;
+    if (cv_flag(cvec_i(regexv, i), V_INVERT))
+	ret = !ret;
+    if (ret == 0)
+	goto fail;
+    retval = 1;
+ done:
+    return retval;
+ fail:
+    retval = 0;
+    goto done;
+}
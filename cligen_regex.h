@@ -49,6 +49,8 @@ int cligen_regex_compile(cligen_handle h, char *regexp, void **recomp);
 int cligen_regex_exec(cligen_handle h, void *recomp, char *string);
 int cligen_regex_free(cligen_handle h, void *recomp);
 int match_regexp(cligen_handle h, char *string, char *pattern, int invert);
+int cligen_regex_cache_free(void *cache);
+int match_regexp_cache(cligen_handle h, char *string, cvec *regexv, int i, void **cache);
 
 #endif /* _CLIGEN_REGEX_H_ */
 
@@ -0,0 +1,338 @@
+/*
+  CLI generator function registry
+
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+
+  Map names of callback, expand and translate functions in a spec to functions.
+  An application registers its functions once with cligen_fn_register, instead of
+  mapping each tree with a str2fn function (see cligen_callbackv_str2fn). Names are then
+  resolved on first use, ie when a command is evaluated or a variable expanded or
+  translated, and the function is stored in the object. Only trees that are used are
+  resolved. Use cligen_fn_resolve to resolve a whole tree up front and detect unknown names.
+*/
+
+#include "cligen_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "cligen_buf.h"
+#include "cligen_cv.h"
+#include "cligen_cvec.h"
+#include "cligen_parsetree.h"
+#include "cligen_pt_head.h"
+#include "cligen_object.h"
+#include "cligen_handle.h"
+#include "cligen_registry.h"
+
+/* One registered function */
+struct registry_entry{
+    char               *re_name; /* Function name, malloced, NULL if slot is empty */
+    enum cligen_fn_type re_type; /* Kind of function */
+    cligen_fn_t        *re_fn;   /* Function */
+};
+
+struct cligen_registry{
+    struct registry_entry *cr_vec;   /* Open addressing hash table of functions */
+    size_t                 cr_slots; /* Number of slots in cr_vec, power of two */
+    size_t                 cr_len;   /* Number of functions */
+};
+
+/*! FNV-1a hash of a function name and kind
+ */
+static inline uint32_t
+registry_hash(enum cligen_fn_type type,
+	      const char         *str)
+{
+    const unsigned char *s = (const unsigned char *)str;
+    uint32_t             h = 2166136261U;
+
+    h = (h ^ type) * 16777619U;
+    while (*s){
+	h ^= *s++;
+	h *= 16777619U;
+    }
+    return h;
+}
+
+/*! Create a new function registry
+ * @retval  cr    Registry, free with cligen_registry_free
+ * @retval  NULL  Error
+ */
+cligen_registry *
+cligen_registry_new(void)
+{
+    cligen_registry *cr;
+
+    if ((cr = malloc(sizeof(*cr))) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	return NULL;
+    }
+    memset(cr, 0, sizeof(*cr));
+    cr->cr_slots = CLIGEN_REGISTRY_SLOTS;
+    if ((cr->cr_vec = calloc(cr->cr_slots, sizeof(*cr->cr_vec))) == NULL){
+	fprintf(stderr, "%s: calloc: %s\n", __FUNCTION__, strerror(errno));
+	free(cr);
+	return NULL;
+    }
+    return cr;
+}
+
+/*! Find slot of function, or empty slot where it should be added
+ */
+static struct registry_entry *
+registry_slot(cligen_registry    *cr,
+	      enum cligen_fn_type type,
+	      char               *name)
+{
+    struct registry_entry *re;
+    size_t                 j;
+
+    j = registry_hash(type, name) & (cr->cr_slots-1);
+    while ((re = &cr->cr_vec[j])->re_name != NULL){
+	if (re->re_type == type && strcmp(re->re_name, name) == 0)
+	    break;
+	j = (j+1) & (cr->cr_slots-1);
+    }
+    return re;
+}
+
+/*! Double the hash table and rehash
+ */
+static int
+registry_grow(cligen_registry *cr)
+{
+    struct registry_entry *vec = cr->cr_vec;
+    size_t                 slots = cr->cr_slots;
+    size_t                 i;
+
+    if ((cr->cr_vec = calloc(slots*2, sizeof(*cr->cr_vec))) == NULL){
+	fprintf(stderr, "%s: calloc: %s\n", __FUNCTION__, strerror(errno));
+	cr->cr_vec = vec;
+	return -1;
+    }
+    cr->cr_slots = slots*2;
+    for (i=0; i<slots; i++)
+	if (vec[i].re_name != NULL)
+	    *registry_slot(cr, vec[i].re_type, vec[i].re_name) = vec[i];
+    free(vec);
+    return 0;
+}
+
+/*! Add a function to a registry, replace the function if the name is already registered
+ *
+ * @param[in]  cr    Registry
+ * @param[in]  type  Kind of function
+ * @param[in]  name  Function name as used in spec, copied
+ * @param[in]  fn    Function
+ * @retval     0     OK
+ * @retval    -1     Error
+ */
+int
+cligen_registry_add(cligen_registry    *cr,
+		    enum cligen_fn_type type,
+		    char               *name,
+		    cligen_fn_t        *fn)
+{
+    struct registry_entry *re;
+
+    if (cr == NULL || name == NULL || fn == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    re = registry_slot(cr, type, name);
+    if (re->re_name == NULL){
+	if ((re->re_name = strdup(name)) == NULL){
+	    fprintf(stderr, "%s: strdup: %s\n", __FUNCTION__, strerror(errno));
+	    return -1;
+	}
+	re->re_type = type;
+	cr->cr_len++;
+    }
+    re->re_fn = fn;
+    /* Keep load factor below 1/2 */
+    if (cr->cr_len*2 > cr->cr_slots && registry_grow(cr) < 0)
+	return -1;
+    return 0;
+}
+
+/*! Look up a function by kind and name
+ * @param[in]  cr    Registry
+ * @param[in]  type  Kind of function
+ * @param[in]  name  Function name
+ * @retval     fn    Function
+ * @retval     NULL  Not found
+ */
+cligen_fn_t *
+cligen_registry_lookup(cligen_registry    *cr,
+		       enum cligen_fn_type type,
+		       char               *name)
+{
+    if (cr == NULL || name == NULL)
+	return NULL;
+    return registry_slot(cr, type, name)->re_fn;
+}
+
+/*! Number of functions in registry
+ * @param[in]  cr    Registry
+ */
+size_t
+cligen_registry_len(cligen_registry *cr)
+{
+    if (cr == NULL)
+	return 0;
+    return cr->cr_len;
+}
+
+/*! Free registry
+ * @param[in]  cr    Registry
+ */
+int
+cligen_registry_free(cligen_registry *cr)
+{
+    size_t i;
+
+    if (cr == NULL)
+	return 0;
+    for (i=0; i<cr->cr_slots; i++)
+	if (cr->cr_vec[i].re_name)
+	    free(cr->cr_vec[i].re_name);
+    free(cr->cr_vec);
+    free(cr);
+    return 0;
+}
+
+/*! Register a table of functions in the registry of a handle
+ *
+ * Functions named in specs are then resolved on first use, a str2fn mapping with
+ * eg cligen_callbackv_str2fn is not necessary. Functions already resolved by objects
+ * are not changed if a name is registered again.
+ * @param[in]  h     CLIgen handle
+ * @param[in]  tab   Table of functions
+ * @param[in]  len   Number of entries in tab
+ * @retval     0     OK
+ * @retval    -1     Error
+ * @code
+ *   static cligen_fn_entry fns[] = {
+ *      {"callback", CLIGEN_FN_CALLBACK, (cligen_fn_t*)callback},
+ *      {"expand",   CLIGEN_FN_EXPAND,   (cligen_fn_t*)expand_cb},
+ *   };
+ *   cligen_fn_register(h, fns, sizeof(fns)/sizeof(fns[0]));
+ * @endcode
+ */
+int
+cligen_fn_register(cligen_handle    h,
+		   cligen_fn_entry *tab,
+		   int              len)
+{
+    cligen_registry *cr;
+    int              i;
+
+    if (tab == NULL && len != 0){
+	errno = EINVAL;
+	return -1;
+    }
+    if ((cr = cligen_fn_registry(h)) == NULL){
+	if ((cr = cligen_registry_new()) == NULL)
+	    return -1;
+	cligen_fn_registry_set(h, cr);
+    }
+    for (i=0; i<len; i++)
+	if (cligen_registry_add(cr, tab[i].fe_type, tab[i].fe_name, tab[i].fe_fn) < 0)
+	    return -1;
+    return 0;
+}
+
+/*! Look up a function in the registry of a handle
+ * @param[in]  h     CLIgen handle
+ * @param[in]  type  Kind of function
+ * @param[in]  name  Function name
+ * @retval     fn    Function
+ * @retval     NULL  Not found, or no functions registered
+ */
+cligen_fn_t *
+cligen_fn_lookup(cligen_handle       h,
+		 enum cligen_fn_type type,
+		 char               *name)
+{
+    return cligen_registry_lookup(cligen_fn_registry(h), type, name);
+}
+
+/*! Resolve all function names of a parse-tree using the registry of a handle
+ *
+ * Names are otherwise resolved on first use, this is for applications that want to
+ * detect unknown names when loading a spec.
+ * @param[in]  h     CLIgen handle
+ * @param[in]  pt    Parse-tree, recursively
+ * @retval     0     OK
+ * @retval    -1     Error, or unknown function name, statement written on stderr
+ */
+int
+cligen_fn_resolve(cligen_handle h,
+		  parse_tree   *pt)
+{
+    int                 retval = -1;
+    cg_obj             *co;
+    struct cg_callback *cc;
+    int                 i;
+
+    for (i=0; i<pt_len_get(pt); i++){
+	if ((co = pt_vec_i_get(pt, i)) == NULL)
+	    continue;
+	for (cc = co->co_callbacks; cc; cc=cc->cc_next)
+	    if (cc->cc_fn_str != NULL && cc->cc_fn_vec == NULL &&
+		(cc->cc_fn_vec = (cgv_fnstype_t*)cligen_fn_lookup(h, CLIGEN_FN_CALLBACK, cc->cc_fn_str)) == NULL){
+		fprintf(stderr, "%s: error: No such function: %s\n", __FUNCTION__, cc->cc_fn_str);
+		goto done;
+	    }
+	if (co->co_type == CO_VARIABLE){
+	    if (co->co_expand_fn_str != NULL && co->co_expandv_fn == NULL &&
+		(co->co_expandv_fn = (expandv_cb*)cligen_fn_lookup(h, CLIGEN_FN_EXPAND, co->co_expand_fn_str)) == NULL){
+		fprintf(stderr, "%s: error: No such function: %s\n", __FUNCTION__, co->co_expand_fn_str);
+		goto done;
+	    }
+	    if (co->co_translate_fn_str != NULL && co->co_translate_fn == NULL &&
+		(co->co_translate_fn = (translate_cb_t*)cligen_fn_lookup(h, CLIGEN_FN_TRANSLATE, co->co_translate_fn_str)) == NULL){
+		fprintf(stderr, "%s: error: No such function: %s\n", __FUNCTION__, co->co_translate_fn_str);
+		goto done;
+	    }
+	}
+	if (cligen_fn_resolve(h, co_pt_get(co)) < 0)
+	    goto done;
+    }
+    retval = 0;
+ done:
+    return retval;
+}
@@ -0,0 +1,81 @@
+/*
+  CLI generator function registry
+
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+
+  This file includes a registry of callback, expand and translate functions by name
+*/
+
+#ifndef _CLIGEN_REGISTRY_H_
+#define _CLIGEN_REGISTRY_H_
+
+/*
+ * Constants
+ */
+/* Initial number of slots in registry hash tables, power of two */
+#define CLIGEN_REGISTRY_SLOTS 64
+
+/*
+ * Types
+ */
+/* Kinds of functions named in a spec */
+enum cligen_fn_type{
+    CLIGEN_FN_CALLBACK,  /* Command callback, cgv_fnstype_t */
+    CLIGEN_FN_EXPAND,    /* Expand callback of variable, expandv_cb */
+    CLIGEN_FN_TRANSLATE, /* Translate function of variable, translate_cb_t */
+};
+
+/* Generic function pointer of registry, cast to and from the type of the function */
+typedef void (cligen_fn_t)(void);
+
+/* Entry of a table of functions given to cligen_fn_register */
+typedef struct cligen_fn_entry{
+    char               *fe_name; /* Function name as used in spec */
+    enum cligen_fn_type fe_type; /* Kind of function */
+    cligen_fn_t        *fe_fn;   /* Function, eg (cligen_fn_t*)callback */
+} cligen_fn_entry;
+
+typedef struct cligen_registry cligen_registry; /* struct defined internally in cligen_registry.c */
+
+/*
+ * Prototypes
+ */
+cligen_registry *cligen_registry_new(void);
+int          cligen_registry_add(cligen_registry *cr, enum cligen_fn_type type, char *name, cligen_fn_t *fn);
+cligen_fn_t *cligen_registry_lookup(cligen_registry *cr, enum cligen_fn_type type, char *name);
+size_t       cligen_registry_len(cligen_registry *cr);
+int          cligen_registry_free(cligen_registry *cr);
+int          cligen_fn_register(cligen_handle h, cligen_fn_entry *tab, int len);
+cligen_fn_t *cligen_fn_lookup(cligen_handle h, enum cligen_fn_type type, char *name);
+int          cligen_fn_resolve(cligen_handle h, parse_tree *pt);
+
+#endif /* _CLIGEN_REGISTRY_H_ */
@@ -0,0 +1,859 @@
+/*
+  CLI generator server of sessions
+
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+
+  A server hosts many CLI sessions in one process, eg one per socket of an operator
+  connection, instead of one process per session each loading and expanding the spec.
+  The parse-trees of a spec are loaded once into a handle, which is wrapped in a reference
+  counted cligen_spec. Each session has a lightweight handle (see cligen_clone) with its
+  own prompt, history, buffers, workpoints and output, sharing the parse-trees of a spec.
+  Sessions are driven by one event loop on registered file descriptors, see cligen_regfd,
+  and evaluate one command at a time, so the shared trees are only used by one command
+  at a time and are left as loaded between commands.
+  A reload of the spec swaps in a new version with cligen_server_spec_set. Sessions that
+  are not evaluating a command move to it at once, a session evaluating a command (eg the
+  one that made the reload) keeps the old version until the command is done. The old
+  version is freed when no session uses it.
+  Output of a session is collected in memory and written to its file descriptor without
+  blocking, so that a session whose peer does not read does not stop the other sessions.
+  Output not yet written is kept until the descriptor is writable, and a session with
+  more than CLIGEN_SESSION_OBUF_MAX bytes of such output is closed.
+  Sessions read complete lines, there is no line editing or completion: gl_getline reads
+  the terminal on stdin, see cligen_loop.
+*/
+
+#include "cligen_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include "cligen_buf.h"
+#include "cligen_cv.h"
+#include "cligen_cvec.h"
+#include "cligen_parsetree.h"
+#include "cligen_pt_head.h"
+#include "cligen_object.h"
+#include "cligen_handle.h"
+#include "cligen_read.h"
+#include "cligen_io.h"
+#include "cligen_expand.h"
+#include "cligen_getline.h"
+#include "cligen_history_internal.h"
+#include "cligen_server.h"
+
+/*
+ * Types
+ */
+/* Version of a spec: parse-trees loaded into a handle, shared by sessions */
+struct cligen_spec{
+    cligen_handle   sp_h;       /* Handle owning the parse-trees */
+    int             sp_refcnt;  /* Users: creator, server and sessions */
+    int             sp_version; /* Version in server, see cligen_server_spec_set */
+};
+
+/* A session of a server */
+struct cligen_session{
+    cligen_session *ss_next;    /* Next session of server */
+    cligen_server  *ss_srv;     /* Server of session */
+    cligen_handle   ss_h;       /* Handle sharing the parse-trees of ss_spec */
+    cligen_spec    *ss_spec;    /* Spec version used by session */
+    int             ss_fdin;    /* Input of session */
+    int             ss_fdout;   /* Output of session, non-blocking */
+    int             ss_fdflags; /* File status flags of ss_fdout, restored on free */
+    FILE           *ss_fout;    /* Output in memory, see cligen_output_file_set */
+    char           *ss_mbuf;    /* Buffer of ss_fout */
+    size_t          ss_mlen;    /* Length of output in ss_mbuf */
+    char           *ss_obuf;    /* Output not yet written to ss_fdout */
+    size_t          ss_olen;    /* End of output in ss_obuf */
+    size_t          ss_opos;    /* Start of output not yet written */
+    size_t          ss_obuflen; /* Size of ss_obuf */
+    int             ss_wait;    /* Waiting for ss_fdout to be writable */
+    char           *ss_buf;     /* Input not yet evaluated */
+    size_t          ss_len;     /* Length of input in ss_buf */
+    size_t          ss_buflen;  /* Size of ss_buf */
+    size_t          ss_pos;     /* Start of next line in ss_buf */
+    int             ss_busy;    /* Evaluating commands, keep ss_spec */
+    int             ss_closing; /* End of input or exit, free when not busy */
+};
+
+struct cligen_server{
+    cligen_spec    *sv_spec;     /* Current spec version, used by new commands */
+    int             sv_version;  /* Latest version number */
+    cligen_session *sv_sessions; /* List of sessions */
+    int             sv_nsessions; /* Number of sessions */
+    int             sv_listen;   /* Listening socket, or -1 */
+    int             sv_exiting;  /* Set by cligen_server_exit_set */
+};
+
+/*! Create a spec version from the parse-trees of a handle
+ *
+ * The handle is owned by the spec, and freed with it by cligen_spec_release. Load and map
+ * the parse-trees, and set the prompt and other settings of sessions, before this call,
+ * then do not use the handle for commands. Expanded tree references are removed and
+ * labels of objects are computed here, so that the trees are not changed by sessions
+ * between commands.
+ * @param[in] h    CLIgen handle with parse-trees
+ * @retval    sp   Spec, with one reference held by the caller
+ * @retval    NULL Error
+ * @see cligen_spec_release
+ */
+cligen_spec *
+cligen_spec_new(cligen_handle h)
+{
+    cligen_spec *sp;
+    pt_head     *ph = NULL;
+    parse_tree  *pt;
+
+    if (h == NULL){
+	errno = EINVAL;
+	return NULL;
+    }
+    if ((sp = malloc(sizeof(*sp))) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	return NULL;
+    }
+    memset(sp, 0, sizeof(*sp));
+    if (cligen_treeref_cache_set(h, 0) < 0)
+	goto err;
+    while ((ph = cligen_ph_each(h, ph)) != NULL){
+	if ((pt = cligen_ph_parsetree_get(ph)) == NULL)
+	    continue;
+	if (pt_expand_treeref_cleanup(pt) < 0)
+	    goto err;
+	if (cligen_parsetree_labels(h, pt) < 0)
+	    goto err;
+    }
+    sp->sp_h = h;
+    sp->sp_refcnt = 1;
+    return sp;
+ err:
+    free(sp);
+    return NULL;
+}
+
+/*! Hold a reference to a spec version
+ * @param[in] sp   Spec
+ * @retval    0    OK
+ */
+int
+cligen_spec_hold(cligen_spec *sp)
+{
+    sp->sp_refcnt++;
+    return 0;
+}
+
+/*! Release a reference to a spec version, free it and its handle if it was the last
+ * @param[in] sp   Spec
+ * @retval    0    OK
+ * @retval   -1    Error
+ */
+int
+cligen_spec_release(cligen_spec *sp)
+{
+    if (sp == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    if (--sp->sp_refcnt > 0)
+	return 0;
+    if (sp->sp_h)
+	cligen_exit(sp->sp_h);
+    free(sp);
+    return 0;
+}
+
+/*! Get handle owning the parse-trees of a spec version
+ */
+cligen_handle
+cligen_spec_handle(cligen_spec *sp)
+{
+    return sp->sp_h;
+}
+
+/*! Get version number of a spec, 0 until set in a server
+ */
+int
+cligen_spec_version(cligen_spec *sp)
+{
+    return sp->sp_version;
+}
+
+/*! Use a spec version in a session, release the previous version
+ * @param[in] ss   Session, not evaluating a command
+ * @param[in] sp   Spec
+ * @retval    0    OK
+ * @retval   -1    Error
+ */
+static int
+session_attach(cligen_session *ss,
+	       cligen_spec    *sp)
+{
+    cligen_spec *sp0 = ss->ss_spec;
+
+    if (sp0 == sp)
+	return 0;
+    if (cligen_share(ss->ss_h, sp->sp_h) < 0)
+	return -1;
+    cligen_spec_hold(sp);
+    ss->ss_spec = sp;
+    if (sp0 && cligen_spec_release(sp0) < 0)
+	return -1;
+    return 0;
+}
+
+/*! Next complete line of input of a session, see cligen_line_fn_t
+ *
+ * Ends the lines to evaluate when the spec version of the server has changed, so that
+ * the session moves to it before the next command.
+ */
+static int
+session_next(void  *arg,
+	     char **line)
+{
+    cligen_session *ss = (cligen_session *)arg;
+    char           *str;
+    char           *nl;
+
+    *line = NULL;
+    if (ss->ss_spec != ss->ss_srv->sv_spec)
+	return 0;
+    str = ss->ss_buf + ss->ss_pos;
+    if ((nl = memchr(str, '\n', ss->ss_len - ss->ss_pos)) == NULL)
+	return 0;
+    ss->ss_pos += nl - str + 1;
+    *nl = '\0';
+    if (nl > str && nl[-1] == '\r')
+	nl[-1] = '\0';
+    if (strlen(str) && hist_add(ss->ss_h, str) < 0)
+	return -1;
+    *line = str;
+    return 0;
+}
+
+/*! Write output of a session not yet written, without blocking
+ * @param[in] ss   Session
+ * @retval    1    All output written
+ * @retval    0    Output left, ss_fdout is not writable
+ * @retval   -1    Error, eg peer closed
+ */
+static int
+session_write(cligen_session *ss)
+{
+    ssize_t n;
+
+    while (ss->ss_opos < ss->ss_olen){
+	if ((n = write(ss->ss_fdout, ss->ss_obuf + ss->ss_opos, ss->ss_olen - ss->ss_opos)) < 0){
+	    if (errno == EINTR)
+		continue;
+	    if (errno == EAGAIN || errno == EWOULDBLOCK)
+		return 0;
+	    return -1;
+	}
+	ss->ss_opos += n;
+    }
+    ss->ss_olen = ss->ss_opos = 0;
+    return 1;
+}
+
+/*! Write output of a session when its output is writable, see cligen_fd_cb_t
+ *
+ * A closing session is freed when its output is written.
+ */
+static int
+session_writable(int   fd,
+		 void *arg)
+{
+    cligen_session *ss = (cligen_session *)arg;
+    int             ret;
+
+    if ((ret = session_write(ss)) == 0)
+	return 0;
+#if CLIGEN_REGFD
+    cligen_unregfd_write(ss->ss_fdout);
+#endif
+    ss->ss_wait = 0;
+    if (ret < 0 || (ss->ss_closing && !ss->ss_busy))
+	return cligen_session_free(ss);
+    return 0;
+}
+
+/*! Move output of a session from memory to its output and write it without blocking
+ *
+ * Output that is not written is kept, and written when the output is writable.
+ * @param[in] ss   Session
+ * @retval    0    OK
+ * @retval   -1    Error, eg peer closed or more than CLIGEN_SESSION_OBUF_MAX bytes left
+ */
+static int
+session_output(cligen_session *ss)
+{
+    size_t len;
+    size_t buflen;
+    char  *buf;
+    int    ret;
+
+    if (fflush(ss->ss_fout) < 0)
+	return -1;
+    if (ss->ss_mlen){
+	len = ss->ss_olen - ss->ss_opos;
+	if (len + ss->ss_mlen > CLIGEN_SESSION_OBUF_MAX){
+	    errno = ENOBUFS;
+	    return -1;
+	}
+	if (ss->ss_opos){
+	    memmove(ss->ss_obuf, ss->ss_obuf + ss->ss_opos, len);
+	    ss->ss_olen = len;
+	    ss->ss_opos = 0;
+	}
+	if (ss->ss_olen + ss->ss_mlen > ss->ss_obuflen){
+	    buflen = ss->ss_obuflen ? ss->ss_obuflen : CLIGEN_SESSION_BUFLEN;
+	    while (buflen < ss->ss_olen + ss->ss_mlen)
+		buflen *= 2;
+	    if ((buf = realloc(ss->ss_obuf, buflen)) == NULL){
+		fprintf(stderr, "%s: realloc: %s\n", __FUNCTION__, strerror(errno));
+		return -1;
+	    }
+	    ss->ss_obuf = buf;
+	    ss->ss_obuflen = buflen;
+	}
+	memcpy(ss->ss_obuf + ss->ss_olen, ss->ss_mbuf, ss->ss_mlen);
+	ss->ss_olen += ss->ss_mlen;
+	rewind(ss->ss_fout);
+	ss->ss_mlen = 0;
+    }
+    if (ss->ss_wait)
+	return 0;
+    if ((ret = session_write(ss)) < 0)
+	return -1;
+#if CLIGEN_REGFD
+    if (ret == 0){
+	if (cligen_regfd_write(ss->ss_fdout, session_writable, ss) < 0)
+	    return -1;
+	ss->ss_wait = 1;
+    }
+#endif
+    return 0;
+}
+
+/*! Close a session, when its output is written
+ * @param[in] ss   Session, not evaluating a command
+ */
+static int
+session_close(cligen_session *ss)
+{
+    ss->ss_closing = 1;
+    if (ss->ss_wait){ /* Stop reading, freed by session_writable */
+#if CLIGEN_REGFD
+	cligen_unregfd(ss->ss_fdin);
+#endif
+	return 0;
+    }
+    return cligen_session_free(ss);
+}
+
+/*! Print result of a command of a session, see cligen_stream_fn_t
+ *
+ * Output of the command is written here, not only when all lines are evaluated.
+ */
+static int
+session_result(cligen_handle h,
+	       int           lineno,
+	       char         *line,
+	       cligen_result result,
+	       int           cb_retval,
+	       char         *reason,
+	       void         *arg)
+{
+    cligen_session *ss = (cligen_session *)arg;
+    int             retval = -1;
+
+    switch (result){
+    case CG_NOMATCH:
+	if (cligen_output(stdout, "CLI syntax error in: \"%s\": %s\n", line, reason) < 0)
+	    goto done;
+	break;
+    case CG_MATCH:
+	if (cb_retval < 0 &&
+	    cligen_output(stdout, "CLI callback error\n") < 0)
+	    goto done;
+	break;
+    default: /* multiple matches */
+	if (cligen_output(stdout, "Ambiguous command\n") < 0)
+	    goto done;
+	break;
+    }
+    if (session_output(ss) < 0)
+	goto done;
+    retval = 0;
+ done:
+    return retval;
+}
+
+/*! Evaluate complete lines of input of a session and show the prompt
+ * @param[in] ss   Session
+ * @retval    0    OK
+ * @retval   -1    Error
+ */
+static int
+session_eval(cligen_session *ss)
+{
+    int            retval = -1;
+    cligen_server *srv = ss->ss_srv;
+    cligen_handle  h = ss->ss_h;
+    cligen_handle  h0;
+
+    h0 = cligen_thread();
+    cligen_thread_set(h);
+    ss->ss_busy = 1;
+    while (!cligen_exiting(h) &&
+	   memchr(ss->ss_buf + ss->ss_pos, '\n', ss->ss_len - ss->ss_pos) != NULL){
+	if (session_attach(ss, srv->sv_spec) < 0)
+	    goto done;
+	if (cligen_eval_lines(h, session_next, ss, 0, session_result, ss) < 0)
+	    goto done;
+    }
+    ss->ss_busy = 0;
+    /* The command may have reloaded the spec, release the old version */
+    if (session_attach(ss, srv->sv_spec) < 0)
+	goto done;
+    if (ss->ss_pos){
+	memmove(ss->ss_buf, ss->ss_buf + ss->ss_pos, ss->ss_len - ss->ss_pos);
+	ss->ss_len -= ss->ss_pos;
+	ss->ss_pos = 0;
+    }
+    if (cligen_exiting(h))
+	ss->ss_closing = 1;
+    else if (!ss->ss_closing &&
+	     cligen_output(stdout, "%s", cligen_prompt(h)) < 0)
+	goto done;
+    if (session_output(ss) < 0)
+	goto done;
+    retval = 0;
+ done:
+    ss->ss_busy = 0;
+    cligen_thread_set(h0);
+    return retval;
+}
+
+/*! Read input of a session and evaluate complete lines, see cligen_fd_cb_t
+ *
+ * The session is closed at end of input, on error, or if a command sets cligen_exiting,
+ * and freed when its output is written. Errors of a session do not stop the server.
+ */
+static int
+session_input(int   fd,
+	      void *arg)
+{
+    cligen_session *ss = (cligen_session *)arg;
+    char           *buf;
+    size_t          buflen;
+    ssize_t         n;
+
+    if (ss->ss_buflen - ss->ss_len < CLIGEN_SESSION_BUFLEN/2){
+	buflen = ss->ss_buflen ? 2*ss->ss_buflen : CLIGEN_SESSION_BUFLEN;
+	if ((buf = realloc(ss->ss_buf, buflen)) == NULL){
+	    fprintf(stderr, "%s: realloc: %s\n", __FUNCTION__, strerror(errno));
+	    goto close;
+	}
+	ss->ss_buf = buf;
+	ss->ss_buflen = buflen;
+    }
+    /* Leave room for a newline at end of input */
+    if ((n = read(fd, ss->ss_buf + ss->ss_len, ss->ss_buflen - ss->ss_len - 1)) < 0){
+	if (errno == EINTR || errno == EAGAIN)
+	    return 0;
+	goto close;
+    }
+    if (n == 0){ /* End of input, evaluate an unterminated last line */
+	ss->ss_closing = 1;
+	if (ss->ss_len > ss->ss_pos && ss->ss_buf[ss->ss_len-1] != '\n')
+	    ss->ss_buf[ss->ss_len++] = '\n';
+    }
+    ss->ss_len += n;
+    if (session_eval(ss) < 0)
+	goto close;
+    if (!ss->ss_closing)
+	return 0;
+ close:
+    return session_close(ss);
+}
+
+/*! Create a session of a server, reading commands from fdin and writing output to fdout
+ *
+ * The session uses the current spec version of the server. Its handle is made with
+ * cligen_clone of the handle of the spec, and all cligen_output to stdout of the session
+ * is written to fdout. The prompt is written when the session is ready for a command.
+ * The session owns the file descriptors, they are closed by cligen_session_free, or here
+ * on error.
+ * fdout is set non-blocking while the session exists, output is written when fdout is
+ * writable, see cligen_regfd_write. Callbacks write output of a session with
+ * cligen_output to stdout or to cligen_output_file, not to fdout directly.
+ * The session has no line editing, completion or paging, see cligen_loop for a terminal.
+ * @param[in] srv    Server
+ * @param[in] fdin   Input, eg a socket or pty
+ * @param[in] fdout  Output, may be the same as fdin
+ * @retval    ss     Session
+ * @retval    NULL   Error
+ */
+cligen_session *
+cligen_session_new(cligen_server *srv,
+		   int            fdin,
+		   int            fdout)
+{
+    cligen_session *ss;
+    cligen_handle   h0;
+
+    if (srv == NULL || fdin < 0 || fdout < 0){
+	errno = EINVAL;
+	return NULL;
+    }
+    if ((ss = malloc(sizeof(*ss))) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	goto close;
+    }
+    memset(ss, 0, sizeof(*ss));
+    ss->ss_srv = srv;
+    ss->ss_fdin = fdin;
+    ss->ss_fdout = fdout;
+    if ((ss->ss_fdflags = fcntl(fdout, F_GETFL)) < 0){
+	fprintf(stderr, "%s: fcntl: %s\n", __FUNCTION__, strerror(errno));
+	free(ss);
+	goto close;
+    }
+#if CLIGEN_REGFD
+    if (fcntl(fdout, F_SETFL, ss->ss_fdflags | O_NONBLOCK) < 0){
+	fprintf(stderr, "%s: fcntl: %s\n", __FUNCTION__, strerror(errno));
+	free(ss);
+	goto close;
+    }
+#endif
+    if ((ss->ss_fout = open_memstream(&ss->ss_mbuf, &ss->ss_mlen)) == NULL){
+	fprintf(stderr, "%s: open_memstream: %s\n", __FUNCTION__, strerror(errno));
+	fcntl(fdout, F_SETFL, ss->ss_fdflags);
+	free(ss);
+	goto close;
+    }
+    ss->ss_next = srv->sv_sessions;
+    srv->sv_sessions = ss;
+    srv->sv_nsessions++;
+    if ((ss->ss_h = cligen_clone(srv->sv_spec->sp_h)) == NULL)
+	goto err;
+    cligen_spec_hold(srv->sv_spec);
+    ss->ss_spec = srv->sv_spec;
+    cligen_output_file_set(ss->ss_h, ss->ss_fout);
+#if CLIGEN_REGFD
+    if (cligen_regfd(fdin, session_input, ss) < 0)
+	goto err;
+#endif
+    h0 = cligen_thread();
+    cligen_thread_set(ss->ss_h);
+    if (cligen_output(stdout, "%s", cligen_prompt(ss->ss_h)) < 0){
+	cligen_thread_set(h0);
+	goto err;
+    }
+    cligen_thread_set(h0);
+    if (session_output(ss) < 0)
+	goto err;
+    return ss;
+ err:
+    cligen_session_free(ss);
+    return NULL;
+ close:
+    if (fdin != fdout)
+	close(fdin);
+    close(fdout);
+    return NULL;
+}
+
+/*! Free a session, close its file descriptors and release its spec version
+ *
+ * May be called from a callback of a command of the session, the session is then freed
+ * when the command is done. Output not yet written is dropped.
+ * @param[in] ss   Session
+ * @retval    0    OK
+ * @retval   -1    Error
+ */
+int
+cligen_session_free(cligen_session *ss)
+{
+    cligen_server   *srv;
+    cligen_session **ssp;
+
+    if (ss == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    if (ss->ss_busy){
+	ss->ss_closing = 1;
+	if (ss->ss_h)
+	    cligen_exiting_set(ss->ss_h, 1);
+	return 0;
+    }
+    srv = ss->ss_srv;
+    for (ssp = &srv->sv_sessions; *ssp; ssp = &(*ssp)->ss_next)
+	if (*ssp == ss){
+	    *ssp = ss->ss_next;
+	    srv->sv_nsessions--;
+	    break;
+	}
+#if CLIGEN_REGFD
+    cligen_unregfd(ss->ss_fdin);
+    if (ss->ss_wait)
+	cligen_unregfd_write(ss->ss_fdout);
+#endif
+    if (ss->ss_h){
+	if (cligen_thread() == ss->ss_h)
+	    cligen_thread_set(NULL);
+	cligen_exit(ss->ss_h);
+    }
+    if (ss->ss_spec)
+	cligen_spec_release(ss->ss_spec);
+    if (ss->ss_fdin != ss->ss_fdout)
+	close(ss->ss_fdin);
+    fcntl(ss->ss_fdout, F_SETFL, ss->ss_fdflags);
+    close(ss->ss_fdout);
+    fclose(ss->ss_fout);
+    if (ss->ss_mbuf)
+	free(ss->ss_mbuf);
+    if (ss->ss_obuf)
+	free(ss->ss_obuf);
+    if (ss->ss_buf)
+	free(ss->ss_buf);
+    free(ss);
+    return 0;
+}
+
+/*! Get handle of a session
+ */
+cligen_handle
+cligen_session_handle(cligen_session *ss)
+{
+    return ss->ss_h;
+}
+
+/*! Create a server of sessions using a spec version
+ * @param[in] sp   Spec, the server holds a reference to it
+ * @retval    srv  Server, free with cligen_server_free
+ * @retval    NULL Error
+ */
+cligen_server *
+cligen_server_new(cligen_spec *sp)
+{
+    cligen_server *srv;
+
+    if (sp == NULL){
+	errno = EINVAL;
+	return NULL;
+    }
+    if ((srv = malloc(sizeof(*srv))) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	return NULL;
+    }
+    memset(srv, 0, sizeof(*srv));
+    srv->sv_listen = -1;
+    cligen_spec_hold(sp);
+    sp->sp_version = ++srv->sv_version;
+    srv->sv_spec = sp;
+    return srv;
+}
+
+/*! Free a server, its sessions and its reference to the spec
+ * @param[in] srv  Server
+ * @retval    0    OK
+ * @retval   -1    Error
+ */
+int
+cligen_server_free(cligen_server *srv)
+{
+    cligen_session *ss;
+
+    if (srv == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    while ((ss = srv->sv_sessions) != NULL){
+	ss->ss_busy = 0;
+	cligen_session_free(ss);
+    }
+#if CLIGEN_REGFD
+    if (srv->sv_listen != -1)
+	cligen_unregfd(srv->sv_listen);
+#endif
+    if (srv->sv_spec)
+	cligen_spec_release(srv->sv_spec);
+    free(srv);
+    return 0;
+}
+
+/*! Get current spec version of a server
+ */
+cligen_spec *
+cligen_server_spec(cligen_server *srv)
+{
+    return srv->sv_spec;
+}
+
+/*! Swap in a new spec version, eg after a reload of the spec
+ *
+ * The swap is made at once: new sessions and all following commands use the new version.
+ * Sessions that are evaluating a command, eg the one whose callback made the swap, keep
+ * the old version until the command is done. The old version is freed when the last
+ * session leaves it.
+ * @param[in] srv  Server
+ * @param[in] sp   New spec, the server holds a reference to it
+ * @retval    0    OK
+ * @retval   -1    Error
+ */
+int
+cligen_server_spec_set(cligen_server *srv,
+		       cligen_spec   *sp)
+{
+    int             retval = -1;
+    cligen_spec    *sp0;
+    cligen_session *ss;
+
+    if (srv == NULL || sp == NULL){
+	errno = EINVAL;
+	goto done;
+    }
+    if ((sp0 = srv->sv_spec) == sp)
+	goto ok;
+    cligen_spec_hold(sp);
+    sp->sp_version = ++srv->sv_version;
+    srv->sv_spec = sp;
+    for (ss = srv->sv_sessions; ss; ss = ss->ss_next)
+	if (!ss->ss_busy && session_attach(ss, sp) < 0)
+	    goto done;
+    if (cligen_spec_release(sp0) < 0)
+	goto done;
+ ok:
+    retval = 0;
+ done:
+    return retval;
+}
+
+/*! Get number of sessions of a server
+ */
+int
+cligen_server_sessions(cligen_server *srv)
+{
+    return srv->sv_nsessions;
+}
+
+/*! Accept a connection on the listening socket and create a session, see cligen_fd_cb_t
+ */
+static int
+server_accept(int   fd,
+	      void *arg)
+{
+    cligen_server *srv = (cligen_server *)arg;
+    int            s;
+
+    if ((s = accept(fd, NULL, NULL)) < 0){
+	if (errno == EINTR || errno == EAGAIN || errno == ECONNABORTED)
+	    return 0;
+	return -1;
+    }
+    (void)cligen_session_new(srv, s, s);
+    return 0;
+}
+
+/*! Create a session for each connection accepted on a listening socket
+ *
+ * The socket is bound and listening, eg a UNIX socket. The application should ignore
+ * SIGPIPE, so that a session whose peer has closed does not stop the server.
+ * @param[in] srv  Server
+ * @param[in] fd   Listening socket, owned by the application
+ * @retval    0    OK
+ * @retval   -1    Error
+ */
+int
+cligen_server_listen(cligen_server *srv,
+		     int            fd)
+{
+    if (srv == NULL || fd < 0){
+	errno = EINVAL;
+	return -1;
+    }
+#if CLIGEN_REGFD
+    if (cligen_regfd(fd, server_accept, srv) < 0)
+	return -1;
+    srv->sv_listen = fd;
+    return 0;
+#else
+    errno = ENOTSUP;
+    return -1;
+#endif
+}
+
+/*! Stop the event loop of a server, eg from a callback
+ */
+int
+cligen_server_exit_set(cligen_server *srv)
+{
+    srv->sv_exiting = 1;
+    return 0;
+}
+
+/*! Event loop of a server: serve sessions and other registered file descriptors
+ *
+ * Returns when cligen_server_exit_set is called, or when there are no sessions and no
+ * listening socket.
+ * @param[in] srv  Server
+ * @retval    0    OK
+ * @retval   -1    Error
+ */
+int
+cligen_server_loop(cligen_server *srv)
+{
+    if (srv == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+#if CLIGEN_REGFD
+    while (!srv->sv_exiting && (srv->sv_nsessions > 0 || srv->sv_listen != -1))
+	if (gl_select_timeout(-1) < 0)
+	    return -1;
+    return 0;
+#else
+    errno = ENOTSUP;
+    return -1;
+#endif
+}
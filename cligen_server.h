@@ -0,0 +1,78 @@
+/*
+  CLI generator server of sessions
+
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+
+  This file includes a server hosting many CLI sessions that share the parse-trees of a spec
+*/
+
+#ifndef _CLIGEN_SERVER_H_
+#define _CLIGEN_SERVER_H_
+
+/*
+ * Constants
+ */
+/* Initial size of the input buffer of a session */
+#define CLIGEN_SESSION_BUFLEN 1024
+
+/* Max output of a session not yet written, eg when its peer does not read. The session
+ * is closed if it has more */
+#define CLIGEN_SESSION_OBUF_MAX (1024*1024)
+
+/*
+ * Types
+ */
+typedef struct cligen_spec    cligen_spec;    /* struct defined internally in cligen_server.c */
+typedef struct cligen_server  cligen_server;  /* struct defined internally in cligen_server.c */
+typedef struct cligen_session cligen_session; /* struct defined internally in cligen_server.c */
+
+/*
+ * Prototypes
+ */
+cligen_spec    *cligen_spec_new(cligen_handle h);
+int             cligen_spec_hold(cligen_spec *sp);
+int             cligen_spec_release(cligen_spec *sp);
+cligen_handle   cligen_spec_handle(cligen_spec *sp);
+int             cligen_spec_version(cligen_spec *sp);
+cligen_server  *cligen_server_new(cligen_spec *sp);
+int             cligen_server_free(cligen_server *srv);
+cligen_spec    *cligen_server_spec(cligen_server *srv);
+int             cligen_server_spec_set(cligen_server *srv, cligen_spec *sp);
+int             cligen_server_sessions(cligen_server *srv);
+int             cligen_server_listen(cligen_server *srv, int fd);
+int             cligen_server_exit_set(cligen_server *srv);
+int             cligen_server_loop(cligen_server *srv);
+cligen_session *cligen_session_new(cligen_server *srv, int fdin, int fdout);
+int             cligen_session_free(cligen_session *ss);
+cligen_handle   cligen_session_handle(cligen_session *ss);
+
+#endif /* _CLIGEN_SERVER_H_ */
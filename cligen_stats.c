@@ -0,0 +1,309 @@
+/*
+  CLI generator per-phase statistics
+
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+
+
+  Per-phase counters and timers of the parse/eval pipeline.
+  Instrumented code calls cligen_stats_start at the beginning of a phase and
+  cligen_stats_stop at the end. When statistics are not enabled, cligen_stats_start
+  returns 0 and cligen_stats_stop does nothing, so the cost is one test per phase.
+  With CLIGEN_STATS set to 0 the calls are compiled out.
+*/
+
+#include "cligen_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "cligen_buf.h"
+#include "cligen_cv.h"
+#include "cligen_cvec.h"
+#include "cligen_parsetree.h"
+#include "cligen_pt_head.h"
+#include "cligen_object.h"
+#include "cligen_handle.h"
+#include "cligen_stats.h"
+#include "cligen_handle_internal.h"
+
+/* Names of phases, in order of enum cligen_stat_phase */
+static const char *_stats_phase_str[CLIGEN_STAT_NR] = {
+    "tokenize",
+    "treeref",
+    "expand",
+    "expand-fn",
+    "match",
+    "parse",
+    "validate",
+    "regex",
+    "eval",
+    "resume"
+};
+
+/*! Get name of a phase
+ * @param[in]  phase  Phase
+ * @retval     str    Name, eg "match"
+ * @retval     NULL   Unknown phase
+ */
+const char *
+cligen_stats_phase2str(enum cligen_stat_phase phase)
+{
+    if ((int)phase < 0 || phase >= CLIGEN_STAT_NR)
+	return NULL;
+    return _stats_phase_str[phase];
+}
+
+/*! Get statistics mode
+ * @param[in] h      CLIgen handle
+ * @retval    1      Phases are counted and timed
+ * @retval    0      Not enabled (default)
+ */
+int
+cligen_stats_enabled(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    return ch->ch_stats_enabled;
+}
+
+/*! Enable or disable counting and timing of the phases of the parse/eval pipeline
+ *
+ * Counters are kept until reset with cligen_stats_reset, also when disabled.
+ * @param[in] h      CLIgen handle
+ * @param[in] flag   1: enable, 0: disable
+ * @retval    0      OK
+ * @retval   -1      Error, compiled without CLIGEN_STATS
+ * @see cligen_stats_get
+ */
+int
+cligen_stats_set(cligen_handle h,
+		 int           flag)
+{
+    struct cligen_handle *ch = handle(h);
+
+#if CLIGEN_STATS
+    ch->ch_stats_enabled = flag;
+    return 0;
+#else
+    ch->ch_stats_enabled = 0;
+    if (flag){
+	errno = ENOTSUP;
+	return -1;
+    }
+    return 0;
+#endif
+}
+
+/*! Get a copy of the counters of a handle
+ * @param[in]  h      CLIgen handle
+ * @param[out] cs     Counters since start or last reset
+ * @retval     0      OK
+ * @retval    -1      Error
+ */
+int
+cligen_stats_get(cligen_handle h,
+		 cligen_stats *cs)
+{
+    struct cligen_handle *ch = handle(h);
+
+    if (cs == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    memcpy(cs, &ch->ch_stats, sizeof(*cs));
+    return 0;
+}
+
+/*! Reset all counters of a handle
+ * @param[in]  h      CLIgen handle
+ * @retval     0      OK
+ */
+int
+cligen_stats_reset(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+
+    memset(&ch->ch_stats, 0, sizeof(ch->ch_stats));
+    return 0;
+}
+
+/*! Set per-line trace hook, called at the end of each line when statistics are enabled
+ * @param[in]  h      CLIgen handle
+ * @param[in]  fn     Hook, or NULL to remove
+ * @param[in]  arg    Argument given to fn
+ * @retval     0      OK
+ */
+int
+cligen_stats_fn_set(cligen_handle      h,
+		    cligen_stats_fn_t *fn,
+		    void              *arg)
+{
+    struct cligen_handle *ch = handle(h);
+
+    ch->ch_stats_fn = fn;
+    ch->ch_stats_arg = arg;
+    return 0;
+}
+
+/*! Print counters of a handle, one phase per line
+ * @param[in]  f      Output file, eg stderr
+ * @param[in]  h      CLIgen handle
+ * @retval     0      OK
+ */
+int
+cligen_stats_dump(FILE         *f,
+		  cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+    cligen_stats         *cs = &ch->ch_stats;
+    int                   i;
+
+    fprintf(f, "%-12s %12s %14s %10s\n", "phase", "calls", "total(us)", "avg(ns)");
+    for (i=0; i<CLIGEN_STAT_NR; i++)
+	fprintf(f, "%-12s %12" PRIu64 " %14" PRIu64 " %10" PRIu64 "\n",
+		_stats_phase_str[i],
+		cs->cs_calls[i],
+		cs->cs_ns[i]/1000,
+		cs->cs_calls[i] ? cs->cs_ns[i]/cs->cs_calls[i] : 0);
+    fprintf(f, "lines: %" PRIu64 " objects new: %" PRIu64 " freed: %" PRIu64 "\n",
+	    cs->cs_lines, cs->cs_co_new, cs->cs_co_free);
+    return 0;
+}
+
+/*! Start of a line: save counters to compute the counters of the line
+ * @param[in]  h      CLIgen handle
+ * @retval     0      OK
+ * @see cligen_stats_line_end
+ */
+int
+cligen_stats_line_begin(cligen_handle h)
+{
+    struct cligen_handle *ch = handle(h);
+    uint64_t              live;
+
+    if (!ch->ch_stats_enabled)
+	return 0;
+    memcpy(&ch->ch_stats_line, &ch->ch_stats, sizeof(ch->ch_stats_line));
+    co_stats_get(&live, NULL, NULL);
+    ch->ch_stats_line.cs_co_new = co_count_get();
+    ch->ch_stats_line.cs_co_free = ch->ch_stats_line.cs_co_new - live;
+    return 0;
+}
+
+/*! End of a line: add object counters and call the trace hook with counters of the line
+ *
+ * Objects are counted process-wide, also objects of other threads.
+ * @param[in]  h      CLIgen handle
+ * @param[in]  line   Command line
+ * @retval     0      OK
+ * @retval    -1      Error in trace hook
+ * @see cligen_stats_fn_set
+ */
+int
+cligen_stats_line_end(cligen_handle h,
+		      char         *line)
+{
+    struct cligen_handle *ch = handle(h);
+    cligen_stats         *cs = &ch->ch_stats;
+    cligen_stats         *csl = &ch->ch_stats_line;
+    uint64_t              live;
+    uint64_t              nr;
+    int                   i;
+
+    if (!ch->ch_stats_enabled)
+	return 0;
+    co_stats_get(&live, NULL, NULL);
+    nr = co_count_get();
+    /* Line counters are the difference to the start of the line */
+    for (i=0; i<CLIGEN_STAT_NR; i++){
+	csl->cs_calls[i] = cs->cs_calls[i] - csl->cs_calls[i];
+	csl->cs_ns[i] = cs->cs_ns[i] - csl->cs_ns[i];
+    }
+    csl->cs_lines = 1;
+    csl->cs_co_new = nr - csl->cs_co_new;
+    csl->cs_co_free = (nr - live) - csl->cs_co_free;
+    cs->cs_lines++;
+    cs->cs_co_new += csl->cs_co_new;
+    cs->cs_co_free += csl->cs_co_free;
+    if (ch->ch_stats_fn &&
+	(*ch->ch_stats_fn)(h, line, csl, ch->ch_stats_arg) < 0)
+	return -1;
+    return 0;
+}
+
+#if CLIGEN_STATS
+/*! Start timing a phase
+ * @param[in]  h      CLIgen handle, may be NULL
+ * @retval     t0     Start time in nanoseconds, give to cligen_stats_stop
+ * @retval     0      Not enabled
+ */
+uint64_t
+cligen_stats_start(cligen_handle h)
+{
+    struct timespec ts;
+
+    if (h == NULL || !handle(h)->ch_stats_enabled)
+	return 0;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec + 1; /* never 0 */
+}
+
+/*! Stop timing a phase, count one call and add the time since t0
+ * @param[in]  h      CLIgen handle, may be NULL
+ * @param[in]  phase  Phase
+ * @param[in]  t0     Return value of cligen_stats_start, 0 is ignored
+ * @retval     0      OK
+ */
+int
+cligen_stats_stop(cligen_handle          h,
+		  enum cligen_stat_phase phase,
+		  uint64_t               t0)
+{
+    struct cligen_handle *ch;
+    struct timespec       ts;
+    uint64_t              t1;
+
+    if (t0 == 0 || h == NULL)
+	return 0;
+    ch = handle(h);
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    t1 = (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec + 1;
+    ch->ch_stats.cs_calls[phase]++;
+    ch->ch_stats.cs_ns[phase] += t1 - t0;
+    return 0;
+}
+#endif /* CLIGEN_STATS */
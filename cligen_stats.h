@@ -0,0 +1,103 @@
+/*
+  CLI generator per-phase statistics
+
+  ***** BEGIN LICENSE BLOCK *****
+
+  Copyright (C) 2001-2021 Olof Hagsand
+
+  This file is part of CLIgen.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  Alternatively, the contents of this file may be used under the terms of
+  the GNU General Public License Version 2 or later (the "GPL"),
+  in which case the provisions of the GPL are applicable instead
+  of those above. If you wish to allow use of your version of this file only
+  under the terms of the GPL, and not to allow others to
+  use your version of this file under the terms of Apache License version 2, indicate
+  your decision by deleting the provisions above and replace them with the
+  notice and other provisions required by the GPL. If you do not delete
+  the provisions above, a recipient may use your version of this file under
+  the terms of any one of the Apache License version 2 or the GPL.
+
+  ***** END LICENSE BLOCK *****
+
+
+  This file includes per-phase counters and timers of the parse/eval pipeline
+*/
+
+#ifndef _CLIGEN_STATS_H_
+#define _CLIGEN_STATS_H_
+
+/*
+ * Constants
+ */
+/* Phases of the parse/eval pipeline. A phase includes the time of phases it calls,
+ * eg match includes expand and validate */
+enum cligen_stat_phase{
+    CLIGEN_STAT_TOKENIZE,  /* cligen_str2tokens */
+    CLIGEN_STAT_TREEREF,   /* pt_expand_treeref */
+    CLIGEN_STAT_EXPAND,    /* pt_expand */
+    CLIGEN_STAT_EXPAND_FN, /* expand callbacks, see pt_expand_fnv */
+    CLIGEN_STAT_MATCH,     /* match_pattern */
+    CLIGEN_STAT_PARSE,     /* cv_parse1 of variables */
+    CLIGEN_STAT_VALIDATE,  /* cv_validate of variables, including regexp */
+    CLIGEN_STAT_REGEX,     /* regexp matching */
+    CLIGEN_STAT_EVAL,      /* command callbacks, see cligen_eval */
+    CLIGEN_STAT_RESUME,    /* completion resumed from saved match state, see cligen_complete_state_set */
+    CLIGEN_STAT_NR         /* Number of phases, not a phase */
+};
+
+/*
+ * Types
+ */
+/*! Counters of a handle, or of one line when given to cligen_stats_fn_t
+ */
+struct cligen_stats{
+    uint64_t cs_calls[CLIGEN_STAT_NR]; /* Number of calls per phase */
+    uint64_t cs_ns[CLIGEN_STAT_NR];    /* Time per phase in nanoseconds */
+    uint64_t cs_lines;                 /* Number of lines */
+    uint64_t cs_co_new;                /* Objects allocated, see co_count_get */
+    uint64_t cs_co_free;               /* Objects freed */
+};
+typedef struct cligen_stats cligen_stats;
+
+/*! Per-line trace hook, called at the end of each line with the counters of that line
+ * @param[in]  h     CLIgen handle
+ * @param[in]  line  Command line
+ * @param[in]  cs    Counters of this line
+ * @param[in]  arg   Argument given to cligen_stats_fn_set
+ */
+typedef int (cligen_stats_fn_t)(cligen_handle h, char *line, cligen_stats *cs, void *arg);
+
+/*
+ * Prototypes
+ */
+int         cligen_stats_enabled(cligen_handle h);
+int         cligen_stats_set(cligen_handle h, int flag);
+int         cligen_stats_get(cligen_handle h, cligen_stats *cs);
+int         cligen_stats_reset(cligen_handle h);
+int         cligen_stats_fn_set(cligen_handle h, cligen_stats_fn_t *fn, void *arg);
+int         cligen_stats_dump(FILE *f, cligen_handle h);
+const char *cligen_stats_phase2str(enum cligen_stat_phase phase);
+int         cligen_stats_line_begin(cligen_handle h);
+int         cligen_stats_line_end(cligen_handle h, char *line);
+#if CLIGEN_STATS
+uint64_t    cligen_stats_start(cligen_handle h);
+int         cligen_stats_stop(cligen_handle h, enum cligen_stat_phase phase, uint64_t t0);
+#else
+#define     cligen_stats_start(h)            0
+#define     cligen_stats_stop(h, phase, t0)  ((void)(t0))
+#endif
+
+#endif /* _CLIGEN_STATS_H_ */
@@ -37,6 +37,9 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
 #include <netinet/in.h>
 
 #include "cligen_buf.h"
@@ -49,26 +52,62 @@
 #include "cligen_handle.h"
 #include "cligen_read.h"
 #include "cligen_syntax.h"
+#include "cligen_intern.h"
+#include "cligen_registry.h"
+#include "cligen_expand.h"
 
-/*! Parse a string containing a CLIgen spec into a parse-tree
- * 
- * Syntax parsing. A string is input and a syntax-tree is returned (or error). 
- * A variable record is also returned containing a list of (global) variable values.
- * The string contains a hierarchy of syntax specs bounded by {} and semi-colon. Comma is used
- * to tag a syntax-spec with assignments or callbacks. Help strings are delimited with ("").
- * '#' anywhere on the line means the rest is comment.
+/*! Get last parse-tree header of handle
+ * @param[in]  h     CLIgen handle
+ * @retval     ph    Last parse-tree header
+ * @retval     NULL  No parse-trees
+ */
+static pt_head *
+ph_last(cligen_handle h)
+{
+    pt_head *ph = NULL;
+    pt_head *ph1;
+
+    while ((ph1 = cligen_ph_each(h, ph)) != NULL)
+	ph = ph1;
+    return ph;
+}
+
+/*! Set source of parse-tree headers added after mark
+ * @param[in]  h      CLIgen handle
+ * @param[in]  mark   Last parse-tree header before parse, or NULL
+ * @param[in]  name   Name of spec
+ * @param[in]  stamp  Version of spec, eg modification time
+ */
+static int
+ph_source_mark(cligen_handle h,
+	       pt_head      *mark,
+	       char         *name,
+	       uint64_t      stamp)
+{
+    pt_head *ph;
+
+    for (ph = cligen_ph_each(h, mark); ph; ph = cligen_ph_each(h, ph))
+	if (cligen_ph_source_set(ph, name, stamp) < 0)
+	    return -1;
+    return 0;
+}
+
+/*! Parse a string or a buffer containing a CLIgen spec into a parse-tree
+ *
  * @param[in]     h    CLIgen handle
- * @param[in]     str  String to parse containing CLIgen specification statements
+ * @param[in]     str  String or buffer containing CLIgen specification statements
+ * @param[in]     len  0: str is a string, copied by the scanner.
+ *                     >0: Length of buffer, which has two extra NULs at str[len] and
+ *                     str[len+1] and is scanned in place (temporarily modified)
  * @param[in]     name Debug string identifying the spec, typically a filename
  * @param[in,out] pt   Parse-tree, if set, add commands to this. Can be NULL
  * @param[out]    cvv  Global variables
- * @see cligen_parse_file
- * @note parse-trees can be added as side-effect:s using the treename clispec:s. The tree returned
- * in pt is only the "latest" one.
+ * @see cligen_parse_str
  */
-int
-cligen_parse_str(cligen_handle h,
+static int
+cligen_parse_buf(cligen_handle h,
 		 char         *str,
+		 size_t        len,
 		 char         *name,
 		 parse_tree   *ptp,
 		 cvec         *cvv)
@@ -80,7 +119,9 @@ cligen_parse_str(cligen_handle h,
     cg_obj            *cot = NULL;
     parse_tree        *pt = NULL; 
     pt_head           *ph;
+    pt_head           *mark;
     
+    mark = ph_last(h);
     /* "Fake" top-level object that is removed on exit */
     if ((cot = co_new(NULL, NULL)) == NULL)
 	goto done;
@@ -89,6 +130,7 @@ cligen_parse_str(cligen_handle h,
     cy.cy_treename     = strdup(name); /* Use name as default tree name */
     cy.cy_linenum      = 1;
     cy.cy_parse_string = str;
+    cy.cy_parse_len    = len;
     cy.cy_stack        = NULL;
     if (ptp != NULL)
 	pt = ptp;
@@ -103,7 +145,7 @@ cligen_parse_str(cligen_handle h,
 	    fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno)); 
 	    goto done;
 	}
-    if (strlen(str)){ /* Not empty */
+    if (str[0] != '\0'){ /* Not empty */
 	if (cgl_init(&cy) < 0)
 	    goto done;
 	if (cgy_init(&cy, cot) < 0)
@@ -126,7 +168,30 @@ cligen_parse_str(cligen_handle h,
 	    goto done;		
 	if (cgl_exit(&cy) < 0)
 	    goto done;		
+	/* Share strings of new objects, also in trees added with treename */
+	if (cligen_intern_table(h) != NULL){
+	    if (cligen_parsetree_intern(h, pt) < 0)
+		goto done;
+	    ph = NULL;
+	    while ((ph = cligen_ph_each(h, ph)) != NULL)
+		if (cligen_parsetree_intern(h, cligen_ph_parsetree_get(ph)) < 0)
+		    goto done;
+	}
+	/* Label masks of new objects, for filtering in tree references */
+	if (cligen_parsetree_labels(h, pt) < 0)
+	    goto done;
+	/* Match metadata, also of trees added with treename */
+	if (cligen_parsetree_meta(pt) < 0)
+	    goto done;
+	ph = NULL;
+	while ((ph = cligen_ph_each(h, ph)) != NULL)
+	    if (cligen_parsetree_labels(h, cligen_ph_parsetree_get(ph)) < 0 ||
+		cligen_parsetree_meta(cligen_ph_parsetree_get(ph)) < 0)
+		goto done;
     }
+    /* Trees added by this spec, see cligen_ph_reload */
+    if (ph_source_mark(h, mark, name, 0) < 0)
+	goto done;
     if (cvv == NULL) /* Not passed to caller function */
 	cvec_free(cy.cy_globals);
     /*
@@ -146,6 +211,32 @@ cligen_parse_str(cligen_handle h,
     return retval;
 }
 
+/*! Parse a string containing a CLIgen spec into a parse-tree
+ * 
+ * Syntax parsing. A string is input and a syntax-tree is returned (or error). 
+ * A variable record is also returned containing a list of (global) variable values.
+ * The string contains a hierarchy of syntax specs bounded by {} and semi-colon. Comma is used
+ * to tag a syntax-spec with assignments or callbacks. Help strings are delimited with ("").
+ * '#' anywhere on the line means the rest is comment.
+ * @param[in]     h    CLIgen handle
+ * @param[in]     str  String to parse containing CLIgen specification statements
+ * @param[in]     name Debug string identifying the spec, typically a filename
+ * @param[in,out] pt   Parse-tree, if set, add commands to this. Can be NULL
+ * @param[out]    cvv  Global variables
+ * @see cligen_parse_file
+ * @note parse-trees can be added as side-effect:s using the treename clispec:s. The tree returned
+ * in pt is only the "latest" one.
+ */
+int
+cligen_parse_str(cligen_handle h,
+		 char         *str,
+		 char         *name,
+		 parse_tree   *ptp,
+		 cvec         *cvv)
+{
+    return cligen_parse_buf(h, str, 0, name, ptp, cvv);
+}
+
 /*! Parse a file containing a CLIgen spec into a parse-tree
  *
  * @param[in]     h    CLIgen handle
@@ -162,34 +253,46 @@ cligen_parse_file(cligen_handle h,
 		  parse_tree   *pt,  
 		  cvec         *cvv)
 {
-    char         *buf;
-    int           i;
-    int           c;
-    int           len;
     int           retval = -1;
+    char         *buf = NULL;
+    char         *p;
+    size_t        len = 0;  /* bytes read */
+    size_t        cap;      /* size of buf */
+    size_t        n;
+    struct stat   st;
+    long          pos;
 
-    len = 1024; /* any number is fine */
-    if ((buf = malloc(len)) == NULL){
-	perror("pt_file malloc");
-	return -1;
+    /* Regular file: read all in one call, otherwise (pipe) grow as needed
+     * Two extra bytes for the NULs the scanner requires at the end */
+    cap = 1024;
+    if (fstat(fileno(f), &st) == 0 && S_ISREG(st.st_mode) &&
+	(pos = ftell(f)) >= 0 && st.st_size >= pos)
+	cap = st.st_size - pos + 3;
+    if ((buf = malloc(cap)) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	goto done;
     }
-    memset(buf, 0, len);
-
-    i = 0; /* position in buf */
-    while (1){ /* read the whole file */
-	if ((c = fgetc(f)) == EOF)
-	    break;
-	if (i == len-1){
-	    if ((buf = realloc(buf, 2*len)) == NULL){
+    while ((n = fread(buf+len, 1, cap-len-2, f)) > 0){
+	len += n;
+	if (len == cap-2){
+	    cap *= 2;
+	    if ((p = realloc(buf, cap)) == NULL){
 		fprintf(stderr, "%s: realloc: %s\n", __FUNCTION__, strerror(errno));
 		goto done;
-	    }	    
-	    memset(buf+len, 0, len);
-	    len *= 2;
+	    }
+	    buf = p;
 	}
-	buf[i++] = (char)(c&0xff);
-    } /* read a line */
-    if (cligen_parse_str(h, buf, name, pt, cvv) < 0)
+    }
+    if (ferror(f)){
+	fprintf(stderr, "%s: fread: %s\n", __FUNCTION__, strerror(errno));
+	goto done;
+    }
+    /* As a string, a spec ends at the first NUL */
+    if ((p = memchr(buf, '\0', len)) != NULL)
+	len = p - buf;
+    buf[len] = '\0';
+    buf[len+1] = '\0';
+    if (cligen_parse_buf(h, buf, len, name, pt, cvv) < 0)
 	goto done;
     retval = 0;
   done:
@@ -198,6 +301,359 @@ cligen_parse_file(cligen_handle h,
     return retval;
 }
 
+/*! Version of a spec file, its modification time in nanoseconds
+ */
+static uint64_t
+stat_stamp(struct stat *st)
+{
+    return (uint64_t)st->st_mtim.tv_sec*1000000000ULL + st->st_mtim.tv_nsec;
+}
+
+/*! Parse a spec file again and update the parse-trees parsed from it, see cligen_ph_reload
+ * @param[in]  stamp  Version of file, or 0
+ */
+static int
+parse_file_reload(cligen_handle h,
+		  FILE         *f,
+		  char         *name,
+		  cvec         *cvv,
+		  uint64_t      stamp)
+{
+    pt_head *mark;
+
+    mark = ph_last(h);
+    if (cligen_parse_file(h, f, name, NULL, cvv) < 0 ||
+	ph_source_mark(h, mark, name, stamp) < 0){
+	cligen_ph_trim(h, mark);
+	return -1;
+    }
+    return cligen_ph_reload(h, mark, name);
+}
+
+/*! Parse a spec file again and update the parse-trees parsed from it in place
+ *
+ * Instead of freeing and parsing all specs, only the trees of one spec are updated with
+ * minimal changes, see cligen_ph_reload. Unchanged objects are kept with their resolved
+ * functions, so only new objects need to be mapped, eg with cligen_callbackv_str2fn
+ * which skips mapped objects. Working points in unchanged objects remain.
+ * Trees are matched by name to trees parsed before with the same name argument.
+ * On a syntax error no tree is changed.
+ * @param[in]     h     CLIgen handle
+ * @param[in]     f     Open stdio file handle
+ * @param[in]     name  Name of spec as when parsed before, eg file name
+ * @param[out]    cvv   Global variables
+ * @retval        n     Number of changed objects and trees, 0: no change
+ * @retval       -1     Error
+ * @see cligen_parse_files_reload
+ */
+int
+cligen_parse_file_reload(cligen_handle h,
+			 FILE         *f,
+			 char         *name,
+			 cvec         *cvv)
+{
+    if (h == NULL || f == NULL || name == NULL){
+	errno = EINVAL;
+	return -1;
+    }
+    return parse_file_reload(h, f, name, cvv, 0);
+}
+
+/*! Scan a directory for spec files with a suffix, in alphabetical order
+ *
+ * Entries are filtered after scandir since its filter callback has no argument for the
+ * suffix. Hidden files are skipped.
+ * @param[in]  dir       Directory
+ * @param[in]  suffix    Suffix of files, eg ".cli"
+ * @param[out] namelist  Vector of entries, free each entry and the vector
+ * @retval     n         Number of entries
+ * @retval    -1         Error
+ */
+static int
+parse_files_scan(const char      *dir,
+		 const char      *suffix,
+		 struct dirent ***namelist)
+{
+    struct dirent **nl = NULL;
+    int             n;
+    int             i;
+    int             j = 0;
+    size_t          len;
+    size_t          slen = strlen(suffix);
+
+    if ((n = scandir(dir, &nl, NULL, alphasort)) < 0){
+	fprintf(stderr, "%s: scandir(%s): %s\n", __FUNCTION__, dir, strerror(errno));
+	return -1;
+    }
+    for (i=0; i<n; i++){
+	len = strlen(nl[i]->d_name);
+	if (nl[i]->d_name[0] != '.' && len > slen &&
+	    strcmp(nl[i]->d_name + len - slen, suffix) == 0)
+	    nl[j++] = nl[i];
+	else
+	    free(nl[i]);
+    }
+    *namelist = nl;
+    return j;
+}
+
+/*! Open a spec file in a directory and advise the kernel to read it
+ * @param[in]  dir   Directory
+ * @param[in]  file  File name
+ * @param[in]  path  Buffer for path
+ * @param[in]  plen  Size of path buffer
+ * @retval     f     Open file
+ * @retval     NULL  Error
+ */
+static FILE *
+parse_files_open(const char *dir,
+		 const char *file,
+		 char       *path,
+		 size_t      plen)
+{
+    FILE *f;
+
+    snprintf(path, plen, "%s/%s", dir, file);
+    if ((f = fopen(path, "r")) == NULL){
+	fprintf(stderr, "%s: fopen(%s): %s\n", __FUNCTION__, path, strerror(errno));
+	return NULL;
+    }
+#ifdef POSIX_FADV_WILLNEED
+    (void)posix_fadvise(fileno(f), 0, 0, POSIX_FADV_WILLNEED);
+#endif
+    return f;
+}
+
+/*! Parse all files in a directory containing CLIgen specs, each into its own parse-tree
+ *
+ * Files are parsed in alphabetical order. Each file is added as a parse-tree head named
+ * after the file without suffix, eg foo.cli is named "foo", unless it sets treename.
+ * Files are parsed one at a time since the parser is not reentrant. The next file is
+ * opened and the kernel advised to read it while parsing, so that its read overlaps,
+ * and at most two files are open at once.
+ * @param[in]  h       CLIgen handle
+ * @param[in]  dir     Directory
+ * @param[in]  suffix  Only parse files ending with this suffix, eg ".cli"
+ * @param[out] cvv     Global variables of all files, later files override
+ * @retval     n       Number of files parsed
+ * @retval    -1       Error
+ * @see cligen_parse_file
+ */
+int
+cligen_parse_files(cligen_handle h,
+		   const char   *dir,
+		   const char   *suffix,
+		   cvec         *cvv)
+{
+    int             retval = -1;
+    struct dirent **namelist = NULL;
+    FILE           *f = NULL;
+    FILE           *fnext = NULL;
+    int             n = 0;
+    int             i;
+    char           *path = NULL;
+    size_t          plen;
+    char           *name;
+    pt_head        *mark;
+    struct stat     st;
+
+    if (dir == NULL || suffix == NULL){
+	errno = EINVAL;
+	goto done;
+    }
+    if ((n = parse_files_scan(dir, suffix, &namelist)) < 0){
+	n = 0;
+	goto done;
+    }
+    plen = strlen(dir) + 1 + 256 + 1;
+    if ((path = malloc(plen)) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	goto done;
+    }
+    for (i=0; i<n; i++){
+	if (f == NULL &&
+	    (f = parse_files_open(dir, namelist[i]->d_name, path, plen)) == NULL)
+	    goto done;
+	/* Read-ahead of next file */
+	if (i+1 < n &&
+	    (fnext = parse_files_open(dir, namelist[i+1]->d_name, path, plen)) == NULL)
+	    goto done;
+	name = namelist[i]->d_name;
+	name[strlen(name) - strlen(suffix)] = '\0';
+	mark = ph_last(h);
+	if (cligen_parse_file(h, f, name, NULL, cvv) < 0)
+	    goto done;
+	/* Modification time for cligen_parse_files_reload */
+	if (fstat(fileno(f), &st) == 0 &&
+	    ph_source_mark(h, mark, name, stat_stamp(&st)) < 0)
+	    goto done;
+	fclose(f);
+	f = fnext;
+	fnext = NULL;
+    }
+    retval = n;
+  done:
+    if (f)
+	fclose(f);
+    if (fnext)
+	fclose(fnext);
+    if (path)
+	free(path);
+    if (namelist){
+	for (i=0; i<n; i++)
+	    free(namelist[i]);
+	free(namelist);
+    }
+    return retval;
+}
+
+/*! Parse changed files in a directory again, updating their parse-trees in place
+ *
+ * Files parsed by cligen_parse_files, or by an earlier call, are parsed again only if
+ * their modification time changed, see cligen_parse_file_reload. New files are parsed
+ * and trees of removed files are removed.
+ * @param[in]  h       CLIgen handle
+ * @param[in]  dir     Directory
+ * @param[in]  suffix  Only parse files ending with this suffix, eg ".cli"
+ * @param[out] cvv     Global variables of parsed files
+ * @retval     n       Number of parsed and removed files, 0: no file changed
+ * @retval    -1       Error
+ */
+int
+cligen_parse_files_reload(cligen_handle h,
+			  const char   *dir,
+			  const char   *suffix,
+			  cvec         *cvv)
+{
+    int             retval = -1;
+    struct dirent **namelist = NULL;
+    FILE           *f = NULL;
+    int             n = 0;
+    int             nr = 0;
+    int             i;
+    char           *path = NULL;
+    size_t          plen;
+    char           *name;
+    char           *source;
+    pt_head        *ph;
+    uint64_t        stamp;
+    struct stat     st;
+    int             ret;
+
+    if (h == NULL || dir == NULL || suffix == NULL){
+	errno = EINVAL;
+	goto done;
+    }
+    if ((n = parse_files_scan(dir, suffix, &namelist)) < 0){
+	n = 0;
+	goto done;
+    }
+    plen = strlen(dir) + 1 + 256 + 1;
+    if ((path = malloc(plen)) == NULL){
+	fprintf(stderr, "%s: malloc: %s\n", __FUNCTION__, strerror(errno));
+	goto done;
+    }
+    for (i=0; i<n; i++){
+	name = namelist[i]->d_name;
+	snprintf(path, plen, "%s/%s", dir, name);
+	name[strlen(name) - strlen(suffix)] = '\0';
+	if (stat(path, &st) < 0){
+	    fprintf(stderr, "%s: stat(%s): %s\n", __FUNCTION__, path, strerror(errno));
+	    goto done;
+	}
+	stamp = stat_stamp(&st);
+	ph = NULL;
+	while ((ph = cligen_ph_each(h, ph)) != NULL)
+	    if ((source = cligen_ph_source_get(ph)) != NULL && strcmp(source, name) == 0 &&
+		cligen_ph_stamp_get(ph) == stamp)
+		break;
+	if (ph != NULL) /* Unchanged */
+	    continue;
+	if ((f = fopen(path, "r")) == NULL){
+	    fprintf(stderr, "%s: fopen(%s): %s\n", __FUNCTION__, path, strerror(errno));
+	    goto done;
+	}
+	if (parse_file_reload(h, f, name, cvv, stamp) < 0)
+	    goto done;
+	fclose(f);
+	f = NULL;
+	nr++;
+    }
+    /* Trees of removed files, sources with modification times not in dir */
+    ph = NULL;
+    while ((ph = cligen_ph_each(h, ph)) != NULL){
+	if ((source = cligen_ph_source_get(ph)) == NULL || cligen_ph_stamp_get(ph) == 0)
+	    continue;
+	for (i=0; i<n; i++)
+	    if (strcmp(namelist[i]->d_name, source) == 0)
+		break;
+	if (i < n)
+	    continue;
+	if ((source = strdup(source)) == NULL)
+	    goto done;
+	ret = cligen_ph_reload(h, ph_last(h), source);
+	free(source);
+	if (ret < 0)
+	    goto done;
+	nr++;
+	ph = NULL; /* Restart, removed trees are freed */
+    }
+    retval = nr;
+  done:
+    if (f)
+	fclose(f);
+    if (path)
+	free(path);
+    if (namelist){
+	for (i=0; i<n; i++)
+	    free(namelist[i]);
+	free(namelist);
+    }
+    return retval;
+}
+
+/*! Map callback names of a parse-tree recursively, see cligen_callbackv_str2fn
+ * @param[in]  memo    Functions returned by str2fn, by name
+ */
+static int
+callbackv_str2fn(parse_tree      *pt, 
+		 cgv_str2fn_t    *str2fn, 
+		 void            *arg,
+		 cligen_registry *memo)
+{
+    int                 retval = -1;
+    cg_obj             *co;
+    char               *callback_err = NULL;   /* Error from str2fn callback */
+    struct cg_callback *cc;
+    int                 i;
+
+    for (i=0; i<pt_len_get(pt); i++)
+	if ((co = pt_vec_i_get(pt, i)) != NULL){
+	    for (cc = co->co_callbacks; cc; cc=cc->cc_next){
+		if (cc->cc_fn_str != NULL && cc->cc_fn_vec == NULL){
+		    if ((cc->cc_fn_vec = (cgv_fnstype_t*)cligen_registry_lookup(memo, CLIGEN_FN_CALLBACK, cc->cc_fn_str)) != NULL)
+			continue;
+		    /* Note str2fn is a function pointer */
+		    cc->cc_fn_vec = str2fn(cc->cc_fn_str, arg, &callback_err);
+		    if (callback_err != NULL){
+			fprintf(stderr, "%s: error: No such function: %s (%s)\n",
+				__FUNCTION__, cc->cc_fn_str, callback_err);
+			goto done;
+		    }
+		    if (cc->cc_fn_vec &&
+			cligen_registry_add(memo, CLIGEN_FN_CALLBACK, cc->cc_fn_str, (cligen_fn_t*)cc->cc_fn_vec) < 0)
+			goto done;
+		}
+	    }
+	    /* recursive call to next level */
+	    if (callbackv_str2fn(co_pt_get(co), str2fn, arg, memo) < 0)
+		goto done;
+	}
+    retval = 0;
+  done:
+    return retval;
+}
+
 /*! Assign functions for variable completion using a mapper function
  *
  * The mapping is done from string to C-function. This is done recursively.
@@ -223,36 +679,60 @@ cligen_parse_file(cligen_handle h,
  *
  * @see cligen_expandv_str2fn    For expansion/completion callbacks
  * @see cligen_callback_str2fn Same but for callback single argument
+ * @see cligen_fn_register     Register functions by name instead, resolved on first use
  * @note str2fn may return NULL on error and should then supply a (static) error string 
+ * @note str2fn is called once per distinct name
  */
 int
 cligen_callbackv_str2fn(parse_tree   *pt, 
 			cgv_str2fn_t *str2fn, 
 			void         *arg)
 {
-    int                 retval = -1;
-    cg_obj             *co;
-    char               *callback_err = NULL;   /* Error from str2fn callback */
-    struct cg_callback *cc;
-    int                 i;
+    int              retval = -1;
+    cligen_registry *memo;
 
-    for (i=0; i<pt_len_get(pt); i++)
+    if ((memo = cligen_registry_new()) == NULL)
+	goto done;
+    retval = callbackv_str2fn(pt, str2fn, arg, memo);
+  done:
+    cligen_registry_free(memo);
+    return retval;
+}
+
+/*! Map expand function names of a parse-tree recursively, see cligen_expandv_str2fn
+ * @param[in]  memo    Functions returned by str2fn, by name
+ */
+static int
+expandv_str2fn(parse_tree       *pt, 
+	       expandv_str2fn_t *str2fn, 
+	       void             *arg,
+	       cligen_registry  *memo)
+{
+    int     retval = -1;
+    cg_obj *co;
+    char   *callback_err = NULL;   /* Error from str2fn callback */
+    int     i;
+
+    for (i=0; i<pt_len_get(pt); i++){    
 	if ((co = pt_vec_i_get(pt, i)) != NULL){
-	    for (cc = co->co_callbacks; cc; cc=cc->cc_next){
-		if (cc->cc_fn_str != NULL && cc->cc_fn_vec == NULL){
-		    /* Note str2fn is a function pointer */
-		    cc->cc_fn_vec = str2fn(cc->cc_fn_str, arg, &callback_err);
-		    if (callback_err != NULL){
-			fprintf(stderr, "%s: error: No such function: %s (%s)\n",
-				__FUNCTION__, cc->cc_fn_str, callback_err);
-			goto done;
-		    }
+	    if (co->co_expand_fn_str != NULL && co->co_expandv_fn == NULL &&
+		(co->co_expandv_fn = (expandv_cb*)cligen_registry_lookup(memo, CLIGEN_FN_EXPAND, co->co_expand_fn_str)) == NULL){
+		/* Note str2fn is a function pointer */
+		co->co_expandv_fn = str2fn(co->co_expand_fn_str, arg, &callback_err);
+		if (callback_err != NULL){
+		    fprintf(stderr, "%s: error: No such function: %s\n",
+			    __FUNCTION__, co->co_expand_fn_str);
+		    goto done;
 		}
+		if (co->co_expandv_fn &&
+		    cligen_registry_add(memo, CLIGEN_FN_EXPAND, co->co_expand_fn_str, (cligen_fn_t*)co->co_expandv_fn) < 0)
+		    goto done;
 	    }
 	    /* recursive call to next level */
-	    if (cligen_callbackv_str2fn(co_pt_get(co), str2fn, arg) < 0)
+	    if (expandv_str2fn(co_pt_get(co), str2fn, arg, memo) < 0)
 		goto done;
 	}
+    }
     retval = 0;
   done:
     return retval;
@@ -278,11 +758,32 @@ cligen_callbackv_str2fn(parse_tree   *pt,
  *                     callbacks. 
  * @param[in]  arg     Function argument for expand callbacks (at evaluation time).
  * @see cligen_callbackv_str2fn for translating callback functions
+ * @note str2fn is called once per distinct name
  */
 int
 cligen_expandv_str2fn(parse_tree       *pt, 
 		      expandv_str2fn_t *str2fn, 
 		      void             *arg)
+{
+    int              retval = -1;
+    cligen_registry *memo;
+
+    if ((memo = cligen_registry_new()) == NULL)
+	goto done;
+    retval = expandv_str2fn(pt, str2fn, arg, memo);
+  done:
+    cligen_registry_free(memo);
+    return retval;
+}
+
+/*! Map translate function names of a parse-tree recursively, see cligen_translate_str2fn
+ * @param[in]  memo    Functions returned by str2fn, by name
+ */
+static int
+translate_str2fn(parse_tree         *pt, 
+		 translate_str2fn_t *str2fn, 
+		 void               *arg,
+		 cligen_registry    *memo)
 {
     int     retval = -1;
     cg_obj *co;
@@ -291,17 +792,21 @@ cligen_expandv_str2fn(parse_tree       *pt,
 
     for (i=0; i<pt_len_get(pt); i++){    
 	if ((co = pt_vec_i_get(pt, i)) != NULL){
-	    if (co->co_expand_fn_str != NULL && co->co_expandv_fn == NULL){
+	    if (co->co_translate_fn_str != NULL && co->co_translate_fn == NULL &&
+		(co->co_translate_fn = (translate_cb_t*)cligen_registry_lookup(memo, CLIGEN_FN_TRANSLATE, co->co_translate_fn_str)) == NULL){
 		/* Note str2fn is a function pointer */
-		co->co_expandv_fn = str2fn(co->co_expand_fn_str, arg, &callback_err);
+		co->co_translate_fn = str2fn(co->co_translate_fn_str, arg, &callback_err);
 		if (callback_err != NULL){
 		    fprintf(stderr, "%s: error: No such function: %s\n",
-			    __FUNCTION__, co->co_expand_fn_str);
+			    __FUNCTION__, co->co_translate_fn_str);
 		    goto done;
 		}
+		if (co->co_translate_fn &&
+		    cligen_registry_add(memo, CLIGEN_FN_TRANSLATE, co->co_translate_fn_str, (cligen_fn_t*)co->co_translate_fn) < 0)
+		    goto done;
 	    }
 	    /* recursive call to next level */
-	    if (cligen_expandv_str2fn(co_pt_get(co), str2fn, arg) < 0)
+	    if (translate_str2fn(co_pt_get(co), str2fn, arg, memo) < 0)
 		goto done;
 	}
     }
@@ -315,34 +820,20 @@ cligen_expandv_str2fn(parse_tree       *pt,
  * @param[in]  pt      Parse-tree. Recursively loop through and call str2fn
  * @param[in]  str2fn  Translator function from strings to function pointers
  * @param[in]  arg     Argument to call str2fn with
+ * @note str2fn is called once per distinct name
  */
 int
 cligen_translate_str2fn(parse_tree         *pt, 
 			translate_str2fn_t *str2fn, 
 			void               *arg)
 {
-    int     retval = -1;
-    cg_obj *co;
-    char   *callback_err = NULL;   /* Error from str2fn callback */
-    int     i;
+    int              retval = -1;
+    cligen_registry *memo;
 
-    for (i=0; i<pt_len_get(pt); i++){    
-	if ((co = pt_vec_i_get(pt, i)) != NULL){
-	    if (co->co_translate_fn_str != NULL && co->co_translate_fn == NULL){
-		/* Note str2fn is a function pointer */
-		co->co_translate_fn = str2fn(co->co_translate_fn_str, arg, &callback_err);
-		if (callback_err != NULL){
-		    fprintf(stderr, "%s: error: No such function: %s\n",
-			    __FUNCTION__, co->co_translate_fn_str);
-		    goto done;
-		}
-	    }
-	    /* recursive call to next level */
-	    if (cligen_translate_str2fn(co_pt_get(co), str2fn, arg) < 0)
-		goto done;
-	}
-    }
-    retval = 0;
+    if ((memo = cligen_registry_new()) == NULL)
+	goto done;
+    retval = translate_str2fn(pt, str2fn, arg, memo);
   done:
+    cligen_registry_free(memo);
     return retval;
 }
@@ -73,6 +73,21 @@ cligen_parse_file(cligen_handle h,
 		  char         *name, 
 		  parse_tree   *obsolete,
 		  cvec         *globals);
+int
+cligen_parse_files(cligen_handle h,
+		   const char   *dir,
+		   const char   *suffix,
+		   cvec         *globals);
+int
+cligen_parse_file_reload(cligen_handle h,
+			 FILE         *f,
+			 char         *name,
+			 cvec         *globals);
+int
+cligen_parse_files_reload(cligen_handle h,
+			  const char   *dir,
+			  const char   *suffix,
+			  cvec         *globals);
 
 int cligen_callback_str2fn(parse_tree *pt, cg_str2fn_t *str2fn, void *arg);
 int cligen_callbackv_str2fn(parse_tree *pt, cgv_str2fn_t *str2fn, void *arg);
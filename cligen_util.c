@@ -127,6 +127,9 @@ cligen_loop(cligen_handle h)
 	    free(reason);
 	    reason = NULL;
 	}
+	/* Other lines of a paste */
+	if (!cligen_exiting(h) && cliread_paste_eval(h) < 0)
+	    goto done;
     }
     retval = 0;
  done:
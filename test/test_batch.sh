@@ -0,0 +1,53 @@
+#!/usr/bin/env bash
+# Batch mode, commands from stdin are evaluated by cligen_eval_stream
+
+# Magic line must be first in script (see README.md)
+s="$_" ; . ./lib.sh || if [ "$s" = $0 ]; then exit 0; else return 0; fi
+
+fspec=$dir/spec.cli
+
+cat > $fspec <<EOF
+  prompt="cli> ";
+  comment="#";
+  treename="batch";
+
+  aa <x:int32>, callback("arg");
+  bb @sub, callback();
+  treename="sub";
+  cc;
+  dd;
+EOF
+
+newtest "batch match"
+expectpart "$(echo "aa 42" | $cligen_file -b -f $fspec 2>&1)" 0 "2 name:x type:int32 value:42" "arg 0: arg"
+
+newtest "batch no prompt"
+ret=$(echo "aa 42" | $cligen_file -b -f $fspec 2>&1)
+match=$(echo "$ret" | grep "cli>")
+if [ -n "$match" ]; then
+    err "no prompt" "$ret"
+fi
+
+newtest "batch empty and comment lines"
+expectpart "$(printf "\n# comment\naa 1\n\naa 2 # trailing\n" | $cligen_file -b -f $fspec 2>&1)" 0 "value:1" "value:2"
+
+newtest "batch tree reference"
+expectpart "$(printf "bb dd\nbb cc\n" | $cligen_file -b -f $fspec 2>&1)" 0 "2 name:dd type:string value:dd" "2 name:cc type:string value:cc"
+
+newtest "batch continue after error"
+expectpart "$(printf "aa x\nbb\naa 3\n" | $cligen_file -b -f $fspec 2>&1)" 0 "CLI syntax error in: \"aa x\": 'x' is not a number" "CLI syntax error in: \"bb\": Incomplete command" "value:3"
+
+newtest "batch stop at error"
+ret=$(printf "aa x\naa 3\n" | $cligen_file -B -f $fspec 2>&1)
+match=$(echo "$ret" | grep "value:3")
+if [ -n "$match" ]; then
+    err "stop at error" "$ret"
+fi
+
+newtest "batch shared tree references"
+expectpart "$(printf "bb dd\nbb cc\n" | $cligen_file -b -S -f $fspec 2>&1)" 0 "2 name:dd type:string value:dd" "2 name:cc type:string value:cc"
+
+newtest "endtest"
+endtest
+
+rm -rf $dir
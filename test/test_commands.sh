@@ -39,6 +39,48 @@ expectpart "$(echo "abc" | $cligen_file -f $fspec 2>&1)" 0 "1 name:abc type:stri
 newtest "abd incomplete"
 expectpart "$(echo "abd" | $cligen_file -f $fspec 2>&1)" 0 'CLI syntax error in: "abd": Incomplete command'
 
+# Wide level using keyword index, see pt_index_lookup
+cat > $fspec <<EOF
+  prompt="cli> ";
+  comment="#";
+  treename="tutorial";
+
+  x0,callback(); x1,callback(); x2,callback(); x3,callback(); x4,callback();
+  x5,callback(); x6,callback(); x7,callback(); x8,callback(); x9,callback();
+  x10,callback(); x11,callback(); x12,callback(); x13,callback(); x14,callback();
+  X1,callback(); "x15",callback(); <v:int32>,callback();
+  x16 {
+     y,callback();
+  }
+EOF
+
+newtest "wide x1 exact"
+expectpart "$(echo "x1" | $cligen_file -f $fspec 2>&1)" 0 "1 name:x1 type:string value:x1"
+
+newtest "wide X1 case"
+expectpart "$(echo "X1" | $cligen_file -f $fspec 2>&1)" 0 "1 name:X1 type:string value:X1"
+
+newtest "wide x ambiguous"
+expectpart "$(echo "x" | $cligen_file -f $fspec 2>&1)" 0 "Ambiguous command"
+
+newtest "wide x15 escaped"
+expectpart "$(echo "x15" | $cligen_file -f $fspec 2>&1)" 0 '1 name:"x15" type:string value:"x15"'
+
+newtest "wide x16 y"
+expectpart "$(echo "x16 y" | $cligen_file -f $fspec 2>&1)" 0 "2 name:y type:string value:y"
+
+newtest "wide 42 variable"
+expectpart "$(echo "42" | $cligen_file -f $fspec 2>&1)" 0 "1 name:v type:int32 value:42"
+
+newtest "wide x17 variable reason"
+expectpart "$(echo "x17" | $cligen_file -f $fspec 2>&1)" 0 "'x17' is not a number"
+
+newtest "wide x1?"
+expectpart "$(echo "x1?" | $cligen_file -f $fspec 2>&1)" 0 "x10" "x14" "x16"
+
+newtest "wide slab several"
+expectpart "$(printf "x16 y\nx\nx17\nx1?\n" | $cligen_file -A -f $fspec 2>&1)" 0 "2 name:y type:string value:y" "Ambiguous command" "'x17' is not a number" "x14"
+
 newtest "endtest"
 endtest
 
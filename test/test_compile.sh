@@ -0,0 +1,62 @@
+#!/usr/bin/env bash
+# Compiled matcher, see cligen_compile_set
+# Lines matched by the compiled tables and lines left to the tree walk give the same result
+
+# Magic line must be first in script (see README.md)
+s="$_" ; . ./lib.sh || if [ "$s" = $0 ]; then exit 0; else return 0; fi
+
+fspec=$dir/spec.cli
+
+cat > $fspec <<EOF
+  prompt="cli> ";
+  treename="compile";
+
+  show {
+    interfaces, callback();
+    ip route, callback();
+  }
+  shutdown, callback();
+  set <name:string> <val:int32 range[1:10]>, callback();
+  num (<a:int32>|<b:ipv4addr>|12), callback();
+  ee (<z:string>|<z:string exp()>), callback();
+  cc <y:string choice:foo|fum>, callback();
+  ref @sub;
+  sets @{
+    aa, callback();
+    bb, callback();
+  }
+  treename="sub";
+  aa {
+    bb, callback();
+    cc, callback();
+  }
+  ab, callback();
+EOF
+
+newtest "$cligen_file -c -f $fspec"
+
+newtest "compile keywords"
+expectpart "$(printf "show interfaces\nshow ip route\nshu\n" | $cligen_file -c -f $fspec 2>&1)" 0 "2 name:interfaces type:string value:interfaces" "3 name:route type:string value:route" "1 name:shutdown type:string value:shutdown"
+
+newtest "compile variables"
+expectpart "$(printf "set foo 3\nnum 13\nnum 1.2.3.4\nnum 12\n" | $cligen_file -c -f $fspec 2>&1)" 0 "2 name:name type:string value:foo" "3 name:val type:int32 value:3" "2 name:a type:int32 value:13" "2 name:b type:ipv4addr value:1.2.3.4" "2 name:12 type:string value:12"
+
+newtest "compile errors"
+expectpart "$(printf "set foo 11\nshow\nsh int\nnum x\ns\n" | $cligen_file -b -c -f $fspec 2>&1)" 0 "Number 11 out of range: 1 - 10" "CLI syntax error in: \"show\": Incomplete command" "CLI syntax error in: \"sh int\": Unknown command" "'x' is not a number" "Ambiguous command"
+
+newtest "compile unique prefix"
+expectpart "$(printf "sho interfaces\nshut\nsh\nref a\n" | $cligen_file -b -c -f $fspec 2>&1)" 0 "2 name:interfaces type:string value:interfaces" "1 name:shutdown type:string value:shutdown" "Ambiguous command"
+
+newtest "compile tree reference"
+expectpart "$(printf "ref aa bb\nref aa c\nref ab\n" | $cligen_file -c -f $fspec 2>&1)" 0 "3 name:bb type:string value:bb" "3 name:cc type:string value:cc" "2 name:ab type:string value:ab"
+
+newtest "compile fallback"
+expectpart "$(printf "ee exp1\ncc fum\nsets bb aa\n" | $cligen_file -c -e -f $fspec 2>&1)" 0 "2 name:z type:string value:exp1" "2 name:y type:string value:fum" "2 name:bb type:string value:bb" "3 name:aa type:string value:aa"
+
+newtest "compile statistics"
+expectpart "$(printf "show interfaces\nshow interfaces\nee exp1\n" | $cligen_file -c -e -T -f $fspec 2>&1)" 0 "hits:2 misses:1"
+
+newtest "endtest"
+endtest
+
+rm -rf $dir
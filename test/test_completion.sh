@@ -40,6 +40,36 @@ expectpart "$(echo "v	a	" | $cligen_file -f $fspec)" 0  "values
 newtest "v<tab>a<tab>42 OK"
 expectpart "$(echo "v	a	42" | $cligen_file -f $fspec 2>&1)" 0  "cli> values 42" "1 name:values type:string value:values" "2 name:int32 type:int32 value:42" 
 
+# Deep completion with completion state (-K), preceding tokens are matched once and
+# later keystrokes resume from the saved state, see cligen_complete_state_set
+cat > $fspec <<EOF
+  prompt="cli> ";
+  treename="deep";
+
+  aa bb <x:int32> cc {
+    dd <y:string choice:foo|fum> ee, callback();
+    dx, callback();
+  }
+EOF
+
+newtest "deep d<tab>"
+expectpart "$(printf "aa bb 1 cc d\t\n" | $cligen_file -K -f $fspec 2>&1)" 0 "dd                        dx"
+
+newtest "deep f<tab><tab>"
+expectpart "$(printf "aa bb 1 cc dd f\t\t\n" | $cligen_file -K -T -f $fspec 2>&1)" 0 "foo                       fum" "cli> aa bb 1 cc dd f" "^resume *[1-9]"
+
+newtest "deep fo<tab>ee"
+expectpart "$(printf "aa bb 1 cc dd fo\tee\n" | $cligen_file -K -f $fspec 2>&1)" 0 "cli> aa bb 1 cc dd foo ee" "6 name:y type:string value:foo" "7 name:ee type:string value:ee"
+
+newtest "deep edit last token<tab>"
+expectpart "$(printf "aa bb 1 cc dd fux\b\b\t\t\n" | $cligen_file -K -T -f $fspec 2>&1)" 0 "foo                       fum" "cli> aa bb 1 cc dd f" "^resume *[1-9]"
+
+newtest "deep next line"
+expectpart "$(printf "aa bb 2 cc dd f\t\naa bb 1 cc d\t\n" | $cligen_file -K -f $fspec 2>&1)" 0 "foo                       fum" "dd                        dx"
+
+newtest "deep f<tab><tab> without completion state"
+expectpart "$(printf "aa bb 1 cc dd f\t\t\n" | $cligen_file -T -f $fspec 2>&1)" 0 "foo                       fum" "^resume *0 "
+
 newtest "endtest"
 endtest
 
@@ -123,6 +123,80 @@ expectpart "$(echo "z	" | $cligen_file -t 0 -e -f $fspec 2>&1)" 0 'CLI syntax er
 newtest "cligen z<tab> tabmode:4"
 expectpart "$(echo "z	" | $cligen_file -t 4 -e -f $fspec 2>&1)" 0 "za zb zc" "1 name:za type:string value:za" "2 name:zb type:string value:zb" "3 name:zc type:string value:zc"
 
+# Cached expand results, see cligen_expand_cache_set
+# count() gives a new command on each call
+cat > $fspec <<EOF
+  prompt="cli> ";
+  treename="example";
+
+  c <x:string count()>, callback();
+  d <y:string> <x:string count()>, callback();
+EOF
+
+newtest "expand no cache"
+expectpart "$(printf "c cnt0\nc cnt0\n" | $cligen_file -e -f $fspec 2>&1)" 0 "2 name:x type:string value:cnt0" 'CLI syntax error in: "c cnt0": Unknown command'
+
+newtest "expand cache"
+expectpart "$(printf "c cnt0\nc cnt0\nc ?\n" | $cligen_file -C 0 -e -f $fspec 2>&1)" 0 "2 name:x type:string value:cnt0" "cnt0                  Help count" --not-- "Unknown command"
+
+newtest "expand cache key has variable values"
+expectpart "$(printf "d a cnt0\nd b cnt1\nd a cnt0\n" | $cligen_file -C 0 -e -f $fspec 2>&1)" 0 "3 name:x type:string value:cnt0" "3 name:x type:string value:cnt1" --not-- "Unknown command"
+
+# Idle pre-expansion, see cligen_idle_expand_set: count() is called before ? is typed
+newtest "expand idle no cache"
+expectpart "$( (printf "c "; sleep 1; printf "?\n") | $cligen_file -W 100 -e -f $fspec 2>&1)" 0 "cnt1                  Help count" --not-- "cnt0"
+
+newtest "expand idle cache"
+expectpart "$( (printf "c "; sleep 1; printf "?\n") | $cligen_file -W 100 -C 0 -e -f $fspec 2>&1)" 0 "cnt0                  Help count" --not-- "cnt1"
+
+# Asynchronous expand callbacks, see cligen_expand_deadline_set
+# async() delivers via a registered fd, slow() delivers one command and never completes
+# late() first delivers late0 with the id of its previous expansion, which is dropped
+cat > $fspec <<EOF
+  prompt="cli> ";
+  treename="example";
+
+  a <x:string async()>, callback();
+  s <x:string slow()>, callback();
+  l <x:string late()>, callback();
+EOF
+
+newtest "expand async ?"
+expectpart "$(echo "a ?" | $cligen_file -e -f $fspec 2>&1)" 0 "async1                Help async1" "async2                Help async2" --not-- "(incomplete)"
+
+newtest "expand async"
+expectpart "$(echo "a async2" | $cligen_file -e -f $fspec 2>&1)" 0 "2 name:x type:string value:async2"
+
+newtest "expand async deadline ?"
+expectpart "$(echo "s ?" | $cligen_file -e -f $fspec 2>&1)" 0 "slow1                 Help slow1" "(incomplete)"
+
+newtest "expand async deadline"
+expectpart "$(echo "s slow1" | $cligen_file -e -f $fspec 2>&1)" 0 "2 name:x type:string value:slow1"
+
+newtest "expand late result of previous expansion dropped"
+expectpart "$(printf "l ?\nl ?\n" | $cligen_file -e -f $fspec 2>&1)" 0 "late1                 Help late1" --not-- "late0" "(incomplete)"
+
+# Large expansion, many() gives 20000 commands
+cat > $fspec <<EOF
+  prompt="cli> ";
+  treename="example";
+
+  m <x:string many()>, callback();
+EOF
+
+newtest "expand many"
+expectpart "$(printf "m many19999\nm many0\n" | $cligen_file -e -f $fspec 2>&1)" 0 "2 name:x type:string value:many19999" "2 name:x type:string value:many0"
+
+newtest "expand many unknown"
+expectpart "$(echo "m many20000" | $cligen_file -e -f $fspec 2>&1)" 0 'CLI syntax error in: "m many20000": Unknown command'
+
+# Help of a large expansion is capped with -M
+newtest "expand many help capped"
+expectpart "$(echo "m ?" | $cligen_file -e -M 100 -f $fspec 2>&1)" 0 "Help many" "... and 19900 more" --not-- "many19999"
+
+newtest "expand many tab capped"
+expectpart "$(printf "m \t\n" | $cligen_file -e -M 10 -f $fspec 2>&1)" 0 "... and 19990 more" --not-- "many19999"
+
 newtest "endtest"
 endtest
 
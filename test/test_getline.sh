@@ -52,6 +52,34 @@ expectpart "$(echo -n "Theodoric ruledTheo 		" | $cligen_file -f $fspec)" 0
 newtest "^W"
 expectpart "$(echo -n "TheodoricThe			" | $cligen_file -f $fspec)" 0 "Theodoric the bold"
 
+# Redraw writes only the changed part of the line, backspace shown as <
+newtest "redraw insert"
+expectpart "$(printf "chief\002\002X\n" | $cligen_file -f $fspec 2>&1 | tr '\b' '<')" 0 "chief<<Xef<<" --not-- "chief<<Xef<<<"
+
+newtest "redraw delete"
+expectpart "$(printf "chief\002\002X\010\n" | $cligen_file -f $fspec 2>&1 | tr '\b' '<')" 0 "chief<<Xef<<<ef <<<" --not-- "chiXef"
+
+newtest "redraw move"
+expectpart "$(printf "chief\001\005\n" | $cligen_file -f $fspec 2>&1 | tr '\b' '<')" 0 "chief<<<<<chief"
+
+# Bracketed paste: ESC [200~ ... ESC [201~ is read at once, without TAB and ? hooks
+cat > $fspec <<EOF
+  prompt="cli> ";
+  treename="example";
+
+  a <x:string>, callback();
+  b, callback();
+EOF
+
+newtest "paste lines"
+expectpart "$(printf "a \033[200~1\r\nb\nzz\na 4\033[201~2\n" | $cligen_file -f $fspec 2>&1)" 0 "2 name:x type:string value:1" "1 name:b type:string value:b" 'CLI syntax error in: "zz": Unknown command' "2 name:x type:string value:42"
+
+newtest "paste no hooks"
+expectpart "$(printf "\033[200~a x?\t\n\033[201~" | $cligen_file -f $fspec 2>&1)" 0 "cli> a x? " "2 name:x type:string value:x?" --not-- "<x>"
+
+newtest "paste history"
+expectpart "$(printf "\033[200~a 1\na 2\n\033[201~\020\020\n" | $cligen_file -f $fspec 2>&1)" 0 "2 name:x type:string value:1" "2 name:x type:string value:2" "cli> a 1"
+
 newtest "endtest"
 endtest
 
@@ -0,0 +1,86 @@
+#!/usr/bin/env bash
+# CLI history: history file appended by sessions, loaded and searched, duplicates
+# See cligen_hist_file_load, cligen_hist_file_sync
+
+# Magic line must be first in script (see README.md)
+s="$_" ; . ./lib.sh || if [ "$s" = $0 ]; then exit 0; else return 0; fi
+
+fspec=$dir/spec.cli
+hfile=$dir/history
+
+cat > $fspec <<EOF
+  prompt="cli> ";
+  treename="example";
+
+  a <x:string>, callback();
+  b, callback();
+EOF
+
+newtest "$cligen_file -f $fspec"
+
+rm -f $hfile
+newtest "history file created"
+expectpart "$(printf "a 1\na 2\n" | $cligen_file -H $hfile -f $fspec 2>&1)" 0 "2 name:x type:string value:2"
+expectpart "$(cat $hfile)" 0 "a 1" "a 2"
+
+newtest "history file appended"
+expectpart "$(printf "a 3\n" | $cligen_file -H $hfile -f $fspec 2>&1)" 0 "2 name:x type:string value:3"
+expectpart "$(wc -l < $hfile)" 0 "3"
+
+# ^P twice recalls line of previous session
+newtest "history file loaded"
+expectpart "$(printf "\020\020\n" | $cligen_file -H $hfile -f $fspec 2>&1)" 0 "2 name:x type:string value:2"
+
+# Only the last lines fitting in history are loaded, ^R finds newest match
+seq -f "a %g" 1 1000 > $hfile
+newtest "history search loaded"
+expectpart "$(printf "\022a 95\n" | $cligen_file -H $hfile -f $fspec 2>&1)" 0 "2 name:x type:string value:959"
+
+# File with more than twice the history size lines is compacted to history size
+newtest "history file compacted"
+expectpart "$(wc -l < $hfile)" 0 "100"
+expectpart "$(tail -1 $hfile)" 0 "a 959"
+
+# ^R again finds older match, first the line of previous session
+newtest "history search older"
+expectpart "$(printf "\022a 95\022\022\n" | $cligen_file -H $hfile -f $fspec 2>&1)" 0 "2 name:x type:string value:958"
+
+# Concurrent sessions append under a lock, no line is lost or mixed
+rm -f $hfile
+newtest "history concurrent append"
+for i in $(seq 1 8); do
+    (seq -f "a s$i-%g" 1 20 | $cligen_file -H $hfile -f $fspec > /dev/null 2>&1) &
+done
+wait
+expectpart "$(wc -l < $hfile)" 0 "160"
+expectpart "$(grep -c '^a s[0-9]-[0-9]*$' $hfile)" 0 "160"
+
+# Concurrent sessions compacting, lines appended after a compaction are kept
+seq -f "a %g" 1 1000 > $hfile
+newtest "history concurrent compact"
+for i in $(seq 1 8); do
+    (seq -f "a c$i-%g" 1 5 | $cligen_file -H $hfile -f $fspec > /dev/null 2>&1) &
+done
+wait
+expectpart "$(grep -c '^a c[0-9]-[0-9]*$' $hfile)" 0 "40"
+expectpart "$(grep -c '^a 1$' $hfile)" 1 "0"
+
+# ^P past the oldest line gives an empty line
+newtest "history duplicates kept"
+expectpart "$(printf "a 1\nb\na 1\n\020\020\020\n" | $cligen_file -f $fspec 2>&1 | grep -c "name:x type")" 0 "3"
+
+newtest "history duplicates removed"
+expectpart "$(printf "a 1\nb\na 1\n\020\020\020\n" | $cligen_file -u -f $fspec 2>&1 | grep -c "name:x type")" 0 "2"
+
+printf "a 2\nb\na 2\na 3\n" > $hfile
+newtest "history duplicates kept on load"
+expectpart "$(printf "\020\020\020\020\n" | $cligen_file -f $fspec -H $hfile 2>&1)" 0 "2 name:x type:string value:2"
+
+printf "a 2\nb\na 2\na 3\n" > $hfile
+newtest "history duplicates removed on load"
+expectpart "$(printf "\020\020\020\n\020\020\020\020\020\n" | $cligen_file -u -H $hfile -f $fspec 2>&1)" 0 "1 name:b type:string value:b" --not-- "2 name:x type:string value:2"
+
+newtest "endtest"
+endtest
+
+rm -rf $dir
@@ -0,0 +1,70 @@
+#!/usr/bin/env bash
+# Precompiled parse-tree images, see cligen_parse_file_image
+
+# Magic line must be first in script (see README.md)
+s="$_" ; . ./lib.sh || if [ "$s" = $0 ]; then exit 0; else return 0; fi
+
+fspec=$dir/spec.cli
+fimg=$dir/spec.img
+fref=$dir/ref
+
+cat > $fspec <<EOF
+  prompt="cli> ";
+  treename="image";
+
+  aaa("Help aaa") <v:int32 range[1:10]>, callback("arg");
+  str <s:string regexp:"[a-z]+">, callback();
+  set @{
+    x, callback();
+    y, callback();
+  }
+EOF
+
+rm -f $fimg
+
+newtest "image is written"
+expectpart "$(echo "aaa 5" | $cligen_file -i $fimg -f $fspec 2>&1)" 0 "2 name:v type:int32 value:5"
+if [ ! -f $fimg ]; then
+    err "$fimg" "no image"
+fi
+
+newtest "image is read"
+expectpart "$(echo "aaa 5" | $cligen_file -i $fimg -f $fspec 2>&1)" 0 "2 name:v type:int32 value:5"
+
+newtest "image range"
+expectpart "$(echo "aaa 11" | $cligen_file -i $fimg -f $fspec 2>&1)" 0 "Number 11 out of range: 1 - 10"
+
+newtest "image regexp"
+expectpart "$(echo "str A" | $cligen_file -i $fimg -f $fspec 2>&1)" 0 "\"A\" is invalid input for cli command: s"
+
+newtest "image help"
+expectpart "$(echo "?" | $cligen_file -i $fimg -f $fspec 2>&1)" 0 "Help aaa" "str" "set"
+
+newtest "image sets"
+expectpart "$(echo "set y x" | $cligen_file -i $fimg -f $fspec 2>&1)" 0 "2 name:y type:string value:y" "3 name:x type:string value:x"
+
+# Same size and modification time: image is used even though spec differs
+touch -r $fspec $fref
+sed -i 's/aaa/bbb/g' $fspec
+touch -r $fref $fspec
+
+newtest "unchanged stat uses image"
+expectpart "$(echo "aaa 5" | $cligen_file -i $fimg -f $fspec 2>&1)" 0 "2 name:v type:int32 value:5"
+
+touch -d "+1 second" $fspec
+
+newtest "changed spec is reparsed"
+expectpart "$(echo "bbb 5" | $cligen_file -i $fimg -f $fspec 2>&1)" 0 "2 name:v type:int32 value:5"
+
+newtest "changed spec image is rewritten"
+expectpart "$(echo "bbb 5" | $cligen_file -i $fimg -f $fspec 2>&1)" 0 "2 name:v type:int32 value:5"
+
+truncate -s 100 $fimg
+
+newtest "truncated image falls back"
+expectpart "$(echo "bbb 5" | $cligen_file -i $fimg -f $fspec 2>&1)" 0 "2 name:v type:int32 value:5"
+
+newtest "endtest"
+endtest
+
+rm -rf $dir
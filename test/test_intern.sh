@@ -0,0 +1,71 @@
+#!/usr/bin/env bash
+# String interning of parse-tree objects, see cligen_intern_set
+# Same keywords, help texts and variable specs occur many times and are shared
+
+# Magic line must be first in script (see README.md)
+s="$_" ; . ./lib.sh || if [ "$s" = $0 ]; then exit 0; else return 0; fi
+
+fspec=$dir/spec.cli
+fimg=$dir/spec.img
+
+cat > $fspec <<EOF
+  prompt="cli> ";
+  treename="intern";
+
+  aa("Help aa") <x:int32 range[1:10]>("Help x"), callback();
+  bb("Help aa") <x:int32 range[1:10]>("Help x") {
+    aa("Help aa"), callback();
+    cc <y:string choice:foo|fum>, callback();
+  }
+  ee (<z:string>|<z:string exp()>), callback();
+  ref @sub, callback();
+  set @{
+    aa, callback();
+    bb, callback();
+  }
+  treename="sub";
+  aa("Help aa"), callback();
+  dd("Help dd") <x:int32>, callback();
+EOF
+
+rm -f $fimg
+
+newtest "$cligen_file -I -f $fspec"
+
+newtest "intern keyword and variable"
+expectpart "$(echo "aa 5" | $cligen_file -I -f $fspec 2>&1)" 0 "1 name:aa type:string value:aa" "2 name:x type:int32 value:5"
+
+newtest "intern range"
+expectpart "$(echo "aa 11" | $cligen_file -I -f $fspec 2>&1)" 0 "Number 11 out of range: 1 - 10"
+
+newtest "intern help"
+expectpart "$(echo "bb 1 ?" | $cligen_file -I -f $fspec 2>&1)" 0 "aa                    Help aa" "cc"
+
+newtest "intern choice"
+expectpart "$(echo "bb 1 cc fum" | $cligen_file -I -f $fspec 2>&1)" 0 "4 name:y type:string value:fum"
+
+newtest "intern expand"
+expectpart "$(echo "ee exp1" | $cligen_file -I -e -f $fspec 2>&1)" 0 "2 name:z type:string value:exp1"
+
+newtest "intern tree reference"
+expectpart "$(printf "ref aa\nref dd 3\nref ?\n" | $cligen_file -I -f $fspec 2>&1)" 0 "2 name:aa type:string value:aa" "3 name:x type:int32 value:3" "dd                    Help dd"
+
+newtest "intern shared tree reference"
+expectpart "$(printf "ref aa\nref dd 3\n" | $cligen_file -I -S -f $fspec 2>&1)" 0 "2 name:aa type:string value:aa" "3 name:x type:int32 value:3"
+
+newtest "intern sets"
+expectpart "$(echo "set bb aa" | $cligen_file -I -f $fspec 2>&1)" 0 "2 name:bb type:string value:bb" "3 name:aa type:string value:aa"
+
+newtest "intern print syntax"
+expectpart "$($cligen_file -I -p -f $fspec < /dev/null 2>&1)" 0 'aa("Help aa") <x:int32 range\[1:10\]>("Help x")' "cc (foo|fum), callback();"
+
+newtest "intern image is written"
+expectpart "$(echo "bb 2 aa" | $cligen_file -I -i $fimg -f $fspec 2>&1)" 0 "3 name:aa type:string value:aa"
+
+newtest "intern image is read"
+expectpart "$(printf "bb 2 aa\nref dd 4\n" | $cligen_file -I -i $fimg -f $fspec 2>&1)" 0 "3 name:aa type:string value:aa" "3 name:x type:int32 value:4"
+
+newtest "endtest"
+endtest
+
+rm -rf $dir
@@ -0,0 +1,58 @@
+#!/usr/bin/env bash
+# CLI output: buffered cligen_output and output filters, see cligen_output_filter_add
+
+# Magic line must be first in script (see README.md)
+s="$_" ; . ./lib.sh || if [ "$s" = $0 ]; then exit 0; else return 0; fi
+
+fspec=$dir/spec.cli
+
+# lines() outputs numbered lines and attaches filters given by keywords
+cat > $fspec <<EOF
+  prompt="cli> ";
+  treename="example";
+
+  lines [include <re:string>] [exclude <ex:string>] [begin <b:string>] [count], lines("100");
+  big, lines("100000");
+  mixed, lines("12", "stdio");
+  errlines [include <re:string>], lines("10", "stderr");
+EOF
+
+newtest "$cligen_file -f $fspec"
+
+newtest "lines"
+expectpart "$(echo "lines" | $cligen_file -f $fspec 2>&1)" 0 "line 0" "line 1" "line 50" "line 99"
+
+newtest "lines include"
+expectpart "$(echo "lines include 9" | $cligen_file -f $fspec 2>&1)" 0 "line 9" "line 19" "line 95" --not-- "line 18" "line 50"
+
+newtest "lines exclude"
+expectpart "$(echo "lines exclude 1" | $cligen_file -f $fspec 2>&1)" 0 "line 0" "line 2" "line 99" --not-- "line 1" "line 21"
+
+newtest "lines begin"
+expectpart "$(echo "lines begin 9[5-6]" | $cligen_file -f $fspec 2>&1)" 0 "line 95" "line 96" "line 99" --not-- "line 94" "line 50"
+
+newtest "lines include count"
+expectpart "$(echo "lines include 9 count" | $cligen_file -f $fspec 2>&1)" 0 "Count: 19 lines" --not-- "line 9"
+
+newtest "lines filters removed after command"
+expectpart "$(printf "lines count\nlines include 5\n" | $cligen_file -f $fspec 2>&1)" 0 "Count: 100 lines" "line 15" "line 55" --not-- "line 16" "Count: 10 lines"
+
+newtest "cligen_output and printf in call order"
+expectpart "$(echo "mixed" | $cligen_file -f $fspec 2>&1 | grep -o "line [0-9]*" | tr '\n' ' ')" 0 "line 0 line 1 line 2 line 3 line 4 line 5 line 6 line 7 line 8 line 9 line 10 line 11 "
+
+newtest "cligen_output and printf in call order to a pipe"
+expectpart "$(printf "mixed\nmixed\n" | $cligen_file -f $fspec 2>/dev/null | grep -o "line [0-9]*" | tr '\n' ' ')" 0 "line 10 line 11 line 0 line 1 line 2 line 3 "
+
+newtest "filters do not apply to stderr"
+expectpart "$(echo "errlines include 5" | $cligen_file -f $fspec 2>&1)" 0 "line 5" "err 0" "err 4" "err 9" --not-- "line 4" "line 6"
+
+newtest "big"
+expectpart "$(echo "big" | $cligen_file -f $fspec 2>&1 | tail -3)" 0 "line 99999"
+
+newtest "big count"
+expectpart "$(echo "big" | $cligen_file -f $fspec 2>&1 | grep -c "line [0-9]")" 0 "100000"
+
+newtest "endtest"
+endtest
+
+rm -rf $dir
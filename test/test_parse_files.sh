@@ -0,0 +1,58 @@
+#!/usr/bin/env bash
+# Loading specs from files and directories, see cligen_parse_file and cligen_parse_files
+
+# Magic line must be first in script (see README.md)
+s="$_" ; . ./lib.sh || if [ "$s" = $0 ]; then exit 0; else return 0; fi
+
+fspec=$dir/spec.cli
+specdir=$dir/specs
+
+rm -rf $specdir
+mkdir $specdir
+
+# Files are loaded in alphabetical order, the first is the active tree
+cat > $specdir/a.cli <<EOF
+  prompt="cli> ";
+  aa <x:int32>, callback();
+  ref @b;
+EOF
+
+cat > $specdir/b.cli <<EOF
+  bb("Help bb"), callback();
+EOF
+
+# Not loaded: wrong suffix
+cat > $specdir/c.txt <<EOF
+  cc, callback();
+EOF
+
+newtest "$cligen_file -D $specdir"
+
+newtest "parse files first tree"
+expectpart "$(echo "aa 42" | $cligen_file -D $specdir 2>&1)" 0 "2 name:x type:int32 value:42"
+
+newtest "parse files reference other file"
+expectpart "$(printf "ref bb\nref ?\n" | $cligen_file -D $specdir 2>&1)" 0 "2 name:bb type:string value:bb" "bb                    Help bb"
+
+newtest "parse files suffix"
+expectpart "$(echo "cc" | $cligen_file -D $specdir 2>&1)" 0 'CLI syntax error in: "cc": Unknown command'
+
+newtest "parse files no dir"
+expectpart "$(echo "aa 1" | $cligen_file -D $dir/nonexist 2>&1)" 255 "scandir"
+
+# A larger spec read from a pipe, not a regular file
+echo 'prompt="cli> ";' > $fspec
+for i in $(seq 1 500); do
+    echo "cmd$i(\"Help command $i\") <x:int32>, callback();" >> $fspec
+done
+
+newtest "parse file from pipe"
+expectpart "$(cat $fspec | $cligen_file -p 2>&1)" 0 'cmd1("Help command 1") <x:int32>, callback();' 'cmd500("Help command 500") <x:int32>, callback();'
+
+newtest "parse file regular"
+expectpart "$(echo "cmd250 7" | $cligen_file -f $fspec 2>&1)" 0 "1 name:cmd250 type:string value:cmd250"
+
+newtest "endtest"
+endtest
+
+rm -rf $dir
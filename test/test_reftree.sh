@@ -60,6 +60,215 @@ expectpart "$(echo "parameter zz2 zz3" | $cligen_file -f $fspec 2>&1)" 0 "CLI sy
 newtest "parameter reference zz2 zz4"
 expectpart "$(echo "parameter zz2 zz4" | $cligen_file -f $fspec 2>&1)" 0 "1 name:parameter type:string value:parameter" "2 name:zz2 type:string value:zz2" "3 name:zz4 type:string value:zz4"
 
+# Several commands in one session reuse the cached tree reference expansions
+newtest "cached reference several commands"
+expectpart "$(printf "values xx yy\nparameter zz1\nparameter zz2 zz4\nvalues zz1\n" | $cligen_file -r -f $fspec 2>&1)" 0 "2 name:xx type:string value:xx" 'CLI syntax error in: "parameter zz1": Unknown command' "3 name:zz4 type:string value:zz4" "2 name:zz1 type:string value:zz1"
+
+# The cached expansions are flushed when their inputs change between commands: the
+# workpoint, the reftree filter and the referenced tree, see cligen_treeref_cache_invalidate
+cat > $fspec <<EOF
+  prompt="cli> ";
+  treename="example";
+
+  ref @sub;
+  edit, cligen_wp_set("sub");{
+    @sub, cligen_wp_set("sub");
+  }
+  top, cligen_wp_top("sub");
+  filter, filter("local");
+  nofilter, filter();
+  swap, treeswap("sub", "other");
+
+  treename="sub";
+  xx;{
+    yy, callback();
+  }
+  zz, local, callback();
+
+  treename="other";
+  ww, callback();
+EOF
+
+for share in "" "-S"; do
+    newtest "cached reference $share workpoint set"
+    expectpart "$(printf "ref yy\nedit xx\nref yy\n" | $cligen_file -r $share -f $fspec 2>&1)" 0 'CLI syntax error in: "ref yy": Unknown command' "2 name:yy type:string value:yy"
+
+    newtest "cached reference $share workpoint top"
+    expectpart "$(printf "edit xx\nref yy\ntop\nref xx yy\n" | $cligen_file -r $share -f $fspec 2>&1)" 0 "2 name:yy type:string value:yy" "3 name:yy type:string value:yy"
+
+    newtest "cached reference $share filter set"
+    expectpart "$(printf "ref zz\nfilter\nref zz\n" | $cligen_file -r $share -f $fspec 2>&1)" 0 "2 name:zz type:string value:zz" 'CLI syntax error in: "ref zz": Unknown command'
+
+    newtest "cached reference $share filter removed"
+    expectpart "$(printf "filter\nref zz\nnofilter\nref zz\n" | $cligen_file -r $share -f $fspec 2>&1)" 0 'CLI syntax error in: "ref zz": Unknown command' "2 name:zz type:string value:zz"
+
+    newtest "cached reference $share tree replaced"
+    expectpart "$(printf "ref zz\nswap\nref ww\nref zz\n" | $cligen_file -r $share -f $fspec 2>&1)" 0 "2 name:zz type:string value:zz" "2 name:ww type:string value:ww" 'CLI syntax error in: "ref zz": Unknown command'
+done
+
+# Shared (non-copying) tree references, see cligen_treeref_share_set()
+cat > $fspec <<EOF
+  prompt="cli> ";
+  comment="#";
+  treename="tutorial";
+
+  shared @subtree;                  # No callback: shared
+  copied @subtree, callback();      # Callback: copied
+  filtered @subtree, @remove:local; # Filtered: copied
+
+  treename="subtree";
+  xx{
+    yy, callback();
+  }
+  zz1, local, callback();
+EOF
+
+for share in "" "-S"; do
+    newtest "shared reference $share ?"
+    expectpart "$(echo "shared ?" | $cligen_file $share -f $fspec 2>&1)" 0 "xx" "zz1"
+
+    newtest "shared reference $share xx yy"
+    expectpart "$(printf "shared xx yy\nshared zz1\n" | $cligen_file $share -f $fspec 2>&1)" 0 "1 name:shared type:string value:shared" "2 name:xx type:string value:xx" "3 name:yy type:string value:yy" "2 name:zz1 type:string value:zz1"
+
+    newtest "copied reference $share xx yy"
+    expectpart "$(printf "copied xx yy\nshared xx yy\n" | $cligen_file $share -f $fspec 2>&1)" 0 "1 name:copied type:string value:copied" "1 name:shared type:string value:shared" "3 name:yy type:string value:yy"
+
+    newtest "filtered reference $share"
+    expectpart "$(printf "filtered zz1\nshared zz1\n" | $cligen_file $share -f $fspec 2>&1)" 0 'CLI syntax error in: "filtered zz1": Unknown command' "2 name:zz1 type:string value:zz1"
+done
+
+# Referenced objects equal to existing objects are merged, see cligen_parsetree_finalize
+cat > $fspec <<EOF
+  prompt="cli> ";
+  treename="tutorial";
+
+  merged {
+    xx ww, callback();
+    @subtree;
+    aa, callback();
+  }
+
+  treename="subtree";
+  xx{
+    yy, callback();
+  }
+  xx zz, callback();
+  bb, callback();
+EOF
+
+for share in "" "-S"; do
+    newtest "merged reference $share ?"
+    expectpart "$(echo "merged ?" | $cligen_file $share -f $fspec 2>&1)" 0 "aa" "bb" "xx"
+
+    newtest "merged reference $share xx ?"
+    expectpart "$(echo "merged xx ?" | $cligen_file $share -f $fspec 2>&1)" 0 "ww" "yy" "zz"
+
+    newtest "merged reference $share xx"
+    expectpart "$(printf "merged xx ww\nmerged xx yy\nmerged xx zz\nmerged bb\n" | $cligen_file $share -f $fspec 2>&1)" 0 "3 name:ww type:string value:ww" "3 name:yy type:string value:yy" "3 name:zz type:string value:zz" "2 name:bb type:string value:bb"
+done
+
+# Callback lists are shared by copies, arguments of a reference are appended to local
+# callbacks of the referenced tree without changing the tree itself
+cat > $fspec <<EOF
+  prompt="cli> ";
+  treename="example";
+
+  ref @sub, callback("top");
+  other @sub, callback("other");
+  (aa|bb), callback("one");
+  treename="sub";
+  x, callback("local");
+  y;
+EOF
+
+newtest "reference callback arguments appended"
+expectpart "$(printf "ref x\nref x\n" | $cligen_file -f $fspec 2>&1)" 0 "arg 0: local" "arg 1: top" --not-- "arg 2:"
+
+newtest "reference callback arguments other reference"
+expectpart "$(printf "ref x\nother x\n" | $cligen_file -f $fspec 2>&1)" 0 "arg 1: top" "arg 1: other" --not-- "arg 2:"
+
+newtest "reference callback inherited"
+expectpart "$(echo "ref y" | $cligen_file -f $fspec 2>&1)" 0 "2 name:y type:string value:y" "arg 0: top" --not-- "arg 1:"
+
+newtest "callback shared by choice"
+expectpart "$(printf "aa\nbb\n" | $cligen_file -f $fspec 2>&1)" 0 "1 name:aa type:string value:aa" "1 name:bb type:string value:bb" "arg 0: one"
+
+# Several labels, filtered by label masks also deep in sub-trees, see cligen_parsetree_labels
+cat > $fspec <<EOF
+  prompt="cli> ";
+  treename="example";
+
+  one @sub, @remove:a, @remove:b;
+  two @sub, @remove:c;
+  all @sub;
+  treename="sub";
+  x {
+    y {
+      ya, a, callback();
+      yc, c, callback();
+      yy, callback();
+    }
+    xb, b, callback();
+  }
+  z, c, callback();
+EOF
+
+newtest "labels filter several"
+expectpart "$(printf "one x y yy\none x y ya\none x xb\none z\n" | $cligen_file -f $fspec 2>&1)" 0 "4 name:yy type:string value:yy" 'CLI syntax error in: "one x y ya": Unknown command' 'CLI syntax error in: "one x xb": Unknown command' "2 name:z type:string value:z"
+
+newtest "labels filter other reference"
+expectpart "$(printf "two x y ya\ntwo x y yc\ntwo z\ntwo x xb\n" | $cligen_file -f $fspec 2>&1)" 0 "4 name:ya type:string value:ya" 'CLI syntax error in: "two x y yc": Unknown command' 'CLI syntax error in: "two z": Unknown command' "3 name:xb type:string value:xb"
+
+newtest "labels not filtered"
+expectpart "$(printf "all x y yc\nall z\n" | $cligen_file -S -f $fspec 2>&1)" 0 "4 name:yc type:string value:yc" "2 name:z type:string value:z"
+
+# Two references at one level with equal top objects are merged, the referenced trees
+# are not changed, also when the references are shared
+cat > $fspec <<EOF
+  prompt="cli> ";
+  treename="example";
+
+  both {
+    @a;
+    @b;
+  }
+  mixed {
+    @a;
+    @b, callback();
+  }
+  onlya @a;
+  onlyb @b;
+  treename="a";
+  show x, callback();
+  treename="b";
+  show y, callback();
+EOF
+
+for share in "" "-S"; do
+    newtest "overlapping references $share merged"
+    expectpart "$(printf "both show x\nboth show y\nmixed show x\nmixed show y\n" | $cligen_file $share -f $fspec 2>&1)" 0 "3 name:x type:string value:x" "3 name:y type:string value:y" --not-- "CLI syntax error"
+
+    newtest "overlapping references $share trees unchanged"
+    expectpart "$(printf "both show y\nmixed show y\nonlya show y\nonlyb show x\nonlya show x\n" | $cligen_file $share -f $fspec 2>&1)" 0 'CLI syntax error in: "onlya show y": Unknown command' 'CLI syntax error in: "onlyb show x": Unknown command' "3 name:x type:string value:x"
+done
+
+# Many trees, references and mode are looked up by name in an index, see cligen_ph_find
+echo 'prompt="cli> ";' > $fspec
+echo 'treename="top";' >> $fspec
+echo 'first @t1;' >> $fspec
+echo 'last @t300;' >> $fspec
+for i in $(seq 1 300); do
+    echo "treename=\"t$i\";" >> $fspec
+    echo "cmd$i, callback();" >> $fspec
+done
+
+newtest "many trees references"
+expectpart "$(printf "first cmd1\nlast cmd300\n" | $cligen_file -f $fspec 2>&1)" 0 "2 name:cmd1 type:string value:cmd1" "2 name:cmd300 type:string value:cmd300"
+
+echo 'mode="t150";' >> $fspec
+newtest "many trees mode"
+expectpart "$(echo "cmd150" | $cligen_file -f $fspec 2>&1)" 0 "1 name:cmd150 type:string value:cmd150"
+
 newtest "endtest"
 endtest
 
@@ -0,0 +1,44 @@
+#!/usr/bin/env bash
+# Function registry, names are resolved on first use, see cligen_fn_register
+
+# Magic line must be first in script (see README.md)
+s="$_" ; . ./lib.sh || if [ "$s" = $0 ]; then exit 0; else return 0; fi
+
+fspec=$dir/spec.cli
+
+cat > $fspec <<EOF
+  prompt="cli> ";
+  treename="example";
+
+  aa <x:int32>, callback("arg");
+  bb, nosuch();
+  cc <y:string exp()>, callback();
+  ref @sub;
+  treename="sub";
+  dd, callback();
+EOF
+
+newtest "$cligen_file -R -f $fspec"
+
+newtest "registry callback"
+expectpart "$(echo "aa 5" | $cligen_file -R -f $fspec 2>&1)" 0 "function: callback" "2 name:x type:int32 value:5" "arg 0: arg"
+
+newtest "registry unknown function not called"
+expectpart "$(echo "bb" | $cligen_file -R -f $fspec 2>&1)" 0 --not-- "function: nosuch"
+
+newtest "str2fn maps unknown function"
+expectpart "$(echo "bb" | $cligen_file -f $fspec 2>&1)" 0 "function: nosuch"
+
+newtest "registry expand"
+expectpart "$(printf "cc ?\ncc exp2\n" | $cligen_file -R -e -f $fspec 2>&1)" 0 "exp1                  Help exp1" "2 name:y type:string value:exp2"
+
+newtest "registry expand not registered"
+expectpart "$(echo "cc ?" | $cligen_file -R -f $fspec 2>&1)" 0 "<y>" --not-- "exp1"
+
+newtest "registry reference"
+expectpart "$(printf "ref dd\nref dd\n" | $cligen_file -R -f $fspec 2>&1)" 0 "function: callback" "2 name:dd type:string value:dd"
+
+newtest "endtest"
+endtest
+
+rm -rf $dir
@@ -0,0 +1,64 @@
+#!/usr/bin/env bash
+# Incremental reload of a spec directory, see cligen_parse_files_reload
+# Changed files are parsed again and their trees updated in place, removed files drop their trees
+
+# Magic line must be first in script (see README.md)
+s="$_" ; . ./lib.sh || if [ "$s" = $0 ]; then exit 0; else return 0; fi
+
+specdir=$dir/specs
+rm -rf $specdir
+mkdir $specdir
+
+cat > $specdir/a.cli <<EOF
+  prompt="cli> ";
+  aa <x:int32>, callback();
+  ref @b;
+  swap, cligen_exec_cb("$dir/swap.sh");
+  reload, reload();
+EOF
+
+cat > $specdir/b.cli <<EOF
+  bb("Help bb"), callback();
+  bc, callback();
+EOF
+
+cat > $dir/b.new <<EOF
+  bb("Help bb"), callback();
+  bd, callback();
+EOF
+
+# Change b.cli and add c.cli from a command
+cat > $dir/swap.sh <<EOF
+#!/usr/bin/env bash
+cp $dir/b.new $specdir/b.cli
+echo 'treename="c"; cc, callback();' > $specdir/c.cli
+EOF
+chmod 755 $dir/swap.sh
+
+newtest "$cligen_file -D $specdir"
+
+newtest "reload unchanged"
+expectpart "$(printf "ref bc\nreload\nref bc\n" | $cligen_file -D $specdir 2>&1)" 0 "reload: files:0" "2 name:bc type:string value:bc"
+
+newtest "reload changed and added"
+expectpart "$(printf "swap\nreload\nref bd\nref bb\nref bc\n" | $cligen_file -D $specdir 2>&1)" 0 "reload: files:2" "2 name:bd type:string value:bd" "2 name:bb type:string value:bb" "CLI syntax error in: \"ref bc\": Unknown command"
+
+# Restore b.cli and remove c.cli
+cat > $specdir/b.cli <<EOF
+  bb("Help bb"), callback();
+  bc, callback();
+EOF
+echo 'treename="c"; cc, callback();' > $specdir/c.cli
+
+cat > $dir/swap.sh <<EOF
+#!/usr/bin/env bash
+rm -f $specdir/c.cli
+EOF
+
+newtest "reload removed"
+expectpart "$(printf "swap\nreload\nreload\nref bc\n" | $cligen_file -D $specdir 2>&1)" 0 "reload: files:1" "reload: files:0" "2 name:bc type:string value:bc"
+
+newtest "endtest"
+endtest
+
+rm -rf $dir
@@ -34,6 +34,16 @@ expectpart "$(echo "values aab" | $cligen_file -f $fspec 2>&1)" 0 "1 name:values
 newtest "cligen values aab foo rest"
 expectpart "$(echo "values aab cde" | $cligen_file -f $fspec 2>&1)" 0 "1 name:values type:string value:values" "2 name:x type:rest value:aab cde"
 
+# Rest is the remaining string as typed, including quotes
+newtest "cligen xxx rest with quotes"
+expectpart "$(echo 'xxx a "b c" d' | $cligen_file -f $fspec 2>&1)" 0 "1 name:xxx type:string value:xxx" '2 name:x type:rest value:a "b c" d'
+
+newtest "cligen xxx rest of many tokens"
+expectpart "$(echo "xxx $(seq -s ' ' 1 20)" | $cligen_file -f $fspec 2>&1)" 0 "2 name:x type:rest value:1 2 3 .* 19 20$"
+
+newtest "cligen xxx quoted token"
+expectpart "$(echo 'xxx "b c"' | $cligen_file -f $fspec 2>&1)" 0 '2 name:x type:rest value:"b c"'
+
 newtest "endtest"
 endtest
 
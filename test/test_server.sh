@@ -0,0 +1,44 @@
+#!/usr/bin/env bash
+# Server mode, see cligen_server_new
+# A session shares the parse-trees of the spec, a reload swaps in a new version
+
+# Magic line must be first in script (see README.md)
+s="$_" ; . ./lib.sh || if [ "$s" = $0 ]; then exit 0; else return 0; fi
+
+fspec=$dir/spec.cli
+
+cat > $fspec <<EOF
+  prompt="srv> ";
+  treename="server";
+
+  show {
+    interfaces, callback();
+  }
+  set <name:string> <val:int32>, callback();
+  reload, reload();
+  ref @sub;
+  treename="sub";
+  aa, callback();
+EOF
+
+newtest "$cligen_file -N -f $fspec"
+
+newtest "server commands"
+expectpart "$(printf "show interfaces\nset foo 3\n" | $cligen_file -N -f $fspec 2>&1)" 0 "srv> " "2 name:interfaces type:string value:interfaces" "3 name:val type:int32 value:3"
+
+newtest "server errors"
+expectpart "$(printf "shw\nshow\nset foo bar\n" | $cligen_file -N -f $fspec 2>&1)" 0 "CLI syntax error in: \"shw\": Unknown command" "CLI syntax error in: \"show\": Incomplete command" "'bar' is not a number"
+
+newtest "server tree reference"
+expectpart "$(printf "ref aa\n" | $cligen_file -N -f $fspec 2>&1)" 0 "2 name:aa type:string value:aa"
+
+newtest "server reload"
+expectpart "$(printf "show interfaces\nreload\nshow interfaces\nreload\nref aa\n" | $cligen_file -N -f $fspec 2>&1)" 0 "spec version 2" "spec version 3" "2 name:interfaces type:string value:interfaces" "2 name:aa type:string value:aa"
+
+newtest "server last line without newline"
+expectpart "$(printf "show interfaces" | $cligen_file -N -f $fspec 2>&1)" 0 "2 name:interfaces type:string value:interfaces"
+
+newtest "endtest"
+endtest
+
+rm -rf $dir
@@ -130,6 +130,25 @@ expectpart "$(echo "b f c d e ?" | $cligen_file -f $fspec 2>&1)" 0 "1 name:b typ
 newtest "b c d d: Already matched"
 expectpart "$(echo "b c d d" | $cligen_file -f $fspec 2>&1)" 0 "Already matched"
 
+# Matched objects are local to each line
+newtest "a d, a d: not matched in previous line"
+expectpart "$(printf "a d\na d c\n" | $cligen_file -f $fspec 2>&1)" 0 "2 name:d type:string value:d" "3 name:c type:string value:c" --not-- "Already matched"
+
+# Large set, matched positions do not fit in a word
+echo 'prompt="cli> ";' > $fspec
+echo 'treename="large";' >> $fspec
+echo 'acl @{' >> $fspec
+for i in $(seq 1 300); do
+    echo "f$i <v$i:int32>, callback();" >> $fspec
+done
+echo '}' >> $fspec
+
+newtest "large set"
+expectpart "$(echo "acl f290 1 f2 2 f70 3" | $cligen_file -f $fspec 2>&1)" 0 "2 name:f290 type:string value:f290" "5 name:v2 type:int32 value:2" "7 name:v70 type:int32 value:3"
+
+newtest "large set: Already matched"
+expectpart "$(echo "acl f290 1 f2 2 f290 3" | $cligen_file -f $fspec 2>&1)" 0 "Already matched"
+
 newtest "endtest"
 endtest
 
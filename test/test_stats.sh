@@ -0,0 +1,56 @@
+#!/usr/bin/env bash
+# Per-phase statistics and per-line trace hook, see cligen_stats_set
+
+# Magic line must be first in script (see README.md)
+s="$_" ; . ./lib.sh || if [ "$s" = $0 ]; then exit 0; else return 0; fi
+
+fspec=$dir/spec.cli
+
+cat > $fspec <<EOF
+  prompt="cli> ";
+  treename="stats";
+
+  aa <x:int32 range[1:10]>, callback();
+  bb <y:string regexp:"[a-z]+">, callback();
+  cc <z:string exp()>, callback();
+  ref @sub;
+  treename="sub";
+  dd, callback();
+  lines, lines("4");
+EOF
+
+newtest "$cligen_file -T -f $fspec"
+expectpart "$(echo "aa 5" | $cligen_file -T -f $fspec 2>&1)" 0 "2 name:x type:int32 value:5" "^lines: 1 "
+
+newtest "stats trace hook per line"
+expectpart "$(printf "aa 5\nbb foo\n" | $cligen_file -T -f $fspec 2>&1)" 0 'trace: "aa 5" match:1 eval:1' 'trace: "bb foo" match:1 eval:1' "lines: 2"
+
+newtest "stats phases"
+expectpart "$(printf "aa 5\nbb foo\ncc exp1\nref dd\n" | $cligen_file -e -T -f $fspec 2>&1)" 0 "^tokenize *4 " "^match *4 " "^eval *4 " "^regex *1 " "^expand-fn " "^treeref " "lines: 4"
+
+newtest "stats no match"
+expectpart "$(echo "aa 11" | $cligen_file -T -f $fspec 2>&1)" 0 'trace: "aa 11" match:1 eval:0' "^eval *0 "
+
+newtest "stats batch mode"
+expectpart "$(printf "aa 5\naa 6\n" | $cligen_file -b -T -f $fspec 2>&1)" 0 'trace: "aa 6" match:1 eval:1' "lines: 2"
+
+newtest "memory accounting"
+expectpart "$(printf "aa 5\nref dd\n" | $cligen_file -T -f $fspec 2>&1)" 0 "^memory: objects:[0-9]* nodes:[0-9]* strings:[0-9]* cvecs:[0-9]* callbacks:[0-9]* varspecs:[0-9]* total:" "^scratch: last:[0-9]* max:[0-9]* arena:"
+
+newtest "parse buffers reused between lines"
+ret=$(printf "aa 5\nbb foo\n" | $cligen_file -T -f $fspec 2>&1 | grep "^parse:")
+ret8=$(printf "aa 5\nbb foo\naa 6\nbb fum\naa 7\nbb fee\naa 8\nbb foe\n" | $cligen_file -T -f $fspec 2>&1 | grep "^parse:")
+a2=$(echo "$ret" | sed 's/.*allocated:\([0-9]*\)/\1/')
+a8=$(echo "$ret8" | sed 's/.*allocated:\([0-9]*\)/\1/')
+if [ -z "$a2" -o "$a2" != "$a8" ]; then
+    err "allocated:$a2" "$ret8"
+fi
+expectpart "$ret8" 0 "^parse: reused:[1-9][0-9]* allocated:"
+
+newtest "cbufs reused between lines"
+expectpart "$(printf "ref lines\nref lines\nref lines\n" | $cligen_file -T -f $fspec 2>&1)" 0 "line 3" "^cbuf: reused:[1-9][0-9]* allocated:"
+
+newtest "endtest"
+endtest
+
+rm -rf $dir
@@ -18,6 +18,7 @@ cat > $fspec <<EOF
   r3  <v:string regexp:"^([a-z][0-9]*">;
   r4  <v:string regexp:"[a-z][0-9]*$">;
   r5  <v:string regexp:"[a-z][0-9]*)$">;
+  r6  <v:string regexp:"[a-z]+[0-9]*" regexp:!"x.*">;
   i0  <v:int8>;
   i1  <v:int16>;
   i2  <v:int32>;
@@ -27,6 +28,10 @@ cat > $fspec <<EOF
   ui2 <v:uint32>;
   ui3 <v:uint64>;
   d0  <v:decimal64 fraction-digits:4 range[0.1:10]>;
+  n0  <v:int32 range[7:9] range[-10:-5] range[1:3]>;
+  n1  <v:int8 range[5]>;
+  n2  <v:uint64 range[10:20] range[15:30]>;
+  s0  <v:string length[2:3] length[6:8]>;
   b0  <v:bool>;
   a0  <v:ipv4addr>;
   a1  <v:ipv4prefix>;
@@ -48,6 +53,13 @@ for x in 0 1 2 3 4 5; do
     expectpart "$(echo "r$x ax42" | $cligen_file -f $fspec)" 0 "cli> r$x ax42" "is invalid input for cli command"
 done
 
+# Compiled regexps are cached, check repeated and inverted patterns
+newtest "regexp r6 several"
+expectpart "$(printf "r6 ab12\nr6 xb12\nr6 ab12\n" | $cligen_file -f $fspec 2>&1)" 0 "cli> r6 ab12" 'CLI syntax error in: "r6 xb12": "xb12" is invalid input for cli command: v' --not-- "r6 ab12\": "
+
+newtest "regexp r6 fail"
+expectpart "$(echo "r6 12" | $cligen_file -f $fspec 2>&1)" 0 "is invalid input for cli command"
+
 for x in 0 1 2 3; do
     newtest "int i$x"
     expectpart "$(echo "i$x -77" | $cligen_file -f $fspec)" 0 "cli> i$x -77" --not-- "CLI syntax error" 
@@ -76,6 +88,26 @@ expectpart "$(echo "d0 17438598437598437598743" | $cligen_file -f $fspec)" 0 "CL
 newtest "dec64 d0 fail"
 expectpart "$(echo "d0 1.67425" | $cligen_file -f $fspec)" 0 "cli> d0 1.67425" "CLI syntax error"
 
+# Several ranges are compiled to sorted intervals, see cv_range_compile
+for x in -10 -5 1 3 7 9; do
+    newtest "range n0 $x"
+    expectpart "$(echo "n0 $x" | $cligen_file -f $fspec 2>&1)" 0 "cli> n0 $x" --not-- "CLI syntax error"
+done
+
+for x in -11 -4 0 4 6 10; do
+    newtest "range n0 $x fail"
+    expectpart "$(echo "n0 $x" | $cligen_file -f $fspec 2>&1)" 0 "Number $x out of range: 7 - 9, -10 - -5, 1 - 3"
+done
+
+newtest "range n1 min of type"
+expectpart "$(printf "n1 -128\nn1 6\n" | $cligen_file -f $fspec 2>&1)" 0 'CLI syntax error in: "n1 6": Number 6 out of range' --not-- '"n1 -128"'
+
+newtest "range n2 overlapping"
+expectpart "$(printf "n2 30\nn2 10\nn2 31\n" | $cligen_file -f $fspec 2>&1)" 0 'CLI syntax error in: "n2 31": Number 31 out of range' --not-- '"n2 30"' '"n2 10"'
+
+newtest "length s0"
+expectpart "$(printf "s0 abc\ns0 abcdefgh\ns0 abcd\n" | $cligen_file -f $fspec 2>&1)" 0 'CLI syntax error in: "s0 abcd": String length 4 out of range: 2 - 3, 6 - 8' --not-- '"s0 abc"' '"s0 abcdefgh"'
+
 newtest "addr a0"
 expectpart "$(echo "a0 1.2.3.4" | $cligen_file -f $fspec)" 0 "cli> a0 1.2.3.4" --not-- "CLI syntax error"
 
@@ -103,6 +135,28 @@ expectpart "$(echo "u1 550e8400-e29b-41d4-a716-446655440000" | $cligen_file -f $
 newtest "time t0"
 expectpart "$(echo "t0 2008-09-21T18:57:21.003" | $cligen_file -f $fspec)" 0 "cli> t0 2008-09-21T18:57:21.003" --not-- "regexp match fail"
 
+# Numbers and addresses are converted in one pass, with the same errors as before
+newtest "int i2 limits"
+expectpart "$(printf "i2 2147483647\ni2 -2147483648\ni2 2147483648\n" | $cligen_file -f $fspec 2>&1)" 0 'CLI syntax error in: "i2 2147483648": Number 2147483648 out of range: -2147483648 - 2147483647' --not-- '"i2 2147483647"' '"i2 -2147483648"'
+
+newtest "int i0 hex and octal"
+expectpart "$(printf "i0 0x10\ni0 010\ni0 08\n" | $cligen_file -f $fspec 2>&1)" 0 "CLI syntax error in: \"i0 08\": '08' is not a number" --not-- '"i0 0x10"' '"i0 010"'
+
+newtest "uint ui3 limits"
+expectpart "$(printf "ui3 18446744073709551615\nui3 18446744073709551616\n" | $cligen_file -f $fspec 2>&1)" 0 'CLI syntax error in: "ui3 18446744073709551616": Number 18446744073709551616 out of range: 0 - 18446744073709551615' --not-- '"ui3 18446744073709551615"'
+
+newtest "addr a0 leading zero fail"
+expectpart "$(echo "a0 1.02.3.4" | $cligen_file -f $fspec 2>&1)" 0 "Invalid IPv4 address"
+
+newtest "addr a2 fail"
+expectpart "$(echo "a2 1::5::6" | $cligen_file -f $fspec 2>&1)" 0 "Invalid IPv6 address"
+
+newtest "addr a4 fail"
+expectpart "$(echo "a4 a4:4e:31:c9:d7:g4" | $cligen_file -f $fspec 2>&1)" 0 "Invalid MAC address (illegal character 'g')"
+
+newtest "uuid u1 fail"
+expectpart "$(echo "u1 550e8400-e29b-41d4-a716-44665544000" | $cligen_file -f $fspec 2>&1)" 0 "Invalid uuid: 550e8400-e29b-41d4-a716-44665544000"
+
 newtest "endtest"
 endtest
 
@@ -0,0 +1,59 @@
+#!/usr/bin/env bash
+# Parallel dry-run validation, see cligen_validate_lines
+# Lines are matched by worker threads without invoking callbacks, lines changing mode are barriers
+
+# Magic line must be first in script (see README.md)
+s="$_" ; . ./lib.sh || if [ "$s" = $0 ]; then exit 0; else return 0; fi
+
+fspec=$dir/spec.cli
+fin=$dir/in
+
+cat > $fspec <<EOF
+  prompt="cli> ";
+  comment="#";
+  treename="validate";
+
+  edit,cligen_wp_set("working");{
+    @working, cligen_wp_set("working");
+  }
+  show, callback();
+  top, cligen_wp_top("working");
+  set <name:string> <val:int32>, callback();
+
+  treename="working";
+  a; {
+    b <v:int32>; {
+      d;
+    }
+    c;
+  }
+EOF
+
+newtest "$cligen_file -V 4 -f $fspec"
+
+newtest "validate no callbacks"
+expectpart "$(printf "show\nset foo 3\n# comment\n\n" | $cligen_file -V 4 -f $fspec 2>&1)" 0 "validate: lines:4 failed:0" --not-- "name:show"
+
+newtest "validate errors"
+expectpart "$(printf "show\nshw\nset foo bar\nsh\n" | $cligen_file -V 4 -f $fspec 2>&1)" 0 "2: CLI syntax error in: \"shw\": Unknown command" "3: CLI syntax error in: \"set foo bar\": 'bar' is not a number" "validate: lines:4 failed:2"
+
+# Each mode change is followed by lines valid only in the new mode
+rm -f $fin
+for i in $(seq 1 200); do
+    echo "edit a" >> $fin
+    echo "edit b $i" >> $fin
+    echo "edit d" >> $fin
+    echo "top" >> $fin
+    echo "edit c" >> $fin
+done
+
+newtest "validate mode barriers"
+expectpart "$(cat $fin | $cligen_file -V 4 -f $fspec 2>&1)" 0 "validate: lines:1000 failed:200" "5: CLI syntax error in: \"edit c\": Unknown command" --not-- "3: CLI syntax error"
+
+newtest "validate one worker"
+expectpart "$(cat $fin | $cligen_file -V 1 -f $fspec 2>&1)" 0 "validate: lines:1000 failed:200"
+
+newtest "endtest"
+endtest
+
+rm -rf $dir
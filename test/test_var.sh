@@ -23,6 +23,9 @@ cat > $fspec <<EOF
 
 # * Choice with variable
   extra (<crypto:string>|<crypto:string choice:mc:aes|mc:foo|des:des|des:des3>), callback();
+
+# * Alternative variables, a token is parsed once per variable in a line
+  addr (<addr:ipv4addr>|<addr:ipv6addr>|<name:string regexp:"[a-z]+">) [<n:int32>], callback();
 EOF
 
 newtest "$cligen_file -f $fspec"
@@ -87,6 +90,62 @@ expectpart "$(echo -n "extra ?" | $cligen_file -f $fspec 2>&1)" 0 "<crypto>" "de
 newtest "extra des:?"
 expectpart "$(echo -n "extra des:?" | $cligen_file -f $fspec 2>&1)" 0 "<crypto>" "des:des" "des:des3" --not-- "mc:aes" "mc:foo"
 
+# Large choices next to keywords, choices are compiled and indexed, see co_choice_compile
+choices=$(seq -s "|" -f "ch%g" 40 -1 1)
+echo 'prompt="cli> ";' > $fspec
+echo 'treename="example";' >> $fspec
+echo 'wide {' >> $fspec
+for i in $(seq 1 20); do
+    echo "cmd$i, callback();" >> $fspec
+done
+echo "<x:string choice:$choices>, callback();" >> $fspec
+echo "<y:string choice:\"q1\"|cmd5x|zz>, callback();" >> $fspec
+echo '}' >> $fspec
+
+newtest "large choice"
+expectpart "$(printf "wide ch1\nwide ch40\nwide cmd7\nwide cmd5x\n" | $cligen_file -f $fspec 2>&1)" 0 "2 name:x type:string value:ch1" "2 name:x type:string value:ch40" "2 name:cmd7 type:string value:cmd7" "2 name:y type:string value:cmd5x"
+
+newtest "large choice unknown"
+expectpart "$(echo "wide ch41" | $cligen_file -f $fspec 2>&1)" 0 'CLI syntax error in: "wide ch41": Unknown command'
+
+newtest "large choice ?"
+expectpart "$(echo -n "wide ch3?" | $cligen_file -f $fspec 2>&1)" 0 "ch3" "ch30" "ch39" --not-- "ch4" "cmd"
+
+# Variables bound from the memo of the line or parsed again give the same values
+for m in "" "-m"; do
+    newtest "alternative variables $m"
+    expectpart "$(printf "addr 1.2.3.4 7\naddr ::1\naddr foo\n" | $cligen_file $m -f $fspec 2>&1)" 0 "2 name:addr type:ipv4addr value:1.2.3.4" "3 name:n type:int32 value:7" "2 name:addr type:ipv6addr value:::1" "2 name:name type:string value:foo"
+
+    newtest "alternative variables fail $m"
+    expectpart "$(echo "addr 1.2.3.4 x" | $cligen_file $m -f $fspec 2>&1)" 0 "'x' is not a number"
+done
+
+# Many global variables, lookups by name use an index, see cvec_find
+echo 'treename="first";' > $fspec
+for i in $(seq 1 40); do
+    echo "g$i=\"$i\";" >> $fspec
+done
+cat >> $fspec <<EOF
+  prompt="cli> ";
+  prompt="other> ";
+  mode="second";
+  aa, callback();
+  treename="second";
+  bb, callback();
+EOF
+
+newtest "many globals mode"
+expectpart "$(echo "bb" | $cligen_file -f $fspec 2>&1)" 0 "cli> " "1 name:bb type:string value:bb" --not-- "other> "
+
+# Variable renamed after the name index of the variable vector is built, see cvec_find
+cat > $fspec <<EOF
+  prompt="cli> ";
+  r$(for i in $(seq 1 20); do printf " <a$i:int32>"; done), rename("a3", "x");
+EOF
+
+newtest "rename indexed variable"
+expectpart "$(echo "r $(seq -s ' ' 1 20)" | $cligen_file -f $fspec 2>&1)" 0 "x: 3" --not-- "not found" "still found"
+
 newtest "endtest"
 endtest
 